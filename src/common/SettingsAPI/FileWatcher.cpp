@@ -2,65 +2,270 @@
 #include "FileWatcher.h"
 #include <utils/winapi_error.h>
 
-std::optional<FILETIME> FileWatcher::MyFileTime()
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace FileWatcherDetails
 {
-    HANDLE hFile = CreateFileW(m_path.c_str(), FILE_READ_ATTRIBUTES, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
-    std::optional<FILETIME> result;
-    if (hFile != INVALID_HANDLE_VALUE)
+    std::wstring to_lower(std::wstring value)
+    {
+        std::transform(value.begin(), value.end(), value.begin(), ::towlower);
+        return value;
+    }
+
+    struct Subscription
+    {
+        // Held while the callback runs, so that unsubscribing waits for it.
+        // Recursive, since a watcher may be destroyed from its own callback.
+        std::recursive_mutex mutex;
+        FileWatcher::Callback callback;
+        std::wstring path;
+        std::optional<uint64_t> lastHash;
+    };
+
+    // The watchers of one file and the debounce timer of its changes
+    struct WatchedFile : std::enable_shared_from_this<WatchedFile>
     {
-        FILETIME lastWrite;
-        if (GetFileTime(hFile, nullptr, nullptr, &lastWrite))
+        std::wstring path;
+        std::mutex mutex;
+        std::vector<std::shared_ptr<Subscription>> subscriptions;
+        wil::unique_threadpool_timer timer;
+
+        explicit WatchedFile(const std::wstring& filePath) :
+            path(filePath)
         {
-            result = lastWrite;
         }
 
-        CloseHandle(hFile);
-    }
+        void OnChanged()
+        {
+            // Re-arming the timer on every change delays the reload until the writes settle
+            FILETIME dueTime = wil::filetime::from_int64(static_cast<ULONGLONG>(-wil::filetime_duration::one_millisecond * FileWatcher::DebounceDelay.count()));
+            SetThreadpoolTimer(timer.get(), &dueTime, 0, 0);
+        }
 
-    return result;
-}
+        void OnDebounced()
+        {
+            // A callback may destroy the last watcher of the file, so keep it alive until the
+            // end. Empty if the file is already being unwatched.
+            auto self = weak_from_this().lock();
+            if (!self)
+            {
+                return;
+            }
 
-FileWatcher::FileWatcher(const std::wstring& path, std::function<void()> callback) :
-    m_path(path),
-    m_callback(callback)
-{
-    std::filesystem::path fsPath(path);
-    m_file_name = fsPath.filename();
-    std::transform(m_file_name.begin(), m_file_name.end(), m_file_name.begin(), ::towlower);
-    m_folder_change_reader = wil::make_folder_change_reader_nothrow(
-        fsPath.parent_path().c_str(),
-        false,
-        wil::FolderChangeEvents::LastWriteTime,
-        [this](wil::FolderChangeEvent, PCWSTR fileName) {
-            std::wstring lowerFileName(fileName);
-            std::transform(lowerFileName.begin(), lowerFileName.end(), lowerFileName.begin(), ::towlower);
-
-            if (m_file_name.compare(fileName) == 0)
+            NotifySubscriptions();
+
+            // Releasing the last reference here would destroy the timer from its own callback,
+            // which waits for the callback to return. Release it from a work item instead.
+            auto release = std::make_unique<std::shared_ptr<WatchedFile>>(std::move(self));
+            if (TrySubmitThreadpoolCallback(
+                    [](PTP_CALLBACK_INSTANCE, PVOID context) {
+                        delete static_cast<std::shared_ptr<WatchedFile>*>(context);
+                    },
+                    release.get(),
+                    nullptr))
+            {
+                release.release();
+            }
+            else if (release->use_count() == 1)
+            {
+                // Leaking the file is better than deadlocking the thread pool
+                Logger::error(L"Failed to release the change timer of {}", path);
+                release.release();
+            }
+        }
+
+        void NotifySubscriptions()
+        {
+            std::vector<std::shared_ptr<Subscription>> current;
+            {
+                std::unique_lock lock{ mutex };
+                current = subscriptions;
+            }
+
+            // The file is read once for all of its watchers
+            const auto hash = FileWatcher::HashFileContent(path);
+            if (!hash.has_value())
+            {
+                return;
+            }
+
+            for (const auto& subscription : current)
             {
-                auto lastWrite = MyFileTime();
-                if (!m_lastWrite.has_value())
+                std::unique_lock lock{ subscription->mutex };
+                if (subscription->callback && subscription->lastHash != hash)
                 {
-                    m_lastWrite = lastWrite;
+                    subscription->lastHash = hash;
+
+                    // Call a copy, destroying the watcher from its callback resets the original
+                    auto callback = subscription->callback;
+                    callback(*hash);
                 }
-                else if (lastWrite.has_value())
+            }
+        }
+    };
+
+    // The change reader shared by all the watchers of files in a directory. Each file is
+    // debounced on its own, so a file written continuously doesn't delay the others.
+    struct DirectoryWatch
+    {
+        std::wstring path;
+        std::mutex mutex;
+        std::map<std::wstring, std::shared_ptr<WatchedFile>> files;
+        wil::unique_folder_change_reader_nothrow reader;
+
+        explicit DirectoryWatch(const std::wstring& directory) :
+            path(directory)
+        {
+        }
+
+        ~DirectoryWatch()
+        {
+            // Stop the notifications before the files, the reader callback arms their timers
+            reader.reset();
+        }
+
+        void OnFileChanged(PCWSTR fileName)
+        {
+            std::unique_lock lock{ mutex };
+            if (auto it = files.find(to_lower(fileName)); it != files.end())
+            {
+                it->second->OnChanged();
+            }
+        }
+
+        void Subscribe(const std::shared_ptr<Subscription>& subscription)
+        {
+            std::unique_lock lock{ mutex };
+            auto& file = files[to_lower(std::filesystem::path(subscription->path).filename().wstring())];
+            if (!file)
+            {
+                file = std::make_shared<WatchedFile>(subscription->path);
+                file->timer.reset(CreateThreadpoolTimer(
+                    [](PTP_CALLBACK_INSTANCE, PVOID context, PTP_TIMER) {
+                        static_cast<WatchedFile*>(context)->OnDebounced();
+                    },
+                    file.get(),
+                    nullptr));
+                if (!file->timer)
                 {
-                    if (m_lastWrite->dwHighDateTime != lastWrite->dwHighDateTime ||
-                        m_lastWrite->dwLowDateTime != lastWrite->dwLowDateTime)
-                    {
-                        m_lastWrite = lastWrite;
-                        m_callback();
-                    }
+                    Logger::error(L"Failed to create the change timer of {}. {}", subscription->path, get_last_error_or_default(GetLastError()));
                 }
             }
-        });
 
-    if (!m_folder_change_reader)
+            std::unique_lock fileLock{ file->mutex };
+            file->subscriptions.push_back(subscription);
+        }
+
+        void Unsubscribe(const std::shared_ptr<Subscription>& subscription)
+        {
+            // Destroyed outside of the lock, the timer waits for a running callback
+            std::shared_ptr<WatchedFile> unwatched;
+            std::unique_lock lock{ mutex };
+            auto it = files.find(to_lower(std::filesystem::path(subscription->path).filename().wstring()));
+            if (it == files.end())
+            {
+                return;
+            }
+
+            std::unique_lock fileLock{ it->second->mutex };
+            std::erase(it->second->subscriptions, subscription);
+            if (it->second->subscriptions.empty())
+            {
+                fileLock.unlock();
+                unwatched = std::move(it->second);
+                files.erase(it);
+            }
+        }
+    };
+
+    std::shared_ptr<DirectoryWatch> GetDirectoryWatch(const std::filesystem::path& directory)
     {
-        Logger::error(L"Failed to start folder change reader for path {}. {}", path, get_last_error_or_default(GetLastError()));
+        static std::mutex mutex;
+        static std::map<std::wstring, std::weak_ptr<DirectoryWatch>> directories;
+
+        std::unique_lock lock{ mutex };
+        const auto key = to_lower(directory.wstring());
+        if (auto existing = directories[key].lock())
+        {
+            return existing;
+        }
+
+        // Saves which replace the file through a rename only change the file names
+        auto watch = std::make_shared<DirectoryWatch>(directory.wstring());
+        auto rawWatch = watch.get();
+        watch->reader = wil::make_folder_change_reader_nothrow(
+            directory.c_str(),
+            false,
+            wil::FolderChangeEvents::LastWriteTime | wil::FolderChangeEvents::FileName,
+            [rawWatch](wil::FolderChangeEvent, PCWSTR fileName) {
+                rawWatch->OnFileChanged(fileName);
+            });
+
+        if (!watch->reader)
+        {
+            Logger::error(L"Failed to start folder change reader for path {}. {}", directory.wstring(), get_last_error_or_default(GetLastError()));
+        }
+
+        // Drop the entries of directories which are not watched anymore
+        std::erase_if(directories, [](const auto& entry) { return entry.second.expired(); });
+        directories[key] = watch;
+        return watch;
     }
 }
 
+FileWatcher::FileWatcher(const std::wstring& path, std::function<void()> callback) :
+    FileWatcher(path, Callback([callback = std::move(callback)](uint64_t) { callback(); }))
+{
+}
+
+FileWatcher::FileWatcher(const std::wstring& path, Callback callback)
+{
+    m_subscription = std::make_shared<FileWatcherDetails::Subscription>();
+    m_subscription->callback = std::move(callback);
+    m_subscription->path = path;
+    m_subscription->lastHash = HashFileContent(path);
+
+    m_directory = FileWatcherDetails::GetDirectoryWatch(std::filesystem::path(path).parent_path());
+    m_directory->Subscribe(m_subscription);
+}
+
 FileWatcher::~FileWatcher()
 {
-    m_folder_change_reader.reset();
+    m_directory->Unsubscribe(m_subscription);
+
+    // Waits for a running callback
+    std::unique_lock lock{ m_subscription->mutex };
+    m_subscription->callback = nullptr;
+}
+
+std::optional<uint64_t> FileWatcher::HashFileContent(const std::wstring& path)
+{
+    wil::unique_hfile file{ CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_DELETE | FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr) };
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    uint64_t hash = 14695981039346656037ull;
+    std::vector<uint8_t> buffer(64 * 1024);
+    while (true)
+    {
+        DWORD read = 0;
+        if (!ReadFile(file.get(), buffer.data(), static_cast<DWORD>(buffer.size()), &read, nullptr))
+        {
+            return std::nullopt;
+        }
+
+        if (read == 0)
+        {
+            return hash;
+        }
+
+        for (DWORD i = 0; i < read; i++)
+        {
+            hash = (hash ^ buffer[i]) * 1099511628211ull;
+        }
+    }
 }
@@ -4,24 +4,44 @@
 #define NOMINMAX
 #include <Windows.h>
 
-#include <thread>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
 #include <optional>
 #include <string>
-#include <functional>
 
 #include <wil/resource.h>
 #include <wil/filesystem.h>
 
-class FileWatcher
+namespace FileWatcherDetails
 {
-    std::wstring m_path;
-    std::wstring m_file_name;
-    std::optional<FILETIME> m_lastWrite;
-    std::function<void()> m_callback;
-    wil::unique_folder_change_reader_nothrow m_folder_change_reader;
+    struct Subscription;
+    struct DirectoryWatch;
+}
 
-    std::optional<FILETIME> MyFileTime();
+// Calls back when the content of a file changes.
+// Watchers of files in the same directory share one directory change reader. Bursts of writes to a
+// file are coalesced until that file was quiet for DebounceDelay, and the callback only runs if the
+// hash of the file content differs from the last one the watcher saw.
+class FileWatcher
+{
 public:
+    using Callback = std::function<void(uint64_t contentHash)>;
+
+    static constexpr std::chrono::milliseconds DebounceDelay{ 100 };
+
     FileWatcher(const std::wstring& path, std::function<void()> callback);
+    FileWatcher(const std::wstring& path, Callback callback);
     ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    // FNV-1a hash of the file content, or nothing if the file can't be read
+    static std::optional<uint64_t> HashFileContent(const std::wstring& path);
+
+private:
+    std::shared_ptr<FileWatcherDetails::DirectoryWatch> m_directory;
+    std::shared_ptr<FileWatcherDetails::Subscription> m_subscription;
 };
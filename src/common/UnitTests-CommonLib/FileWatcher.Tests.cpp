@@ -0,0 +1,146 @@
+#include "pch.h"
+#include <common/SettingsAPI/FileWatcher.h>
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace UnitTestsCommonLib
+{
+    TEST_CLASS (FileWatcherUnitTests)
+    {
+    private:
+        std::filesystem::path m_directory;
+
+        // Long enough for the change notification and the debounce timer on a loaded machine
+        static constexpr DWORD CallbackTimeoutMs = 5000;
+
+        // Quiet period after which a pending callback would have run
+        static constexpr DWORD SettleMs = static_cast<DWORD>(FileWatcher::DebounceDelay.count() * 5);
+
+        static void WriteContent(const std::filesystem::path& path, const std::string& content)
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file << content;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(Init)
+        {
+            m_directory = std::filesystem::temp_directory_path() / (L"FileWatcherTests-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(GetTickCount64()));
+            std::filesystem::create_directories(m_directory);
+        }
+
+        TEST_METHOD_CLEANUP(CleanUp)
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(m_directory, ec);
+        }
+
+        TEST_METHOD (BurstOfWritesCallsBackOnce)
+        {
+            const auto path = m_directory / L"settings.json";
+            WriteContent(path, "initial");
+
+            std::atomic<int> calls = 0;
+            std::atomic<uint64_t> lastHash = 0;
+            wil::unique_event called(wil::EventOptions::None);
+            FileWatcher watcher(path.wstring(), [&](uint64_t contentHash) {
+                lastHash = contentHash;
+                ++calls;
+                called.SetEvent();
+            });
+
+            for (int i = 0; i < 20; i++)
+            {
+                WriteContent(path, "content " + std::to_string(i));
+            }
+
+            Assert::IsTrue(called.wait(CallbackTimeoutMs));
+            Sleep(SettleMs);
+            Assert::AreEqual(1, calls.load());
+            Assert::AreEqual(FileWatcher::HashFileContent(path.wstring()).value(), lastHash.load());
+        }
+
+        TEST_METHOD (UnchangedContentDoesNotCallBack)
+        {
+            const auto path = m_directory / L"settings.json";
+            WriteContent(path, "same");
+
+            std::atomic<int> calls = 0;
+            wil::unique_event called(wil::EventOptions::None);
+            FileWatcher watcher(path.wstring(), [&](uint64_t) {
+                ++calls;
+                called.SetEvent();
+            });
+
+            WriteContent(path, "same");
+            Assert::IsFalse(called.wait(SettleMs));
+            Assert::AreEqual(0, calls.load());
+
+            // The watcher still sees real changes
+            WriteContent(path, "changed");
+            Assert::IsTrue(called.wait(CallbackTimeoutMs));
+            Assert::AreEqual(1, calls.load());
+        }
+
+        TEST_METHOD (BusyFileDoesNotDelayOtherFiles)
+        {
+            const auto busyPath = m_directory / L"busy.json";
+            const auto quietPath = m_directory / L"quiet.json";
+            WriteContent(busyPath, "busy");
+            WriteContent(quietPath, "quiet");
+
+            std::atomic<int> busyCalls = 0;
+            wil::unique_event quietCalled(wil::EventOptions::None);
+            FileWatcher busyWatcher(busyPath.wstring(), [&](uint64_t) { ++busyCalls; });
+            FileWatcher quietWatcher(quietPath.wstring(), [&](uint64_t) { quietCalled.SetEvent(); });
+
+            // The busy file is written more often than the debounce delay the whole time
+            WriteContent(quietPath, "quiet changed");
+            bool quietCalledWhileBusy = false;
+            const auto writeInterval = static_cast<DWORD>(FileWatcher::DebounceDelay.count() / 4);
+            for (int i = 0; i < 40 && !quietCalledWhileBusy; i++)
+            {
+                WriteContent(busyPath, "busy " + std::to_string(i));
+                quietCalledWhileBusy = quietCalled.wait(writeInterval);
+            }
+
+            Assert::IsTrue(quietCalledWhileBusy);
+            Assert::AreEqual(0, busyCalls.load());
+        }
+
+        TEST_METHOD (WatcherCanBeDestroyedFromItsCallback)
+        {
+            const auto path = m_directory / L"settings.json";
+            WriteContent(path, "initial");
+
+            // The only watcher of the directory, so destroying it releases the directory watch too
+            std::atomic<int> calls = 0;
+            std::atomic<bool> captureAlive = false;
+            wil::unique_event called(wil::EventOptions::None);
+            std::unique_ptr<FileWatcher> watcher;
+            watcher = std::make_unique<FileWatcher>(path.wstring(), [&, content = std::string("captured")](uint64_t) {
+                ++calls;
+                watcher.reset();
+
+                // The callback object must outlive its own watcher
+                captureAlive = content == "captured";
+                called.SetEvent();
+            });
+
+            WriteContent(path, "changed");
+            Assert::IsTrue(called.wait(CallbackTimeoutMs));
+            Assert::IsTrue(captureAlive.load());
+
+            WriteContent(path, "changed again");
+            Sleep(SettleMs);
+            Assert::AreEqual(1, calls.load());
+            Assert::IsFalse(static_cast<bool>(watcher));
+        }
+    };
+}
@@ -0,0 +1,354 @@
+#include "pch.h"
+#include "TestHelpers.h"
+#include <json.h>
+#include <json_stream.h>
+#include <atomic_file.h>
+
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using json::stream::Token;
+
+namespace UnitTestsCommonUtils
+{
+    namespace
+    {
+        // Flattens the token stream into a short string, e.g. "{k:s,k:n}" for {"a":"b","c":1}
+        std::string Tokens(std::string_view text)
+        {
+            json::stream::Reader reader(text);
+            std::string result;
+            for (Token token = reader.next(); token != Token::End; token = reader.next())
+            {
+                switch (token)
+                {
+                case Token::BeginObject:
+                    result += '{';
+                    break;
+                case Token::EndObject:
+                    result += '}';
+                    break;
+                case Token::BeginArray:
+                    result += '[';
+                    break;
+                case Token::EndArray:
+                    result += ']';
+                    break;
+                case Token::Key:
+                    result += "k:";
+                    break;
+                case Token::String:
+                    result += 's';
+                    break;
+                case Token::Number:
+                    result += 'n';
+                    break;
+                case Token::True:
+                case Token::False:
+                    result += 'b';
+                    break;
+                case Token::Null:
+                    result += '0';
+                    break;
+                default:
+                    return result + "!";
+                }
+            }
+            return result;
+        }
+
+        std::string Write(const std::function<void(json::stream::Writer&)>& write)
+        {
+            std::ostringstream output;
+            {
+                json::stream::Writer writer(output);
+                write(writer);
+            }
+            return output.str();
+        }
+    }
+
+    TEST_CLASS (JsonStreamReaderTests)
+    {
+    public:
+        TEST_METHOD (ValidDocuments_ProduceTokens)
+        {
+            Assert::AreEqual(std::string("{}"), Tokens("{}"));
+            Assert::AreEqual(std::string("[]"), Tokens(" [ ] "));
+            Assert::AreEqual(std::string("n"), Tokens("42"));
+            Assert::AreEqual(std::string("{k:[nn{k:0}]k:sk:b}"), Tokens("{\"a\":[1, 2,{\"b\":null}], \"c\":\"x\",\"d\":true}"));
+        }
+
+        TEST_METHOD (MalformedDocuments_ReportError)
+        {
+            for (auto text : { "", "[1,]", "{\"a\":1,}", "{\"a\" 1}", "[1 2]", "[01]", "{,}", "[}", "{\"a\":1}}", "\"abc", "[tru]", "{\"a\":\"\x01\"}" })
+            {
+                Assert::IsTrue(Tokens(text).ends_with("!"), winrt::to_hstring(text).c_str());
+            }
+        }
+
+        TEST_METHOD (Strings_WithoutEscapes_PointIntoBuffer)
+        {
+            const std::string text = "[\"plain\"]";
+            json::stream::Reader reader(text);
+            reader.next();
+            Assert::IsTrue(reader.next() == Token::String);
+            Assert::IsTrue(reader.string().data() == text.data() + 2);
+            Assert::AreEqual(std::string("plain"), std::string(reader.string()));
+        }
+
+        TEST_METHOD (Strings_WithEscapes_AreDecoded)
+        {
+            json::stream::Reader reader("[\"a\\\"b\\\\c\\/d\\n\\u00e9\\ud83d\\ude00\"]");
+            reader.next();
+            Assert::IsTrue(reader.next() == Token::String);
+            Assert::AreEqual(std::string("a\"b\\c/d\n\xC3\xA9\xF0\x9F\x98\x80"), std::string(reader.string()));
+            Assert::AreEqual(std::wstring(L"a\"b\\c/d\n\u00e9\U0001F600"), json::stream::to_wstring(reader.string()));
+        }
+
+        TEST_METHOD (Numbers_AreParsed)
+        {
+            json::stream::Reader reader("[-1.5e2, 0, 12345678901]");
+            reader.next();
+            reader.next();
+            Assert::AreEqual(-150.0, reader.number());
+            reader.next();
+            Assert::AreEqual(0.0, reader.number());
+            reader.next();
+            Assert::AreEqual(12345678901.0, reader.number());
+        }
+
+        TEST_METHOD (Skip_ConsumesNestedValue)
+        {
+            json::stream::Reader reader("{\"skip\":{\"a\":[1,{\"b\":2}]},\"keep\":3}");
+            reader.next();
+            reader.next();
+            Assert::IsTrue(reader.skip(reader.next()));
+            Assert::IsTrue(reader.next() == Token::Key);
+            Assert::IsTrue(json::stream::key_equals(reader.string(), L"keep"));
+            Assert::IsTrue(reader.next() == Token::Number);
+            Assert::IsTrue(reader.next() == Token::EndObject);
+            Assert::IsTrue(reader.next() == Token::End);
+        }
+
+        TEST_METHOD (Bom_IsIgnored)
+        {
+            Assert::AreEqual(std::string("{}"), Tokens("\xEF\xBB\xBF{}"));
+        }
+    };
+
+    TEST_CLASS (JsonStreamWriterTests)
+    {
+    public:
+        TEST_METHOD (Writer_ProducesCompactJson)
+        {
+            auto text = Write([](json::stream::Writer& writer) {
+                writer.begin_object();
+                writer.key("a");
+                writer.begin_array();
+                writer.value(1);
+                writer.value(2.5);
+                writer.value(true);
+                writer.null_value();
+                writer.end_array();
+                writer.key(L"b");
+                writer.begin_object();
+                writer.end_object();
+                writer.end_object();
+            });
+
+            Assert::AreEqual(std::string("{\"a\":[1,2.5,true,null],\"b\":{}}"), text);
+        }
+
+        TEST_METHOD (Writer_EscapesStrings)
+        {
+            auto text = Write([](json::stream::Writer& writer) {
+                writer.begin_array();
+                writer.value(L"q\"b\\n\n\x01\u00e9\U0001F600");
+                writer.value("q\"\t");
+                writer.end_array();
+            });
+
+            Assert::AreEqual(std::string("[\"q\\\"b\\\\n\\n\\u0001\xC3\xA9\xF0\x9F\x98\x80\",\"q\\\"\\t\"]"), text);
+        }
+
+        TEST_METHOD (Writer_OutputIsReadableByWinRT)
+        {
+            auto text = Write([](json::stream::Writer& writer) {
+                writer.begin_object();
+                writer.key(L"path");
+                writer.value(std::wstring(L"C:\\Program Files\\\u00c9diteur\\app.exe"));
+                writer.key(L"number");
+                writer.value(-7);
+                writer.end_object();
+            });
+
+            auto obj = json::JsonValue::Parse(winrt::to_hstring(text)).GetObjectW();
+            Assert::AreEqual(std::wstring(L"C:\\Program Files\\\u00c9diteur\\app.exe"), std::wstring(obj.GetNamedString(L"path")));
+            Assert::AreEqual(-7.0, obj.GetNamedNumber(L"number"));
+        }
+
+        TEST_METHOD (AtomicFileWrite_ReplacesFileAndRemovesTemp)
+        {
+            TestHelpers::TempFile tempFile(L"", L".json");
+            tempFile.write("{\"old\":true}");
+
+            Assert::IsTrue(atomic_file::write(tempFile.path(), std::string_view("{\"new\":true}")));
+
+            Assert::AreEqual(std::string("{\"new\":true}"), json::stream::read_file(tempFile.path()).value());
+
+            const auto fileName = std::filesystem::path(tempFile.path()).filename().wstring();
+            for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(tempFile.path()).parent_path()))
+            {
+                const auto entryName = entry.path().filename().wstring();
+                Assert::IsFalse(entryName.starts_with(fileName + L".") && entryName.ends_with(L".tmp"));
+            }
+        }
+
+        TEST_METHOD (AtomicFileWrite_KeepsFileWhenItCannotBeReplaced)
+        {
+            TestHelpers::TempFile tempFile(L"", L".json");
+            tempFile.write("{\"old\":true}");
+
+            // Open without delete sharing, so the file can't be replaced
+            HANDLE file = CreateFileW(tempFile.path().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+            const bool saved = atomic_file::write(tempFile.path(), std::string_view("{\"new\":true}"));
+            CloseHandle(file);
+
+            Assert::IsFalse(saved);
+
+            Assert::AreEqual(std::string("{\"old\":true}"), json::stream::read_file(tempFile.path()).value());
+        }
+
+        TEST_METHOD (ToFile_RoundTripsThroughFromFile)
+        {
+            TestHelpers::TempFile tempFile(L"", L".json");
+
+            json::JsonObject obj;
+            obj.SetNamedValue(L"name", json::value(L"\u00e9t\u00e9"));
+            json::to_file(tempFile.path(), obj);
+
+            auto result = json::from_file(tempFile.path());
+            Assert::IsTrue(result.has_value());
+            Assert::AreEqual(std::wstring(L"\u00e9t\u00e9"), std::wstring(result->GetNamedString(L"name")));
+        }
+    };
+
+    namespace
+    {
+        // Writes an app-zone-history shaped document with the given number of applications
+        void WriteHistory(json::stream::Writer& writer, size_t apps)
+        {
+            writer.begin_object();
+            writer.key(L"app-zone-history");
+            writer.begin_array();
+            for (size_t i = 0; i < apps; ++i)
+            {
+                writer.begin_object();
+                writer.key(L"app-path");
+                writer.value(L"C:\\Program Files\\Vendor " + std::to_wstring(i) + L"\\Application.exe");
+                writer.key(L"history");
+                writer.begin_array();
+                for (int desktop = 0; desktop < 3; ++desktop)
+                {
+                    writer.begin_object();
+                    writer.key(L"zone-index-set");
+                    writer.begin_array();
+                    writer.value(static_cast<int>(i % 4));
+                    writer.value(static_cast<int>(i % 4) + 1);
+                    writer.end_array();
+                    writer.key(L"device");
+                    writer.begin_object();
+                    writer.key(L"monitor");
+                    writer.value(L"DELA0F2");
+                    writer.key(L"monitor-instance");
+                    writer.value(L"4&125707d6&0&UID28741");
+                    writer.key(L"serial-number");
+                    writer.value(L"H5JM7V3");
+                    writer.key(L"monitor-number");
+                    writer.value(desktop + 1);
+                    writer.key(L"virtual-desktop");
+                    writer.value(L"{5E7C8E58-7F38-4EF7-A2E9-3F4B4A8C2D1E}");
+                    writer.end_object();
+                    writer.key(L"zoneset-uuid");
+                    writer.value(L"{61FA9FC0-26A6-4B37-A834-491C148DFC57}");
+                    writer.end_object();
+                }
+                writer.end_array();
+                writer.end_object();
+            }
+            writer.end_array();
+            writer.end_object();
+        }
+
+        size_t CountStrings(std::string_view text)
+        {
+            json::stream::Reader reader(text);
+            size_t strings = 0;
+            for (Token token = reader.next(); token != Token::End; token = reader.next())
+            {
+                Assert::IsTrue(token != Token::Error);
+                strings += token == Token::String ? 1 : 0;
+            }
+            return strings;
+        }
+
+        void MeasureHistory(size_t apps)
+        {
+            TestHelpers::TempFile tempFile(L"", L".json");
+            atomic_file::write(tempFile.path(), [apps](std::ostream& output) {
+                json::stream::Writer writer(output);
+                WriteHistory(writer, apps);
+            });
+            const auto fileSize = std::filesystem::file_size(tempFile.path());
+
+            using clock = std::chrono::steady_clock;
+
+            // Current path: UTF-8 -> UTF-16 -> JsonObject, and back through Stringify
+            auto start = clock::now();
+            auto obj = json::from_file(tempFile.path());
+            const std::chrono::duration<double> winrtRead = clock::now() - start;
+            Assert::IsTrue(obj.has_value());
+
+            start = clock::now();
+            json::to_file(tempFile.path(), obj.value());
+            const std::chrono::duration<double> winrtWrite = clock::now() - start;
+
+            // Streaming path
+            start = clock::now();
+            auto content = json::stream::read_file(tempFile.path());
+            const size_t strings = CountStrings(content.value());
+            const std::chrono::duration<double> streamRead = clock::now() - start;
+            Assert::AreEqual(apps * (1 + 3 * 5), strings);
+
+            start = clock::now();
+            atomic_file::write(tempFile.path(), [apps](std::ostream& output) {
+                json::stream::Writer writer(output);
+                WriteHistory(writer, apps);
+            });
+            const std::chrono::duration<double> streamWrite = clock::now() - start;
+
+            Logger::WriteMessage((std::to_wstring(fileSize / 1024) + L" KB: WinRT read " + std::to_wstring(winrtRead.count()) +
+                                  L" s, write " + std::to_wstring(winrtWrite.count()) + L" s; stream read " + std::to_wstring(streamRead.count()) +
+                                  L" s, write " + std::to_wstring(streamWrite.count()) + L" s\n")
+                                     .c_str());
+        }
+    }
+
+    TEST_CLASS (JsonStreamBenchmarks)
+    {
+    public:
+        BEGIN_TEST_METHOD_ATTRIBUTE(AppZoneHistoryReadWrite)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (AppZoneHistoryReadWrite)
+        {
+            // Roughly 0.8, 4 and 16 MB
+            for (size_t apps : { 1'000, 5'000, 20'000 })
+            {
+                MeasureHistory(apps);
+            }
+        }
+    };
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+
+#include <atomic>
+#include <concepts>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+
+namespace atomic_file
+{
+    namespace details
+    {
+        // Readers (the settings UI, antivirus, indexers) keep the destination open for a moment
+        // without delete sharing, so the rename is retried for a short while before giving up
+        inline bool replace_with_retry(const std::filesystem::path& tempPath, const std::filesystem::path& path)
+        {
+            constexpr int attempts = 10;
+            constexpr DWORD retryDelayMs = 50;
+            for (int attempt = 1;; ++attempt)
+            {
+                if (MoveFileExW(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+                {
+                    return true;
+                }
+
+                const DWORD error = GetLastError();
+                if (attempt == attempts || (error != ERROR_SHARING_VIOLATION && error != ERROR_ACCESS_DENIED && error != ERROR_LOCK_VIOLATION))
+                {
+                    SetLastError(error);
+                    return false;
+                }
+                Sleep(retryDelayMs);
+            }
+        }
+    }
+
+    // Writes the file next to its destination, flushes it to disk and moves it over the
+    // destination, so readers and crashes see either the old or the new content, never a half
+    // written file. If any step fails (e.g. someone keeps the file open without delete sharing),
+    // the destination is left as it was and false is returned.
+    // Replacing the file changes its identity, so use it only for files nobody watches for
+    // in-place writes; json::to_file keeps writing in place.
+    template<typename WriteContent>
+        requires std::invocable<WriteContent&, std::ostream&>
+    bool write(const std::filesystem::path& path, WriteContent&& writeContent)
+    {
+        // Unique, so that two processes saving the same file don't write to the same temp file
+        static std::atomic<uint32_t> tempCounter = 0;
+        auto tempPath = path;
+        tempPath += L"." + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(++tempCounter) + L".tmp";
+
+        std::error_code ec;
+        try
+        {
+            bool written = false;
+            {
+                std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+                if (file.is_open())
+                {
+                    writeContent(file);
+                    file.close();
+                    written = static_cast<bool>(file);
+                }
+            }
+
+            if (written)
+            {
+                // The stream can only flush to the system cache, make the content durable before
+                // the rename makes it visible
+                HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+                const bool flushed = file != INVALID_HANDLE_VALUE && FlushFileBuffers(file);
+                if (file != INVALID_HANDLE_VALUE)
+                {
+                    CloseHandle(file);
+                }
+
+                if (flushed && details::replace_with_retry(tempPath, path))
+                {
+                    return true;
+                }
+            }
+        }
+        catch (...)
+        {
+        }
+
+        const DWORD error = GetLastError();
+        std::filesystem::remove(tempPath, ec);
+        SetLastError(error);
+        return false;
+    }
+
+    inline bool write(const std::filesystem::path& path, std::string_view content)
+    {
+        return write(path, [content](std::ostream& output) {
+            output.write(content.data(), static_cast<std::streamsize>(content.size()));
+        });
+    }
+}
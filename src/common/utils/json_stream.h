@@ -0,0 +1,914 @@
+#pragma once
+
+#include <charconv>
+#include <concepts>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Streaming UTF-8 JSON reader and writer for large data files.
+// Unlike json::from_file/json::to_file, nothing here goes through UTF-16 or builds a DOM:
+// the reader tokenizes the file buffer in place and the writer appends straight to a file buffer.
+// The header only depends on the standard library.
+namespace json::stream
+{
+    enum class Token
+    {
+        BeginObject,
+        EndObject,
+        BeginArray,
+        EndArray,
+        Key,
+        String,
+        Number,
+        True,
+        False,
+        Null,
+        End,
+        Error,
+    };
+
+    namespace details
+    {
+        inline void append_utf8(std::string& out, uint32_t codePoint)
+        {
+            if (codePoint < 0x80)
+            {
+                out.push_back(static_cast<char>(codePoint));
+            }
+            else if (codePoint < 0x800)
+            {
+                out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else if (codePoint < 0x10000)
+            {
+                out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            else
+            {
+                out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+        }
+
+        inline int hex_digit(char c) noexcept
+        {
+            if (c >= '0' && c <= '9')
+            {
+                return c - '0';
+            }
+            if (c >= 'a' && c <= 'f')
+            {
+                return c - 'a' + 10;
+            }
+            if (c >= 'A' && c <= 'F')
+            {
+                return c - 'A' + 10;
+            }
+            return -1;
+        }
+    }
+
+    // Converts a UTF-8 string returned by the Reader into UTF-16. Invalid sequences become U+FFFD.
+    inline std::wstring to_wstring(std::string_view utf8)
+    {
+        std::wstring result;
+        result.reserve(utf8.size());
+
+        size_t i = 0;
+        while (i < utf8.size())
+        {
+            const auto lead = static_cast<unsigned char>(utf8[i]);
+            if (lead < 0x80)
+            {
+                result.push_back(static_cast<wchar_t>(lead));
+                ++i;
+                continue;
+            }
+
+            size_t length = 0;
+            uint32_t codePoint = 0;
+            uint32_t minimum = 0;
+            if ((lead & 0xE0) == 0xC0)
+            {
+                length = 2;
+                codePoint = lead & 0x1F;
+                minimum = 0x80;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                length = 3;
+                codePoint = lead & 0x0F;
+                minimum = 0x800;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                length = 4;
+                codePoint = lead & 0x07;
+                minimum = 0x10000;
+            }
+
+            bool valid = length != 0 && i + length <= utf8.size();
+            for (size_t k = 1; valid && k < length; ++k)
+            {
+                const auto continuation = static_cast<unsigned char>(utf8[i + k]);
+                valid = (continuation & 0xC0) == 0x80;
+                codePoint = (codePoint << 6) | (continuation & 0x3F);
+            }
+            valid = valid && codePoint >= minimum && codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint > 0xDFFF);
+
+            if (!valid)
+            {
+                result.push_back(L'\xFFFD');
+                ++i;
+                continue;
+            }
+
+            if constexpr (sizeof(wchar_t) == 2)
+            {
+                if (codePoint >= 0x10000)
+                {
+                    codePoint -= 0x10000;
+                    result.push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+                    result.push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+                    i += length;
+                    continue;
+                }
+            }
+            result.push_back(static_cast<wchar_t>(codePoint));
+            i += length;
+        }
+
+        return result;
+    }
+
+    // Compares a key returned by the Reader with an ASCII name, without converting either of them.
+    inline bool key_equals(std::string_view utf8, std::wstring_view name) noexcept
+    {
+        if (utf8.size() != name.size())
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < utf8.size(); ++i)
+        {
+            if (static_cast<wchar_t>(static_cast<unsigned char>(utf8[i])) != name[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Pull parser over a UTF-8 buffer which must outlive the reader.
+    // Call next() until it returns Token::End or Token::Error. After Token::Key or Token::String,
+    // string() points either into the buffer (no escapes) or into an internal scratch buffer
+    // which is reused by the following call to next().
+    class Reader
+    {
+    public:
+        explicit Reader(std::string_view text) noexcept :
+            m_text(text)
+        {
+            // Skip the UTF-8 BOM written by some editors
+            if (m_text.starts_with("\xEF\xBB\xBF"))
+            {
+                m_pos = 3;
+            }
+        }
+
+        Token next()
+        {
+            if (m_failed)
+            {
+                return Token::Error;
+            }
+
+            SkipWhitespace();
+            if (m_rootDone)
+            {
+                return m_pos == m_text.size() ? Token::End : Fail();
+            }
+
+            if (m_pos == m_text.size())
+            {
+                return Fail();
+            }
+
+            char c = m_text[m_pos];
+            if (m_afterValue)
+            {
+                if (c == ',')
+                {
+                    ++m_pos;
+                    SkipWhitespace();
+                    if (m_pos == m_text.size())
+                    {
+                        return Fail();
+                    }
+
+                    c = m_text[m_pos];
+                    m_afterValue = false;
+                    m_needItem = true;
+                }
+                else
+                {
+                    return Close(c);
+                }
+            }
+            else if (!m_needItem && !m_afterKey && !m_stack.empty())
+            {
+                // First item of a container, or an empty one
+                if (c == '}' || c == ']')
+                {
+                    return Close(c);
+                }
+            }
+
+            m_needItem = false;
+            if (InObject() && !m_afterKey)
+            {
+                if (c != '"' || !ParseString())
+                {
+                    return Fail();
+                }
+
+                SkipWhitespace();
+                if (m_pos == m_text.size() || m_text[m_pos] != ':')
+                {
+                    return Fail();
+                }
+
+                ++m_pos;
+                m_afterKey = true;
+                return Token::Key;
+            }
+
+            m_afterKey = false;
+            return ParseValue(c);
+        }
+
+        // Consumes the rest of the value whose first token was just returned by next().
+        // Useful for ignoring unknown keys. Returns false on malformed input.
+        bool skip(Token current)
+        {
+            if (current != Token::BeginObject && current != Token::BeginArray)
+            {
+                return current != Token::Error;
+            }
+
+            const size_t depth = m_stack.size();
+            while (m_stack.size() >= depth)
+            {
+                if (next() == Token::Error)
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::string_view string() const noexcept
+        {
+            return m_string;
+        }
+
+        double number() const noexcept
+        {
+            return m_number;
+        }
+
+        size_t depth() const noexcept
+        {
+            return m_stack.size();
+        }
+
+        bool failed() const noexcept
+        {
+            return m_failed;
+        }
+
+        // Byte offset of the first malformed character, if any.
+        size_t position() const noexcept
+        {
+            return m_pos;
+        }
+
+    private:
+        bool InObject() const noexcept
+        {
+            return !m_stack.empty() && m_stack.back() == '{';
+        }
+
+        Token Fail() noexcept
+        {
+            m_failed = true;
+            return Token::Error;
+        }
+
+        void SkipWhitespace() noexcept
+        {
+            while (m_pos < m_text.size())
+            {
+                const char c = m_text[m_pos];
+                if (c != ' ' && c != '\t' && c != '\n' && c != '\r')
+                {
+                    break;
+                }
+                ++m_pos;
+            }
+        }
+
+        void ValueDone() noexcept
+        {
+            if (m_stack.empty())
+            {
+                m_rootDone = true;
+            }
+            else
+            {
+                m_afterValue = true;
+            }
+        }
+
+        Token Close(char c)
+        {
+            const char open = c == '}' ? '{' : '[';
+            if ((c != '}' && c != ']') || m_stack.empty() || m_stack.back() != open)
+            {
+                return Fail();
+            }
+
+            ++m_pos;
+            m_stack.pop_back();
+            m_afterValue = false;
+            ValueDone();
+            return c == '}' ? Token::EndObject : Token::EndArray;
+        }
+
+        Token ParseValue(char c)
+        {
+            switch (c)
+            {
+            case '{':
+            case '[':
+                ++m_pos;
+                m_stack.push_back(c);
+                return c == '{' ? Token::BeginObject : Token::BeginArray;
+            case '"':
+                if (!ParseString())
+                {
+                    return Fail();
+                }
+                ValueDone();
+                return Token::String;
+            case 't':
+                return ParseLiteral("true", Token::True);
+            case 'f':
+                return ParseLiteral("false", Token::False);
+            case 'n':
+                return ParseLiteral("null", Token::Null);
+            default:
+                return ParseNumber();
+            }
+        }
+
+        Token ParseLiteral(std::string_view literal, Token token)
+        {
+            if (m_text.substr(m_pos, literal.size()) != literal)
+            {
+                return Fail();
+            }
+
+            m_pos += literal.size();
+            ValueDone();
+            return token;
+        }
+
+        Token ParseNumber()
+        {
+            const size_t start = m_pos;
+            auto isDigit = [this](size_t pos) { return pos < m_text.size() && m_text[pos] >= '0' && m_text[pos] <= '9'; };
+
+            size_t pos = m_pos;
+            if (pos < m_text.size() && m_text[pos] == '-')
+            {
+                ++pos;
+            }
+
+            if (!isDigit(pos))
+            {
+                return Fail();
+            }
+
+            if (m_text[pos] == '0')
+            {
+                ++pos;
+            }
+            else
+            {
+                while (isDigit(pos))
+                {
+                    ++pos;
+                }
+            }
+
+            if (pos < m_text.size() && m_text[pos] == '.')
+            {
+                ++pos;
+                if (!isDigit(pos))
+                {
+                    return Fail();
+                }
+                while (isDigit(pos))
+                {
+                    ++pos;
+                }
+            }
+
+            if (pos < m_text.size() && (m_text[pos] == 'e' || m_text[pos] == 'E'))
+            {
+                ++pos;
+                if (pos < m_text.size() && (m_text[pos] == '+' || m_text[pos] == '-'))
+                {
+                    ++pos;
+                }
+                if (!isDigit(pos))
+                {
+                    return Fail();
+                }
+                while (isDigit(pos))
+                {
+                    ++pos;
+                }
+            }
+
+            const char* first = m_text.data() + start;
+            const char* last = m_text.data() + pos;
+            auto [ptr, ec] = std::from_chars(first, last, m_number);
+            if (ec == std::errc::result_out_of_range)
+            {
+                // Keep going like JsonValue::Parse does, with a saturated value
+                m_number = *first == '-' ? -HUGE_VAL : HUGE_VAL;
+            }
+            else if (ec != std::errc{} || ptr != last)
+            {
+                return Fail();
+            }
+
+            m_pos = pos;
+            ValueDone();
+            return Token::Number;
+        }
+
+        bool ParseUnicodeEscape(uint32_t& codeUnit) noexcept
+        {
+            // m_pos is at 'u'
+            if (m_pos + 4 >= m_text.size())
+            {
+                return false;
+            }
+
+            codeUnit = 0;
+            for (size_t i = 1; i <= 4; ++i)
+            {
+                const int digit = details::hex_digit(m_text[m_pos + i]);
+                if (digit < 0)
+                {
+                    return false;
+                }
+                codeUnit = (codeUnit << 4) | static_cast<uint32_t>(digit);
+            }
+
+            m_pos += 5;
+            return true;
+        }
+
+        bool ParseString()
+        {
+            // m_pos is at the opening quote
+            const size_t start = ++m_pos;
+            while (m_pos < m_text.size())
+            {
+                const char c = m_text[m_pos];
+                if (c == '"')
+                {
+                    m_string = m_text.substr(start, m_pos - start);
+                    ++m_pos;
+                    return true;
+                }
+
+                if (c == '\\')
+                {
+                    break;
+                }
+
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    return false;
+                }
+                ++m_pos;
+            }
+
+            if (m_pos == m_text.size())
+            {
+                return false;
+            }
+
+            // Slow path, the string has escapes
+            m_scratch.assign(m_text.substr(start, m_pos - start));
+            while (m_pos < m_text.size())
+            {
+                const char c = m_text[m_pos];
+                if (c == '"')
+                {
+                    m_string = m_scratch;
+                    ++m_pos;
+                    return true;
+                }
+
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    return false;
+                }
+
+                if (c != '\\')
+                {
+                    m_scratch.push_back(c);
+                    ++m_pos;
+                    continue;
+                }
+
+                if (++m_pos == m_text.size())
+                {
+                    return false;
+                }
+
+                switch (m_text[m_pos])
+                {
+                case '"':
+                    m_scratch.push_back('"');
+                    break;
+                case '\\':
+                    m_scratch.push_back('\\');
+                    break;
+                case '/':
+                    m_scratch.push_back('/');
+                    break;
+                case 'b':
+                    m_scratch.push_back('\b');
+                    break;
+                case 'f':
+                    m_scratch.push_back('\f');
+                    break;
+                case 'n':
+                    m_scratch.push_back('\n');
+                    break;
+                case 'r':
+                    m_scratch.push_back('\r');
+                    break;
+                case 't':
+                    m_scratch.push_back('\t');
+                    break;
+                case 'u':
+                {
+                    uint32_t codePoint = 0;
+                    if (!ParseUnicodeEscape(codePoint))
+                    {
+                        return false;
+                    }
+
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+                    {
+                        uint32_t low = 0;
+                        const bool hasLow = m_pos + 1 < m_text.size() && m_text[m_pos] == '\\' && m_text[m_pos + 1] == 'u';
+                        if (hasLow)
+                        {
+                            ++m_pos;
+                            if (!ParseUnicodeEscape(low))
+                            {
+                                return false;
+                            }
+                        }
+
+                        if (hasLow && low >= 0xDC00 && low <= 0xDFFF)
+                        {
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        else
+                        {
+                            // Unpaired high surrogate
+                            details::append_utf8(m_scratch, 0xFFFD);
+                            if (!hasLow)
+                            {
+                                continue;
+                            }
+                            codePoint = (low >= 0xD800 && low <= 0xDFFF) ? 0xFFFD : low;
+                        }
+                    }
+                    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+                    {
+                        codePoint = 0xFFFD;
+                    }
+
+                    details::append_utf8(m_scratch, codePoint);
+                    continue;
+                }
+                default:
+                    return false;
+                }
+                ++m_pos;
+            }
+
+            return false;
+        }
+
+        std::string_view m_text;
+        size_t m_pos = 0;
+
+        std::string_view m_string;
+        std::string m_scratch;
+        double m_number = 0;
+
+        // '{' or '[' for every open container
+        std::vector<char> m_stack;
+        bool m_afterKey = false;
+        bool m_afterValue = false;
+        bool m_needItem = false;
+        bool m_rootDone = false;
+        bool m_failed = false;
+    };
+
+    // Compact JSON writer with its own output buffer, flushed to the stream in large chunks.
+    // The writer tracks commas but does not validate the document structure.
+    class Writer
+    {
+    public:
+        static constexpr size_t FlushThreshold = 64 * 1024;
+
+        explicit Writer(std::ostream& output) :
+            m_output(output)
+        {
+            m_buffer.reserve(FlushThreshold + 1024);
+        }
+
+        ~Writer()
+        {
+            flush();
+        }
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void begin_object()
+        {
+            BeforeValue();
+            m_buffer.push_back('{');
+            m_first.push_back(true);
+        }
+
+        void end_object()
+        {
+            m_buffer.push_back('}');
+            m_first.pop_back();
+            MaybeFlush();
+        }
+
+        void begin_array()
+        {
+            BeforeValue();
+            m_buffer.push_back('[');
+            m_first.push_back(true);
+        }
+
+        void end_array()
+        {
+            m_buffer.push_back(']');
+            m_first.pop_back();
+            MaybeFlush();
+        }
+
+        template<typename Char>
+        void key(std::basic_string_view<Char> name)
+        {
+            BeforeValue();
+            AppendString(name);
+            m_buffer.push_back(':');
+            m_afterKey = true;
+        }
+
+        void key(const char* name) { key(std::string_view{ name }); }
+        void key(const wchar_t* name) { key(std::wstring_view{ name }); }
+
+        template<typename Char>
+        void value(std::basic_string_view<Char> text)
+        {
+            BeforeValue();
+            AppendString(text);
+            MaybeFlush();
+        }
+
+        void value(const char* text) { value(std::string_view{ text }); }
+        void value(const wchar_t* text) { value(std::wstring_view{ text }); }
+        void value(const std::string& text) { value(std::string_view{ text }); }
+        void value(const std::wstring& text) { value(std::wstring_view{ text }); }
+
+        void value(bool boolean)
+        {
+            BeforeValue();
+            m_buffer.append(boolean ? "true" : "false");
+        }
+
+        void value(int number) { value(static_cast<int64_t>(number)); }
+
+        void value(int64_t number)
+        {
+            BeforeValue();
+            char digits[24];
+            auto result = std::to_chars(std::begin(digits), std::end(digits), number);
+            m_buffer.append(digits, result.ptr);
+        }
+
+        void value(double number)
+        {
+            BeforeValue();
+            if (number != number || number == HUGE_VAL || number == -HUGE_VAL)
+            {
+                m_buffer.append("null");
+                return;
+            }
+
+            char digits[32];
+            auto result = std::to_chars(std::begin(digits), std::end(digits), number);
+            m_buffer.append(digits, result.ptr);
+        }
+
+        void null_value()
+        {
+            BeforeValue();
+            m_buffer.append("null");
+        }
+
+        // Writes everything buffered so far to the stream.
+        void flush()
+        {
+            if (!m_buffer.empty())
+            {
+                m_output.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+                m_buffer.clear();
+            }
+        }
+
+    private:
+        void BeforeValue()
+        {
+            if (m_afterKey)
+            {
+                m_afterKey = false;
+                return;
+            }
+
+            if (!m_first.empty())
+            {
+                if (!m_first.back())
+                {
+                    m_buffer.push_back(',');
+                }
+                m_first.back() = false;
+            }
+        }
+
+        void MaybeFlush()
+        {
+            if (m_buffer.size() >= FlushThreshold)
+            {
+                flush();
+            }
+        }
+
+        void AppendEscaped(uint32_t codePoint)
+        {
+            switch (codePoint)
+            {
+            case '"':
+                m_buffer.append("\\\"");
+                return;
+            case '\\':
+                m_buffer.append("\\\\");
+                return;
+            case '\b':
+                m_buffer.append("\\b");
+                return;
+            case '\f':
+                m_buffer.append("\\f");
+                return;
+            case '\n':
+                m_buffer.append("\\n");
+                return;
+            case '\r':
+                m_buffer.append("\\r");
+                return;
+            case '\t':
+                m_buffer.append("\\t");
+                return;
+            default:
+                break;
+            }
+
+            if (codePoint < 0x20)
+            {
+                static constexpr char hex[] = "0123456789abcdef";
+                m_buffer.append("\\u00");
+                m_buffer.push_back(hex[codePoint >> 4]);
+                m_buffer.push_back(hex[codePoint & 0xF]);
+            }
+            else
+            {
+                details::append_utf8(m_buffer, codePoint);
+            }
+        }
+
+        void AppendString(std::string_view text)
+        {
+            // UTF-8 input is copied as is, only the characters JSON requires are escaped
+            m_buffer.push_back('"');
+            size_t runStart = 0;
+            for (size_t i = 0; i < text.size(); ++i)
+            {
+                const auto c = static_cast<unsigned char>(text[i]);
+                if (c < 0x20 || c == '"' || c == '\\')
+                {
+                    m_buffer.append(text.data() + runStart, i - runStart);
+                    AppendEscaped(c);
+                    runStart = i + 1;
+                }
+            }
+            m_buffer.append(text.data() + runStart, text.size() - runStart);
+            m_buffer.push_back('"');
+        }
+
+        void AppendString(std::wstring_view text)
+        {
+            m_buffer.push_back('"');
+            for (size_t i = 0; i < text.size(); ++i)
+            {
+                uint32_t codePoint = static_cast<uint32_t>(text[i]);
+                if constexpr (sizeof(wchar_t) == 2)
+                {
+                    if (codePoint >= 0xD800 && codePoint <= 0xDBFF && i + 1 < text.size() && text[i + 1] >= 0xDC00 && text[i + 1] <= 0xDFFF)
+                    {
+                        codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (static_cast<uint32_t>(text[i + 1]) - 0xDC00);
+                        ++i;
+                    }
+                }
+
+                if (codePoint >= 0xD800 && codePoint <= 0xDFFF)
+                {
+                    codePoint = 0xFFFD;
+                }
+                AppendEscaped(codePoint);
+            }
+            m_buffer.push_back('"');
+        }
+
+        std::ostream& m_output;
+        std::string m_buffer;
+        std::vector<bool> m_first;
+        bool m_afterKey = false;
+    };
+
+    inline std::optional<std::string> read_file(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            return std::nullopt;
+        }
+
+        const auto size = file.tellg();
+        if (size < 0)
+        {
+            return std::nullopt;
+        }
+
+        std::string content(static_cast<size_t>(size), '\0');
+        file.seekg(0);
+        if (!file.read(content.data(), size))
+        {
+            return std::nullopt;
+        }
+        return content;
+    }
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <map>
 #include "resource.h"
 #include <common/logger/logger.h>
 #include <common/utils/logger_helper.h>
@@ -98,6 +99,119 @@ std::wstring get_text(const std::vector<ProcessResult>& results, IStringProvider
     return ss.str();
 }
 
+namespace
+{
+    constexpr DWORD WatchIntervalMs = 1000;
+
+    struct PollingProcessWatcher : IProcessWatcher
+    {
+        IProcessFinder& finder;
+        std::vector<std::wstring> paths;
+
+        PollingProcessWatcher(IProcessFinder& finder, const std::vector<std::wstring>& paths) :
+            finder(finder), paths(paths)
+        {
+        }
+
+        std::vector<ProcessResult> poll() override
+        {
+            return finder.find(paths);
+        }
+    };
+
+    // A file locked by a process, as reported by --watch
+    struct WatchedLock
+    {
+        std::wstring name;
+        std::wstring user;
+    };
+
+    using WatchedLocks = std::map<std::pair<DWORD, std::wstring>, WatchedLock>;
+
+    std::wstring get_watch_event(bool locked, DWORD pid, const std::wstring& file, const WatchedLock& lock, bool json_output, IStringProvider& strings)
+    {
+        if (json_output)
+        {
+            json::JsonObject event;
+            event.SetNamedValue(L"event", json::JsonValue::CreateStringValue(locked ? L"locked" : L"unlocked"));
+            event.SetNamedValue(L"pid", json::JsonValue::CreateNumberValue(pid));
+            event.SetNamedValue(L"name", json::JsonValue::CreateStringValue(lock.name));
+            event.SetNamedValue(L"user", json::JsonValue::CreateStringValue(lock.user));
+            event.SetNamedValue(L"file", json::JsonValue::CreateStringValue(file));
+            return std::wstring(event.Stringify().c_str()) + L"\n";
+        }
+
+        return FormatString(strings, locked ? IDS_WATCH_LOCKED : IDS_WATCH_UNLOCKED, pid, lock.name.c_str(), file.c_str());
+    }
+
+    // Polls the watcher and writes a line for each file that got locked or released, one JSON object per line with --json.
+    CommandResult watch_processes(const std::vector<std::wstring>& paths, bool json_output, int timeout_ms, IProcessFinder& finder, IOutputWriter& output, IStringProvider& strings)
+    {
+        std::wstring command_name = json_output ? L"watch-json" : L"watch";
+        if (!json_output)
+        {
+            output.write(strings.GetString(IDS_WATCHING));
+        }
+
+        auto watcher = finder.watch(paths);
+        WatchedLocks previous_locks;
+        auto start_time = std::chrono::steady_clock::now();
+
+        while (true)
+        {
+            WatchedLocks locks;
+            for (const auto& result : watcher->poll())
+            {
+                for (const auto& file : result.files)
+                {
+                    locks[{ result.pid, file }] = { result.name, result.user };
+                }
+            }
+
+            std::wstringstream ss;
+            for (const auto& [key, lock] : previous_locks)
+            {
+                if (!locks.contains(key))
+                {
+                    ss << get_watch_event(false, key.first, key.second, lock, json_output, strings);
+                }
+            }
+
+            for (const auto& [key, lock] : locks)
+            {
+                if (!previous_locks.contains(key))
+                {
+                    ss << get_watch_event(true, key.first, key.second, lock, json_output, strings);
+                }
+            }
+
+            if (auto events = ss.str(); !events.empty())
+            {
+                output.write(events);
+            }
+
+            previous_locks = std::move(locks);
+
+            if (timeout_ms >= 0)
+            {
+                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+                if (elapsed >= timeout_ms)
+                {
+                    Logger::info("Watch timeout reached");
+                    return { 0, L"", command_name };
+                }
+            }
+
+            Sleep(WatchIntervalMs);
+        }
+    }
+}
+
+std::unique_ptr<IProcessWatcher> IProcessFinder::watch(const std::vector<std::wstring>& paths)
+{
+    return std::make_unique<PollingProcessWatcher>(*this, paths);
+}
+
 std::wstring kill_processes(const std::vector<ProcessResult>& results, IProcessTerminator& terminator, IStringProvider& strings)
 {
     std::wstringstream ss;
@@ -115,7 +229,7 @@ std::wstring kill_processes(const std::vector<ProcessResult>& results, IProcessT
     return ss.str();
 }
 
-CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IProcessTerminator& terminator, IStringProvider& strings)
+CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IProcessTerminator& terminator, IStringProvider& strings, IOutputWriter* output)
 {
     Logger::info("Parsing arguments");
     if (argc < 2)
@@ -127,6 +241,7 @@ CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IPr
     bool json_output = false;
     bool kill = false;
     bool wait = false;
+    bool watch = false;
     int timeout_ms = -1;
     std::vector<std::wstring> paths;
 
@@ -145,6 +260,10 @@ CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IPr
         {
             wait = true;
         }
+        else if (arg == L"--watch")
+        {
+            watch = true;
+        }
         else if (arg == L"--timeout")
         {
             if (i + 1 < argc)
@@ -183,6 +302,23 @@ CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IPr
 
     Logger::info("Processing {} paths", paths.size());
 
+    if (watch)
+    {
+        if (kill || wait)
+        {
+            Logger::error("Watch can't be combined with kill or wait");
+            return { 1, strings.GetString(IDS_ERROR_WATCH_ARGS), L"watch" };
+        }
+
+        if (!output)
+        {
+            Logger::error("No output for watch");
+            return { 1, L"", L"watch" };
+        }
+
+        return watch_processes(paths, json_output, timeout_ms, finder, *output, strings);
+    }
+
     if (wait)
     {
         std::wstringstream ss;
@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <memory>
 #include "FileLocksmithLib/FileLocksmith.h"
 #include <Windows.h>
 
@@ -11,9 +12,19 @@ struct CommandResult
     std::wstring command_name;
 };
 
+struct IProcessWatcher
+{
+    virtual std::vector<ProcessResult> poll() = 0;
+    virtual ~IProcessWatcher() = default;
+};
+
 struct IProcessFinder
 {
     virtual std::vector<ProcessResult> find(const std::vector<std::wstring>& paths) = 0;
+
+    // Starts watching the paths. By default, every poll is a new search.
+    virtual std::unique_ptr<IProcessWatcher> watch(const std::vector<std::wstring>& paths);
+
     virtual ~IProcessFinder() = default;
 };
 
@@ -29,4 +40,11 @@ struct IStringProvider
     virtual ~IStringProvider() = default;
 };
 
-CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IProcessTerminator& terminator, IStringProvider& strings);
+// Receives the output of --watch while the command runs
+struct IOutputWriter
+{
+    virtual void write(const std::wstring& text) = 0;
+    virtual ~IOutputWriter() = default;
+};
+
+CommandResult run_command(int argc, wchar_t* argv[], IProcessFinder& finder, IProcessTerminator& terminator, IStringProvider& strings, IOutputWriter* output = nullptr);
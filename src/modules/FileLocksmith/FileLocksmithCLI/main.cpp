@@ -7,12 +7,32 @@
 #include <common/logger/logger.h>
 #include <common/utils/logger_helper.h>
 
+struct RealProcessWatcher : IProcessWatcher
+{
+    LockWatcher watcher;
+
+    explicit RealProcessWatcher(const std::vector<std::wstring>& paths) :
+        watcher(paths)
+    {
+    }
+
+    std::vector<ProcessResult> poll() override
+    {
+        return watcher.poll();
+    }
+};
+
 struct RealProcessFinder : IProcessFinder
 {
     std::vector<ProcessResult> find(const std::vector<std::wstring>& paths) override
     {
         return find_processes_recursive(paths);
     }
+
+    std::unique_ptr<IProcessWatcher> watch(const std::vector<std::wstring>& paths) override
+    {
+        return std::make_unique<RealProcessWatcher>(paths);
+    }
 };
 
 struct RealProcessTerminator : IProcessTerminator
@@ -44,6 +64,14 @@ struct RealStringProvider : IStringProvider
     }
 };
 
+struct ConsoleOutputWriter : IOutputWriter
+{
+    void write(const std::wstring& text) override
+    {
+        std::wcout << text << std::flush;
+    }
+};
+
 #ifndef UNIT_TEST
 int wmain(int argc, wchar_t* argv[])
 {
@@ -55,8 +83,9 @@ int wmain(int argc, wchar_t* argv[])
     RealProcessFinder finder;
     RealProcessTerminator terminator;
     RealStringProvider strings;
+    ConsoleOutputWriter output;
 
-    auto result = run_command(argc, argv, finder, terminator, strings);
+    auto result = run_command(argc, argv, finder, terminator, strings, &output);
 
     if (result.exit_code != 0)
     {
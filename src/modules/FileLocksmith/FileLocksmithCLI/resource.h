@@ -14,3 +14,7 @@
 #define IDS_TIMEOUT                     111
 #define IDS_ERROR_INVALID_TIMEOUT       112
 #define IDS_ERROR_TIMEOUT_ARG           113
+#define IDS_WATCHING                    114
+#define IDS_WATCH_LOCKED                115
+#define IDS_WATCH_UNLOCKED              116
+#define IDS_ERROR_WATCH_ARGS            117
@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "CppUnitTest.h"
 #include "../CLILogic.h"
+#include "../resource.h"
 #include <map>
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -17,6 +18,39 @@ namespace FileLocksmithCLIUnitTests
         }
     };
 
+    // Returns the scripted results one poll after the other, then keeps returning the last ones
+    struct MockProcessWatcher : IProcessWatcher
+    {
+        std::vector<std::vector<ProcessResult>> polls;
+        size_t poll_count = 0;
+        std::vector<ProcessResult> poll() override
+        {
+            auto index = std::min(poll_count++, polls.size() - 1);
+            return polls[index];
+        }
+    };
+
+    struct MockWatchingProcessFinder : MockProcessFinder
+    {
+        std::vector<std::vector<ProcessResult>> polls;
+        std::unique_ptr<IProcessWatcher> watch(const std::vector<std::wstring>& paths) override
+        {
+            (void)paths;
+            auto watcher = std::make_unique<MockProcessWatcher>();
+            watcher->polls = polls;
+            return watcher;
+        }
+    };
+
+    struct MockOutputWriter : IOutputWriter
+    {
+        std::wstring text;
+        void write(const std::wstring& output) override
+        {
+            text += output;
+        }
+    };
+
     struct MockProcessTerminator : IProcessTerminator
     {
         bool shouldSucceed = true;
@@ -132,5 +166,75 @@ namespace FileLocksmithCLIUnitTests
             Assert::AreEqual(1, result.exit_code);
             Assert::AreEqual(std::wstring(L"query-wait"), result.command_name);
         }
+
+        TEST_METHOD(TestWatch)
+        {
+            MockProcessFinder finder;
+            finder.results = { { L"process", 123, L"user", { L"file1" } } };
+            MockProcessTerminator terminator;
+            MockStringProvider strings;
+            strings.strings[IDS_WATCH_LOCKED] = L"Locked %1!d! %2 %3";
+            MockOutputWriter output;
+
+            wchar_t* argv[] = { (wchar_t*)L"exe", (wchar_t*)L"file1", (wchar_t*)L"--watch", (wchar_t*)L"--timeout", (wchar_t*)L"0" };
+            auto result = run_command(5, argv, finder, terminator, strings, &output);
+
+            Assert::AreEqual(0, result.exit_code);
+            Assert::AreEqual(std::wstring(L"watch"), result.command_name);
+            Assert::IsTrue(output.text.find(L"Locked 123 process file1") != std::wstring::npos);
+        }
+
+        TEST_METHOD(TestWatchReportsChanges)
+        {
+            MockWatchingProcessFinder finder;
+            finder.polls = {
+                { { L"process", 123, L"user", { L"file1" } } },
+                { { L"other", 456, L"user", { L"file1" } } },
+            };
+            MockProcessTerminator terminator;
+            MockStringProvider strings;
+            strings.strings[IDS_WATCH_LOCKED] = L"Locked %1!d!;";
+            strings.strings[IDS_WATCH_UNLOCKED] = L"Unlocked %1!d!;";
+            MockOutputWriter output;
+
+            // Long enough for the first poll only, the second one comes after the watch interval
+            wchar_t* argv[] = { (wchar_t*)L"exe", (wchar_t*)L"file1", (wchar_t*)L"--watch", (wchar_t*)L"--timeout", (wchar_t*)L"500" };
+            auto result = run_command(5, argv, finder, terminator, strings, &output);
+
+            Assert::AreEqual(0, result.exit_code);
+            Assert::AreEqual(std::wstring(L"String_114Locked 123;Unlocked 123;Locked 456;"), output.text);
+        }
+
+        TEST_METHOD(TestWatchJsonOutput)
+        {
+            MockProcessFinder finder;
+            finder.results = { { L"process", 123, L"user", { L"file1" } } };
+            MockProcessTerminator terminator;
+            MockStringProvider strings;
+            MockOutputWriter output;
+
+            wchar_t* argv[] = { (wchar_t*)L"exe", (wchar_t*)L"file1", (wchar_t*)L"--watch", (wchar_t*)L"--json", (wchar_t*)L"--timeout", (wchar_t*)L"0" };
+            auto result = run_command(6, argv, finder, terminator, strings, &output);
+
+            Assert::AreEqual(0, result.exit_code);
+            Assert::AreEqual(std::wstring(L"watch-json"), result.command_name);
+            Assert::IsTrue(output.text.find(L"\"event\":\"locked\"") != std::wstring::npos);
+            Assert::IsTrue(output.text.find(L"\"pid\":123") != std::wstring::npos);
+        }
+
+        TEST_METHOD(TestWatchWithKill)
+        {
+            MockProcessFinder finder;
+            MockProcessTerminator terminator;
+            MockStringProvider strings;
+            MockOutputWriter output;
+
+            wchar_t* argv[] = { (wchar_t*)L"exe", (wchar_t*)L"file1", (wchar_t*)L"--watch", (wchar_t*)L"--kill" };
+            auto result = run_command(4, argv, finder, terminator, strings, &output);
+
+            Assert::AreEqual(1, result.exit_code);
+            Assert::AreEqual(std::wstring(L"watch"), result.command_name);
+            Assert::IsTrue(terminator.terminatedPids.empty());
+        }
     };
 }
@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "FileLocksmithLib/FileLocksmith.h"
+#include <algorithm>
+#include <filesystem>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FileLocksmithCLIUnitTests
+{
+    // Scans the real handle table, with a file held open by the test process
+    TEST_CLASS(FindProcessesTests)
+    {
+        std::filesystem::path folder;
+        HANDLE file = INVALID_HANDLE_VALUE;
+
+        const ProcessResult* find_own_process(const std::vector<ProcessResult>& results)
+        {
+            auto it = std::find_if(results.begin(), results.end(), [](const ProcessResult& result) { return result.pid == GetCurrentProcessId(); });
+            return it != results.end() ? &*it : nullptr;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(CreateLockedFile)
+        {
+            folder = std::filesystem::temp_directory_path() / (L"FileLocksmithTests_" + std::to_wstring(GetCurrentProcessId()));
+            std::filesystem::create_directories(folder / L"sub");
+            file = CreateFileW((folder / L"sub" / L"locked.txt").c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, NULL);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+        }
+
+        TEST_METHOD_CLEANUP(DeleteLockedFile)
+        {
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file);
+            }
+
+            std::error_code error;
+            std::filesystem::remove_all(folder, error);
+        }
+
+        TEST_METHOD(TestFindsOpenFile)
+        {
+            auto path = (folder / L"sub" / L"locked.txt").wstring();
+            auto results = find_processes_recursive({ path });
+
+            auto own_process = find_own_process(results);
+            Assert::IsNotNull(own_process);
+            Assert::IsTrue(std::find(own_process->files.begin(), own_process->files.end(), path) != own_process->files.end());
+        }
+
+        TEST_METHOD(TestFindsFileWithinFolder)
+        {
+            auto results = find_processes_recursive({ folder.wstring() });
+
+            auto own_process = find_own_process(results);
+            Assert::IsNotNull(own_process);
+            Assert::IsTrue(std::find(own_process->files.begin(), own_process->files.end(), (folder / L"sub" / L"locked.txt").wstring()) != own_process->files.end());
+        }
+
+        TEST_METHOD(TestClosedFileIsNotReported)
+        {
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+
+            auto results = find_processes_recursive({ folder.wstring() });
+            Assert::IsNull(find_own_process(results));
+        }
+
+        TEST_METHOD(TestWatcherFollowsHandles)
+        {
+            LockWatcher watcher({ folder.wstring() });
+            Assert::IsNotNull(find_own_process(watcher.poll()));
+
+            CloseHandle(file);
+            file = INVALID_HANDLE_VALUE;
+            Assert::IsNull(find_own_process(watcher.poll()));
+
+            auto path = (folder / L"other.txt").wstring();
+            file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, 0, NULL);
+            auto own_process = find_own_process(watcher.poll());
+            Assert::IsNotNull(own_process);
+            Assert::IsTrue(std::find(own_process->files.begin(), own_process->files.end(), path) != own_process->files.end());
+        }
+    };
+}
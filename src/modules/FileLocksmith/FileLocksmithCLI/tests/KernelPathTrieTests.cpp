@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "CppUnitTest.h"
+#include "FileLocksmithLibInterop/KernelPathTrie.h"
+#include <chrono>
+#include <map>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FileLocksmithCLIUnitTests
+{
+    // The matching find_processes_recursive did before the trie: exact lookups,
+    // then a prefix comparison against every selected directory.
+    struct LinearMatcher
+    {
+        std::map<std::wstring, std::wstring> files;
+        std::map<std::wstring, std::wstring> dirs;
+
+        std::wstring find(const std::wstring& kernel_name) const
+        {
+            if (auto it = files.find(kernel_name); it != files.end())
+            {
+                return it->second;
+            }
+
+            if (auto it = dirs.find(kernel_name); it != dirs.end())
+            {
+                return it->second;
+            }
+
+            for (const auto& [dir_kernel_name, dir_path] : dirs)
+            {
+                auto prefix = dir_kernel_name + (dir_kernel_name.back() != L'\\' ? L"\\" : L"");
+                if (kernel_name.starts_with(prefix))
+                {
+                    return dir_path + kernel_name.substr(dir_kernel_name.size());
+                }
+            }
+
+            return {};
+        }
+    };
+
+    // Synthetic selection and handle table: `dir_count` selected folders spread over a
+    // volume, and `handle_count` file handles, some of them within the selected folders.
+    struct SyntheticHandleTable
+    {
+        KernelPathTrie trie;
+        LinearMatcher linear;
+        std::vector<std::wstring> handles;
+
+        SyntheticHandleTable(size_t dir_count, size_t handle_count, unsigned seed)
+        {
+            std::mt19937 generator(seed);
+            std::uniform_int_distribution<int> component(0, 63);
+            std::uniform_int_distribution<int> depth(1, 8);
+
+            auto random_path = [&](const std::wstring& root, int components) {
+                std::wstring path = root;
+                for (int i = 0; i < components; i++)
+                {
+                    path += L"\\dir" + std::to_wstring(component(generator));
+                }
+                return path;
+            };
+
+            std::vector<std::wstring> selected_dirs;
+            for (size_t i = 0; i < dir_count; i++)
+            {
+                auto kernel_name = random_path(L"\\Device\\HarddiskVolume3\\build", depth(generator) / 2 + 1);
+                auto path = L"C:" + kernel_name.substr(std::wstring(L"\\Device\\HarddiskVolume3").size());
+                trie.insert_directory(kernel_name, path);
+                linear.dirs[kernel_name] = path;
+                selected_dirs.push_back(std::move(kernel_name));
+            }
+
+            handles.reserve(handle_count);
+            for (size_t i = 0; i < handle_count; i++)
+            {
+                switch (i % 4)
+                {
+                case 0:
+                    handles.push_back(random_path(selected_dirs[i % selected_dirs.size()], depth(generator) / 2) + L"\\file.obj");
+                    break;
+                case 1:
+                    handles.push_back(random_path(L"\\Device\\HarddiskVolume3\\build", depth(generator)) + L"\\file.pdb");
+                    break;
+                case 2:
+                    handles.push_back(random_path(L"\\Device\\HarddiskVolume3\\Windows\\System32", depth(generator)) + L"\\module.dll");
+                    break;
+                default:
+                    handles.push_back(random_path(L"\\Device\\NamedPipe", 1));
+                    break;
+                }
+            }
+        }
+    };
+
+    TEST_CLASS(KernelPathTrieTests)
+    {
+    public:
+        TEST_METHOD(TestExactMatches)
+        {
+            KernelPathTrie trie;
+            trie.insert_file(L"\\Device\\HarddiskVolume3\\a\\file.txt", L"C:\\a\\file.txt");
+            trie.insert_directory(L"\\Device\\HarddiskVolume3\\b", L"C:\\b");
+
+            Assert::AreEqual(std::wstring(L"C:\\a\\file.txt"), trie.find(L"\\Device\\HarddiskVolume3\\a\\file.txt"));
+            Assert::AreEqual(std::wstring(L"C:\\b"), trie.find(L"\\Device\\HarddiskVolume3\\b"));
+            Assert::AreEqual(std::wstring(), trie.find(L"\\Device\\HarddiskVolume3\\a\\file.txt\\x"));
+            Assert::AreEqual(std::wstring(), trie.find(L"\\Device\\HarddiskVolume3\\a"));
+            Assert::AreEqual(std::wstring(), trie.find(L""));
+        }
+
+        TEST_METHOD(TestDirectoryContents)
+        {
+            KernelPathTrie trie;
+            trie.insert_directory(L"\\Device\\HarddiskVolume3\\src", L"C:\\src");
+
+            Assert::AreEqual(std::wstring(L"C:\\src\\x\\y.cpp"), trie.find(L"\\Device\\HarddiskVolume3\\src\\x\\y.cpp"));
+            // Only whole components match
+            Assert::AreEqual(std::wstring(), trie.find(L"\\Device\\HarddiskVolume3\\src2\\y.cpp"));
+        }
+
+        TEST_METHOD(TestRootDirectory)
+        {
+            KernelPathTrie trie;
+            trie.insert_directory(L"\\Device\\HarddiskVolume3\\", L"C:\\");
+
+            Assert::AreEqual(std::wstring(L"C:\\"), trie.find(L"\\Device\\HarddiskVolume3\\"));
+            Assert::AreEqual(std::wstring(L"C:\\x\\y.cpp"), trie.find(L"\\Device\\HarddiskVolume3\\x\\y.cpp"));
+            Assert::AreEqual(std::wstring(), trie.find(L"\\Device\\HarddiskVolume4\\x\\y.cpp"));
+        }
+
+        TEST_METHOD(TestNestedDirectoriesUseOutermost)
+        {
+            KernelPathTrie trie;
+            trie.insert_directory(L"\\Device\\HarddiskVolume3\\a\\b", L"C:\\a\\b");
+            trie.insert_directory(L"\\Device\\HarddiskVolume3\\a", L"C:\\A");
+
+            Assert::AreEqual(std::wstring(L"C:\\A\\b\\c.txt"), trie.find(L"\\Device\\HarddiskVolume3\\a\\b\\c.txt"));
+            // An exact match wins over the containing directory
+            Assert::AreEqual(std::wstring(L"C:\\a\\b"), trie.find(L"\\Device\\HarddiskVolume3\\a\\b"));
+        }
+
+        TEST_METHOD(TestMatchesLinearMatcher)
+        {
+            SyntheticHandleTable table(200, 20000, 42);
+            table.trie.insert_file(table.handles[1], L"C:\\file.pdb");
+            table.linear.files[table.handles[1]] = L"C:\\file.pdb";
+
+            size_t matches = 0;
+            for (const auto& handle : table.handles)
+            {
+                auto expected = table.linear.find(handle);
+                Assert::AreEqual(expected, table.trie.find(handle));
+                matches += !expected.empty();
+            }
+
+            Assert::IsTrue(matches >= table.handles.size() / 4);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(BenchmarkHandleMatching)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD(BenchmarkHandleMatching)
+        {
+            for (size_t dir_count : { 10, 100, 500 })
+            {
+                SyntheticHandleTable table(dir_count, 500000, 7);
+
+                auto measure = [&](auto&& find) {
+                    size_t matches = 0;
+                    auto start = std::chrono::steady_clock::now();
+                    for (const auto& handle : table.handles)
+                    {
+                        matches += !find(handle).empty();
+                    }
+                    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+                    return std::make_pair(elapsed.count(), matches);
+                };
+
+                auto [trie_ms, trie_matches] = measure([&](const std::wstring& handle) { return table.trie.find(handle); });
+                auto [linear_ms, linear_matches] = measure([&](const std::wstring& handle) { return table.linear.find(handle); });
+                Assert::AreEqual(linear_matches, trie_matches);
+
+                auto message = std::to_wstring(dir_count) + L" directories, " + std::to_wstring(table.handles.size()) + L" handles: trie " +
+                               std::to_wstring(trie_ms) + L" ms, linear " + std::to_wstring(linear_ms) + L" ms";
+                Logger::WriteMessage(message.c_str());
+            }
+        }
+    };
+}
@@ -1,6 +1,23 @@
 #pragma once
 
 #include "ProcessResult.h"
+#include <memory>
+
+// Keeps the result of find_processes_recursive up to date over repeated polls.
+// Handles and processes seen by a previous poll aren't resolved again, only new ones are.
+class LockWatcher
+{
+public:
+    explicit LockWatcher(const std::vector<std::wstring>& paths);
+    ~LockWatcher();
+
+    // Scans the system for processes using the paths, or the files and folders within them.
+    std::vector<ProcessResult> poll();
+
+private:
+    struct State;
+    std::unique_ptr<State> m_state;
+};
 
 // Second version, checks handles towards files and all subfiles and folders of given dirs, if any.
 std::vector<ProcessResult> find_processes_recursive(const std::vector<std::wstring>& paths);
@@ -2,6 +2,7 @@
 
 #include "FileLocksmith.h"
 #include "NtdllExtensions.h"
+#include "KernelPathTrie.h"
 
 static bool is_directory(const std::wstring path)
 {
@@ -9,102 +10,143 @@ static bool is_directory(const std::wstring path)
     return attributes != INVALID_FILE_ATTRIBUTES && attributes & FILE_ATTRIBUTE_DIRECTORY;
 }
 
-// C++20 method
-static constexpr bool starts_with(std::wstring_view whole, std::wstring_view part)
-{
-    return whole.size() >= part.size() && whole.substr(0, part.size()) == part;
-}
-
-std::vector<ProcessResult> find_processes_recursive(const std::vector<std::wstring>& paths)
+struct LockWatcher::State
 {
     NtdllExtensions nt_ext;
 
-    // TODO use a trie!
+    // Kernel names of files and directories within `paths`, mapped to their normal paths.
+    KernelPathTrie kernel_paths;
 
-    // This maps kernel names of files within `paths` to their normal paths.
-    std::map<std::wstring, std::wstring> kernel_names_files;
+    // Handles seen by the last poll, with the path they matched or an empty string.
+    std::map<NtdllExtensions::HandleKey, std::wstring> handle_paths;
 
-    // This maps kernel names of directories within `paths` to their normal paths.
-    std::map<std::wstring, std::wstring> kernel_names_dirs;
+    struct Process
+    {
+        ULONGLONG create_time = 0;
+        std::wstring name;
+        std::wstring user;
 
+        // Modules of the process that match the search criteria, kept until the process exits.
+        std::vector<std::wstring> module_paths;
+    };
+
+    std::map<DWORD, Process> processes;
+};
+
+LockWatcher::LockWatcher(const std::vector<std::wstring>& paths) :
+    m_state(std::make_unique<State>())
+{
     for (const auto& path : paths)
     {
-        auto kernel_path = nt_ext.path_to_kernel_name(path.c_str());
+        auto kernel_path = m_state->nt_ext.path_to_kernel_name(path.c_str());
         if (!kernel_path.empty())
         {
-            (is_directory(path) ? kernel_names_dirs : kernel_names_files)[kernel_path] = path;
+            if (is_directory(path))
+            {
+                m_state->kernel_paths.insert_directory(kernel_path, path);
+            }
+            else
+            {
+                m_state->kernel_paths.insert_file(kernel_path, path);
+            }
         }
     }
+}
 
-    std::map<ULONG_PTR, std::set<std::wstring>> pid_files;
+LockWatcher::~LockWatcher() = default;
 
-    // Returns a normal path of the file specified by kernel_name, if it matches
-    // the search criteria. Otherwise, return an empty string.
-    auto kernel_paths_contain = [&](const std::wstring& kernel_name) -> std::wstring
-    {
-        // Normal equivalence
-        if (auto it = kernel_names_files.find(kernel_name); it != kernel_names_files.end())
-        {
-            return it->second;
-        }
+std::vector<ProcessResult> LockWatcher::poll()
+{
+    auto& nt_ext = m_state->nt_ext;
+    auto& kernel_paths = m_state->kernel_paths;
 
-        if (auto it = kernel_names_dirs.find(kernel_name); it != kernel_names_dirs.end())
-        {
-            return it->second;
-        }
+    // Handles which are still open keep their path, only new handles are resolved.
+    // Handles which weren't seen again were closed, together with those of exited processes.
+    std::map<NtdllExtensions::HandleKey, std::wstring> handle_paths;
 
-        for (const auto& [dir_kernel_name, dir_path] : kernel_names_dirs)
+    auto is_new_handle = [&](const NtdllExtensions::HandleKey& key) {
+        // Without the object address, a handle value which was closed and reused for another
+        // file has the same key, so these handles are resolved on every poll.
+        if (key.object != 0)
         {
-            if (starts_with(kernel_name, dir_kernel_name + (dir_kernel_name.length()>0&&dir_kernel_name[dir_kernel_name.length()-1]!=L'\\' ? L"\\" : L"")))
+            if (auto node = m_state->handle_paths.extract(key))
             {
-                return dir_path + kernel_name.substr(dir_kernel_name.size());
+                handle_paths.insert(std::move(node));
+                return false;
             }
         }
 
-        return {};
+        // Handles which can't be resolved aren't tried again.
+        handle_paths.emplace(key, std::wstring{});
+        return true;
     };
 
-    for (const auto& handle_info : nt_ext.handles())
+    // File handles are matched as they are resolved.
+    nt_ext.handles(
+        [&](NtdllExtensions::HandleInfo&& handle_info) {
+            handle_paths[handle_info.key()] = kernel_paths.find(handle_info.kernel_file_name);
+        },
+        is_new_handle);
+
+    m_state->handle_paths = std::move(handle_paths);
+
+    std::map<ULONG_PTR, std::set<std::wstring>> pid_files;
+    for (const auto& [key, path] : m_state->handle_paths)
     {
-        if (handle_info.type_name == L"File")
+        if (!path.empty())
         {
-            auto path = kernel_paths_contain(handle_info.kernel_file_name);
-            if (!path.empty())
-            {
-                pid_files[handle_info.pid].insert(std::move(path));
-            }
+            pid_files[key.pid].insert(path);
         }
     }
 
-    // Check all modules used by processes
-    auto processes = nt_ext.processes();
+    // Check all modules used by processes. They are only enumerated for processes which weren't seen before.
+    auto process_list = nt_ext.process_list();
+    std::map<DWORD, State::Process> processes;
 
-    for (const auto& process : processes)
+    for (const auto& process_info : process_list)
     {
-        for (const auto& path : process.modules)
+        // A different creation time means the process exited and its pid was reused,
+        // possibly by another instance of the same executable.
+        auto it = m_state->processes.find(process_info.pid);
+        if (it != m_state->processes.end() && it->second.create_time == process_info.create_time)
+        {
+            processes.insert(m_state->processes.extract(it));
+            continue;
+        }
+
+        State::Process process{ process_info.create_time, process_info.name, nt_ext.pid_to_user(process_info.pid) };
+        for (const auto& path : nt_ext.pid_to_modules(process_info.pid))
         {
             auto kernel_name = nt_ext.path_to_kernel_name(path.c_str());
 
-            auto found_path = kernel_paths_contain(kernel_name);
+            auto found_path = kernel_paths.find(kernel_name);
             if (!found_path.empty())
             {
-                pid_files[process.pid].insert(std::move(found_path));
+                process.module_paths.push_back(std::move(found_path));
             }
         }
+
+        processes[process_info.pid] = std::move(process);
     }
 
+    m_state->processes = std::move(processes);
+
     std::vector<ProcessResult> result;
 
-    for (const auto& process_info : processes)
+    for (const auto& process_info : process_list)
     {
-        if (auto it = pid_files.find(process_info.pid); it != pid_files.end())
+        const auto& process = m_state->processes[process_info.pid];
+        auto& files = pid_files[process_info.pid];
+        files.insert(process.module_paths.begin(), process.module_paths.end());
+
+        if (!files.empty())
         {
             result.push_back(ProcessResult
                 {
-                    process_info.name,
+                    process.name,
                     process_info.pid,
-                    process_info.user,
-                    std::vector(it->second.begin(), it->second.end())
+                    process.user,
+                    std::vector(files.begin(), files.end())
                 });
         }
     }
@@ -112,6 +154,11 @@ std::vector<ProcessResult> find_processes_recursive(const std::vector<std::wstri
     return result;
 }
 
+std::vector<ProcessResult> find_processes_recursive(const std::vector<std::wstring>& paths)
+{
+    return LockWatcher(paths).poll();
+}
+
 constexpr size_t LongMaxPathSize = 65536;
 
 std::wstring pid_to_full_path(DWORD pid)
@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#include "KernelPathTrie.h"
+
+size_t KernelPathTrie::add_node(std::wstring_view name)
+{
+    size_t node = 0;
+    size_t start = 0;
+
+    while (true)
+    {
+        auto end = name.find(L'\\', start);
+        auto component = name.substr(start, end == std::wstring_view::npos ? std::wstring_view::npos : end - start);
+
+        if (auto it = m_nodes[node].children.find(component); it != m_nodes[node].children.end())
+        {
+            node = it->second;
+        }
+        else
+        {
+            // Add the child before growing the vector, `m_nodes[node]` may move.
+            auto child = m_nodes.size();
+            m_nodes[node].children.emplace(component, child);
+            m_nodes.emplace_back();
+            node = child;
+        }
+
+        if (end == std::wstring_view::npos)
+        {
+            return node;
+        }
+
+        start = end + 1;
+    }
+}
+
+void KernelPathTrie::insert_file(std::wstring_view kernel_name, const std::wstring& path)
+{
+    if (kernel_name.empty())
+    {
+        return;
+    }
+
+    m_nodes[add_node(kernel_name)].file_path = path;
+}
+
+void KernelPathTrie::insert_directory(std::wstring_view kernel_name, const std::wstring& path)
+{
+    if (kernel_name.empty())
+    {
+        return;
+    }
+
+    m_nodes[add_node(kernel_name)].dir_path = path;
+
+    // The contents of the directory are the names continuing with a '\' after it.
+    // A kernel name of a root directory already ends with one.
+    auto contents_name = kernel_name;
+    if (contents_name.back() == L'\\')
+    {
+        contents_name.remove_suffix(1);
+    }
+
+    // "\Device\X" and "\Device\X\" end at the same node, prefer the shorter one.
+    auto& node = m_nodes[add_node(contents_name)];
+    if (node.contents_path.empty() || kernel_name.size() <= node.contents_kernel_name_length)
+    {
+        node.contents_path = path;
+        node.contents_kernel_name_length = kernel_name.size();
+    }
+}
+
+std::wstring KernelPathTrie::find(std::wstring_view kernel_name) const
+{
+    // The outermost selected directory containing the file
+    const Node* contents = nullptr;
+    const Node* node = &m_nodes[0];
+    size_t start = 0;
+
+    while (node)
+    {
+        auto end = kernel_name.find(L'\\', start);
+        auto component = kernel_name.substr(start, end == std::wstring_view::npos ? std::wstring_view::npos : end - start);
+
+        auto it = node->children.find(component);
+        node = it != node->children.end() ? &m_nodes[it->second] : nullptr;
+
+        if (!node || end == std::wstring_view::npos)
+        {
+            break;
+        }
+
+        if (!contents && !node->contents_path.empty())
+        {
+            contents = node;
+        }
+
+        start = end + 1;
+    }
+
+    // Normal equivalence
+    if (node && !node->file_path.empty())
+    {
+        return node->file_path;
+    }
+
+    if (node && !node->dir_path.empty())
+    {
+        return node->dir_path;
+    }
+
+    if (contents)
+    {
+        return contents->contents_path + std::wstring(kernel_name.substr(contents->contents_kernel_name_length));
+    }
+
+    return {};
+}
+
+bool KernelPathTrie::empty() const
+{
+    return m_nodes.size() == 1;
+}
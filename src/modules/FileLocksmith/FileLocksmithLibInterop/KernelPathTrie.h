@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Matches kernel file names against the selected files and directories.
+// Kernel names are split on '\' and stored component by component, so a lookup
+// walks the trie once along the name instead of comparing it with every selected directory.
+class KernelPathTrie
+{
+private:
+    struct Node
+    {
+        // Children by path component. std::less<> allows lookups by std::wstring_view.
+        std::map<std::wstring, size_t, std::less<>> children;
+
+        // Normal path of a selected file or directory with exactly this kernel name.
+        std::wstring file_path;
+        std::wstring dir_path;
+
+        // Normal path of a selected directory whose contents end here, and the length of its kernel name.
+        std::wstring contents_path;
+        size_t contents_kernel_name_length = 0;
+    };
+
+    // Node 0 is the root, children refer to the other nodes by index.
+    std::vector<Node> m_nodes = std::vector<Node>(1);
+
+    size_t add_node(std::wstring_view name);
+
+public:
+    void insert_file(std::wstring_view kernel_name, const std::wstring& path);
+
+    void insert_directory(std::wstring_view kernel_name, const std::wstring& path);
+
+    // Returns a normal path of the file specified by kernel_name, if it is one of the
+    // selected files or directories or is within a selected directory.
+    // Otherwise, returns an empty string.
+    std::wstring find(std::wstring_view kernel_name) const;
+
+    bool empty() const;
+};
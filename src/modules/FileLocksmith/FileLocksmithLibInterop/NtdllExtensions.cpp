@@ -3,6 +3,7 @@
 #include "NtdllExtensions.h"
 #include <thread>
 #include <atomic>
+#include <mutex>
 
 #define STATUS_INFO_LENGTH_MISMATCH ((LONG)0xC0000004)
 
@@ -40,6 +41,32 @@ namespace
 
     constexpr size_t DefaultModulesResultSize = 512;
 
+    // winternl.h hides CreateTime in Reserved1. It follows WorkingSetPrivateSize, HardFaultCount,
+    // NumberOfThreadsHighWatermark and CycleTime in the native SYSTEM_PROCESS_INFORMATION.
+    constexpr size_t ProcessCreateTimeOffset = 24;
+    static_assert(sizeof(SYSTEM_PROCESS_INFORMATION::Reserved1) >= ProcessCreateTimeOffset + sizeof(ULONGLONG));
+
+    ULONGLONG process_create_time(const SYSTEM_PROCESS_INFORMATION& info)
+    {
+        ULONGLONG create_time;
+        memcpy(&create_time, info.Reserved1 + ProcessCreateTimeOffset, sizeof(create_time));
+        return create_time;
+    }
+
+    // ObjectTypeIndex is a USHORT, so this is never a valid index.
+    constexpr ULONG UnknownObjectTypeIndex = ULONG_MAX;
+
+    HANDLE open_own_executable()
+    {
+        wchar_t path[MAX_PATH + 1];
+        if (!GetModuleFileNameW(NULL, path, MAX_PATH + 1) || GetLastError() == ERROR_INSUFFICIENT_BUFFER)
+        {
+            return INVALID_HANDLE_VALUE;
+        }
+
+        return CreateFileW(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+    }
+
     std::vector<std::wstring> process_modules(DWORD pid)
     {
         HANDLE process = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
@@ -152,138 +179,309 @@ std::wstring NtdllExtensions::path_to_kernel_name(LPCWSTR path)
     return kernel_name;
 }
 
-std::vector<NtdllExtensions::HandleInfo> NtdllExtensions::handles() noexcept
+// A terminated worker never runs user mode code again, so apart from the buffer of the query it
+// hangs in, the shard is only used by its watchdog once the worker is killed.
+struct NtdllExtensions::HandleShard
 {
-    auto get_info_result = NtQuerySystemInformationMemoryLoop(SystemExtendedHandleInformation);
-    if (NT_ERROR(get_info_result.status))
-    {
-        return {};
-    }
+    NtdllExtensions* owner = nullptr;
+    std::vector<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX*> handles;
 
-    auto info_ptr = reinterpret_cast<SYSTEM_HANDLE_INFORMATION_EX*>(get_info_result.memory.data());
+    // Index of the "File" object type, shared by all shards of a scan
+    std::atomic<ULONG>* file_type_index = nullptr;
 
-    std::map<ULONG_PTR, HANDLE> pid_to_handle;
-    std::vector<HandleInfo> result;
+    std::atomic<size_t> i = 0;
+    std::atomic<HANDLE> handle_copy = NULL;
 
-    std::vector<BYTE> object_info_buffer(DefaultResultBufferSize);
+    std::map<ULONG_PTR, HANDLE> pid_to_handle;
 
-    std::atomic<ULONG> i = 0;
-    std::atomic<ULONG_PTR> handle_count = info_ptr->NumberOfHandles;
-    std::atomic<HANDLE> process_handle = NULL;
-    std::atomic<HANDLE> handle_copy = NULL;
-    ULONG previous_i;
+    // The kernel may still write to the buffer of a query that hangs after its worker is
+    // terminated, so a worker which doesn't go away keeps its buffer.
+    std::unique_ptr<std::vector<BYTE>> object_info_buffer = std::make_unique<std::vector<BYTE>>(DefaultResultBufferSize);
 
+    // One slot per handle, written by the worker without a lock, so that terminating it can't
+    // leave a lock held. Slots below results_count are complete and belong to the watchdog.
+    std::vector<HandleInfo> results;
+    std::atomic<size_t> results_count = 0;
+    size_t results_passed = 0;
+};
 
-    while (i < handle_count)
+void NtdllExtensions::resolve_handle_shard(HandleShard& shard)
+{
+    for (; shard.i < shard.handles.size(); shard.i++)
     {
-        previous_i = i;
+        shard.handle_copy = NULL;
 
-        // The system calls we use in this block were reported to hang on some machines.
-        // We need to offload the cycle to another thread and keep track of progress to terminate and resume when needed.
-        // Unfortunately, there are no alternative APIs to what we're using that accept timeouts. (NtQueryObject and GetFileType)
-        auto offload_function = std::thread([&] {
-            for (; i < handle_count; i++)
-            {
-                process_handle = NULL;
-                handle_copy = NULL;
+        auto handle_info = shard.handles[shard.i];
+        auto pid = handle_info->UniqueProcessId;
 
-                auto handle_info = info_ptr->Handles + i;
-                auto pid = handle_info->UniqueProcessId;
+        // Once the index of the "File" type is known, other handles are skipped without duplicating them.
+        auto file_type_index = shard.file_type_index->load();
+        if (file_type_index != UnknownObjectTypeIndex && handle_info->ObjectTypeIndex != file_type_index)
+        {
+            continue;
+        }
 
-                auto iter = pid_to_handle.find(pid);
-                if (iter != pid_to_handle.end())
-                {
-                    process_handle = iter->second;
-                }
-                else
-                {
-                    process_handle = OpenProcess(PROCESS_DUP_HANDLE, FALSE, static_cast<DWORD>(pid));
-                    if (!process_handle)
-                    {
-                        continue;
-                    }
-                    pid_to_handle[pid] = process_handle;
-                }
+        HANDLE process_handle;
+        if (auto iter = shard.pid_to_handle.find(pid); iter != shard.pid_to_handle.end())
+        {
+            process_handle = iter->second;
+        }
+        else
+        {
+            // Processes which can't be opened are remembered too, so they are tried only once.
+            process_handle = OpenProcess(PROCESS_DUP_HANDLE, FALSE, static_cast<DWORD>(pid));
+            shard.pid_to_handle[pid] = process_handle;
+        }
+
+        if (!process_handle)
+        {
+            continue;
+        }
 
-                // According to this:
-                // https://stackoverflow.com/questions/46384048/enumerate-handles
-                // NtQueryObject could hang
+        // According to this:
+        // https://stackoverflow.com/questions/46384048/enumerate-handles
+        // NtQueryObject could hang
 
-                // TODO uncomment and investigate
-                // if (handle_info->GrantedAccess == 0x0012019f) {
-                //     continue;
-                // }
+        // TODO uncomment and investigate
+        // if (handle_info->GrantedAccess == 0x0012019f) {
+        //     continue;
+        // }
 
-                HANDLE local_handle_copy;
-                auto dh_result = DuplicateHandle(process_handle, reinterpret_cast<HANDLE>(handle_info->HandleValue), GetCurrentProcess(), &local_handle_copy, 0, 0, DUPLICATE_SAME_ACCESS);
-                if (dh_result == 0)
-                {
-                    // Ignore this handle.
-                    continue;
-                }
-                handle_copy = local_handle_copy;
+        HANDLE local_handle_copy;
+        auto dh_result = DuplicateHandle(process_handle, reinterpret_cast<HANDLE>(handle_info->HandleValue), GetCurrentProcess(), &local_handle_copy, 0, 0, DUPLICATE_SAME_ACCESS);
+        if (dh_result == 0)
+        {
+            // Ignore this handle.
+            continue;
+        }
+        shard.handle_copy = local_handle_copy;
 
-                ULONG return_length;
-                auto status = NtQueryObject(handle_copy, ObjectTypeInformation, object_info_buffer.data(), static_cast<ULONG>(object_info_buffer.size()), &return_length);
-                if (NT_ERROR(status))
-                {
-                    // Ignore this handle.
-                    CloseHandle(handle_copy);
-                    handle_copy = NULL;
-                    continue;
-                }
+        bool is_file = true;
+        if (file_type_index == UnknownObjectTypeIndex)
+        {
+            ULONG return_length;
+            auto& buffer = *shard.object_info_buffer;
+            auto status = NtQueryObject(local_handle_copy, ObjectTypeInformation, buffer.data(), static_cast<ULONG>(buffer.size()), &return_length);
 
-                auto object_type_info = reinterpret_cast<OBJECT_TYPE_INFORMATION*>(object_info_buffer.data());
-                auto type_name = unicode_to_str(object_type_info->Name);
+            auto object_type_info = reinterpret_cast<OBJECT_TYPE_INFORMATION*>(buffer.data());
+            is_file = NT_SUCCESS(status) && unicode_to_view(object_type_info->Name) == L"File";
+            if (is_file)
+            {
+                shard.file_type_index->store(handle_info->ObjectTypeIndex);
+            }
+        }
 
-                std::wstring file_name;
+        if (is_file)
+        {
+            auto file_name = file_handle_to_kernel_name(local_handle_copy, *shard.object_info_buffer);
 
-                if (type_name == L"File")
-                {
-                    file_name = file_handle_to_kernel_name(handle_copy, object_info_buffer);
-                    result.push_back(HandleInfo{ pid, handle_info->HandleValue, type_name, file_name });
-                }
+            const size_t result_index = shard.results_count.load(std::memory_order_relaxed);
+            shard.results[result_index] = HandleInfo{ pid, handle_info->HandleValue, L"File", std::move(file_name), reinterpret_cast<ULONG_PTR>(handle_info->Object) };
+            shard.results_count.store(result_index + 1, std::memory_order_release);
+        }
 
-                CloseHandle(handle_copy);
-                handle_copy = NULL;
-            }
-        });
+        shard.handle_copy = NULL;
+        CloseHandle(local_handle_copy);
+    }
+}
+
+DWORD WINAPI NtdllExtensions::resolve_handle_shard_thread(LPVOID param)
+{
+    auto& shard = *static_cast<HandleShard*>(param);
+    shard.owner->resolve_handle_shard(shard);
+    return 0;
+}
 
-        offload_function.detach();
-        do
+void NtdllExtensions::watch_handle_shard(HandleShard& shard, const std::function<void(std::vector<HandleInfo>&)>& callback)
+{
+    auto pass_results = [&] {
+        const size_t results_count = shard.results_count.load(std::memory_order_acquire);
+        if (results_count == shard.results_passed)
         {
-            Sleep(200); // Timeout in milliseconds for detecting that the system hang on getting information for a handle.
-            if (i >= handle_count)
+            return;
+        }
+
+        std::vector<HandleInfo> results(std::make_move_iterator(shard.results.begin() + shard.results_passed),
+                                        std::make_move_iterator(shard.results.begin() + results_count));
+        shard.results_passed = results_count;
+        callback(results);
+    };
+
+    while (shard.i < shard.handles.size())
+    {
+        // The system calls we use in resolve_handle_shard were reported to hang on some machines.
+        // We need to offload the cycle to another thread and keep track of progress to terminate and resume when needed.
+        // Unfortunately, there are no alternative APIs to what we're using that accept timeouts. (NtQueryObject and GetFileType)
+        // The thread is created directly, as a terminated std::thread leaks its state.
+        HANDLE thread_handle = CreateThread(nullptr, 0, resolve_handle_shard_thread, &shard, 0, nullptr);
+        if (!thread_handle)
+        {
+            resolve_handle_shard(shard);
+            pass_results();
+            continue;
+        }
+
+        size_t previous_i = shard.i;
+        while (true)
+        {
+            auto wait_result = WaitForSingleObject(thread_handle, HandleWatchdogTimeout);
+            pass_results();
+
+            if (wait_result != WAIT_TIMEOUT)
             {
                 // We're done.
                 break;
             }
 
-            if (previous_i >= i)
+            if (previous_i >= shard.i)
             {
                 // The thread looks like it's hanging on some handle. Let's kill it and resume.
 
-                // HACK: This is unsafe and may leak something, but looks like there's no way to properly clean up a thread when it's hanging on a system call.
-                TerminateThread(offload_function.native_handle(), 1);
+                // HACK: This is unsafe, but looks like there's no way to properly clean up a thread when it's hanging on a system call.
+                TerminateThread(thread_handle, 1);
 
                 // Close Handles that might be lingering.
-                if (handle_copy!=NULL)
+                if (HANDLE handle_copy = shard.handle_copy.exchange(NULL); handle_copy != NULL)
                 {
                     CloseHandle(handle_copy);
                 }
-                i++;
+
+                // The thread only goes away once the system call returns. Until then, its buffer is left to it.
+                if (WaitForSingleObject(thread_handle, HandleWatchdogTimeout) != WAIT_OBJECT_0)
+                {
+                    static_cast<void>(shard.object_info_buffer.release());
+                    shard.object_info_buffer = std::make_unique<std::vector<BYTE>>(DefaultResultBufferSize);
+                }
+
+                shard.i++;
                 break;
             }
-            previous_i = i;
-        } while (1);
+            previous_i = shard.i;
+        }
+
+        CloseHandle(thread_handle);
+    }
+
+    for (auto [pid, handle] : shard.pid_to_handle)
+    {
+        if (handle)
+        {
+            CloseHandle(handle);
+        }
+    }
+}
+
+void NtdllExtensions::handles(const std::function<void(HandleInfo&&)>& callback, const std::function<bool(const HandleKey&)>& filter) noexcept
+{
+    // A handle to a file of our own, to learn the index of the "File" object type from the handle table.
+    HANDLE probe_handle = open_own_executable();
+
+    auto snapshot = NtQuerySystemInformationMemoryLoop(SystemExtendedHandleInformation);
+    if (NT_ERROR(snapshot.status))
+    {
+        if (probe_handle != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(probe_handle);
+        }
+        return;
+    }
+
+    auto info_ptr = reinterpret_cast<SYSTEM_HANDLE_INFORMATION_EX*>(snapshot.memory.data());
+    auto is_probe_handle = [&, current_pid = GetCurrentProcessId()](const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX& handle_info) {
+        return probe_handle != INVALID_HANDLE_VALUE && handle_info.UniqueProcessId == current_pid && handle_info.HandleValue == reinterpret_cast<ULONG_PTR>(probe_handle);
+    };
+
+    // If the probe isn't found, the workers learn the index from the first file handle they query.
+    std::atomic<ULONG> file_type_index = UnknownObjectTypeIndex;
+    for (ULONG_PTR i = 0; i < info_ptr->NumberOfHandles; i++)
+    {
+        if (is_probe_handle(info_ptr->Handles[i]))
+        {
+            file_type_index.store(info_ptr->Handles[i].ObjectTypeIndex);
+            break;
+        }
+    }
+
+    // Group the handles which can be files by process.
+    std::map<ULONG_PTR, std::vector<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX*>> pid_handles;
+    for (ULONG_PTR i = 0; i < info_ptr->NumberOfHandles; i++)
+    {
+        const auto& handle_info = info_ptr->Handles[i];
+        if ((file_type_index != UnknownObjectTypeIndex && handle_info.ObjectTypeIndex != file_type_index) || is_probe_handle(handle_info))
+        {
+            continue;
+        }
+
+        if (filter && !filter({ handle_info.UniqueProcessId, handle_info.HandleValue, reinterpret_cast<ULONG_PTR>(handle_info.Object) }))
+        {
+            continue;
+        }
+
+        pid_handles[handle_info.UniqueProcessId].push_back(&handle_info);
+    }
+
+    // Spread the processes over the workers, largest first, so a hang only delays the processes of one worker.
+    auto worker_count = std::clamp(std::thread::hardware_concurrency(), 1u, MaxHandleWorkers);
+    std::vector<std::unique_ptr<HandleShard>> shards;
+    for (unsigned i = 0; i < worker_count; i++)
+    {
+        auto shard = std::make_unique<HandleShard>();
+        shard->owner = this;
+        shard->file_type_index = &file_type_index;
+        shards.push_back(std::move(shard));
+    }
+
+    std::vector<const std::vector<const SYSTEM_HANDLE_TABLE_ENTRY_INFO_EX*>*> groups;
+    for (const auto& [pid, handles] : pid_handles)
+    {
+        groups.push_back(&handles);
+    }
+
+    std::sort(groups.begin(), groups.end(), [](auto a, auto b) { return a->size() > b->size(); });
+    for (auto group : groups)
+    {
+        auto& shard = *std::min_element(shards.begin(), shards.end(), [](const auto& a, const auto& b) { return a->handles.size() < b->handles.size(); });
+        shard->handles.insert(shard->handles.end(), group->begin(), group->end());
+    }
+
+    for (const auto& shard : shards)
+    {
+        shard->results.resize(shard->handles.size());
+    }
 
+    std::mutex callback_mutex;
+    std::function<void(std::vector<HandleInfo>&)> pass_results = [&](std::vector<HandleInfo>& results) {
+        std::scoped_lock lock(callback_mutex);
+        for (auto& handle_info : results)
+        {
+            callback(std::move(handle_info));
+        }
+    };
+
+    std::vector<std::thread> watchdogs;
+    for (const auto& shard : shards)
+    {
+        if (!shard->handles.empty())
+        {
+            watchdogs.emplace_back([this, shard = shard.get(), &pass_results] { watch_handle_shard(*shard, pass_results); });
+        }
+    }
+
+    for (auto& watchdog : watchdogs)
+    {
+        watchdog.join();
     }
 
-    for (auto [pid, handle] : pid_to_handle)
+    if (probe_handle != INVALID_HANDLE_VALUE)
     {
-        CloseHandle(handle);
+        CloseHandle(probe_handle);
     }
+}
 
+std::vector<NtdllExtensions::HandleInfo> NtdllExtensions::handles() noexcept
+{
+    std::vector<HandleInfo> result;
+    handles([&](HandleInfo&& handle_info) { result.push_back(std::move(handle_info)); });
     return result;
 }
 
@@ -340,7 +538,25 @@ std::wstring NtdllExtensions::pid_to_user(DWORD pid)
 }
 
 
+std::vector<std::wstring> NtdllExtensions::pid_to_modules(DWORD pid)
+{
+    return process_modules(pid);
+}
+
 std::vector<NtdllExtensions::ProcessInfo> NtdllExtensions::processes() noexcept
+{
+    auto result = process_list();
+
+    for (auto& item : result)
+    {
+        item.modules = process_modules(item.pid);
+        item.user = pid_to_user(item.pid);
+    }
+
+    return result;
+}
+
+std::vector<NtdllExtensions::ProcessInfo> NtdllExtensions::process_list() noexcept
 {
     auto get_info_result = NtQuerySystemInformationMemoryLoop(SystemProcessInformation);
 
@@ -359,10 +575,9 @@ std::vector<NtdllExtensions::ProcessInfo> NtdllExtensions::processes() noexcept
         ProcessInfo item;
         item.name = unicode_to_str(info_ptr->ImageName);
         item.pid = static_cast<DWORD>(reinterpret_cast<uintptr_t>(info_ptr->UniqueProcessId));
-        item.modules = process_modules(item.pid);
-        item.user = pid_to_user(item.pid);
+        item.create_time = process_create_time(*info_ptr);
 
-        result.push_back(item);
+        result.push_back(std::move(item));
     }
 
     return result;
@@ -4,6 +4,9 @@
 
 #include "NtdllBase.h"
 
+#include <functional>
+#include <memory>
+
 class NtdllExtensions : protected Ntdll
 {
 private:
@@ -13,6 +16,15 @@ private:
     constexpr static int ObjectNameInformation = 1;
     constexpr static int SystemExtendedHandleInformation = 64;
 
+    // Number of threads resolving the system handles, each with its own hang watchdog.
+    constexpr static unsigned MaxHandleWorkers = 8;
+
+    // Timeout in milliseconds for detecting that the system hang on getting information for a handle.
+    constexpr static DWORD HandleWatchdogTimeout = 200;
+
+    // Handles of a set of processes, resolved by one worker.
+    struct HandleShard;
+
     struct MemoryLoopResult
     {
         NTSTATUS status = 0;
@@ -28,17 +40,38 @@ public:
     struct ProcessInfo
     {
         DWORD pid = 0;
+
+        // Creation time of the process, which tells it apart from an earlier process with the same pid.
+        ULONGLONG create_time = 0;
         std::wstring name;
         std::wstring user;
         std::vector<std::wstring> modules;
     };
 
+    // Identifies a handle across scans. The object address is only reported
+    // to elevated callers, otherwise it's zero and handle values may be reused,
+    // so a key with a zero object doesn't identify the file the handle is open on.
+    struct HandleKey
+    {
+        ULONG_PTR pid;
+        ULONG_PTR handle;
+        ULONG_PTR object;
+
+        auto operator<=>(const HandleKey&) const = default;
+    };
+
     struct HandleInfo
     {
         ULONG_PTR pid;
         ULONG_PTR handle;
         std::wstring type_name;
         std::wstring kernel_file_name;
+        ULONG_PTR object = 0;
+
+        HandleKey key() const
+        {
+            return { pid, handle, object };
+        }
     };
 
     std::wstring file_handle_to_kernel_name(HANDLE file_handle);
@@ -48,9 +81,29 @@ public:
     // Gives the user name of the account running this process
     std::wstring pid_to_user(DWORD pid);
 
+    // Gives the paths of the modules loaded by this process
+    std::vector<std::wstring> pid_to_modules(DWORD pid);
+
+    // Calls `callback` for the file handles in the system as they are resolved.
+    // The callback is called from several threads, but never concurrently.
+    // If `filter` is given, it's called first for each handle which may be a file and only
+    // the handles it returns true for are resolved.
+    void handles(const std::function<void(HandleInfo&&)>& callback, const std::function<bool(const HandleKey&)>& filter = {}) noexcept;
+
     std::vector<HandleInfo> handles() noexcept;
 
     // Returns the list of all processes.
     // On failure, returns an empty vector.
     std::vector<ProcessInfo> processes() noexcept;
+
+    // Same as processes(), without the user and the modules.
+    std::vector<ProcessInfo> process_list() noexcept;
+
+private:
+    // Resolves the handles of the shard, starting at its current position. Runs on a thread which is terminated if it hangs.
+    void resolve_handle_shard(HandleShard& shard);
+    static DWORD WINAPI resolve_handle_shard_thread(LPVOID shard);
+
+    // Runs resolve_handle_shard under a watchdog until all handles of the shard are visited, passing the results to `callback`.
+    void watch_handle_shard(HandleShard& shard, const std::function<void(std::vector<HandleInfo>&)>& callback);
 };
@@ -0,0 +1,830 @@
+//============================================================================
+//
+// PanoramaStitchReplay.cpp
+//
+// Offline replay and benchmark tool for the panorama stitch engine.
+//
+// Runs ZoomIt panorama debug dumps (directories of accepted_NNNN.bmp frames
+// written by /panorama-debug) or synthetic scrolling captures through
+// StitchPanoramaPixels and reports per-stage timings and a hash of the
+// stitched image, so throughput and output changes can be tracked in CI
+// without a desktop session.  With --streaming each case also goes through
+// StreamingPanoramaStitch, which produces the image during a live capture,
+// and its output is compared with the batch one.  Builds on Windows and
+// Linux; see CMakeLists.txt.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//
+//============================================================================
+#include "PanoramaStitch.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct ReplayCase
+{
+    std::string name;
+    std::vector<std::vector<BYTE>> frames;
+    int frameWidth = 0;
+    int frameHeight = 0;
+
+    // Synthetic cases only: the page the frames were cut from, which the
+    // stitched image must reproduce from the top.
+    std::vector<BYTE> page;
+    int pageHeight = 0;
+};
+
+struct ReplayOptions
+{
+    int iterations = 3;
+    bool lowContrast = false;
+    bool trace = false;
+    bool verify = false;
+    bool streaming = false;
+    bool schedulerBenchmark = false;
+    fs::path outputDirectory;
+    fs::path expectFile;
+    fs::path writeExpectFile;
+};
+
+//----------------------------------------------------------------------------
+//
+// BMP files
+//
+//----------------------------------------------------------------------------
+static uint32_t ReadLe32( const BYTE* data )
+{
+    return static_cast<uint32_t>( data[0] ) | ( static_cast<uint32_t>( data[1] ) << 8 ) |
+           ( static_cast<uint32_t>( data[2] ) << 16 ) | ( static_cast<uint32_t>( data[3] ) << 24 );
+}
+
+static void WriteLe32( BYTE* data, uint32_t value )
+{
+    data[0] = static_cast<BYTE>( value );
+    data[1] = static_cast<BYTE>( value >> 8 );
+    data[2] = static_cast<BYTE>( value >> 16 );
+    data[3] = static_cast<BYTE>( value >> 24 );
+}
+
+// Loads an uncompressed 24- or 32-bpp BMP as top-down BGRA.
+static bool LoadBmp( const fs::path& path, std::vector<BYTE>& pixels, int& width, int& height )
+{
+    std::ifstream stream( path, std::ios::binary );
+    std::vector<BYTE> file( ( std::istreambuf_iterator<char>( stream ) ), std::istreambuf_iterator<char>() );
+    if( file.size() < 54 || file[0] != 'B' || file[1] != 'M' )
+    {
+        return false;
+    }
+
+    const uint32_t pixelOffset = ReadLe32( &file[10] );
+    width = static_cast<int32_t>( ReadLe32( &file[18] ) );
+    const int32_t rawHeight = static_cast<int32_t>( ReadLe32( &file[22] ) );
+    const int bitCount = file[28] | ( file[29] << 8 );
+    const uint32_t compression = ReadLe32( &file[30] );
+    const bool topDown = rawHeight < 0;
+    height = topDown ? -rawHeight : rawHeight;
+    // BI_RGB, or BI_BITFIELDS with the default masks that GetDIBits writes.
+    if( width <= 0 || height <= 0 || ( bitCount != 24 && bitCount != 32 ) || ( compression != 0 && compression != 3 ) )
+    {
+        return false;
+    }
+
+    const size_t bytesPerPixel = static_cast<size_t>( bitCount ) / 8;
+    const size_t stride = ( static_cast<size_t>( width ) * bytesPerPixel + 3 ) & ~static_cast<size_t>( 3 );
+    if( pixelOffset + stride * static_cast<size_t>( height ) > file.size() )
+    {
+        return false;
+    }
+
+    pixels.resize( static_cast<size_t>( width ) * static_cast<size_t>( height ) * 4 );
+    for( int y = 0; y < height; ++y )
+    {
+        const BYTE* source = &file[pixelOffset + stride * static_cast<size_t>( topDown ? y : height - 1 - y )];
+        BYTE* destination = &pixels[static_cast<size_t>( y ) * static_cast<size_t>( width ) * 4];
+        for( int x = 0; x < width; ++x )
+        {
+            destination[x * 4 + 0] = source[x * bytesPerPixel + 0];
+            destination[x * 4 + 1] = source[x * bytesPerPixel + 1];
+            destination[x * 4 + 2] = source[x * bytesPerPixel + 2];
+            destination[x * 4 + 3] = bytesPerPixel == 4 ? source[x * bytesPerPixel + 3] : 255;
+        }
+    }
+    return true;
+}
+
+// Writes top-down BGRA pixels as a 32-bpp BMP, the same layout ZoomIt dumps.
+static bool SaveBmp( const fs::path& path, const std::vector<BYTE>& pixels, int width, int height )
+{
+    BYTE header[54]{};
+    header[0] = 'B';
+    header[1] = 'M';
+    WriteLe32( &header[2], static_cast<uint32_t>( sizeof( header ) + pixels.size() ) );
+    WriteLe32( &header[10], sizeof( header ) );
+    WriteLe32( &header[14], 40 );
+    WriteLe32( &header[18], static_cast<uint32_t>( width ) );
+    WriteLe32( &header[22], static_cast<uint32_t>( -height ) );
+    header[26] = 1;
+    header[28] = 32;
+    WriteLe32( &header[34], static_cast<uint32_t>( pixels.size() ) );
+
+    std::ofstream stream( path, std::ios::binary | std::ios::trunc );
+    stream.write( reinterpret_cast<const char*>( header ), sizeof( header ) );
+    stream.write( reinterpret_cast<const char*>( pixels.data() ), static_cast<std::streamsize>( pixels.size() ) );
+    return stream.good();
+}
+
+//----------------------------------------------------------------------------
+//
+// Replay cases
+//
+//----------------------------------------------------------------------------
+
+// Frame selection matches the debug-only /panorama-stitch-replay switch:
+// accepted frames, or grabbed frames when fewer than two were accepted.
+static bool LoadDumpDirectory( const fs::path& directory, ReplayCase& replayCase )
+{
+    std::vector<fs::path> accepted;
+    std::vector<fs::path> grabbed;
+    std::error_code errorCode;
+    for( const auto& entry : fs::directory_iterator( directory, errorCode ) )
+    {
+        const std::string fileName = entry.path().filename().string();
+        if( !entry.is_regular_file() || entry.path().extension() != ".bmp" )
+        {
+            continue;
+        }
+        if( fileName.rfind( "accepted_", 0 ) == 0 )
+        {
+            accepted.push_back( entry.path() );
+        }
+        else if( fileName.rfind( "grabbed_", 0 ) == 0 )
+        {
+            grabbed.push_back( entry.path() );
+        }
+    }
+
+    std::vector<fs::path>& framePaths = ( grabbed.size() >= 2 && accepted.size() < 2 ) ? grabbed : accepted;
+    if( framePaths.size() < 2 )
+    {
+        return false;
+    }
+    std::sort( framePaths.begin(), framePaths.end() );
+
+    replayCase.name = directory.filename().string();
+    for( const auto& framePath : framePaths )
+    {
+        std::vector<BYTE> pixels;
+        int width = 0;
+        int height = 0;
+        if( !LoadBmp( framePath, pixels, width, height ) )
+        {
+            fprintf( stderr, "%s: cannot read %s\n", replayCase.name.c_str(), framePath.string().c_str() );
+            return false;
+        }
+        if( replayCase.frames.empty() )
+        {
+            replayCase.frameWidth = width;
+            replayCase.frameHeight = height;
+        }
+        else if( width != replayCase.frameWidth || height != replayCase.frameHeight )
+        {
+            fprintf( stderr, "%s: %s is %dx%d, expected %dx%d\n", replayCase.name.c_str(), framePath.string().c_str(),
+                     width, height, replayCase.frameWidth, replayCase.frameHeight );
+            return false;
+        }
+        replayCase.frames.push_back( std::move( pixels ) );
+    }
+    return true;
+}
+
+// A directory is either one dump or a corpus of dump subdirectories.
+static bool CollectCases( const fs::path& path, std::vector<ReplayCase>& cases )
+{
+    ReplayCase replayCase;
+    if( LoadDumpDirectory( path, replayCase ) )
+    {
+        cases.push_back( std::move( replayCase ) );
+        return true;
+    }
+
+    std::vector<fs::path> subdirectories;
+    std::error_code errorCode;
+    for( const auto& entry : fs::directory_iterator( path, errorCode ) )
+    {
+        if( entry.is_directory() )
+        {
+            subdirectories.push_back( entry.path() );
+        }
+    }
+    std::sort( subdirectories.begin(), subdirectories.end() );
+
+    bool found = false;
+    for( const auto& subdirectory : subdirectories )
+    {
+        ReplayCase subdirectoryCase;
+        if( LoadDumpDirectory( subdirectory, subdirectoryCase ) )
+        {
+            cases.push_back( std::move( subdirectoryCase ) );
+            found = true;
+        }
+    }
+    return found;
+}
+
+static uint32_t NextRandom( uint32_t& state )
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Builds a document-like page (lines of "words", rules and pictures on a
+// light background) and cuts frames from it at irregular scroll steps, as
+// a scrolled browser window would produce.  spec is WIDTHxHEIGHT:FRAMES,
+// optionally followed by :STEP to scroll about STEP pixels per frame.
+static bool CreateSyntheticCase( const std::string& spec, ReplayCase& replayCase )
+{
+    int width = 0;
+    int height = 0;
+    int frameCount = 0;
+    int averageStep = 0;
+    const int fields = sscanf( spec.c_str(), "%dx%d:%d:%d", &width, &height, &frameCount, &averageStep );
+    if( fields < 3 || width < 64 || height < 64 || frameCount < 2 ||
+        ( fields == 4 && ( averageStep < 8 || averageStep > height * 3 / 4 ) ) )
+    {
+        return false;
+    }
+
+    uint32_t random = 0x2545F491u ^ static_cast<uint32_t>( width * 31 + height * 17 + frameCount );
+    std::vector<int> steps;
+    int pageHeight = height;
+    for( int i = 1; i < frameCount; ++i )
+    {
+        const int step = averageStep > 0
+            ? averageStep - averageStep / 8 + static_cast<int>( NextRandom( random ) % static_cast<uint32_t>( averageStep / 4 + 1 ) )
+            : height / 20 + static_cast<int>( NextRandom( random ) % static_cast<uint32_t>( height / 4 ) );
+        steps.push_back( step );
+        pageHeight += step;
+    }
+    if( pageHeight > kMaxStitchedCanvasDimension )
+    {
+        return false;
+    }
+
+    std::vector<BYTE>& page = replayCase.page;
+    page.assign( static_cast<size_t>( width ) * static_cast<size_t>( pageHeight ) * 4, 0 );
+    auto fill = [&]( int left, int top, int right, int bottom, BYTE b, BYTE g, BYTE r )
+    {
+        for( int y = ( std::max )( top, 0 ); y < ( std::min )( bottom, pageHeight ); ++y )
+        {
+            for( int x = ( std::max )( left, 0 ); x < ( std::min )( right, width ); ++x )
+            {
+                BYTE* pixel = &page[( static_cast<size_t>( y ) * width + x ) * 4];
+                pixel[0] = b;
+                pixel[1] = g;
+                pixel[2] = r;
+                pixel[3] = 255;
+            }
+        }
+    };
+
+    fill( 0, 0, width, pageHeight, 250, 248, 245 );
+    const int margin = width / 16;
+    const int lineHeight = ( std::max )( 12, height / 40 );
+    for( int y = lineHeight; y + lineHeight < pageHeight; )
+    {
+        const uint32_t kind = NextRandom( random ) % 16;
+        if( kind == 0 )
+        {
+            // Picture: a gradient block with some structure.
+            const int pictureHeight = lineHeight * ( 4 + static_cast<int>( NextRandom( random ) % 6 ) );
+            const int pictureWidth = width / 3 + static_cast<int>( NextRandom( random ) % static_cast<uint32_t>( width / 3 ) );
+            const BYTE hue = static_cast<BYTE>( NextRandom( random ) );
+            for( int py = 0; py < pictureHeight && y + py < pageHeight; ++py )
+            {
+                for( int px = 0; px < pictureWidth && margin + px < width; ++px )
+                {
+                    BYTE* pixel = &page[( static_cast<size_t>( y + py ) * width + margin + px ) * 4];
+                    pixel[0] = static_cast<BYTE>( hue + px / 3 );
+                    pixel[1] = static_cast<BYTE>( 80 + py * 120 / pictureHeight );
+                    pixel[2] = static_cast<BYTE>( ( ( px / 9 ) ^ ( py / 7 ) ) * 23 );
+                    pixel[3] = 255;
+                }
+            }
+            y += pictureHeight + lineHeight;
+        }
+        else if( kind == 1 )
+        {
+            fill( margin, y + lineHeight / 2, width - margin, y + lineHeight / 2 + 2, 190, 190, 190 );
+            y += lineHeight * 2;
+        }
+        else
+        {
+            // A line of words with a ragged right edge.
+            const int lineEnd = width - margin - static_cast<int>( NextRandom( random ) % static_cast<uint32_t>( width / 4 ) );
+            for( int x = margin; x < lineEnd; )
+            {
+                const int wordWidth = 6 + static_cast<int>( NextRandom( random ) % 60 );
+                const int glyphHeight = lineHeight * 2 / 3 - static_cast<int>( NextRandom( random ) % 3 );
+                const BYTE ink = static_cast<BYTE>( 20 + NextRandom( random ) % 60 );
+                for( int gx = x; gx < x + wordWidth && gx < lineEnd; gx += 4 )
+                {
+                    const int top = y + static_cast<int>( NextRandom( random ) % 4 );
+                    fill( gx, top, gx + 3, y + glyphHeight, ink, ink, static_cast<BYTE>( ink + 10 ) );
+                }
+                x += wordWidth + 8;
+            }
+            y += lineHeight + lineHeight / 2;
+        }
+    }
+
+    replayCase.name = "synthetic-" + spec;
+    replayCase.frameWidth = width;
+    replayCase.frameHeight = height;
+    replayCase.pageHeight = pageHeight;
+    const size_t rowBytes = static_cast<size_t>( width ) * 4;
+    int position = 0;
+    for( int i = 0; i < frameCount; ++i )
+    {
+        replayCase.frames.emplace_back( page.begin() + static_cast<ptrdiff_t>( position * rowBytes ),
+                                        page.begin() + static_cast<ptrdiff_t>( ( position + height ) * rowBytes ) );
+        if( i + 1 < frameCount )
+        {
+            position += steps[i];
+        }
+    }
+    return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// Benchmark
+//
+//----------------------------------------------------------------------------
+
+// FNV-1a over the dimensions and the color channels; alpha is ignored
+// because screen captures leave it undefined.
+static uint64_t HashImage( const std::vector<BYTE>& pixels, int width, int height )
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash]( BYTE value )
+    {
+        hash ^= value;
+        hash *= 1099511628211ull;
+    };
+    for( int shift = 0; shift < 32; shift += 8 )
+    {
+        add( static_cast<BYTE>( width >> shift ) );
+        add( static_cast<BYTE>( height >> shift ) );
+    }
+    for( size_t i = 0; i < pixels.size(); i += 4 )
+    {
+        add( pixels[i] );
+        add( pixels[i + 1] );
+        add( pixels[i + 2] );
+    }
+    return hash;
+}
+
+static void TraceToStderr( const wchar_t* message )
+{
+    std::string narrow;
+    for( const wchar_t* c = message; *c != 0; ++c )
+    {
+        narrow.push_back( *c < 128 ? static_cast<char>( *c ) : '?' );
+    }
+    fputs( narrow.c_str(), stderr );
+}
+
+static bool TraceEnabled()
+{
+    return true;
+}
+
+static std::map<std::string, std::string> ReadExpectations( const fs::path& path )
+{
+    std::map<std::string, std::string> expectations;
+    std::ifstream stream( path );
+    std::string name;
+    std::string hash;
+    while( stream >> name >> hash )
+    {
+        expectations[name] = hash;
+    }
+    return expectations;
+}
+
+// Fraction of pixels whose color channels differ, or 1 if the sizes differ.
+static double MismatchFraction( const std::vector<BYTE>& pixels,
+                                int width,
+                                int height,
+                                const std::vector<BYTE>& referencePixels,
+                                int referenceWidth,
+                                int referenceHeight )
+{
+    if( width != referenceWidth || height != referenceHeight || width <= 0 || height <= 0 )
+    {
+        return 1.0;
+    }
+    size_t mismatched = 0;
+    for( size_t i = 0; i < pixels.size(); i += 4 )
+    {
+        if( pixels[i] != referencePixels[i] || pixels[i + 1] != referencePixels[i + 1] || pixels[i + 2] != referencePixels[i + 2] )
+        {
+            mismatched++;
+        }
+    }
+    return static_cast<double>( mismatched ) / static_cast<double>( pixels.size() / 4 );
+}
+
+// Feeds the frames through StreamingPanoramaStitch as the capture loop does.
+static bool StitchStreaming( const ReplayCase& replayCase,
+                             bool lowContrast,
+                             std::vector<BYTE>& stitched,
+                             int& stitchedWidth,
+                             int& stitchedHeight,
+                             size_t& composedFrames,
+                             bool& lostTrack )
+{
+    StreamingPanoramaStitch stitch( replayCase.frameWidth, replayCase.frameHeight, lowContrast );
+    for( const std::vector<BYTE>& frame : replayCase.frames )
+    {
+        std::vector<BYTE> pixels = frame;
+        stitch.AddFrame( pixels );
+    }
+    composedFrames = stitch.ComposedFrameCount();
+    lostTrack = stitch.HasLostTrack();
+    return stitch.Compose( stitched, stitchedWidth, stitchedHeight );
+}
+
+static double Median( std::vector<double> values )
+{
+    std::sort( values.begin(), values.end() );
+    return values[values.size() / 2];
+}
+
+//----------------------------------------------------------------------------
+// SpawnPerCallParallelFor
+//
+// The parallel_for the stitch engine used before the shared task scheduler:
+// it creates and joins hardware_concurrency threads on every call.  Kept
+// only as the baseline for --scheduler-benchmark.
+//----------------------------------------------------------------------------
+template<typename Func>
+static void SpawnPerCallParallelFor( int begin, int end, const Func& body )
+{
+    const int count = end - begin;
+    if( count <= 0 )
+        return;
+    const int maxThreads = static_cast<int>( std::thread::hardware_concurrency() );
+    const int numThreads = ( std::min )( maxThreads, count );
+    if( numThreads <= 1 )
+    {
+        for( int i = begin; i < end; ++i )
+            body( i );
+        return;
+    }
+    std::vector<std::thread> threads( numThreads - 1 );
+    std::atomic<int> nextIndex( begin );
+    auto worker = [&]()
+    {
+        for( ;; )
+        {
+            const int i = nextIndex.fetch_add( 1 );
+            if( i >= end )
+                break;
+            body( i );
+        }
+    };
+    for( auto& t : threads )
+        t = std::thread( worker );
+    worker();
+    for( auto& t : threads )
+        t.join();
+}
+
+//----------------------------------------------------------------------------
+// RunSchedulerBenchmark
+//
+// Reports the wall time of one dispatch of a small per-item kernel for a
+// serial loop, the old spawn-per-call parallel_for and the shared task
+// scheduler (grain 1, as the stitch engine dispatches candidates).  With
+// little work per item the difference is the per-dispatch overhead.
+//----------------------------------------------------------------------------
+static void RunSchedulerBenchmark()
+{
+    printf( "Dispatch cost with %d scheduler threads (%u hardware threads)\n",
+            TaskSchedulerConcurrency(),
+            std::thread::hardware_concurrency() );
+    printf( "%8s %14s %14s %14s\n", "items", "serial us", "spawn us", "scheduler us" );
+
+    for( const int items : { 8, 64, 512, 4096 } )
+    {
+        std::vector<uint32_t> results( items );
+        const auto kernel = [&]( int i )
+        {
+            uint32_t value = static_cast<uint32_t>( i );
+            for( int k = 0; k < 64; ++k )
+            {
+                value = value * 1664525u + 1013904223u;
+            }
+            results[i] = value;
+        };
+        const auto microsecondsPerDispatch = []( int dispatches, const auto& dispatch )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            for( int i = 0; i < dispatches; ++i )
+            {
+                dispatch();
+            }
+            return std::chrono::duration<double, std::micro>( std::chrono::steady_clock::now() - start ).count() / dispatches;
+        };
+
+        const double serialUs = microsecondsPerDispatch( 2000, [&]()
+        {
+            for( int i = 0; i < items; ++i )
+                kernel( i );
+        } );
+        const double spawnUs = microsecondsPerDispatch( 200, [&]()
+        {
+            SpawnPerCallParallelFor( 0, items, kernel );
+        } );
+        const double schedulerUs = microsecondsPerDispatch( 2000, [&]()
+        {
+            ParallelFor( 0, items, 1, [&]( int rangeBegin, int rangeEnd )
+            {
+                for( int i = rangeBegin; i < rangeEnd; ++i )
+                    kernel( i );
+            } );
+        } );
+        printf( "%8d %14.2f %14.2f %14.2f\n", items, serialUs, spawnUs, schedulerUs );
+    }
+}
+
+static void PrintUsage()
+{
+    fputs( "Usage: PanoramaStitchReplay [options] <dump-or-corpus-directory>...\n"
+           "\n"
+           "Stitches ZoomIt panorama debug dumps and reports the median stage timings\n"
+           "over the iterations and a hash of the stitched image.\n"
+           "\n"
+           "  --synthetic WxH:N[:S] Add a synthetic capture of N frames of WxH pixels,\n"
+           "                        scrolled about S pixels per frame if given\n"
+           "  --iterations N        Stitch each case N times (default 3)\n"
+           "  --low-contrast        Stitch in low-contrast mode\n"
+           "  --verify              Fail if a synthetic case does not reproduce its page,\n"
+           "                        or with --streaming if the outputs differ\n"
+           "  --streaming           Also stitch each case with the streaming stitcher\n"
+           "                        and compare its output with the batch one\n"
+           "  --expect FILE         Fail if a hash differs from the one listed in FILE\n"
+           "  --write-expect FILE   Write the hashes in the --expect format\n"
+           "  --output DIR          Save each stitched image as DIR/<case>.bmp\n"
+           "  --trace               Write the stitch log to stderr\n"
+           "  --scheduler-benchmark Report task scheduler dispatch overhead\n",
+           stdout );
+}
+
+int main( int argc, char** argv )
+{
+    ReplayOptions options;
+    std::vector<ReplayCase> cases;
+    for( int i = 1; i < argc; ++i )
+    {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if( argument == "--iterations" && hasValue )
+        {
+            options.iterations = ( std::max )( 1, atoi( argv[++i] ) );
+        }
+        else if( argument == "--synthetic" && hasValue )
+        {
+            ReplayCase replayCase;
+            if( !CreateSyntheticCase( argv[++i], replayCase ) )
+            {
+                fprintf( stderr, "Invalid synthetic capture %s\n", argv[i] );
+                return 2;
+            }
+            cases.push_back( std::move( replayCase ) );
+        }
+        else if( argument == "--low-contrast" )
+        {
+            options.lowContrast = true;
+        }
+        else if( argument == "--verify" )
+        {
+            options.verify = true;
+        }
+        else if( argument == "--streaming" )
+        {
+            options.streaming = true;
+        }
+        else if( argument == "--trace" )
+        {
+            options.trace = true;
+        }
+        else if( argument == "--scheduler-benchmark" )
+        {
+            options.schedulerBenchmark = true;
+        }
+        else if( argument == "--expect" && hasValue )
+        {
+            options.expectFile = argv[++i];
+        }
+        else if( argument == "--write-expect" && hasValue )
+        {
+            options.writeExpectFile = argv[++i];
+        }
+        else if( argument == "--output" && hasValue )
+        {
+            options.outputDirectory = argv[++i];
+        }
+        else if( argument.rfind( "--", 0 ) == 0 )
+        {
+            PrintUsage();
+            return 2;
+        }
+        else if( !CollectCases( argument, cases ) )
+        {
+            fprintf( stderr, "No panorama dumps found in %s\n", argument.c_str() );
+            return 2;
+        }
+    }
+
+    if( options.schedulerBenchmark )
+    {
+        RunSchedulerBenchmark();
+        if( cases.empty() )
+        {
+            return 0;
+        }
+    }
+
+    if( cases.empty() )
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    if( options.trace )
+    {
+        SetPanoramaStitchLogSink( { TraceEnabled, TraceToStderr } );
+    }
+
+    const auto expectations = options.expectFile.empty() ? std::map<std::string, std::string>() : ReadExpectations( options.expectFile );
+    std::ofstream expectOutput;
+    if( !options.writeExpectFile.empty() )
+    {
+        expectOutput.open( options.writeExpectFile, std::ios::trunc );
+    }
+
+    printf( "%-32s %6s %8s %12s %16s %9s %9s %9s %9s %9s %9s\n",
+            "case", "frames", "composed", "canvas", "hash",
+            "prepare", "align", "overlay", "compose", "total", "ms/frame" );
+
+    int failures = 0;
+    for( const ReplayCase& replayCase : cases )
+    {
+        std::vector<double> prepare, align, overlay, compose, total;
+        std::vector<BYTE> stitched;
+        int stitchedWidth = 0;
+        int stitchedHeight = 0;
+        size_t composedFrames = 0;
+        bool stitchedOk = true;
+        for( int iteration = 0; iteration < options.iterations && stitchedOk; ++iteration )
+        {
+            PanoramaStitchTimings timings{};
+            stitchedOk = StitchPanoramaPixels( replayCase.frames, replayCase.frameWidth, replayCase.frameHeight,
+                                               options.lowContrast, nullptr, stitched, stitchedWidth, stitchedHeight,
+                                               &composedFrames, nullptr, &timings );
+            prepare.push_back( timings.prepareMs );
+            align.push_back( timings.alignMs );
+            overlay.push_back( timings.overlayMs );
+            compose.push_back( timings.composeMs );
+            total.push_back( timings.totalMs );
+        }
+
+        if( !stitchedOk )
+        {
+            printf( "%-32s %6zu FAILED\n", replayCase.name.c_str(), replayCase.frames.size() );
+            failures++;
+            continue;
+        }
+
+        char hash[17]{};
+        snprintf( hash, sizeof( hash ), "%016llx", static_cast<unsigned long long>( HashImage( stitched, stitchedWidth, stitchedHeight ) ) );
+        char canvas[32]{};
+        snprintf( canvas, sizeof( canvas ), "%dx%d", stitchedWidth, stitchedHeight );
+        printf( "%-32s %6zu %8zu %12s %16s %9.1f %9.1f %9.1f %9.1f %9.1f %9.2f\n",
+                replayCase.name.c_str(), replayCase.frames.size(), composedFrames, canvas, hash,
+                Median( prepare ), Median( align ), Median( overlay ), Median( compose ), Median( total ),
+                Median( total ) / static_cast<double>( replayCase.frames.size() ) );
+
+        if( expectOutput.is_open() )
+        {
+            expectOutput << replayCase.name << ' ' << hash << '\n';
+        }
+
+        const auto expected = expectations.find( replayCase.name );
+        if( expected != expectations.end() && expected->second != hash )
+        {
+            printf( "  hash mismatch: expected %s\n", expected->second.c_str() );
+            failures++;
+        }
+
+        if( options.verify && !replayCase.page.empty() )
+        {
+            // Compare against the page rows the canvas should cover.
+            const double mismatchFraction = MismatchFraction( stitched, stitchedWidth, stitchedHeight,
+                                                              replayCase.page, replayCase.frameWidth, replayCase.pageHeight );
+            if( mismatchFraction > 0.001 )
+            {
+                printf( "  verify failed: canvas %dx%d page %dx%d mismatched=%.3f%%\n",
+                        stitchedWidth, stitchedHeight, replayCase.frameWidth, replayCase.pageHeight, mismatchFraction * 100.0 );
+                failures++;
+            }
+        }
+
+        if( options.streaming )
+        {
+            std::vector<BYTE> streamed;
+            int streamedWidth = 0;
+            int streamedHeight = 0;
+            size_t streamedComposedFrames = 0;
+            bool lostTrack = false;
+            const auto streamStart = std::chrono::steady_clock::now();
+            const bool streamedOk = StitchStreaming( replayCase, options.lowContrast, streamed, streamedWidth, streamedHeight,
+                                                     streamedComposedFrames, lostTrack );
+            const double streamMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - streamStart ).count();
+            if( !streamedOk )
+            {
+                printf( "  streaming FAILED\n" );
+                failures++;
+                continue;
+            }
+
+            snprintf( hash, sizeof( hash ), "%016llx", static_cast<unsigned long long>( HashImage( streamed, streamedWidth, streamedHeight ) ) );
+            snprintf( canvas, sizeof( canvas ), "%dx%d", streamedWidth, streamedHeight );
+            const double batchMismatch = MismatchFraction( streamed, streamedWidth, streamedHeight, stitched, stitchedWidth, stitchedHeight );
+            printf( "  streaming: composed=%zu canvas=%s hash=%s total=%.1f ms lostTrack=%d differs from batch=%.3f%%\n",
+                    streamedComposedFrames, canvas, hash, streamMs, lostTrack ? 1 : 0, batchMismatch * 100.0 );
+
+            if( options.verify )
+            {
+                // The streaming stitcher does not feather, so allow the
+                // seams the batch stitcher blends to differ slightly.
+                if( lostTrack || batchMismatch > 0.01 )
+                {
+                    printf( "  verify failed: streaming canvas %dx%d batch %dx%d lostTrack=%d\n",
+                            streamedWidth, streamedHeight, stitchedWidth, stitchedHeight, lostTrack ? 1 : 0 );
+                    failures++;
+                }
+                if( !replayCase.page.empty() )
+                {
+                    const double pageMismatch = MismatchFraction( streamed, streamedWidth, streamedHeight,
+                                                                  replayCase.page, replayCase.frameWidth, replayCase.pageHeight );
+                    if( pageMismatch > 0.001 )
+                    {
+                        printf( "  verify failed: streaming canvas %dx%d page %dx%d mismatched=%.3f%%\n",
+                                streamedWidth, streamedHeight, replayCase.frameWidth, replayCase.pageHeight, pageMismatch * 100.0 );
+                        failures++;
+                    }
+                }
+            }
+
+            if( !options.outputDirectory.empty() )
+            {
+                std::error_code errorCode;
+                fs::create_directories( options.outputDirectory, errorCode );
+                SaveBmp( options.outputDirectory / ( replayCase.name + ".streaming.bmp" ), streamed, streamedWidth, streamedHeight );
+            }
+        }
+
+        if( !options.outputDirectory.empty() )
+        {
+            std::error_code errorCode;
+            fs::create_directories( options.outputDirectory, errorCode );
+            SaveBmp( options.outputDirectory / ( replayCase.name + ".bmp" ), stitched, stitchedWidth, stitchedHeight );
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}
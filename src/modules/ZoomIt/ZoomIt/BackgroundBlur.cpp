@@ -14,7 +14,9 @@
 //==============================================================================
 #include "pch.h"
 #include "BackgroundBlur.h"
+#include "TaskScheduler.h"
 #include <algorithm>
+#include <chrono>
 #include <cstring>
 #include <wincodec.h>
 #include <wil/com.h>
@@ -25,6 +27,13 @@ namespace wf    = winrt::Windows::Foundation::Collections;
 // Defined in Zoomit.cpp; compiles to nothing in Release builds.
 void OutputDebug(const TCHAR* format, ...);
 
+// Rows (columns for the vertical mask pass) per task scheduler grain in the
+// frame-resolution mask and compositing passes.  A 960-pixel row is only a
+// few microseconds of work, so single rows would spend more time on
+// scheduling than computing.
+constexpr int kFrameRowGrain = 8;
+constexpr int kFrameColumnGrain = 16;
+
 //----------------------------------------------------------------------------
 // BackgroundBlur::Initialize
 //
@@ -315,34 +324,37 @@ bool BackgroundBlur::RunSegmentation( const uint8_t* bgraPixels, uint32_t width,
         // to produce smooth edges instead of staircase artifacts.
         const size_t maskPixels = static_cast<size_t>( width ) * height;
         m_mask.resize( maskPixels );
-        for( uint32_t y = 0; y < height; y++ )
+        ParallelFor( 0, static_cast<int>( height ), kFrameRowGrain, [&]( int rowBegin, int rowEnd )
         {
-            float srcYf = ( y + 0.5f ) * outH / static_cast<float>( height ) - 0.5f;
-            srcYf = (std::max)( 0.0f, (std::min)( srcYf, static_cast<float>( outH - 1 ) ) );
-            int64_t y0 = static_cast<int64_t>( srcYf );
-            int64_t y1 = (std::min)( y0 + 1, outH - 1 );
-            float fy = srcYf - y0;
-
-            for( uint32_t x = 0; x < width; x++ )
+            for( uint32_t y = static_cast<uint32_t>( rowBegin ); y < static_cast<uint32_t>( rowEnd ); y++ )
             {
-                float srcXf = ( x + 0.5f ) * outW / static_cast<float>( width ) - 0.5f;
-                srcXf = (std::max)( 0.0f, (std::min)( srcXf, static_cast<float>( outW - 1 ) ) );
-                int64_t x0 = static_cast<int64_t>( srcXf );
-                int64_t x1 = (std::min)( x0 + 1, outW - 1 );
-                float fx = srcXf - x0;
-
-                float v00 = m_erodeBuf[static_cast<size_t>(y0 * outW + x0)];
-                float v01 = m_erodeBuf[static_cast<size_t>(y0 * outW + x1)];
-                float v10 = m_erodeBuf[static_cast<size_t>(y1 * outW + x0)];
-                float v11 = m_erodeBuf[static_cast<size_t>(y1 * outW + x1)];
-
-                m_mask[static_cast<size_t>( y ) * width + x] =
-                    v00 * ( 1.0f - fx ) * ( 1.0f - fy ) +
-                    v01 * fx * ( 1.0f - fy ) +
-                    v10 * ( 1.0f - fx ) * fy +
-                    v11 * fx * fy;
+                float srcYf = ( y + 0.5f ) * outH / static_cast<float>( height ) - 0.5f;
+                srcYf = (std::max)( 0.0f, (std::min)( srcYf, static_cast<float>( outH - 1 ) ) );
+                int64_t y0 = static_cast<int64_t>( srcYf );
+                int64_t y1 = (std::min)( y0 + 1, outH - 1 );
+                float fy = srcYf - y0;
+
+                for( uint32_t x = 0; x < width; x++ )
+                {
+                    float srcXf = ( x + 0.5f ) * outW / static_cast<float>( width ) - 0.5f;
+                    srcXf = (std::max)( 0.0f, (std::min)( srcXf, static_cast<float>( outW - 1 ) ) );
+                    int64_t x0 = static_cast<int64_t>( srcXf );
+                    int64_t x1 = (std::min)( x0 + 1, outW - 1 );
+                    float fx = srcXf - x0;
+
+                    float v00 = m_erodeBuf[static_cast<size_t>(y0 * outW + x0)];
+                    float v01 = m_erodeBuf[static_cast<size_t>(y0 * outW + x1)];
+                    float v10 = m_erodeBuf[static_cast<size_t>(y1 * outW + x0)];
+                    float v11 = m_erodeBuf[static_cast<size_t>(y1 * outW + x1)];
+
+                    m_mask[static_cast<size_t>( y ) * width + x] =
+                        v00 * ( 1.0f - fx ) * ( 1.0f - fy ) +
+                        v01 * fx * ( 1.0f - fy ) +
+                        v10 * ( 1.0f - fx ) * fy +
+                        v11 * fx * fy;
+                }
             }
-        }
+        } );
 
         // Apply a small box blur to the upscaled mask to feather edges.
         const int maskBlurRadius = 3;
@@ -350,44 +362,50 @@ bool BackgroundBlur::RunSegmentation( const uint8_t* bgraPixels, uint32_t width,
         m_maskBlurBuf.resize( maskPixels );
 
         // Horizontal pass.
-        for( uint32_t y = 0; y < height; y++ )
+        ParallelFor( 0, static_cast<int>( height ), kFrameRowGrain, [&]( int rowBegin, int rowEnd )
         {
-            const float* srcRow = m_mask.data() + static_cast<size_t>( y ) * width;
-            float* dstRow = m_maskBlurBuf.data() + static_cast<size_t>( y ) * width;
-            float sum = 0.0f;
+            for( uint32_t y = static_cast<uint32_t>( rowBegin ); y < static_cast<uint32_t>( rowEnd ); y++ )
+            {
+                const float* srcRow = m_mask.data() + static_cast<size_t>( y ) * width;
+                float* dstRow = m_maskBlurBuf.data() + static_cast<size_t>( y ) * width;
+                float sum = 0.0f;
 
-            for( int i = -maskBlurRadius; i <= maskBlurRadius; i++ )
-                sum += srcRow[(std::max)( 0, (std::min)( static_cast<int>( width ) - 1, i ) )];
+                for( int i = -maskBlurRadius; i <= maskBlurRadius; i++ )
+                    sum += srcRow[(std::max)( 0, (std::min)( static_cast<int>( width ) - 1, i ) )];
 
-            for( uint32_t x = 0; x < width; x++ )
-            {
-                dstRow[x] = sum / maskDiam;
-                int remX = (std::max)( 0, static_cast<int>( x ) - maskBlurRadius );
-                int addX = (std::min)( static_cast<int>( width ) - 1, static_cast<int>( x ) + maskBlurRadius + 1 );
-                sum += srcRow[addX] - srcRow[remX];
+                for( uint32_t x = 0; x < width; x++ )
+                {
+                    dstRow[x] = sum / maskDiam;
+                    int remX = (std::max)( 0, static_cast<int>( x ) - maskBlurRadius );
+                    int addX = (std::min)( static_cast<int>( width ) - 1, static_cast<int>( x ) + maskBlurRadius + 1 );
+                    sum += srcRow[addX] - srcRow[remX];
+                }
             }
-        }
+        } );
 
         // Vertical pass.
-        for( uint32_t x = 0; x < width; x++ )
+        ParallelFor( 0, static_cast<int>( width ), kFrameColumnGrain, [&]( int columnBegin, int columnEnd )
         {
-            float sum = 0.0f;
-
-            for( int i = -maskBlurRadius; i <= maskBlurRadius; i++ )
+            for( uint32_t x = static_cast<uint32_t>( columnBegin ); x < static_cast<uint32_t>( columnEnd ); x++ )
             {
-                int iy = (std::max)( 0, (std::min)( static_cast<int>( height ) - 1, i ) );
-                sum += m_maskBlurBuf[static_cast<size_t>( iy ) * width + x];
-            }
+                float sum = 0.0f;
 
-            for( uint32_t y = 0; y < height; y++ )
-            {
-                m_mask[static_cast<size_t>( y ) * width + x] = sum / maskDiam;
-                int remY = (std::max)( 0, static_cast<int>( y ) - maskBlurRadius );
-                int addY = (std::min)( static_cast<int>( height ) - 1, static_cast<int>( y ) + maskBlurRadius + 1 );
-                sum += m_maskBlurBuf[static_cast<size_t>( addY ) * width + x] -
-                       m_maskBlurBuf[static_cast<size_t>( remY ) * width + x];
+                for( int i = -maskBlurRadius; i <= maskBlurRadius; i++ )
+                {
+                    int iy = (std::max)( 0, (std::min)( static_cast<int>( height ) - 1, i ) );
+                    sum += m_maskBlurBuf[static_cast<size_t>( iy ) * width + x];
+                }
+
+                for( uint32_t y = 0; y < height; y++ )
+                {
+                    m_mask[static_cast<size_t>( y ) * width + x] = sum / maskDiam;
+                    int remY = (std::max)( 0, static_cast<int>( y ) - maskBlurRadius );
+                    int addY = (std::min)( static_cast<int>( height ) - 1, static_cast<int>( y ) + maskBlurRadius + 1 );
+                    sum += m_maskBlurBuf[static_cast<size_t>( addY ) * width + x] -
+                           m_maskBlurBuf[static_cast<size_t>( remY ) * width + x];
+                }
             }
-        }
+        } );
 
         // Temporal smoothing: blend the current mask with the previous
         // frame's mask to stabilize edges and reduce flicker.  A weight
@@ -417,143 +435,23 @@ bool BackgroundBlur::RunSegmentation( const uint8_t* bgraPixels, uint32_t width,
     }
 }
 
-//----------------------------------------------------------------------------
-// HorizontalBoxBlur / VerticalBoxBlur
-//
-// Separable box blur passes used to build an approximate Gaussian.
-//----------------------------------------------------------------------------
-static void HorizontalBoxBlur(
-    const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, int radius )
-{
-    const int diameter = radius * 2 + 1;
-    for( uint32_t y = 0; y < height; y++ )
-    {
-        int rSum = 0, gSum = 0, bSum = 0;
-        const uint8_t* row = src + static_cast<size_t>( y ) * width * 4;
-
-        // Initialize window with clamped left edge.
-        for( int i = -radius; i <= radius; i++ )
-        {
-            int ix = (std::max)( 0, (std::min)( static_cast<int>( width ) - 1, i ) );
-            const uint8_t* px = row + ix * 4;
-            bSum += px[0];
-            gSum += px[1];
-            rSum += px[2];
-        }
-
-        uint8_t* dstRow = dst + static_cast<size_t>( y ) * width * 4;
-        for( uint32_t x = 0; x < width; x++ )
-        {
-            dstRow[x * 4 + 0] = static_cast<uint8_t>( bSum / diameter );
-            dstRow[x * 4 + 1] = static_cast<uint8_t>( gSum / diameter );
-            dstRow[x * 4 + 2] = static_cast<uint8_t>( rSum / diameter );
-            dstRow[x * 4 + 3] = 0xFF;
-
-            // Slide window: add right, remove left.
-            int removeX = (std::max)( 0, static_cast<int>( x ) - radius );
-            int addX = (std::min)( static_cast<int>( width ) - 1, static_cast<int>( x ) + radius + 1 );
-            const uint8_t* remPx = row + removeX * 4;
-            const uint8_t* addPx = row + addX * 4;
-            bSum += addPx[0] - remPx[0];
-            gSum += addPx[1] - remPx[1];
-            rSum += addPx[2] - remPx[2];
-        }
-    }
-}
-
-static void VerticalBoxBlur(
-    const uint8_t* src, uint8_t* dst, uint32_t width, uint32_t height, int radius )
-{
-    const int diameter = radius * 2 + 1;
-    for( uint32_t x = 0; x < width; x++ )
-    {
-        int rSum = 0, gSum = 0, bSum = 0;
-
-        // Initialize window with clamped top edge.
-        for( int i = -radius; i <= radius; i++ )
-        {
-            int iy = (std::max)( 0, (std::min)( static_cast<int>( height ) - 1, i ) );
-            const uint8_t* px = src + ( static_cast<size_t>( iy ) * width + x ) * 4;
-            bSum += px[0];
-            gSum += px[1];
-            rSum += px[2];
-        }
-
-        for( uint32_t y = 0; y < height; y++ )
-        {
-            uint8_t* dstPx = dst + ( static_cast<size_t>( y ) * width + x ) * 4;
-            dstPx[0] = static_cast<uint8_t>( bSum / diameter );
-            dstPx[1] = static_cast<uint8_t>( gSum / diameter );
-            dstPx[2] = static_cast<uint8_t>( rSum / diameter );
-            dstPx[3] = 0xFF;
-
-            int removeY = (std::max)( 0, static_cast<int>( y ) - radius );
-            int addY = (std::min)( static_cast<int>( height ) - 1, static_cast<int>( y ) + radius + 1 );
-            const uint8_t* remPx = src + ( static_cast<size_t>( removeY ) * width + x ) * 4;
-            const uint8_t* addPx = src + ( static_cast<size_t>( addY ) * width + x ) * 4;
-            bSum += addPx[0] - remPx[0];
-            gSum += addPx[1] - remPx[1];
-            rSum += addPx[2] - remPx[2];
-        }
-    }
-}
-
 //----------------------------------------------------------------------------
 // BackgroundBlur::ApplyBlurWithMask
 //
-// Downscales the frame to a small working size, blurs there, then
-// performs a single full-resolution pass that blends the original
-// pixels with the upscaled blurred pixels according to the mask.
+// Blurs the frame and blends the blurred pixels into the background
+// according to the mask (see BackgroundBlurKernels.cpp).
 //----------------------------------------------------------------------------
 void BackgroundBlur::ApplyBlurWithMask( uint8_t* bgraPixels, uint32_t width, uint32_t height, int blurRadius )
 {
-    const size_t frameBytes = static_cast<size_t>( width ) * height * 4;
-    m_blurredFrame.resize( frameBytes );
-    m_tempFrame.resize( frameBytes );
-
     // The input is already capped at 960×540 by WebcamCapture, so blur
     // directly — no need for a secondary downscale.
     int effectiveRadius = (std::max)( 3, blurRadius );
 
-    // 2 iterations of box blur → approximate Gaussian.
-    HorizontalBoxBlur( bgraPixels, m_blurredFrame.data(), width, height, effectiveRadius );
-    VerticalBoxBlur( m_blurredFrame.data(), m_tempFrame.data(), width, height, effectiveRadius );
-    HorizontalBoxBlur( m_tempFrame.data(), m_blurredFrame.data(), width, height, effectiveRadius );
-    VerticalBoxBlur( m_blurredFrame.data(), m_tempFrame.data(), width, height, effectiveRadius );
-
-    // Blend pass with alpha support for smooth mask edges.
-    const uint8_t* blurData = m_tempFrame.data();
-    for( uint32_t y = 0; y < height; y++ )
-    {
-        uint8_t* dstRow = bgraPixels + static_cast<size_t>( y ) * width * 4;
-        const uint8_t* blurRow = blurData + static_cast<size_t>( y ) * width * 4;
-        const float* maskRow = m_mask.data() + static_cast<size_t>( y ) * width;
-
-        for( uint32_t x = 0; x < width; x++ )
-        {
-            float maskVal = maskRow[x];
-
-            // Fast path: fully person → keep original pixel untouched.
-            if( maskVal >= 1.0f )
-                continue;
-
-            uint8_t* dp = dstRow + x * 4;
-            const uint8_t* bp = blurRow + x * 4;
-
-            // Fast path: fully background → copy blurred pixel.
-            if( maskVal <= 0.0f )
-            {
-                *reinterpret_cast<uint32_t*>( dp ) = *reinterpret_cast<const uint32_t*>( bp );
-                continue;
-            }
-
-            // Edge pixel → alpha blend original and blurred.
-            float inv = 1.0f - maskVal;
-            dp[0] = static_cast<uint8_t>( dp[0] * maskVal + bp[0] * inv + 0.5f );
-            dp[1] = static_cast<uint8_t>( dp[1] * maskVal + bp[1] * inv + 0.5f );
-            dp[2] = static_cast<uint8_t>( dp[2] * maskVal + bp[2] * inv + 0.5f );
-        }
-    }
+    // 2 iterations of box blur → approximate Gaussian, with the mask blend
+    // fused into the last vertical pass.  The blurred frame stays in
+    // m_tempFrame for GetBlurredFrame().
+    BlurAndBlendBackground( bgraPixels, m_mask.data(), width, height, effectiveRadius,
+                            m_tempFrame, m_blurredFrame, &m_lastTimings );
 }
 
 //----------------------------------------------------------------------------
@@ -691,37 +589,40 @@ void BackgroundBlur::ApplyImageWithMask( uint8_t* bgraPixels, uint32_t width, ui
 
     const uint8_t* bgData = m_scaledBgImage.data();
 
-    for( uint32_t y = 0; y < height; y++ )
+    ParallelFor( 0, static_cast<int>( height ), kFrameRowGrain, [&]( int rowBegin, int rowEnd )
     {
-        uint8_t* dstRow = bgraPixels + static_cast<size_t>( y ) * width * 4;
-        const uint8_t* bgRow = bgData + static_cast<size_t>( y ) * width * 4;
-        const float* maskRow = m_mask.data() + static_cast<size_t>( y ) * width;
-
-        for( uint32_t x = 0; x < width; x++ )
+        for( uint32_t y = static_cast<uint32_t>( rowBegin ); y < static_cast<uint32_t>( rowEnd ); y++ )
         {
-            float maskVal = maskRow[x];
+            uint8_t* dstRow = bgraPixels + static_cast<size_t>( y ) * width * 4;
+            const uint8_t* bgRow = bgData + static_cast<size_t>( y ) * width * 4;
+            const float* maskRow = m_mask.data() + static_cast<size_t>( y ) * width;
+
+            for( uint32_t x = 0; x < width; x++ )
+            {
+                float maskVal = maskRow[x];
 
-            // Fully person → keep original pixel.
-            if( maskVal >= 1.0f )
-                continue;
+                // Fully person → keep original pixel.
+                if( maskVal >= 1.0f )
+                    continue;
 
-            uint8_t* dp = dstRow + x * 4;
-            const uint8_t* bp = bgRow + x * 4;
+                uint8_t* dp = dstRow + x * 4;
+                const uint8_t* bp = bgRow + x * 4;
 
-            // Fully background → copy background image pixel.
-            if( maskVal <= 0.0f )
-            {
-                *reinterpret_cast<uint32_t*>( dp ) = *reinterpret_cast<const uint32_t*>( bp );
-                continue;
-            }
+                // Fully background → copy background image pixel.
+                if( maskVal <= 0.0f )
+                {
+                    *reinterpret_cast<uint32_t*>( dp ) = *reinterpret_cast<const uint32_t*>( bp );
+                    continue;
+                }
 
-            // Edge pixel → alpha blend person and background image.
-            float inv = 1.0f - maskVal;
-            dp[0] = static_cast<uint8_t>( dp[0] * maskVal + bp[0] * inv + 0.5f );
-            dp[1] = static_cast<uint8_t>( dp[1] * maskVal + bp[1] * inv + 0.5f );
-            dp[2] = static_cast<uint8_t>( dp[2] * maskVal + bp[2] * inv + 0.5f );
+                // Edge pixel → alpha blend person and background image.
+                float inv = 1.0f - maskVal;
+                dp[0] = static_cast<uint8_t>( dp[0] * maskVal + bp[0] * inv + 0.5f );
+                dp[1] = static_cast<uint8_t>( dp[1] * maskVal + bp[1] * inv + 0.5f );
+                dp[2] = static_cast<uint8_t>( dp[2] * maskVal + bp[2] * inv + 0.5f );
+            }
         }
-    }
+    } );
 }
 
 //----------------------------------------------------------------------------
@@ -817,6 +718,11 @@ bool BackgroundBlur::Apply( uint8_t* bgraPixels, uint32_t width, uint32_t height
     if( !m_session || !bgraPixels || width == 0 || height == 0 )
         return false;
 
+    using Clock = std::chrono::steady_clock;
+    using Milliseconds = std::chrono::duration<double, std::milli>;
+    const auto start = Clock::now();
+
+    m_lastTimings = {};
     if( ShouldRunInference( bgraPixels, width, height ) )
     {
         if( !RunSegmentation( bgraPixels, width, height ) )
@@ -826,8 +732,29 @@ bool BackgroundBlur::Apply( uint8_t* bgraPixels, uint32_t width, uint32_t height
         m_hasCachedMask = true;
     }
     m_frameCounter++;
+    const auto segmented = Clock::now();
+    m_lastTimings.segmentationMs = Milliseconds( segmented - start ).count();
 
     ApplyBlurWithMask( bgraPixels, width, height, blurRadius );
+    m_lastTimings.totalMs = Milliseconds( Clock::now() - start ).count();
+
+    // Report the running average now and then so regressions show up in
+    // the debugger output without a profiler attached.
+    m_timingTotals.segmentationMs += m_lastTimings.segmentationMs;
+    m_timingTotals.horizontalMs += m_lastTimings.horizontalMs;
+    m_timingTotals.verticalMs += m_lastTimings.verticalMs;
+    m_timingTotals.totalMs += m_lastTimings.totalMs;
+    if( ++m_timedFrames == kTimingReportFrames )
+    {
+        OutputDebug( L"[BackgroundBlur] %ux%u %S avg over %d frames: segmentation %.2f ms, horizontal %.2f ms, vertical+blend %.2f ms, total %.2f ms\n",
+                     width, height, BackgroundBlurKernelName(), m_timedFrames,
+                     m_timingTotals.segmentationMs / m_timedFrames,
+                     m_timingTotals.horizontalMs / m_timedFrames,
+                     m_timingTotals.verticalMs / m_timedFrames,
+                     m_timingTotals.totalMs / m_timedFrames );
+        m_timingTotals = {};
+        m_timedFrames = 0;
+    }
     return true;
 }
 
@@ -17,6 +17,7 @@
 #include <string>
 #include <cstdint>
 #include <winrt/Windows.AI.MachineLearning.h>
+#include "BackgroundBlurKernels.h"
 
 // Background processing mode for the webcam overlay.
 enum class WebcamBackgroundMode : uint32_t
@@ -82,6 +83,9 @@ public:
     int64_t GetModelMaskWidth() const { return m_modelOutputWidth; }
     int64_t GetModelMaskHeight() const { return m_modelOutputHeight; }
 
+    // Per-stage timings of the last Apply() call.
+    const BackgroundBlurTimings& GetLastTimings() const { return m_lastTimings; }
+
 private:
     // Run the segmentation model and produce a float mask [0..1] per pixel.
     // When modelResOnly is true, stops after model-resolution post-processing
@@ -157,4 +161,11 @@ private:
 
     // Model-resolution previous mask for GPU path temporal smoothing.
     std::vector<float>      m_prevModelMask;
+
+    // Per-frame timing counters for Apply(), averaged to the debug output
+    // every kTimingReportFrames frames.
+    static constexpr int    kTimingReportFrames = 300;
+    BackgroundBlurTimings   m_lastTimings = {};
+    BackgroundBlurTimings   m_timingTotals = {};
+    int                     m_timedFrames = 0;
 };
@@ -0,0 +1,673 @@
+//============================================================================
+//
+// BackgroundBlurKernels.cpp
+//
+// Separable box blur and mask blend for the webcam background blur.
+//
+// The horizontal pass keeps a running window sum per row and emits two
+// pixels per step.  The vertical pass walks tiles of 16 adjacent pixels
+// (a cache line of each row) down the frame instead of single columns, so
+// every row access uses a whole line; the final vertical pass blends each
+// tile into the frame while it is still in cache instead of making another
+// full-frame pass.  Window sums live in 16-bit lanes and are divided by the
+// window size with a fixed-point reciprocal multiply plus a one-step
+// correction, which is exact, so every instruction set produces the same
+// pixels as the original integer division.
+//
+// This file must not depend on Windows ML or GDI so the blur benchmark can
+// build it on Linux.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//
+//============================================================================
+#include "BackgroundBlurKernels.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BLUR_KERNELS_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define BLUR_KERNELS_AVX2_FUNCTION
+#else
+#define BLUR_KERNELS_AVX2_FUNCTION __attribute__(( target( "avx2" ) ))
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define BLUR_KERNELS_NEON
+#include <arm_neon.h>
+#endif
+
+// Pixels per vertical-pass tile: one 64-byte line of every row it walks.
+constexpr int kVerticalTilePixels = 16;
+
+// Scheduler grains.  A row or a tile column is a few microseconds of work
+// at webcam resolutions.
+constexpr int kHorizontalRowGrain = 8;
+constexpr int kVerticalTileGrain = 2;
+
+struct BoxDivisor
+{
+    uint32_t diameter;
+    uint32_t reciprocal;    // floor( 65536 / diameter )
+};
+
+#if defined(BLUR_KERNELS_SSE2)
+static bool CpuSupportsAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4]{};
+    __cpuid( info, 0 );
+    if( info[0] < 7 )
+    {
+        return false;
+    }
+    __cpuid( info, 1 );
+    const bool osSavesYmm = ( info[2] & ( 1 << 27 ) ) != 0 && ( info[2] & ( 1 << 28 ) ) != 0 &&
+                            ( _xgetbv( 0 ) & 6 ) == 6;
+    if( !osSavesYmm )
+    {
+        return false;
+    }
+    __cpuidex( info, 7, 0 );
+    return ( info[1] & ( 1 << 5 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+static const bool g_UseAvx2 = CpuSupportsAvx2();
+#endif
+
+//----------------------------------------------------------------------------
+// DivideByDiameter
+//
+// floor( sum / diameter ) for sum < 65536.  The reciprocal estimate is low
+// by at most one, which the remainder check corrects.
+//----------------------------------------------------------------------------
+static inline int DivideByDiameter( int sum, const BoxDivisor& divisor )
+{
+    const uint32_t value = static_cast<uint32_t>( sum );
+    uint32_t quotient = ( value * divisor.reciprocal ) >> 16;
+    if( value - quotient * divisor.diameter >= divisor.diameter )
+    {
+        quotient++;
+    }
+    return static_cast<int>( quotient );
+}
+
+#if defined(BLUR_KERNELS_SSE2)
+static inline __m128i DivideByDiameterSse2( __m128i sums, __m128i reciprocal, __m128i diameter, __m128i diameterMinusOne )
+{
+    const __m128i quotient = _mm_mulhi_epu16( sums, reciprocal );
+    const __m128i remainder = _mm_sub_epi16( sums, _mm_mullo_epi16( quotient, diameter ) );
+    return _mm_sub_epi16( quotient, _mm_cmpgt_epi16( remainder, diameterMinusOne ) );
+}
+
+BLUR_KERNELS_AVX2_FUNCTION
+static inline __m256i DivideByDiameterAvx2( __m256i sums, __m256i reciprocal, __m256i diameter, __m256i diameterMinusOne )
+{
+    const __m256i quotient = _mm256_mulhi_epu16( sums, reciprocal );
+    const __m256i remainder = _mm256_sub_epi16( sums, _mm256_mullo_epi16( quotient, diameter ) );
+    return _mm256_sub_epi16( quotient, _mm256_cmpgt_epi16( remainder, diameterMinusOne ) );
+}
+#elif defined(BLUR_KERNELS_NEON)
+static inline uint16x8_t DivideByDiameterNeon( uint16x8_t sums, uint16x8_t reciprocal, uint16x8_t diameter )
+{
+    const uint16x8_t quotient = vcombine_u16( vshrn_n_u32( vmull_u16( vget_low_u16( sums ), vget_low_u16( reciprocal ) ), 16 ),
+                                              vshrn_n_u32( vmull_high_u16( sums, reciprocal ), 16 ) );
+    const uint16x8_t remainder = vsubq_u16( sums, vmulq_u16( quotient, diameter ) );
+    return vsubq_u16( quotient, vcgeq_u16( remainder, diameter ) );
+}
+#endif
+
+//----------------------------------------------------------------------------
+// BlendBlurredSpan
+//
+// Mask blend of count pixels: person pixels (mask 1) keep the frame,
+// background pixels (mask 0) take the blurred pixel, edge pixels mix the
+// two.  Runs of four uniform mask values skip the per-pixel work.
+//----------------------------------------------------------------------------
+static inline void BlendBlurredPixel( uint8_t* dp, const uint8_t* bp, float maskVal )
+{
+    if( maskVal >= 1.0f )
+    {
+        return;
+    }
+    if( maskVal <= 0.0f )
+    {
+        memcpy( dp, bp, 4 );
+        return;
+    }
+    const float inv = 1.0f - maskVal;
+    dp[0] = static_cast<uint8_t>( dp[0] * maskVal + bp[0] * inv + 0.5f );
+    dp[1] = static_cast<uint8_t>( dp[1] * maskVal + bp[1] * inv + 0.5f );
+    dp[2] = static_cast<uint8_t>( dp[2] * maskVal + bp[2] * inv + 0.5f );
+}
+
+static void BlendBlurredSpan( uint8_t* framePixels, const uint8_t* blurredPixels, const float* mask, int count )
+{
+    int i = 0;
+#if defined(BLUR_KERNELS_SSE2)
+    const __m128 one = _mm_set1_ps( 1.0f );
+    const __m128 zero = _mm_setzero_ps();
+    for( ; i + 4 <= count; i += 4 )
+    {
+        const __m128 maskValues = _mm_loadu_ps( mask + i );
+        if( _mm_movemask_ps( _mm_cmpge_ps( maskValues, one ) ) == 0xF )
+        {
+            continue;
+        }
+        if( _mm_movemask_ps( _mm_cmple_ps( maskValues, zero ) ) == 0xF )
+        {
+            memcpy( framePixels + i * 4, blurredPixels + i * 4, 16 );
+            continue;
+        }
+        for( int k = i; k < i + 4; k++ )
+        {
+            BlendBlurredPixel( framePixels + k * 4, blurredPixels + k * 4, mask[k] );
+        }
+    }
+#elif defined(BLUR_KERNELS_NEON)
+    const float32x4_t one = vdupq_n_f32( 1.0f );
+    const float32x4_t zero = vdupq_n_f32( 0.0f );
+    for( ; i + 4 <= count; i += 4 )
+    {
+        const float32x4_t maskValues = vld1q_f32( mask + i );
+        if( vminvq_u32( vcgeq_f32( maskValues, one ) ) != 0 )
+        {
+            continue;
+        }
+        if( vminvq_u32( vcleq_f32( maskValues, zero ) ) != 0 )
+        {
+            memcpy( framePixels + i * 4, blurredPixels + i * 4, 16 );
+            continue;
+        }
+        for( int k = i; k < i + 4; k++ )
+        {
+            BlendBlurredPixel( framePixels + k * 4, blurredPixels + k * 4, mask[k] );
+        }
+    }
+#endif
+    for( ; i < count; i++ )
+    {
+        BlendBlurredPixel( framePixels + i * 4, blurredPixels + i * 4, mask[i] );
+    }
+}
+
+//----------------------------------------------------------------------------
+// Horizontal pass
+//
+// Each output pixel is the window sum of the row, clamped at the edges,
+// divided by the diameter; alpha is forced opaque.
+//----------------------------------------------------------------------------
+#if !defined(BLUR_KERNELS_SSE2) && !defined(BLUR_KERNELS_NEON)
+static void HorizontalBoxBlurRowScalar( const uint8_t* row, uint8_t* dstRow, int width, int radius, const BoxDivisor& divisor )
+{
+    int bSum = 0, gSum = 0, rSum = 0;
+    for( int i = -radius; i <= radius; i++ )
+    {
+        const uint8_t* px = row + std::clamp( i, 0, width - 1 ) * 4;
+        bSum += px[0];
+        gSum += px[1];
+        rSum += px[2];
+    }
+
+    for( int x = 0; x < width; x++ )
+    {
+        dstRow[x * 4 + 0] = static_cast<uint8_t>( DivideByDiameter( bSum, divisor ) );
+        dstRow[x * 4 + 1] = static_cast<uint8_t>( DivideByDiameter( gSum, divisor ) );
+        dstRow[x * 4 + 2] = static_cast<uint8_t>( DivideByDiameter( rSum, divisor ) );
+        dstRow[x * 4 + 3] = 0xFF;
+
+        const uint8_t* remPx = row + ( std::max )( 0, x - radius ) * 4;
+        const uint8_t* addPx = row + ( std::min )( width - 1, x + radius + 1 ) * 4;
+        bSum += addPx[0] - remPx[0];
+        gSum += addPx[1] - remPx[1];
+        rSum += addPx[2] - remPx[2];
+    }
+}
+#endif
+
+#if defined(BLUR_KERNELS_SSE2)
+static inline __m128i LoadPixelSse2( const uint8_t* pixel )
+{
+    int32_t value;
+    memcpy( &value, pixel, 4 );
+    return _mm_unpacklo_epi8( _mm_cvtsi32_si128( value ), _mm_setzero_si128() );
+}
+
+static void HorizontalBoxBlurRowSse2( const uint8_t* row, uint8_t* dstRow, int width, int radius, const BoxDivisor& divisor )
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i reciprocal = _mm_set1_epi16( static_cast<short>( divisor.reciprocal ) );
+    const __m128i diameter = _mm_set1_epi16( static_cast<short>( divisor.diameter ) );
+    const __m128i diameterMinusOne = _mm_set1_epi16( static_cast<short>( divisor.diameter - 1 ) );
+    const __m128i opaque = _mm_set1_epi32( static_cast<int>( 0xFF000000u ) );
+
+    // Window sum of the current pixel in the low four 16-bit lanes.
+    __m128i sum = zero;
+    for( int i = -radius; i <= radius; i++ )
+    {
+        sum = _mm_add_epi16( sum, LoadPixelSse2( row + std::clamp( i, 0, width - 1 ) * 4 ) );
+    }
+
+    const auto stepOnePixel = [&]( int x )
+    {
+        const int value = _mm_cvtsi128_si32( _mm_or_si128( _mm_packus_epi16( DivideByDiameterSse2( sum, reciprocal, diameter, diameterMinusOne ), zero ), opaque ) );
+        memcpy( dstRow + x * 4, &value, 4 );
+        sum = _mm_add_epi16( sum, _mm_sub_epi16( LoadPixelSse2( row + ( std::min )( width - 1, x + radius + 1 ) * 4 ),
+                                                 LoadPixelSse2( row + ( std::max )( 0, x - radius ) * 4 ) ) );
+    };
+
+    // Where the window needs no clamping, two pixels are produced per step:
+    // the second sum is the first plus one window step.
+    const int interiorEnd = width - radius - 1;
+    int x = 0;
+    for( ; x < width && x < radius; x++ )
+    {
+        stepOnePixel( x );
+    }
+    for( ; x + 1 < interiorEnd; x += 2 )
+    {
+        const __m128i add = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( row + ( x + radius + 1 ) * 4 ) ), zero );
+        const __m128i rem = _mm_unpacklo_epi8( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( row + ( x - radius ) * 4 ) ), zero );
+        const __m128i delta = _mm_sub_epi16( add, rem );
+        const __m128i sums = _mm_add_epi16( _mm_unpacklo_epi64( sum, sum ), _mm_slli_si128( delta, 8 ) );
+        const __m128i quotient = DivideByDiameterSse2( sums, reciprocal, diameter, diameterMinusOne );
+        _mm_storel_epi64( reinterpret_cast<__m128i*>( dstRow + x * 4 ), _mm_or_si128( _mm_packus_epi16( quotient, zero ), opaque ) );
+        sum = _mm_add_epi16( sum, _mm_add_epi16( delta, _mm_srli_si128( delta, 8 ) ) );
+    }
+    for( ; x < width; x++ )
+    {
+        stepOnePixel( x );
+    }
+}
+#elif defined(BLUR_KERNELS_NEON)
+static inline uint16x8_t LoadPixelNeon( const uint8_t* pixel )
+{
+    uint32_t value;
+    memcpy( &value, pixel, 4 );
+    return vmovl_u8( vreinterpret_u8_u32( vdup_n_u32( value ) ) );
+}
+
+static void HorizontalBoxBlurRowNeon( const uint8_t* row, uint8_t* dstRow, int width, int radius, const BoxDivisor& divisor )
+{
+    const uint16x8_t zero = vdupq_n_u16( 0 );
+    const uint16x8_t reciprocal = vdupq_n_u16( static_cast<uint16_t>( divisor.reciprocal ) );
+    const uint16x8_t diameter = vdupq_n_u16( static_cast<uint16_t>( divisor.diameter ) );
+    const uint8x8_t opaque = vreinterpret_u8_u32( vdup_n_u32( 0xFF000000u ) );
+
+    // Window sum of the current pixel in the low four 16-bit lanes.
+    uint16x8_t sum = zero;
+    for( int i = -radius; i <= radius; i++ )
+    {
+        sum = vaddq_u16( sum, LoadPixelNeon( row + std::clamp( i, 0, width - 1 ) * 4 ) );
+    }
+
+    const auto stepOnePixel = [&]( int x )
+    {
+        const uint8x8_t pixel = vorr_u8( vqmovn_u16( DivideByDiameterNeon( sum, reciprocal, diameter ) ), opaque );
+        const uint32_t value = vget_lane_u32( vreinterpret_u32_u8( pixel ), 0 );
+        memcpy( dstRow + x * 4, &value, 4 );
+        sum = vaddq_u16( sum, vsubq_u16( LoadPixelNeon( row + ( std::min )( width - 1, x + radius + 1 ) * 4 ),
+                                         LoadPixelNeon( row + ( std::max )( 0, x - radius ) * 4 ) ) );
+    };
+
+    // Where the window needs no clamping, two pixels are produced per step:
+    // the second sum is the first plus one window step.
+    const int interiorEnd = width - radius - 1;
+    int x = 0;
+    for( ; x < width && x < radius; x++ )
+    {
+        stepOnePixel( x );
+    }
+    for( ; x + 1 < interiorEnd; x += 2 )
+    {
+        const uint16x8_t delta = vsubq_u16( vmovl_u8( vld1_u8( row + ( x + radius + 1 ) * 4 ) ),
+                                            vmovl_u8( vld1_u8( row + ( x - radius ) * 4 ) ) );
+        const uint16x8_t sums = vaddq_u16( vcombine_u16( vget_low_u16( sum ), vget_low_u16( sum ) ), vextq_u16( zero, delta, 4 ) );
+        vst1_u8( dstRow + x * 4, vorr_u8( vqmovn_u16( DivideByDiameterNeon( sums, reciprocal, diameter ) ), opaque ) );
+        sum = vaddq_u16( sum, vaddq_u16( delta, vextq_u16( delta, delta, 4 ) ) );
+    }
+    for( ; x < width; x++ )
+    {
+        stepOnePixel( x );
+    }
+}
+#endif
+
+static void HorizontalBoxBlur( const uint8_t* src, uint8_t* dst, int width, int height, int radius, const BoxDivisor& divisor )
+{
+    ParallelFor( 0, height, kHorizontalRowGrain, [&]( int rowBegin, int rowEnd )
+    {
+        for( int y = rowBegin; y < rowEnd; y++ )
+        {
+            const uint8_t* row = src + static_cast<size_t>( y ) * width * 4;
+            uint8_t* dstRow = dst + static_cast<size_t>( y ) * width * 4;
+#if defined(BLUR_KERNELS_SSE2)
+            HorizontalBoxBlurRowSse2( row, dstRow, width, radius, divisor );
+#elif defined(BLUR_KERNELS_NEON)
+            HorizontalBoxBlurRowNeon( row, dstRow, width, radius, divisor );
+#else
+            HorizontalBoxBlurRowScalar( row, dstRow, width, radius, divisor );
+#endif
+        }
+    } );
+}
+
+//----------------------------------------------------------------------------
+// Vertical pass
+//
+// Each tile function walks count pixels starting at column x0 down every
+// row, keeping the window sums of all of them, so each row access reads
+// and writes contiguous bytes.
+//----------------------------------------------------------------------------
+static void VerticalBoxBlurTileScalar( const uint8_t* src, uint8_t* dst, int width, int height, int radius,
+                                       const BoxDivisor& divisor, int x0, int count )
+{
+    const size_t stride = static_cast<size_t>( width ) * 4;
+    int sums[kVerticalTilePixels * 3]{};
+    for( int i = -radius; i <= radius; i++ )
+    {
+        const uint8_t* row = src + std::clamp( i, 0, height - 1 ) * stride + x0 * 4;
+        for( int p = 0; p < count; p++ )
+        {
+            sums[p * 3 + 0] += row[p * 4 + 0];
+            sums[p * 3 + 1] += row[p * 4 + 1];
+            sums[p * 3 + 2] += row[p * 4 + 2];
+        }
+    }
+
+    for( int y = 0; y < height; y++ )
+    {
+        uint8_t* dstRow = dst + y * stride + x0 * 4;
+        const uint8_t* remRow = src + ( std::max )( 0, y - radius ) * stride + x0 * 4;
+        const uint8_t* addRow = src + ( std::min )( height - 1, y + radius + 1 ) * stride + x0 * 4;
+        for( int p = 0; p < count; p++ )
+        {
+            for( int c = 0; c < 3; c++ )
+            {
+                dstRow[p * 4 + c] = static_cast<uint8_t>( DivideByDiameter( sums[p * 3 + c], divisor ) );
+                sums[p * 3 + c] += addRow[p * 4 + c] - remRow[p * 4 + c];
+            }
+            dstRow[p * 4 + 3] = 0xFF;
+        }
+    }
+}
+
+#if defined(BLUR_KERNELS_SSE2)
+static void VerticalBoxBlurTileSse2( const uint8_t* src, uint8_t* dst, int width, int height, int radius,
+                                     const BoxDivisor& divisor, int x0, int chunkCount )
+{
+    const size_t stride = static_cast<size_t>( width ) * 4;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i reciprocal = _mm_set1_epi16( static_cast<short>( divisor.reciprocal ) );
+    const __m128i diameter = _mm_set1_epi16( static_cast<short>( divisor.diameter ) );
+    const __m128i diameterMinusOne = _mm_set1_epi16( static_cast<short>( divisor.diameter - 1 ) );
+    const __m128i opaque = _mm_set1_epi32( static_cast<int>( 0xFF000000u ) );
+
+    // Four pixels per chunk: the low and high pixel pairs in 16-bit lanes.
+    __m128i sumsLow[kVerticalTilePixels / 4];
+    __m128i sumsHigh[kVerticalTilePixels / 4];
+    for( int c = 0; c < chunkCount; c++ )
+    {
+        sumsLow[c] = zero;
+        sumsHigh[c] = zero;
+    }
+    for( int i = -radius; i <= radius; i++ )
+    {
+        const uint8_t* row = src + std::clamp( i, 0, height - 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const __m128i pixels = _mm_loadu_si128( reinterpret_cast<const __m128i*>( row + c * 16 ) );
+            sumsLow[c] = _mm_add_epi16( sumsLow[c], _mm_unpacklo_epi8( pixels, zero ) );
+            sumsHigh[c] = _mm_add_epi16( sumsHigh[c], _mm_unpackhi_epi8( pixels, zero ) );
+        }
+    }
+
+    for( int y = 0; y < height; y++ )
+    {
+        uint8_t* dstRow = dst + y * stride + x0 * 4;
+        const uint8_t* remRow = src + ( std::max )( 0, y - radius ) * stride + x0 * 4;
+        const uint8_t* addRow = src + ( std::min )( height - 1, y + radius + 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const __m128i quotient = _mm_packus_epi16( DivideByDiameterSse2( sumsLow[c], reciprocal, diameter, diameterMinusOne ),
+                                                       DivideByDiameterSse2( sumsHigh[c], reciprocal, diameter, diameterMinusOne ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( dstRow + c * 16 ), _mm_or_si128( quotient, opaque ) );
+
+            const __m128i add = _mm_loadu_si128( reinterpret_cast<const __m128i*>( addRow + c * 16 ) );
+            const __m128i rem = _mm_loadu_si128( reinterpret_cast<const __m128i*>( remRow + c * 16 ) );
+            sumsLow[c] = _mm_sub_epi16( _mm_add_epi16( sumsLow[c], _mm_unpacklo_epi8( add, zero ) ), _mm_unpacklo_epi8( rem, zero ) );
+            sumsHigh[c] = _mm_sub_epi16( _mm_add_epi16( sumsHigh[c], _mm_unpackhi_epi8( add, zero ) ), _mm_unpackhi_epi8( rem, zero ) );
+        }
+    }
+}
+
+BLUR_KERNELS_AVX2_FUNCTION
+static void VerticalBoxBlurTileAvx2( const uint8_t* src, uint8_t* dst, int width, int height, int radius,
+                                     const BoxDivisor& divisor, int x0, int chunkCount )
+{
+    const size_t stride = static_cast<size_t>( width ) * 4;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i reciprocal = _mm256_set1_epi16( static_cast<short>( divisor.reciprocal ) );
+    const __m256i diameter = _mm256_set1_epi16( static_cast<short>( divisor.diameter ) );
+    const __m256i diameterMinusOne = _mm256_set1_epi16( static_cast<short>( divisor.diameter - 1 ) );
+    const __m256i opaque = _mm256_set1_epi32( static_cast<int>( 0xFF000000u ) );
+
+    // Eight pixels per chunk.  The unpacks and the final pack both work
+    // within 128-bit halves, so pixel order survives the round trip.
+    __m256i sumsLow[kVerticalTilePixels / 8];
+    __m256i sumsHigh[kVerticalTilePixels / 8];
+    for( int c = 0; c < chunkCount; c++ )
+    {
+        sumsLow[c] = zero;
+        sumsHigh[c] = zero;
+    }
+    for( int i = -radius; i <= radius; i++ )
+    {
+        const uint8_t* row = src + std::clamp( i, 0, height - 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const __m256i pixels = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( row + c * 32 ) );
+            sumsLow[c] = _mm256_add_epi16( sumsLow[c], _mm256_unpacklo_epi8( pixels, zero ) );
+            sumsHigh[c] = _mm256_add_epi16( sumsHigh[c], _mm256_unpackhi_epi8( pixels, zero ) );
+        }
+    }
+
+    for( int y = 0; y < height; y++ )
+    {
+        uint8_t* dstRow = dst + y * stride + x0 * 4;
+        const uint8_t* remRow = src + ( std::max )( 0, y - radius ) * stride + x0 * 4;
+        const uint8_t* addRow = src + ( std::min )( height - 1, y + radius + 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const __m256i quotient = _mm256_packus_epi16( DivideByDiameterAvx2( sumsLow[c], reciprocal, diameter, diameterMinusOne ),
+                                                          DivideByDiameterAvx2( sumsHigh[c], reciprocal, diameter, diameterMinusOne ) );
+            _mm256_storeu_si256( reinterpret_cast<__m256i*>( dstRow + c * 32 ), _mm256_or_si256( quotient, opaque ) );
+
+            const __m256i add = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( addRow + c * 32 ) );
+            const __m256i rem = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( remRow + c * 32 ) );
+            sumsLow[c] = _mm256_sub_epi16( _mm256_add_epi16( sumsLow[c], _mm256_unpacklo_epi8( add, zero ) ), _mm256_unpacklo_epi8( rem, zero ) );
+            sumsHigh[c] = _mm256_sub_epi16( _mm256_add_epi16( sumsHigh[c], _mm256_unpackhi_epi8( add, zero ) ), _mm256_unpackhi_epi8( rem, zero ) );
+        }
+    }
+    _mm256_zeroupper();
+}
+#elif defined(BLUR_KERNELS_NEON)
+static void VerticalBoxBlurTileNeon( const uint8_t* src, uint8_t* dst, int width, int height, int radius,
+                                     const BoxDivisor& divisor, int x0, int chunkCount )
+{
+    const size_t stride = static_cast<size_t>( width ) * 4;
+    const uint16x8_t reciprocal = vdupq_n_u16( static_cast<uint16_t>( divisor.reciprocal ) );
+    const uint16x8_t diameter = vdupq_n_u16( static_cast<uint16_t>( divisor.diameter ) );
+    const uint8x16_t opaque = vreinterpretq_u8_u32( vdupq_n_u32( 0xFF000000u ) );
+
+    // Four pixels per chunk: the low and high pixel pairs in 16-bit lanes.
+    uint16x8_t sumsLow[kVerticalTilePixels / 4];
+    uint16x8_t sumsHigh[kVerticalTilePixels / 4];
+    for( int c = 0; c < chunkCount; c++ )
+    {
+        sumsLow[c] = vdupq_n_u16( 0 );
+        sumsHigh[c] = vdupq_n_u16( 0 );
+    }
+    for( int i = -radius; i <= radius; i++ )
+    {
+        const uint8_t* row = src + std::clamp( i, 0, height - 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const uint8x16_t pixels = vld1q_u8( row + c * 16 );
+            sumsLow[c] = vaddw_u8( sumsLow[c], vget_low_u8( pixels ) );
+            sumsHigh[c] = vaddw_high_u8( sumsHigh[c], pixels );
+        }
+    }
+
+    for( int y = 0; y < height; y++ )
+    {
+        uint8_t* dstRow = dst + y * stride + x0 * 4;
+        const uint8_t* remRow = src + ( std::max )( 0, y - radius ) * stride + x0 * 4;
+        const uint8_t* addRow = src + ( std::min )( height - 1, y + radius + 1 ) * stride + x0 * 4;
+        for( int c = 0; c < chunkCount; c++ )
+        {
+            const uint8x16_t quotient = vcombine_u8( vqmovn_u16( DivideByDiameterNeon( sumsLow[c], reciprocal, diameter ) ),
+                                                     vqmovn_u16( DivideByDiameterNeon( sumsHigh[c], reciprocal, diameter ) ) );
+            vst1q_u8( dstRow + c * 16, vorrq_u8( quotient, opaque ) );
+
+            const uint8x16_t add = vld1q_u8( addRow + c * 16 );
+            const uint8x16_t rem = vld1q_u8( remRow + c * 16 );
+            sumsLow[c] = vsubw_u8( vaddw_u8( sumsLow[c], vget_low_u8( add ) ), vget_low_u8( rem ) );
+            sumsHigh[c] = vsubw_high_u8( vaddw_high_u8( sumsHigh[c], add ), rem );
+        }
+    }
+}
+#endif
+
+// Blurs columns [x0, x1) of one tile with the widest kernel that fits, then
+// blends the tile into frame while its rows are still cached.
+static void VerticalBoxBlurTile( const uint8_t* src, uint8_t* dst, int width, int height, int radius, const BoxDivisor& divisor,
+                                 int x0, int x1, uint8_t* frame, const float* mask )
+{
+    int x = x0;
+#if defined(BLUR_KERNELS_SSE2)
+    if( g_UseAvx2 && x1 - x >= 8 )
+    {
+        const int chunkCount = ( x1 - x ) / 8;
+        VerticalBoxBlurTileAvx2( src, dst, width, height, radius, divisor, x, chunkCount );
+        x += chunkCount * 8;
+    }
+    if( x1 - x >= 4 )
+    {
+        const int chunkCount = ( x1 - x ) / 4;
+        VerticalBoxBlurTileSse2( src, dst, width, height, radius, divisor, x, chunkCount );
+        x += chunkCount * 4;
+    }
+#elif defined(BLUR_KERNELS_NEON)
+    if( x1 - x >= 4 )
+    {
+        const int chunkCount = ( x1 - x ) / 4;
+        VerticalBoxBlurTileNeon( src, dst, width, height, radius, divisor, x, chunkCount );
+        x += chunkCount * 4;
+    }
+#endif
+    if( x < x1 )
+    {
+        VerticalBoxBlurTileScalar( src, dst, width, height, radius, divisor, x, x1 - x );
+    }
+
+    if( frame != nullptr && mask != nullptr )
+    {
+        const size_t stride = static_cast<size_t>( width ) * 4;
+        for( int y = 0; y < height; y++ )
+        {
+            BlendBlurredSpan( frame + y * stride + x0 * 4,
+                              dst + y * stride + x0 * 4,
+                              mask + static_cast<size_t>( y ) * width + x0,
+                              x1 - x0 );
+        }
+    }
+}
+
+static void VerticalBoxBlur( const uint8_t* src, uint8_t* dst, int width, int height, int radius, const BoxDivisor& divisor,
+                             uint8_t* frame, const float* mask )
+{
+    const int tileCount = ( width + kVerticalTilePixels - 1 ) / kVerticalTilePixels;
+    ParallelFor( 0, tileCount, kVerticalTileGrain, [&]( int tileBegin, int tileEnd )
+    {
+        for( int tile = tileBegin; tile < tileEnd; tile++ )
+        {
+            const int x0 = tile * kVerticalTilePixels;
+            VerticalBoxBlurTile( src, dst, width, height, radius, divisor,
+                                 x0, ( std::min )( width, x0 + kVerticalTilePixels ), frame, mask );
+        }
+    } );
+}
+
+//----------------------------------------------------------------------------
+// BlurAndBlendBackground
+//
+// Two iterations of the separable box blur approximate a Gaussian.  The
+// buffers ping-pong frame -> scratch -> blurred -> scratch -> blurred, so
+// blurred ends up holding the fully blurred frame for the overlay
+// composite, and frame is only written by the fused final pass.
+//----------------------------------------------------------------------------
+void BlurAndBlendBackground( uint8_t* frame,
+                             const float* mask,
+                             uint32_t width,
+                             uint32_t height,
+                             int radius,
+                             std::vector<uint8_t>& blurred,
+                             std::vector<uint8_t>& scratch,
+                             BackgroundBlurTimings* timings )
+{
+    const size_t frameBytes = static_cast<size_t>( width ) * height * 4;
+    blurred.resize( frameBytes );
+    scratch.resize( frameBytes );
+    if( frameBytes == 0 )
+    {
+        return;
+    }
+
+    const int boxRadius = std::clamp( radius, 1, kMaxBackgroundBoxBlurRadius );
+    const uint32_t diameter = static_cast<uint32_t>( boxRadius * 2 + 1 );
+    const BoxDivisor divisor{ diameter, 65536u / diameter };
+    const int w = static_cast<int>( width );
+    const int h = static_cast<int>( height );
+
+    using Clock = std::chrono::steady_clock;
+    const auto start = Clock::now();
+    HorizontalBoxBlur( frame, scratch.data(), w, h, boxRadius, divisor );
+    const auto firstHorizontalDone = Clock::now();
+    VerticalBoxBlur( scratch.data(), blurred.data(), w, h, boxRadius, divisor, nullptr, nullptr );
+    const auto firstVerticalDone = Clock::now();
+    HorizontalBoxBlur( blurred.data(), scratch.data(), w, h, boxRadius, divisor );
+    const auto secondHorizontalDone = Clock::now();
+    VerticalBoxBlur( scratch.data(), blurred.data(), w, h, boxRadius, divisor, frame, mask );
+    const auto done = Clock::now();
+
+    if( timings != nullptr )
+    {
+        using Milliseconds = std::chrono::duration<double, std::milli>;
+        timings->horizontalMs = Milliseconds( ( firstHorizontalDone - start ) + ( secondHorizontalDone - firstVerticalDone ) ).count();
+        timings->verticalMs = Milliseconds( ( firstVerticalDone - firstHorizontalDone ) + ( done - secondHorizontalDone ) ).count();
+    }
+}
+
+const char* BackgroundBlurKernelName()
+{
+#if defined(BLUR_KERNELS_SSE2)
+    return g_UseAvx2 ? "AVX2" : "SSE2";
+#elif defined(BLUR_KERNELS_NEON)
+    return "NEON";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,48 @@
+//============================================================================
+//
+// BackgroundBlurKernels.h
+//
+// CPU blur and mask compositing kernels behind BackgroundBlur::Apply.  Kept
+// free of Windows ML and GDI so the blur benchmark can build them on other
+// platforms.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//============================================================================
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Largest box radius the kernels accept; keeps a channel's window sum,
+// 255 * ( 2 * radius + 1 ), within 16 bits.
+constexpr int kMaxBackgroundBoxBlurRadius = 127;
+
+// Wall-clock milliseconds spent on one background blur frame.
+struct BackgroundBlurTimings
+{
+    double segmentationMs;  // Inference and mask post-processing; 0 when the cached mask was reused
+    double horizontalMs;    // Both horizontal box passes
+    double verticalMs;      // Both vertical box passes, the second with the mask blend fused in
+    double totalMs;
+};
+
+// Blurs the width x height BGRA frame with two iterations of a separable
+// box blur (an approximate Gaussian) into blurred, then blends blurred into
+// frame wherever mask (one float per pixel, 1 = person) is below 1.
+// scratch holds the intermediate passes.  Fills the horizontalMs and
+// verticalMs fields of timings when it is not null.
+void BlurAndBlendBackground( uint8_t* frame,
+                             const float* mask,
+                             uint32_t width,
+                             uint32_t height,
+                             int radius,
+                             std::vector<uint8_t>& blurred,
+                             std::vector<uint8_t>& scratch,
+                             BackgroundBlurTimings* timings = nullptr );
+
+// Instruction set the kernels selected on this machine, for diagnostics.
+const char* BackgroundBlurKernelName();
@@ -0,0 +1,9840 @@
+﻿//============================================================================
+//
+// PanoramaStitch.cpp
+//
+// Panorama stitch engine: frame alignment and composition on 32-bpp BGRA
+// pixel buffers.  See PanoramaCapture.cpp for the algorithm overview.
+//
+// This file must not depend on GDI or anything else Windows-specific so the
+// offline replay tool (PanoramaStitchReplay) can build it on Linux.  The
+// stitch trace goes through the sink registered by the host.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//
+//============================================================================
+#include "PanoramaStitch.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cwchar>
+#include <functional>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define PANORAMA_STITCH_SSE2
+#include <emmintrin.h>
+#if defined(_M_IX86)
+// _mm_cvtsi128_si64 is unavailable on 32-bit x86; emulate via _mm_storel_epi64.
+inline __int64 _mm_cvtsi128_si64_compat( __m128i v )
+{
+    __int64 r;
+    _mm_storel_epi64( reinterpret_cast<__m128i*>( &r ), v );
+    return r;
+}
+#define _mm_cvtsi128_si64 _mm_cvtsi128_si64_compat
+#endif
+#elif defined(_M_ARM64) || defined(__aarch64__)
+#define PANORAMA_STITCH_NEON
+#include <arm_neon.h>
+#endif
+
+#ifndef _WIN32
+// The stitch code relies on the windows.h min/max macros, which accept
+// mixed operand types.
+#ifndef min
+#define min(a,b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a,b) (((a) > (b)) ? (a) : (b))
+#endif
+#endif
+
+static PanoramaStitchLogSink g_StitchLogSink{};
+
+void SetPanoramaStitchLogSink( const PanoramaStitchLogSink& sink )
+{
+    g_StitchLogSink = sink;
+}
+
+static bool PanoramaStitchLogEnabled()
+{
+    return g_StitchLogSink.write != nullptr && ( g_StitchLogSink.enabled == nullptr || g_StitchLogSink.enabled() );
+}
+
+static void StitchLog( const wchar_t* format, ... )
+{
+    if( !PanoramaStitchLogEnabled() )
+    {
+        return;
+    }
+    va_list args;
+#ifdef _MSC_VER
+#pragma warning(push)
+#pragma warning(disable: 26492) // Don't use const_cast - unavoidable in va_start macro
+#endif
+    va_start( args, format );
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+    wchar_t buffer[1024]{};
+    vswprintf( buffer, std::size( buffer ), format, args );
+    va_end( args );
+    g_StitchLogSink.write( buffer );
+}
+
+//----------------------------------------------------------------------------
+// parallel_for
+// Runs body( i ) for every i in [begin, end) on the shared ZoomIt task
+// scheduler.  Candidate and frame items are heavy enough to schedule one
+// at a time; row loops pass a larger grain.
+//----------------------------------------------------------------------------
+template<typename Func>
+static void parallel_for( int begin, int end, const Func& body, int grainSize = 1 )
+{
+    ParallelFor( begin, end, grainSize, [&]( int rangeBegin, int rangeEnd )
+    {
+        for( int i = rangeBegin; i < rangeEnd; ++i )
+            body( i );
+    } );
+}
+
+// Emit a compact transition trace for composed frames so capture repros can
+// pinpoint skipped-content jumps and zero-overlap seams without changing
+// stitch behavior.
+static void LogComposedFrameDiagnostics( const std::vector<size_t>& composedFrameIndices,
+                                         const std::vector<POINT>& composedFrameOrigins,
+                                         const std::vector<POINT>& composedFrameSteps,
+                                         int frameWidth,
+                                         int frameHeight )
+{
+    if( !PanoramaStitchLogEnabled() || composedFrameIndices.size() < 2 ||
+        composedFrameOrigins.size() != composedFrameIndices.size() ||
+        composedFrameSteps.size() != composedFrameIndices.size() )
+    {
+        return;
+    }
+
+    StitchLog( L"[Panorama/Stitch] Composed transition diagnostics begin count=%zu\n",
+               composedFrameIndices.size() );
+
+    std::vector<int> recentAxisSteps;
+    recentAxisSteps.reserve( 8 );
+    for( size_t i = 1; i < composedFrameIndices.size(); ++i )
+    {
+        const POINT& step = composedFrameSteps[i];
+        const POINT& origin = composedFrameOrigins[i];
+        const int gap = static_cast<int>( composedFrameIndices[i] - composedFrameIndices[i - 1] );
+        const bool mostlyVertical = abs( step.y ) >= abs( step.x );
+        const int axisFrame = mostlyVertical ? frameHeight : frameWidth;
+        const int axisStep = max( abs( step.x ), abs( step.y ) );
+        const int axisOverlap = axisFrame - axisStep;
+
+        int recentMedian = 0;
+        if( !recentAxisSteps.empty() )
+        {
+            std::vector<int> sorted = recentAxisSteps;
+            std::sort( sorted.begin(), sorted.end() );
+            recentMedian = sorted[sorted.size() / 2];
+        }
+
+        const bool suspiciousGapBridge = gap > 1;
+        const bool suspiciousMissingOverlap = axisOverlap <= 0;
+        const bool suspiciousSpike = recentMedian > 0 &&
+                                     axisStep >= max( axisFrame / 6, recentMedian * 3 ) &&
+                                     axisOverlap < axisFrame * 3 / 4;
+
+        StitchLog( L"[Panorama/Stitch] Transition %zu: frames %zu->%zu gap=%d step=(%d,%d) axis=%ls axisStep=%d overlap=%d origin=(%d,%d)%ls%ls%ls recentMedian=%d\n",
+                   i,
+                   composedFrameIndices[i - 1],
+                   composedFrameIndices[i],
+                   gap,
+                   step.x,
+                   step.y,
+                   mostlyVertical ? L"vertical" : L"horizontal",
+                   axisStep,
+                   axisOverlap,
+                   origin.x,
+                   origin.y,
+                   suspiciousGapBridge ? L" [gap-bridge]" : L"",
+                   suspiciousMissingOverlap ? L" [no-overlap]" : L"",
+                   suspiciousSpike ? L" [spike]" : L"",
+                   recentMedian );
+
+        recentAxisSteps.push_back( axisStep );
+        if( recentAxisSteps.size() > 8 )
+        {
+            recentAxisSteps.erase( recentAxisSteps.begin() );
+        }
+    }
+
+    StitchLog( L"[Panorama/Stitch] Composed transition diagnostics end\n" );
+}
+
+// Emit row-level ownership diagnostics after composition so seam artifacts can
+// be traced back to specific frames, blended handoffs, or true unwritten gaps.
+static void LogCompositionCoverageDiagnostics( const std::vector<int>& stitchedOwner,
+                                               const std::vector<BYTE>& stitchedWritten,
+                                               const std::vector<BYTE>& stitchedBlended,
+                                               int stitchedWidth,
+                                               int stitchedHeight )
+{
+    if( !PanoramaStitchLogEnabled() || stitchedWidth <= 0 || stitchedHeight <= 0 ||
+        stitchedOwner.size() != stitchedWritten.size() ||
+        stitchedWritten.size() != stitchedBlended.size() )
+    {
+        return;
+    }
+
+    struct SuspiciousRowInfo
+    {
+        int y;
+        int unwrittenCount;
+        int blendedCount;
+        size_t segmentCount;
+        bool smallSegment;
+        std::wstring summary;
+    };
+
+    const int smallSegmentWidth = max( 4, min( 24, stitchedWidth / 40 ) );
+    std::vector<SuspiciousRowInfo> suspiciousRows;
+    suspiciousRows.reserve( 16 );
+    int rowsWithGaps = 0;
+    int rowsWithBlend = 0;
+
+    for( int y = 0; y < stitchedHeight; ++y )
+    {
+        const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+        int unwrittenCount = 0;
+        int blendedCount = 0;
+        std::vector<std::pair<int, int>> segments;
+        segments.reserve( 12 );
+
+        auto markerForPixel = [&]( size_t idx )
+        {
+            if( stitchedWritten[idx] == 0 )
+            {
+                return -1;
+            }
+            if( stitchedBlended[idx] != 0 )
+            {
+                return -2;
+            }
+            return stitchedOwner[idx];
+        };
+
+        int currentMarker = markerForPixel( rowBase );
+        int currentLength = 0;
+        for( int x = 0; x < stitchedWidth; ++x )
+        {
+            const size_t idx = rowBase + static_cast<size_t>( x );
+            const int marker = markerForPixel( idx );
+            if( stitchedWritten[idx] == 0 )
+            {
+                ++unwrittenCount;
+            }
+            if( stitchedBlended[idx] != 0 )
+            {
+                ++blendedCount;
+            }
+
+            if( marker != currentMarker )
+            {
+                segments.push_back( { currentMarker, currentLength } );
+                currentMarker = marker;
+                currentLength = 1;
+            }
+            else
+            {
+                ++currentLength;
+            }
+        }
+        segments.push_back( { currentMarker, currentLength } );
+
+        bool smallSegment = false;
+        for( size_t si = 1; si + 1 < segments.size(); ++si )
+        {
+            const int marker = segments[si].first;
+            const int length = segments[si].second;
+            if( marker != -1 && length <= smallSegmentWidth )
+            {
+                smallSegment = true;
+                break;
+            }
+        }
+
+        if( unwrittenCount > 0 )
+        {
+            ++rowsWithGaps;
+        }
+        if( blendedCount > 0 )
+        {
+            ++rowsWithBlend;
+        }
+
+        const bool suspiciousRow = unwrittenCount > 0 || smallSegment ||
+                                   ( blendedCount > max( 8, stitchedWidth / 12 ) && segments.size() >= 4 );
+        if( !suspiciousRow )
+        {
+            continue;
+        }
+
+        std::wstring summary;
+        for( size_t si = 0; si < segments.size() && si < 8; ++si )
+        {
+            if( si > 0 )
+            {
+                summary += L"|";
+            }
+
+            wchar_t segmentText[48]{};
+            const int marker = segments[si].first;
+            const int length = segments[si].second;
+            if( marker == -1 )
+            {
+                swprintf( segmentText, std::size( segmentText ), L"gap:%d", length );
+            }
+            else if( marker == -2 )
+            {
+                swprintf( segmentText, std::size( segmentText ), L"blend:%d", length );
+            }
+            else
+            {
+                swprintf( segmentText, std::size( segmentText ), L"f%d:%d", marker, length );
+            }
+            summary += segmentText;
+        }
+        if( segments.size() > 8 )
+        {
+            summary += L"|...";
+        }
+
+        suspiciousRows.push_back( { y, unwrittenCount, blendedCount, segments.size(), smallSegment, summary } );
+    }
+
+    StitchLog( L"[Panorama/Stitch] Coverage diagnostics rowsWithGaps=%d rowsWithBlend=%d suspiciousRows=%zu\n",
+               rowsWithGaps,
+               rowsWithBlend,
+               suspiciousRows.size() );
+    if( suspiciousRows.empty() )
+    {
+        return;
+    }
+
+    const size_t maxRowsToLog = 40;
+    for( size_t i = 0; i < suspiciousRows.size() && i < maxRowsToLog; ++i )
+    {
+        const auto& row = suspiciousRows[i];
+        StitchLog( L"[Panorama/Stitch] Coverage row y=%d unwritten=%d blended=%d segments=%zu smallSegment=%d summary=%ls\n",
+                   row.y,
+                   row.unwrittenCount,
+                   row.blendedCount,
+                   row.segmentCount,
+                   row.smallSegment ? 1 : 0,
+                   row.summary.c_str() );
+    }
+    if( suspiciousRows.size() > maxRowsToLog )
+    {
+        StitchLog( L"[Panorama/Stitch] Coverage diagnostics truncated %zu additional suspicious row(s)\n",
+                   suspiciousRows.size() - maxRowsToLog );
+    }
+}
+
+static std::wstring BuildStitchedRowSummary( const std::vector<int>& stitchedOwner,
+                                             const std::vector<BYTE>& stitchedWritten,
+                                             const std::vector<BYTE>& stitchedBlended,
+                                             int stitchedWidth,
+                                             int stitchedHeight,
+                                             int y,
+                                             size_t maxSegments = 8 )
+{
+    std::wstring summary;
+    if( stitchedWidth <= 0 || stitchedHeight <= 0 || y < 0 || y >= stitchedHeight ||
+        stitchedOwner.size() != stitchedWritten.size() ||
+        stitchedWritten.size() != stitchedBlended.size() )
+    {
+        return summary;
+    }
+
+    const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+    auto markerForPixel = [&]( size_t idx )
+    {
+        if( stitchedWritten[idx] == 0 )
+        {
+            return -1;
+        }
+        if( stitchedBlended[idx] != 0 )
+        {
+            return -2;
+        }
+        return stitchedOwner[idx];
+    };
+
+    int currentMarker = markerForPixel( rowBase );
+    int currentLength = 0;
+    size_t emittedSegments = 0;
+    for( int x = 0; x < stitchedWidth; ++x )
+    {
+        const int marker = markerForPixel( rowBase + static_cast<size_t>( x ) );
+        if( marker != currentMarker )
+        {
+            if( emittedSegments > 0 )
+            {
+                summary += L"|";
+            }
+
+            wchar_t segmentText[48]{};
+            if( currentMarker == -1 )
+            {
+                swprintf( segmentText, std::size( segmentText ), L"gap:%d", currentLength );
+            }
+            else if( currentMarker == -2 )
+            {
+                swprintf( segmentText, std::size( segmentText ), L"blend:%d", currentLength );
+            }
+            else
+            {
+                swprintf( segmentText, std::size( segmentText ), L"f%d:%d", currentMarker, currentLength );
+            }
+            summary += segmentText;
+
+            ++emittedSegments;
+            if( emittedSegments >= maxSegments )
+            {
+                summary += L"|...";
+                return summary;
+            }
+
+            currentMarker = marker;
+            currentLength = 1;
+        }
+        else
+        {
+            ++currentLength;
+        }
+    }
+
+    if( emittedSegments > 0 )
+    {
+        summary += L"|";
+    }
+    wchar_t segmentText[48]{};
+    if( currentMarker == -1 )
+    {
+        swprintf( segmentText, std::size( segmentText ), L"gap:%d", currentLength );
+    }
+    else if( currentMarker == -2 )
+    {
+        swprintf( segmentText, std::size( segmentText ), L"blend:%d", currentLength );
+    }
+    else
+    {
+        swprintf( segmentText, std::size( segmentText ), L"f%d:%d", currentLength == 0 ? -1 : currentMarker, currentLength );
+    }
+    summary += segmentText;
+    return summary;
+}
+
+static void LogSuspiciousTransitionWindowDiagnostics( const std::vector<BYTE>& stitchedPixels,
+                                                      const std::vector<int>& stitchedOwner,
+                                                      const std::vector<BYTE>& stitchedWritten,
+                                                      const std::vector<BYTE>& stitchedBlended,
+                                                      const std::vector<int>& rowBlendPixelCount,
+                                                      const std::vector<int>& rowBlendWeightSum,
+                                                      const std::vector<int>& rowBlendWeightMin,
+                                                      const std::vector<int>& rowBlendWeightMax,
+                                                      const std::vector<int>& rowBlendDominantFrame,
+                                                      const std::vector<int>& rowBlendDominantPixels,
+                                                      const std::vector<int>& rowFullWidthBlendFirstFrame,
+                                                      const std::vector<int>& rowFullWidthBlendFirstPass,
+                                                      const std::vector<int>& rowFullWidthBlendFirstWeight,
+                                                      const std::vector<int>& rowFullWidthBlendLastFrame,
+                                                      const std::vector<int>& rowFullWidthBlendLastPass,
+                                                      const std::vector<int>& rowFullWidthBlendLastWeight,
+                                                      const std::vector<int>& rowFullWidthBlendPassCount,
+                                                      int stitchedWidth,
+                                                      int stitchedHeight,
+                                                      const std::vector<size_t>& composedFrameIndices,
+                                                      const std::vector<POINT>& composedFrameOrigins,
+                                                      const std::vector<POINT>& composedFrameSteps,
+                                                      int frameWidth,
+                                                      int frameHeight,
+                                                      int verticalFeather,
+                                                      int horizontalFeather,
+                                                      int minX,
+                                                      int minY )
+{
+    if( !PanoramaStitchLogEnabled() || stitchedWidth <= 0 || stitchedHeight <= 0 ||
+        stitchedPixels.size() != static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ) * 4 ||
+        stitchedOwner.size() != stitchedWritten.size() ||
+        stitchedWritten.size() != stitchedBlended.size() ||
+        rowBlendPixelCount.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightSum.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightMin.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightMax.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendDominantFrame.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendDominantPixels.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstFrame.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstPass.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstWeight.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastFrame.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastPass.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastWeight.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendPassCount.size() != static_cast<size_t>( stitchedHeight ) ||
+        composedFrameIndices.size() < 2 ||
+        composedFrameOrigins.size() != composedFrameIndices.size() ||
+        composedFrameSteps.size() != composedFrameIndices.size() )
+    {
+        return;
+    }
+
+    int totalAbsStepX = 0;
+    int totalAbsStepY = 0;
+    for( size_t i = 1; i < composedFrameSteps.size(); ++i )
+    {
+        totalAbsStepX += abs( composedFrameSteps[i].x );
+        totalAbsStepY += abs( composedFrameSteps[i].y );
+    }
+
+    const bool mostlyVerticalCapture = totalAbsStepY >= totalAbsStepX;
+    const int axisFrame = mostlyVerticalCapture ? frameHeight : frameWidth;
+    const int windowRadius = max( 12, min( 48, axisFrame / 10 ) );
+    const int minWrittenForSignal = stitchedWidth * 9 / 10;
+    const int maxPriorityTransitionsToLog = 12;
+    const int maxNonPriorityTransitionsToLog = 10;
+    int loggedTransitions = 0;
+    int loggedPriorityTransitions = 0;
+    int loggedNonPriorityTransitions = 0;
+
+    auto rowAverageLuma = [&]( int y )
+    {
+        if( y < 0 || y >= stitchedHeight )
+        {
+            return -1;
+        }
+
+        const size_t pixelRowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth ) * 4;
+        uint64_t totalLuma = 0;
+        for( int x = 0; x < stitchedWidth; ++x )
+        {
+            const size_t pixelIdx = pixelRowBase + static_cast<size_t>( x ) * 4;
+            totalLuma += ( static_cast<uint64_t>( stitchedPixels[pixelIdx + 2] ) * 77 +
+                           static_cast<uint64_t>( stitchedPixels[pixelIdx + 1] ) * 150 +
+                           static_cast<uint64_t>( stitchedPixels[pixelIdx + 0] ) * 29 ) >> 8;
+        }
+        return static_cast<int>( totalLuma / max( 1, stitchedWidth ) );
+    };
+
+    auto rowWrittenCount = [&]( int y )
+    {
+        if( y < 0 || y >= stitchedHeight )
+        {
+            return 0;
+        }
+
+        const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+        int written = 0;
+        for( int x = 0; x < stitchedWidth; ++x )
+        {
+            written += stitchedWritten[rowBase + static_cast<size_t>( x )] != 0 ? 1 : 0;
+        }
+        return written;
+    };
+
+    auto rowBlendedCount = [&]( int y )
+    {
+        if( y < 0 || y >= stitchedHeight )
+        {
+            return 0;
+        }
+
+        const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+        int blended = 0;
+        for( int x = 0; x < stitchedWidth; ++x )
+        {
+            blended += stitchedBlended[rowBase + static_cast<size_t>( x )] != 0 ? 1 : 0;
+        }
+        return blended;
+    };
+
+    auto rowBlendAverageWeight = [&]( int y )
+    {
+        if( y < 0 || y >= stitchedHeight || rowBlendPixelCount[y] <= 0 )
+        {
+            return 0;
+        }
+        return rowBlendWeightSum[y] / rowBlendPixelCount[y];
+    };
+
+    StitchLog( L"[Panorama/Stitch] Seam window diagnostics begin axis=%ls radius=%d\n",
+               mostlyVerticalCapture ? L"vertical" : L"horizontal",
+               windowRadius );
+
+    for( size_t i = 1; i < composedFrameIndices.size(); ++i )
+    {
+        const POINT& step = composedFrameSteps[i];
+        const int gap = static_cast<int>( composedFrameIndices[i] - composedFrameIndices[i - 1] );
+        const int axisStep = mostlyVerticalCapture ? abs( step.y ) : abs( step.x );
+        const int axisOverlap = axisFrame - axisStep;
+        const bool suspiciousTransition =
+            gap > 1 || axisOverlap < axisFrame * 3 / 4 || axisStep >= axisFrame / 6;
+        const bool priorityTransition =
+            gap > 1 || i + 4 >= composedFrameIndices.size();
+        if( !suspiciousTransition )
+        {
+            continue;
+        }
+        if( priorityTransition )
+        {
+            if( loggedPriorityTransitions >= maxPriorityTransitionsToLog )
+            {
+                continue;
+            }
+        }
+        else if( loggedNonPriorityTransitions >= maxNonPriorityTransitionsToLog )
+        {
+            continue;
+        }
+
+        const int boundary = mostlyVerticalCapture
+            ? ( composedFrameOrigins[i].y - minY )
+            : ( composedFrameOrigins[i].x - minX );
+        const int windowStart = max( 0, boundary - windowRadius );
+        const int windowEnd = min( stitchedHeight - 1, boundary + windowRadius );
+        int featherStart = -1;
+        int featherEnd = -1;
+        int featherStartWeight = -1;
+        if( mostlyVerticalCapture && axisOverlap > 0 )
+        {
+            const int destinationY = composedFrameOrigins[i].y - minY;
+            if( step.y > 0 )
+            {
+                featherStart = destinationY + max( 0, axisOverlap - verticalFeather );
+                featherEnd = destinationY + max( 0, axisOverlap - 1 );
+            }
+            else if( step.y < 0 )
+            {
+                featherStart = destinationY + abs( step.y );
+                featherEnd = featherStart + max( 0, verticalFeather - 1 );
+            }
+            if( featherStart >= 0 )
+            {
+                featherStartWeight = 255 / max( 1, verticalFeather );
+            }
+        }
+        else if( !mostlyVerticalCapture && axisOverlap > 0 )
+        {
+            const int destinationX = composedFrameOrigins[i].x - minX;
+            if( step.x > 0 )
+            {
+                featherStart = destinationX + max( 0, axisOverlap - horizontalFeather );
+                featherEnd = destinationX + max( 0, axisOverlap - 1 );
+            }
+            else if( step.x < 0 )
+            {
+                featherStart = destinationX + abs( step.x );
+                featherEnd = featherStart + max( 0, horizontalFeather - 1 );
+            }
+            if( featherStart >= 0 )
+            {
+                featherStartWeight = 255 / max( 1, horizontalFeather );
+            }
+        }
+
+        int darkestRow = -1;
+        int darkestLuma = ( std::numeric_limits<int>::max )();
+        int maxBlendRow = -1;
+        int maxBlendCount = -1;
+        for( int y = windowStart; y <= windowEnd; ++y )
+        {
+            const int writtenCount = rowWrittenCount( y );
+            if( writtenCount < minWrittenForSignal )
+            {
+                continue;
+            }
+
+            const int luma = rowAverageLuma( y );
+            if( luma >= 0 && luma < darkestLuma )
+            {
+                darkestLuma = luma;
+                darkestRow = y;
+            }
+
+            const int blendedCount = rowBlendedCount( y );
+            if( blendedCount > maxBlendCount )
+            {
+                maxBlendCount = blendedCount;
+                maxBlendRow = y;
+            }
+        }
+
+        StitchLog( L"[Panorama/Stitch] Seam transition %zu frames %zu->%zu gap=%d boundary=%d axisStep=%d overlap=%d feather=%d..%d featherStartWeight=%d window=%d..%d darkestRow=%d darkestLuma=%d maxBlendRow=%d maxBlend=%d\n",
+                   i,
+                   composedFrameIndices[i - 1],
+                   composedFrameIndices[i],
+                   gap,
+                   boundary,
+                   axisStep,
+                   axisOverlap,
+                   featherStart,
+                   featherEnd,
+                   featherStartWeight,
+                   windowStart,
+                   windowEnd,
+                   darkestRow,
+                   darkestLuma == ( std::numeric_limits<int>::max )() ? -1 : darkestLuma,
+                   maxBlendRow,
+                   maxBlendCount );
+
+        const int featherMid = ( featherStart >= 0 && featherEnd >= featherStart )
+            ? ( featherStart + featherEnd ) / 2
+            : -1;
+        const int sampleRows[] = { boundary - 1, boundary, boundary + 1, featherStart, featherMid, featherEnd, darkestRow, maxBlendRow };
+        const wchar_t* sampleLabels[] = { L"boundary-1", L"boundary", L"boundary+1", L"featherStart", L"featherMid", L"featherEnd", L"darkest", L"maxBlend" };
+        for( int sampleIndex = 0; sampleIndex < static_cast<int>( std::size( sampleRows ) ); ++sampleIndex )
+        {
+            const int sampleRow = sampleRows[sampleIndex];
+            if( sampleRow < 0 || sampleRow >= stitchedHeight )
+            {
+                continue;
+            }
+
+            bool alreadyLogged = false;
+            for( int prior = 0; prior < sampleIndex; ++prior )
+            {
+                if( sampleRows[prior] == sampleRow )
+                {
+                    alreadyLogged = true;
+                    break;
+                }
+            }
+            if( alreadyLogged )
+            {
+                continue;
+            }
+
+            StitchLog( L"[Panorama/Stitch] Seam row transition=%zu label=%ls y=%d luma=%d written=%d blended=%d blendPixels=%d blendAvg=%d blendMin=%d blendMax=%d blendDominantFrame=%d blendDominantPixels=%d fullBlendFirst=(frame:%d pass:%d weight:%d) fullBlendLast=(frame:%d pass:%d weight:%d) fullBlendPasses=%d summary=%ls\n",
+                       i,
+                       sampleLabels[sampleIndex],
+                       sampleRow,
+                       rowAverageLuma( sampleRow ),
+                       rowWrittenCount( sampleRow ),
+                       rowBlendedCount( sampleRow ),
+                       rowBlendPixelCount[sampleRow],
+                       rowBlendAverageWeight( sampleRow ),
+                       rowBlendPixelCount[sampleRow] > 0 ? rowBlendWeightMin[sampleRow] : 0,
+                       rowBlendPixelCount[sampleRow] > 0 ? rowBlendWeightMax[sampleRow] : 0,
+                       rowBlendDominantFrame[sampleRow],
+                       rowBlendDominantPixels[sampleRow],
+                       rowFullWidthBlendFirstFrame[sampleRow],
+                       rowFullWidthBlendFirstPass[sampleRow],
+                       rowFullWidthBlendFirstWeight[sampleRow],
+                       rowFullWidthBlendLastFrame[sampleRow],
+                       rowFullWidthBlendLastPass[sampleRow],
+                       rowFullWidthBlendLastWeight[sampleRow],
+                       rowFullWidthBlendPassCount[sampleRow],
+                       BuildStitchedRowSummary( stitchedOwner,
+                                                stitchedWritten,
+                                                stitchedBlended,
+                                                stitchedWidth,
+                                                stitchedHeight,
+                                                sampleRow ).c_str() );
+        }
+
+        ++loggedTransitions;
+        if( priorityTransition )
+        {
+            ++loggedPriorityTransitions;
+        }
+        else
+        {
+            ++loggedNonPriorityTransitions;
+        }
+    }
+
+    StitchLog( L"[Panorama/Stitch] Seam window diagnostics end logged=%d priority=%d nonPriority=%d\n",
+               loggedTransitions,
+               loggedPriorityTransitions,
+               loggedNonPriorityTransitions );
+}
+
+// Detect visually dark stitched bands even when the canvas has no unwritten
+// gaps so we can correlate full-width artifacts with a specific frame handoff.
+static void LogStitchedBandDiagnostics( const std::vector<BYTE>& stitchedPixels,
+                                        const std::vector<int>& stitchedOwner,
+                                        const std::vector<BYTE>& stitchedWritten,
+                                        const std::vector<BYTE>& stitchedBlended,
+                                        const std::vector<int>& rowBlendPixelCount,
+                                        const std::vector<int>& rowBlendWeightSum,
+                                        const std::vector<int>& rowBlendWeightMin,
+                                        const std::vector<int>& rowBlendWeightMax,
+                                        const std::vector<int>& rowFullWidthBlendFirstFrame,
+                                        const std::vector<int>& rowFullWidthBlendFirstPass,
+                                        const std::vector<int>& rowFullWidthBlendFirstWeight,
+                                        const std::vector<int>& rowFullWidthBlendLastFrame,
+                                        const std::vector<int>& rowFullWidthBlendLastPass,
+                                        const std::vector<int>& rowFullWidthBlendLastWeight,
+                                        const std::vector<int>& rowFullWidthBlendPassCount,
+                                        int stitchedWidth,
+                                        int stitchedHeight,
+                                        const std::vector<size_t>& composedFrameIndices,
+                                        const std::vector<POINT>& composedFrameOrigins,
+                                        int minY )
+{
+    if( !PanoramaStitchLogEnabled() || stitchedWidth <= 0 || stitchedHeight <= 0 ||
+        stitchedPixels.size() != static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ) * 4 ||
+        stitchedOwner.size() != stitchedWritten.size() ||
+        stitchedWritten.size() != stitchedBlended.size() ||
+        rowBlendPixelCount.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightSum.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightMin.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowBlendWeightMax.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstFrame.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstPass.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendFirstWeight.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastFrame.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastPass.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendLastWeight.size() != static_cast<size_t>( stitchedHeight ) ||
+        rowFullWidthBlendPassCount.size() != static_cast<size_t>( stitchedHeight ) )
+    {
+        return;
+    }
+
+    std::vector<int> rowLuma( stitchedHeight, 0 );
+    std::vector<int> rowBlended( stitchedHeight, 0 );
+    std::vector<int> rowWritten( stitchedHeight, 0 );
+    std::vector<std::pair<int, int>> darkBandFirstPassCounts;
+    std::vector<std::pair<int, int>> darkBandLastPassCounts;
+    auto incrementPassCount = []( std::vector<std::pair<int, int>>& counts, int pass )
+    {
+        if( pass < 0 )
+        {
+            return;
+        }
+        for( auto& entry : counts )
+        {
+            if( entry.first == pass )
+            {
+                entry.second++;
+                return;
+            }
+        }
+        counts.push_back( { pass, 1 } );
+    };
+    auto rowBlendAverageWeight = [&]( int y )
+    {
+        if( y < 0 || y >= stitchedHeight || rowBlendPixelCount[y] <= 0 )
+        {
+            return 0;
+        }
+        return rowBlendWeightSum[y] / rowBlendPixelCount[y];
+    };
+    for( int y = 0; y < stitchedHeight; ++y )
+    {
+        const size_t pixelRowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth ) * 4;
+        const size_t maskRowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+        uint64_t totalLuma = 0;
+        for( int x = 0; x < stitchedWidth; ++x )
+        {
+            const size_t pixelIdx = pixelRowBase + static_cast<size_t>( x ) * 4;
+            totalLuma += ( static_cast<uint64_t>( stitchedPixels[pixelIdx + 2] ) * 77 +
+                           static_cast<uint64_t>( stitchedPixels[pixelIdx + 1] ) * 150 +
+                           static_cast<uint64_t>( stitchedPixels[pixelIdx + 0] ) * 29 ) >> 8;
+
+            const size_t maskIdx = maskRowBase + static_cast<size_t>( x );
+            if( stitchedWritten[maskIdx] != 0 )
+            {
+                ++rowWritten[y];
+            }
+            if( stitchedBlended[maskIdx] != 0 )
+            {
+                ++rowBlended[y];
+            }
+        }
+        rowLuma[y] = static_cast<int>( totalLuma / max( 1, stitchedWidth ) );
+    }
+
+    struct DarkBandInfo
+    {
+        int startY;
+        int endY;
+        int centerY;
+        int avgLuma;
+        int referenceLuma;
+        int delta;
+    };
+
+    const int referenceRadius = max( 8, min( 24, stitchedHeight / 40 ) );
+    const int minBandThickness = 2;
+    const int maxBandsToLog = 12;
+    std::vector<DarkBandInfo> darkBands;
+    std::vector<BYTE> darkRowMask( stitchedHeight, 0 );
+
+    for( int y = referenceRadius; y < stitchedHeight - referenceRadius; ++y )
+    {
+        if( rowWritten[y] < stitchedWidth * 9 / 10 )
+        {
+            continue;
+        }
+
+        uint64_t neighborhoodTotal = 0;
+        int neighborhoodCount = 0;
+        for( int offset = -referenceRadius; offset <= referenceRadius; ++offset )
+        {
+            if( offset == 0 || abs( offset ) <= 2 )
+            {
+                continue;
+            }
+
+            const int sampleY = y + offset;
+            neighborhoodTotal += static_cast<uint64_t>( rowLuma[sampleY] );
+            ++neighborhoodCount;
+        }
+        if( neighborhoodCount <= 0 )
+        {
+            continue;
+        }
+
+        const int referenceLuma = static_cast<int>( neighborhoodTotal / neighborhoodCount );
+        const int delta = referenceLuma - rowLuma[y];
+        const bool isDarkOutlier = referenceLuma >= 24 &&
+                                   delta >= max( 18, referenceLuma / 5 ) &&
+                                   rowBlended[y] >= stitchedWidth / 3;
+        if( isDarkOutlier )
+        {
+            darkRowMask[y] = 1;
+        }
+    }
+
+    for( int y = 0; y < stitchedHeight; )
+    {
+        if( darkRowMask[y] == 0 )
+        {
+            ++y;
+            continue;
+        }
+
+        const int startY = y;
+        int endY = y;
+        while( endY + 1 < stitchedHeight && darkRowMask[endY + 1] != 0 )
+        {
+            ++endY;
+        }
+
+        if( endY - startY + 1 >= minBandThickness )
+        {
+            uint64_t bandLumaTotal = 0;
+            uint64_t refLumaTotal = 0;
+            for( int bandY = startY; bandY <= endY; ++bandY )
+            {
+                bandLumaTotal += static_cast<uint64_t>( rowLuma[bandY] );
+
+                uint64_t neighborhoodTotal = 0;
+                int neighborhoodCount = 0;
+                for( int offset = -referenceRadius; offset <= referenceRadius; ++offset )
+                {
+                    if( abs( offset ) <= 2 )
+                    {
+                        continue;
+                    }
+
+                    const int sampleY = bandY + offset;
+                    if( sampleY < 0 || sampleY >= stitchedHeight )
+                    {
+                        continue;
+                    }
+                    neighborhoodTotal += static_cast<uint64_t>( rowLuma[sampleY] );
+                    ++neighborhoodCount;
+                }
+                if( neighborhoodCount > 0 )
+                {
+                    refLumaTotal += neighborhoodTotal / neighborhoodCount;
+                }
+            }
+
+            const int rowCount = endY - startY + 1;
+            const int avgLuma = static_cast<int>( bandLumaTotal / rowCount );
+            const int referenceLuma = static_cast<int>( refLumaTotal / rowCount );
+            darkBands.push_back( { startY, endY, ( startY + endY ) / 2, avgLuma, referenceLuma, referenceLuma - avgLuma } );
+        }
+
+        y = endY + 1;
+    }
+
+    StitchLog( L"[Panorama/Stitch] Band diagnostics darkBands=%zu referenceRadius=%d\n",
+               darkBands.size(),
+               referenceRadius );
+    if( darkBands.empty() )
+    {
+        return;
+    }
+
+    for( size_t i = 0; i < darkBands.size() && i < maxBandsToLog; ++i )
+    {
+        const auto& band = darkBands[i];
+        int nearestBoundaryRow = -1;
+        size_t nearestBoundaryFrame = static_cast<size_t>( -1 );
+        int nearestBoundaryDistance = ( std::numeric_limits<int>::max )();
+        for( size_t framePos = 0; framePos < composedFrameIndices.size() && framePos < composedFrameOrigins.size(); ++framePos )
+        {
+            const int boundaryRow = composedFrameOrigins[framePos].y - minY;
+            const int distance = abs( boundaryRow - band.centerY );
+            if( distance < nearestBoundaryDistance )
+            {
+                nearestBoundaryDistance = distance;
+                nearestBoundaryRow = boundaryRow;
+                nearestBoundaryFrame = composedFrameIndices[framePos];
+            }
+        }
+
+        incrementPassCount( darkBandFirstPassCounts, rowFullWidthBlendFirstPass[band.centerY] );
+        incrementPassCount( darkBandLastPassCounts, rowFullWidthBlendLastPass[band.centerY] );
+
+        StitchLog( L"[Panorama/Stitch] Dark band y=%d..%d rows=%d avgLuma=%d refLuma=%d delta=%d blendedCenter=%d writtenCenter=%d blendPixelsCenter=%d blendAvgCenter=%d blendMinCenter=%d blendMaxCenter=%d fullBlendFirst=(frame:%d pass:%d weight:%d) fullBlendLast=(frame:%d pass:%d weight:%d) fullBlendPasses=%d nearestBoundaryRow=%d nearestBoundaryFrame=%zu boundaryDistance=%d summary=%ls\n",
+                   band.startY,
+                   band.endY,
+                   band.endY - band.startY + 1,
+                   band.avgLuma,
+                   band.referenceLuma,
+                   band.delta,
+                   rowBlended[band.centerY],
+                   rowWritten[band.centerY],
+                   rowBlendPixelCount[band.centerY],
+                   rowBlendAverageWeight( band.centerY ),
+                   rowBlendPixelCount[band.centerY] > 0 ? rowBlendWeightMin[band.centerY] : 0,
+                   rowBlendPixelCount[band.centerY] > 0 ? rowBlendWeightMax[band.centerY] : 0,
+                   rowFullWidthBlendFirstFrame[band.centerY],
+                   rowFullWidthBlendFirstPass[band.centerY],
+                   rowFullWidthBlendFirstWeight[band.centerY],
+                   rowFullWidthBlendLastFrame[band.centerY],
+                   rowFullWidthBlendLastPass[band.centerY],
+                   rowFullWidthBlendLastWeight[band.centerY],
+                   rowFullWidthBlendPassCount[band.centerY],
+                   nearestBoundaryRow,
+                   nearestBoundaryFrame,
+                   nearestBoundaryDistance,
+                   BuildStitchedRowSummary( stitchedOwner,
+                                            stitchedWritten,
+                                            stitchedBlended,
+                                            stitchedWidth,
+                                            stitchedHeight,
+                                            band.centerY ).c_str() );
+    }
+    if( !darkBandFirstPassCounts.empty() )
+    {
+        std::sort( darkBandFirstPassCounts.begin(), darkBandFirstPassCounts.end(), []( const auto& lhs, const auto& rhs )
+        {
+            return lhs.second > rhs.second;
+        } );
+        std::sort( darkBandLastPassCounts.begin(), darkBandLastPassCounts.end(), []( const auto& lhs, const auto& rhs )
+        {
+            return lhs.second > rhs.second;
+        } );
+
+        std::wstring firstSummary;
+        std::wstring lastSummary;
+        for( size_t idx = 0; idx < darkBandFirstPassCounts.size() && idx < 6; ++idx )
+        {
+            if( idx > 0 )
+            {
+                firstSummary += L"|";
+            }
+            wchar_t buffer[32]{};
+            swprintf( buffer, std::size( buffer ), L"p%d:%d", darkBandFirstPassCounts[idx].first, darkBandFirstPassCounts[idx].second );
+            firstSummary += buffer;
+        }
+        for( size_t idx = 0; idx < darkBandLastPassCounts.size() && idx < 6; ++idx )
+        {
+            if( idx > 0 )
+            {
+                lastSummary += L"|";
+            }
+            wchar_t buffer[32]{};
+            swprintf( buffer, std::size( buffer ), L"p%d:%d", darkBandLastPassCounts[idx].first, darkBandLastPassCounts[idx].second );
+            lastSummary += buffer;
+        }
+
+        StitchLog( L"[Panorama/Stitch] Dark band provenance firstPasses=%ls lastPasses=%ls\n",
+                   firstSummary.c_str(),
+                   lastSummary.c_str() );
+    }
+    if( darkBands.size() > maxBandsToLog )
+    {
+        StitchLog( L"[Panorama/Stitch] Band diagnostics truncated %zu additional dark band(s)\n",
+                   darkBands.size() - maxBandsToLog );
+    }
+}
+
+// Post-composition content-duplication diagnostic.
+// For each composed frame, compute how many of its "unique" (non-overlap)
+// rows are pixel-identical to rows elsewhere on the canvas.  This reveals
+// whether the matcher placed frames redundantly or the source content is
+// genuinely repetitive.
+static void LogContentDuplicationDiagnostics( const std::vector<BYTE>& stitchedPixels,
+                                              const std::vector<int>& stitchedOwner,
+                                              int stitchedWidth,
+                                              int stitchedHeight,
+                                              const std::vector<size_t>& composedFrameIndices,
+                                              const std::vector<POINT>& composedFrameOrigins,
+                                              const std::vector<POINT>& composedFrameSteps,
+                                              int frameHeight,
+                                              int minY )
+{
+    if( !PanoramaStitchLogEnabled() || stitchedWidth <= 0 || stitchedHeight <= 0 ||
+        stitchedPixels.size() != static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ) * 4 ||
+        composedFrameIndices.size() < 2 ||
+        composedFrameOrigins.size() != composedFrameIndices.size() ||
+        composedFrameSteps.size() != composedFrameIndices.size() )
+    {
+        return;
+    }
+
+    // Helper: compute average per-pixel RGB difference between two canvas rows.
+    auto rowDifference = [&]( int yA, int yB ) -> double
+    {
+        if( yA < 0 || yA >= stitchedHeight || yB < 0 || yB >= stitchedHeight )
+            return 999.0;
+        const size_t baseA = static_cast<size_t>( yA ) * static_cast<size_t>( stitchedWidth ) * 4;
+        const size_t baseB = static_cast<size_t>( yB ) * static_cast<size_t>( stitchedWidth ) * 4;
+        long long sum = 0;
+        // Sample every 4th pixel for speed.
+        int count = 0;
+        for( int x = 0; x < stitchedWidth; x += 4 )
+        {
+            const size_t offA = baseA + static_cast<size_t>( x ) * 4;
+            const size_t offB = baseB + static_cast<size_t>( x ) * 4;
+            sum += abs( static_cast<int>( stitchedPixels[offA + 0] ) - static_cast<int>( stitchedPixels[offB + 0] ) )
+                 + abs( static_cast<int>( stitchedPixels[offA + 1] ) - static_cast<int>( stitchedPixels[offB + 1] ) )
+                 + abs( static_cast<int>( stitchedPixels[offA + 2] ) - static_cast<int>( stitchedPixels[offB + 2] ) );
+            ++count;
+        }
+        return count > 0 ? static_cast<double>( sum ) / ( count * 3.0 ) : 999.0;
+    };
+
+    // Helper: compute the dominant owner frame for a canvas row.
+    auto rowDominantOwner = [&]( int y ) -> int
+    {
+        if( y < 0 || y >= stitchedHeight )
+            return -1;
+        const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth );
+        // Count the first owner seen (they're usually uniform for full-width frames).
+        return stitchedOwner[rowBase + static_cast<size_t>( stitchedWidth / 2 )];
+    };
+
+    // Helper: average luma of a canvas row.
+    auto rowAverageLuma = [&]( int y ) -> int
+    {
+        if( y < 0 || y >= stitchedHeight )
+            return -1;
+        const size_t base = static_cast<size_t>( y ) * static_cast<size_t>( stitchedWidth ) * 4;
+        unsigned long long totalLuma = 0;
+        for( int x = 0; x < stitchedWidth; x += 4 )
+        {
+            const size_t off = base + static_cast<size_t>( x ) * 4;
+            totalLuma += ( static_cast<unsigned long long>( stitchedPixels[off + 2] ) * 77 +
+                           static_cast<unsigned long long>( stitchedPixels[off + 1] ) * 150 +
+                           static_cast<unsigned long long>( stitchedPixels[off + 0] ) * 29 ) >> 8;
+        }
+        const int sampleCount = ( stitchedWidth + 3 ) / 4;
+        return static_cast<int>( totalLuma / max( 1, sampleCount ) );
+    };
+
+    StitchLog( L"[Panorama/Stitch] Content duplication diagnostics begin\n" );
+
+    // Only inspect the last ~40% of composed transitions where artifacts cluster.
+    const size_t startTransition = composedFrameIndices.size() / 2;
+
+    int totalDuplicateTransitions = 0;
+    for( size_t i = startTransition; i < composedFrameIndices.size(); ++i )
+    {
+        const int stepY = composedFrameSteps[i].y;
+        const int absStepY = abs( stepY );
+        const int destY = composedFrameOrigins[i].y - minY;
+
+        // Determine the "new content" region: rows that should be unique.
+        // For downward scrolling (stepY > 0 i.e. step on canvas is positive),
+        // the new content is the bottom portion: rows [destY + overlapHeight, destY + frameHeight).
+        // For upward, the new content is the top portion.
+        const int overlapHeight = max( 0, frameHeight - absStepY );
+
+        int newContentStart = -1;
+        int newContentEnd = -1;
+        if( stepY > 0 && absStepY > 0 )
+        {
+            // Downward scroll: new content at the bottom of this frame's span.
+            newContentStart = destY + overlapHeight;
+            newContentEnd = destY + frameHeight;
+        }
+        else if( stepY < 0 && absStepY > 0 )
+        {
+            // Upward scroll: new content at the top.
+            newContentStart = destY;
+            newContentEnd = destY + absStepY;
+        }
+        else
+        {
+            continue; // No movement, skip.
+        }
+
+        // Clamp to canvas bounds.
+        newContentStart = max( 0, min( stitchedHeight, newContentStart ) );
+        newContentEnd = max( 0, min( stitchedHeight, newContentEnd ) );
+        const int newContentRows = newContentEnd - newContentStart;
+        if( newContentRows <= 0 )
+            continue;
+
+        // Check each new-content row against the canvas row that is
+        // exactly one step above. If pixel-identical, the frame is
+        // painting redundant content.
+        int identicalToStepAbove = 0;
+        int nearIdenticalToStepAbove = 0;
+        // Also check if it matches row at offset = overlapHeight above (full frame repeat).
+        int identicalToOverlapAbove = 0;
+        // Also scan for best-matching row within a search window above.
+        int identicalToBestMatch = 0;
+        int bestMatchSampleOffset = 0;
+
+        for( int row = newContentStart; row < newContentEnd; ++row )
+        {
+            // Compare to the row absStepY rows above (one "frame step" earlier).
+            const double diffStep = rowDifference( row, row - absStepY );
+            if( diffStep <= 0.5 )
+                ++identicalToStepAbove;
+            else if( diffStep <= 4.0 )
+                ++nearIdenticalToStepAbove;
+
+            // Compare to row overlapHeight above.
+            const double diffOverlap = rowDifference( row, row - overlapHeight );
+            if( diffOverlap <= 0.5 )
+                ++identicalToOverlapAbove;
+        }
+
+        // Sample a few rows for the best-match scan to keep it fast.
+        const int sampleRow = ( newContentStart + newContentEnd ) / 2;
+        double bestSampleDiff = 999.0;
+        for( int offset = 24; offset < min( stitchedHeight, 800 ); ++offset )
+        {
+            if( sampleRow - offset < 0 )
+                break;
+            const double d = rowDifference( sampleRow, sampleRow - offset );
+            if( d < bestSampleDiff )
+            {
+                bestSampleDiff = d;
+                bestMatchSampleOffset = offset;
+            }
+        }
+        if( bestSampleDiff <= 0.5 )
+            ++identicalToBestMatch;
+
+        const int gap = ( i > 0 ) ? static_cast<int>( composedFrameIndices[i] - composedFrameIndices[i - 1] ) : 0;
+        const bool significantDuplication =
+            identicalToStepAbove > newContentRows / 3 ||
+            identicalToOverlapAbove > newContentRows / 3 ||
+            nearIdenticalToStepAbove > newContentRows * 2 / 3;
+
+        if( significantDuplication )
+            ++totalDuplicateTransitions;
+
+        // Log every transition in the tail region regardless of whether it's duplicate,
+        // so we can see the pattern. But use a compact format.
+        StitchLog( L"[Panorama/Stitch] FrameDup trans=%zu frame=%zu gap=%d step=(%d,%d) dest=%d newRows=%d..%d(%d) "
+                   L"identStep=%d nearStep=%d identOverlap=%d bestMatchOff=%d bestMatchDiff=%.1f "
+                   L"ownerAtNew=%d ownerAbove=%d lumaNew=%d lumaAbove=%d%ls\n",
+                   i,
+                   composedFrameIndices[i],
+                   gap,
+                   composedFrameSteps[i].x,
+                   composedFrameSteps[i].y,
+                   destY,
+                   newContentStart,
+                   newContentEnd,
+                   newContentRows,
+                   identicalToStepAbove,
+                   nearIdenticalToStepAbove,
+                   identicalToOverlapAbove,
+                   bestMatchSampleOffset,
+                   bestSampleDiff,
+                   rowDominantOwner( ( newContentStart + newContentEnd ) / 2 ),
+                   rowDominantOwner( ( newContentStart + newContentEnd ) / 2 - absStepY ),
+                   rowAverageLuma( ( newContentStart + newContentEnd ) / 2 ),
+                   rowAverageLuma( ( newContentStart + newContentEnd ) / 2 - absStepY ),
+                   significantDuplication ? L" [DUPLICATE]" : L"" );
+    }
+
+    StitchLog( L"[Panorama/Stitch] Content duplication diagnostics end duplicateTransitions=%d/%zu\n",
+               totalDuplicateTransitions,
+               composedFrameIndices.size() - startTransition );
+}
+
+static void LogGapBridgeProbeDiagnostics( size_t frameIndex,
+                                          size_t lastAcceptedIndex,
+                                          int gap,
+                                          int acceptedDx,
+                                          int acceptedDy,
+                                          int expectedDx,
+                                          int expectedDy,
+                                          int frameWidth,
+                                          int frameHeight,
+                                          bool lowContrastMode,
+                                          const std::vector<std::vector<BYTE>>& framePixels,
+                                          const std::vector<std::vector<BYTE>>& frameLuma,
+                                          const std::vector<double>& frameConstantFraction,
+                                          const std::vector<POINT>& composedFrameSteps )
+{
+    if( gap <= 1 || frameIndex == 0 || lastAcceptedIndex >= frameIndex )
+    {
+        return;
+    }
+
+    int histAbsX = 0;
+    int histAbsY = 0;
+    for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+    {
+        histAbsX += abs( composedFrameSteps[si].x );
+        histAbsY += abs( composedFrameSteps[si].y );
+    }
+
+    const bool mostlyVerticalHist = histAbsY > histAbsX * 3;
+    const bool mostlyHorizontalHist = histAbsX > histAbsY * 3;
+    std::vector<int> recentAxisAbs;
+    recentAxisAbs.reserve( 8 );
+    for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+         si >= 1 && static_cast<int>( recentAxisAbs.size() ) < 8;
+         --si )
+    {
+        const int axisValue = mostlyVerticalHist
+            ? abs( composedFrameSteps[static_cast<size_t>( si )].y )
+            : ( mostlyHorizontalHist
+                ? abs( composedFrameSteps[static_cast<size_t>( si )].x )
+                : 0 );
+        if( axisValue > 0 )
+        {
+            recentAxisAbs.push_back( axisValue );
+        }
+    }
+
+    int recentMedian = 0;
+    if( !recentAxisAbs.empty() )
+    {
+        std::sort( recentAxisAbs.begin(), recentAxisAbs.end() );
+        recentMedian = recentAxisAbs[recentAxisAbs.size() / 2];
+    }
+
+    StitchLog( L"[Panorama/Stitch] GapBridgeProbe begin frame=%zu ref=%zu gap=%d accepted=(%d,%d) expected=(%d,%d) recentMedian=%d mode=%ls\n",
+                 frameIndex,
+                 lastAcceptedIndex,
+                 gap,
+                 acceptedDx,
+                 acceptedDy,
+                 expectedDx,
+                 expectedDy,
+                 recentMedian,
+                 mostlyVerticalHist ? L"vertical" : ( mostlyHorizontalHist ? L"horizontal" : L"neutral" ) );
+
+    int bridgeProbeDx = 0;
+    int bridgeProbeDy = 0;
+    bool bridgeProbeNearStationary = false;
+    const int bridgeVle = ( frameConstantFraction[lastAcceptedIndex] > 0.58 &&
+                            frameConstantFraction[frameIndex] > 0.58 ) ? 1 : 0;
+    const bool bridgeProbeOk = FindBestFrameShiftVerticalOnly( framePixels[lastAcceptedIndex],
+                                                               framePixels[frameIndex],
+                                                               frameWidth,
+                                                               frameHeight,
+                                                               expectedDx * gap,
+                                                               expectedDy * gap,
+                                                               bridgeProbeDx,
+                                                               bridgeProbeDy,
+                                                               lowContrastMode,
+                                                               frameLuma[lastAcceptedIndex],
+                                                               frameLuma[frameIndex],
+                                                               bridgeVle,
+                                                               &bridgeProbeNearStationary,
+                                                               false,
+                                                               nullptr,
+                                                               true,
+                                                               true );
+    StitchLog( L"[Panorama/Stitch] GapBridgeProbe bridge-pair frame=%zu ref=%zu ok=%d probe=(%d,%d) expectedTotal=(%d,%d) nearStationary=%d\n",
+                 frameIndex,
+                 lastAcceptedIndex,
+                 bridgeProbeOk ? 1 : 0,
+                 bridgeProbeDx,
+                 bridgeProbeDy,
+                 expectedDx * gap,
+                 expectedDy * gap,
+                 bridgeProbeNearStationary ? 1 : 0 );
+
+    int adjacentProbeDx = 0;
+    int adjacentProbeDy = 0;
+    bool adjacentProbeNearStationary = false;
+    const int adjacentVle = ( frameConstantFraction[frameIndex - 1] > 0.58 &&
+                              frameConstantFraction[frameIndex] > 0.58 ) ? 1 : 0;
+    const bool adjacentProbeOk = FindBestFrameShiftVerticalOnly( framePixels[frameIndex - 1],
+                                                                 framePixels[frameIndex],
+                                                                 frameWidth,
+                                                                 frameHeight,
+                                                                 expectedDx,
+                                                                 expectedDy,
+                                                                 adjacentProbeDx,
+                                                                 adjacentProbeDy,
+                                                                 lowContrastMode,
+                                                                 frameLuma[frameIndex - 1],
+                                                                 frameLuma[frameIndex],
+                                                                 adjacentVle,
+                                                                 &adjacentProbeNearStationary,
+                                                                 false,
+                                                                 nullptr,
+                                                                 true,
+                                                                 true );
+    StitchLog( L"[Panorama/Stitch] GapBridgeProbe adjacent-pair frame=%zu prev=%zu ok=%d probe=(%d,%d) expectedSingle=(%d,%d) nearStationary=%d\n",
+                 frameIndex,
+                 frameIndex - 1,
+                 adjacentProbeOk ? 1 : 0,
+                 adjacentProbeDx,
+                 adjacentProbeDy,
+                 expectedDx,
+                 expectedDy,
+                 adjacentProbeNearStationary ? 1 : 0 );
+}
+
+static int DivideRounded( int value, int divisor )
+{
+    if( divisor <= 1 )
+    {
+        return value;
+    }
+
+    if( value >= 0 )
+    {
+        return ( value + divisor / 2 ) / divisor;
+    }
+
+    return -( ( -value + divisor / 2 ) / divisor );
+}
+
+//----------------------------------------------------------------------------
+//
+// Performance profiling for FindBestFrameShiftVerticalOnly
+//
+//----------------------------------------------------------------------------
+#ifdef _DEBUG
+struct StitchPerfCounters
+{
+    int64_t totalCalls;
+    int64_t tBuildDsLuma;       // BuildDownsampledLuma
+    int64_t tStationary;        // Stationary score
+    int64_t tVleMask;           // VLE/HCF mask build + dilation
+    int64_t tCoarseSearch;      // Coarse search loop
+    int64_t tFullResLuma;       // BuildFullLumaFrame (when not precomputed)
+    int64_t tProbeInject;       // Probe/candidate injection
+    int64_t tFineSearch;        // Fine search (Phase 2)
+    int64_t tPostValidation;    // Post-search validation/ambiguity
+    int64_t tTotal;             // Total function time
+    int64_t tEdgeProjection;    // Edge-density NCC (HCF injection)
+    int64_t tMaskedFallback;    // Full-res masked coarse fallback
+    int64_t tPhaseCorrelation;  // Row-profile phase correlation seeding
+
+    StitchPerfCounters() { Reset(); }
+    void Reset() { memset( &totalCalls, 0, reinterpret_cast<char*>(&tPhaseCorrelation + 1) - reinterpret_cast<char*>(&totalCalls) ); }
+
+    static double UsFromTicks( int64_t ticks )
+    {
+        return static_cast<double>( ticks ) / 1000.0;
+    }
+
+    void Report()
+    {
+        if( totalCalls == 0 ) return;
+        StitchLog( L"[Panorama/Perf] === FindBestFrameShiftVerticalOnly profiling (%lld calls) ===\n", totalCalls );
+        StitchLog( L"[Panorama/Perf]   Total:          %8.0f us (%.0f us/call)\n", UsFromTicks( tTotal ), UsFromTicks( tTotal ) / totalCalls );
+        StitchLog( L"[Panorama/Perf]   BuildDsLuma:    %8.0f us (%.1f%%)\n", UsFromTicks( tBuildDsLuma ), tBuildDsLuma * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   Stationary:     %8.0f us (%.1f%%)\n", UsFromTicks( tStationary ), tStationary * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   VLE/HCF mask:   %8.0f us (%.1f%%)\n", UsFromTicks( tVleMask ), tVleMask * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   CoarseSearch:   %8.0f us (%.1f%%)\n", UsFromTicks( tCoarseSearch ), tCoarseSearch * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   MaskedFallback: %8.0f us (%.1f%%)\n", UsFromTicks( tMaskedFallback ), tMaskedFallback * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   PhaseCorr:      %8.0f us (%.1f%%)\n", UsFromTicks( tPhaseCorrelation ), tPhaseCorrelation * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   FullResLuma:    %8.0f us (%.1f%%)\n", UsFromTicks( tFullResLuma ), tFullResLuma * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   ProbeInject:    %8.0f us (%.1f%%)\n", UsFromTicks( tProbeInject ), tProbeInject * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   EdgeProjection: %8.0f us (%.1f%%)\n", UsFromTicks( tEdgeProjection ), tEdgeProjection * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   FineSearch:     %8.0f us (%.1f%%)\n", UsFromTicks( tFineSearch ), tFineSearch * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf]   PostValidation: %8.0f us (%.1f%%)\n", UsFromTicks( tPostValidation ), tPostValidation * 100.0 / max( tTotal, int64_t{ 1 } ) );
+        StitchLog( L"[Panorama/Perf] ===================================================\n" );
+    }
+};
+static StitchPerfCounters g_StitchPerf;
+
+// Counters are in nanoseconds.
+static int64_t PerfNow()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+struct ScopedPerfTimer
+{
+    int64_t& accumulator;
+    int64_t start;
+    ScopedPerfTimer( int64_t& acc ) : accumulator( acc ), start( PerfNow() ) {}
+    ~ScopedPerfTimer() { accumulator += PerfNow() - start; }
+};
+#define PERF_TIMER(field) ScopedPerfTimer _pt_##field( g_StitchPerf.field )
+#define PERF_START(field) const int64_t _ps_##field = PerfNow()
+#define PERF_STOP(field) { g_StitchPerf.field += PerfNow() - _ps_##field; }
+#else
+#define PERF_TIMER(field) ((void)0)
+#define PERF_START(field) ((void)0)
+#define PERF_STOP(field)  ((void)0)
+#endif
+
+static bool ComputeAveragePixelDifference( const std::vector<BYTE>& currentPixels,
+                                           const std::vector<BYTE>& previousPixels,
+                                           int frameWidth,
+                                           int frameHeight,
+                                           uint64_t& avgDiff,
+                                           double& changedPixelFraction,
+                                           int sampleStep = 6,
+                                           unsigned phase = 0 )
+{
+    if( currentPixels.size() != previousPixels.size() || frameWidth <= 0 || frameHeight <= 0 )
+        return false;
+
+    const int stride = frameWidth * 4;
+    const int marginX = max( 4, frameWidth / 40 );
+    const int marginY = max( 4, frameHeight / 40 );
+    const int startX = marginX;
+    const int endX = frameWidth - marginX;
+    const int startY = marginY;
+    const int endY = frameHeight - marginY;
+
+    if( endX <= startX || endY <= startY )
+        return false;
+
+    const int step = max( 1, sampleStep );
+    const int phaseX = ( step > 1 ) ? static_cast<int>( ( phase * 3u ) % static_cast<unsigned>( step ) ) : 0;
+    const int phaseY = ( step > 1 ) ? static_cast<int>( ( phase * 5u ) % static_cast<unsigned>( step ) ) : 0;
+
+    int y0 = startY + phaseY;
+    if( y0 >= endY ) y0 = startY;
+
+    int x0 = startX + phaseX;
+    if( x0 >= endX ) x0 = startX;
+
+    uint64_t totalDiff = 0;
+    uint64_t samples = 0;
+    uint64_t changedPixels = 0;
+    uint64_t pixelSamples = 0;
+
+    for( int y = y0; y < endY; y += step )
+    {
+        const int rowOffset = y * stride;
+        for( int x = x0; x < endX; x += step )
+        {
+            const int index = rowOffset + x * 4;
+            const int d0 = abs( static_cast<int>( currentPixels[index + 0] ) - static_cast<int>( previousPixels[index + 0] ) );
+            const int d1 = abs( static_cast<int>( currentPixels[index + 1] ) - static_cast<int>( previousPixels[index + 1] ) );
+            const int d2 = abs( static_cast<int>( currentPixels[index + 2] ) - static_cast<int>( previousPixels[index + 2] ) );
+            const int sum = d0 + d1 + d2;
+
+            totalDiff += static_cast<uint64_t>( sum );
+            samples += 3;
+            pixelSamples++;
+            if( sum > 30 )
+                changedPixels++;
+        }
+    }
+
+    if( samples == 0 )
+        return false;
+
+    avgDiff = totalDiff / samples;
+    changedPixelFraction = ( pixelSamples > 0 )
+        ? static_cast<double>( changedPixels ) / static_cast<double>( pixelSamples )
+        : 0.0;
+
+    return true;
+}
+
+
+// Per-frame "very low entropy" detection
+// Returns the fraction of pixels in a frame that sit in constant/uniform
+// regions (local max-luma-deviation within a 5x5 block <= 3).  Sampled
+// every 4th pixel in both axes for speed.  A pair of frames is "very
+// low entropy" if both frames have constantFraction > 0.58.
+double ComputeConstantContentFraction( const std::vector<BYTE>& pixels,
+                                       int frameWidth,
+                                       int frameHeight )
+{
+    if( frameWidth <= 8 || frameHeight <= 8 )
+        return 0.0;
+
+    auto pixelLuma = [&]( int x, int y ) -> int
+    {
+        const int idx = ( y * frameWidth + x ) * 4;
+        return ( pixels[idx + 2] * 77 + pixels[idx + 1] * 150 + pixels[idx + 0] * 29 ) >> 8;
+    };
+
+    const int sampleStep = 4;
+    const int radius = 2;
+    uint64_t constantCount = 0;
+    uint64_t totalCount = 0;
+
+    for( int y = radius; y < frameHeight - radius; y += sampleStep )
+    {
+        for( int x = radius; x < frameWidth - radius; x += sampleStep )
+        {
+            const int centerLuma = pixelLuma( x, y );
+            int maxDev = 0;
+            for( int ny = -radius; ny <= radius && maxDev <= 3; ny += 2 )
+            {
+                for( int nx = -radius; nx <= radius && maxDev <= 3; nx += 2 )
+                {
+                    const int dev = abs( pixelLuma( x + nx, y + ny ) - centerLuma );
+                    if( dev > maxDev )
+                        maxDev = dev;
+                }
+            }
+            totalCount++;
+            if( maxDev <= 3 )
+                constantCount++;
+        }
+    }
+
+    return ( totalCount > 0 ) ? static_cast<double>( constantCount ) / static_cast<double>( totalCount ) : 0.0;
+}
+
+static bool IsVeryLowEntropyPair( const std::vector<BYTE>& previousPixels,
+                                  const std::vector<BYTE>& currentPixels,
+                                  int frameWidth,
+                                  int frameHeight )
+{
+    const double prevConstant = ComputeConstantContentFraction( previousPixels, frameWidth, frameHeight );
+    const double currConstant = ComputeConstantContentFraction( currentPixels, frameWidth, frameHeight );
+    return ( prevConstant > 0.58 && currConstant > 0.58 );
+}
+
+// Informative pixel difference
+// Computes the average pixel difference ONLY at "informative" locations
+// (pixels where the local luma gradient exceeds a threshold, i.e. edges
+// and text, not flat background).  Used to rescue frames that look like
+// duplicates overall but have meaningful changes in their content areas.
+static bool ComputeInformativePixelDifference( const std::vector<BYTE>& currentPixels,
+                                               const std::vector<BYTE>& previousPixels,
+                                               int frameWidth,
+                                               int frameHeight,
+                                               uint64_t& informativeDiff,
+                                               uint64_t& informativeCount )
+{
+    informativeDiff = 0;
+    informativeCount = 0;
+    if( frameWidth < 8 || frameHeight < 8 )
+        return false;
+
+    const int stride = frameWidth * 4;
+    const int edgeThreshold = 4;
+
+    // Sample every 2nd pixel to keep it fast.
+    for( int y = 1; y < frameHeight - 1; y += 2 )
+    {
+        const int rowOff = y * stride;
+        for( int x = 1; x < frameWidth - 1; x += 2 )
+        {
+            const int idx = rowOff + x * 4;
+            // Luma of current position in the PREVIOUS frame (where
+            // we want to detect edges).
+            auto lumaAt = [&]( const std::vector<BYTE>& px, int ix, int iy ) -> int
+            {
+                const int i = ( iy * frameWidth + ix ) * 4;
+                return ( px[i + 2] * 77 + px[i + 1] * 150 + px[i + 0] * 29 ) >> 8;
+            };
+
+            // Check gradient in previous frame.
+            const int prevLuma = lumaAt( previousPixels, x, y );
+            const int gradH = abs( prevLuma - lumaAt( previousPixels, x + 1, y ) );
+            const int gradV = abs( prevLuma - lumaAt( previousPixels, x, y + 1 ) );
+
+            // Also check gradient in current frame (text may have scrolled in).
+            const int currLuma = lumaAt( currentPixels, x, y );
+            const int gradH2 = abs( currLuma - lumaAt( currentPixels, x + 1, y ) );
+            const int gradV2 = abs( currLuma - lumaAt( currentPixels, x, y + 1 ) );
+
+            if( ( gradH + gradV ) >= edgeThreshold || ( gradH2 + gradV2 ) >= edgeThreshold )
+            {
+                // This is an informative pixel.  Compute RGB diff.
+                const int d0 = abs( static_cast<int>( currentPixels[idx + 0] ) - static_cast<int>( previousPixels[idx + 0] ) );
+                const int d1 = abs( static_cast<int>( currentPixels[idx + 1] ) - static_cast<int>( previousPixels[idx + 1] ) );
+                const int d2 = abs( static_cast<int>( currentPixels[idx + 2] ) - static_cast<int>( previousPixels[idx + 2] ) );
+                informativeDiff += static_cast<uint64_t>( d0 + d1 + d2 );
+                informativeCount++;
+            }
+        }
+    }
+
+    return ( informativeCount > 0 );
+}
+
+static void BuildDownsampledLumaFrame( const std::vector<BYTE>& pixels,
+                                       int frameWidth,
+                                       int frameHeight,
+                                       int scale,
+                                       std::vector<BYTE>& luma,
+                                       int& downsampledWidth,
+                                       int& downsampledHeight )
+{
+    downsampledWidth = max( 1, frameWidth / scale );
+    downsampledHeight = max( 1, frameHeight / scale );
+    luma.resize( static_cast<size_t>( downsampledWidth ) * static_cast<size_t>( downsampledHeight ) );
+
+    for( int y = 0; y < downsampledHeight; ++y )
+    {
+        const int sourceY = min( frameHeight - 1, y * scale + ( scale / 2 ) );
+        for( int x = 0; x < downsampledWidth; ++x )
+        {
+            const int sourceX = min( frameWidth - 1, x * scale + ( scale / 2 ) );
+            const int sourceIndex = ( sourceY * frameWidth + sourceX ) * 4;
+            const int l = ( pixels[sourceIndex + 2] * 77 +
+                            pixels[sourceIndex + 1] * 150 +
+                            pixels[sourceIndex + 0] * 29 ) >> 8;
+            luma[static_cast<size_t>( y ) * static_cast<size_t>( downsampledWidth ) + static_cast<size_t>( x )] =
+                static_cast<BYTE>( l );
+        }
+    }
+}
+
+// Build a full-resolution single-channel luma array from 32-bpp BGRA pixels.
+void BuildFullLumaFrame( const std::vector<BYTE>& pixels,
+                         int frameWidth,
+                         int frameHeight,
+                         std::vector<BYTE>& luma )
+{
+    const size_t pixelCount = static_cast<size_t>( frameWidth ) * static_cast<size_t>( frameHeight );
+    luma.resize( pixelCount );
+    const BYTE* src = pixels.data();
+    BYTE* dst = luma.data();
+    size_t p = 0;
+
+#if defined(PANORAMA_STITCH_NEON)
+    // NEON: process 8 BGRA pixels per iteration.
+    for( ; p + 8 <= pixelCount; p += 8 )
+    {
+        const uint8x8x4_t bgra = vld4_u8( src + p * 4 );
+        const uint16x8_t rw = vmull_u8( bgra.val[2], vdup_n_u8( 77 ) );
+        const uint16x8_t gw = vmull_u8( bgra.val[1], vdup_n_u8( 150 ) );
+        const uint16x8_t bw = vmull_u8( bgra.val[0], vdup_n_u8( 29 ) );
+        const uint16x8_t sum = vaddq_u16( vaddq_u16( rw, gw ), bw );
+        vst1_u8( dst + p, vshrn_n_u16( sum, 8 ) );
+    }
+#elif defined(PANORAMA_STITCH_SSE2)
+    // SSE2: process 4 BGRA pixels per iteration using _mm_madd_epi16
+    // for pairwise multiply-add of adjacent 16-bit words to 32-bit.
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i coeffs = _mm_setr_epi16( 29, 150, 77, 0, 29, 150, 77, 0 );
+    const __m128i mask_even32 = _mm_setr_epi32( -1, 0, -1, 0 );
+    for( ; p + 4 <= pixelCount; p += 4 )
+    {
+        const __m128i bgra = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + p * 4 ) );
+        // Unpack interleaved BGRA bytes to 16-bit words.
+        const __m128i lo16 = _mm_unpacklo_epi8( bgra, zero );  // B0 G0 R0 A0 B1 G1 R1 A1
+        const __m128i hi16 = _mm_unpackhi_epi8( bgra, zero );  // B2 G2 R2 A2 B3 G3 R3 A3
+        // _mm_madd_epi16: [B*29+G*150, R*77+A*0, ...]  per 32-bit lane pair.
+        const __m128i prod_lo = _mm_madd_epi16( lo16, coeffs );
+        const __m128i prod_hi = _mm_madd_epi16( hi16, coeffs );
+        // Sum adjacent 32-bit pairs within each 64-bit lane.
+        const __m128i sum_lo = _mm_add_epi32( _mm_and_si128( prod_lo, mask_even32 ),
+                                              _mm_srli_epi64( prod_lo, 32 ) );
+        const __m128i sum_hi = _mm_add_epi32( _mm_and_si128( prod_hi, mask_even32 ),
+                                              _mm_srli_epi64( prod_hi, 32 ) );
+        // >> 8 to divide by 256, then pack 32 -> 16 -> 8.
+        const __m128i l32 = _mm_packs_epi32( _mm_srli_epi32( sum_lo, 8 ),
+                                             _mm_srli_epi32( sum_hi, 8 ) );
+        const __m128i l8 = _mm_packus_epi16( l32, zero );
+        // l8 has [l0, 0, l1, 0, l2, 0, l3, 0, ...] because the odd 32-bit
+        // lanes were zero before packing.  Extract even bytes.
+        dst[p + 0] = static_cast<BYTE>( _mm_extract_epi16( l8, 0 ) & 0xFF );
+        dst[p + 1] = static_cast<BYTE>( _mm_extract_epi16( l8, 1 ) & 0xFF );
+        dst[p + 2] = static_cast<BYTE>( _mm_extract_epi16( l8, 2 ) & 0xFF );
+        dst[p + 3] = static_cast<BYTE>( _mm_extract_epi16( l8, 3 ) & 0xFF );
+    }
+#endif
+
+    for( ; p < pixelCount; ++p )
+    {
+        const size_t idx = p * 4;
+        dst[p] = static_cast<BYTE>( ( src[idx + 2] * 77 +
+                                      src[idx + 1] * 150 +
+                                      src[idx + 0] * 29 ) >> 8 );
+    }
+}
+
+// Downsample from a pre-computed full-resolution luma array.
+static void BuildDownsampledLumaFromFullLuma( const std::vector<BYTE>& fullLuma,
+                                              int frameWidth,
+                                              int frameHeight,
+                                              int scale,
+                                              std::vector<BYTE>& luma,
+                                              int& downsampledWidth,
+                                              int& downsampledHeight )
+{
+    downsampledWidth = max( 1, frameWidth / scale );
+    downsampledHeight = max( 1, frameHeight / scale );
+    luma.resize( static_cast<size_t>( downsampledWidth ) * static_cast<size_t>( downsampledHeight ) );
+    for( int y = 0; y < downsampledHeight; ++y )
+    {
+        const int sourceY = min( frameHeight - 1, y * scale + ( scale / 2 ) );
+        for( int x = 0; x < downsampledWidth; ++x )
+        {
+            const int sourceX = min( frameWidth - 1, x * scale + ( scale / 2 ) );
+            luma[static_cast<size_t>( y ) * static_cast<size_t>( downsampledWidth ) + static_cast<size_t>( x )] =
+                fullLuma[static_cast<size_t>( sourceY ) * static_cast<size_t>( frameWidth ) + static_cast<size_t>( sourceX )];
+        }
+    }
+}
+
+// Compute per-row sum of horizontal gradient magnitudes.
+// This is a 1D "edge density" signal: rows with text/edges have high values,
+// constant rows (dark background) have ~0.  NCC on these signals discriminates
+// offsets by structural content alignment rather than pixel identity.
+static void BuildRowEdgeDensity( const std::vector<BYTE>& luma,
+                                 int width, int height, int marginX,
+                                 std::vector<int>& density )
+{
+    density.resize( height, 0 );
+    for( int y = 0; y < height; ++y )
+    {
+        const int row = y * width;
+        const BYTE* rowPtr = luma.data() + row;
+        const int xStart = marginX;
+        const int xEnd = width - marginX - 1;
+        int sum = 0;
+        int x = xStart;
+#if defined(PANORAMA_STITCH_NEON)
+        uint32x4_t vSum = vdupq_n_u32( 0 );
+        for( ; x + 16 <= xEnd; x += 16 )
+        {
+            const uint8x16_t cur  = vld1q_u8( rowPtr + x );
+            const uint8x16_t next = vld1q_u8( rowPtr + x + 1 );
+            const uint8x16_t diff = vabdq_u8( cur, next );
+            const uint16x8_t sum16 = vpaddlq_u8( diff );
+            vSum = vaddq_u32( vSum, vpaddlq_u16( sum16 ) );
+        }
+        sum = static_cast<int>( vaddvq_u32( vSum ) );
+#endif
+        for( ; x < xEnd; ++x )
+        {
+            sum += abs( static_cast<int>( rowPtr[x + 1] ) -
+                        static_cast<int>( rowPtr[x] ) );
+        }
+        density[y] = sum;
+    }
+}
+
+// 1D Normalized Cross-Correlation between two int signals.
+// Returns NCC in [-1.0, 1.0].  Returns 0.0 if either signal has zero variance.
+static double NCC1D( const int* a, const int* b, int n )
+{
+    if( n <= 0 ) return 0.0;
+
+    int64_t iSumA = 0, iSumB = 0, iSumAB = 0, iSumA2 = 0, iSumB2 = 0;
+    int i = 0;
+#if defined(PANORAMA_STITCH_NEON)
+    // NEON: accumulate 4 int32 elements per iteration using widening
+    // multiply-accumulate (vmlal_s32) for products.
+    int64x2_t vSumA  = vdupq_n_s64( 0 );
+    int64x2_t vSumB  = vdupq_n_s64( 0 );
+    int64x2_t vSumAB = vdupq_n_s64( 0 );
+    int64x2_t vSumA2 = vdupq_n_s64( 0 );
+    int64x2_t vSumB2 = vdupq_n_s64( 0 );
+    for( ; i + 4 <= n; i += 4 )
+    {
+        const int32x4_t va = vld1q_s32( a + i );
+        const int32x4_t vb = vld1q_s32( b + i );
+        // Pairwise add-long for sums (s32 -> s64).
+        vSumA = vaddq_s64( vSumA, vpaddlq_s32( va ) );
+        vSumB = vaddq_s64( vSumB, vpaddlq_s32( vb ) );
+        // Widening multiply-accumulate: low and high halves separately.
+        const int32x2_t aLo = vget_low_s32( va );
+        const int32x2_t aHi = vget_high_s32( va );
+        const int32x2_t bLo = vget_low_s32( vb );
+        const int32x2_t bHi = vget_high_s32( vb );
+        vSumAB = vmlal_s32( vmlal_s32( vSumAB, aLo, bLo ), aHi, bHi );
+        vSumA2 = vmlal_s32( vmlal_s32( vSumA2, aLo, aLo ), aHi, aHi );
+        vSumB2 = vmlal_s32( vmlal_s32( vSumB2, bLo, bLo ), bHi, bHi );
+    }
+    iSumA  = vgetq_lane_s64( vSumA, 0 )  + vgetq_lane_s64( vSumA, 1 );
+    iSumB  = vgetq_lane_s64( vSumB, 0 )  + vgetq_lane_s64( vSumB, 1 );
+    iSumAB = vgetq_lane_s64( vSumAB, 0 ) + vgetq_lane_s64( vSumAB, 1 );
+    iSumA2 = vgetq_lane_s64( vSumA2, 0 ) + vgetq_lane_s64( vSumA2, 1 );
+    iSumB2 = vgetq_lane_s64( vSumB2, 0 ) + vgetq_lane_s64( vSumB2, 1 );
+#endif
+    for( ; i < n; ++i )
+    {
+        const int64_t ai = static_cast<int64_t>( a[i] );
+        const int64_t bi = static_cast<int64_t>( b[i] );
+        iSumA  += ai;
+        iSumB  += bi;
+        iSumAB += ai * bi;
+        iSumA2 += ai * ai;
+        iSumB2 += bi * bi;
+    }
+    const double N    = static_cast<double>( n );
+    const double sumA = static_cast<double>( iSumA );
+    const double sumB = static_cast<double>( iSumB );
+    const double varA = static_cast<double>( iSumA2 ) / N - ( sumA / N ) * ( sumA / N );
+    const double varB = static_cast<double>( iSumB2 ) / N - ( sumB / N ) * ( sumB / N );
+    if( varA <= 0.0 || varB <= 0.0 ) return 0.0;
+    const double cov = static_cast<double>( iSumAB ) / N - ( sumA / N ) * ( sumB / N );
+    return cov / sqrt( varA * varB );
+}
+
+//----------------------------------------------------------------------------
+//
+// Row-profile phase correlation
+//
+// Coarse vertical shift estimate whose cost does not depend on how far the
+// content moved.  Each frame is reduced to per-band row profiles (horizontal
+// edge density), and the peaks of their phase correlation are the likely
+// shifts.  The peaks only seed the candidate list of
+// FindBestFrameShiftVerticalOnly; the full-resolution search still decides.
+//
+//----------------------------------------------------------------------------
+constexpr int kPhaseCorrelationBands = 4;
+
+struct PhaseCorrelationPeak
+{
+    int dy;         // curr[y] matches prev[y - dy]
+    double ncc;     // Mean band-profile NCC over the overlapping rows
+};
+
+// In-place radix-2 complex FFT, unscaled.  size must be a power of two.
+static void FourierTransform( double* re, double* im, int size, bool inverse )
+{
+    for( int i = 1, j = 0; i < size; ++i )
+    {
+        int bit = size >> 1;
+        for( ; j & bit; bit >>= 1 )
+        {
+            j ^= bit;
+        }
+        j ^= bit;
+        if( i < j )
+        {
+            std::swap( re[i], re[j] );
+            std::swap( im[i], im[j] );
+        }
+    }
+
+    for( int length = 2; length <= size; length <<= 1 )
+    {
+        const double angle = ( inverse ? 2.0 : -2.0 ) * 3.14159265358979323846 / length;
+        const double stepRe = cos( angle );
+        const double stepIm = sin( angle );
+        const int half = length / 2;
+        for( int start = 0; start < size; start += length )
+        {
+            double wRe = 1.0;
+            double wIm = 0.0;
+            for( int k = 0; k < half; ++k )
+            {
+                const int a = start + k;
+                const int b = a + half;
+                const double tRe = re[b] * wRe - im[b] * wIm;
+                const double tIm = re[b] * wIm + im[b] * wRe;
+                re[b] = re[a] - tRe;
+                im[b] = im[a] - tIm;
+                re[a] += tRe;
+                im[a] += tIm;
+                const double nextRe = wRe * stepRe - wIm * stepIm;
+                wIm = wRe * stepIm + wIm * stepRe;
+                wRe = nextRe;
+            }
+        }
+    }
+}
+
+// Per-row sum of horizontal gradient magnitudes for kPhaseCorrelationBands
+// equal-width vertical bands, stored band-major (profiles[band * height + y]).
+// Splitting the width keeps lines of different layout from looking alike,
+// which a single whole-row profile cannot tell apart.
+static void BuildBandRowEdgeDensity( const std::vector<BYTE>& luma,
+                                     int width, int height, int marginX,
+                                     std::vector<int>& profiles )
+{
+    profiles.assign( static_cast<size_t>( kPhaseCorrelationBands ) * height, 0 );
+    const int span = width - 2 * marginX - 1;
+    for( int y = 0; y < height; ++y )
+    {
+        const BYTE* rowPtr = luma.data() + static_cast<size_t>( y ) * width;
+        for( int band = 0; band < kPhaseCorrelationBands; ++band )
+        {
+            const int xEnd = marginX + span * ( band + 1 ) / kPhaseCorrelationBands;
+            int x = marginX + span * band / kPhaseCorrelationBands;
+            int sum = 0;
+#if defined(PANORAMA_STITCH_SSE2)
+            __m128i sadAcc = _mm_setzero_si128();
+            for( ; x + 16 <= xEnd; x += 16 )
+            {
+                const __m128i cur  = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rowPtr + x ) );
+                const __m128i next = _mm_loadu_si128( reinterpret_cast<const __m128i*>( rowPtr + x + 1 ) );
+                const __m128i diff = _mm_or_si128( _mm_subs_epu8( cur, next ), _mm_subs_epu8( next, cur ) );
+                sadAcc = _mm_add_epi64( sadAcc, _mm_sad_epu8( diff, _mm_setzero_si128() ) );
+            }
+            sum = static_cast<int>( _mm_cvtsi128_si64( sadAcc ) + _mm_cvtsi128_si64( _mm_srli_si128( sadAcc, 8 ) ) );
+#elif defined(PANORAMA_STITCH_NEON)
+            uint32x4_t vSum = vdupq_n_u32( 0 );
+            for( ; x + 16 <= xEnd; x += 16 )
+            {
+                const uint8x16_t cur  = vld1q_u8( rowPtr + x );
+                const uint8x16_t next = vld1q_u8( rowPtr + x + 1 );
+                vSum = vaddq_u32( vSum, vpaddlq_u16( vpaddlq_u8( vabdq_u8( cur, next ) ) ) );
+            }
+            sum = static_cast<int>( vaddvq_u32( vSum ) );
+#endif
+            for( ; x < xEnd; ++x )
+            {
+                sum += abs( static_cast<int>( rowPtr[x + 1] ) -
+                            static_cast<int>( rowPtr[x] ) );
+            }
+            profiles[static_cast<size_t>( band ) * height + y] = sum;
+        }
+    }
+}
+
+// Finds up to maxPeaks vertical shifts between two full-resolution luma
+// frames with minStep <= |dy|, dy in [searchMinDy, searchMaxDy] and at least
+// minOverlap overlapping rows.  Returns the number found, best NCC first.
+//
+// The band cross-power spectra are whitened and summed, so every band votes
+// equally and the correlation peak stays sharp on text whose profile is
+// dominated by the line pitch.  The surface ignores how many rows overlap,
+// so twice as many peaks as requested are re-scored with the overlap-aware
+// NCC of the profiles.
+static int EstimateVerticalShiftsByPhaseCorrelation( const std::vector<BYTE>& previousLuma,
+                                                      const std::vector<BYTE>& currentLuma,
+                                                      int width,
+                                                      int height,
+                                                      int minStep,
+                                                      int searchMinDy,
+                                                      int searchMaxDy,
+                                                      int minOverlap,
+                                                      PhaseCorrelationPeak* peaks,
+                                                      int maxPeaks )
+{
+    const int marginX = max( 4, width / 20 );
+    if( maxPeaks <= 0 || width - 2 * marginX < 16 * kPhaseCorrelationBands || height < 16 )
+    {
+        return 0;
+    }
+
+    std::vector<int> previousProfiles;
+    std::vector<int> currentProfiles;
+    BuildBandRowEdgeDensity( previousLuma, width, height, marginX, previousProfiles );
+    BuildBandRowEdgeDensity( currentLuma, width, height, marginX, currentProfiles );
+
+    // Zero-pad to at least twice the height so the correlation is linear
+    // rather than circular.
+    int size = 1;
+    while( size < 2 * height )
+    {
+        size <<= 1;
+    }
+    std::vector<double> re( size ), im( size );
+    std::vector<double> sumRe( size, 0.0 ), sumIm( size, 0.0 );
+    bool usableBand[kPhaseCorrelationBands]{};
+    int usableBands = 0;
+    for( int band = 0; band < kPhaseCorrelationBands; ++band )
+    {
+        const int* previousProfile = &previousProfiles[static_cast<size_t>( band ) * height];
+        const int* currentProfile = &currentProfiles[static_cast<size_t>( band ) * height];
+        int64_t previousSum = 0, currentSum = 0;
+        int previousMin = INT_MAX, previousMax = 0, currentMin = INT_MAX, currentMax = 0;
+        for( int y = 0; y < height; ++y )
+        {
+            previousSum += previousProfile[y];
+            currentSum += currentProfile[y];
+            previousMin = min( previousMin, previousProfile[y] );
+            previousMax = max( previousMax, previousProfile[y] );
+            currentMin = min( currentMin, currentProfile[y] );
+            currentMax = max( currentMax, currentProfile[y] );
+        }
+        if( previousMax == previousMin || currentMax == currentMin )
+        {
+            continue;
+        }
+
+        // Both real profiles go through one complex transform, previous as
+        // the real part and current as the imaginary part.
+        const double previousMean = static_cast<double>( previousSum ) / height;
+        const double currentMean = static_cast<double>( currentSum ) / height;
+        std::fill( re.begin(), re.end(), 0.0 );
+        std::fill( im.begin(), im.end(), 0.0 );
+        for( int y = 0; y < height; ++y )
+        {
+            re[y] = previousProfile[y] - previousMean;
+            im[y] = currentProfile[y] - currentMean;
+        }
+        FourierTransform( re.data(), im.data(), size, false );
+
+        // current * conj(previous), normalized to unit magnitude.
+        for( int k = 0; k < size; ++k )
+        {
+            const int mirror = ( size - k ) & ( size - 1 );
+            const double previousRe = 0.5 * ( re[k] + re[mirror] );
+            const double previousIm = 0.5 * ( im[k] - im[mirror] );
+            const double currentRe = 0.5 * ( im[k] + im[mirror] );
+            const double currentIm = 0.5 * ( re[mirror] - re[k] );
+            const double crossRe = currentRe * previousRe + currentIm * previousIm;
+            const double crossIm = currentIm * previousRe - currentRe * previousIm;
+            const double magnitude = sqrt( crossRe * crossRe + crossIm * crossIm );
+            if( magnitude > 1e-9 )
+            {
+                sumRe[k] += crossRe / magnitude;
+                sumIm[k] += crossIm / magnitude;
+            }
+        }
+        usableBand[band] = true;
+        usableBands++;
+    }
+    if( usableBands == 0 )
+    {
+        return 0;
+    }
+    FourierTransform( sumRe.data(), sumIm.data(), size, true );
+
+    // Shortlist the local maxima of the correlation surface.
+    constexpr int kMaxShortlist = 16;
+    const int shortlistLimit = min( kMaxShortlist, 2 * maxPeaks );
+    PhaseCorrelationPeak shortlist[kMaxShortlist];
+    int shortlistCount = 0;
+    const int firstDy = max( searchMinDy, -( height - minOverlap ) );
+    const int lastDy = min( searchMaxDy, height - minOverlap );
+    auto surface = [&]( int dy ) { return sumRe[static_cast<size_t>( ( dy + size ) % size )]; };
+    for( int dy = firstDy; dy <= lastDy; ++dy )
+    {
+        if( abs( dy ) < minStep )
+        {
+            continue;
+        }
+        const double value = surface( dy );
+        if( value <= 0.0 || value <= surface( dy - 1 ) || value < surface( dy + 1 ) )
+        {
+            continue;
+        }
+        if( shortlistCount < shortlistLimit || value > shortlist[shortlistCount - 1].ncc )
+        {
+            int insertPos = shortlistCount < shortlistLimit ? shortlistCount : shortlistCount - 1;
+            for( ; insertPos > 0 && shortlist[insertPos - 1].ncc < value; --insertPos )
+            {
+                shortlist[insertPos] = shortlist[insertPos - 1];
+            }
+            shortlist[insertPos] = { dy, value };
+            if( shortlistCount < shortlistLimit )
+            {
+                shortlistCount++;
+            }
+        }
+    }
+
+    // Re-score with the profile NCC over the rows that actually overlap.
+    for( int i = 0; i < shortlistCount; ++i )
+    {
+        const int dy = shortlist[i].dy;
+        const int absStep = abs( dy );
+        double nccSum = 0.0;
+        for( int band = 0; band < kPhaseCorrelationBands; ++band )
+        {
+            if( usableBand[band] )
+            {
+                const int* previousProfile = &previousProfiles[static_cast<size_t>( band ) * height];
+                const int* currentProfile = &currentProfiles[static_cast<size_t>( band ) * height];
+                nccSum += ( dy < 0 )
+                    ? NCC1D( previousProfile + absStep, currentProfile, height - absStep )
+                    : NCC1D( previousProfile, currentProfile + absStep, height - absStep );
+            }
+        }
+        shortlist[i].ncc = nccSum / usableBands;
+    }
+    std::stable_sort( shortlist, shortlist + shortlistCount,
+                      []( const PhaseCorrelationPeak& a, const PhaseCorrelationPeak& b ) { return a.ncc > b.ncc; } );
+
+    int peakCount = 0;
+    for( int i = 0; i < shortlistCount && peakCount < maxPeaks; ++i )
+    {
+        if( shortlist[i].ncc > 0.0 )
+        {
+            peaks[peakCount++] = shortlist[i];
+        }
+    }
+    return peakCount;
+}
+
+struct FixedOverlayMask
+{
+    int tileWidth = 0;
+    int tileHeight = 0;
+    int tileCols = 0;
+    int tileRows = 0;
+    std::vector<BYTE> maskedTiles;
+
+    // Pixel-level erase region for small floating overlays (e.g. spinner
+    // icon) that are too small/dynamic for tile-based suppression.  Before
+    // composing each frame, pixels within this rect that differ from the
+    // local background are replaced with the background color.
+    RECT eraseRect = {};  // In frame coordinates.  Empty if right<=left.
+
+    // Height of the fixed header at the top of the frame (0 if none).
+    // The first composed frame is exempt from tile-mask suppression
+    // for y < topHeaderHeight so the header appears once at the top.
+    int topHeaderHeight = 0;
+
+    // Pixel row where the fixed bottom strip starts (0 if none).
+    // Used to suppress floating buttons in the margin above the toolbar.
+    int bottomStripY = 0;
+
+    bool Empty() const
+    {
+        return maskedTiles.empty() && eraseRect.right <= eraseRect.left;
+    }
+
+    bool IsMaskedPixel( int x, int y ) const
+    {
+        if( maskedTiles.empty() || tileWidth <= 0 || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return false;
+
+        const int tileX = min( tileCols - 1, max( 0, x / tileWidth ) );
+        const int tileY = min( tileRows - 1, max( 0, y / tileHeight ) );
+        const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( tileCols ) + static_cast<size_t>( tileX );
+        return tileIndex < maskedTiles.size() && maskedTiles[tileIndex] != 0;
+    }
+
+    bool IsMaskedRow( int y ) const
+    {
+        if( maskedTiles.empty() || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return false;
+
+        const int tileY = min( tileRows - 1, max( 0, y / tileHeight ) );
+        const size_t rowBase = static_cast<size_t>( tileY ) * static_cast<size_t>( tileCols );
+        for( int tileX = 0; tileX < tileCols; ++tileX )
+        {
+            if( maskedTiles[rowBase + static_cast<size_t>( tileX )] != 0 )
+                return true;
+        }
+        return false;
+    }
+
+    // Returns true if ALL tile columns in this pixel row are masked.
+    bool IsFullWidthMaskedRow( int y ) const
+    {
+        if( maskedTiles.empty() || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return false;
+
+        const int tileY = min( tileRows - 1, max( 0, y / tileHeight ) );
+        const size_t rowBase = static_cast<size_t>( tileY ) * static_cast<size_t>( tileCols );
+        for( int tx = 0; tx < tileCols; ++tx )
+        {
+            if( maskedTiles[rowBase + static_cast<size_t>( tx )] == 0 )
+                return false;
+        }
+        return true;
+    }
+
+    // Returns the pixel-Y of the first masked row, or -1 if none.
+    int FirstMaskedY() const
+    {
+        if( maskedTiles.empty() || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return -1;
+
+        for( int ty = 0; ty < tileRows; ++ty )
+        {
+            const size_t rowBase = static_cast<size_t>( ty ) * static_cast<size_t>( tileCols );
+            for( int tx = 0; tx < tileCols; ++tx )
+            {
+                if( maskedTiles[rowBase + static_cast<size_t>( tx )] != 0 )
+                    return ty * tileHeight;
+            }
+        }
+        return -1;
+    }
+
+    // Returns the number of rows at the top of the frame that are
+    // mostly masked (majority of tiles in the row are masked).
+    // Returns 0 if there is no contiguous masked header.
+    int TopMaskedRows() const
+    {
+        if( maskedTiles.empty() || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return 0;
+
+        int maskedRowCount = 0;
+        for( int ty = 0; ty < tileRows; ++ty )
+        {
+            const size_t rowBase = static_cast<size_t>( ty ) * static_cast<size_t>( tileCols );
+            int maskedInRow = 0;
+            for( int tx = 0; tx < tileCols; ++tx )
+            {
+                if( maskedTiles[rowBase + static_cast<size_t>( tx )] != 0 )
+                    ++maskedInRow;
+            }
+            // Require majority of tiles masked to count as header row.
+            if( maskedInRow * 2 < tileCols )
+                break;
+            maskedRowCount = ( ty + 1 ) * tileHeight;
+        }
+        return maskedRowCount;
+    }
+
+    // Return the height of a fixed header detected at the top of the
+    // frame.  Uses a lenient check: any tile row starting from the
+    // first masked row that has at least one masked tile is part of
+    // the header.  Returns 0 if there is no header.
+    int TopHeaderHeight() const
+    {
+        if( maskedTiles.empty() || tileHeight <= 0 || tileCols <= 0 || tileRows <= 0 )
+            return 0;
+
+        const int firstMY = FirstMaskedY();
+        if( firstMY < 0 || firstMY > tileHeight )
+            return 0;
+
+        const int startTY = firstMY / max( 1, tileHeight );
+        int headerEndTY = startTY;
+        for( int ty = startTY; ty < tileRows; ++ty )
+        {
+            const size_t rowBase = static_cast<size_t>( ty ) * static_cast<size_t>( tileCols );
+            bool anyMasked = false;
+            for( int tx = 0; tx < tileCols; ++tx )
+            {
+                if( maskedTiles[rowBase + static_cast<size_t>( tx )] != 0 )
+                {
+                    anyMasked = true;
+                    break;
+                }
+            }
+            if( !anyMasked )
+            {
+                headerEndTY = ty;
+                break;
+            }
+        }
+        const int h = headerEndTY * tileHeight;
+        // Sanity: header must be < 1/4 of frame.
+        const int frameH = tileRows * tileHeight;
+        return ( h > 0 && h < frameH / 4 ) ? h : 0;
+    }
+};
+
+struct FixedOverlayDiagnostics
+{
+    int pairCount = 0;
+    int informativeTileComparisons = 0;
+    int strongTileCount = 0;
+    int connectedTileCount = 0;
+    int maskedTileCount = 0;
+    int tileBoundsLeft = 0;
+    int tileBoundsTop = 0;
+    int tileBoundsRight = 0;
+    int tileBoundsBottom = 0;
+    uint64_t suppressedPixels = 0;
+    uint64_t repairedPixels = 0;
+    uint64_t fallbackPixels = 0;
+    int correctedDarkBands = 0;
+    int correctedDarkBandRows = 0;
+    int blendedToBaseline = 0;
+};
+
+static uint64_t RepairSuppressedOverlayHoles( std::vector<BYTE>& pixels,
+                                                      std::vector<BYTE>& written,
+                                                      std::vector<int>& owner,
+                                                      std::vector<BYTE>& blended,
+                                                      const std::vector<BYTE>& suppressed,
+                                                      int width,
+                                                      int height )
+{
+    if( pixels.empty() || written.empty() || owner.empty() || blended.empty() ||
+        suppressed.empty() || width <= 0 || height <= 0 )
+    {
+        return 0;
+    }
+
+    uint64_t repairedPixels = 0;
+    for( int x = 0; x < width; ++x )
+    {
+        int y = 0;
+        while( y < height )
+        {
+            const size_t pixelIndex = static_cast<size_t>( y ) * static_cast<size_t>( width ) + static_cast<size_t>( x );
+            if( written[pixelIndex] != 0 || suppressed[pixelIndex] == 0 )
+            {
+                ++y;
+                continue;
+            }
+
+            const int runStart = y;
+            while( y < height )
+            {
+                const size_t runIndex = static_cast<size_t>( y ) * static_cast<size_t>( width ) + static_cast<size_t>( x );
+                if( written[runIndex] != 0 || suppressed[runIndex] == 0 )
+                {
+                    break;
+                }
+                ++y;
+            }
+            const int runEnd = y - 1;
+
+            int aboveY = runStart - 1;
+            while( aboveY >= 0 )
+            {
+                const size_t aboveIndex = static_cast<size_t>( aboveY ) * static_cast<size_t>( width ) + static_cast<size_t>( x );
+                if( written[aboveIndex] != 0 )
+                {
+                    break;
+                }
+                --aboveY;
+            }
+
+            int belowY = runEnd + 1;
+            while( belowY < height )
+            {
+                const size_t belowIndex = static_cast<size_t>( belowY ) * static_cast<size_t>( width ) + static_cast<size_t>( x );
+                if( written[belowIndex] != 0 )
+                {
+                    break;
+                }
+                ++belowY;
+            }
+
+            const bool hasAbove = aboveY >= 0;
+            const bool hasBelow = belowY < height;
+            if( !hasAbove && !hasBelow )
+            {
+                continue;
+            }
+
+            const size_t abovePixelIndex = hasAbove
+                ? static_cast<size_t>( aboveY ) * static_cast<size_t>( width ) + static_cast<size_t>( x )
+                : 0;
+            const size_t belowPixelIndex = hasBelow
+                ? static_cast<size_t>( belowY ) * static_cast<size_t>( width ) + static_cast<size_t>( x )
+                : 0;
+            const size_t aboveColorIndex = abovePixelIndex * 4;
+            const size_t belowColorIndex = belowPixelIndex * 4;
+
+            for( int fillY = runStart; fillY <= runEnd; ++fillY )
+            {
+                const size_t fillPixelIndex = static_cast<size_t>( fillY ) * static_cast<size_t>( width ) + static_cast<size_t>( x );
+                const size_t fillColorIndex = fillPixelIndex * 4;
+
+                if( hasAbove && hasBelow && belowY > aboveY )
+                {
+                    const int numerator = fillY - aboveY;
+                    const int denominator = belowY - aboveY;
+                    for( int channel = 0; channel < 3; ++channel )
+                    {
+                        const int aboveValue = static_cast<int>( pixels[aboveColorIndex + static_cast<size_t>( channel )] );
+                        const int belowValue = static_cast<int>( pixels[belowColorIndex + static_cast<size_t>( channel )] );
+                        pixels[fillColorIndex + static_cast<size_t>( channel )] = static_cast<BYTE>(
+                            ( aboveValue * ( denominator - numerator ) + belowValue * numerator ) / max( 1, denominator ) );
+                    }
+                    const bool useBelowOwner = numerator * 2 >= denominator;
+                    owner[fillPixelIndex] = useBelowOwner ? owner[belowPixelIndex] : owner[abovePixelIndex];
+                }
+                else
+                {
+                    const size_t sourcePixelIndex = hasAbove ? abovePixelIndex : belowPixelIndex;
+                    const size_t sourceColorIndex = sourcePixelIndex * 4;
+                    pixels[fillColorIndex + 0] = pixels[sourceColorIndex + 0];
+                    pixels[fillColorIndex + 1] = pixels[sourceColorIndex + 1];
+                    pixels[fillColorIndex + 2] = pixels[sourceColorIndex + 2];
+                    owner[fillPixelIndex] = owner[sourcePixelIndex];
+                }
+
+                pixels[fillColorIndex + 3] = 0xFF;
+                written[fillPixelIndex] = 1;
+                blended[fillPixelIndex] = 1;
+                ++repairedPixels;
+            }
+        }
+    }
+
+    return repairedPixels;
+}
+
+// Repairs dark bands caused by overlay suppression breaking the blend chain.
+// After FixedOverlay suppression, rows near frame boundaries lose intermediate-
+// frame blend contributions, creating visible dark streaks.  This function
+// detects those dark rows and scales pixel brightness within the overlay column
+// range to match the surrounding neighborhood luminance.
+static int RepairOverlayDarkBands( std::vector<BYTE>& pixels,
+                                    const std::vector<BYTE>& written,
+                                    const std::vector<BYTE>& blended,
+                                    int overlayLeft,
+                                    int overlayRight,
+                                    int width,
+                                    int height,
+                                    int* outCorrectedRows )
+{
+    if( outCorrectedRows )
+    {
+        *outCorrectedRows = 0;
+    }
+
+    if( pixels.empty() || written.empty() || blended.empty() ||
+        width <= 0 || height <= 0 ||
+        overlayLeft < 0 || overlayRight <= overlayLeft || overlayRight > width )
+    {
+        return 0;
+    }
+
+    // Build per-row luminance and blend statistics.
+    std::vector<int> rowLuma( height, 0 );
+    std::vector<int> rowWritten( height, 0 );
+    std::vector<int> rowBlended( height, 0 );
+    for( int y = 0; y < height; ++y )
+    {
+        uint64_t totalLuma = 0;
+        const size_t pixelRowBase = static_cast<size_t>( y ) * static_cast<size_t>( width ) * 4;
+        const size_t maskRowBase = static_cast<size_t>( y ) * static_cast<size_t>( width );
+        for( int x = 0; x < width; ++x )
+        {
+            const size_t pixelIdx = pixelRowBase + static_cast<size_t>( x ) * 4;
+            totalLuma += ( static_cast<uint64_t>( pixels[pixelIdx + 2] ) * 77 +
+                           static_cast<uint64_t>( pixels[pixelIdx + 1] ) * 150 +
+                           static_cast<uint64_t>( pixels[pixelIdx + 0] ) * 29 ) >> 8;
+            const size_t maskIdx = maskRowBase + static_cast<size_t>( x );
+            if( written[maskIdx] != 0 )
+            {
+                ++rowWritten[y];
+            }
+            if( blended[maskIdx] != 0 )
+            {
+                ++rowBlended[y];
+            }
+        }
+        rowLuma[y] = static_cast<int>( totalLuma / max( 1, width ) );
+    }
+
+    // Detect dark band rows using the same criteria as LogStitchedBandDiagnostics.
+    const int referenceRadius = max( 8, min( 24, height / 40 ) );
+    std::vector<BYTE> darkRowMask( height, 0 );
+    std::vector<int> rowRefLuma( height, 0 );
+
+    for( int y = referenceRadius; y < height - referenceRadius; ++y )
+    {
+        if( rowWritten[y] < width * 9 / 10 )
+        {
+            continue;
+        }
+
+        uint64_t neighborhoodTotal = 0;
+        int neighborhoodCount = 0;
+        for( int offset = -referenceRadius; offset <= referenceRadius; ++offset )
+        {
+            if( offset == 0 || abs( offset ) <= 2 )
+            {
+                continue;
+            }
+            const int sampleY = y + offset;
+            neighborhoodTotal += static_cast<uint64_t>( rowLuma[sampleY] );
+            ++neighborhoodCount;
+        }
+        if( neighborhoodCount <= 0 )
+        {
+            continue;
+        }
+
+        const int refLuma = static_cast<int>( neighborhoodTotal / neighborhoodCount );
+        const int delta = refLuma - rowLuma[y];
+        if( refLuma >= 24 &&
+            delta >= max( 18, refLuma / 5 ) &&
+            rowBlended[y] >= width / 3 )
+        {
+            darkRowMask[y] = 1;
+            rowRefLuma[y] = refLuma;
+        }
+    }
+
+    // Group into bands, find reference rows, and apply per-pixel correction.
+    const int columnFeather = 8;
+    int correctedBandCount = 0;
+    int correctedRowCount = 0;
+
+    for( int y = 0; y < height; )
+    {
+        if( darkRowMask[y] == 0 )
+        {
+            ++y;
+            continue;
+        }
+
+        const int bandStart = y;
+        while( y < height && darkRowMask[y] != 0 )
+        {
+            ++y;
+        }
+        const int bandEnd = y - 1;
+
+        if( bandEnd - bandStart + 1 < 2 )
+        {
+            continue;
+        }
+
+        // Find nearest non-dark reference rows above and below.
+        int refAboveY = bandStart - 1;
+        while( refAboveY >= 0 && darkRowMask[refAboveY] != 0 )
+        {
+            --refAboveY;
+        }
+        int refBelowY = bandEnd + 1;
+        while( refBelowY < height && darkRowMask[refBelowY] != 0 )
+        {
+            ++refBelowY;
+        }
+
+        const bool hasAbove = refAboveY >= 0;
+        const bool hasBelow = refBelowY < height;
+        if( !hasAbove && !hasBelow )
+        {
+            continue;
+        }
+
+        // Apply per-pixel luminance correction for each row in the band.
+        // Only correct columns within the overlay mask range (with feather).
+        for( int bandY = bandStart; bandY <= bandEnd; ++bandY )
+        {
+            const int curRowLuma = rowLuma[bandY];
+            const int refLuma = rowRefLuma[bandY];
+            if( curRowLuma <= 4 || refLuma <= 4 )
+            {
+                continue;
+            }
+
+            // Row-level correction cap (fixed-point: 256 = 1.0).
+            const int rowFactorCap256 = min( 448, ( refLuma * 256 ) / max( 1, curRowLuma ) );
+
+            const int spanTotal = ( hasAbove && hasBelow ) ? ( refBelowY - refAboveY ) : 1;
+            const int spanToAbove = bandY - ( hasAbove ? refAboveY : bandY );
+
+            const size_t pixelRowBase = static_cast<size_t>( bandY ) * static_cast<size_t>( width ) * 4;
+            const size_t aboveRowBase = hasAbove
+                ? static_cast<size_t>( refAboveY ) * static_cast<size_t>( width ) * 4 : 0;
+            const size_t belowRowBase = hasBelow
+                ? static_cast<size_t>( refBelowY ) * static_cast<size_t>( width ) * 4 : 0;
+
+            bool rowCorrected = false;
+
+            // Process columns within overlay range (with feathered edges).
+            const int corrLeft = max( 0, overlayLeft - columnFeather );
+            const int corrRight = min( width, overlayRight + columnFeather );
+
+            for( int x = corrLeft; x < corrRight; ++x )
+            {
+                // Column feather: ramp correction from 0 at edge to full inside.
+                int columnWeight256 = 256;
+                if( x < overlayLeft )
+                {
+                    columnWeight256 = ( ( x - corrLeft ) * 256 ) / max( 1, columnFeather );
+                }
+                else if( x >= overlayRight )
+                {
+                    columnWeight256 = ( ( corrRight - 1 - x ) * 256 ) / max( 1, columnFeather );
+                }
+
+                const size_t pixIdx = pixelRowBase + static_cast<size_t>( x ) * 4;
+
+                // Compute per-pixel reference luminance from vertical neighbors.
+                int pixRefLuma;
+                if( hasAbove && hasBelow )
+                {
+                    const size_t aboveIdx = aboveRowBase + static_cast<size_t>( x ) * 4;
+                    const size_t belowIdx = belowRowBase + static_cast<size_t>( x ) * 4;
+                    const int aboveLuma = ( static_cast<int>( pixels[aboveIdx + 2] ) * 77 +
+                                            static_cast<int>( pixels[aboveIdx + 1] ) * 150 +
+                                            static_cast<int>( pixels[aboveIdx + 0] ) * 29 ) >> 8;
+                    const int belowLuma = ( static_cast<int>( pixels[belowIdx + 2] ) * 77 +
+                                            static_cast<int>( pixels[belowIdx + 1] ) * 150 +
+                                            static_cast<int>( pixels[belowIdx + 0] ) * 29 ) >> 8;
+                    pixRefLuma = ( aboveLuma * ( spanTotal - spanToAbove ) +
+                                   belowLuma * spanToAbove ) / max( 1, spanTotal );
+                }
+                else if( hasAbove )
+                {
+                    const size_t aboveIdx = aboveRowBase + static_cast<size_t>( x ) * 4;
+                    pixRefLuma = ( static_cast<int>( pixels[aboveIdx + 2] ) * 77 +
+                                   static_cast<int>( pixels[aboveIdx + 1] ) * 150 +
+                                   static_cast<int>( pixels[aboveIdx + 0] ) * 29 ) >> 8;
+                }
+                else
+                {
+                    const size_t belowIdx = belowRowBase + static_cast<size_t>( x ) * 4;
+                    pixRefLuma = ( static_cast<int>( pixels[belowIdx + 2] ) * 77 +
+                                   static_cast<int>( pixels[belowIdx + 1] ) * 150 +
+                                   static_cast<int>( pixels[belowIdx + 0] ) * 29 ) >> 8;
+                }
+
+                const int curLuma = ( static_cast<int>( pixels[pixIdx + 2] ) * 77 +
+                                      static_cast<int>( pixels[pixIdx + 1] ) * 150 +
+                                      static_cast<int>( pixels[pixIdx + 0] ) * 29 ) >> 8;
+
+                if( curLuma <= 4 || pixRefLuma <= 4 )
+                {
+                    continue;
+                }
+
+                // Per-pixel correction factor, capped by row-level factor.
+                int pixFactor256 = ( pixRefLuma * 256 ) / max( 1, curLuma );
+                pixFactor256 = min( rowFactorCap256, pixFactor256 );
+
+                // Only correct if meaningfully darker (factor > 1.02).
+                if( pixFactor256 <= 261 )
+                {
+                    continue;
+                }
+
+                // Apply column feather to blend correction strength at edges.
+                const int factor256 = 256 + ( ( pixFactor256 - 256 ) * columnWeight256 ) / 256;
+
+                for( int c = 0; c < 3; ++c )
+                {
+                    const int val = static_cast<int>( pixels[pixIdx + static_cast<size_t>( c )] );
+                    pixels[pixIdx + static_cast<size_t>( c )] = static_cast<BYTE>(
+                        min( 255, ( val * factor256 ) / 256 ) );
+                }
+                rowCorrected = true;
+            }
+
+            if( rowCorrected )
+            {
+                ++correctedRowCount;
+            }
+        }
+
+        ++correctedBandCount;
+    }
+
+    if( outCorrectedRows )
+    {
+        *outCorrectedRows = correctedRowCount;
+    }
+    return correctedBandCount;
+}
+
+static int ComputeTileEdgeEnergy( const std::vector<BYTE>& luma,
+                                  int frameWidth,
+                                  int frameHeight,
+                                  int startX,
+                                  int startY,
+                                  int tileWidth,
+                                  int tileHeight )
+{
+    if( luma.empty() || frameWidth <= 2 || frameHeight <= 2 || tileWidth <= 1 || tileHeight <= 1 )
+        return 0;
+
+    const int endX = min( frameWidth - 1, startX + tileWidth );
+    const int endY = min( frameHeight - 1, startY + tileHeight );
+    const int sampleStep = 3;
+    int energy = 0;
+
+    for( int y = max( 1, startY ); y < endY; y += sampleStep )
+    {
+        for( int x = max( 1, startX ); x < endX; x += sampleStep )
+        {
+            const size_t index = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) + static_cast<size_t>( x );
+            const int center = static_cast<int>( luma[index] );
+            const int left = static_cast<int>( luma[index - 1] );
+            const int up = static_cast<int>( luma[index - static_cast<size_t>( frameWidth )] );
+            energy += abs( center - left ) + abs( center - up );
+        }
+    }
+
+    return energy;
+}
+
+static int ComputeTileAverageRgbDifference( const std::vector<BYTE>& aPixels,
+                                            int aStartX,
+                                            int aStartY,
+                                            const std::vector<BYTE>& bPixels,
+                                            int bStartX,
+                                            int bStartY,
+                                            int frameWidth,
+                                            int frameHeight,
+                                            int tileWidth,
+                                            int tileHeight )
+{
+    if( aPixels.empty() || bPixels.empty() )
+        return INT_MAX;
+
+    if( aStartX < 0 || aStartY < 0 || bStartX < 0 || bStartY < 0 ||
+        aStartX + tileWidth > frameWidth || aStartY + tileHeight > frameHeight ||
+        bStartX + tileWidth > frameWidth || bStartY + tileHeight > frameHeight )
+    {
+        return INT_MAX;
+    }
+
+    const int sampleStep = 4;
+    uint64_t diffSum = 0;
+    uint64_t sampleCount = 0;
+
+    for( int y = 0; y < tileHeight; y += sampleStep )
+    {
+        const int ay = aStartY + y;
+        const int by = bStartY + y;
+        const size_t aRow = static_cast<size_t>( ay ) * static_cast<size_t>( frameWidth ) * 4;
+        const size_t bRow = static_cast<size_t>( by ) * static_cast<size_t>( frameWidth ) * 4;
+        for( int x = 0; x < tileWidth; x += sampleStep )
+        {
+            const size_t aIndex = aRow + static_cast<size_t>( aStartX + x ) * 4;
+            const size_t bIndex = bRow + static_cast<size_t>( bStartX + x ) * 4;
+            diffSum += static_cast<uint64_t>( abs( static_cast<int>( aPixels[aIndex + 0] ) - static_cast<int>( bPixels[bIndex + 0] ) ) );
+            diffSum += static_cast<uint64_t>( abs( static_cast<int>( aPixels[aIndex + 1] ) - static_cast<int>( bPixels[bIndex + 1] ) ) );
+            diffSum += static_cast<uint64_t>( abs( static_cast<int>( aPixels[aIndex + 2] ) - static_cast<int>( bPixels[bIndex + 2] ) ) );
+            ++sampleCount;
+        }
+    }
+
+    if( sampleCount == 0 )
+        return INT_MAX;
+
+    return static_cast<int>( diffSum / ( sampleCount * 3 ) );
+}
+
+static constexpr bool IsStrongFixedOverlayTile( int supports, int stationary, int scrolled )
+{
+    return supports >= 4 &&
+           stationary >= 3 &&
+           stationary >= scrolled + 2 &&
+           stationary * 2 >= supports + 1;
+}
+
+static constexpr bool IsWeakFixedOverlayTile( int supports, int stationary, int scrolled )
+{
+    return supports >= 3 &&
+           stationary >= 2 &&
+           stationary >= scrolled + 1 &&
+           stationary * 2 >= supports;
+}
+
+static int CountSetTileNeighbors( const std::vector<BYTE>& tiles,
+                                  int tileCols,
+                                  int tileRows,
+                                  int tileX,
+                                  int tileY )
+{
+    int neighbors = 0;
+    for( int neighborY = max( 0, tileY - 1 ); neighborY <= min( tileRows - 1, tileY + 1 ); ++neighborY )
+    {
+        for( int neighborX = max( 0, tileX - 1 ); neighborX <= min( tileCols - 1, tileX + 1 ); ++neighborX )
+        {
+            if( neighborX == tileX && neighborY == tileY )
+                continue;
+
+            const size_t neighborIndex = static_cast<size_t>( neighborY ) * static_cast<size_t>( tileCols ) + static_cast<size_t>( neighborX );
+            neighbors += tiles[neighborIndex] != 0 ? 1 : 0;
+        }
+    }
+    return neighbors;
+}
+
+// Detect a fixed overlay strip at the bottom of the frame by comparing bottom
+// rows across widely-separated frame pairs.  Returns the height in pixels of
+// the detected strip, or 0 if none found.
+static int DetectFixedBottomStrip( const std::vector<std::vector<BYTE>>& framePixels,
+                                   const std::vector<size_t>& composedFrameIndices,
+                                   const std::vector<POINT>& composedFrameSteps,
+                                   int frameWidth,
+                                   int frameHeight )
+{
+    if( composedFrameIndices.size() < 6 || frameWidth < 64 || frameHeight < 64 )
+        return 0;
+
+    // Build cumulative Y offsets to find widely-separated frame pairs.
+    std::vector<int> cumulativeY( composedFrameIndices.size(), 0 );
+    for( size_t i = 1; i < composedFrameIndices.size(); ++i )
+    {
+        cumulativeY[i] = cumulativeY[i - 1] + composedFrameSteps[i].y;
+    }
+
+    // Collect frame pairs with significant scroll separation.
+    const int minSeparation = max( frameHeight / 2, 200 );
+    struct Pair { size_t a, b; };
+    std::vector<Pair> pairs;
+    const size_t stride = max( static_cast<size_t>( 1 ), composedFrameIndices.size() / 7 );
+    for( size_t anchor = 0; anchor < composedFrameIndices.size() && pairs.size() < 6; anchor += stride )
+    {
+        for( size_t other = anchor + 1; other < composedFrameIndices.size(); ++other )
+        {
+            if( abs( cumulativeY[other] - cumulativeY[anchor] ) >= minSeparation )
+            {
+                pairs.push_back( { composedFrameIndices[anchor], composedFrameIndices[other] } );
+                break;
+            }
+        }
+    }
+    StitchLog( L"[Panorama/Stitch] BottomStripDetect: pairs=%zu minSep=%d stride=%zu\n",
+               pairs.size(), minSeparation, stride );
+    if( pairs.size() < 3 )
+        return 0;
+
+    // For each pair, find the longest matching suffix from the bottom.
+    const int maxScanRows = min( frameHeight / 3, 256 );
+    std::vector<int> allMatchingRows;
+    allMatchingRows.reserve( pairs.size() );
+    for( size_t pi = 0; pi < pairs.size(); ++pi )
+    {
+        const auto& p = pairs[pi];
+        const auto& pixA = framePixels[p.a];
+        const auto& pixB = framePixels[p.b];
+        if( pixA.empty() || pixB.empty() )
+        {
+            StitchLog( L"[Panorama/Stitch] BottomStripDetect: pair %zu (%zu,%zu) EMPTY pixelsA=%zu pixelsB=%zu\n",
+                       pi, p.a, p.b, pixA.size(), pixB.size() );
+            allMatchingRows.push_back( 0 );
+            continue;
+        }
+
+        int matchingRows = 0;
+        int firstMismatchY = -1;
+        int firstMismatchAvgDiff = 0;
+        for( int y = frameHeight - 1; y >= frameHeight - maxScanRows; --y )
+        {
+            const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4;
+            int rowDiffSum = 0;
+            int sampleCount = 0;
+            for( int x = 0; x < frameWidth; x += 4 )
+            {
+                const size_t idx = rowBase + static_cast<size_t>( x ) * 4;
+                rowDiffSum += abs( static_cast<int>( pixA[idx + 0] ) - static_cast<int>( pixB[idx + 0] ) );
+                rowDiffSum += abs( static_cast<int>( pixA[idx + 1] ) - static_cast<int>( pixB[idx + 1] ) );
+                rowDiffSum += abs( static_cast<int>( pixA[idx + 2] ) - static_cast<int>( pixB[idx + 2] ) );
+                ++sampleCount;
+            }
+            const int avgDiff = rowDiffSum / max( 1, sampleCount * 3 );
+            // Threshold raised from 6 to 12 to accommodate VM/RDP
+            // rendering noise — software-rendered or protocol-compressed
+            // displays can produce per-pixel jitter of 5-10 in static content.
+            // True scrolled-content transitions have avgDiff >> 15.
+            if( avgDiff > 12 )
+            {
+                firstMismatchY = y;
+                firstMismatchAvgDiff = avgDiff;
+                break;
+            }
+            ++matchingRows;
+        }
+        StitchLog( L"[Panorama/Stitch] BottomStripDetect: pair %zu (%zu,%zu) matchingRows=%d mismatchY=%d mismatchDiff=%d\n",
+                   pi, p.a, p.b, matchingRows, firstMismatchY, firstMismatchAvgDiff );
+        allMatchingRows.push_back( matchingRows );
+    }
+
+    // Use a robust aggregation instead of strict minimum: allow up to
+    // 1/3 of pairs to be outliers.  VM or RDP rendering noise, animated
+    // scroll indicators, and subtle overlay state changes can cause a
+    // few pairs to badly disagree even though the static strip is real.
+    if( allMatchingRows.empty() )
+        return 0;
+    std::sort( allMatchingRows.begin(), allMatchingRows.end() );
+    const size_t robustIndex = min( allMatchingRows.size() / 3, allMatchingRows.size() - 1 );
+    const int minMatchingRows = allMatchingRows[robustIndex];
+    StitchLog( L"[Panorama/Stitch] BottomStripDetect: minMatchingRows=%d (robust index=%zu of %zu, values=",
+               minMatchingRows, robustIndex, allMatchingRows.size() );
+    for( size_t ri = 0; ri < allMatchingRows.size(); ++ri )
+        StitchLog( L"%ls%d", ri > 0 ? L"," : L"", allMatchingRows[ri] );
+    StitchLog( L")\n" );
+    if( minMatchingRows < 3 )
+        return 0;
+
+    // Verify the strip has visual content (not just uniform background).
+    const auto& pix0 = framePixels[composedFrameIndices[0]];
+    if( pix0.empty() )
+        return 0;
+
+    const int stripStartY = frameHeight - minMatchingRows;
+    int energy = 0;
+    int energySamples = 0;
+    for( int y = max( 1, stripStartY ); y < frameHeight; y += 3 )
+    {
+        const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4;
+        const size_t prevRowBase = static_cast<size_t>( y - 1 ) * static_cast<size_t>( frameWidth ) * 4;
+        for( int x = 1; x < frameWidth; x += 3 )
+        {
+            const size_t idx = rowBase + static_cast<size_t>( x ) * 4;
+            const size_t leftIdx = rowBase + static_cast<size_t>( x - 1 ) * 4;
+            const size_t upIdx = prevRowBase + static_cast<size_t>( x ) * 4;
+            const int center = ( static_cast<int>( pix0[idx + 2] ) * 77 +
+                                 static_cast<int>( pix0[idx + 1] ) * 150 +
+                                 static_cast<int>( pix0[idx + 0] ) * 29 ) >> 8;
+            const int left = ( static_cast<int>( pix0[leftIdx + 2] ) * 77 +
+                               static_cast<int>( pix0[leftIdx + 1] ) * 150 +
+                               static_cast<int>( pix0[leftIdx + 0] ) * 29 ) >> 8;
+            const int up = ( static_cast<int>( pix0[upIdx + 2] ) * 77 +
+                             static_cast<int>( pix0[upIdx + 1] ) * 150 +
+                             static_cast<int>( pix0[upIdx + 0] ) * 29 ) >> 8;
+            energy += abs( center - left ) + abs( center - up );
+            ++energySamples;
+        }
+    }
+    const int avgEnergy = ( energySamples > 0 ) ? energy / energySamples : 0;
+    // Large contiguous matching strips (≥ 40 rows) across many frame pairs
+    // are extremely unlikely to be plain background — even dark-themed
+    // toolbars contain subtle gradients, icons, and text.  Relax the energy
+    // threshold to avoid rejecting genuine low-contrast UI bars.
+    const int energyThreshold = ( minMatchingRows >= 40 ) ? 1 : 3;
+    StitchLog( L"[Panorama/Stitch] BottomStripDetect: stripStartY=%d energy=%d samples=%d avgEnergy=%d (threshold=%d)\n",
+               stripStartY, energy, energySamples, avgEnergy, energyThreshold );
+    if( energySamples <= 0 || avgEnergy < energyThreshold )
+        return 0;
+
+    return minMatchingRows;
+}
+
+static FixedOverlayMask BuildFixedOverlayMask( const std::vector<size_t>& composedFrameIndices,
+                                               const std::vector<POINT>& composedFrameSteps,
+                                               const std::vector<std::vector<BYTE>>& framePixels,
+                                               const std::vector<std::vector<BYTE>>& frameLuma,
+                                               int frameWidth,
+                                               int frameHeight,
+                                               int minProgress,
+                                               FixedOverlayDiagnostics* diagnostics )
+{
+    FixedOverlayMask mask;
+    if( diagnostics != nullptr )
+    {
+        *diagnostics = {};
+    }
+
+    if( composedFrameIndices.size() < 5 || frameWidth < 64 || frameHeight < 64 )
+        return mask;
+
+    mask.tileWidth = max( 16, min( 32, frameWidth / 28 ) );
+    mask.tileHeight = max( 16, min( 32, frameHeight / 28 ) );
+    mask.tileCols = ( frameWidth + mask.tileWidth - 1 ) / mask.tileWidth;
+    mask.tileRows = ( frameHeight + mask.tileHeight - 1 ) / mask.tileHeight;
+
+    if( mask.tileCols <= 0 || mask.tileRows <= 0 )
+        return mask;
+
+    const size_t tileCount = static_cast<size_t>( mask.tileCols ) * static_cast<size_t>( mask.tileRows );
+    std::vector<int> supportCount( tileCount, 0 );
+    std::vector<int> stationaryWins( tileCount, 0 );
+    std::vector<int> scrolledWins( tileCount, 0 );
+
+    const size_t maxLookbackComparisons = ( composedFrameIndices.size() - 1 < 4 ) ? ( composedFrameIndices.size() - 1 ) : 4;
+    for( size_t passIndex = 1; passIndex < composedFrameIndices.size(); ++passIndex )
+    {
+        const size_t currFrameIndex = composedFrameIndices[passIndex];
+        const std::vector<BYTE>& currPixels = framePixels[currFrameIndex];
+        const std::vector<BYTE>& currLuma = frameLuma[currFrameIndex];
+        if( currPixels.empty() || currLuma.empty() )
+            continue;
+
+        POINT cumulativeStep{};
+        const size_t lookbackLimit = min( maxLookbackComparisons, passIndex );
+        for( size_t compareOffset = 1; compareOffset <= lookbackLimit; ++compareOffset )
+        {
+            const POINT& segmentStep = composedFrameSteps[passIndex - compareOffset + 1];
+            cumulativeStep.x += segmentStep.x;
+            cumulativeStep.y += segmentStep.y;
+
+            const int absStepX = abs( cumulativeStep.x );
+            const int absStepY = abs( cumulativeStep.y );
+            const bool mostlyVertical = absStepY >= minProgress && absStepX <= max( 16, frameWidth / 18 );
+            const bool mostlyHorizontal = absStepX >= minProgress && absStepY <= max( 16, frameHeight / 18 );
+            if( !( mostlyVertical || mostlyHorizontal ) )
+                continue;
+
+            const size_t prevFrameIndex = composedFrameIndices[passIndex - compareOffset];
+            const std::vector<BYTE>& prevPixels = framePixels[prevFrameIndex];
+            const std::vector<BYTE>& prevLuma = frameLuma[prevFrameIndex];
+            if( prevPixels.empty() || prevLuma.empty() )
+                continue;
+
+            if( diagnostics != nullptr )
+            {
+                diagnostics->pairCount++;
+            }
+
+            for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+            {
+                const int startY = tileY * mask.tileHeight;
+                const int currentTileHeight = min( mask.tileHeight, frameHeight - startY );
+                if( currentTileHeight < mask.tileHeight / 2 )
+                    continue;
+
+                for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+                {
+                    const int startX = tileX * mask.tileWidth;
+                    const int currentTileWidth = min( mask.tileWidth, frameWidth - startX );
+                    if( currentTileWidth < mask.tileWidth / 2 )
+                        continue;
+
+                    const int shiftedX = startX + cumulativeStep.x;
+                    const int shiftedY = startY + cumulativeStep.y;
+                    if( shiftedX < 0 || shiftedY < 0 ||
+                        shiftedX + currentTileWidth > frameWidth ||
+                        shiftedY + currentTileHeight > frameHeight )
+                    {
+                        continue;
+                    }
+
+                    const int currTileEnergy = ComputeTileEdgeEnergy( currLuma, frameWidth, frameHeight, startX, startY, currentTileWidth, currentTileHeight );
+                    const int prevShiftedEnergy = ComputeTileEdgeEnergy( prevLuma, frameWidth, frameHeight, shiftedX, shiftedY, currentTileWidth, currentTileHeight );
+                    const int informativeEnergy = max( currTileEnergy, prevShiftedEnergy );
+                    const int informativeEnergyThreshold = max( 180, ( currentTileWidth * currentTileHeight ) / 2 );
+                    if( informativeEnergy < informativeEnergyThreshold )
+                        continue;
+
+                    const int sameDiff = ComputeTileAverageRgbDifference( currPixels,
+                                                                          startX,
+                                                                          startY,
+                                                                          prevPixels,
+                                                                          startX,
+                                                                          startY,
+                                                                          frameWidth,
+                                                                          frameHeight,
+                                                                          currentTileWidth,
+                                                                          currentTileHeight );
+                    const int shiftedDiff = ComputeTileAverageRgbDifference( currPixels,
+                                                                             startX,
+                                                                             startY,
+                                                                             prevPixels,
+                                                                             shiftedX,
+                                                                             shiftedY,
+                                                                             frameWidth,
+                                                                             frameHeight,
+                                                                             currentTileWidth,
+                                                                             currentTileHeight );
+
+                    if( sameDiff == INT_MAX || shiftedDiff == INT_MAX )
+                        continue;
+
+                    // Gate on edge energy.  Bypass the gate when the tile is
+                    // near-perfectly stationary (sameDiff <= 4) with clear
+                    // scroll evidence (shiftedDiff >= 24) — such tiles
+                    // contain a genuine fixed element even on low-contrast
+                    // dark pages where edge energy is minimal.
+                    const bool lowEnergyBypass = ( sameDiff <= 4 && shiftedDiff >= 24 );
+                    if( informativeEnergy < informativeEnergyThreshold && !lowEnergyBypass )
+                        continue;
+
+                    const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                    supportCount[tileIndex]++;
+                    if( diagnostics != nullptr )
+                    {
+                        diagnostics->informativeTileComparisons++;
+                    }
+
+                    if( sameDiff <= 18 && shiftedDiff >= sameDiff + 12 && shiftedDiff >= ( sameDiff * 2 ) + 6 )
+                    {
+                        // Require meaningful content at the stationary position in both
+                        // frames.  Two featureless dark tiles trivially have sameDiff ≈ 0
+                        // and would false-positive as "fixed overlay."
+                        const int prevStationaryEnergy = ComputeTileEdgeEnergy( prevLuma, frameWidth, frameHeight,
+                                                                                startX, startY,
+                                                                                currentTileWidth, currentTileHeight );
+                        if( max( currTileEnergy, prevStationaryEnergy ) >= informativeEnergyThreshold )
+                        {
+                            stationaryWins[tileIndex]++;
+                        }
+                    }
+                    else if( shiftedDiff <= 18 && sameDiff >= shiftedDiff + 10 )
+                    {
+                        scrolledWins[tileIndex]++;
+                    }
+                }
+            }
+        }
+    }
+
+    std::vector<BYTE> candidateTiles( tileCount, 0 );
+    for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+    {
+        for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+        {
+            const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+            if( IsStrongFixedOverlayTile( supportCount[tileIndex], stationaryWins[tileIndex], scrolledWins[tileIndex] ) )
+            {
+                candidateTiles[tileIndex] = 1;
+            }
+        }
+    }
+
+    std::vector<BYTE> confirmedTiles( tileCount, 0 );
+    for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+    {
+        for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+        {
+            const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+            if( candidateTiles[tileIndex] == 0 )
+                continue;
+
+            const int adjacentCandidates = CountSetTileNeighbors( candidateTiles,
+                                                                  mask.tileCols,
+                                                                  mask.tileRows,
+                                                                  tileX,
+                                                                  tileY );
+
+            if( adjacentCandidates == 0 && supportCount[tileIndex] < 6 )
+                continue;
+
+            confirmedTiles[tileIndex] = 1;
+            if( diagnostics != nullptr )
+            {
+                diagnostics->strongTileCount++;
+            }
+        }
+    }
+
+    mask.maskedTiles.assign( tileCount, 0 );
+    std::vector<BYTE> connectedTiles( tileCount, 0 );
+    std::vector<POINT> growQueue;
+    growQueue.reserve( tileCount );
+    for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+    {
+        for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+        {
+            const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+            if( confirmedTiles[tileIndex] == 0 )
+                continue;
+
+            connectedTiles[tileIndex] = 1;
+            growQueue.push_back( POINT{ tileX, tileY } );
+        }
+    }
+
+    for( size_t queueIndex = 0; queueIndex < growQueue.size(); ++queueIndex )
+    {
+        const POINT current = growQueue[queueIndex];
+        for( int neighborY = max( 0, current.y - 1 ); neighborY <= min( mask.tileRows - 1, current.y + 1 ); ++neighborY )
+        {
+            for( int neighborX = max( 0, current.x - 1 ); neighborX <= min( mask.tileCols - 1, current.x + 1 ); ++neighborX )
+            {
+                const size_t neighborIndex = static_cast<size_t>( neighborY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( neighborX );
+                if( connectedTiles[neighborIndex] != 0 )
+                    continue;
+
+                if( !IsWeakFixedOverlayTile( supportCount[neighborIndex], stationaryWins[neighborIndex], scrolledWins[neighborIndex] ) )
+                    continue;
+
+                connectedTiles[neighborIndex] = 1;
+                growQueue.push_back( POINT{ neighborX, neighborY } );
+            }
+        }
+    }
+
+    int connectedTileCount = 0;
+    int minTileX = mask.tileCols;
+    int minTileY = mask.tileRows;
+    int maxTileX = -1;
+    int maxTileY = -1;
+    for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+    {
+        for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+        {
+            const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+            if( connectedTiles[tileIndex] == 0 )
+                continue;
+
+            connectedTileCount++;
+            minTileX = min( minTileX, tileX );
+            minTileY = min( minTileY, tileY );
+            maxTileX = max( maxTileX, tileX );
+            maxTileY = max( maxTileY, tileY );
+        }
+    }
+
+    if( diagnostics != nullptr )
+    {
+        diagnostics->connectedTileCount = connectedTileCount;
+    }
+
+    if( connectedTileCount > 0 && connectedTileCount <= 2 )
+    {
+        minTileX = max( 0, minTileX - 1 );
+        maxTileX = min( mask.tileCols - 1, maxTileX + 1 );
+        minTileY = max( 0, minTileY - 1 );
+        maxTileY = min( mask.tileRows - 1, maxTileY + 2 );
+    }
+
+    if( connectedTileCount == 0 )
+    {
+        // No tile-level detections.  Skip bounds expansion and dense/sparse
+        // masking — the bottom strip detection below may still find overlays.
+        goto skipTileMasking;
+    }
+
+    { // Scope for tile masking.
+    bool expandedBounds = true;
+    while( expandedBounds )
+    {
+        expandedBounds = false;
+
+        if( minTileX > 0 )
+        {
+            bool includeColumn = false;
+            for( int tileY = minTileY; tileY <= maxTileY && !includeColumn; ++tileY )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( minTileX - 1 );
+                includeColumn = IsWeakFixedOverlayTile( supportCount[tileIndex], stationaryWins[tileIndex], scrolledWins[tileIndex] );
+            }
+            if( includeColumn )
+            {
+                --minTileX;
+                expandedBounds = true;
+            }
+        }
+
+        if( maxTileX + 1 < mask.tileCols )
+        {
+            bool includeColumn = false;
+            for( int tileY = minTileY; tileY <= maxTileY && !includeColumn; ++tileY )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( maxTileX + 1 );
+                includeColumn = IsWeakFixedOverlayTile( supportCount[tileIndex], stationaryWins[tileIndex], scrolledWins[tileIndex] );
+            }
+            if( includeColumn )
+            {
+                ++maxTileX;
+                expandedBounds = true;
+            }
+        }
+
+        if( minTileY > 0 )
+        {
+            bool includeRow = false;
+            for( int tileX = minTileX; tileX <= maxTileX && !includeRow; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( minTileY - 1 ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                includeRow = IsWeakFixedOverlayTile( supportCount[tileIndex], stationaryWins[tileIndex], scrolledWins[tileIndex] );
+            }
+            if( includeRow )
+            {
+                --minTileY;
+                expandedBounds = true;
+            }
+        }
+
+        if( maxTileY + 1 < mask.tileRows )
+        {
+            bool includeRow = false;
+            for( int tileX = minTileX; tileX <= maxTileX && !includeRow; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( maxTileY + 1 ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                includeRow = IsWeakFixedOverlayTile( supportCount[tileIndex], stationaryWins[tileIndex], scrolledWins[tileIndex] );
+            }
+            if( includeRow )
+            {
+                ++maxTileY;
+                expandedBounds = true;
+            }
+        }
+    }
+
+    const int boundsWidthTiles = maxTileX - minTileX + 1;
+    const int boundsHeightTiles = maxTileY - minTileY + 1;
+    const int boundsAreaTiles = boundsWidthTiles * boundsHeightTiles;
+    const bool denseBounds = boundsAreaTiles > 0 && connectedTileCount * 100 >= boundsAreaTiles * 35;
+
+    int maskedTileCount = 0;
+    if( denseBounds )
+    {
+        for( int tileY = minTileY; tileY <= maxTileY; ++tileY )
+        {
+            for( int tileX = minTileX; tileX <= maxTileX; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                mask.maskedTiles[tileIndex] = 1;
+                maskedTileCount++;
+            }
+        }
+    }
+    else
+    {
+        for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+        {
+            for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                if( connectedTiles[tileIndex] == 0 )
+                    continue;
+
+                for( int neighborY = max( 0, tileY - 1 ); neighborY <= min( mask.tileRows - 1, tileY + 1 ); ++neighborY )
+                {
+                    for( int neighborX = max( 0, tileX - 1 ); neighborX <= min( mask.tileCols - 1, tileX + 1 ); ++neighborX )
+                    {
+                        const size_t neighborIndex = static_cast<size_t>( neighborY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( neighborX );
+                        if( mask.maskedTiles[neighborIndex] != 0 )
+                            continue;
+
+                        if( connectedTiles[neighborIndex] == 0 &&
+                            !IsWeakFixedOverlayTile( supportCount[neighborIndex], stationaryWins[neighborIndex], scrolledWins[neighborIndex] ) )
+                        {
+                            continue;
+                        }
+
+                        mask.maskedTiles[neighborIndex] = 1;
+                        maskedTileCount++;
+                    }
+                }
+            }
+        }
+
+        minTileX = mask.tileCols;
+        minTileY = mask.tileRows;
+        maxTileX = -1;
+        maxTileY = -1;
+        for( int tileY = 0; tileY < mask.tileRows; ++tileY )
+        {
+            for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                if( mask.maskedTiles[tileIndex] == 0 )
+                    continue;
+
+                minTileX = min( minTileX, tileX );
+                minTileY = min( minTileY, tileY );
+                maxTileX = max( maxTileX, tileX );
+                maxTileY = max( maxTileY, tileY );
+            }
+        }
+    }
+
+    } // End scope for tile masking.
+skipTileMasking:
+
+    // Supplement with bottom-strip detection for overlays at the frame edge
+    // that tile-based comparison misses (shifted position falls outside frame).
+    int maskedTileCount = 0;
+    for( size_t ti = 0; ti < tileCount; ++ti )
+    {
+        if( mask.maskedTiles[ti] != 0 )
+            ++maskedTileCount;
+    }
+    const int fixedBottomRows = DetectFixedBottomStrip( framePixels,
+                                                        composedFrameIndices,
+                                                        composedFrameSteps,
+                                                        frameWidth,
+                                                        frameHeight );
+    if( fixedBottomRows > 0 )
+    {
+        const int stripStartTileY = max( 0, ( frameHeight - fixedBottomRows ) / mask.tileHeight );
+        for( int tileY = stripStartTileY; tileY < mask.tileRows; ++tileY )
+        {
+            for( int tileX = 0; tileX < mask.tileCols; ++tileX )
+            {
+                const size_t tileIndex = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                if( mask.maskedTiles[tileIndex] == 0 )
+                {
+                    mask.maskedTiles[tileIndex] = 1;
+                    ++maskedTileCount;
+                }
+            }
+        }
+
+        minTileX = 0;
+        minTileY = min( minTileY, stripStartTileY );
+        maxTileX = mask.tileCols - 1;
+        maxTileY = mask.tileRows - 1;
+    }
+
+    // Detect small floating overlays (e.g. scroll-to-top button, chevron,
+    // spinner) using shift-compensated residual accumulation across
+    // consecutive frame pairs.  For each pair with a known scroll shift,
+    // compare curr[x,y] against prev[x, y+step] — page content matches
+    // after compensation, but a fixed overlay at (x,y) shows residual
+    // because it doesn't scroll.  Pixels with consistent residual across
+    // many pairs are overlay candidates.  Works regardless of overlay
+    // contrast, color, shape, or position.
+    if( mask.eraseRect.right <= mask.eraseRect.left &&
+        composedFrameIndices.size() >= 8 )
+    {
+        const int halfW = ( frameWidth + 1 ) / 2;
+        const int halfH = ( frameHeight + 1 ) / 2;
+        std::vector<int> hitCount( static_cast<size_t>( halfW ) * halfH, 0 );
+        std::vector<int> pairCountMap( static_cast<size_t>( halfW ) * halfH, 0 );
+        const int residualThreshold = 10;
+
+        for( size_t pi = 1; pi < composedFrameIndices.size(); ++pi )
+        {
+            const int stepX = composedFrameSteps[pi].x;
+            const int stepY = composedFrameSteps[pi].y;
+            if( abs( stepX ) < minProgress && abs( stepY ) < minProgress )
+                continue;
+
+            const auto& currPx = framePixels[composedFrameIndices[pi]];
+            const auto& prevPx = framePixels[composedFrameIndices[pi - 1]];
+            if( currPx.empty() || prevPx.empty() )
+                continue;
+
+            for( int hy = 0; hy < halfH; ++hy )
+            {
+                const int y = hy * 2;
+                const int prevY = y + stepY;
+                if( prevY < 0 || prevY >= frameHeight )
+                    continue;
+
+                // Skip comparisons where the shifted position maps
+                // into the fixed header/footer area — those produce
+                // false residual for every pixel near the edges,
+                // swamping the real overlay signal.  Use the detected
+                // strip heights rather than the tile mask, which can
+                // have artifacts from connected components (scrollbar
+                // connecting header to footer).
+                if( fixedBottomRows > 0 && prevY >= frameHeight - fixedBottomRows )
+                    continue;
+                {
+                    const int hdrH = mask.TopHeaderHeight();
+                    if( hdrH > 0 && prevY < hdrH )
+                        continue;
+                }
+
+                for( int hx = 0; hx < halfW; ++hx )
+                {
+                    const int x = hx * 2;
+                    const int prevX = x + stepX;
+                    if( prevX < 0 || prevX >= frameWidth )
+                        continue;
+
+                    const size_t ci = ( static_cast<size_t>( y ) * frameWidth + x ) * 4;
+                    const size_t pri = ( static_cast<size_t>( prevY ) * frameWidth + prevX ) * 4;
+                    const int d = max( abs( static_cast<int>( currPx[ci] ) - static_cast<int>( prevPx[pri] ) ),
+                                       max( abs( static_cast<int>( currPx[ci + 1] ) - static_cast<int>( prevPx[pri + 1] ) ),
+                                            abs( static_cast<int>( currPx[ci + 2] ) - static_cast<int>( prevPx[pri + 2] ) ) ) );
+
+                    const size_t idx = static_cast<size_t>( hy ) * halfW + hx;
+                    pairCountMap[idx]++;
+                    if( d > residualThreshold )
+                    {
+                        hitCount[idx]++;
+                    }
+                }
+            }
+        }
+
+        const int minPairsRequired = 4;
+        const int minHitPercent = 50;
+        int fixMinX = frameWidth, fixMaxX = 0, fixMinY = frameHeight, fixMaxY = 0;
+        int fixedCount = 0;
+        for( int hy = 0; hy < halfH; ++hy )
+        {
+            for( int hx = 0; hx < halfW; ++hx )
+            {
+                const size_t idx = static_cast<size_t>( hy ) * halfW + hx;
+                if( pairCountMap[idx] < minPairsRequired )
+                    continue;
+                if( hitCount[idx] * 100 < pairCountMap[idx] * minHitPercent )
+                    continue;
+
+                const int x = hx * 2;
+                const int y = hy * 2;
+
+                // Skip the top and bottom frame edges — scroll
+                // clipping at the frame boundary creates natural
+                // residual that isn't a floating overlay.
+                if( y < 8 || y >= frameHeight - 8 )
+                    continue;
+
+                // Skip pixels within the fixed top header — the
+                // header is stationary and produces residual, but
+                // it's already handled by tile-mask suppression.
+                {
+                    const int topHdrH = mask.TopHeaderHeight();
+                    if( topHdrH > 0 && y < topHdrH + 8 )
+                        continue;
+                }
+
+                // Skip pixels in or near the bottom fixed region.  The tile
+                // mask and bottom strip cover the toolbar itself, but
+                // toolbar UI elements (icons, borders, edit box) extend
+                // above the mask and produce residual noise.  Use a
+                // moderate margin to suppress toolbar noise while still
+                // allowing floating overlays near the toolbar.
+                if( maskedTileCount > 0 && mask.IsMaskedPixel( x, y ) )
+                    continue;
+                const int firstMaskedRow = mask.FirstMaskedY();
+                const int topHdr = mask.TopHeaderHeight();
+                // Only apply the firstMaskedRow margin when it refers
+                // to the bottom toolbar, not the top header.  When the
+                // header is masked, FirstMaskedY() returns ~0 and the
+                // margin (y >= -40) would exclude every pixel.
+                if( firstMaskedRow > topHdr && y >= firstMaskedRow - 40 )
+                    continue;
+                if( fixedBottomRows > 0 && y >= frameHeight - fixedBottomRows - 40 )
+                    continue;
+
+                fixMinX = min( fixMinX, x );
+                fixMaxX = max( fixMaxX, x );
+                fixMinY = min( fixMinY, y );
+                fixMaxY = max( fixMaxY, y );
+                ++fixedCount;
+            }
+        }
+
+        if( fixedCount >= 2 )
+        {
+            int finalMinX = fixMinX, finalMaxX = fixMaxX;
+            int finalMinY = fixMinY, finalMaxY = fixMaxY;
+
+            const int coreW = finalMaxX - finalMinX + 1;
+            const int coreH = finalMaxY - finalMinY + 1;
+            const int64_t bboxArea = static_cast<int64_t>( coreW ) * coreH;
+
+            // A real floating overlay (toolbar bar, button) has its
+            // residual pixels concentrated in a compact region.
+            // Scattered noise from cursor movement or sub-pixel
+            // rendering produces a similar pixel count but spread
+            // across the whole frame, yielding very low density.
+            // Require at least 1% of the bounding box to be filled.
+            // Also force clustering when the bounding box is very
+            // large (e.g. IDE sidebar + minimap producing widespread
+            // residual) — a real floating overlay is compact, not
+            // frame-spanning.
+            const int64_t densityPercent = bboxArea > 0
+                ? ( static_cast<int64_t>( fixedCount ) * 100 / bboxArea )
+                : 0;
+            const bool bboxTooLarge = coreW > frameWidth * 2 / 5 &&
+                                      coreH > frameHeight * 2 / 5;
+            if( densityPercent < 1 || bboxTooLarge )
+            {
+                // The full bounding box is too sparse — likely scattered
+                // noise.  But there might be a real compact overlay
+                // hiding inside the noise.  Search for the densest
+                // sub-window to recover it.
+                const int windowW = min( frameWidth / 4, 120 );
+                const int windowH = min( frameHeight / 4, 120 );
+                int bestCount = 0, bestWx = 0, bestWy = 0;
+
+                for( int wy = 0; wy <= halfH - windowH / 2; wy += 2 )
+                {
+                    for( int wx = 0; wx <= halfW - windowW / 2; wx += 2 )
+                    {
+                        int count = 0;
+                        const int wyEnd = min( wy + windowH / 2, halfH );
+                        const int wxEnd = min( wx + windowW / 2, halfW );
+                        for( int hy = wy; hy < wyEnd; ++hy )
+                        {
+                            for( int hx = wx; hx < wxEnd; ++hx )
+                            {
+                                const size_t idx2 = static_cast<size_t>( hy ) * halfW + hx;
+                                if( pairCountMap[idx2] >= minPairsRequired &&
+                                    hitCount[idx2] * 100 >= pairCountMap[idx2] * minHitPercent &&
+                                    !( maskedTileCount > 0 && mask.IsMaskedPixel( hx * 2, hy * 2 ) ) )
+                                {
+                                    const int py = hy * 2;
+                                    const int topHdrC2 = mask.TopHeaderHeight();
+                                    if( topHdrC2 > 0 && py < topHdrC2 + 8 )
+                                        continue;
+                                    const int firstMR = mask.FirstMaskedY();
+                                    const int topHdrC = mask.TopHeaderHeight();
+                                    if( firstMR > topHdrC && py >= firstMR - 40 )
+                                        continue;
+                                    if( fixedBottomRows > 0 && py >= frameHeight - fixedBottomRows - 40 )
+                                        continue;
+                                    ++count;
+                                }
+                            }
+                        }
+                        if( count > bestCount )
+                        {
+                            bestCount = count;
+                            bestWx = wx;
+                            bestWy = wy;
+                        }
+                    }
+                }
+
+                if( bestCount >= 2 )
+                {
+                    finalMinX = frameWidth; finalMaxX = 0;
+                    finalMinY = frameHeight; finalMaxY = 0;
+                    fixedCount = 0;
+                    const int wyEnd = min( bestWy + windowH / 2, halfH );
+                    const int wxEnd = min( bestWx + windowW / 2, halfW );
+                    for( int hy = bestWy; hy < wyEnd; ++hy )
+                    {
+                        for( int hx = bestWx; hx < wxEnd; ++hx )
+                        {
+                            const size_t idx2 = static_cast<size_t>( hy ) * halfW + hx;
+                            if( pairCountMap[idx2] >= minPairsRequired &&
+                                hitCount[idx2] * 100 >= pairCountMap[idx2] * minHitPercent &&
+                                !( maskedTileCount > 0 && mask.IsMaskedPixel( hx * 2, hy * 2 ) ) )
+                            {
+                                finalMinX = min( finalMinX, hx * 2 );
+                                finalMaxX = max( finalMaxX, hx * 2 );
+                                finalMinY = min( finalMinY, hy * 2 );
+                                finalMaxY = max( finalMaxY, hy * 2 );
+                                ++fixedCount;
+                            }
+                        }
+                    }
+
+                    // Verify the cluster has reasonable density too.
+                    if( fixedCount >= 2 )
+                    {
+                        const int clW = finalMaxX - finalMinX + 1;
+                        const int clH = finalMaxY - finalMinY + 1;
+                        const int64_t clArea = static_cast<int64_t>( clW ) * clH;
+                        const int64_t clDensityPct = clArea > 0 ? static_cast<int64_t>( fixedCount ) * 100 / clArea : 0;
+                        if( clDensityPct < 2 )
+                        {
+                            fixedCount = 0;
+                        }
+                    }
+                }
+                else
+                {
+                    fixedCount = 0;
+                }
+            }
+
+            if( fixedCount >= 2 )
+            {
+                // Reject clusters in the top third of the frame —
+                // floating overlays (scroll-to-bottom, FAB, etc.)
+                // sit in the lower portion, not near the header.
+                // Noise near the header edge produces false clusters.
+                if( finalMaxY < frameHeight / 3 )
+                {
+                    fixedCount = 0;
+                }
+            }
+
+            if( fixedCount >= 2 )
+            {
+                const int coreW2 = finalMaxX - finalMinX + 1;
+                const int coreH2 = finalMaxY - finalMinY + 1;
+                const int marginX = max( 24, coreW2 );
+                const int marginY = max( 24, coreH2 );
+                mask.eraseRect.left   = max( 0L, static_cast<long>( finalMinX ) - marginX );
+                mask.eraseRect.top    = max( 0L, static_cast<long>( finalMinY ) - marginY );
+                mask.eraseRect.right  = min( static_cast<long>( frameWidth ), static_cast<long>( finalMaxX ) + marginX + 2 );
+                mask.eraseRect.bottom = min( static_cast<long>( frameHeight ), static_cast<long>( finalMaxY ) + marginY + 2 );
+            }
+        }
+
+        StitchLog( L"[Panorama/Stitch] ResidualOverlay: pairsUsed=%zu fixedPixels=%d bounds=(%d,%d)-(%d,%d) maskedTiles=%d eraseRect=(%d,%d)-(%d,%d)\n",
+                   composedFrameIndices.size() - 1,
+                   fixedCount,
+                   fixMinX, fixMinY, fixMaxX, fixMaxY,
+                   maskedTileCount,
+                   mask.eraseRect.left, mask.eraseRect.top,
+                   mask.eraseRect.right, mask.eraseRect.bottom );
+    }
+
+    // Fill unmasked holes within the masked bounds.  Small overlay elements
+    // (e.g. a chevron indicator above the bottom strip) may fall in tiles
+    // that tile voting didn't flag, leaving gaps in the mask.  Any unmasked
+    // tile bordered on 3+ sides by masked tiles is almost certainly part of
+    // the overlay and should be masked too.
+    if( maskedTileCount > 0 )
+    {
+        bool filled = true;
+        while( filled )
+        {
+            filled = false;
+            for( int tileY = minTileY; tileY <= maxTileY; ++tileY )
+            {
+                for( int tileX = minTileX; tileX <= maxTileX; ++tileX )
+                {
+                    const size_t ti = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                    if( mask.maskedTiles[ti] != 0 )
+                        continue;
+
+                    int maskedNeighbors = 0;
+                    if( tileY > 0 )
+                    {
+                        const size_t above = static_cast<size_t>( tileY - 1 ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                        if( mask.maskedTiles[above] != 0 ) ++maskedNeighbors;
+                    }
+                    else ++maskedNeighbors;  // frame edge counts as masked
+                    if( tileY + 1 < mask.tileRows )
+                    {
+                        const size_t below = static_cast<size_t>( tileY + 1 ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX );
+                        if( mask.maskedTiles[below] != 0 ) ++maskedNeighbors;
+                    }
+                    else ++maskedNeighbors;
+                    if( tileX > 0 )
+                    {
+                        const size_t left = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX - 1 );
+                        if( mask.maskedTiles[left] != 0 ) ++maskedNeighbors;
+                    }
+                    else ++maskedNeighbors;
+                    if( tileX + 1 < mask.tileCols )
+                    {
+                        const size_t right = static_cast<size_t>( tileY ) * static_cast<size_t>( mask.tileCols ) + static_cast<size_t>( tileX + 1 );
+                        if( mask.maskedTiles[right] != 0 ) ++maskedNeighbors;
+                    }
+                    else ++maskedNeighbors;
+
+                    if( maskedNeighbors >= 3 )
+                    {
+                        mask.maskedTiles[ti] = 1;
+                        ++maskedTileCount;
+                        filled = true;
+                    }
+                }
+            }
+        }
+    }
+
+    if( maskedTileCount == 0 && mask.eraseRect.right <= mask.eraseRect.left )
+    {
+        mask.maskedTiles.clear();
+        return mask;
+    }
+
+    if( diagnostics != nullptr )
+    {
+        diagnostics->maskedTileCount = maskedTileCount;
+        if( maskedTileCount > 0 )
+        {
+            diagnostics->tileBoundsLeft = minTileX * mask.tileWidth;
+            diagnostics->tileBoundsTop = minTileY * mask.tileHeight;
+            diagnostics->tileBoundsRight = min( frameWidth, ( maxTileX + 1 ) * mask.tileWidth );
+            diagnostics->tileBoundsBottom = min( frameHeight, ( maxTileY + 1 ) * mask.tileHeight );
+        }
+    }
+
+    mask.topHeaderHeight = mask.TopHeaderHeight();
+    if( mask.topHeaderHeight > 0 )
+    {
+        StitchLog( L"[Panorama/Stitch] TopHeader: height=%d\n", mask.topHeaderHeight );
+    }
+
+    mask.bottomStripY = fixedBottomRows > 0 ? frameHeight - fixedBottomRows : 0;
+
+    return mask;
+}
+
+// Masked Zero-Mean Normalized Cross-Correlation over 2D overlap region.
+// Only scores pixels where the mask is set (informative/edge pixels).
+// Returns ZNCC in [-1.0, 1.0].  Returns 0.0 if fewer than minSamples
+// masked pixels, or if either signal has zero variance.
+static double ComputeMaskedZNCC( const BYTE* prevLuma, const BYTE* currLuma,
+                                 const BYTE* maskPrev, const BYTE* maskCurr,
+                                 int width, int overlap, int absStep,
+                                 int direction, int dx,
+                                 int marginX, int minSamples )
+{
+    int64_t iSumA = 0, iSumB = 0, iSumAB = 0, iSumA2 = 0, iSumB2 = 0;
+    int n = 0;
+    const int xStart = max( marginX, marginX + max( 0, -dx ) );
+    const int xEnd = min( width - marginX, width - marginX - max( 0, dx ) );
+
+    for( int y = 0; y < overlap; ++y )
+    {
+        const int pY = ( direction < 0 ) ? ( y + absStep ) : y;
+        const int cY = ( direction < 0 ) ? y : ( y + absStep );
+        const int prevRow = pY * width;
+        const int currRow = cY * width;
+
+        const BYTE* pLuma = &prevLuma[prevRow + xStart];
+        const BYTE* cLuma = &currLuma[currRow + xStart + dx];
+        const BYTE* pMask = &maskPrev[prevRow + xStart];
+        const BYTE* cMask = &maskCurr[currRow + xStart + dx];
+        const int xSpan = xEnd - xStart;
+
+#if defined(PANORAMA_STITCH_SSE2)
+        const __m128i zero = _mm_setzero_si128();
+        int x = 0;
+        for( ; x + 16 <= xSpan; x += 16 )
+        {
+            const __m128i mPrev = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pMask + x ) );
+            const __m128i mCurr = _mm_loadu_si128( reinterpret_cast<const __m128i*>( cMask + x ) );
+            const __m128i mInf = _mm_or_si128( mPrev, mCurr );
+            const __m128i mActive = _mm_cmpgt_epi8( mInf, zero );
+            const unsigned int activeBits = static_cast<unsigned int>( _mm_movemask_epi8( mActive ) );
+            if( activeBits == 0 )
+            {
+                continue;
+            }
+
+            const __m128i va = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pLuma + x ) );
+            const __m128i vb = _mm_loadu_si128( reinterpret_cast<const __m128i*>( cLuma + x ) );
+            const __m128i aMasked = _mm_and_si128( va, mActive );
+            const __m128i bMasked = _mm_and_si128( vb, mActive );
+
+            const __m128i sadA = _mm_sad_epu8( aMasked, zero );
+            const __m128i sadB = _mm_sad_epu8( bMasked, zero );
+            iSumA += static_cast<int64_t>( _mm_cvtsi128_si64( sadA ) ) +
+                     static_cast<int64_t>( _mm_cvtsi128_si64( _mm_srli_si128( sadA, 8 ) ) );
+            iSumB += static_cast<int64_t>( _mm_cvtsi128_si64( sadB ) ) +
+                     static_cast<int64_t>( _mm_cvtsi128_si64( _mm_srli_si128( sadB, 8 ) ) );
+            n += static_cast<int>( std::popcount( activeBits ) );
+
+            const __m128i aLo16 = _mm_unpacklo_epi8( aMasked, zero );
+            const __m128i aHi16 = _mm_unpackhi_epi8( aMasked, zero );
+            const __m128i bLo16 = _mm_unpacklo_epi8( bMasked, zero );
+            const __m128i bHi16 = _mm_unpackhi_epi8( bMasked, zero );
+
+            const __m128i abLo32 = _mm_madd_epi16( aLo16, bLo16 );
+            const __m128i abHi32 = _mm_madd_epi16( aHi16, bHi16 );
+            const __m128i a2Lo32 = _mm_madd_epi16( aLo16, aLo16 );
+            const __m128i a2Hi32 = _mm_madd_epi16( aHi16, aHi16 );
+            const __m128i b2Lo32 = _mm_madd_epi16( bLo16, bLo16 );
+            const __m128i b2Hi32 = _mm_madd_epi16( bHi16, bHi16 );
+
+            alignas(16) int abBuf[4];
+            alignas(16) int a2Buf[4];
+            alignas(16) int b2Buf[4];
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( abBuf ), abLo32 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( a2Buf ), a2Lo32 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( b2Buf ), b2Lo32 );
+            iSumAB += static_cast<int64_t>( abBuf[0] ) + abBuf[1] + abBuf[2] + abBuf[3];
+            iSumA2 += static_cast<int64_t>( a2Buf[0] ) + a2Buf[1] + a2Buf[2] + a2Buf[3];
+            iSumB2 += static_cast<int64_t>( b2Buf[0] ) + b2Buf[1] + b2Buf[2] + b2Buf[3];
+
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( abBuf ), abHi32 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( a2Buf ), a2Hi32 );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( b2Buf ), b2Hi32 );
+            iSumAB += static_cast<int64_t>( abBuf[0] ) + abBuf[1] + abBuf[2] + abBuf[3];
+            iSumA2 += static_cast<int64_t>( a2Buf[0] ) + a2Buf[1] + a2Buf[2] + a2Buf[3];
+            iSumB2 += static_cast<int64_t>( b2Buf[0] ) + b2Buf[1] + b2Buf[2] + b2Buf[3];
+        }
+
+        for( ; x < xSpan; ++x )
+        {
+            if( !pMask[x] && !cMask[x] )
+                continue;
+
+            const int a = static_cast<int>( pLuma[x] );
+            const int b = static_cast<int>( cLuma[x] );
+            iSumA  += a;
+            iSumB  += b;
+            iSumAB += a * b;
+            iSumA2 += a * a;
+            iSumB2 += b * b;
+            n++;
+        }
+#else
+        for( int x = 0; x < xSpan; ++x )
+        {
+            if( !pMask[x] && !cMask[x] )
+                continue;
+
+            const int a = static_cast<int>( pLuma[x] );
+            const int b = static_cast<int>( cLuma[x] );
+            iSumA  += a;
+            iSumB  += b;
+            iSumAB += a * b;
+            iSumA2 += a * a;
+            iSumB2 += b * b;
+            n++;
+        }
+#endif
+    }
+
+    if( n < minSamples ) return 0.0;
+    const double N    = static_cast<double>( n );
+    const double sumA = static_cast<double>( iSumA );
+    const double sumB = static_cast<double>( iSumB );
+    const double varA = static_cast<double>( iSumA2 ) / N - ( sumA / N ) * ( sumA / N );
+    const double varB = static_cast<double>( iSumB2 ) / N - ( sumB / N ) * ( sumB / N );
+    if( varA <= 0.0 || varB <= 0.0 ) return 0.0;
+    const double cov = static_cast<double>( iSumAB ) / N - ( sumA / N ) * ( sumB / N );
+    return cov / sqrt( varA * varB );
+}
+
+static bool FindBestSmallShiftDownsampledLuma( const std::vector<BYTE>& previousPixels,
+                                               const std::vector<BYTE>& currentPixels,
+                                               int frameWidth,
+                                               int frameHeight,
+                                               int maxAbsDyFull,
+                                               int maxAbsDxFull,
+                                               int& bestDxFull,
+                                               int& bestDyFull,
+                                               uint64_t& stationaryScore,
+                                               uint64_t& bestShiftScore )
+{
+    bestDxFull = 0;
+    bestDyFull = 0;
+    stationaryScore = ( std::numeric_limits<uint64_t>::max )();
+    bestShiftScore = ( std::numeric_limits<uint64_t>::max )();
+
+    if( previousPixels.size() != currentPixels.size() || frameWidth <= 0 || frameHeight <= 0 )
+        return false;
+
+    const int scale = ( min( frameWidth, frameHeight ) >= 240 ) ? 4 : 2;
+
+    std::vector<BYTE> prevLuma, currLuma;
+    int dsW = 0, dsH = 0, dsW2 = 0, dsH2 = 0;
+    BuildDownsampledLumaFrame( previousPixels, frameWidth, frameHeight, scale, prevLuma, dsW, dsH );
+    BuildDownsampledLumaFrame( currentPixels,  frameWidth, frameHeight, scale, currLuma, dsW2, dsH2 );
+    if( dsW != dsW2 || dsH != dsH2 || dsW < 8 || dsH < 8 )
+        return false;
+
+    const int maxDyDs = max( 1, maxAbsDyFull / scale );
+    const int maxDxDs = max( 0, maxAbsDxFull / scale );
+
+    const int marginX = max( 2, dsW / 20 );
+    const int marginY = max( 2, dsH / 20 );
+
+    auto scoreShift = [&]( int dx, int dy, uint64_t& outScore ) -> bool
+    {
+        const int absDx = abs( dx );
+        const int absDy = abs( dy );
+
+        const int overlapW = dsW - 2 * marginX - absDx;
+        const int overlapH = dsH - 2 * marginY - absDy;
+        if( overlapW <= dsW / 4 || overlapH <= dsH / 4 )
+            return false;
+
+        const int prevX = marginX + max( 0, -dx );
+        const int currX = marginX + max( 0,  dx );
+        const int prevY = marginY + max( 0, -dy );
+        const int currY = marginY + max( 0,  dy );
+
+        uint64_t total = 0;
+        uint64_t n = 0;
+
+        // Sample every other pixel for speed (good enough for "motion vs none")
+        for( int y = 0; y < overlapH; y += 2 )
+        {
+            const BYTE* pRow = &prevLuma[ ( prevY + y ) * dsW + prevX ];
+            const BYTE* cRow = &currLuma[ ( currY + y ) * dsW + currX ];
+            for( int x = 0; x < overlapW; x += 2 )
+            {
+                total += static_cast<uint64_t>( abs( static_cast<int>( pRow[x] ) - static_cast<int>( cRow[x] ) ) );
+                n++;
+            }
+        }
+
+        if( n < 200 )
+            return false;
+
+        outScore = total / n;
+        return true;
+    };
+
+    uint64_t s0 = 0;
+    if( !scoreShift( 0, 0, s0 ) )
+        return false;
+
+    stationaryScore = s0;
+    bestShiftScore = s0;
+
+    int bestDxDs = 0;
+    int bestDyDs = 0;
+
+    for( int dy = -maxDyDs; dy <= maxDyDs; ++dy )
+    {
+        for( int dx = -maxDxDs; dx <= maxDxDs; ++dx )
+        {
+            if( dx == 0 && dy == 0 )
+                continue;
+
+            uint64_t sc = 0;
+            if( !scoreShift( dx, dy, sc ) )
+                continue;
+
+            if( sc < bestShiftScore )
+            {
+                bestShiftScore = sc;
+                bestDxDs = dx;
+                bestDyDs = dy;
+            }
+        }
+    }
+
+    bestDxFull = bestDxDs * scale;
+    bestDyFull = bestDyDs * scale;
+    return true;
+}
+
+static bool LooksLikeSmallShiftNotDuplicate( const std::vector<BYTE>& previousPixels,
+                                             const std::vector<BYTE>& currentPixels,
+                                             int frameWidth,
+                                             int frameHeight,
+                                             int maxAbsDyFull,
+                                             int maxAbsDxFull,
+                                             bool lowContrastMode,
+                                             int* outDxFull = nullptr,
+                                             int* outDyFull = nullptr,
+                                             uint64_t* outStationary = nullptr,
+                                             uint64_t* outBest = nullptr )
+{
+    int dx = 0, dy = 0;
+    uint64_t s0 = 0, best = 0;
+    if( !FindBestSmallShiftDownsampledLuma( previousPixels, currentPixels, frameWidth, frameHeight,
+                                           maxAbsDyFull, maxAbsDxFull, dx, dy, s0, best ) )
+        return false;
+
+    if( outDxFull ) *outDxFull = dx;
+    if( outDyFull ) *outDyFull = dy;
+    if( outStationary ) *outStationary = s0;
+    if( outBest ) *outBest = best;
+
+    if( dx == 0 && dy == 0 )
+        return false;
+
+    // If stationary is extremely low, we can't reliably separate "tiny scroll" from noise.
+    if( s0 < 4 )
+        return false;
+
+    // Require meaningful improvement over stationary and a reasonably low best score.
+    if( best + 2 > s0 )
+        return false;
+
+    // At least ~15% better than stationary.
+    if( best * 100 > s0 * 85 )
+        return false;
+
+    const uint64_t bestThreshold = lowContrastMode ? 20 : 25;
+    if( best > bestThreshold )
+        return false;
+
+    return true;
+}
+
+// Core pixel-based duplicate detection used by both the HBITMAP and pixel-array
+// entry points.  Returns true if the frames should be treated as duplicates.
+bool ArePixelFramesNearDuplicateCore( const std::vector<BYTE>& currentPixels,
+                                      const std::vector<BYTE>& previousPixels,
+                                      int frameWidth,
+                                      int frameHeight,
+                                      bool lowContrastMode,
+                                      bool verbose )
+{
+    static unsigned s_phase = 0;
+    uint64_t avgDiff = 0;
+    double changedFraction = 0.0;
+
+    const int coarseSampleStep = lowContrastMode ? 4 : 6;
+    if( !ComputeAveragePixelDifference( currentPixels, previousPixels, frameWidth, frameHeight,
+                                        avgDiff, changedFraction, coarseSampleStep, ++s_phase ) )
+    {
+        return false;
+    }
+
+    const uint64_t avgDiffThreshold = lowContrastMode ? 2 : 6;
+    const double changedThreshold = lowContrastMode ? 0.0005 : 0.005;
+    const bool coarseDuplicate = ( avgDiff < avgDiffThreshold && changedFraction < changedThreshold );
+    bool duplicate = coarseDuplicate;
+
+    // Low-content captures (e.g. mostly blank editors where only line numbers
+    // change) can be under-sampled by the coarse pass.  Recheck with denser
+    // sampling before dropping a frame.
+    if( lowContrastMode )
+    {
+        uint64_t fineAvgDiff = 0;
+        double fineChangedFraction = 0.0;
+        if( ComputeAveragePixelDifference( currentPixels, previousPixels, frameWidth, frameHeight,
+                                           fineAvgDiff, fineChangedFraction, 1, ++s_phase ) )
+        {
+            const bool fineDuplicate = ( fineAvgDiff < 1 && fineChangedFraction < 0.00008 );
+            duplicate = coarseDuplicate && fineDuplicate;
+            if( verbose && coarseDuplicate && !fineDuplicate )
+            {
+                StitchLog( L"[Panorama/Capture] Fine-pass rescued frame avgDiff=%llu changedPct=%.3f%% fineAvg=%llu fineChangedPct=%.3f%%\n",
+                             avgDiff,
+                             changedFraction * 100.0,
+                             fineAvgDiff,
+                             fineChangedFraction * 100.0 );
+            }
+        }
+    }
+
+    // Guard: if it "looks duplicate" by RGB stats but a small translation aligns notably better,
+    // treat it as movement (prevents false drops during slow scrolling / low-texture content).
+    if( duplicate )
+    {
+        int guardDx = 0, guardDy = 0;
+        uint64_t s0 = 0, best = 0;
+        if( LooksLikeSmallShiftNotDuplicate( previousPixels, currentPixels, frameWidth, frameHeight,
+                            /*maxAbsDyFull=*/lowContrastMode ? 24 : 16,
+                            /*maxAbsDxFull=*/lowContrastMode ? 12 : 8,
+                            lowContrastMode,
+                                            &guardDx, &guardDy, &s0, &best ) )
+        {
+            duplicate = false;
+            if( verbose )
+            {
+                StitchLog( L"[Panorama/Capture] Duplicate-guard: avgDiff=%llu changedPct=%.2f%% smallShift=(%d,%d) stationary=%llu best=%llu\n",
+                             avgDiff, changedFraction * 100.0, guardDx, guardDy,
+                             static_cast<unsigned long long>( s0 ),
+                             static_cast<unsigned long long>( best ) );
+            }
+        }
+    }
+
+    // Informative-pixel rescue: if the frame still looks like a duplicate but
+    // the edge/text pixels show real differences, keep it.  This catches slow
+    // scrolls of very-low-entropy content where overall avgDiff is diluted
+    // by the overwhelmingly constant background.
+    if( duplicate && lowContrastMode )
+    {
+        uint64_t infDiff = 0, infCount = 0;
+        if( ComputeInformativePixelDifference( currentPixels, previousPixels, frameWidth, frameHeight, infDiff, infCount ) &&
+            infCount > 0 )
+        {
+            const uint64_t avgInfDiff = infDiff / ( infCount * 3 );
+            if( avgInfDiff >= 8 )
+            {
+                duplicate = false;
+                if( verbose )
+                {
+                    StitchLog( L"[Panorama/Capture] Informative-pixel rescued frame avgInfDiff=%llu infCount=%llu\n",
+                                 static_cast<unsigned long long>( avgInfDiff ),
+                                 static_cast<unsigned long long>( infCount ) );
+                }
+            }
+        }
+    }
+
+    if( verbose )
+    {
+        StitchLog( L"[Panorama/Capture] Frame compare avgDiff=%llu changedPct=%.1f%% size=%dx%d identical=%d lowContrast=%d\n",
+                   avgDiff, changedFraction * 100.0, frameWidth, frameHeight, duplicate ? 1 : 0, lowContrastMode ? 1 : 0 );
+    }
+
+    return duplicate;
+}
+
+
+static bool ArePixelFramesNearDuplicate( const std::vector<BYTE>& currentPixels,
+                                         const std::vector<BYTE>& previousPixels,
+                                         int frameWidth,
+                                         int frameHeight,
+                                         bool lowContrastMode )
+{
+    return ArePixelFramesNearDuplicateCore( currentPixels, previousPixels, frameWidth, frameHeight, lowContrastMode, /*verbose=*/false );
+}
+
+static bool TransposePixels32( const std::vector<BYTE>& source,
+                               int sourceWidth,
+                               int sourceHeight,
+                               std::vector<BYTE>& destination )
+{
+    if( sourceWidth <= 0 || sourceHeight <= 0 ||
+        source.size() != static_cast<size_t>( sourceWidth ) * static_cast<size_t>( sourceHeight ) * 4 )
+    {
+        return false;
+    }
+
+    destination.resize( source.size() );
+    for( int y = 0; y < sourceHeight; ++y )
+    {
+        for( int x = 0; x < sourceWidth; ++x )
+        {
+            const int srcIndex = ( y * sourceWidth + x ) * 4;
+            const int dstX = y;
+            const int dstY = x;
+            const int dstWidth = sourceHeight;
+            const int dstIndex = ( dstY * dstWidth + dstX ) * 4;
+            destination[dstIndex + 0] = source[srcIndex + 0];
+            destination[dstIndex + 1] = source[srcIndex + 1];
+            destination[dstIndex + 2] = source[srcIndex + 2];
+            destination[dstIndex + 3] = source[srcIndex + 3];
+        }
+    }
+    return true;
+}
+
+bool FindBestFrameShiftVerticalOnly( const std::vector<BYTE>& previousPixels,
+                                     const std::vector<BYTE>& currentPixels,
+                                     int frameWidth,
+                                     int frameHeight,
+                                     int expectedDx,
+                                     int expectedDy,
+                                     int& bestDx,
+                                     int& bestDy,
+                                     bool lowContrastMode,
+                                     const std::vector<BYTE>& precomputedPrevLuma,
+                                     const std::vector<BYTE>& precomputedCurrLuma,
+                                     int precomputedVeryLowEntropy,
+                                     bool* outNearStationaryOverride,
+                                     bool allowHighConstStationaryRelax,
+                                     uint64_t* outMaskedStationaryScore,
+                                     bool forceExhaustiveProbeBudget,
+                                     bool forceExhaustiveFineDx )
+{
+    if( previousPixels.size() != currentPixels.size() || frameWidth <= 0 || frameHeight <= 0 )
+    {
+        return false;
+    }
+
+    PERF_START( tTotal );
+#ifdef _DEBUG
+    g_StitchPerf.totalCalls++;
+#endif
+
+    // Informative-pixel SAD at dy=0 for HCF pairs (set during the
+    // stationary check, consumed by the post-search validation).
+    uint64_t hcfInfDiff = 0, hcfInfCount = 0;
+
+    // Phase 1 -- Windowed coarse search on downsampled luma
+    // Search a LIMITED range around the expected shift to avoid harmonic
+    // matches on repetitive content.  For the first frame pair
+    // (expectedDy == 0) search outward from the smallest step.
+    //
+    PERF_START( tBuildDsLuma );
+    const int downsampleScale = ( min( frameWidth, frameHeight ) >= 240 ) ? 4 : 2;
+    const bool hasPrecomputedLuma = !precomputedPrevLuma.empty() && !precomputedCurrLuma.empty();
+    std::vector<BYTE> previousLuma;
+    std::vector<BYTE> currentLuma;
+    int dsW = 0, dsH = 0, dsW2 = 0, dsH2 = 0;
+    if( hasPrecomputedLuma )
+    {
+        BuildDownsampledLumaFromFullLuma( precomputedPrevLuma, frameWidth, frameHeight, downsampleScale, previousLuma, dsW, dsH );
+        BuildDownsampledLumaFromFullLuma( precomputedCurrLuma, frameWidth, frameHeight, downsampleScale, currentLuma, dsW2, dsH2 );
+    }
+    else
+    {
+        BuildDownsampledLumaFrame( previousPixels, frameWidth, frameHeight, downsampleScale, previousLuma, dsW, dsH );
+        BuildDownsampledLumaFrame( currentPixels, frameWidth, frameHeight, downsampleScale, currentLuma, dsW2, dsH2 );
+    }
+    if( dsW != dsW2 || dsH != dsH2 )
+    {
+        PERF_STOP( tBuildDsLuma );
+        PERF_STOP( tTotal );
+        return false;
+    }
+    PERF_STOP( tBuildDsLuma );
+
+    const int minStepDs = 1;
+    const int maxStepDs = dsH - max( 2, dsH / 6 );
+    const int marginX = max( 2, dsW / 20 );
+
+    // Stationary score: how well the frames match with zero shift.
+    PERF_START( tStationary );
+    uint64_t stationaryScore = ( std::numeric_limits<uint64_t>::max )();
+    {
+        uint64_t totalDiff = 0;
+        uint64_t samples = 0;
+        for( int y = 0; y < dsH; ++y )
+        {
+            const int row = y * dsW;
+            for( int x = marginX; x < dsW - marginX; x += 2 )
+            {
+                totalDiff += static_cast<uint64_t>(
+                    abs( static_cast<int>( previousLuma[row + x] ) -
+                         static_cast<int>( currentLuma[row + x] ) ) );
+                samples++;
+            }
+        }
+        if( samples > 0 )
+        {
+            stationaryScore = totalDiff / samples;
+        }
+    }
+    PERF_STOP( tStationary );
+
+    // Very-low-entropy detection and informative mask
+    PERF_START( tVleMask );
+    // For frames that are mostly constant (>58% uniform pixels in both
+    // frames), build a boolean mask of "informative" downsampled pixels
+    // (those near edges/text).  Scoring limited to these pixels avoids
+    // the background-to-background dilution that makes low-entropy
+    // content indistinguishable at every shift.
+    //
+    // The high-constant-fraction check is independent of lowContrastMode
+    // so that sparse high-contrast content (black text on white) gets
+    // masked stationary detection.  When the full-frame stationary
+    // score is diluted to 0 by the constant background, the masked
+    // score (informative pixels only) can still detect real movement.
+    // We do NOT promote highConstantFractionPair to veryLowEntropyPair
+    // because the masked coarse/fine search is unreliable when the mask
+    // is sparse (few informative pixels give noisy candidate scoring).
+    const bool isHighConstantFraction =
+        ( precomputedVeryLowEntropy >= 0
+          ? ( precomputedVeryLowEntropy != 0 )
+          : IsVeryLowEntropyPair( previousPixels, currentPixels, frameWidth, frameHeight ) );
+
+    const bool veryLowEntropyPair = lowContrastMode && isHighConstantFraction;
+    const bool highConstantFractionPair = !veryLowEntropyPair && isHighConstantFraction;
+
+    // Build downsampled informative mask: a pixel is informative if the
+    // luma gradient exceeds a small threshold in either frame.
+    std::vector<BYTE> dsMaskPrev;
+    std::vector<BYTE> dsMaskCurr;
+    if( veryLowEntropyPair || highConstantFractionPair )
+    {
+        dsMaskPrev.resize( static_cast<size_t>( dsW ) * dsH, 0 );
+        dsMaskCurr.resize( static_cast<size_t>( dsW ) * dsH, 0 );
+        const int dsEdgeThreshold = 3;
+        for( int y = 1; y < dsH - 1; ++y )
+        {
+            const int rowOff = y * dsW;
+            int x = 1;
+#if defined(PANORAMA_STITCH_NEON)
+            const uint8x16_t vThresh = vdupq_n_u8( dsEdgeThreshold );
+            const uint8x16_t vOne    = vdupq_n_u8( 1 );
+            for( ; x + 16 < dsW - 1; x += 16 )
+            {
+                const int idx = rowOff + x;
+                // Previous frame gradient.
+                const uint8x16_t pCur  = vld1q_u8( previousLuma.data() + idx );
+                const uint8x16_t pRight = vld1q_u8( previousLuma.data() + idx + 1 );
+                const uint8x16_t pDown  = vld1q_u8( previousLuma.data() + idx + dsW );
+                const uint8x16_t pGrad = vqaddq_u8( vabdq_u8( pCur, pRight ),
+                                                     vabdq_u8( pCur, pDown ) );
+                const uint8x16_t pMask = vandq_u8( vcgeq_u8( pGrad, vThresh ), vOne );
+                vst1q_u8( dsMaskPrev.data() + idx, pMask );
+                // Current frame gradient.
+                const uint8x16_t cCur   = vld1q_u8( currentLuma.data() + idx );
+                const uint8x16_t cRight = vld1q_u8( currentLuma.data() + idx + 1 );
+                const uint8x16_t cDown  = vld1q_u8( currentLuma.data() + idx + dsW );
+                const uint8x16_t cGrad = vqaddq_u8( vabdq_u8( cCur, cRight ),
+                                                     vabdq_u8( cCur, cDown ) );
+                const uint8x16_t cMask = vandq_u8( vcgeq_u8( cGrad, vThresh ), vOne );
+                vst1q_u8( dsMaskCurr.data() + idx, cMask );
+            }
+#endif
+            for( ; x < dsW - 1; ++x )
+            {
+                const int idx = rowOff + x;
+                const int gradHP = abs( static_cast<int>( previousLuma[idx] ) - static_cast<int>( previousLuma[idx + 1] ) );
+                const int gradVP = abs( static_cast<int>( previousLuma[idx] ) - static_cast<int>( previousLuma[idx + dsW] ) );
+                if( gradHP + gradVP >= dsEdgeThreshold )
+                    dsMaskPrev[idx] = 1;
+                const int gradHC = abs( static_cast<int>( currentLuma[idx] ) - static_cast<int>( currentLuma[idx + 1] ) );
+                const int gradVC = abs( static_cast<int>( currentLuma[idx] ) - static_cast<int>( currentLuma[idx + dsW] ) );
+                if( gradHC + gradVC >= dsEdgeThreshold )
+                    dsMaskCurr[idx] = 1;
+            }
+        }
+        // Dilate masks by 1px so adjacent-to-edge pixels are included.
+        std::vector<BYTE> dilatedPrev( dsMaskPrev.size(), 0 );
+        std::vector<BYTE> dilatedCurr( dsMaskCurr.size(), 0 );
+        for( int y = 1; y < dsH - 1; ++y )
+        {
+            int x = 1;
+#if defined(PANORAMA_STITCH_NEON)
+            const uint8x16_t vOne = vdupq_n_u8( 1 );
+            for( ; x + 16 < dsW - 1; x += 16 )
+            {
+                const int idx = y * dsW + x;
+                // Previous mask: OR of center, left, right, up, down.
+                uint8x16_t pOr = vld1q_u8( dsMaskPrev.data() + idx );
+                pOr = vorrq_u8( pOr, vld1q_u8( dsMaskPrev.data() + idx - 1 ) );
+                pOr = vorrq_u8( pOr, vld1q_u8( dsMaskPrev.data() + idx + 1 ) );
+                pOr = vorrq_u8( pOr, vld1q_u8( dsMaskPrev.data() + idx - dsW ) );
+                pOr = vorrq_u8( pOr, vld1q_u8( dsMaskPrev.data() + idx + dsW ) );
+                // Clamp to 1 (inputs are 0/1, OR preserves that, but be safe).
+                vst1q_u8( dilatedPrev.data() + idx, vandq_u8( vminq_u8( pOr, vOne ), vOne ) );
+                // Current mask.
+                uint8x16_t cOr = vld1q_u8( dsMaskCurr.data() + idx );
+                cOr = vorrq_u8( cOr, vld1q_u8( dsMaskCurr.data() + idx - 1 ) );
+                cOr = vorrq_u8( cOr, vld1q_u8( dsMaskCurr.data() + idx + 1 ) );
+                cOr = vorrq_u8( cOr, vld1q_u8( dsMaskCurr.data() + idx - dsW ) );
+                cOr = vorrq_u8( cOr, vld1q_u8( dsMaskCurr.data() + idx + dsW ) );
+                vst1q_u8( dilatedCurr.data() + idx, vandq_u8( vminq_u8( cOr, vOne ), vOne ) );
+            }
+#endif
+            for( ; x < dsW - 1; ++x )
+            {
+                const int idx = y * dsW + x;
+                if( dsMaskPrev[idx] | dsMaskPrev[idx - 1] | dsMaskPrev[idx + 1] |
+                    dsMaskPrev[idx - dsW] | dsMaskPrev[idx + dsW] )
+                    dilatedPrev[idx] = 1;
+                if( dsMaskCurr[idx] | dsMaskCurr[idx - 1] | dsMaskCurr[idx + 1] |
+                    dsMaskCurr[idx - dsW] | dsMaskCurr[idx + dsW] )
+                    dilatedCurr[idx] = 1;
+            }
+        }
+        dsMaskPrev = std::move( dilatedPrev );
+        dsMaskCurr = std::move( dilatedCurr );
+    }
+
+    // Compute masked stationary score for very-low-entropy pairs.
+    uint64_t maskedStationaryScore = stationaryScore;
+    if( veryLowEntropyPair || highConstantFractionPair )
+    {
+        uint64_t maskedDiff = 0;
+        uint64_t maskedSamples = 0;
+        for( int y = 0; y < dsH; ++y )
+        {
+            const int row = y * dsW;
+            for( int x = marginX; x < dsW - marginX; x += 2 )
+            {
+                if( dsMaskPrev[row + x] || dsMaskCurr[row + x] )
+                {
+                    maskedDiff += static_cast<uint64_t>(
+                        abs( static_cast<int>( previousLuma[row + x] ) -
+                             static_cast<int>( currentLuma[row + x] ) ) );
+                    maskedSamples++;
+                }
+            }
+        }
+        if( maskedSamples > 0 )
+        {
+            maskedStationaryScore = maskedDiff / maskedSamples;
+        }
+
+        // For high-constant-fraction pairs, the 4x downsampled comparison
+        // averages away small scrolls (3-10px).  Re-check at full resolution
+        // using ComputeInformativePixelDifference which examines gradient
+        // positions in the raw pixel data, detecting sub-downsample movement.
+        if( highConstantFractionPair && maskedStationaryScore < 2 )
+        {
+            if( ComputeInformativePixelDifference( previousPixels, currentPixels,
+                                                   frameWidth, frameHeight,
+                                                   hcfInfDiff, hcfInfCount ) &&
+                hcfInfCount > 0 )
+            {
+                // Convert per-channel sum to approximate luma diff.
+                maskedStationaryScore = hcfInfDiff / ( hcfInfCount * 3 );
+            }
+        }
+    }
+    PERF_STOP( tVleMask );
+
+    // Reject if frames are stationary (near-identical).
+    // For very-low-entropy pairs, use the masked stationary score which
+    // focuses on content pixels and isn't diluted by the background.
+    // For high-constant-fraction pairs that aren't in lowContrastMode,
+    // rescue frames from false stationary rejection when the masked score
+    // shows significant movement at informative pixels.
+    const uint64_t effectiveStationaryScore = veryLowEntropyPair ? maskedStationaryScore : stationaryScore;
+    // High-constant-fraction captures can produce false "stationary=1"
+    // readings on real movement (periodic content with sparse informative
+    // pixels). Use a stricter reject threshold there so only true near-zero
+    // matches are dropped.
+    const uint64_t stationaryRejectThreshold = lowContrastMode ? 1 : 2;
+    if( effectiveStationaryScore <= stationaryRejectThreshold )
+    {
+        const bool highConstStationaryRelax =
+            allowHighConstStationaryRelax &&
+            highConstantFractionPair &&
+            stationaryScore <= 1 &&
+            maskedStationaryScore >= 1;
+
+        // Rescue: if the full-frame score is below threshold but the
+        // masked score (informative pixels only) shows movement, the
+        // frame moved but the background diluted the signal.  Use >= so
+        // that borderline cases (maskedStationary at threshold) are
+        // rescued -- these frames already passed the duplicate check, so
+        // a non-zero masked score indicates real content change.
+        // For HCF pairs, maskedStationaryScore >= 1 is sufficient: a
+        // non-zero average luma diff at informative pixels indicates
+        // real movement even when the full-frame score is diluted by
+        // the constant background.
+        // For VLE pairs, informative pixels are so sparse that the
+        // downsampled stationary score can be 0 even with real movement.
+        // Rescue unconditionally -- the full-resolution masked coarse
+        // fallback will determine the correct shift or legitimately
+        // fail downstream.  Truly-stationary frames are already
+        // filtered by the capture loop's duplicate check.
+        if( veryLowEntropyPair ||
+            ( highConstantFractionPair &&
+              ( maskedStationaryScore >= 1 || highConstStationaryRelax ) ) )
+        {
+            // Fall through to the coarse search.
+        }
+        else
+        {
+            if( outMaskedStationaryScore )
+                *outMaskedStationaryScore = maskedStationaryScore;
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift stationary expected=(%d,%d) stationary=%llu maskedStationary=%llu veryLowEntropy=%d highConstFrac=%d frame=%dx%d\n",
+                         expectedDx, expectedDy,
+                         static_cast<unsigned long long>( stationaryScore ),
+                         static_cast<unsigned long long>( maskedStationaryScore ),
+                         veryLowEntropyPair ? 1 : 0,
+                         highConstantFractionPair ? 1 : 0,
+                         frameWidth, frameHeight );
+            PERF_STOP( tTotal );
+            return false;
+        }
+    }
+
+    // Determine the search window in downsampled space.
+    // Use full range in the known scroll direction.  Scroll speed
+    // can vary dramatically between frames (e.g. 40->202->213->38)
+    // so a narrow window around the expected step misses large jumps.
+    // The candidate-shortlist + fine-resolution ranking below handles
+    // disambiguation among many coarse candidates.
+    const int expectedDyDs = expectedDy / downsampleScale;
+    int searchMinDy, searchMaxDy;
+    if( expectedDyDs == 0 )
+    {
+        // First frame pair: no prior knowledge of scroll direction.
+        searchMinDy = -maxStepDs;
+        searchMaxDy = maxStepDs;
+    }
+    else if( expectedDyDs < 0 )
+    {
+        // Scrolling down: search full range in negative direction.
+        searchMinDy = -maxStepDs;
+        searchMaxDy = -minStepDs;
+    }
+    else
+    {
+        // Scrolling up: search full range in positive direction.
+        searchMinDy = minStepDs;
+        searchMaxDy = maxStepDs;
+    }
+
+
+
+    // Score every candidate within the search window.
+    PERF_START( tCoarseSearch );
+    // Collect the top candidates by raw coarse score, then rank by
+    // full-resolution comparison.  This avoids the problem of distance-
+    // based scoring favoring wrong harmonic matches when scroll speed
+    // varies.
+    struct CoarseCandidate
+    {
+        int dyDs;
+        uint64_t score;
+    };
+
+    constexpr int kMaxCandidates = 12;
+    constexpr int kMaxCandidatesWithProbes = 160;
+    constexpr int kStableDirectionCandidateBudget = 64;
+    constexpr int kConfidentDirectionCandidateBudget = 48;
+    constexpr int kUnknownDirectionCandidateBudget = 96;
+    CoarseCandidate candidates[kMaxCandidatesWithProbes];
+    int candidateCount = 0;
+
+    // Fast-pass budget: search with a tighter candidate budget first, then
+    // rerun with exhaustive budget only when confidence is weak.
+    // Exception: first-pair unknown-direction VLE content is exactly where
+    // candidate starvation can cause axis-defer loops and middle-frame drops,
+    // so force exhaustive coverage up front.
+    const bool useFastProbePass = !forceExhaustiveProbeBudget &&
+                                  !( expectedDyDs == 0 && veryLowEntropyPair );
+    int probeCandidateBudget = kMaxCandidatesWithProbes;
+    if( useFastProbePass )
+    {
+        if( expectedDyDs == 0 )
+        {
+            probeCandidateBudget = kUnknownDirectionCandidateBudget;
+        }
+        else
+        {
+            probeCandidateBudget = ( abs( expectedDyDs ) >= 2 )
+                ? kConfidentDirectionCandidateBudget
+                : kStableDirectionCandidateBudget;
+        }
+    }
+
+    for( int absStep = minStepDs; absStep <= maxStepDs; ++absStep )
+    {
+        for( int direction = -1; direction <= 1; direction += 2 )
+        {
+            const int dyDs = direction * absStep;
+
+            // Skip candidates outside the search window.
+            if( dyDs < searchMinDy || dyDs > searchMaxDy )
+            {
+                continue;
+            }
+
+            const int overlap = dsH - absStep;
+            uint64_t totalDiff = 0;
+            uint64_t samples = 0;
+            bool earlyExitCoarse = false;
+
+            for( int y = 0; y < overlap && !earlyExitCoarse; y += 2 )
+            {
+                const int pY = ( direction < 0 ) ? ( y + absStep ) : y;
+                const int cY = ( direction < 0 ) ? y : ( y + absStep );
+                const int prevRow = pY * dsW;
+                const int currRow = cY * dsW;
+                for( int x = marginX; x < dsW - marginX; x += 2 )
+                {
+                    // For very-low-entropy pairs, only score informative
+                    // pixels (those near edges/text in either frame).
+                    if( veryLowEntropyPair &&
+                        !dsMaskPrev[prevRow + x] && !dsMaskCurr[currRow + x] )
+                    {
+                        continue;
+                    }
+
+                    totalDiff += static_cast<uint64_t>(
+                        abs( static_cast<int>( previousLuma[prevRow + x] ) -
+                             static_cast<int>( currentLuma[currRow + x] ) ) );
+                    samples++;
+                }
+
+                // Early termination: if running average already exceeds
+                // the worst kept candidate, this step cannot win.
+                // Use (score+1)*samples to match floor-division semantics:
+                // floor(totalDiff/samples) > score  iff  totalDiff >= (score+1)*samples.
+                if( candidateCount >= kMaxCandidates && samples >= 100 &&
+                    totalDiff >= (candidates[candidateCount - 1].score + 1) * samples )
+                {
+                    earlyExitCoarse = true;
+                }
+            }
+
+            if( earlyExitCoarse || samples < ( veryLowEntropyPair ? 20 : 100 ) )
+            {
+                continue;
+            }
+
+            uint64_t score = totalDiff / samples;
+
+            // Insert into sorted candidates list if good enough
+            if( candidateCount < kMaxCandidates || score < candidates[candidateCount - 1].score )
+            {
+                int insertPos = candidateCount < kMaxCandidates ? candidateCount : candidateCount - 1;
+                for( int j = insertPos; j > 0 && candidates[j - 1].score > score; --j )
+                {
+                    if( j < kMaxCandidates )
+                    {
+                        candidates[j] = candidates[j - 1];
+                    }
+                    insertPos = j - 1;
+                }
+                if( insertPos < kMaxCandidates )
+                {
+                    candidates[insertPos] = { dyDs, score };
+                    if( candidateCount < kMaxCandidates )
+                    {
+                        candidateCount++;
+                    }
+                }
+            }
+        }
+    }
+    PERF_STOP( tCoarseSearch );
+
+    // Full-resolution masked coarse fallback
+    PERF_START( tMaskedFallback );
+    // When all coarse candidates have score 0 (or the coarse search
+    // produced zero candidates because VLE masking left < 20 samples
+    // at every offset), the downsampled search can't discriminate
+    // offsets.  For high-constant-fraction or very-low-entropy pairs
+    // with sparse text, even a masked downsampled search fails because
+    // at 4x downsample thin characters become indistinguishable blobs.
+    //
+    // The fix: re-run the coarse search at full resolution, scoring
+    // only informative pixels (those near edges/text).  Full-resolution
+    // text characters are clearly distinguishable, so the correct shift
+    // produces a much lower score than wrong shifts.
+    //
+    // This is a fallback-only path: normal content that produces
+    // non-zero downsampled scores is never affected.
+    bool useMaskedFallback = false;
+    std::vector<BYTE> fallbackPrevLuma;
+    std::vector<BYTE> fallbackCurrLuma;
+    std::vector<BYTE> fallbackMaskPrev;
+    std::vector<BYTE> fallbackMaskCurr;
+    if( highConstantFractionPair || veryLowEntropyPair )
+    {
+        bool allZeroOrEmpty = ( candidateCount == 0 );
+        if( !allZeroOrEmpty )
+        {
+            allZeroOrEmpty = true;
+            for( int ci = 0; ci < candidateCount; ++ci )
+            {
+                if( candidates[ci].score > 0 )
+                {
+                    allZeroOrEmpty = false;
+                    break;
+                }
+            }
+        }
+
+        if( allZeroOrEmpty )
+        {
+            // Build full-resolution luma.
+            if( hasPrecomputedLuma )
+            {
+                // Reference precomputed -- avoid copying.
+            }
+            else
+            {
+                BuildFullLumaFrame( previousPixels, frameWidth, frameHeight, fallbackPrevLuma );
+                BuildFullLumaFrame( currentPixels, frameWidth, frameHeight, fallbackCurrLuma );
+            }
+            const std::vector<BYTE>& prevFull = hasPrecomputedLuma ? precomputedPrevLuma : fallbackPrevLuma;
+            const std::vector<BYTE>& currFull = hasPrecomputedLuma ? precomputedCurrLuma : fallbackCurrLuma;
+
+            // Build full-resolution informative masks.
+            const size_t pixelCount = static_cast<size_t>( frameWidth ) * static_cast<size_t>( frameHeight );
+            std::vector<BYTE> rawMaskPrev( pixelCount, 0 );
+            std::vector<BYTE> rawMaskCurr( pixelCount, 0 );
+            const int fineEdgeThreshold = 4;
+            for( int y = 1; y < frameHeight - 1; ++y )
+            {
+                for( int x = 1; x < frameWidth - 1; ++x )
+                {
+                    const int idx = y * frameWidth + x;
+                    const int gHP = abs( static_cast<int>( prevFull[idx] ) - static_cast<int>( prevFull[idx + 1] ) );
+                    const int gVP = abs( static_cast<int>( prevFull[idx] ) - static_cast<int>( prevFull[idx + frameWidth] ) );
+                    if( gHP + gVP >= fineEdgeThreshold )
+                        rawMaskPrev[idx] = 1;
+                    const int gHC = abs( static_cast<int>( currFull[idx] ) - static_cast<int>( currFull[idx + 1] ) );
+                    const int gVC = abs( static_cast<int>( currFull[idx] ) - static_cast<int>( currFull[idx + frameWidth] ) );
+                    if( gHC + gVC >= fineEdgeThreshold )
+                        rawMaskCurr[idx] = 1;
+                }
+            }
+            // Dilate by 1 pixel.
+            fallbackMaskPrev.resize( pixelCount, 0 );
+            fallbackMaskCurr.resize( pixelCount, 0 );
+            for( int y = 1; y < frameHeight - 1; ++y )
+            {
+                for( int x = 1; x < frameWidth - 1; ++x )
+                {
+                    const int idx = y * frameWidth + x;
+                    if( rawMaskPrev[idx] | rawMaskPrev[idx - 1] | rawMaskPrev[idx + 1] |
+                        rawMaskPrev[idx - frameWidth] | rawMaskPrev[idx + frameWidth] )
+                        fallbackMaskPrev[idx] = 1;
+                    if( rawMaskCurr[idx] | rawMaskCurr[idx - 1] | rawMaskCurr[idx + 1] |
+                        rawMaskCurr[idx - frameWidth] | rawMaskCurr[idx + frameWidth] )
+                        fallbackMaskCurr[idx] = 1;
+                }
+            }
+
+            useMaskedFallback = true;
+
+            // Edge-density coarse search at full resolution.
+            // Instead of counting informative pixels per row (fragile on periodic
+            // content), sum horizontal gradient magnitudes per row.  This "edge
+            // density" signal captures the structural layout of text lines.
+            // Cross-correlate using NCC (not L1) for scale-invariant matching.
+            candidateCount = 0;
+            const int fullMarginX = 4;
+            const int fullMinStep = max( 4, downsampleScale );
+            const int fullMaxStep = frameHeight - max( 2, frameHeight / 6 );
+
+            // Build edge density signals.
+            std::vector<int> edgePrev, edgeCurr;
+            BuildRowEdgeDensity( prevFull, frameWidth, frameHeight, fullMarginX, edgePrev );
+            BuildRowEdgeDensity( currFull, frameWidth, frameHeight, fullMarginX, edgeCurr );
+
+            // Convert search window to full-resolution.
+            const int searchMinDyFull = searchMinDy * downsampleScale;
+            const int searchMaxDyFull = searchMaxDy * downsampleScale;
+
+            struct EdgeCandidate { int dyFull; double ncc; };
+            EdgeCandidate edgeCands[kMaxCandidates];
+            int edgeCandCount = 0;
+
+            for( int absStep = fullMinStep; absStep <= fullMaxStep; absStep += 2 )
+            {
+                for( int direction = -1; direction <= 1; direction += 2 )
+                {
+                    const int dyFull = direction * absStep;
+                    if( dyFull < searchMinDyFull || dyFull > searchMaxDyFull )
+                        continue;
+
+                    const int overlap = frameHeight - absStep;
+                    const int* aSig = ( direction < 0 ) ? &edgePrev[absStep] : &edgePrev[0];
+                    const int* bSig = ( direction < 0 ) ? &edgeCurr[0] : &edgeCurr[absStep];
+                    const double ncc = NCC1D( aSig, bSig, overlap );
+
+                    // Insert into top-K by NCC (descending).
+                    if( edgeCandCount < kMaxCandidates || ncc > edgeCands[edgeCandCount - 1].ncc )
+                    {
+                        int insertPos = edgeCandCount < kMaxCandidates ? edgeCandCount : edgeCandCount - 1;
+                        for( int j = insertPos; j > 0 && edgeCands[j - 1].ncc < ncc; --j )
+                        {
+                            if( j < kMaxCandidates )
+                                edgeCands[j] = edgeCands[j - 1];
+                            insertPos = j - 1;
+                        }
+                        if( insertPos < kMaxCandidates )
+                        {
+                            edgeCands[insertPos] = { dyFull, ncc };
+                            if( edgeCandCount < kMaxCandidates )
+                                edgeCandCount++;
+                        }
+                    }
+                }
+            }
+
+            // Transfer edge projection candidates to the main candidate array.
+            // Convert full-resolution dy to downsampled units for the fine search.
+            for( int ei = 0; ei < edgeCandCount; ++ei )
+            {
+                const int dyDs = edgeCands[ei].dyFull / downsampleScale;
+                candidates[candidateCount++] = { dyDs, 0 };
+            }
+            if( candidateCount > 0 )
+                useMaskedFallback = true;
+
+            // When all edge NCC candidates scored <= 0 (no meaningful
+            // correlation found on periodic content), redistribute them
+            // evenly across the search range so the fine search samples
+            // the full window instead of clustering at small shifts.
+            if( useMaskedFallback && edgeCandCount >= 2 &&
+                edgeCands[0].ncc <= 0.0 )
+            {
+                const int rangeSpan = searchMaxDy - searchMinDy;
+                const int stride = max( 1, rangeSpan / ( kMaxCandidates - 1 ) );
+                candidateCount = 0;
+                for( int pos = searchMinDy; pos <= searchMaxDy && candidateCount < kMaxCandidates; pos += stride )
+                {
+                    candidates[candidateCount++] = { pos, 0 };
+                }
+            }
+
+            StitchLog( L"[Panorama/Stitch] FullResMaskedCoarseFallback triggered=%d candidates=%d frame=%dx%d\n",
+                         useMaskedFallback ? 1 : 0, candidateCount,
+                         frameWidth, frameHeight );
+        }
+    }
+    PERF_STOP( tMaskedFallback );
+
+    if( candidateCount == 0 )
+    {
+        StitchLog( L"[Panorama/Stitch] FindBestFrameShift no-match expected=(%d,%d) frame=%dx%d\n",
+                     expectedDx, expectedDy, frameWidth, frameHeight );
+        PERF_STOP( tTotal );
+        return false;
+    }
+
+    const uint64_t bestCoarseScore = candidates[0].score;
+
+    // Optimization #1: confidence-gated probe injection bypass.
+    // On stable high-constant-fraction streams with established motion,
+    // probe candidate expansion can dominate runtime while adding little
+    // value. Skip probes when the coarse winner is clearly separated.
+    const bool coarseWinnerClearlySeparated =
+        ( candidateCount <= 1 ) ||
+        ( candidates[1].score >= candidates[0].score + 6 );
+    const bool bypassProbeInjection =
+        useFastProbePass &&
+        !forceExhaustiveProbeBudget &&
+        expectedDyDs != 0 &&
+        highConstantFractionPair &&
+        !veryLowEntropyPair &&
+        bestCoarseScore <= 12 &&
+        coarseWinnerClearlySeparated;
+
+    // Prune candidates whose coarse score is far worse than the best.
+    PERF_START( tProbeInject );
+    const uint64_t coarsePruneThreshold = bestCoarseScore + ( lowContrastMode ? 20 : 30 );
+    int prunedCount = candidateCount;
+    for( int ci = 0; ci < prunedCount; ++ci )
+    {
+        if( candidates[ci].score > coarsePruneThreshold )
+        {
+            prunedCount = ci;
+            break;
+        }
+    }
+    if( prunedCount < 1 )
+    {
+        prunedCount = 1;
+    }
+
+    // Pre-compute full-resolution luma arrays.  Hoisted before probe
+    // injection so that edge-projection injection (HCF) can use them.
+    // Use caller-provided full-resolution luma if available; reuse
+    // fallback-computed luma if the masked coarse ran; otherwise compute locally.
+    std::vector<BYTE> previousFullLumaOwned;
+    std::vector<BYTE> currentFullLumaOwned;
+    if( !hasPrecomputedLuma )
+    {
+        if( !fallbackPrevLuma.empty() )
+        {
+            previousFullLumaOwned = std::move( fallbackPrevLuma );
+            currentFullLumaOwned = std::move( fallbackCurrLuma );
+        }
+        else
+        {
+            BuildFullLumaFrame( previousPixels, frameWidth, frameHeight, previousFullLumaOwned );
+            BuildFullLumaFrame( currentPixels, frameWidth, frameHeight, currentFullLumaOwned );
+        }
+    }
+    const std::vector<BYTE>& previousFullLuma = hasPrecomputedLuma ? precomputedPrevLuma : previousFullLumaOwned;
+    const std::vector<BYTE>& currentFullLuma = hasPrecomputedLuma ? precomputedCurrLuma : currentFullLumaOwned;
+
+    // Seed the candidates with the phase-correlation peaks of the row
+    // profiles.  At large steps the downsampled coarse search above only
+    // sees a short overlap and can leave the true shift out of its
+    // shortlist; the peaks come from the whole frame and cost the same
+    // whatever the step.
+    //
+    // A single clear peak already pins the shift down to within the refine
+    // radius.  The fine search then only verifies it against the coarse
+    // winner, and the probe expansion and edge-projection scan below, whose
+    // cost grows with the search window, are skipped.  Harmonics of a text
+    // line pitch show up as a second peak of similar NCC and keep the full
+    // search; a poor fine score reruns with the exhaustive budget.
+    PERF_START( tPhaseCorrelation );
+    constexpr int kPhaseCorrelationPeaks = 3;
+    constexpr double kConfidentPhaseNcc = 0.95;
+    constexpr double kPhasePeakSeparation = 0.1;
+    PhaseCorrelationPeak phasePeaks[kPhaseCorrelationPeaks];
+    const int phasePeakCount = EstimateVerticalShiftsByPhaseCorrelation( previousFullLuma,
+                                                                         currentFullLuma,
+                                                                         frameWidth,
+                                                                         frameHeight,
+                                                                         max( 4, minStepDs * downsampleScale ),
+                                                                         searchMinDy * downsampleScale,
+                                                                         searchMaxDy * downsampleScale,
+                                                                         frameHeight / 4,
+                                                                         phasePeaks,
+                                                                         kPhaseCorrelationPeaks );
+    int phasePeakDyDs[kPhaseCorrelationPeaks];
+    for( int pi = 0; pi < phasePeakCount; ++pi )
+    {
+        phasePeakDyDs[pi] = DivideRounded( phasePeaks[pi].dy, downsampleScale );
+        if( abs( phasePeakDyDs[pi] ) < minStepDs || abs( phasePeakDyDs[pi] ) > maxStepDs ||
+            phasePeakDyDs[pi] < searchMinDy || phasePeakDyDs[pi] > searchMaxDy )
+        {
+            phasePeakDyDs[pi] = 0;
+        }
+    }
+    const bool phaseCorrelationConfident =
+        useFastProbePass &&
+        phasePeakCount > 0 &&
+        phasePeakDyDs[0] != 0 &&
+        phasePeaks[0].ncc >= kConfidentPhaseNcc &&
+        ( phasePeakCount == 1 || phasePeaks[1].ncc <= phasePeaks[0].ncc - kPhasePeakSeparation );
+    const bool skipProbeExpansion = bypassProbeInjection || phaseCorrelationConfident;
+    if( phaseCorrelationConfident )
+    {
+        prunedCount = 1;
+    }
+    for( int pi = 0; pi < phasePeakCount && prunedCount < kMaxCandidatesWithProbes; ++pi )
+    {
+        if( phasePeakDyDs[pi] == 0 )
+        {
+            continue;
+        }
+
+        bool alreadyPresent = false;
+        for( int ci = 0; ci < prunedCount; ++ci )
+        {
+            if( candidates[ci].dyDs == phasePeakDyDs[pi] )
+            {
+                alreadyPresent = true;
+                break;
+            }
+        }
+
+        if( !alreadyPresent )
+        {
+            candidates[prunedCount] = { phasePeakDyDs[pi], coarsePruneThreshold };
+            prunedCount++;
+        }
+    }
+    StitchLog( L"[Panorama/Stitch] PhaseCorrelation peaks=%d top=(%d,%.3f) second=(%d,%.3f) expected=(%d,%d) confident=%d\n",
+                 phasePeakCount,
+                 phasePeakCount > 0 ? phasePeaks[0].dy : 0, phasePeakCount > 0 ? phasePeaks[0].ncc : 0.0,
+                 phasePeakCount > 1 ? phasePeaks[1].dy : 0, phasePeakCount > 1 ? phasePeaks[1].ncc : 0.0,
+                 expectedDx, expectedDy,
+                 phaseCorrelationConfident ? 1 : 0 );
+    PERF_STOP( tPhaseCorrelation );
+
+    // Inject probe candidates near the expected shift.  Content with regular
+    // vertical structure (e.g. code text at ~13 px line height) produces many
+    // similarly-scored coarse candidates at text-line harmonics, pushing the
+    // correct shift outside the top-12.  Adding probes at the expected step
+    // ensures the fine search always evaluates the correct neighborhood.
+    if( !skipProbeExpansion && expectedDyDs != 0 && prunedCount < probeCandidateBudget )
+    {
+        for( int probe = -3; probe <= 3 && prunedCount < probeCandidateBudget; ++probe )
+        {
+            const int probeDyDs = expectedDyDs + probe;
+            if( abs( probeDyDs ) < minStepDs || abs( probeDyDs ) > maxStepDs )
+            {
+                continue;
+            }
+
+            // Respect the search window established by the scroll direction.
+            // Without this check, probes near expectedDyDs can inject wrong-
+            // direction candidates (e.g. dyDs=+1 when searching negative only),
+            // which on HCF content score nearly identically to the correct
+            // direction and cause forward/backward oscillation.
+            if( probeDyDs < searchMinDy || probeDyDs > searchMaxDy )
+            {
+                continue;
+            }
+
+            bool alreadyPresent = false;
+            for( int ci = 0; ci < prunedCount; ++ci )
+            {
+                if( candidates[ci].dyDs == probeDyDs )
+                {
+                    alreadyPresent = true;
+                    break;
+                }
+            }
+
+            if( !alreadyPresent )
+            {
+                candidates[prunedCount] = { probeDyDs, coarsePruneThreshold };
+                prunedCount++;
+            }
+        }
+    }
+
+    // Flat-content exhaustive fallback: when the coarse search cannot
+    // discriminate offsets (best coarse score is at noise-floor level),
+    // inject DS candidates across the search window.  Iterate from the
+    // center outward (smallest absStep first) so that moderate shifts —
+    // the most common in real scrolling — get candidate slots before the
+    // budget fills up.  For high-entropy low-contrast content, all
+    // shifts score nearly identically in the downsampled space because
+    // rows are independent random values, so the top-12 selection is
+    // essentially random and may miss the true shift.  The fine search
+    // at full resolution CAN discriminate because the true shift gives
+    // zero difference (exact row match).  Once the first score=0
+    // candidate is found the earlyExit mechanism makes all remaining
+    // candidates trivially cheap to evaluate.
+    if( !skipProbeExpansion && bestCoarseScore >= 8 && !highConstantFractionPair )
+    {
+        for( int absStep = minStepDs; absStep <= maxStepDs && prunedCount < probeCandidateBudget; ++absStep )
+        {
+            for( int direction = -1; direction <= 1; direction += 2 )
+            {
+                if( prunedCount >= probeCandidateBudget )
+                    break;
+
+                const int dyDs = direction * absStep;
+                if( dyDs < searchMinDy || dyDs > searchMaxDy )
+                    continue;
+
+                bool alreadyPresent = false;
+                for( int ci = 0; ci < prunedCount; ++ci )
+                {
+                    if( candidates[ci].dyDs == dyDs )
+                    {
+                        alreadyPresent = true;
+                        break;
+                    }
+                }
+
+                if( !alreadyPresent )
+                {
+                    candidates[prunedCount] = { dyDs, coarsePruneThreshold };
+                    prunedCount++;
+                }
+            }
+        }
+    }
+
+    // First-frame diversity: when no expected motion is known, the coarse
+    // search may concentrate all candidates at small harmonics, causing
+    // the fine search to miss the true (potentially large) shift.  Inject
+    // evenly-distributed probes across the full search range so the fine
+    // search always evaluates a representative sample of shifts.
+    // Performance is safe because the correct shift produces fineScore=0
+    // on exact-overlap content, and early termination kills all subsequent
+    // candidates after the first sample.
+    if( !skipProbeExpansion && expectedDyDs == 0 && prunedCount < probeCandidateBudget )
+    {
+        const int rangeSpan = searchMaxDy - searchMinDy;
+        const int probeTarget = min( 30, max( 10, rangeSpan / 4 ) );
+        const int probeStride = max( 1, rangeSpan / max( 1, probeTarget ) );
+        for( int pos = searchMinDy; pos <= searchMaxDy && prunedCount < probeCandidateBudget; pos += probeStride )
+        {
+            if( abs( pos ) < minStepDs || abs( pos ) > maxStepDs )
+                continue;
+
+            bool alreadyPresent = false;
+            for( int ci = 0; ci < prunedCount; ++ci )
+            {
+                if( candidates[ci].dyDs == pos )
+                {
+                    alreadyPresent = true;
+                    break;
+                }
+            }
+
+            if( !alreadyPresent )
+            {
+                candidates[prunedCount] = { pos, coarsePruneThreshold };
+                prunedCount++;
+            }
+        }
+    }
+
+    // Exhaustive probe injection for masked-fallback HCF content: the
+    // coarse row-projection search may cluster candidates around a few
+    // harmonics, missing the correct shift.  Since the masked fine search
+    // scores only informative (text/edge) pixels, wrong shifts produce
+    // non-zero scores while the correct shift scores ~ 0.  Injecting
+    // every candidate is safe: early termination after the first score=0
+    // hit makes subsequent evaluations trivially cheap.
+    if( !skipProbeExpansion && useMaskedFallback && prunedCount < probeCandidateBudget )
+    {
+        for( int dyDs = searchMinDy; dyDs <= searchMaxDy && prunedCount < probeCandidateBudget; ++dyDs )
+        {
+            if( abs( dyDs ) < minStepDs || abs( dyDs ) > maxStepDs )
+                continue;
+
+            bool alreadyPresent = false;
+            for( int ci = 0; ci < prunedCount; ++ci )
+            {
+                if( candidates[ci].dyDs == dyDs )
+                {
+                    alreadyPresent = true;
+                    break;
+                }
+            }
+
+            if( !alreadyPresent )
+            {
+                candidates[prunedCount] = { dyDs, coarsePruneThreshold };
+                prunedCount++;
+            }
+        }
+    }
+
+    // Harmonic-fallback probe injection for HCF content.  When the best
+    // coarse candidate scored 0 (perfect harmonic at downsampled resolution)
+    // but not all candidates are zero (useMaskedFallback didn't fire), the
+    // correct shift may be missing from the candidate list.
+    //
+    // This specifically targets the "jump-recovery" scenario: the expected
+    // step is large (the previous frame jumped), but the actual shift for
+    // this frame is much smaller.  The coarse search locks onto a harmonic
+    // of the text-line period, and the small correct shift isn't among the
+    // top candidates.
+    //
+    // Only inject small-shift probes (|dyDs| much less than expected) to
+    // avoid introducing harmonic false matches at large offsets.  The fine
+    // search (standard luma) gives fineScore == 0 only at the true pixel
+    // offset, so a probe guard (score > 0 -> skip) prevents regressions.
+    const bool harmonicFallback = highConstantFractionPair && bestCoarseScore <= 2 && !useMaskedFallback;
+    const int preHarmonicProbeCount = prunedCount;
+    const int expectedAbsStepEarly = max( abs( expectedDy ), abs( expectedDx ) );
+    if( !skipProbeExpansion && harmonicFallback && forceExhaustiveProbeBudget )
+    {
+        probeCandidateBudget = kMaxCandidatesWithProbes;
+    }
+    if( !skipProbeExpansion && harmonicFallback && expectedAbsStepEarly >= frameHeight / 5 )
+    {
+        const int maxProbeDyDs = max( 3, abs( expectedDy ) / ( 3 * downsampleScale ) );
+
+        for( int dyDs = -maxProbeDyDs; dyDs <= maxProbeDyDs && prunedCount < probeCandidateBudget; ++dyDs )
+        {
+            if( abs( dyDs ) < minStepDs || abs( dyDs ) > maxStepDs )
+                continue;
+
+            bool alreadyPresent = false;
+            for( int ci = 0; ci < prunedCount; ++ci )
+            {
+                if( candidates[ci].dyDs == dyDs )
+                {
+                    alreadyPresent = true;
+                    break;
+                }
+            }
+
+            if( !alreadyPresent )
+            {
+                candidates[prunedCount] = { dyDs, coarsePruneThreshold };
+                prunedCount++;
+            }
+        }
+    }
+
+    // Edge-projection candidate injection for HCF content.
+    // When the standard downsampled coarse search works (some non-zero scores)
+    // but may have missed the correct shift among harmonic alternatives,
+    // edge-density NCC provides structurally-informed candidates.
+    if( highConstantFractionPair && !useMaskedFallback && candidateCount > 0 && !phaseCorrelationConfident )
+    {
+        PERF_START( tEdgeProjection );
+        std::vector<int> edgePrevInj, edgeCurrInj;
+        BuildRowEdgeDensity( previousFullLuma, frameWidth, frameHeight, 4, edgePrevInj );
+        BuildRowEdgeDensity( currentFullLuma, frameWidth, frameHeight, 4, edgeCurrInj );
+
+        // Find top 8 edge-density NCC candidates.
+        struct EdgeCandidate { int dyFull; double ncc; };
+        constexpr int kEdgeInject = 8;
+        EdgeCandidate edgeInj[kEdgeInject];
+        int eiCount = 0;
+
+        const int searchMinFull = searchMinDy * downsampleScale;
+        const int searchMaxFull = searchMaxDy * downsampleScale;
+
+        // Parallel NCC scan: evaluate all (absStep, dir) pairs concurrently.
+        const int nccMinStep = max( 4, downsampleScale );
+        const int nccMaxStep = frameHeight - max( 2, frameHeight / 6 );
+        struct NccWork { int absStep; int dir; double ncc; };
+        std::vector<NccWork> nccWork;
+        nccWork.reserve( 2 * ( ( nccMaxStep - nccMinStep ) / 2 + 1 ) );
+        for( int absStep = nccMinStep; absStep <= nccMaxStep; absStep += 2 )
+        {
+            for( int dir = -1; dir <= 1; dir += 2 )
+            {
+                const int dyF = dir * absStep;
+                if( dyF >= searchMinFull && dyF <= searchMaxFull )
+                    nccWork.push_back( { absStep, dir, 0.0 } );
+            }
+        }
+
+        parallel_for( 0, static_cast<int>( nccWork.size() ), [&]( int idx )
+        {
+            auto& w = nccWork[idx];
+            const int overlap = frameHeight - w.absStep;
+            const int* aS = ( w.dir < 0 ) ? &edgePrevInj[w.absStep] : &edgePrevInj[0];
+            const int* bS = ( w.dir < 0 ) ? &edgeCurrInj[0] : &edgeCurrInj[w.absStep];
+            w.ncc = NCC1D( aS, bS, overlap );
+        } );
+
+        // Pick top kEdgeInject from all NCC results.
+        for( const auto& w : nccWork )
+        {
+            const int dyF = w.dir * w.absStep;
+            if( eiCount < kEdgeInject || w.ncc > edgeInj[eiCount - 1].ncc )
+            {
+                int ip = eiCount < kEdgeInject ? eiCount : eiCount - 1;
+                for( int j = ip; j > 0 && edgeInj[j - 1].ncc < w.ncc; --j )
+                {
+                    if( j < kEdgeInject )
+                        edgeInj[j] = edgeInj[j - 1];
+                    ip = j - 1;
+                }
+                if( ip < kEdgeInject )
+                {
+                    edgeInj[ip] = { dyF, w.ncc };
+                    if( eiCount < kEdgeInject )
+                        eiCount++;
+                }
+            }
+        }
+
+        // Inject into candidate array (avoid duplicates).
+        for( int ei = 0; ei < eiCount && prunedCount < probeCandidateBudget; ++ei )
+        {
+            const int dyDs = edgeInj[ei].dyFull / downsampleScale;
+            bool dup = false;
+            for( int ci = 0; ci < prunedCount; ++ci )
+                if( candidates[ci].dyDs == dyDs ) { dup = true; break; }
+            if( !dup )
+                candidates[prunedCount++] = { dyDs, coarsePruneThreshold };
+        }
+
+        StitchLog( L"[Panorama/Stitch] EdgeProjectionInject injected=%d topNCC=%.4f\n",
+                     eiCount, eiCount > 0 ? edgeInj[0].ncc : 0.0 );
+        PERF_STOP( tEdgeProjection );
+    }
+
+    if( bypassProbeInjection )
+    {
+        StitchLog( L"[Panorama/Stitch] ProbeInject bypassed expected=(%d,%d) bestCoarse=%llu candidateCount=%d\n",
+                     expectedDx,
+                     expectedDy,
+                     static_cast<unsigned long long>( bestCoarseScore ),
+                     candidateCount );
+    }
+
+    // Debug: log coarse candidates for HCF frames to diagnose harmonic issues.
+    if( highConstantFractionPair && bestCoarseScore <= 2 )
+    {
+        StitchLog( L"[Panorama/Stitch] HCF-candidates expected=(%d,%d) coarseCount=%d prunedCount=%d bestCoarse=%llu candidates=",
+                     expectedDx, expectedDy, candidateCount, prunedCount,
+                     static_cast<unsigned long long>( bestCoarseScore ) );
+        for( int ci = 0; ci < min( prunedCount, 30 ); ++ci )
+        {
+            StitchLog( L"%d(%llu) ", candidates[ci].dyDs,
+                         static_cast<unsigned long long>( candidates[ci].score ) );
+        }
+        StitchLog( L"\n" );
+    }
+    PERF_STOP( tProbeInject );
+
+    // Phase 2: Rank candidates by full-resolution comparison
+    PERF_START( tFineSearch );
+    // For each coarse candidate, compute a fine score at full resolution.
+    // This resolves ambiguity from harmonic matches on repetitive content
+    // since the full-resolution comparison sees fine text details that
+    // the downsampled comparison misses.
+    //
+    // Pre-compute full-resolution luma arrays so the inner loop uses
+    // cheap byte lookups instead of per-pixel RGB->luma multiplies.
+    //
+    // When the masked-fallback created evenly-distributed candidates,
+    // the gap between adjacent candidates can be much larger than the
+    // normal refine radius (e.g. 96 full-res pixels vs +/-5).  Widen
+    // refineRadiusDy to half the distribution stride so that adjacent
+    // candidate refinement ranges overlap, guaranteeing full coverage.
+    const int normalRefineRadius = max( 3, downsampleScale + 1 );
+    const int refineRadiusDy = useMaskedFallback && candidateCount >= 2 && !phaseCorrelationConfident
+        ? max( normalRefineRadius,
+               ( searchMaxDy - searchMinDy ) * downsampleScale / ( 2 * max( 1, candidateCount - 1 ) ) )
+        : normalRefineRadius;
+    // Fast fine-search pass: when horizontal motion is expected to be zero and
+    // vertical direction is already established, evaluate only dx=0 first.
+    // If confidence is weak, we rerun once with full dx radius to preserve
+    // quality on borderline frames.
+    const bool useFastFineDxPass =
+        !forceExhaustiveFineDx &&
+        expectedDx == 0 &&
+        expectedDy != 0;
+    const int refineRadiusDx = useFastFineDxPass ? 0 : 1;
+
+    // Build full-resolution informative masks for very-low-entropy pairs.
+    // The masked fine search restricts scoring to content pixels (text
+    // edges) which is essential for low-contrast terminal-style content
+    // where the standard SAD produces near-zero scores everywhere.
+    std::vector<BYTE> fullMaskPrev;
+    std::vector<BYTE> fullMaskCurr;
+    const bool useFineMask = veryLowEntropyPair || useMaskedFallback;
+    const bool useZnccFineSearch = highConstantFractionPair && useFineMask;
+    constexpr uint64_t kZnccScoreBase = 12800;
+    if( useFineMask )
+    {
+        if( !fallbackMaskPrev.empty() )
+        {
+            fullMaskPrev = std::move( fallbackMaskPrev );
+            fullMaskCurr = std::move( fallbackMaskCurr );
+        }
+        else
+        {
+            const size_t pixelCount = static_cast<size_t>( frameWidth ) * static_cast<size_t>( frameHeight );
+            fullMaskPrev.resize( pixelCount, 0 );
+            fullMaskCurr.resize( pixelCount, 0 );
+            const int fineEdgeThreshold = 4;
+            for( int y = 1; y < frameHeight - 1; ++y )
+            {
+                for( int x = 1; x < frameWidth - 1; ++x )
+                {
+                    const int idx = y * frameWidth + x;
+                    const int gHP = abs( static_cast<int>( previousFullLuma[idx] ) - static_cast<int>( previousFullLuma[idx + 1] ) );
+                    const int gVP = abs( static_cast<int>( previousFullLuma[idx] ) - static_cast<int>( previousFullLuma[idx + frameWidth] ) );
+                    if( gHP + gVP >= fineEdgeThreshold )
+                        fullMaskPrev[idx] = 1;
+                    const int gHC = abs( static_cast<int>( currentFullLuma[idx] ) - static_cast<int>( currentFullLuma[idx + 1] ) );
+                    const int gVC = abs( static_cast<int>( currentFullLuma[idx] ) - static_cast<int>( currentFullLuma[idx + frameWidth] ) );
+                    if( gHC + gVC >= fineEdgeThreshold )
+                        fullMaskCurr[idx] = 1;
+                }
+            }
+            // Dilate by 1 pixel.
+            std::vector<BYTE> dilPrev( pixelCount, 0 );
+            std::vector<BYTE> dilCurr( pixelCount, 0 );
+            for( int y = 1; y < frameHeight - 1; ++y )
+            {
+                for( int x = 1; x < frameWidth - 1; ++x )
+                {
+                    const int idx = y * frameWidth + x;
+                    if( fullMaskPrev[idx] | fullMaskPrev[idx - 1] | fullMaskPrev[idx + 1] |
+                        fullMaskPrev[idx - frameWidth] | fullMaskPrev[idx + frameWidth] )
+                        dilPrev[idx] = 1;
+                    if( fullMaskCurr[idx] | fullMaskCurr[idx - 1] | fullMaskCurr[idx + 1] |
+                        fullMaskCurr[idx - frameWidth] | fullMaskCurr[idx + frameWidth] )
+                        dilCurr[idx] = 1;
+                }
+            }
+            fullMaskPrev = std::move( dilPrev );
+            fullMaskCurr = std::move( dilCurr );
+        }
+    }
+
+    // Per-row mask prefix counts let the masked fine-search skip rows that
+    // contain no informative pixels in either frame window.
+    std::vector<unsigned short> fullMaskPrevRowPrefix;
+    std::vector<unsigned short> fullMaskCurrRowPrefix;
+    if( useFineMask )
+    {
+        const size_t prefixStride = static_cast<size_t>( frameWidth ) + 1;
+        fullMaskPrevRowPrefix.assign( static_cast<size_t>( frameHeight ) * prefixStride, 0 );
+        fullMaskCurrRowPrefix.assign( static_cast<size_t>( frameHeight ) * prefixStride, 0 );
+
+        for( int y = 0; y < frameHeight; ++y )
+        {
+            const size_t rowBase = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth );
+            const size_t prefBase = static_cast<size_t>( y ) * prefixStride;
+            for( int x = 0; x < frameWidth; ++x )
+            {
+                fullMaskPrevRowPrefix[prefBase + static_cast<size_t>( x ) + 1] =
+                    static_cast<unsigned short>(
+                        fullMaskPrevRowPrefix[prefBase + static_cast<size_t>( x )] +
+                        ( fullMaskPrev[rowBase + static_cast<size_t>( x )] ? 1 : 0 ) );
+                fullMaskCurrRowPrefix[prefBase + static_cast<size_t>( x ) + 1] =
+                    static_cast<unsigned short>(
+                        fullMaskCurrRowPrefix[prefBase + static_cast<size_t>( x )] +
+                        ( fullMaskCurr[rowBase + static_cast<size_t>( x )] ? 1 : 0 ) );
+            }
+        }
+    }
+
+    // Scale fine scores by 256 to preserve sub-integer precision.
+    // For sparse content (< 1% non-background pixels), the per-pixel
+    // average difference at wrong shifts is < 1.0, which integer
+    // division truncates to 0 -- making correct and wrong shifts
+    // indistinguishable.  The 256x scale gives 8 bits of fractional
+    // precision without risk of u64 overflow (max totalDiff*256 ~ 20B).
+    constexpr uint64_t kFineScoreScale = 256;
+    uint64_t bestFineScore = ( std::numeric_limits<uint64_t>::max )();
+    uint64_t secondBestFineScore = ( std::numeric_limits<uint64_t>::max )();
+    uint64_t bestFineRankScore = ( std::numeric_limits<uint64_t>::max )();
+    uint64_t secondBestFineRankScore = ( std::numeric_limits<uint64_t>::max )();
+    int secondBestDx = 0;
+    int secondBestDy = 0;
+    bestDx = 0;
+    bestDy = candidates[0].dyDs * downsampleScale;
+    int bestAbsStep = ( std::numeric_limits<int>::max )();
+    int bestAbsDx = ( std::numeric_limits<int>::max )();
+    const int expectedAbsStep = max( abs( expectedDy ), abs( expectedDx ) );
+    int bestExpectedDelta = ( std::numeric_limits<int>::max )();
+    // Track best fine score seen at a candidate near expectedAbsStep
+    // (within +/-4 px). Used both for diagnostics and for harmonic-override
+    // logic that prefers expected-step candidates over far-away harmonics.
+    uint64_t scoreAtExpectedStep = ( std::numeric_limits<uint64_t>::max )();
+    int dxAtExpectedStep = 0;
+    int dyAtExpectedStep = 0;
+
+    // Harmonic-fallback tracking: record whether the ORIGINAL candidates
+    // (before probe injection) achieved fineScore==0, and the smallest
+    // |dy| among ALL candidates (including probes) that scored 0.
+    bool foundOriginalZero = false;
+    int smallestZeroAbsStep = ( std::numeric_limits<int>::max )();
+    int smallestZeroDy = 0;
+    int smallestZeroDx = 0;
+
+    const int fineMarginX = useMaskedFallback ? 4 : max( 4, frameWidth / 20 );
+
+    // Parallel fine search: enumerate work items, score in parallel, rank sequentially.
+    struct FineWorkItem {
+        int ci;
+        int dy;
+        int dx;
+        uint64_t score;
+        bool valid;
+    };
+    std::vector<FineWorkItem> fineWork;
+    fineWork.reserve( prunedCount * ( 2 * refineRadiusDy + 1 ) * ( 2 * refineRadiusDx + 1 ) );
+
+    for( int ci = 0; ci < prunedCount; ++ci )
+    {
+        const int coarseDyFull = candidates[ci].dyDs * downsampleScale;
+        for( int ddy = -refineRadiusDy; ddy <= refineRadiusDy; ++ddy )
+        {
+            const int dy = coarseDyFull + ddy;
+            const int absStep = abs( dy );
+            if( absStep < 4 || absStep >= frameHeight - 4 )
+                continue;
+            const int overlap = frameHeight - absStep;
+            if( overlap < frameHeight / 4 )
+                continue;
+            for( int dx = -refineRadiusDx; dx <= refineRadiusDx; ++dx )
+            {
+                const int xStart = max( fineMarginX, fineMarginX + max( 0, -dx ) );
+                const int xEnd = min( frameWidth - fineMarginX, frameWidth - fineMarginX - max( 0, dx ) );
+                if( xEnd - xStart < frameWidth / 3 )
+                    continue;
+                fineWork.push_back( { ci, dy, dx, 0, false } );
+            }
+        }
+    }
+
+    // Shared approximate best score for cross-thread early termination.
+    // Only used after a significant fraction of rows are evaluated to
+    // avoid prematurely terminating the true best candidate whose running
+    // average is temporarily inflated by early high-difference rows.
+    std::atomic<uint64_t> sharedBestFine{ ( std::numeric_limits<uint64_t>::max )() };
+
+    // Score all work items in parallel.
+    parallel_for( 0, static_cast<int>( fineWork.size() ), [&]( int idx )
+    {
+        auto& w = fineWork[idx];
+        const int dy = w.dy;
+        const int dx = w.dx;
+        const int absStep = abs( dy );
+        const int overlap = frameHeight - absStep;
+        const int xStart = max( fineMarginX, fineMarginX + max( 0, -dx ) );
+        const int xEnd = min( frameWidth - fineMarginX, frameWidth - fineMarginX - max( 0, dx ) );
+
+        if( useZnccFineSearch )
+        {
+            const double zncc = ComputeMaskedZNCC(
+                previousFullLuma.data(), currentFullLuma.data(),
+                fullMaskPrev.data(), fullMaskCurr.data(),
+                frameWidth, overlap, absStep,
+                ( dy < 0 ) ? -1 : 1, dx,
+                fineMarginX, 50 /*minSamples*/ );
+            w.score = static_cast<uint64_t>(
+                max( 0.0, ( 1.0 - zncc ) * static_cast<double>( kZnccScoreBase ) ) );
+            w.valid = true;
+        }
+        else
+        {
+
+        uint64_t totalDiff = 0;
+        uint64_t samples = 0;
+        bool earlyExit = false;
+
+        for( int y = 0; y < overlap && !earlyExit; y += 2 )
+        {
+            int pY, cY;
+            if( dy < 0 )
+            {
+                pY = y + absStep;
+                cY = y;
+            }
+            else
+            {
+                pY = y;
+                cY = y + absStep;
+            }
+
+            const int prevRow = pY * frameWidth;
+            const int currRow = cY * frameWidth;
+
+            const BYTE* pBase = &previousFullLuma[prevRow + xStart];
+            const BYTE* cBase = &currentFullLuma[currRow + xStart + dx];
+            const int xSpan = xEnd - xStart;
+            uint64_t rowDiff = 0;
+
+            if( useFineMask )
+            {
+                const size_t prefixStride = static_cast<size_t>( frameWidth ) + 1;
+                const size_t prevPrefBase = static_cast<size_t>( pY ) * prefixStride;
+                const size_t currPrefBase = static_cast<size_t>( cY ) * prefixStride;
+                const int currXStart = xStart + dx;
+                const int currXEnd = xEnd + dx;
+
+                const unsigned int prevInformative = static_cast<unsigned int>(
+                    fullMaskPrevRowPrefix[prevPrefBase + static_cast<size_t>( xEnd )] -
+                    fullMaskPrevRowPrefix[prevPrefBase + static_cast<size_t>( xStart )] );
+                const unsigned int currInformative = static_cast<unsigned int>(
+                    fullMaskCurrRowPrefix[currPrefBase + static_cast<size_t>( currXEnd )] -
+                    fullMaskCurrRowPrefix[currPrefBase + static_cast<size_t>( currXStart )] );
+
+                if( prevInformative == 0 && currInformative == 0 )
+                {
+                    continue;
+                }
+
+                const BYTE* prevMaskBase = &fullMaskPrev[prevRow + xStart];
+                const BYTE* currMaskBase = &fullMaskCurr[currRow + xStart + dx];
+
+#if defined(PANORAMA_STITCH_SSE2)
+                const __m128i zero = _mm_setzero_si128();
+                int xi = 0;
+                for( ; xi + 16 <= xSpan; xi += 16 )
+                {
+                    const __m128i mPrev = _mm_loadu_si128( reinterpret_cast<const __m128i*>( prevMaskBase + xi ) );
+                    const __m128i mCurr = _mm_loadu_si128( reinterpret_cast<const __m128i*>( currMaskBase + xi ) );
+                    const __m128i mInf = _mm_or_si128( mPrev, mCurr );
+                    const __m128i mActive = _mm_cmpgt_epi8( mInf, zero );
+                    const unsigned int activeBits = static_cast<unsigned int>( _mm_movemask_epi8( mActive ) );
+                    if( activeBits == 0 )
+                    {
+                        continue;
+                    }
+
+                    const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBase + xi ) );
+                    const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( cBase + xi ) );
+                    const __m128i d1 = _mm_subs_epu8( a, b );
+                    const __m128i d2 = _mm_subs_epu8( b, a );
+                    const __m128i absDiff = _mm_or_si128( d1, d2 );
+                    const __m128i maskedDiff = _mm_and_si128( absDiff, mActive );
+                    const __m128i sad = _mm_sad_epu8( maskedDiff, zero );
+
+                    rowDiff += static_cast<uint64_t>( _mm_cvtsi128_si64( sad ) ) +
+                               static_cast<uint64_t>( _mm_cvtsi128_si64( _mm_srli_si128( sad, 8 ) ) );
+                    samples += static_cast<uint64_t>( std::popcount( activeBits ) );
+                }
+
+                for( ; xi < xSpan; ++xi )
+                {
+                    if( prevMaskBase[xi] || currMaskBase[xi] )
+                    {
+                        rowDiff += static_cast<uint64_t>(
+                            abs( static_cast<int>( pBase[xi] ) - static_cast<int>( cBase[xi] ) ) );
+                        samples++;
+                    }
+                }
+#else
+                for( int xi = 0; xi < xSpan; ++xi )
+                {
+                    if( prevMaskBase[xi] || currMaskBase[xi] )
+                    {
+                        rowDiff += static_cast<uint64_t>(
+                            abs( static_cast<int>( pBase[xi] ) - static_cast<int>( cBase[xi] ) ) );
+                        samples++;
+                    }
+                }
+#endif
+                totalDiff += rowDiff;
+            }
+            else
+            {
+
+#if defined(PANORAMA_STITCH_SSE2)
+            __m128i sadAcc = _mm_setzero_si128();
+            int xi = 0;
+            for( ; xi + 16 <= xSpan; xi += 16 )
+            {
+                const __m128i a = _mm_loadu_si128( reinterpret_cast<const __m128i*>( pBase + xi ) );
+                const __m128i b = _mm_loadu_si128( reinterpret_cast<const __m128i*>( cBase + xi ) );
+                sadAcc = _mm_add_epi64( sadAcc, _mm_sad_epu8( a, b ) );
+            }
+
+            rowDiff = static_cast<uint64_t>( _mm_cvtsi128_si64( sadAcc ) ) +
+                      static_cast<uint64_t>( _mm_cvtsi128_si64( _mm_srli_si128( sadAcc, 8 ) ) );
+
+            for( ; xi < xSpan; ++xi )
+            {
+                rowDiff += static_cast<uint64_t>(
+                    abs( static_cast<int>( pBase[xi] ) - static_cast<int>( cBase[xi] ) ) );
+            }
+#elif defined(PANORAMA_STITCH_NEON)
+            uint64x2_t sadAcc = vdupq_n_u64( 0 );
+            int xi = 0;
+            for( ; xi + 16 <= xSpan; xi += 16 )
+            {
+                const uint8x16_t a = vld1q_u8( pBase + xi );
+                const uint8x16_t b = vld1q_u8( cBase + xi );
+                const uint8x16_t absDiff = vabdq_u8( a, b );
+                const uint16x8_t sum16 = vpaddlq_u8( absDiff );
+                const uint32x4_t sum32 = vpaddlq_u16( sum16 );
+                const uint64x2_t sum64 = vpaddlq_u32( sum32 );
+                sadAcc = vaddq_u64( sadAcc, sum64 );
+            }
+
+            rowDiff = vgetq_lane_u64( sadAcc, 0 ) + vgetq_lane_u64( sadAcc, 1 );
+
+            for( ; xi < xSpan; ++xi )
+            {
+                rowDiff += static_cast<uint64_t>(
+                    abs( static_cast<int>( pBase[xi] ) - static_cast<int>( cBase[xi] ) ) );
+            }
+#else
+            for( int xi = 0; xi < xSpan; ++xi )
+            {
+                rowDiff += static_cast<uint64_t>(
+                    abs( static_cast<int>( pBase[xi] ) - static_cast<int>( cBase[xi] ) ) );
+            }
+#endif
+
+            totalDiff += rowDiff;
+            samples += xSpan;
+
+            } // standard luma
+
+            // Early termination using shared best score across threads.
+            // Only activate after 75% of rows to avoid false termination of
+            // the true best candidate whose initial rows may have higher SAD.
+            const uint64_t earlyMinSamples = useFineMask ? 50 : 200;
+            const bool isExpectedStepDy = ( highConstantFractionPair || expectedAbsStep >= frameHeight / 4 ) &&
+                expectedAbsStep > 0 &&
+                abs( abs( dy ) - expectedAbsStep ) <= refineRadiusDy + 4;
+            const uint64_t curBest = sharedBestFine.load( std::memory_order_relaxed );
+            if( !isExpectedStepDy &&
+                curBest != ( std::numeric_limits<uint64_t>::max )() &&
+                y >= overlap * 3 / 4 &&
+                samples >= earlyMinSamples && totalDiff * kFineScoreScale >= (curBest + 1) * samples )
+            {
+                earlyExit = true;
+            }
+        }
+
+        const uint64_t minSamples = useFineMask ? 20 : 100;
+        if( earlyExit || samples < minSamples )
+            return;
+
+        w.score = totalDiff * kFineScoreScale / samples;
+        w.valid = true;
+
+        // Update shared best for cross-thread early termination.
+        uint64_t old = sharedBestFine.load( std::memory_order_relaxed );
+        while( w.score < old )
+        {
+            if( sharedBestFine.compare_exchange_weak( old, w.score, std::memory_order_relaxed ) )
+                break;
+        }
+
+        } // !useZnccFineSearch
+    } );
+
+    // Sequential ranking pass over scored results.
+    for( const auto& w : fineWork )
+    {
+        if( !w.valid )
+            continue;
+
+        const int ci = w.ci;
+        const int dy = w.dy;
+        const int dx = w.dx;
+        const uint64_t score = w.score;
+        const int absStep = abs( dy );
+        const int overlap = frameHeight - absStep;
+
+        // Harmonic-fallback tracking.
+        const uint64_t harmonicPerfectThreshold = useZnccFineSearch ? 64 : 0;
+        if( harmonicFallback && score <= harmonicPerfectThreshold )
+        {
+            if( ci < preHarmonicProbeCount )
+                foundOriginalZero = true;
+            if( absStep < smallestZeroAbsStep )
+            {
+                smallestZeroAbsStep = absStep;
+                smallestZeroDy = dy;
+                smallestZeroDx = dx;
+            }
+        }
+
+        // Skip harmonic-fallback probes that didn't achieve a
+        // perfect pixel match -- only score<=threshold probes can win.
+        // Also skip probes entirely when an original candidate
+        // already found a perfect score.
+        if( harmonicFallback && ci >= preHarmonicProbeCount &&
+            ( score > harmonicPerfectThreshold || foundOriginalZero ) )
+            continue;
+
+        uint64_t rankScore = score;
+        if( expectedAbsStep > 0 && expectedAbsStep >= frameHeight / 4 &&
+            absStep > 4 && absStep < expectedAbsStep * 2 / 3 )
+        {
+            const int ratio = ( expectedAbsStep + absStep / 2 ) / absStep;
+            const int residual = abs( expectedAbsStep - ratio * absStep );
+            if( ratio >= 2 && residual < max( 5, absStep / 3 ) )
+            {
+                rankScore += static_cast<uint64_t>( min( ratio, 6 ) * 2 );
+            }
+        }
+        if( expectedAbsStep > 0 && highConstantFractionPair )
+        {
+            const bool nearExpectedStep = abs( absStep - expectedAbsStep ) <= refineRadiusDy + 4;
+            const int overlapPct = ( overlap * 100 ) / max( 1, frameHeight );
+            if( !nearExpectedStep && overlapPct < 72 )
+            {
+                const uint64_t overlapPenalty =
+                    static_cast<uint64_t>( ( 72 - overlapPct ) * 6 );
+                rankScore = score + overlapPenalty;
+            }
+        }
+        if( expectedAbsStep > 0 && abs( abs( dy ) - expectedAbsStep ) <= 4 )
+        {
+            if( score < scoreAtExpectedStep )
+            {
+                scoreAtExpectedStep = score;
+                dxAtExpectedStep = dx;
+                dyAtExpectedStep = dy;
+            }
+        }
+
+        if( rankScore < bestFineRankScore )
+        {
+            secondBestFineScore = bestFineScore;
+            secondBestFineRankScore = bestFineRankScore;
+            secondBestDx = bestDx;
+            secondBestDy = bestDy;
+            bestFineScore = score;
+            bestFineRankScore = rankScore;
+            bestDx = dx;
+            bestDy = dy;
+            bestAbsStep = abs( dy );
+            bestAbsDx = abs( dx );
+            bestExpectedDelta = ( expectedAbsStep > 0 ) ? abs( bestAbsStep - expectedAbsStep ) : ( std::numeric_limits<int>::max )();
+        }
+        else if( rankScore == bestFineRankScore )
+        {
+            const int absStepLo = abs( dy );
+            const int absDx = abs( dx );
+            const int expectedDelta = ( expectedAbsStep > 0 ) ? abs( absStepLo - expectedAbsStep ) : ( std::numeric_limits<int>::max )();
+
+            if( ( expectedAbsStep > 0 && expectedDelta < bestExpectedDelta ) ||
+                ( expectedAbsStep == 0 && absStepLo < bestAbsStep ) ||
+                ( expectedDelta == bestExpectedDelta &&
+                  ( absStep < bestAbsStep || ( absStepLo == bestAbsStep && absDx < bestAbsDx ) ) ) )
+            {
+                bestDx = dx;
+                bestDy = dy;
+                bestAbsStep = absStepLo;
+                bestAbsDx = absDx;
+                bestExpectedDelta = expectedDelta;
+            }
+        }
+        else if( expectedAbsStep > 0 && bestFineRankScore != ( std::numeric_limits<uint64_t>::max )() )
+        {
+            uint64_t scoreSlack = (std::max)( static_cast<uint64_t>( 2 ), bestFineRankScore / 80 );
+            const int absStepLo = abs( dy );
+            const int absDx = abs( dx );
+            const int expectedDelta = abs( absStepLo - expectedAbsStep );
+            const bool preferExpectedStep = ( highConstantFractionPair || expectedAbsStep >= frameHeight / 4 ) &&
+                expectedAbsStep >= 8;
+
+            if( preferExpectedStep )
+            {
+                scoreSlack = (std::max)( scoreSlack, highConstantFractionPair
+                    ? bestFineRankScore / 12    // 8.3% for HCF
+                    : bestFineRankScore / 30 ); // 3.3% for non-HCF
+            }
+
+            const int requiredExpectedGain = highConstantFractionPair ? 0 : 1;
+            if( rankScore <= bestFineRankScore + scoreSlack && expectedDelta + requiredExpectedGain < bestExpectedDelta )
+            {
+                secondBestFineScore = min( secondBestFineScore, bestFineScore );
+                secondBestFineRankScore = min( secondBestFineRankScore, bestFineRankScore );
+                secondBestDx = bestDx;
+                secondBestDy = bestDy;
+                bestFineScore = score;
+                bestFineRankScore = rankScore;
+                bestDx = dx;
+                bestDy = dy;
+                bestAbsStep = absStepLo;
+                bestAbsDx = absDx;
+                bestExpectedDelta = expectedDelta;
+            }
+        }
+        else if( rankScore < secondBestFineRankScore )
+        {
+            secondBestFineRankScore = rankScore;
+            secondBestFineScore = score;
+            secondBestDx = dx;
+            secondBestDy = dy;
+        }
+    }
+    PERF_STOP( tFineSearch );
+
+    PERF_START( tPostValidation );
+    if( ( highConstantFractionPair || expectedAbsStep >= frameHeight / 4 ) &&
+        bestFineRankScore != ( std::numeric_limits<uint64_t>::max )() &&
+        secondBestFineRankScore != ( std::numeric_limits<uint64_t>::max )() )
+    {
+        const uint64_t ambiguitySlack = (std::max)( static_cast<uint64_t>( 6 ), bestFineRankScore / 16 );
+
+        // Ambiguity-only fallback: when two candidates are effectively tied,
+        // prefer the one materially closer to expected motion. Unlike the
+        // earlier harmonic override, this path only triggers in near-tie
+        // scenarios and therefore avoids forcing a weak expected-step choice
+        // when a clearly better candidate exists.
+        if( expectedAbsStep > 0 && secondBestFineRankScore <= bestFineRankScore + ambiguitySlack )
+        {
+            const int bestDelta = abs( abs( bestDy ) - expectedAbsStep );
+            const int secondDelta = abs( abs( secondBestDy ) - expectedAbsStep );
+
+            // Direction tiebreaker: when both candidates have the same
+            // absolute step distance from expected (e.g. +4 and -4 both
+            // match expectedAbsStep=4), prefer the one whose sign matches
+            // expectedDy.  Without this, the stitcher oscillates between
+            // +dy and -dy on HCF content where forward/backward shifts
+            // score nearly identically.
+            const bool bestMatchesDir = ( expectedDy > 0 && bestDy > 0 ) || ( expectedDy < 0 && bestDy < 0 );
+            const bool secondMatchesDir = ( expectedDy > 0 && secondBestDy > 0 ) || ( expectedDy < 0 && secondBestDy < 0 );
+            const bool directionOverride = bestDelta == secondDelta && !bestMatchesDir && secondMatchesDir;
+
+            if( secondDelta + 2 < bestDelta || directionOverride )
+            {
+                StitchLog( L"[Panorama/Stitch] FindBestFrameShift ambiguity-fallback expected=(%d,%d) best=(%d,%d) second=(%d,%d) bestRank=%llu secondRank=%llu dirOverride=%d\n",
+                             expectedDx,
+                             expectedDy,
+                             bestDx,
+                             bestDy,
+                             secondBestDx,
+                             secondBestDy,
+                             static_cast<unsigned long long>( bestFineRankScore ),
+                             static_cast<unsigned long long>( secondBestFineRankScore ),
+                             directionOverride ? 1 : 0 );
+
+                bestDx = secondBestDx;
+                bestDy = secondBestDy;
+                bestFineScore = secondBestFineScore;
+                bestFineRankScore = secondBestFineRankScore;
+                bestAbsStep = abs( bestDy );
+                bestAbsDx = abs( bestDx );
+                bestExpectedDelta = abs( bestAbsStep - expectedAbsStep );
+            }
+        }
+
+        if( secondBestFineRankScore <= bestFineRankScore + ambiguitySlack )
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift ambiguous expected=(%d,%d) best=(%d,%d) bestRaw=%llu bestRank=%llu second=(%d,%d) secondRaw=%llu secondRank=%llu slack=%llu\n",
+                         expectedDx,
+                         expectedDy,
+                         bestDx,
+                         bestDy,
+                         static_cast<unsigned long long>( bestFineScore ),
+                         static_cast<unsigned long long>( bestFineRankScore ),
+                         secondBestDx,
+                         secondBestDy,
+                         static_cast<unsigned long long>( secondBestFineScore ),
+                         static_cast<unsigned long long>( secondBestFineRankScore ),
+                         static_cast<unsigned long long>( ambiguitySlack ) );
+        }
+    }
+
+    // HCF harmonic-zero override: when the best candidate has score=0 at
+    // a step much smaller than expected, the "perfect" match is almost
+    // certainly spurious -- the constant-fraction region (dark background)
+    // makes any small offset look identical.  Prefer the expected-step
+    // candidate, but only when that candidate also has a plausible score.
+    // A high scoreAtExpectedStep indicates the expected step is wrong
+    // (genuinely small scroll, not a harmonic), so skip the override.
+    // For ZNCC, a "perfect" match scores near 0 but not exactly 0 due
+    // to floating-point rounding.  Use a small threshold instead.
+    const uint64_t kZnccMinPerfect = useZnccFineSearch ? 64 : 0;
+    const uint64_t kExpectedStepMaxScore = useZnccFineSearch ? kZnccScoreBase / 4 : 200;
+    if( highConstantFractionPair && bestFineScore <= kZnccMinPerfect && expectedAbsStep > 0 &&
+        bestAbsStep > 4 && bestAbsStep < expectedAbsStep * 2 / 3 &&
+        scoreAtExpectedStep != ( std::numeric_limits<uint64_t>::max )() &&
+        scoreAtExpectedStep <= kExpectedStepMaxScore )
+    {
+        StitchLog( L"[Panorama/Stitch] FindBestFrameShift hcf-harmonic-zero override: "
+                     L"expected=(%d,%d) harmonic=(%d,%d) score=0 "
+                     L"expectedStep=(%d,%d) expectedScore=%llu\n",
+                     expectedDx, expectedDy, bestDx, bestDy,
+                     dxAtExpectedStep, dyAtExpectedStep,
+                     static_cast<unsigned long long>( scoreAtExpectedStep ) );
+        bestDx = dxAtExpectedStep;
+        bestDy = dyAtExpectedStep;
+        bestFineScore = scoreAtExpectedStep;
+        bestFineRankScore = scoreAtExpectedStep;
+        bestAbsStep = abs( bestDy );
+        bestAbsDx = abs( bestDx );
+        bestExpectedDelta = abs( bestAbsStep - expectedAbsStep );
+    }
+
+    // Harmonic-fallback override: if the original candidates all had
+    // fineScore > 0 but a newly-injected probe found fineScore == 0,
+    // the correct pixel-aligned shift was missing from the original list.
+    // Override with the smallest-|dy| zero-score probe (most overlap,
+    // least risk of truncation artefact).
+    if( harmonicFallback && !foundOriginalZero && smallestZeroAbsStep != ( std::numeric_limits<int>::max )() )
+    {
+        StitchLog( L"[Panorama/Stitch] FindBestFrameShift harmonic-fallback override: expected=(%d,%d) old=(%d,%d) oldScore=%llu new=(%d,%d)\n",
+                     expectedDx, expectedDy, bestDx, bestDy,
+                     static_cast<unsigned long long>( bestFineScore ),
+                     smallestZeroDx, smallestZeroDy );
+        bestDx = smallestZeroDx;
+        bestDy = smallestZeroDy;
+        bestFineScore = 0;
+        bestFineRankScore = 0;
+        bestAbsStep = smallestZeroAbsStep;
+        bestAbsDx = abs( smallestZeroDx );
+        bestExpectedDelta = ( expectedAbsStep > 0 ) ? abs( bestAbsStep - expectedAbsStep ) : ( std::numeric_limits<int>::max )();
+    }
+
+    // Conservative fast-pass fallback: if ranking confidence is weak,
+    // rerun once with exhaustive probe budget to preserve quality.
+    if( useFastProbePass )
+    {
+        const bool noFineWinner = ( bestFineScore == ( std::numeric_limits<uint64_t>::max )() );
+        bool ambiguousWinner = false;
+        const bool allowAmbiguityRerun = expectedAbsStep > 0 && !highConstantFractionPair;
+        if( !noFineWinner &&
+            secondBestFineRankScore != ( std::numeric_limits<uint64_t>::max )() )
+        {
+            const uint64_t ambiguitySlack =
+                ( std::max )( static_cast<uint64_t>( 8 ), bestFineRankScore / 16 );
+            ambiguousWinner = allowAmbiguityRerun &&
+                ( secondBestFineRankScore <= bestFineRankScore + ambiguitySlack );
+        }
+
+        bool farFromExpected = false;
+        if( expectedAbsStep > 0 && !noFineWinner )
+        {
+            const int expectedDeltaTolerance = max( refineRadiusDy + 8, expectedAbsStep / 2 );
+            const uint64_t uncertainScoreFloor = useZnccFineSearch
+                ? static_cast<uint64_t>( kZnccScoreBase / 3 )
+                : static_cast<uint64_t>( 20 * kFineScoreScale );
+            farFromExpected =
+                bestExpectedDelta > expectedDeltaTolerance &&
+                bestFineScore > uncertainScoreFloor;
+        }
+
+        if( noFineWinner || ambiguousWinner || farFromExpected )
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift fast-pass rerun: "
+                         L"reason=noFine:%d ambiguous:%d farExpected:%d budget=%d\n",
+                         noFineWinner ? 1 : 0,
+                         ambiguousWinner ? 1 : 0,
+                         farFromExpected ? 1 : 0,
+                         probeCandidateBudget );
+
+            PERF_STOP( tPostValidation );
+            PERF_STOP( tTotal );
+            return FindBestFrameShiftVerticalOnly( previousPixels,
+                                                   currentPixels,
+                                                   frameWidth,
+                                                   frameHeight,
+                                                   expectedDx,
+                                                   expectedDy,
+                                                   bestDx,
+                                                   bestDy,
+                                                   lowContrastMode,
+                                                   precomputedPrevLuma,
+                                                   precomputedCurrLuma,
+                                                   precomputedVeryLowEntropy,
+                                                   outNearStationaryOverride,
+                                                   allowHighConstStationaryRelax,
+                                                   outMaskedStationaryScore,
+                                                   true,
+                                                   forceExhaustiveFineDx );
+        }
+    }
+
+    // Cross-validate shift vs stationary score.  The stationary score measures
+    // how different the frames look at zero offset.  A large scroll means most
+    // of the content is new, so stationaryScore should be proportionally high.
+    // If stationaryScore is low but the detected shift is large AND the fine
+    // score is not a perfect match (fineScore > 0), the match is likely
+    // spurious -- caused by repeating content patterns (e.g. social media
+    // handles, list layouts) that correlate at a wrong offset.  A perfect
+    // fine score (fineScore == 0) indicates the pixel-level alignment is
+    // genuine even when the stationary score is low.
+    //
+    // Exception: when the scroll direction has already been established and
+    // the detected shift is in the same direction, skip this check.  Content
+    // like code with a dark theme has inherently low stationary scores (~8-12)
+    // even for genuine large scrolls because most pixels are uniform
+    // background.  The fine-score threshold below still rejects poor matches.
+    const int detectedStep = abs( bestDx ) + abs( bestDy );
+    const bool directionEstablished = ( expectedDx != 0 || expectedDy != 0 );
+    const bool shiftMatchesDirection =
+        directionEstablished &&
+        ( ( expectedDy < 0 && bestDy < 0 ) || ( expectedDy > 0 && bestDy > 0 ) ||
+          ( expectedDx < 0 && bestDx < 0 ) || ( expectedDx > 0 && bestDx > 0 ) );
+
+    // Cross-validate shift vs stationary score.  For very-low-entropy
+    // pairs or masked-fallback pairs, use the masked stationary score
+    // (which only considers content pixels) since the raw score is
+    // inherently near-zero.
+    const uint64_t crossValidStationaryUsed = ( useFineMask || useMaskedFallback ) ? maskedStationaryScore : stationaryScore;
+    const uint64_t crossValidationStationaryThreshold = lowContrastMode ? 18 : 15;
+    if( !shiftMatchesDirection && crossValidStationaryUsed < crossValidationStationaryThreshold && detectedStep > frameHeight / 3 && bestFineScore > 0 )
+    {
+        StitchLog( L"[Panorama/Stitch] FindBestFrameShift shift-stationary-mismatch expected=(%d,%d) best=(%d,%d) step=%d fineScore=%llu stationary=%llu maskedStat=%llu veryLowEntropy=%d\n",
+                     expectedDx, expectedDy, bestDx, bestDy,
+                     detectedStep,
+                     static_cast<unsigned long long>( bestFineScore ),
+                     static_cast<unsigned long long>( stationaryScore ),
+                     static_cast<unsigned long long>( maskedStationaryScore ),
+                     veryLowEntropyPair ? 1 : 0 );
+        PERF_STOP( tPostValidation ); PERF_STOP( tTotal );
+        return false;
+    }
+
+    // Near-stationary flag: when the fine score per-pixel is no better
+    // than the stationary score, the "best" match is unreliable -- likely
+    // a harmonic on periodic content.  Signal this to the stitch loop
+    // via the outNearStationaryOverride flag so it can clamp the step
+    // to a conservative minimum while preserving expectedDy for the
+    // next frame's search (avoiding cascade from corrupted expected step).
+    //
+    // Skip this check on masked/HCF content where the scores are on
+    // different scales.
+    if( bestFineScore > 0 && !useFineMask && !useMaskedFallback && !highConstantFractionPair )
+    {
+        const uint64_t finePerPixel = bestFineScore / kFineScoreScale;
+        if( finePerPixel >= stationaryScore && stationaryScore < crossValidationStationaryThreshold )
+        {
+            if( outNearStationaryOverride )
+            {
+                *outNearStationaryOverride = true;
+            }
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift near-stationary-flag expected=(%d,%d) best=(%d,%d) fineScore=%llu finePerPixel=%llu stationary=%llu\n",
+                         expectedDx, expectedDy, bestDx, bestDy,
+                         static_cast<unsigned long long>( bestFineScore ),
+                         static_cast<unsigned long long>( finePerPixel ),
+                         static_cast<unsigned long long>( stationaryScore ) );
+        }
+    }
+
+    // Downward-spike guard: when the expected step is established and
+    // the detected step is dramatically smaller (< 2/3), the match is
+    // likely a harmonic sub-multiple on periodic content.  Only reject
+    // when the fine score is also mediocre -- a genuine scroll slow-down
+    // would produce a clean (low) fine score.
+    //
+    // Before rejecting outright, try falling back to the expected-step
+    // candidate.  On HCF periodic content the harmonic wins the fine
+    // search, but the expected step may still have a usable score.
+    // Let the normal fineThreshold check validate it downstream.
+    if( directionEstablished && expectedAbsStep > frameHeight / 8 &&
+        bestAbsStep > 0 && bestAbsStep < expectedAbsStep * 2 / 3 &&
+        bestFineScore > 8 * kFineScoreScale )
+    {
+        if( scoreAtExpectedStep != ( std::numeric_limits<uint64_t>::max )() )
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift downward-spike-fallback expected=(%d,%d) harmonic=(%d,%d) harmonicScore=%llu expectedStep=(%d,%d) expectedScore=%llu\n",
+                         expectedDx, expectedDy, bestDx, bestDy,
+                         static_cast<unsigned long long>( bestFineScore ),
+                         dxAtExpectedStep, dyAtExpectedStep,
+                         static_cast<unsigned long long>( scoreAtExpectedStep ) );
+            bestDx = dxAtExpectedStep;
+            bestDy = dyAtExpectedStep;
+            bestFineScore = scoreAtExpectedStep;
+            bestFineRankScore = scoreAtExpectedStep;
+            bestAbsStep = abs( bestDy );
+            bestAbsDx = abs( bestDx );
+            bestExpectedDelta = abs( bestAbsStep - expectedAbsStep );
+        }
+        else
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift downward-spike expected=(%d,%d) best=(%d,%d) bestStep=%d expectedStep=%d fineScore=%llu\n",
+                         expectedDx, expectedDy, bestDx, bestDy,
+                         bestAbsStep, expectedAbsStep,
+                         static_cast<unsigned long long>( bestFineScore ) );
+            PERF_STOP( tPostValidation ); PERF_STOP( tTotal );
+            return false;
+        }
+    }
+
+    // Adaptive fine threshold.  For masked scoring (very-low-entropy or
+    // masked fallback) the fine score is on a different scale (higher,
+    // because only content pixels contribute) so use a more generous
+    // threshold.
+    uint64_t fineThreshold;
+    if( useZnccFineSearch )
+    {
+        // ZNCC scores: kZnccScoreBase / 4 = 3200 corresponds to ZNCC >= 0.75.
+        fineThreshold = kZnccScoreBase / 4;
+
+        const int relaxDeltaTolerance = max( refineRadiusDy, 8 );
+        if( expectedAbsStep > 0 &&
+            bestExpectedDelta <= relaxDeltaTolerance &&
+            bestFineScore != ( std::numeric_limits<uint64_t>::max )() )
+        {
+            // Relax to ZNCC >= 0.60 for candidates near expected step.
+            fineThreshold = ( std::max )( fineThreshold, kZnccScoreBase * 2 / 5 );
+        }
+    }
+    else if( useFineMask )
+    {
+        fineThreshold = ( maskedStationaryScore > 15 ) ? 30 * kFineScoreScale : 20 * kFineScoreScale;
+    }
+    else
+    {
+        // For highConstantFractionPair, the raw stationaryScore is diluted by
+        // the large fraction of background pixels, often landing at or below 15
+        // even when the frame actually moved.  The maskedStationaryScore focuses
+        // on informative pixels and better reflects whether the frame changed.
+        // Use the higher of the two when deciding the threshold band.
+        const uint64_t fineStationaryScore =
+            highConstantFractionPair
+                ? ( std::max )( stationaryScore, maskedStationaryScore )
+                : stationaryScore;
+        fineThreshold = ( fineStationaryScore > 15 )
+            ? ( lowContrastMode ? 24 * kFineScoreScale : 30 * kFineScoreScale )
+            : ( lowContrastMode ? 12 * kFineScoreScale : 15 * kFineScoreScale );
+
+        // On sparse/high-constant-fraction content the fine search can
+        // produce legitimate correct-shift scores moderately above the base
+        // threshold because only a handful of pixels differ between frames.
+        // When the best found candidate is already near the expected step
+        // (within a generous tolerance), relax the threshold to accept it
+        // rather than dropping the frame entirely.  Use a fixed tolerance of
+        // 8px or the refine radius, whichever is larger, so that small-window
+        // captures (downsampleScale=2, refineRad=3) are handled correctly.
+        const int relaxDeltaTolerance = max( refineRadiusDy, 8 );
+        if( highConstantFractionPair && expectedAbsStep > 0 &&
+            bestExpectedDelta <= relaxDeltaTolerance &&
+            bestFineScore != ( std::numeric_limits<uint64_t>::max )() )
+        {
+            fineThreshold = ( std::max )( fineThreshold, static_cast<uint64_t>( 40 * kFineScoreScale ) );
+        }
+    }
+
+    if( bestFineScore == ( std::numeric_limits<uint64_t>::max )() || bestFineScore > fineThreshold )
+    {
+        if( useFastFineDxPass )
+        {
+            StitchLog( L"[Panorama/Stitch] FineSearch dx-fast-pass rerun expected=(%d,%d) best=(%d,%d) fineScore=%llu fineThreshold=%llu\n",
+                         expectedDx,
+                         expectedDy,
+                         bestDx,
+                         bestDy,
+                         static_cast<unsigned long long>( bestFineScore ),
+                         static_cast<unsigned long long>( fineThreshold ) );
+
+            PERF_STOP( tPostValidation );
+            PERF_STOP( tTotal );
+            return FindBestFrameShiftVerticalOnly( previousPixels,
+                                                   currentPixels,
+                                                   frameWidth,
+                                                   frameHeight,
+                                                   expectedDx,
+                                                   expectedDy,
+                                                   bestDx,
+                                                   bestDy,
+                                                   lowContrastMode,
+                                                   precomputedPrevLuma,
+                                                   precomputedCurrLuma,
+                                                   precomputedVeryLowEntropy,
+                                                   outNearStationaryOverride,
+                                                   allowHighConstStationaryRelax,
+                                                   outMaskedStationaryScore,
+                                                   forceExhaustiveProbeBudget,
+                                                   true );
+        }
+
+        if( skipProbeExpansion && !forceExhaustiveProbeBudget )
+        {
+            StitchLog( L"[Panorama/Stitch] ProbeInject bypass fallback rerun expected=(%d,%d) best=(%d,%d) fineScore=%llu fineThreshold=%llu\n",
+                         expectedDx,
+                         expectedDy,
+                         bestDx,
+                         bestDy,
+                         static_cast<unsigned long long>( bestFineScore ),
+                         static_cast<unsigned long long>( fineThreshold ) );
+
+            PERF_STOP( tPostValidation );
+            PERF_STOP( tTotal );
+            return FindBestFrameShiftVerticalOnly( previousPixels,
+                                                   currentPixels,
+                                                   frameWidth,
+                                                   frameHeight,
+                                                   expectedDx,
+                                                   expectedDy,
+                                                   bestDx,
+                                                   bestDy,
+                                                   lowContrastMode,
+                                                   precomputedPrevLuma,
+                                                   precomputedCurrLuma,
+                                                   precomputedVeryLowEntropy,
+                                                   outNearStationaryOverride,
+                                                   allowHighConstStationaryRelax,
+                                                   outMaskedStationaryScore,
+                                                   true,
+                                                   true );
+        }
+
+        StitchLog( L"[Panorama/Stitch] FindBestFrameShift poor-fine expected=(%d,%d) best=(%d,%d) fineScore=%llu fineThreshold=%llu stationary=%llu maskedStat=%llu veryLowEntropy=%d expectedStepScore=%llu dyAtExpectedStep=%d highConstFrac=%d bestExpDelta=%d refineRad=%d\n",
+                     expectedDx, expectedDy, bestDx, bestDy,
+                     static_cast<unsigned long long>( bestFineScore ),
+                     static_cast<unsigned long long>( fineThreshold ),
+                     static_cast<unsigned long long>( stationaryScore ),
+                     static_cast<unsigned long long>( maskedStationaryScore ),
+                     veryLowEntropyPair ? 1 : 0,
+                     static_cast<unsigned long long>( scoreAtExpectedStep ),
+                     dyAtExpectedStep,
+                     highConstantFractionPair ? 1 : 0,
+                     bestExpectedDelta,
+                     refineRadiusDy );
+        PERF_STOP( tPostValidation ); PERF_STOP( tTotal );
+        return false;
+    }
+
+    StitchLog( L"[Panorama/Stitch] FindBestFrameShift expected=(%d,%d) best=(%d,%d) coarseScore=%llu fineScore=%llu stationary=%llu maskedStat=%llu veryLowEntropy=%d window=[%d,%d] expectedStepScore=%llu dyAtExpectedStep=%d highConstFrac=%d accepted=1\n",
+                 expectedDx, expectedDy, bestDx, bestDy,
+                 static_cast<unsigned long long>( bestCoarseScore ),
+                 static_cast<unsigned long long>( bestFineScore ),
+                 static_cast<unsigned long long>( stationaryScore ),
+                 static_cast<unsigned long long>( maskedStationaryScore ),
+                 veryLowEntropyPair ? 1 : 0,
+                 searchMinDy * downsampleScale,
+                 searchMaxDy * downsampleScale,
+                 static_cast<unsigned long long>( scoreAtExpectedStep ),
+                 dyAtExpectedStep,
+                 highConstantFractionPair ? 1 : 0 );
+    // Clamp cross-axis shift to zero.  The fine search evaluates dx=+/-1
+    // for better score discrimination (ClearType subpixel effects), but
+    // screen captures scroll perfectly along one axis -- there is never
+    // real cross-axis motion.  Allowing dx!=0 would accumulate drift.
+    bestDx = 0;
+
+    if( outMaskedStationaryScore )
+        *outMaskedStationaryScore = maskedStationaryScore;
+    PERF_STOP( tPostValidation ); PERF_STOP( tTotal );
+    return true;
+}
+
+bool FindBestFrameShift( const std::vector<BYTE>& previousPixels,
+                         const std::vector<BYTE>& currentPixels,
+                         int frameWidth,
+                         int frameHeight,
+                         int expectedDx,
+                         int expectedDy,
+                         int& bestDx,
+                         int& bestDy,
+                         bool lowContrastMode,
+                         const std::vector<BYTE>& precomputedPrevLuma,
+                         const std::vector<BYTE>& precomputedCurrLuma,
+                         int precomputedVeryLowEntropy,
+                         bool* outNearStationaryOverride,
+                         bool allowHighConstStationaryRelax,
+                         uint64_t* outMaskedStationaryScore )
+{
+    const bool axisEstablished = ( expectedDx != 0 || expectedDy != 0 );
+    const bool preferVerticalAxis = !axisEstablished || ( abs( expectedDy ) >= abs( expectedDx ) );
+
+    // -- Once the scroll axis is established, only search along that axis.
+    // Never fall back to the cross-axis -- a perpendicular match is always
+    // spurious (screen captures scroll perfectly along one axis).  If the
+    // preferred axis fails, reject the frame; the caller will advance to
+    // the next frame.
+    if( axisEstablished )
+    {
+        if( preferVerticalAxis )
+        {
+            int directDx = 0, directDy = 0;
+            if( FindBestFrameShiftVerticalOnly( previousPixels, currentPixels,
+                                                frameWidth, frameHeight,
+                                                expectedDx, expectedDy,
+                                                directDx, directDy, lowContrastMode,
+                                                precomputedPrevLuma, precomputedCurrLuma,
+                                                precomputedVeryLowEntropy,
+                                                outNearStationaryOverride,
+                                                allowHighConstStationaryRelax,
+                                                outMaskedStationaryScore ) )
+            {
+                bestDx = directDx;
+                bestDy = directDy;
+                return true;
+            }
+            return false;
+        }
+        else
+        {
+            // Prefer horizontal (transposed) axis.
+            std::vector<BYTE> previousTransposed, currentTransposed;
+            if( TransposePixels32( previousPixels, frameWidth, frameHeight, previousTransposed ) &&
+                TransposePixels32( currentPixels, frameWidth, frameHeight, currentTransposed ) )
+            {
+                int tDx = 0, tDy = 0;
+                if( FindBestFrameShiftVerticalOnly( previousTransposed, currentTransposed,
+                                                    frameHeight, frameWidth,
+                                                    expectedDy, expectedDx,
+                                                    tDx, tDy, lowContrastMode,
+                                                    {}, {},
+                                                    precomputedVeryLowEntropy,
+                                                    outNearStationaryOverride,
+                                                    allowHighConstStationaryRelax,
+                                                    outMaskedStationaryScore ) )
+                {
+                    bestDx = tDy;
+                    bestDy = tDx;
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    // First frame pair: axis unknown run both searches and pick best.
+    int directDx = 0;
+    int directDy = 0;
+    const bool directOk = FindBestFrameShiftVerticalOnly( previousPixels,
+                                                          currentPixels,
+                                                          frameWidth,
+                                                          frameHeight,
+                                                          expectedDx,
+                                                          expectedDy,
+                                                          directDx,
+                                                          directDy,
+                                                          lowContrastMode,
+                                                          precomputedPrevLuma,
+                                                          precomputedCurrLuma,
+                                                          precomputedVeryLowEntropy,
+                                                          outNearStationaryOverride,
+                                                          allowHighConstStationaryRelax,
+                                                          outMaskedStationaryScore );
+
+    std::vector<BYTE> previousTransposed;
+    std::vector<BYTE> currentTransposed;
+    const bool transposedReady =
+        TransposePixels32( previousPixels, frameWidth, frameHeight, previousTransposed ) &&
+        TransposePixels32( currentPixels, frameWidth, frameHeight, currentTransposed );
+
+    int transposedDx = 0;
+    int transposedDy = 0;
+    bool transposedOk = false;
+    if( transposedReady )
+    {
+        transposedOk = FindBestFrameShiftVerticalOnly( previousTransposed,
+                                                       currentTransposed,
+                                                       frameHeight,
+                                                       frameWidth,
+                                                       expectedDy,
+                                                       expectedDx,
+                                                       transposedDx,
+                                                       transposedDy,
+                                                       lowContrastMode,
+                                                       {}, {},
+                                                       precomputedVeryLowEntropy,
+                                                       outNearStationaryOverride,
+                                                       allowHighConstStationaryRelax,
+                                                       outMaskedStationaryScore );
+    }
+
+    if( !directOk && !transposedOk )
+    {
+        return false;
+    }
+
+    int mappedDx = transposedDy;
+    int mappedDy = transposedDx;
+
+    // When only one direction succeeds for the initial axis detection,
+    // verify the frames differ enough for reliable direction detection.
+    // On near-identical frames (stationaryScore ≈ 0), both searches
+    // produce noise-level fine scores.  Content autocorrelation can make
+    // the wrong direction score lower than the correct one (e.g. text
+    // lines cause high vertical autocorrelation SAD but lower horizontal
+    // SAD), allowing the wrong axis to lock in permanently.
+    // Guard: compute a quick full-frame luma difference.  If frames are
+    // too similar, reject the pair so the stitch retries with a later
+    // frame that has more distinctive scroll movement.
+    if( directOk != transposedOk &&
+        !precomputedPrevLuma.empty() && !precomputedCurrLuma.empty() )
+    {
+        uint64_t totalDiff = 0;
+        uint64_t samples = 0;
+        const size_t lumaSize = precomputedPrevLuma.size();
+        for( size_t i = 0; i < lumaSize; i += 4 )
+        {
+            totalDiff += static_cast<uint64_t>(
+                abs( static_cast<int>( precomputedPrevLuma[i] ) -
+                     static_cast<int>( precomputedCurrLuma[i] ) ) );
+            samples++;
+        }
+        if( samples > 0 && totalDiff / samples <= 2 )
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift axis-detection deferred: "
+                       L"frames too similar (lumaDiff=%llu/%llu=%llu) directOk=%d transposedOk=%d\n",
+                       static_cast<unsigned long long>( totalDiff ),
+                       static_cast<unsigned long long>( samples ),
+                       static_cast<unsigned long long>( totalDiff / samples ),
+                       directOk ? 1 : 0, transposedOk ? 1 : 0 );
+            return false;
+        }
+    }
+
+    if( directOk && !transposedOk )
+    {
+        // When only one direction succeeds on the first pair, the result
+        // might be spurious autocorrelation rather than true scroll.
+        // Fall through to the axis scan to validate the direction.
+    }
+    else if( transposedOk && !directOk )
+    {
+        // On portrait portals (height >= 2*width), a transposed-only
+        // success is likely spurious horizontal autocorrelation from
+        // text/code line structure.  Small initial shifts can cause the
+        // direct (vertical) fine score to barely exceed the threshold
+        // while the transposed search passes.  Defer axis detection to
+        // a frame pair with more distinctive scroll movement.
+        if( frameHeight >= frameWidth * 2 )
+        {
+            StitchLog( L"[Panorama/Stitch] FindBestFrameShift portrait-portal transposed-only deferred: "
+                       L"mapped=(%d,%d) frame=%dx%d\n",
+                       mappedDx, mappedDy, frameWidth, frameHeight );
+            return false;
+        }
+        // Otherwise fall through to the axis scan to validate the direction.
+    }
+
+    // Both searches succeeded.  Startup axis choice is critical because a
+    // wrong first lock permanently routes subsequent matching down the wrong
+    // axis.  Pay the extra cost here and run the dedicated axis scan even on
+    // non-VLE content rather than trusting the first direct ZNCC winner.
+
+    // Axis detection: scan pure-vertical and pure-horizontal shifts in a
+    // range to find which direction has a true alignment minimum.  This is
+    // far more robust than scoring two potentially-spurious ZNCC peaks,
+    // especially on mostly-constant content where ZNCC produces noise peaks.
+    //
+    // Optimization: use precomputed luma arrays (already available from the
+    // caller) and build a gradient mask once, rather than recomputing
+    // RGB->luma and gradient per pixel in each of the ~200 calls.
+    constexpr int kAxisScanRange = 50;
+    constexpr int kAxisMargin = 4;
+    constexpr int kAxisStep = 2;
+
+    // Reference or build full-resolution luma for both frames.
+    std::vector<BYTE> prevLumaOwned, currLumaOwned;
+    const BYTE* prevLuma;
+    const BYTE* currLuma;
+    if( !precomputedPrevLuma.empty() && !precomputedCurrLuma.empty() )
+    {
+        prevLuma = precomputedPrevLuma.data();
+        currLuma = precomputedCurrLuma.data();
+    }
+    else
+    {
+        BuildFullLumaFrame( previousPixels, frameWidth, frameHeight, prevLumaOwned );
+        BuildFullLumaFrame( currentPixels, frameWidth, frameHeight, currLumaOwned );
+        prevLuma = prevLumaOwned.data();
+        currLuma = currLumaOwned.data();
+    }
+
+    // Precompute gradient mask for both frames.  A pixel has gradient if
+    // abs(luma - luma_right) + abs(luma - luma_below) >= 4.  Last row and
+    // last column have no gradient.
+    const size_t pixelCount = static_cast<size_t>( frameWidth ) * frameHeight;
+    std::vector<BYTE> gradMask( pixelCount * 2, 0 );
+    BYTE* prevGrad = gradMask.data();
+    BYTE* currGrad = gradMask.data() + pixelCount;
+    for( int y = 0; y < frameHeight - 1; y++ )
+    {
+        const int rowOff = y * frameWidth;
+        for( int x = 0; x < frameWidth - 1; x++ )
+        {
+            const int idx = rowOff + x;
+            const int lp = prevLuma[idx];
+            prevGrad[idx] = ( abs( lp - prevLuma[idx + 1] ) + abs( lp - prevLuma[idx + frameWidth] ) >= 4 ) ? 1 : 0;
+            const int lc = currLuma[idx];
+            currGrad[idx] = ( abs( lc - currLuma[idx + 1] ) + abs( lc - currLuma[idx + frameWidth] ) >= 4 ) ? 1 : 0;
+        }
+    }
+
+    uint64_t bestVertScore = ULLONG_MAX;
+    uint64_t bestHorizScore = ULLONG_MAX;
+    int bestVertDy = 0;
+    int bestHorizDx = 0;
+
+    // Masked SAD of a pure-vertical (dx=0) or pure-horizontal (dy=0) shift,
+    // sampling every step-th row and column.  Returns false if the overlap
+    // is too small.
+    auto scoreAxisShift = [&]( bool vertical, int shift, int step, uint64_t& totalDiff, uint64_t& samples )
+    {
+        const int absShift = abs( shift );
+        const int overlapW = frameWidth - ( vertical ? 0 : absShift ) - 2 * kAxisMargin;
+        const int overlapH = frameHeight - ( vertical ? absShift : 0 ) - 2 * kAxisMargin;
+        if( overlapW < frameWidth / 4 || overlapH < frameHeight / 4 )
+            return false;
+        const int pX0 = kAxisMargin + ( vertical ? 0 : max( 0, -shift ) );
+        const int cX0 = kAxisMargin + ( vertical ? 0 : max( 0, shift ) );
+        const int pY0 = kAxisMargin + ( vertical ? max( 0, -shift ) : 0 );
+        const int cY0 = kAxisMargin + ( vertical ? max( 0, shift ) : 0 );
+        totalDiff = 0;
+        samples = 0;
+        for( int y = 0; y < overlapH; y += step )
+        {
+            const int pRow = ( pY0 + y ) * frameWidth + pX0;
+            const int cRow = ( cY0 + y ) * frameWidth + cX0;
+            for( int x = 0; x < overlapW; x += step )
+            {
+                const int pIdx = pRow + x;
+                const int cIdx = cRow + x;
+                if( !prevGrad[pIdx] && !currGrad[cIdx] )
+                    continue;
+                totalDiff += static_cast<uint64_t>( abs( static_cast<int>( prevLuma[pIdx] ) - static_cast<int>( currLuma[cIdx] ) ) );
+                samples++;
+            }
+        }
+        return true;
+    };
+
+    // Coarse to fine: score every other shift at twice the sampling stride,
+    // then score the shifts around the best few coarse ones at the full
+    // kAxisStep sampling.  The true alignment minimum is steep enough to
+    // survive the coarse level, and this costs about a third of scoring
+    // every shift at full sampling.
+    constexpr int kAxisShortlist = 4;
+    auto scanAxis = [&]( bool vertical, uint64_t& bestScore, int& bestShift )
+    {
+        struct AxisCandidate
+        {
+            int shift;
+            uint64_t score;
+        };
+        AxisCandidate shortlist[kAxisShortlist];
+        int shortlistCount = 0;
+        for( int shift = -kAxisScanRange; shift <= kAxisScanRange; shift += 2 )
+        {
+            uint64_t totalDiff = 0;
+            uint64_t samples = 0;
+            if( shift == 0 || !scoreAxisShift( vertical, shift, kAxisStep * 2, totalDiff, samples ) || samples < 5 )
+                continue;
+            const uint64_t score = totalDiff * 256 / samples;
+            if( shortlistCount < kAxisShortlist || score < shortlist[shortlistCount - 1].score )
+            {
+                int insertPos = shortlistCount < kAxisShortlist ? shortlistCount : shortlistCount - 1;
+                for( ; insertPos > 0 && shortlist[insertPos - 1].score > score; --insertPos )
+                    shortlist[insertPos] = shortlist[insertPos - 1];
+                shortlist[insertPos] = { shift, score };
+                if( shortlistCount < kAxisShortlist )
+                    shortlistCount++;
+            }
+        }
+
+        // Refine in ascending shift order so ties resolve as a full scan would.
+        int refineShifts[kAxisShortlist * 3];
+        int refineCount = 0;
+        for( int i = 0; i < shortlistCount; ++i )
+        {
+            for( int delta = -1; delta <= 1; ++delta )
+                refineShifts[refineCount++] = shortlist[i].shift + delta;
+        }
+        std::sort( refineShifts, refineShifts + refineCount );
+        refineCount = static_cast<int>( std::unique( refineShifts, refineShifts + refineCount ) - refineShifts );
+        for( int i = 0; i < refineCount; ++i )
+        {
+            const int shift = refineShifts[i];
+            uint64_t totalDiff = 0;
+            uint64_t samples = 0;
+            if( shift == 0 || abs( shift ) > kAxisScanRange ||
+                !scoreAxisShift( vertical, shift, kAxisStep, totalDiff, samples ) || samples < 20 )
+                continue;
+            const uint64_t score = totalDiff / samples;
+            if( score < bestScore )
+            {
+                bestScore = score;
+                bestShift = shift;
+            }
+        }
+    };
+    scanAxis( true, bestVertScore, bestVertDy );
+    scanAxis( false, bestHorizScore, bestHorizDx );
+
+    // If ignoring constant regions yields no valid score for one or both
+    // axes, retry without the gradient mask filter.
+    if( bestVertScore == ULLONG_MAX || bestHorizScore == ULLONG_MAX )
+    {
+        for( int dy = -kAxisScanRange; dy <= kAxisScanRange; dy++ )
+        {
+            if( dy == 0 )
+                continue;
+            const int absDy = abs( dy );
+            const int overlapW = frameWidth - 2 * kAxisMargin;
+            const int overlapH = frameHeight - absDy - 2 * kAxisMargin;
+            if( overlapW < frameWidth / 4 || overlapH < frameHeight / 4 )
+                continue;
+            const int pY0 = kAxisMargin + max( 0, -dy );
+            const int cY0 = kAxisMargin + max( 0, dy );
+            uint64_t totalDiff = 0;
+            uint64_t samples = 0;
+            for( int y = 0; y < overlapH; y += kAxisStep )
+            {
+                const int pRow = ( pY0 + y ) * frameWidth;
+                const int cRow = ( cY0 + y ) * frameWidth;
+                for( int x = 0; x < overlapW; x += kAxisStep )
+                {
+                    const int px = kAxisMargin + x;
+                    totalDiff += static_cast<uint64_t>( abs( static_cast<int>( prevLuma[pRow + px] ) - static_cast<int>( currLuma[cRow + px] ) ) );
+                    samples++;
+                }
+            }
+            if( samples >= 100 && bestVertScore == ULLONG_MAX )
+            {
+                const uint64_t score = totalDiff / samples;
+                if( score < bestVertScore )
+                {
+                    bestVertScore = score;
+                    bestVertDy = dy;
+                }
+            }
+        }
+        for( int dx = -kAxisScanRange; dx <= kAxisScanRange; dx++ )
+        {
+            if( dx == 0 )
+                continue;
+            const int absDx = abs( dx );
+            const int overlapW = frameWidth - absDx - 2 * kAxisMargin;
+            const int overlapH = frameHeight - 2 * kAxisMargin;
+            if( overlapW < frameWidth / 4 || overlapH < frameHeight / 4 )
+                continue;
+            const int pX0 = kAxisMargin + max( 0, -dx );
+            const int cX0 = kAxisMargin + max( 0, dx );
+            uint64_t totalDiff = 0;
+            uint64_t samples = 0;
+            for( int y = 0; y < overlapH; y += kAxisStep )
+            {
+                const int rowOff = ( kAxisMargin + y ) * frameWidth;
+                for( int x = 0; x < overlapW; x += kAxisStep )
+                {
+                    totalDiff += static_cast<uint64_t>( abs( static_cast<int>( prevLuma[rowOff + pX0 + x] ) - static_cast<int>( currLuma[rowOff + cX0 + x] ) ) );
+                    samples++;
+                }
+            }
+            if( samples >= 100 && bestHorizScore == ULLONG_MAX )
+            {
+                const uint64_t score = totalDiff / samples;
+                if( score < bestHorizScore )
+                {
+                    bestHorizScore = score;
+                    bestHorizDx = dx;
+                }
+            }
+        }
+    }
+
+    StitchLog( L"[Panorama/Stitch] AxisScan vertBest=%llu dy=%d horizBest=%llu dx=%d\n",
+               static_cast<unsigned long long>( bestVertScore ), bestVertDy,
+               static_cast<unsigned long long>( bestHorizScore ), bestHorizDx );
+
+    bool verticalWins = bestVertScore <= bestHorizScore;
+
+    // Startup default is vertical.  If the horizontal axis only wins by a
+    // small margin, treat the result as ambiguous and keep the default axis.
+    if( bestVertScore != ULLONG_MAX && bestHorizScore != ULLONG_MAX )
+    {
+        const uint64_t horizontalAdvantage =
+            ( bestHorizScore < bestVertScore )
+                ? ( bestVertScore - bestHorizScore )
+                : 0;
+        const uint64_t ambiguityMargin =
+            ( std::max )( static_cast<uint64_t>( 8 ), bestVertScore / 8 );
+        if( horizontalAdvantage <= ambiguityMargin )
+        {
+            if( !verticalWins )
+            {
+                StitchLog( L"[Panorama/Stitch] AxisScan ambiguous startup forcing vertical: vertBest=%llu horizBest=%llu dy=%d dx=%d margin=%llu\n",
+                           static_cast<unsigned long long>( bestVertScore ),
+                           static_cast<unsigned long long>( bestHorizScore ),
+                           bestVertDy,
+                           bestHorizDx,
+                           static_cast<unsigned long long>( ambiguityMargin ) );
+            }
+            verticalWins = true;
+        }
+    }
+
+    // Geometry bias for first-pair VLE axis detection: narrow/tall capture
+    // portals are overwhelmingly used for vertical scroll captures.  On such
+    // strips, horizontal SAD can look deceptively better due to repeated
+    // line/text structure, causing permanent axis mis-lock.
+    const bool portraitPortal = frameHeight >= frameWidth * 2;
+    if( portraitPortal && bestVertScore != ULLONG_MAX )
+    {
+        const uint64_t horizAdvantage =
+            ( bestHorizScore != ULLONG_MAX && bestHorizScore < bestVertScore )
+                ? ( bestVertScore - bestHorizScore )
+                : 0;
+        const uint64_t requiredAdvantage =
+            ( std::max )( static_cast<uint64_t>( 16 ), bestVertScore / 3 );
+        if( horizAdvantage < requiredAdvantage )
+        {
+            if( !verticalWins )
+            {
+                StitchLog( L"[Panorama/Stitch] AxisScan portrait-bias forcing vertical: vertBest=%llu horizBest=%llu dy=%d dx=%d\n",
+                           static_cast<unsigned long long>( bestVertScore ),
+                           static_cast<unsigned long long>( bestHorizScore ),
+                           bestVertDy,
+                           bestHorizDx );
+            }
+            verticalWins = true;
+        }
+    }
+
+    if( verticalWins )
+    {
+        if( directOk )
+        {
+            bestDx = directDx;
+            bestDy = directDy;
+        }
+        else
+        {
+            bestDx = 0;
+            bestDy = bestVertDy;
+        }
+    }
+    else
+    {
+        if( transposedOk )
+        {
+            bestDx = mappedDx;
+            bestDy = mappedDy;
+        }
+        else
+        {
+            bestDx = bestHorizDx;
+            bestDy = 0;
+        }
+    }
+    return true;
+}
+
+
+bool StitchPanoramaPixels( const std::vector<std::vector<BYTE>>& framePixels,
+                           int frameWidth,
+                           int frameHeight,
+                           bool lowContrastMode,
+                           std::function<bool( int )> progressCallback,
+                           std::vector<BYTE>& outStitchedPixels,
+                           int& outStitchedWidth,
+                           int& outStitchedHeight,
+                           size_t* outComposedFrameCount,
+                           std::vector<int>* outComposedAxisSteps,
+                           PanoramaStitchTimings* outTimings )
+{
+    bool cancelled = false;
+    auto reportProgress = [&progressCallback, &cancelled]( int percent )
+    {
+        if( progressCallback )
+        {
+            if( progressCallback( max( 0, min( 100, percent ) ) ) )
+            {
+                cancelled = true;
+            }
+        }
+    };
+    PanoramaStitchTimings timings{};
+    const auto stitchStart = std::chrono::steady_clock::now();
+    auto stageStart = stitchStart;
+    auto endStage = [&stageStart]( double& stageMs )
+    {
+        const auto now = std::chrono::steady_clock::now();
+        stageMs += std::chrono::duration<double, std::milli>( now - stageStart ).count();
+        stageStart = now;
+    };
+
+    if( framePixels.empty() )
+    {
+        StitchLog( L"[Panorama/Stitch] No frames to stitch\n" );
+        return false;
+    }
+
+    if( frameWidth <= 0 || frameHeight <= 0 )
+    {
+        StitchLog( L"[Panorama/Stitch] Invalid frame size %dx%d\n", frameWidth, frameHeight );
+        return false;
+    }
+
+    StitchLog( L"[Panorama/Stitch] Begin stitching frameCount=%zu frame=%dx%d\n",
+                 framePixels.size(),
+                 frameWidth,
+                 frameHeight );
+
+    const size_t frameBytes = static_cast<size_t>( frameWidth ) * static_cast<size_t>( frameHeight ) * 4;
+    for( size_t i = 0; i < framePixels.size(); i++ )
+    {
+        if( framePixels[i].size() != frameBytes )
+        {
+            StitchLog( L"[Panorama/Stitch] Frame %zu size mismatch: %zu bytes expected=%zu\n",
+                         i,
+                         framePixels[i].size(),
+                         frameBytes );
+            return false;
+        }
+    }
+
+    std::vector<std::vector<BYTE>> frameLuma( framePixels.size() );
+    std::vector<double> frameConstantFraction( framePixels.size() );
+
+    parallel_for( 0, static_cast<int>( framePixels.size() ), [&]( int i )
+    {
+        BuildFullLumaFrame( framePixels[i], frameWidth, frameHeight, frameLuma[i] );
+        frameConstantFraction[i] = ComputeConstantContentFraction( framePixels[i], frameWidth, frameHeight );
+    } );
+    endStage( timings.prepareMs );
+
+    std::vector<size_t> composedFrameIndices;
+    std::vector<POINT> composedFrameOrigins;
+    std::vector<POINT> composedFrameSteps;
+    composedFrameIndices.reserve( framePixels.size() );
+    composedFrameOrigins.reserve( framePixels.size() );
+    composedFrameSteps.reserve( framePixels.size() );
+    composedFrameIndices.push_back( 0 );
+    composedFrameOrigins.push_back( { 0, 0 } );
+    composedFrameSteps.push_back( { 0, 0 } );
+
+    const int minFrameDimension = min( frameWidth, frameHeight );
+    const int minProgress = lowContrastMode ? max( 4, minFrameDimension / 40 ) : max( 8, minFrameDimension / 30 );
+    int expectedDx = 0;
+    int expectedDy = 0;
+    int retryEligibilityStep = 0;
+    int retryNormalizationBudget = 0;
+    int nearStationaryCount = 0;
+    int duplicateRetryStreak = 0;
+    int consecutiveNonDupRejectCount = 0;
+    int consecutiveSpikeRejectCount = 0;
+    int consecutiveMomentumCollapseCount = 0;
+
+    int minX = 0;
+    int minY = 0;
+    int maxX = frameWidth;
+    int maxY = frameHeight;
+
+    for( size_t i = 1; i < framePixels.size(); i++ )
+    {
+        reportProgress( 5 + static_cast<int>( i * 85 / framePixels.size() ) );
+        if( cancelled )
+        {
+            StitchLog( L"[Panorama/Stitch] Cancelled during shift computation\n" );
+            return false;
+        }
+
+        // Reject blank/transition frames where virtually all pixels are
+        // identical.  These frames carry no scroll information and will
+        // produce wrong matcher results if accepted.  Real blank frames
+        // have constFrac = 1.000; selftest synthetic frames can reach
+        // ~0.996, so use 0.999 to avoid false rejections.
+        if( frameConstantFraction[i] > 0.999 )
+        {
+            StitchLog( L"[Panorama/Stitch] Frame %zu rejected: blank frame constFrac=%.3f\n",
+                         i, frameConstantFraction[i] );
+            consecutiveNonDupRejectCount++;
+            continue;
+        }
+
+        int dx = expectedDx;
+        int dy = expectedDy;
+        int retryStreakUsed = 0;
+        bool momentumCollapseApplied = false;
+        int momentumCollapseDetectedDx = 0;
+        int momentumCollapseDetectedDy = 0;
+        bool anchorVerifiedShift = false;
+        const int veryLowEntropy = ( frameConstantFraction[composedFrameIndices.back()] > 0.58 && frameConstantFraction[i] > 0.58 ) ? 1 : 0;
+        bool nearStationaryOverride = false;
+        bool foundShift = FindBestFrameShift( framePixels[composedFrameIndices.back()], framePixels[i], frameWidth, frameHeight, expectedDx, expectedDy, dx, dy, lowContrastMode, frameLuma[composedFrameIndices.back()], frameLuma[i], veryLowEntropy, &nearStationaryOverride );
+
+        if( !foundShift )
+        {
+            if( ArePixelFramesNearDuplicate( framePixels[composedFrameIndices.back()],
+                                             framePixels[i],
+                                             frameWidth,
+                                             frameHeight,
+                                             lowContrastMode ) )
+            {
+                duplicateRetryStreak++;
+
+                const int expectedAxisStep = max( abs( expectedDx ), abs( expectedDy ) );
+                int retryExpectedMaxStep = max( 32, frameHeight / 6 + 1 );
+                const double lastConstFrac = frameConstantFraction[composedFrameIndices.back()];
+                const double curConstFrac = frameConstantFraction[i];
+                // In sustained low-detail momentum streaks, strict VLE-only
+                // gating can suppress duplicate recovery and drop multiple
+                // frames. Allow recovery when either frame is near-VLE and
+                // expected motion is strongly established.
+                const bool nearVlePair = ( lastConstFrac > 0.52 ) || ( curConstFrac > 0.52 );
+                const bool sustainedMomentum = expectedAxisStep >= frameHeight / 6 && composedFrameSteps.size() >= 6;
+                if( sustainedMomentum )
+                {
+                    retryExpectedMaxStep = max( retryExpectedMaxStep, frameHeight / 2 );
+                }
+
+                // Bridge the first duplicate miss in sustained low-detail
+                // momentum runs by advancing with the expected shift.  This
+                // prevents one missed match from cascading into multi-frame
+                // duplicate drops against the same reference frame.
+                if( !foundShift && duplicateRetryStreak == 1 && nearVlePair && sustainedMomentum )
+                {
+                    dx = expectedDx;
+                    dy = expectedDy;
+                    foundShift = true;
+                    StitchLog( L"[Panorama/Stitch] Frame %zu duplicate-bridge normalized: expected=(%d,%d) axisStep=%d\n",
+                                 i,
+                                 expectedDx,
+                                 expectedDy,
+                                 expectedAxisStep );
+                }
+
+                const bool retryEligible =
+                    ( veryLowEntropy != 0 || ( nearVlePair && sustainedMomentum ) ) &&
+                    duplicateRetryStreak >= 2 &&
+                    retryEligibilityStep >= minProgress &&
+                    retryEligibilityStep <= retryExpectedMaxStep;
+
+                if( retryEligible )
+                {
+                    int retryDx = expectedDx;
+                    int retryDy = expectedDy;
+                    bool retryNearStationaryOverride = false;
+                    if( FindBestFrameShift( framePixels[composedFrameIndices.back()],
+                                            framePixels[i],
+                                            frameWidth,
+                                            frameHeight,
+                                            expectedDx,
+                                            expectedDy,
+                                            retryDx,
+                                            retryDy,
+                                            lowContrastMode,
+                                            frameLuma[composedFrameIndices.back()],
+                                            frameLuma[i],
+                                            veryLowEntropy,
+                                            &retryNearStationaryOverride,
+                                            true ) )
+                    {
+                        const bool expectedMostlyVertical = abs( expectedDy ) >= abs( expectedDx );
+                        const int retryAxisStep = expectedMostlyVertical ? abs( retryDy ) : abs( retryDx );
+                        const int axisFrame = expectedMostlyVertical ? frameHeight : frameWidth;
+                        int retryHardCap = ( axisFrame * 2 ) / 5;
+                        int retryStepMax = min( retryHardCap,
+                                                expectedAxisStep + max( minProgress * 2, expectedAxisStep ) + 4 );
+
+                        // While normalization budget remains, allow multi-frame
+                        // duplicate retries to span several single-frame steps.
+                        // This preserves legitimate jumpy scrolls that briefly
+                        // enter low-entropy duplicate streaks.
+                        int recentPeakAxisStep = 0;
+                        for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                             si >= 1 && si >= static_cast<int>( composedFrameSteps.size() ) - 10;
+                             --si )
+                        {
+                            const POINT& prevStep = composedFrameSteps[static_cast<size_t>( si )];
+                            const int axis = expectedMostlyVertical ? abs( prevStep.y ) : abs( prevStep.x );
+                            recentPeakAxisStep = max( recentPeakAxisStep, axis );
+                        }
+
+                        const bool jumpyHistory = recentPeakAxisStep >= ( axisFrame * 3 ) / 10;
+                        if( retryNormalizationBudget > 0 && jumpyHistory )
+                        {
+                            retryHardCap = min( axisFrame - minProgress,
+                                                retryHardCap * max( 1, duplicateRetryStreak ) );
+                            retryStepMax = min( retryHardCap,
+                                                expectedAxisStep +
+                                                max( minProgress * 2,
+                                                     expectedAxisStep * ( duplicateRetryStreak + 2 ) ) + 4 );
+                        }
+                        const int retryStepMin = max( 4, expectedAxisStep / 3 );
+                        const int expectedAxisSigned = expectedMostlyVertical ? expectedDy : expectedDx;
+                        const int retryAxisSigned = expectedMostlyVertical ? retryDy : retryDx;
+                        const bool sameDirection = expectedAxisSigned == 0 || retryAxisSigned == 0 ||
+                                                   ( ( expectedAxisSigned < 0 ) == ( retryAxisSigned < 0 ) );
+
+                        if( sameDirection &&
+                            retryAxisStep >= retryStepMin &&
+                            retryAxisStep <= retryStepMax )
+                        {
+                            // When the normalization budget is exhausted, block
+                            // retries whose shift closely matches the expected
+                            // step (harmonic repeat).  These are likely 1-frame
+                            // harmonics rather than genuine multi-frame shifts
+                            // and cause backward jumps in the stitched output.
+                            //
+                            // Exception: allow the retry if the step is
+                            // consistent with the median of recent composed
+                            // steps.  In long HCF duplicate streaks, the
+                            // budget depletes but the retry keeps finding the
+                            // correct per-frame shift -- blocking those loses
+                            // canvas height.
+                            const bool harmonicLike =
+                                abs( retryAxisStep - expectedAxisStep ) < max( 5, expectedAxisStep / 7 );
+                            bool matchesRecentMedian = false;
+                            if( harmonicLike && retryNormalizationBudget <= 0 &&
+                                composedFrameSteps.size() >= 4 )
+                            {
+                                std::vector<int> recentForMedian;
+                                recentForMedian.reserve( 8 );
+                                for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                                     si >= 1 && recentForMedian.size() < 8; --si )
+                                {
+                                    const int v = expectedMostlyVertical
+                                        ? abs( composedFrameSteps[static_cast<size_t>( si )].y )
+                                        : abs( composedFrameSteps[static_cast<size_t>( si )].x );
+                                    if( v > 0 )
+                                        recentForMedian.push_back( v );
+                                }
+                                if( recentForMedian.size() >= 3 )
+                                {
+                                    std::sort( recentForMedian.begin(), recentForMedian.end() );
+                                    const int recentMedian = recentForMedian[recentForMedian.size() / 2];
+                                    matchesRecentMedian =
+                                        abs( retryAxisStep - recentMedian ) < max( 5, recentMedian / 4 );
+                                }
+                            }
+                            const bool budgetBlocked =
+                                retryNormalizationBudget <= 0 && harmonicLike && !matchesRecentMedian;
+
+                            if( !budgetBlocked )
+                            {
+                                dx = retryDx;
+                                dy = retryDy;
+                                nearStationaryOverride = retryNearStationaryOverride;
+                                foundShift = true;
+                                StitchLog( L"[Panorama/Stitch] Frame %zu duplicate-retry accepted: dx=%d dy=%d axisStep=%d expectedAxis=%d streak=%d\n",
+                                             i,
+                                             dx,
+                                             dy,
+                                             retryAxisStep,
+                                             expectedAxisStep,
+                                             duplicateRetryStreak );
+                            }
+                            else
+                            {
+                                StitchLog( L"[Panorama/Stitch] Frame %zu duplicate-retry harmonic-blocked: axisStep=%d expectedAxis=%d budget=%d\n",
+                                             i,
+                                             retryAxisStep,
+                                             expectedAxisStep,
+                                             retryNormalizationBudget );
+                            }
+                        }
+                        else
+                        {
+                            StitchLog( L"[Panorama/Stitch] Frame %zu duplicate-retry rejected: dx=%d dy=%d axisStep=%d expectedAxis=%d range=[%d,%d] sameDir=%d\n",
+                                         i,
+                                         retryDx,
+                                         retryDy,
+                                         retryAxisStep,
+                                         expectedAxisStep,
+                                         retryStepMin,
+                                         retryStepMax,
+                                         sameDirection ? 1 : 0 );
+                        }
+                    }
+                }
+
+                if( !foundShift && expectedDx == 0 && expectedDy == 0 &&
+                    duplicateRetryStreak >= 1 && i >= 1 )
+                {
+                    int negDx = 0, negDy = 0;
+                    int posDx = 0, posDy = 0;
+                    bool negNearStationary = false;
+                    bool posNearStationary = false;
+
+                    const bool negOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                        frameWidth, frameHeight,
+                                                                        0, -minProgress,
+                                                                        negDx, negDy,
+                                                                        lowContrastMode,
+                                                                        frameLuma[i - 1], frameLuma[i],
+                                                                        veryLowEntropy != 0,
+                                                                        &negNearStationary,
+                                                                        true,
+                                                                        nullptr,
+                                                                        true );
+                    const bool posOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                        frameWidth, frameHeight,
+                                                                        0, minProgress,
+                                                                        posDx, posDy,
+                                                                        lowContrastMode,
+                                                                        frameLuma[i - 1], frameLuma[i],
+                                                                        veryLowEntropy != 0,
+                                                                        &posNearStationary,
+                                                                        true,
+                                                                        nullptr,
+                                                                        true );
+
+                    if( negOk || posOk )
+                    {
+                        int bootDx = 0, bootDy = 0;
+                        bool bootNearStationary = false;
+                        if( negOk && ( !posOk || abs( negDy ) >= abs( posDy ) ) )
+                        {
+                            bootDx = negDx;
+                            bootDy = negDy;
+                            bootNearStationary = negNearStationary;
+                        }
+                        else
+                        {
+                            bootDx = posDx;
+                            bootDy = posDy;
+                            bootNearStationary = posNearStationary;
+                        }
+
+                        const int bootStep = abs( bootDx ) + abs( bootDy );
+                        const int bootAxisStep = max( abs( bootDx ), abs( bootDy ) );
+                        const int bootAxisCap = max( 32, frameHeight / 4 );
+                        if( bootStep >= max( 4, minProgress / 2 ) && bootAxisStep <= bootAxisCap )
+                        {
+                            dx = bootDx;
+                            dy = bootDy;
+                            nearStationaryOverride = bootNearStationary;
+                            foundShift = true;
+                            StitchLog( L"[Panorama/Stitch] Frame %zu duplicate-startup-bootstrap accepted: dx=%d dy=%d step=%d streak=%d negOk=%d posOk=%d\n",
+                                         i,
+                                         dx,
+                                         dy,
+                                         bootAxisStep,
+                                         duplicateRetryStreak,
+                                         negOk ? 1 : 0,
+                                         posOk ? 1 : 0 );
+                        }
+                    }
+                }
+
+                if( foundShift )
+                {
+                    retryStreakUsed = duplicateRetryStreak;
+                    duplicateRetryStreak = 0;
+                }
+                else
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: duplicate vs frame %zu\n",
+                                 i,
+                                 composedFrameIndices.back() );
+                    continue;
+                }
+            }
+            else
+            {
+                duplicateRetryStreak = 0;
+                consecutiveNonDupRejectCount++;
+
+                // After several consecutive non-duplicate rejections the
+                // reference frame has drifted too far behind the current
+                // scroll position for FindBestFrameShift to produce an
+                // overlap match.  Recover by matching the adjacent
+                // captured pair (i-1, i) to discover the actual per-frame
+                // step, then extrapolate from the last accepted origin.
+                const bool earlyRecoveryEligible =
+                    ( i - composedFrameIndices.back() ) >= 2 && composedFrameSteps.size() >= 6;
+                const bool lateTailRecoveryEligible =
+                    ( i - composedFrameIndices.back() ) == 1 &&
+                    composedFrameSteps.size() >= 10 &&
+                    max( abs( expectedDx ), abs( expectedDy ) ) >= frameHeight / 4;
+                if( ( consecutiveNonDupRejectCount >= 3 ||
+                      ( consecutiveNonDupRejectCount >= 1 &&
+                        ( earlyRecoveryEligible || lateTailRecoveryEligible ) ) ) &&
+                    i >= 2 )
+                {
+                    int adjDx = 0, adjDy = 0;
+                    bool adjNearStationary = false;
+                    const int adjVLE = ( frameConstantFraction[i - 1] > 0.58 &&
+                                         frameConstantFraction[i] > 0.58 ) ? 1 : 0;
+
+                    bool adjFound = FindBestFrameShift( framePixels[i - 1], framePixels[i],
+                                                        frameWidth, frameHeight,
+                                                        expectedDx, expectedDy,
+                                                        adjDx, adjDy,
+                                                        lowContrastMode,
+                                                        frameLuma[i - 1], frameLuma[i],
+                                                        adjVLE, &adjNearStationary );
+
+                    // Startup bootstrap: when expected shift is still unknown
+                    // (0,0), try directional guesses for the adjacent pair.
+                    // This bypasses first-pair axis-defer loops on VLE captures
+                    // where frame differences are tiny but motion is real.
+                    if( !adjFound && expectedDx == 0 && expectedDy == 0 )
+                    {
+                        int negDx = 0, negDy = 0;
+                        int posDx = 0, posDy = 0;
+                        bool negNearStationary = false;
+                        bool posNearStationary = false;
+
+                        const bool negOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                            frameWidth, frameHeight,
+                                                                            0, -minProgress,
+                                                                            negDx, negDy,
+                                                                            lowContrastMode,
+                                                                            frameLuma[i - 1], frameLuma[i],
+                                                                            adjVLE != 0,
+                                                                            &negNearStationary,
+                                                                            true,
+                                                                            nullptr,
+                                                                            true );
+                        const bool posOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                            frameWidth, frameHeight,
+                                                                            0, minProgress,
+                                                                            posDx, posDy,
+                                                                            lowContrastMode,
+                                                                            frameLuma[i - 1], frameLuma[i],
+                                                                            adjVLE != 0,
+                                                                            &posNearStationary,
+                                                                            true,
+                                                                            nullptr,
+                                                                            true );
+
+                        if( negOk || posOk )
+                        {
+                            if( negOk && ( !posOk || abs( negDy ) >= abs( posDy ) ) )
+                            {
+                                adjDx = negDx;
+                                adjDy = negDy;
+                                adjNearStationary = negNearStationary;
+                            }
+                            else
+                            {
+                                adjDx = posDx;
+                                adjDy = posDy;
+                                adjNearStationary = posNearStationary;
+                            }
+
+                            const int bootAxisStep = max( abs( adjDx ), abs( adjDy ) );
+                            const int bootAxisCap = ( lowContrastMode || adjVLE != 0 ) ?
+                                max( 32, frameHeight / 4 ) :
+                                max( 32, frameHeight / 3 );
+                            if( bootAxisStep >= max( 4, minProgress / 2 ) && bootAxisStep <= bootAxisCap )
+                            {
+                                adjFound = true;
+                                StitchLog( L"[Panorama/Stitch] Startup bootstrap: directional guess selected adj=(%d,%d) negOk=%d posOk=%d\n",
+                                             adjDx,
+                                             adjDy,
+                                             negOk ? 1 : 0,
+                                             posOk ? 1 : 0 );
+                            }
+                            else
+                            {
+                                StitchLog( L"[Panorama/Stitch] Startup bootstrap: directional guess rejected adj=(%d,%d) axisStep=%d cap=%d\n",
+                                             adjDx,
+                                             adjDy,
+                                             bootAxisStep,
+                                             bootAxisCap );
+                            }
+                        }
+                    }
+
+                    // Late-tail fallback: if expected motion is already strong
+                    // and adjacent-pair full matching fails, probe directional
+                    // axis-only matching for (i-1, i). This is intentionally
+                    // narrow to avoid affecting startup behavior.
+                    if( !adjFound && lateTailRecoveryEligible && expectedDy != 0 && abs( expectedDy ) >= abs( expectedDx ) * 2 )
+                    {
+                        int tailDx = 0, tailDy = 0;
+                        bool tailNearStationary = false;
+
+                        bool tailOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                       frameWidth, frameHeight,
+                                                                       0, expectedDy,
+                                                                       tailDx, tailDy,
+                                                                       lowContrastMode,
+                                                                       frameLuma[i - 1], frameLuma[i],
+                                                                       adjVLE != 0,
+                                                                       &tailNearStationary,
+                                                                       true,
+                                                                       nullptr,
+                                                                       true );
+
+                        if( !tailOk )
+                        {
+                            const int signedGuess = ( expectedDy < 0 ) ? -minProgress : minProgress;
+                            tailOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1], framePixels[i],
+                                                                     frameWidth, frameHeight,
+                                                                     0, signedGuess,
+                                                                     tailDx, tailDy,
+                                                                     lowContrastMode,
+                                                                     frameLuma[i - 1], frameLuma[i],
+                                                                     adjVLE != 0,
+                                                                     &tailNearStationary,
+                                                                     true,
+                                                                     nullptr,
+                                                                     true );
+                        }
+
+                        const bool sameDirection = tailOk && ( ( tailDy < 0 ) == ( expectedDy < 0 ) );
+                        const int tailStep = abs( tailDy );
+                        const int minTailStep = max( 4, minProgress / 2 );
+                        const int maxTailStep = min( frameHeight - minProgress,
+                                                     abs( expectedDy ) + max( minProgress * 3, abs( expectedDy ) / 2 ) );
+
+                        if( sameDirection && tailStep >= minTailStep && tailStep <= maxTailStep )
+                        {
+                            adjDx = tailDx;
+                            adjDy = tailDy;
+                            adjNearStationary = tailNearStationary;
+                            adjFound = true;
+                            StitchLog( L"[Panorama/Stitch] Late-tail fallback selected adj=(%d,%d) expected=(%d,%d)\n",
+                                         adjDx,
+                                         adjDy,
+                                         expectedDx,
+                                         expectedDy );
+                        }
+                    }
+
+                    if( adjFound )
+                    {
+                        int perFrameStepX = -adjDx;
+                        int perFrameStepY = -adjDy;
+
+                        // Apply direction clamping consistent with
+                        // the established scroll axis.
+                        if( composedFrameSteps.size() >= 3 )
+                        {
+                            const int stepCap = 3 * minProgress;
+                            int histAbsX = 0, histAbsY = 0;
+                            for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+                            {
+                                histAbsX += min( abs( composedFrameSteps[si].x ), stepCap );
+                                histAbsY += min( abs( composedFrameSteps[si].y ), stepCap );
+                            }
+                            if( histAbsY > histAbsX * 8 )
+                                perFrameStepX = 0;
+                            else if( histAbsX > histAbsY * 8 )
+                                perFrameStepY = 0;
+                        }
+
+                        // Require meaningful progress after clamping
+                        // so we don't re-anchor on near-stationary or
+                        // wrong-axis content.
+                        if( abs( perFrameStepX ) + abs( perFrameStepY ) >= max( 4, minProgress / 2 ) )
+                        {
+                            const int gap = static_cast<int>( i - composedFrameIndices.back() );
+                            // Startup recovery can discover a plausible
+                            // adjacent-pair shift while expected motion is
+                            // still unknown.  Extrapolating that shift across
+                            // multiple dropped frames is high risk in low-
+                            // detail captures and can create large black bands.
+                            // In that uninitialized state, bridge only one
+                            // frame and let subsequent frames refine normally.
+                            const int extrapolationGap =
+                                ( expectedDx == 0 && expectedDy == 0 ) ? 1 : gap;
+
+                            POINT nextOrigin = composedFrameOrigins.back();
+                            nextOrigin.x += perFrameStepX * extrapolationGap;
+                            nextOrigin.y += perFrameStepY * extrapolationGap;
+
+                            composedFrameIndices.push_back( i );
+                            composedFrameOrigins.push_back( nextOrigin );
+                            composedFrameSteps.push_back( { perFrameStepX, perFrameStepY } );
+
+                            expectedDx = adjDx;
+                            expectedDy = adjDy;
+                            retryEligibilityStep = max( abs( adjDx ), abs( adjDy ) );
+                            retryNormalizationBudget = 5;
+                            consecutiveNonDupRejectCount = 0;
+                            consecutiveSpikeRejectCount = 0;
+                            nearStationaryCount = 0;
+
+                            StitchLog( L"[Panorama/Stitch] Frame %zu recovery-accepted: adj=(%d,%d) gap=%d step=(%d,%d) origin=(%d,%d)\n",
+                                         i,
+                                         adjDx,
+                                         adjDy,
+                                         extrapolationGap,
+                                         perFrameStepX,
+                                         perFrameStepY,
+                                         nextOrigin.x,
+                                         nextOrigin.y );
+
+                            minX = min( minX, nextOrigin.x );
+                            minY = min( minY, nextOrigin.y );
+                            maxX = max( maxX, nextOrigin.x + frameWidth );
+                            maxY = max( maxY, nextOrigin.y + frameHeight );
+                            continue;
+                        }
+                    }
+
+                    if( !foundShift && lateTailRecoveryEligible )
+                    {
+                        const bool mostlyVerticalExpected = abs( expectedDy ) >= abs( expectedDx ) * 2;
+                        const int expectedAxisStep = mostlyVerticalExpected ? abs( expectedDy ) : abs( expectedDx );
+                        if( expectedAxisStep >= frameHeight / 4 && composedFrameSteps.size() >= 8 )
+                        {
+                            std::vector<int> recentAxisAbs;
+                            recentAxisAbs.reserve( 8 );
+                            for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                                 si >= 1 && static_cast<int>( recentAxisAbs.size() ) < 8;
+                                 --si )
+                            {
+                                const int av = mostlyVerticalExpected
+                                    ? abs( composedFrameSteps[static_cast<size_t>( si )].y )
+                                    : abs( composedFrameSteps[static_cast<size_t>( si )].x );
+                                if( av > 0 )
+                                    recentAxisAbs.push_back( av );
+                            }
+
+                            if( recentAxisAbs.size() >= 4 )
+                            {
+                                std::sort( recentAxisAbs.begin(), recentAxisAbs.end() );
+                                const int recentMedian = recentAxisAbs[recentAxisAbs.size() / 2];
+                                const bool expectedMatchesHistory =
+                                    abs( expectedAxisStep - recentMedian ) <= max( 24, recentMedian / 3 );
+
+                                if( expectedMatchesHistory )
+                                {
+                                    dx = expectedDx;
+                                    dy = expectedDy;
+                                    foundShift = true;
+                                    StitchLog( L"[Panorama/Stitch] Frame %zu late-tail bridge normalized: expected=(%d,%d) median=%d\n",
+                                                 i,
+                                                 expectedDx,
+                                                 expectedDy,
+                                                 recentMedian );
+                                }
+                            }
+                        }
+                    }
+                }
+
+                if( !foundShift )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: no reliable shift match expected=(%d,%d)\n",
+                                 i,
+                                 expectedDx,
+                                 expectedDy );
+                    continue;
+                }
+            }
+        }
+
+        const size_t lastAcceptedIndex = composedFrameIndices.back();
+        const int acceptedGap = static_cast<int>( i - lastAcceptedIndex );
+        bool hasNextExpectedOverride = false;
+        int overrideNextExpectedDx = 0;
+        int overrideNextExpectedDy = 0;
+        int overrideEligibilityStep = 0;
+
+        if( acceptedGap > 1 )
+        {
+            LogGapBridgeProbeDiagnostics( i,
+                                          lastAcceptedIndex,
+                                          acceptedGap,
+                                          dx,
+                                          dy,
+                                          expectedDx,
+                                          expectedDy,
+                                          frameWidth,
+                                          frameHeight,
+                                          lowContrastMode,
+                                          framePixels,
+                                          frameLuma,
+                                          frameConstantFraction,
+                                          composedFrameSteps );
+
+            const bool expectedMostlyVertical = abs( expectedDy ) >= max( abs( expectedDx ) * 2, minProgress );
+            const bool expectedMostlyHorizontal = abs( expectedDx ) >= max( abs( expectedDy ) * 2, minProgress );
+            if( expectedMostlyVertical || expectedMostlyHorizontal )
+            {
+                int bridgeDx = 0;
+                int bridgeDy = 0;
+                bool bridgeNearStationary = false;
+                const int bridgeVle = ( frameConstantFraction[lastAcceptedIndex] > 0.58 &&
+                                        frameConstantFraction[i] > 0.58 ) ? 1 : 0;
+                const bool bridgeOk = FindBestFrameShiftVerticalOnly( framePixels[lastAcceptedIndex],
+                                                                      framePixels[i],
+                                                                      frameWidth,
+                                                                      frameHeight,
+                                                                      expectedDx * acceptedGap,
+                                                                      expectedDy * acceptedGap,
+                                                                      bridgeDx,
+                                                                      bridgeDy,
+                                                                      lowContrastMode,
+                                                                      frameLuma[lastAcceptedIndex],
+                                                                      frameLuma[i],
+                                                                      bridgeVle,
+                                                                      &bridgeNearStationary,
+                                                                      false,
+                                                                      nullptr,
+                                                                      true,
+                                                                      true );
+
+                int adjacentDx = 0;
+                int adjacentDy = 0;
+                bool adjacentNearStationary = false;
+                const int adjacentVle = ( frameConstantFraction[i - 1] > 0.58 &&
+                                          frameConstantFraction[i] > 0.58 ) ? 1 : 0;
+                const bool adjacentOk = FindBestFrameShiftVerticalOnly( framePixels[i - 1],
+                                                                        framePixels[i],
+                                                                        frameWidth,
+                                                                        frameHeight,
+                                                                        expectedDx,
+                                                                        expectedDy,
+                                                                        adjacentDx,
+                                                                        adjacentDy,
+                                                                        lowContrastMode,
+                                                                        frameLuma[i - 1],
+                                                                        frameLuma[i],
+                                                                        adjacentVle,
+                                                                        &adjacentNearStationary,
+                                                                        false,
+                                                                        nullptr,
+                                                                        true,
+                                                                        true );
+
+                const int expectedAxisSigned = expectedMostlyVertical ? expectedDy : expectedDx;
+                const int acceptedAxisSigned = expectedMostlyVertical ? dy : dx;
+                const int bridgeAxisSigned = expectedMostlyVertical ? bridgeDy : bridgeDx;
+                const int adjacentAxisSigned = expectedMostlyVertical ? adjacentDy : adjacentDx;
+                const int axisFrame = expectedMostlyVertical ? frameHeight : frameWidth;
+                const int expectedAxisAbs = abs( expectedAxisSigned );
+                const int acceptedAxisAbs = abs( acceptedAxisSigned );
+                const int bridgeAxisAbs = abs( bridgeAxisSigned );
+                const int adjacentAxisAbs = abs( adjacentAxisSigned );
+                const int expectedTotalAbs = expectedAxisAbs * acceptedGap;
+                const bool bridgeSameDirection = bridgeOk && bridgeAxisSigned != 0 &&
+                                                ( ( bridgeAxisSigned > 0 ) == ( expectedAxisSigned > 0 ) );
+                const bool adjacentSameDirection = !adjacentOk || adjacentAxisSigned == 0 ||
+                                                  ( ( adjacentAxisSigned > 0 ) == ( expectedAxisSigned > 0 ) );
+                const int bridgeTolerance = max( 12, expectedAxisAbs / 3 );
+                const bool bridgeMatchesExpectedTotal =
+                    bridgeSameDirection &&
+                    bridgeAxisAbs >= max( expectedTotalAbs - bridgeTolerance, expectedTotalAbs * 4 / 5 ) &&
+                    bridgeAxisAbs <= min( axisFrame - minProgress, expectedTotalAbs + max( 24, expectedAxisAbs / 2 ) );
+                const bool acceptedClearlyUnderAdvanced =
+                    acceptedAxisAbs > 0 &&
+                    acceptedAxisAbs <= max( expectedAxisAbs, expectedTotalAbs / 2 );
+                const bool adjacentNearStationaryGap =
+                    adjacentSameDirection &&
+                    adjacentAxisAbs <= max( minProgress / 2, expectedAxisAbs / 4 );
+
+                if( bridgeMatchesExpectedTotal && acceptedClearlyUnderAdvanced && adjacentNearStationaryGap )
+                {
+                    // Don't trust the gap-bridge when any intermediate frame
+                    // is nearly uniform (e.g. an all-dark screen capture).
+                    // The bridge matcher produces harmonic aliases on uniform
+                    // content and the adjacent pair provides no alignment
+                    // signal.  In this case, keep the direct match result.
+                    bool intermediateFrameNearlyUniform = false;
+                    for( size_t skip = lastAcceptedIndex + 1; skip < i; ++skip )
+                    {
+                        // Check both constant fraction AND average pixel brightness.
+                        // A nearly-black frame (avgPixel < 25) with elevated constFrac
+                        // is a blank/dark screen capture that provides no alignment signal.
+                        const double skipConstFrac = frameConstantFraction[skip];
+                        bool skipIsNearlyUniform = skipConstFrac > 0.55;
+                        if( skipIsNearlyUniform )
+                        {
+                            // Verify it's actually a low-content frame by checking
+                            // average pixel brightness. Sample the center of the frame.
+                            const std::vector<BYTE>& skipPx = framePixels[skip];
+                            long long pixSum = 0;
+                            int pixCount = 0;
+                            const int sampleMargin = frameWidth / 6;
+                            for( int sy = frameHeight / 4; sy < frameHeight * 3 / 4; sy += 8 )
+                            {
+                                for( int sx = sampleMargin; sx < frameWidth - sampleMargin; sx += 8 )
+                                {
+                                    const size_t off = static_cast<size_t>( sy ) * static_cast<size_t>( frameWidth ) * 4 +
+                                                       static_cast<size_t>( sx ) * 4;
+                                    pixSum += skipPx[off + 0] + skipPx[off + 1] + skipPx[off + 2];
+                                    ++pixCount;
+                                }
+                            }
+                            const double avgPx = pixCount > 0 ? static_cast<double>( pixSum ) / ( pixCount * 3.0 ) : 128.0;
+                            // Nearly-black or nearly-white uniform frames have no useful structure.
+                            skipIsNearlyUniform = ( avgPx < 65.0 || avgPx > 240.0 );
+
+                            StitchLog( L"[Panorama/Stitch] Frame %zu gap-bridge skip-check: intermediate=%zu constFrac=%.3f avgPx=%.1f uniform=%d\n",
+                                         i,
+                                         skip,
+                                         skipConstFrac,
+                                         avgPx,
+                                         skipIsNearlyUniform ? 1 : 0 );
+                        }
+                        if( skipIsNearlyUniform )
+                        {
+                            intermediateFrameNearlyUniform = true;
+                            break;
+                        }
+                    }
+
+                    if( intermediateFrameNearlyUniform )
+                    {
+                        StitchLog( L"[Panorama/Stitch] Frame %zu gap-bridge-skipped: intermediate frame nearly uniform accepted=(%d,%d) bridge=(%d,%d) gap=%d\n",
+                                     i,
+                                     dx,
+                                     dy,
+                                     bridgeDx,
+                                     bridgeDy,
+                                     acceptedGap );
+                    }
+                    else
+                    {
+                    const int originalDx = dx;
+                    const int originalDy = dy;
+                    dx = bridgeDx;
+                    dy = bridgeDy;
+                    overrideNextExpectedDx = DivideRounded( bridgeDx, acceptedGap );
+                    overrideNextExpectedDy = DivideRounded( bridgeDy, acceptedGap );
+                    overrideEligibilityStep = max( abs( overrideNextExpectedDx ), abs( overrideNextExpectedDy ) );
+                    hasNextExpectedOverride = true;
+                    nearStationaryOverride = false;
+                    StitchLog( L"[Panorama/Stitch] Frame %zu normalized: gap-bridge-total accepted=(%d,%d) bridge=(%d,%d) adjacent=(%d,%d) gap=%d nextExpected=(%d,%d)\n",
+                                 i,
+                                 originalDx,
+                                 originalDy,
+                                 bridgeDx,
+                                 bridgeDy,
+                                 adjacentDx,
+                                 adjacentDy,
+                                 acceptedGap,
+                                 overrideNextExpectedDx,
+                                 overrideNextExpectedDy );
+                    }
+                }
+            }
+        }
+        duplicateRetryStreak = 0;
+        consecutiveNonDupRejectCount = 0;
+
+        const int maxAbsDx = max( 8, frameWidth / 6 );
+        const int maxAbsDy = frameHeight - minProgress;
+        dx = max( -maxAbsDx, min( maxAbsDx, dx ) );
+        dy = max( -maxAbsDy, min( maxAbsDy, dy ) );
+
+        // Distinctive-row anchor verification for high-constant-fraction content.
+        // On dark/uniform frames the matcher picks harmonic aliases because
+        // ~60% of pixels are identical at every offset.  Instead of averaging
+        // over all rows, find a unique high-variance row and search for it
+        // across frames.  A unique row provides an unambiguous MAD minimum
+        // that breaks harmonics.
+        //
+        // We scan the CURRENT frame for distinctive rows (not the reference
+        // frame) because in some cases the reference frame's pixel data may
+        // have constFrac=1.0 (e.g., during gap-bridge transitions).
+        if( composedFrameSteps.size() >= 4 &&
+            ( frameConstantFraction[composedFrameIndices.back()] > 0.45 ||
+              frameConstantFraction[i] > 0.45 ) &&
+            abs( dy ) >= abs( dx ) * 2 &&
+            abs( dy ) > 0 )
+        {
+            const size_t refIdx = composedFrameIndices.back();
+            const std::vector<BYTE>& refPx = framePixels[refIdx];
+            const std::vector<BYTE>& curPx = framePixels[i];
+            const int xMargin = max( 10, frameWidth / 8 );
+            const int sigXStep = max( 1, ( frameWidth - 2 * xMargin ) / 120 );
+
+            // Decide which frame to use as the "source" for finding
+            // distinctive rows.  Prefer the one with lower constFrac
+            // (more varied content), falling back to the current frame.
+            const bool useCurAsSrc = frameConstantFraction[refIdx] > frameConstantFraction[i] + 0.1
+                                  || frameConstantFraction[refIdx] > 0.95;
+            const std::vector<BYTE>& srcPx = useCurAsSrc ? curPx : refPx;
+            const std::vector<BYTE>& tgtPx = useCurAsSrc ? refPx : curPx;
+
+            // Step 1: Collect the top candidate anchor rows by variance.
+            struct AnchorCandidate { int y; double var; };
+            std::vector<AnchorCandidate> candidates;
+            candidates.reserve( 256 );
+            const int varScanStep = 3;
+            const int varXStep = max( 1, ( frameWidth - 2 * xMargin ) / 80 );
+            for( int y = 10; y < frameHeight - 10; y += varScanStep )
+            {
+                double sum = 0, sumSq = 0;
+                int n = 0;
+                for( int x = xMargin; x < frameWidth - xMargin; x += varXStep )
+                {
+                    const size_t off = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4 +
+                                       static_cast<size_t>( x ) * 4;
+                    const double luma = srcPx[off + 2] * 0.299 + srcPx[off + 1] * 0.587 + srcPx[off + 0] * 0.114;
+                    sum += luma;
+                    sumSq += luma * luma;
+                    ++n;
+                }
+                if( n > 0 )
+                {
+                    const double mean = sum / n;
+                    const double var = sumSq / n - mean * mean;
+                    if( var > 500.0 )
+                        candidates.push_back( { y, var } );
+                }
+            }
+
+            // Sort descending by variance so we try the best rows first.
+            std::sort( candidates.begin(), candidates.end(),
+                       []( const AnchorCandidate& a, const AnchorCandidate& b ) { return a.var > b.var; } );
+
+            // Limit to top 20 candidates for performance.
+            if( candidates.size() > 20 )
+                candidates.resize( 20 );
+
+            // Helper: extract a row signature from the reference frame.
+            auto extractSig = [&]( int y, std::vector<int>& sigR, std::vector<int>& sigG, std::vector<int>& sigB )
+            {
+                sigR.clear(); sigG.clear(); sigB.clear();
+                for( int x = xMargin; x < frameWidth - xMargin; x += sigXStep )
+                {
+                    const size_t off = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4 +
+                                       static_cast<size_t>( x ) * 4;
+                    sigB.push_back( srcPx[off + 0] );
+                    sigG.push_back( srcPx[off + 1] );
+                    sigR.push_back( srcPx[off + 2] );
+                }
+            };
+
+            // Helper: compute MAD between two signatures.
+            auto sigMAD = [&]( const std::vector<int>& sigR, const std::vector<int>& sigG,
+                               const std::vector<int>& sigB, const std::vector<BYTE>& px, int y ) -> double
+            {
+                if( y < 0 || y >= frameHeight )
+                    return 9999.0;
+                const int len = static_cast<int>( sigR.size() );
+                double diff = 0;
+                for( int si = 0; si < len; ++si )
+                {
+                    const int x = xMargin + si * sigXStep;
+                    const size_t off = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4 +
+                                       static_cast<size_t>( x ) * 4;
+                    diff += abs( sigB[si] - static_cast<int>( px[off + 0] ) )
+                          + abs( sigG[si] - static_cast<int>( px[off + 1] ) )
+                          + abs( sigR[si] - static_cast<int>( px[off + 2] ) );
+                }
+                return diff / ( len * 3.0 );
+            };
+
+            // Step 2: Find the first candidate row that is UNIQUE within the
+            // reference frame AND matchable in the current frame.
+            int bestAnchorY = -1;
+            double bestAnchorVar = 0;
+            std::vector<int> anchorSigR, anchorSigG, anchorSigB;
+
+            for( const auto& cand : candidates )
+            {
+                extractSig( cand.y, anchorSigR, anchorSigG, anchorSigB );
+
+                // Check for duplicates in the reference frame.
+                bool hasDuplicate = false;
+                for( int checkY = 10; checkY < frameHeight - 10; checkY += varScanStep )
+                {
+                    if( abs( checkY - cand.y ) < 20 )
+                        continue; // Skip nearby rows (same feature).
+                    const double mad = sigMAD( anchorSigR, anchorSigG, anchorSigB, srcPx, checkY );
+                    if( mad < 3.0 )
+                    {
+                        hasDuplicate = true;
+                        break;
+                    }
+                }
+
+                if( hasDuplicate )
+                    continue;
+
+                // Verify the row is actually findable in the current frame.
+                // Use a loose threshold here — the purpose is to exclude rows
+                // that changed entirely between frames (MAD > 50), not to
+                // require pixel-perfect matches.  The final search (step 3)
+                // enforces the tight confidence threshold.
+                // Scan every row (step=1) because pixel-perfect matches can
+                // be missed even at step=3 (e.g., MAD=0 at y=205 but MAD=80
+                // at y=204 and y=207).
+                double bestProbeMAD = 9999.0;
+                for( int probeY = 10; probeY < frameHeight - 10; ++probeY )
+                {
+                    const double mad = sigMAD( anchorSigR, anchorSigG, anchorSigB, tgtPx, probeY );
+                    if( mad < bestProbeMAD )
+                        bestProbeMAD = mad;
+                    if( bestProbeMAD < 1.0 )
+                        break; // Found a near-perfect match, no need to continue.
+                }
+
+                if( bestProbeMAD < 30.0 )
+                {
+                    bestAnchorY = cand.y;
+                    bestAnchorVar = cand.var;
+                    break; // Found a unique, matchable distinctive row.
+                }
+            }
+
+            if( bestAnchorY < 0 )
+            {
+                // Log why no anchor was found — useful for debugging.
+                int totalUnique = 0, totalMatchable = 0;
+                for( const auto& cand : candidates )
+                {
+                    extractSig( cand.y, anchorSigR, anchorSigG, anchorSigB );
+                    bool hasDup = false;
+                    for( int checkY = 10; checkY < frameHeight - 10; checkY += varScanStep )
+                    {
+                        if( abs( checkY - cand.y ) < 20 ) continue;
+                        if( sigMAD( anchorSigR, anchorSigG, anchorSigB, refPx, checkY ) < 3.0 ) { hasDup = true; break; }
+                    }
+                    if( !hasDup )
+                    {
+                        ++totalUnique;
+                        double bestP = 9999.0;
+                        for( int probeY = 10; probeY < frameHeight - 10; ++probeY )
+                        {
+                            const double m = sigMAD( anchorSigR, anchorSigG, anchorSigB, curPx, probeY );
+                            if( m < bestP ) bestP = m;
+                            if( bestP < 1.0 ) break;
+                        }
+                        if( bestP < 30.0 ) ++totalMatchable;
+                    }
+                }
+                StitchLog( L"[Panorama/Stitch] Frame %zu AnchorNoCandidate: totalCandidates=%zu unique=%d matchable=%d refIdx=%zu constFrac=%.2f dy=%d refPxSize=%zu\n",
+                             i, candidates.size(), totalUnique, totalMatchable, refIdx,
+                             frameConstantFraction[refIdx], dy, refPx.size() );
+            }
+
+            if( bestAnchorY >= 0 )
+            {
+                // Step 3: Search the target frame for this unique signature.
+                // When useCurAsSrc, the search finds the offset in refPx, and
+                // we negate it to get the true scroll direction.
+                const int searchRadius = max( abs( dy ) + 20, frameHeight / 2 );
+                // When searching ref→cur (normal): dy is negative, search negative range.
+                // When searching cur→ref (inverted): search positive range (inverted scroll).
+                const int effectiveDy = useCurAsSrc ? -dy : dy;
+                const int searchLo = max( -( frameHeight - 1 ), effectiveDy - searchRadius );
+                const int searchHi = min( frameHeight - 1, effectiveDy + searchRadius );
+
+                double bestMatchMAD = 9999.0;
+                int bestMatchDy = effectiveDy;
+                double secondBestMAD = 9999.0;
+                double matcherAnchorMAD = 9999.0;
+
+                for( int candDy = searchLo; candDy <= searchHi; ++candDy )
+                {
+                    const int targetY = bestAnchorY + candDy;
+                    if( targetY < 0 || targetY >= frameHeight )
+                        continue;
+
+                    const double mad = sigMAD( anchorSigR, anchorSigG, anchorSigB, tgtPx, targetY );
+
+                    if( candDy == effectiveDy )
+                        matcherAnchorMAD = mad;
+
+                    if( mad < bestMatchMAD )
+                    {
+                        // Demote previous best to second-best if not nearby.
+                        if( abs( bestMatchDy - candDy ) > 5 )
+                        {
+                            secondBestMAD = bestMatchMAD;
+                        }
+                        bestMatchMAD = mad;
+                        bestMatchDy = candDy;
+                    }
+                    else if( mad < secondBestMAD && abs( candDy - bestMatchDy ) > 5 )
+                    {
+                        secondBestMAD = mad;
+                    }
+                }
+
+                // Step 4: Override if the anchor found a confident, different answer.
+                // Confident = best match is significantly better than second-best
+                // (i.e., there's a clear unique winner, not multiple harmonics).
+                // For adjacent frames, bestMAD ≈ 0 and secondBestMAD > 50 (trivial).
+                // For gap-bridge frames, bestMAD ≈ 20 and secondBestMAD > 50 (still clear).
+                // Convert anchor result back to actual scroll direction.
+                const int anchorScrollDy = useCurAsSrc ? -bestMatchDy : bestMatchDy;
+
+                const double separation = secondBestMAD - bestMatchMAD;
+                const bool anchorConfident = bestMatchMAD < 30.0 && separation > 5.0;
+                const bool anchorDiffers = anchorScrollDy != dy;
+                const bool anchorSmaller = abs( anchorScrollDy ) < abs( dy );
+                const bool matcherWorse = matcherAnchorMAD > bestMatchMAD + 3.0;
+
+                if( anchorConfident && anchorDiffers && anchorSmaller && matcherWorse )
+                {
+                    const int absMatcher = abs( dy );
+                    const int absAnchor  = abs( anchorScrollDy );
+                    // Don't override to zero — if the anchor thinks the
+                    // frame is stationary but the matcher found a real
+                    // shift, this is almost certainly a content-repeat
+                    // false positive on repetitive/constant content.
+                    // Truly stationary frames are already caught by
+                    // duplicate detection before reaching this point.
+                    const bool largeHarmonicCorrection = absMatcher > 0 && absAnchor > 0 && absAnchor * 2 < absMatcher;
+
+                    // Also correct small same-direction misalignments (off-by-1/2)
+                    // where the anchor's per-row signature matching is more precise
+                    // than the global correlation matcher.  Restricted to same-sign
+                    // shifts to avoid applying sign inversions on ambiguous content.
+                    const bool sameDirection = (dy > 0 && anchorScrollDy > 0) || (dy < 0 && anchorScrollDy < 0);
+                    const bool smallCorrection = sameDirection && (absMatcher - absAnchor) <= 2;
+
+                    StitchLog( L"[Panorama/Stitch] Frame %zu AnchorOverride: matcherDy=%d anchorDy=%d anchorMAD=%.2f matcherMAD=%.2f secondMAD=%.2f sep=%.1f anchorY=%d anchorVar=%.0f constFrac=%.2f inverted=%d largeHarmonic=%d smallCorr=%d\n",
+                                 i, dy, anchorScrollDy, bestMatchMAD, matcherAnchorMAD,
+                                 secondBestMAD, separation,
+                                 bestAnchorY, bestAnchorVar,
+                                 frameConstantFraction[refIdx],
+                                 useCurAsSrc ? 1 : 0,
+                                 largeHarmonicCorrection ? 1 : 0,
+                                 smallCorrection ? 1 : 0 );
+
+                    if( largeHarmonicCorrection || smallCorrection )
+                    {
+                        dy = anchorScrollDy;
+                        dx = 0;
+                    }
+                }
+                else
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu AnchorKept: matcherDy=%d anchorBestDy=%d anchorMAD=%.2f matcherMAD=%.2f secondMAD=%.2f sep=%.1f anchorY=%d anchorVar=%.0f confident=%d differs=%d smaller=%d matcherWorse=%d inverted=%d\n",
+                                 i, dy, anchorScrollDy, bestMatchMAD, matcherAnchorMAD,
+                                 secondBestMAD, separation,
+                                 bestAnchorY, bestAnchorVar,
+                                 anchorConfident ? 1 : 0, anchorDiffers ? 1 : 0, anchorSmaller ? 1 : 0,
+                                 matcherWorse ? 1 : 0, useCurAsSrc ? 1 : 0 );
+
+                    // When the anchor independently confirms the matcher's
+                    // result with high confidence, mark the shift as verified
+                    // so momentum-collapse does not override it.  This prevents
+                    // a feedback loop where a previous harmonic error sets a
+                    // bad expected step, and the normalizer "corrects" the
+                    // current (correct) small step back to the wrong value.
+                    if( anchorConfident && !anchorDiffers )
+                        anchorVerifiedShift = true;
+                }
+            }
+        }
+
+        // Early growth-outlier guard for low-entropy startup/recovery.
+        // This catches the first large harmonic jump (e.g. 330 -> 800)
+        // before long-enough history exists for continuity statistics.
+        if( veryLowEntropy != 0 && composedFrameSteps.size() >= 1 )
+        {
+            const bool expectedMostlyVertical = abs( expectedDy ) >= max( abs( expectedDx ) * 2, minProgress );
+            const bool expectedMostlyHorizontal = abs( expectedDx ) >= max( abs( expectedDy ) * 2, minProgress );
+            const int expectedAxisSigned = expectedMostlyVertical ? expectedDy :
+                                          ( expectedMostlyHorizontal ? expectedDx : 0 );
+            const int candidateAxisSigned = expectedMostlyVertical ? dy :
+                                           ( expectedMostlyHorizontal ? dx : 0 );
+            const int axisFrame = expectedMostlyVertical ? frameHeight :
+                                 ( expectedMostlyHorizontal ? frameWidth : 0 );
+
+            if( axisFrame > 0 && expectedAxisSigned != 0 && candidateAxisSigned != 0 &&
+                ( ( expectedAxisSigned > 0 ) == ( candidateAxisSigned > 0 ) ) &&
+                abs( expectedAxisSigned ) >= max( minProgress * 3, 64 ) )
+            {
+                const int expectedAbs = abs( expectedAxisSigned );
+                const int candidateAbs = abs( candidateAxisSigned );
+                const int growthCap = max( expectedAbs * 2, ( axisFrame * 2 ) / 3 );
+                const int farFromExpected = abs( candidateAxisSigned - expectedAxisSigned );
+                if( candidateAbs > growthCap && farFromExpected > max( minProgress * 2, expectedAbs / 2 ) )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: early-growth-outlier shift=(%d,%d) expected=(%d,%d) cap=%d\n",
+                                 i,
+                                 dx,
+                                 dy,
+                                 expectedDx,
+                                 expectedDy,
+                                 growthCap );
+                    continue;
+                }
+            }
+        }
+
+        // Direct anti-reversal guard for VLE captures: when expected motion
+        // is strongly established in one direction, reject small opposite-
+        // sign shifts that are commonly harmonic aliases.
+        if( veryLowEntropy != 0 && composedFrameSteps.size() >= 6 )
+        {
+            int histAbsX = 0;
+            int histAbsY = 0;
+            for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+            {
+                histAbsX += abs( composedFrameSteps[si].x );
+                histAbsY += abs( composedFrameSteps[si].y );
+            }
+            const bool mostlyVerticalHist = histAbsY > histAbsX * 3;
+            const bool mostlyHorizontalHist = histAbsX > histAbsY * 3;
+            const int expectedAxisSigned = mostlyVerticalHist ? expectedDy :
+                                          ( mostlyHorizontalHist ? expectedDx : 0 );
+            const int candidateAxisSigned = mostlyVerticalHist ? dy :
+                                           ( mostlyHorizontalHist ? dx : 0 );
+            const int axisFrame = mostlyVerticalHist ? frameHeight :
+                                 ( mostlyHorizontalHist ? frameWidth : 0 );
+
+            std::vector<int> recentAxisAbs;
+            recentAxisAbs.reserve( 10 );
+            for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                 si >= 1 && static_cast<int>( recentAxisAbs.size() ) < 10;
+                 --si )
+            {
+                const int sv = mostlyVerticalHist
+                    ? composedFrameSteps[static_cast<size_t>( si )].y
+                    : ( mostlyHorizontalHist
+                        ? composedFrameSteps[static_cast<size_t>( si )].x
+                        : 0 );
+                if( abs( sv ) > 0 )
+                    recentAxisAbs.push_back( abs( sv ) );
+            }
+            int recentMedianAbs = 0;
+            int recentMaxAbs = 0;
+            if( !recentAxisAbs.empty() )
+            {
+                for( int v : recentAxisAbs )
+                    recentMaxAbs = max( recentMaxAbs, v );
+                std::sort( recentAxisAbs.begin(), recentAxisAbs.end() );
+                recentMedianAbs = recentAxisAbs[recentAxisAbs.size() / 2];
+            }
+
+            // Only trust expected-axis normalization when expected motion is
+            // broadly consistent with recent history. If expected has already
+            // drifted into a large harmonic outlier, forcing normalization to
+            // that value can replicate duplicated content bands.
+            const bool expectedAxisTrustedForNormalization =
+                recentMedianAbs > 0 &&
+                abs( expectedAxisSigned ) <= max( recentMedianAbs * 3, axisFrame / 3 );
+
+            // Growth-outlier guard: in low-entropy captures, startup recovery
+            // can occasionally lock to a moderate expected step and then jump
+            // to a near-frame-height harmonic alias. Reject sudden same-sign
+            // amplification far beyond both expected and recent motion.
+            if( veryLowEntropy &&
+                axisFrame > 0 && expectedAxisSigned != 0 && candidateAxisSigned != 0 &&
+                ( ( expectedAxisSigned > 0 ) == ( candidateAxisSigned > 0 ) ) &&
+                recentMedianAbs > 0 &&
+                abs( expectedAxisSigned ) >= max( minProgress * 3, 64 ) )
+            {
+                const int candidateAbs = abs( candidateAxisSigned );
+                const int expectedAbs = abs( expectedAxisSigned );
+                const int growthCap = max( max( expectedAbs * 2, recentMedianAbs * 2 ), ( axisFrame * 2 ) / 3 );
+                const int farFromExpected = abs( candidateAxisSigned - expectedAxisSigned );
+                if( candidateAbs > growthCap && farFromExpected > max( minProgress * 2, expectedAbs / 2 ) )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: growth-outlier shift=(%d,%d) expected=(%d,%d) median=%d cap=%d\n",
+                                 i,
+                                 dx,
+                                 dy,
+                                 expectedDx,
+                                 expectedDy,
+                                 recentMedianAbs,
+                                 growthCap );
+                    continue;
+                }
+            }
+
+            if( axisFrame > 0 && expectedAxisSigned != 0 && candidateAxisSigned != 0 &&
+                ( ( expectedAxisSigned > 0 ) != ( candidateAxisSigned > 0 ) ) &&
+                abs( expectedAxisSigned ) >= axisFrame / 4 &&
+                abs( candidateAxisSigned ) <= max( minProgress * 3, abs( expectedAxisSigned ) / 2 ) )
+            {
+                StitchLog( L"[Panorama/Stitch] Frame %zu rejected: expected-reversal-harmonic shift=(%d,%d) expected=(%d,%d)\n",
+                             i,
+                             dx,
+                             dy,
+                             expectedDx,
+                             expectedDy );
+                continue;
+            }
+
+            // Momentum-collapse guard: after sustained large motion, tiny
+            // same-direction steps are often harmonic aliases.  Normalize
+            // to expected motion rather than rejecting, so the stitcher
+            // keeps advancing and does not get stuck on an old reference.
+            //
+            // However, if multiple consecutive frames trigger this guard,
+            // the scroll has genuinely slowed down — the tiny steps are
+            // real, not aliases.  Continuing to normalize creates a
+            // feedback loop that over-advances the canvas, producing
+            // repeated content and dark gaps.  Cap at 2 consecutive
+            // normalizations to break the loop.
+            if( axisFrame > 0 && expectedAxisSigned != 0 && candidateAxisSigned != 0 &&
+                ( ( expectedAxisSigned > 0 ) == ( candidateAxisSigned > 0 ) ) &&
+                recentMedianAbs >= axisFrame / 10 &&
+                recentMaxAbs >= axisFrame / 4 &&
+                expectedAxisTrustedForNormalization &&
+                abs( expectedAxisSigned ) >= axisFrame / 8 &&
+                abs( candidateAxisSigned ) <= max( 16, abs( expectedAxisSigned ) / 5 ) &&
+                consecutiveMomentumCollapseCount < 2 &&
+                !anchorVerifiedShift )
+            {
+                // Save the pre-normalization detected shift.  After
+                // composing this frame at the expected step, propagate
+                // the detected value as next-expected so that if the
+                // scroll genuinely decelerated the expected step decays
+                // rather than staying locked at the historical peak.
+                momentumCollapseDetectedDx = dx;
+                momentumCollapseDetectedDy = dy;
+                momentumCollapseApplied = true;
+                StitchLog( L"[Panorama/Stitch] Frame %zu normalized: momentum-collapse-harmonic shift=(%d,%d) expected=(%d,%d) median=%d max=%d consecutiveCollapse=%d\n",
+                             i,
+                             dx,
+                             dy,
+                             expectedDx,
+                             expectedDy,
+                             recentMedianAbs,
+                             recentMaxAbs,
+                             consecutiveMomentumCollapseCount + 1 );
+                dx = expectedDx;
+                dy = expectedDy;
+                ++consecutiveMomentumCollapseCount;
+            }
+            else if( axisFrame > 0 && expectedAxisSigned != 0 && candidateAxisSigned != 0 &&
+                     ( ( expectedAxisSigned > 0 ) == ( candidateAxisSigned > 0 ) ) &&
+                     abs( candidateAxisSigned ) <= max( 16, abs( expectedAxisSigned ) / 5 ) &&
+                     consecutiveMomentumCollapseCount >= 2 )
+            {
+                // Scroll genuinely decelerated — accept the small step
+                // and let expected motion adapt naturally.
+                StitchLog( L"[Panorama/Stitch] Frame %zu momentum-collapse-capped: shift=(%d,%d) expected=(%d,%d) consecutiveCollapse=%d (accepting small step)\n",
+                             i,
+                             dx,
+                             dy,
+                             expectedDx,
+                             expectedDy,
+                             consecutiveMomentumCollapseCount );
+                consecutiveMomentumCollapseCount = 0;
+            }
+            else
+            {
+                // Frame was not momentum-collapse normalized — reset the
+                // consecutive counter so future genuine decelerations are
+                // detected fresh.
+                consecutiveMomentumCollapseCount = 0;
+            }
+        }
+
+        // After momentum-collapse normalization, propagate the DETECTED
+        // (pre-normalization) shift as the next expected step.  This lets
+        // the expected step decay toward actual scroll speed rather than
+        // staying locked at the historical peak, which would cause a
+        // feedback loop that over-advances the canvas.
+        int momentumCollapseNextExpectedDx = 0;
+        int momentumCollapseNextExpectedDy = 0;
+        if( momentumCollapseApplied )
+        {
+            momentumCollapseNextExpectedDx = momentumCollapseDetectedDx;
+            momentumCollapseNextExpectedDy = momentumCollapseDetectedDy;
+        }
+
+        int stepX = -dx;
+        int stepY = -dy;
+
+        // After establishing a predominantly vertical or horizontal scroll
+        // direction, clamp the perpendicular component to zero.  Subpixel
+        // rendering noise (e.g. ClearType) causes the fine refinement to
+        // report +/-1 px cross-axis drift per frame, which accumulates into
+        // visible slanting over many composed frames.
+        //
+        // Cap each step's contribution to the direction vote so that one
+        // outlier (e.g. a spurious large-shift match on blank content)
+        // cannot dominate the accumulator and lock the wrong axis.
+        if( composedFrameSteps.size() >= 3 )
+        {
+            const int stepCapForDirection = 3 * minProgress;
+            int totalAbsStepX = 0, totalAbsStepY = 0;
+            for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+            {
+                totalAbsStepX += min( abs( composedFrameSteps[si].x ), stepCapForDirection );
+                totalAbsStepY += min( abs( composedFrameSteps[si].y ), stepCapForDirection );
+            }
+
+            if( totalAbsStepY > totalAbsStepX * 8 )
+            {
+                stepX = 0;
+            }
+            else if( totalAbsStepX > totalAbsStepY * 8 )
+            {
+                stepY = 0;
+            }
+        }
+
+        // Near-stationary override: when FindBestFrameShift flags the match
+        // as unreliable (fine score per-pixel >= stationary score on near-
+        // identical frames), compose the frame at step=0 instead of the
+        // detected (likely harmonic) step.  This avoids advancing the
+        // canvas by a wrong harmonic amount while still updating the
+        // comparison reference for the next frame.  Since the frame is
+        // near-identical to the previous one, compositing at step=0 just
+        // overwrites the canvas with nearly the same pixels.  The expected
+        // step is updated from the original detected shift so subsequent
+        // tie-breaking is unchanged.
+        bool nearStationaryZeroStep = false;
+        if( nearStationaryOverride )
+        {
+            nearStationaryCount++;
+            if( abs( stepX ) + abs( stepY ) > minProgress )
+            {
+                StitchLog( L"[Panorama/Stitch] Frame %zu near-stationary zero-step: original=(%d,%d) count=%d\n",
+                             i, stepX, stepY, nearStationaryCount );
+                stepX = 0;
+                stepY = 0;
+                nearStationaryZeroStep = true;
+            }
+        }
+
+        // Cap the low-movement threshold so large frames don't reject
+        // real slow-scroll steps (e.g. 1071px -> minProgress/2=17 drops
+        // genuine 4-16 px scrolls).
+        if( !nearStationaryZeroStep && abs( stepX ) + abs( stepY ) < min( minProgress / 2, 4 ) )
+        {
+            StitchLog( L"[Panorama/Stitch] Frame %zu rejected: low movement step=(%d,%d)\n", i, stepX, stepY );
+            continue;
+        }
+
+        // Spike-recovery: when spike/outlier guards have rejected
+        // several consecutive frames, the expected step is likely
+        // corrupted by a preceding momentum-collapse cascade.  On
+        // dark / low-contrast content the matcher cannot reliably
+        // distinguish the true offset from harmonics, so correcting
+        // the expected alone does not help — the matched shift is
+        // unreliable.
+        //
+        // Instead, *override* the matched step with a predicted step
+        // derived from the pre-collapse history: the median of recent
+        // "healthy" (non-collapse) signed steps, scaled by the gap
+        // from the last accepted frame.  This positions the frame at
+        // a plausible canvas offset.  On the dark/uniform content
+        // that triggers this path, sub-frame positioning errors are
+        // invisible.
+        //
+        // The near-stationary-spike guard (the one corrupted by
+        // collapse statistics) is skipped for this frame; all other
+        // guards remain active so obviously-wrong predictions are
+        // still caught.
+        bool spikeRecoveryActive = false;
+        if( consecutiveSpikeRejectCount >= 3 && composedFrameSteps.size() >= 6 )
+        {
+            // Global median of accepted step magnitudes (robust to
+            // the small proportion of collapse entries).
+            std::vector<int> allStepMag;
+            for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+            {
+                const int v = max( abs( composedFrameSteps[si].x ),
+                                   abs( composedFrameSteps[si].y ) );
+                if( v > 0 )
+                    allStepMag.push_back( v );
+            }
+            if( !allStepMag.empty() )
+            {
+                std::sort( allStepMag.begin(), allStepMag.end() );
+                const int globalMedian = allStepMag[allStepMag.size() / 2];
+                const int healthyFloor = max( 2, globalMedian / 3 );
+
+                // Collect recent non-collapse signed steps for both axes.
+                std::vector<int> healthyX, healthyY;
+                for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                     si >= 1 && healthyX.size() < 20;
+                     --si )
+                {
+                    if( max( abs( composedFrameSteps[si].x ),
+                             abs( composedFrameSteps[si].y ) ) >= healthyFloor )
+                    {
+                        healthyX.push_back( composedFrameSteps[si].x );
+                        healthyY.push_back( composedFrameSteps[si].y );
+                    }
+                }
+                if( !healthyX.empty() )
+                {
+                    std::sort( healthyX.begin(), healthyX.end() );
+                    std::sort( healthyY.begin(), healthyY.end() );
+                    const int gap = max( 1, static_cast<int>( i - composedFrameIndices.back() ) );
+                    const int perFrameStepX = healthyX[healthyX.size() / 2];
+                    const int perFrameStepY = healthyY[healthyY.size() / 2];
+
+                    // Override matched shift with predicted gap-scaled step.
+                    stepX = perFrameStepX * gap;
+                    stepY = perFrameStepY * gap;
+                    dx = -stepX;
+                    dy = -stepY;
+
+                    // Set next-expected to the per-frame healthy step so
+                    // subsequent single-frame comparisons search correctly.
+                    hasNextExpectedOverride = true;
+                    overrideNextExpectedDx = -perFrameStepX;
+                    overrideNextExpectedDy = -perFrameStepY;
+                    overrideEligibilityStep = max( abs( perFrameStepX ), abs( perFrameStepY ) );
+
+                    spikeRecoveryActive = true;
+                    StitchLog( L"[Panorama/Stitch] Frame %zu spike-recovery: count=%d gap=%d perFrame=(%d,%d) step=(%d,%d)\n",
+                                 i,
+                                 consecutiveSpikeRejectCount,
+                                 gap,
+                                 perFrameStepX,
+                                 perFrameStepY,
+                                 stepX,
+                                 stepY );
+                }
+            }
+            consecutiveSpikeRejectCount = 0;
+        }
+
+        // Continuity guard: reject implausible large jumps once motion is
+        // established. This blocks harmonic matches that can skip ranges and
+        // create duplicate/missing content blocks.
+        if( composedFrameSteps.size() >= 6 )
+        {
+            int totalAbsX = 0;
+            int totalAbsY = 0;
+            for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+            {
+                totalAbsX += abs( composedFrameSteps[si].x );
+                totalAbsY += abs( composedFrameSteps[si].y );
+            }
+
+            const bool mostlyVertical = totalAbsY > totalAbsX * 3;
+            const bool mostlyHorizontal = totalAbsX > totalAbsY * 3;
+            const int axisStep = mostlyVertical ? abs( stepY ) : ( mostlyHorizontal ? abs( stepX ) : max( abs( stepX ), abs( stepY ) ) );
+            const int axisFrame = mostlyVertical ? frameHeight : frameWidth;
+            const int axisOverlap = max( 0, axisFrame - axisStep );
+            const int expectedAxisStep = mostlyVertical ? abs( expectedDy ) :
+                                         ( mostlyHorizontal ? abs( expectedDx ) : max( abs( expectedDx ), abs( expectedDy ) ) );
+
+            std::vector<int> recentAxisSteps;
+            recentAxisSteps.reserve( 12 );
+            for( int si = static_cast<int>( composedFrameSteps.size() ) - 1; si >= 1 && static_cast<int>( recentAxisSteps.size() ) < 12; --si )
+            {
+                const int v = mostlyVertical ? abs( composedFrameSteps[si].y ) :
+                             ( mostlyHorizontal ? abs( composedFrameSteps[si].x ) :
+                               max( abs( composedFrameSteps[si].x ), abs( composedFrameSteps[si].y ) ) );
+                if( v > 0 )
+                    recentAxisSteps.push_back( v );
+            }
+
+            if( recentAxisSteps.size() >= 4 )
+            {
+                std::vector<int> sorted = recentAxisSteps;
+                std::sort( sorted.begin(), sorted.end() );
+                const int medianAxisStep = sorted[sorted.size() / 2];
+                int outlierStepThreshold = max( ( axisFrame * 2 ) / 5, max( minProgress * 6, medianAxisStep * 5 ) );
+                const int lowOverlapThreshold = ( axisFrame * 3 ) / 5;
+                int expectedSpikeThreshold = max( axisFrame / 3, max( minProgress * 5, expectedAxisStep * 3 ) );
+
+                // Very-low-entropy content can produce long runs of small
+                // accepted steps followed by a legitimate large jump.
+                // Raise the outlier floor so those jumps are judged by the
+                // tighter percentile/overlap guards below instead of being
+                // dropped immediately by this coarse continuity gate.
+                if( veryLowEntropy != 0 )
+                {
+                    outlierStepThreshold = max( outlierStepThreshold, ( axisFrame * 7 ) / 10 );
+                    expectedSpikeThreshold = max( expectedSpikeThreshold, ( axisFrame * 7 ) / 10 );
+                }
+
+                // Direction-reversal guard for VLE captures: once a strong
+                // axis direction is established with substantial expected
+                // motion, reject opposite-sign steps that are often harmonic
+                // aliases and create repeated content bands/blank seams.
+                if( veryLowEntropy != 0 )
+                {
+                    const int axisSignMin = max( 4, minProgress );
+                    const int candidateSignMin = max( 8, minProgress / 2 );
+                    int signedSum = 0;
+                    int signedCount = 0;
+                    for( int si = static_cast<int>( composedFrameSteps.size() ) - 1;
+                         si >= 1 && signedCount < 10;
+                         --si )
+                    {
+                        const int sv = mostlyVertical
+                            ? composedFrameSteps[static_cast<size_t>( si )].y
+                            : composedFrameSteps[static_cast<size_t>( si )].x;
+                        if( abs( sv ) < axisSignMin )
+                            continue;
+                        signedSum += ( sv > 0 ) ? 1 : -1;
+                        signedCount++;
+                    }
+
+                    const int candidateSigned = mostlyVertical ? stepY : stepX;
+                    const int expectedSigned = mostlyVertical ? -expectedDy : -expectedDx;
+                    const bool dominantEstablished =
+                        signedCount >= 5 && abs( signedSum ) >= ( signedCount * 2 ) / 3;
+                    const bool candidateSignificant = abs( candidateSigned ) >= candidateSignMin;
+                    const bool oppositeDominant =
+                        dominantEstablished && candidateSigned != 0 &&
+                        ( ( candidateSigned > 0 ) != ( signedSum > 0 ) );
+                    const bool oppositeExpected =
+                        expectedSigned != 0 && candidateSigned != 0 &&
+                        ( ( candidateSigned > 0 ) != ( expectedSigned > 0 ) );
+                    const bool expectedLarge = abs( expectedSigned ) >= max( axisFrame / 8, axisSignMin * 6 );
+
+                    if( oppositeDominant && oppositeExpected && candidateSignificant && expectedLarge )
+                    {
+                        StitchLog( L"[Panorama/Stitch] Frame %zu rejected: direction-reversal step=(%d,%d) axisStep=%d expected=(%d,%d) signedSum=%d count=%d\n",
+                                     i,
+                                     stepX,
+                                     stepY,
+                                     axisStep,
+                                     expectedDx,
+                                     expectedDy,
+                                     signedSum,
+                                     signedCount );
+                        continue;
+                    }
+                }
+
+                if( axisStep >= outlierStepThreshold && axisOverlap < lowOverlapThreshold )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: outlier step=(%d,%d) axisStep=%d median=%d overlap=%d/%d\n",
+                                 i,
+                                 stepX,
+                                 stepY,
+                                 axisStep,
+                                 medianAxisStep,
+                                 axisOverlap,
+                                 axisFrame );
+                    consecutiveSpikeRejectCount++;
+                    continue;
+                }
+
+                // Additional harmonic-spike guard: if a candidate suddenly
+                // jumps far beyond expected motion while overlap is reduced,
+                // treat it as unreliable even when historical median is high.
+                if( expectedAxisStep > 0 && axisStep >= expectedSpikeThreshold && axisOverlap < axisFrame / 2 )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: spike step=(%d,%d) axisStep=%d expectedAxis=%d overlap=%d/%d\n",
+                                 i,
+                                 stepX,
+                                 stepY,
+                                 axisStep,
+                                 expectedAxisStep,
+                                 axisOverlap,
+                                 axisFrame );
+                    consecutiveSpikeRejectCount++;
+                    continue;
+                }
+
+                // Near-stationary spike guard: when recent motion is very
+                // small (< 5% of frame), a large jump is almost certainly
+                // a harmonic match on periodic content rather than a
+                // genuine scroll acceleration.  Unlike the other outlier
+                // guards this has no hard floor tied to frame height, so
+                // it catches spurious matches that slip under the 33-50%
+                // floors above.  The 20x multiplier allows legitimate
+                // jump-recovery scrolls (10-16x median) while catching
+                // harmonic spikes (60x+ median in the real bug case).
+                //
+                // Also require p75 < axisFrame/10: if 25%+ of recent
+                // steps were large the user was actively scrolling and
+                // a big step is more likely genuine acceleration than a
+                // harmonic artifact.
+                const int p75AxisStep = sorted[sorted.size() * 3 / 4];
+                if( !spikeRecoveryActive &&
+                    medianAxisStep < axisFrame / 20 &&
+                    p75AxisStep < axisFrame / 10 &&
+                    axisStep > max( medianAxisStep * 20, minProgress * 4 ) )
+                {
+                    StitchLog( L"[Panorama/Stitch] Frame %zu rejected: near-stationary-spike step=(%d,%d) axisStep=%d median=%d p75=%d threshold=%d\n",
+                                 i,
+                                 stepX,
+                                 stepY,
+                                 axisStep,
+                                 medianAxisStep,
+                                 p75AxisStep,
+                                 max( medianAxisStep * 20, minProgress * 4 ) );
+                    consecutiveSpikeRejectCount++;
+                    continue;
+                }
+
+                // Step-range outlier guard: on periodic content the fine
+                // search can pick a harmonic that is only moderately above
+                // normal -- not enough for the 4x median guard -- but well
+                // above the observed step range.  Use the 75th percentile
+                // of recent steps as a tighter reference.
+                //
+                // Keep a hard floor at 50% of the frame to avoid rejecting
+                // legitimate fast-scroll jumps.  The stress "legitjumps"
+                // scenarios include valid jumps up to that range.
+                if( sorted.size() >= 6 )
+                {
+                    const int p75 = sorted[sorted.size() * 3 / 4];
+                    const int rangeGuard = p75 + max( minProgress, medianAxisStep / 2 );
+                    int legitJumpFloor = axisFrame / 2;
+                    if( veryLowEntropy != 0 )
+                    {
+                        legitJumpFloor = max( legitJumpFloor, ( axisFrame * 7 ) / 10 );
+                    }
+                    const int guardedThreshold = max( rangeGuard, legitJumpFloor );
+                    if( axisStep > guardedThreshold && axisOverlap < ( axisFrame * 2 ) / 3 )
+                    {
+                        StitchLog( L"[Panorama/Stitch] Frame %zu rejected: range-outlier step=(%d,%d) axisStep=%d p75=%d rangeGuard=%d floor=%d overlap=%d/%d\n",
+                                     i,
+                                     stepX,
+                                     stepY,
+                                     axisStep,
+                                     p75,
+                                     rangeGuard,
+                                     legitJumpFloor,
+                                     axisOverlap,
+                                     axisFrame );
+                        consecutiveSpikeRejectCount++;
+                        continue;
+                    }
+                }
+
+                // VLE continuity guard: on very-low-entropy content, ZNCC
+                // scoring is unreliable because near-uniform pixels match
+                // at essentially random offsets.  Use a tighter step ceiling
+                // than the standard outlier guard, but still allow legitimate
+                // fast-scroll jumps up to 50% of frame height.
+                if( veryLowEntropy != 0 )
+                {
+                    const int vleMedianCeiling = max( medianAxisStep * 3, minProgress * 4 );
+                    const int vleLegitFloor = ( axisFrame * 7 ) / 10; // allow up to 70% frame on VLE fast-scroll
+                    const int vleStepCeiling = max( vleMedianCeiling, vleLegitFloor );
+                    if( axisStep > vleStepCeiling )
+                    {
+                        StitchLog( L"[Panorama/Stitch] Frame %zu rejected: vle-outlier step=(%d,%d) axisStep=%d median=%d ceiling=%d\n",
+                                     i,
+                                     stepX,
+                                     stepY,
+                                     axisStep,
+                                     medianAxisStep,
+                                     vleStepCeiling );
+                        consecutiveSpikeRejectCount++;
+                        continue;
+                    }
+                }
+
+            }
+        }
+
+        // Cross-verification diagnostic: after all guards, independently
+        // verify the accepted shift by finding the most distinctive row
+        // in the reference frame and searching for it in the current frame.
+        // This exposes harmonic aliases where the matcher found a plausible
+        // but incorrect offset.
+        if( PanoramaStitchLogEnabled() && composedFrameSteps.size() >= 6 )
+        {
+            const size_t refIdx = composedFrameIndices.back();
+            const std::vector<BYTE>& refPx = framePixels[refIdx];
+            const std::vector<BYTE>& curPx = framePixels[i];
+
+            // Find the most distinctive row in the reference frame
+            // (highest variance across horizontal pixel samples).
+            int bestVarRow = frameHeight / 2;
+            double bestVar = 0;
+            for( int y = frameHeight / 10; y < frameHeight * 9 / 10; y += 3 )
+            {
+                double sum = 0, sumSq = 0;
+                int count = 0;
+                for( int x = frameWidth / 8; x < frameWidth * 7 / 8; x += 8 )
+                {
+                    const size_t idx = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4 + static_cast<size_t>( x ) * 4;
+                    const double val = refPx[idx + 2]; // R channel
+                    sum += val;
+                    sumSq += val * val;
+                    ++count;
+                }
+                if( count > 0 )
+                {
+                    const double mean = sum / count;
+                    const double var = ( sumSq / count ) - ( mean * mean );
+                    if( var > bestVar )
+                    {
+                        bestVar = var;
+                        bestVarRow = y;
+                    }
+                }
+            }
+
+            // Search for the reference row in the current frame.
+            if( bestVar > 100 )
+            {
+                const int searchRange = min( frameHeight - 1, 600 );
+                double bestMatchDiff = 1e9;
+                int bestMatchDy = 0;
+                for( int probe = -searchRange; probe <= 0; ++probe )
+                {
+                    const int ty = bestVarRow + probe;
+                    if( ty < 0 || ty >= frameHeight )
+                        continue;
+                    double diff = 0;
+                    int count = 0;
+                    for( int x = frameWidth / 8; x < frameWidth * 7 / 8; x += 6 )
+                    {
+                        const size_t refOff = static_cast<size_t>( bestVarRow ) * static_cast<size_t>( frameWidth ) * 4 + static_cast<size_t>( x ) * 4;
+                        const size_t curOff = static_cast<size_t>( ty ) * static_cast<size_t>( frameWidth ) * 4 + static_cast<size_t>( x ) * 4;
+                        diff += abs( static_cast<int>( refPx[refOff + 0] ) - static_cast<int>( curPx[curOff + 0] ) )
+                              + abs( static_cast<int>( refPx[refOff + 1] ) - static_cast<int>( curPx[curOff + 1] ) )
+                              + abs( static_cast<int>( refPx[refOff + 2] ) - static_cast<int>( curPx[curOff + 2] ) );
+                        ++count;
+                    }
+                    diff /= max( 1, count * 3 );
+                    if( diff < bestMatchDiff )
+                    {
+                        bestMatchDiff = diff;
+                        bestMatchDy = probe;
+                    }
+                }
+
+                const int matcherDy = dy;
+                const int verifyDy = bestMatchDy;
+                const int discrepancy = abs( matcherDy ) - abs( verifyDy );
+                if( abs( discrepancy ) > max( 8, abs( matcherDy ) / 4 ) )
+                {
+                    StitchLog( L"[Panorama/Stitch] CrossVerify MISMATCH frame=%zu ref=%zu matcherDy=%d verifyDy=%d discrepancy=%d verifyDiff=%.1f refRow=%d refVar=%.0f\n",
+                               i,
+                               refIdx,
+                               matcherDy,
+                               verifyDy,
+                               discrepancy,
+                               bestMatchDiff,
+                               bestVarRow,
+                               bestVar );
+                }
+                else
+                {
+                    StitchLog( L"[Panorama/Stitch] CrossVerify OK frame=%zu ref=%zu matcherDy=%d verifyDy=%d verifyDiff=%.1f\n",
+                               i,
+                               refIdx,
+                               matcherDy,
+                               verifyDy,
+                               bestMatchDiff );
+                }
+            }
+        }
+
+        POINT nextOrigin = composedFrameOrigins.back();
+        nextOrigin.x += stepX;
+        nextOrigin.y += stepY;
+        const int nextExpectedDx = hasNextExpectedOverride ? overrideNextExpectedDx :
+                                   momentumCollapseApplied ? momentumCollapseNextExpectedDx : dx;
+        const int nextExpectedDy = hasNextExpectedOverride ? overrideNextExpectedDy :
+                                   momentumCollapseApplied ? momentumCollapseNextExpectedDy : dy;
+        const int acceptedEligibilityStep = hasNextExpectedOverride
+            ? overrideEligibilityStep
+            : max( abs( dx ), abs( dy ) );
+        composedFrameIndices.push_back( i );
+        composedFrameOrigins.push_back( nextOrigin );
+        composedFrameSteps.push_back( { stepX, stepY } );
+        consecutiveSpikeRejectCount = 0;
+        expectedDx = nextExpectedDx;
+        expectedDy = nextExpectedDy;
+
+        // After a retry spanning multiple frame intervals, normalize
+        // the eligibility step to a single-frame estimate so the
+        // inflated multi-frame shift doesn't block subsequent retries.
+        // Budget limits consecutive normalizations per HCF zone.
+        if( retryStreakUsed >= 2 && retryNormalizationBudget > 0 )
+        {
+            retryEligibilityStep = max( minProgress, max( abs( dx ), abs( dy ) ) / retryStreakUsed );
+            retryNormalizationBudget--;
+        }
+        else
+        {
+            retryEligibilityStep = acceptedEligibilityStep;
+            if( retryStreakUsed == 0 )
+                retryNormalizationBudget = 5;
+        }
+
+        StitchLog( L"[Panorama/Stitch] Frame %zu accepted: dx=%d dy=%d step=(%d,%d) origin=(%d,%d)\n",
+                     i,
+                     dx,
+                     dy,
+                     stepX,
+                     stepY,
+                     nextOrigin.x,
+                     nextOrigin.y );
+
+        minX = min( minX, nextOrigin.x );
+        minY = min( minY, nextOrigin.y );
+        maxX = max( maxX, nextOrigin.x + frameWidth );
+        maxY = max( maxY, nextOrigin.y + frameHeight );
+    }
+
+#ifdef _DEBUG
+    g_StitchPerf.Report();
+    g_StitchPerf.Reset();
+#endif
+    endStage( timings.alignMs );
+
+    int totalAbsStepX = 0;
+    int totalAbsStepY = 0;
+    for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+    {
+        totalAbsStepX += abs( composedFrameSteps[si].x );
+        totalAbsStepY += abs( composedFrameSteps[si].y );
+    }
+
+    const bool mostlyHorizontalCapture = totalAbsStepX > totalAbsStepY;
+    const bool shouldFlipHorizontal =
+        mostlyHorizontalCapture &&
+        !composedFrameOrigins.empty() &&
+        composedFrameOrigins.back().x < composedFrameOrigins.front().x;
+    const bool shouldFlipVertical =
+        !mostlyHorizontalCapture &&
+        !composedFrameOrigins.empty() &&
+        composedFrameOrigins.back().y < composedFrameOrigins.front().y;
+
+    // Normalize output orientation so the first frame appears at the top for
+    // vertical captures and at the left for horizontal captures.
+    if( shouldFlipHorizontal || shouldFlipVertical )
+    {
+        for( POINT& origin : composedFrameOrigins )
+        {
+            if( shouldFlipHorizontal )
+            {
+                origin.x = -origin.x;
+            }
+            if( shouldFlipVertical )
+            {
+                origin.y = -origin.y;
+            }
+        }
+
+        for( POINT& step : composedFrameSteps )
+        {
+            if( shouldFlipHorizontal )
+            {
+                step.x = -step.x;
+            }
+            if( shouldFlipVertical )
+            {
+                step.y = -step.y;
+            }
+        }
+
+        minX = 0;
+        minY = 0;
+        maxX = frameWidth;
+        maxY = frameHeight;
+        for( const POINT& origin : composedFrameOrigins )
+        {
+            minX = min( minX, origin.x );
+            minY = min( minY, origin.y );
+            maxX = max( maxX, origin.x + frameWidth );
+            maxY = max( maxY, origin.y + frameHeight );
+        }
+
+        StitchLog( L"[Panorama/Stitch] Normalized orientation: first frame at %ls\n",
+                     shouldFlipHorizontal ? L"left" : L"top" );
+    }
+
+    const int stitchedWidth = maxX - minX;
+    const int stitchedHeight = maxY - minY;
+    StitchLog( L"[Panorama/Stitch] Composition summary: composed=%zu/%zu canvas=%dx%d bounds=(%d,%d)-(%d,%d)\n",
+                 composedFrameIndices.size(),
+                 framePixels.size(),
+                 stitchedWidth,
+                 stitchedHeight,
+                 minX,
+                 minY,
+                 maxX,
+                 maxY );
+    if( stitchedWidth <= 0 ||
+        stitchedHeight <= 0 ||
+        stitchedWidth > kMaxStitchedCanvasDimension ||
+        stitchedHeight > kMaxStitchedCanvasDimension )
+    {
+        StitchLog( L"[Panorama/Stitch] Invalid stitched canvas size %dx%d\n", stitchedWidth, stitchedHeight );
+        return false;
+    }
+
+    std::vector<BYTE> stitchedPixels( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ) * 4, 0 );
+    std::vector<BYTE> stitchedWritten( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> stitchedOwner( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<BYTE> stitchedBlended( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> rowBlendPixelCount( static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> rowBlendWeightSum( static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> rowBlendWeightMin( static_cast<size_t>( stitchedHeight ), 255 );
+    std::vector<int> rowBlendWeightMax( static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> rowBlendDominantFrame( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowBlendDominantPixels( static_cast<size_t>( stitchedHeight ), 0 );
+    std::vector<int> rowFullWidthBlendFirstFrame( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendFirstPass( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendFirstWeight( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendLastFrame( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendLastPass( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendLastWeight( static_cast<size_t>( stitchedHeight ), -1 );
+    std::vector<int> rowFullWidthBlendPassCount( static_cast<size_t>( stitchedHeight ), 0 );
+    const int verticalFeather = max( 2, min( 12, frameHeight / 36 ) );
+    const int horizontalFeather = max( 2, min( 12, frameWidth / 36 ) );
+    FixedOverlayDiagnostics overlayDiagnostics{};
+    const FixedOverlayMask fixedOverlayMask = BuildFixedOverlayMask( composedFrameIndices,
+                                                                     composedFrameSteps,
+                                                                     framePixels,
+                                                                     frameLuma,
+                                                                     frameWidth,
+                                                                     frameHeight,
+                                                                     minProgress,
+                                                                     &overlayDiagnostics );
+    endStage( timings.overlayMs );
+    if( !fixedOverlayMask.Empty() )
+    {
+        StitchLog( L"[Panorama/Stitch] FixedOverlay mask: pairs=%d informativeTiles=%d strongTiles=%d connectedTiles=%d maskedTiles=%d bounds=(%d,%d)-(%d,%d) tile=%dx%d\n",
+                     overlayDiagnostics.pairCount,
+                     overlayDiagnostics.informativeTileComparisons,
+                     overlayDiagnostics.strongTileCount,
+                     overlayDiagnostics.connectedTileCount,
+                     overlayDiagnostics.maskedTileCount,
+                     overlayDiagnostics.tileBoundsLeft,
+                     overlayDiagnostics.tileBoundsTop,
+                     overlayDiagnostics.tileBoundsRight,
+                     overlayDiagnostics.tileBoundsBottom,
+                     fixedOverlayMask.tileWidth,
+                     fixedOverlayMask.tileHeight );
+    }
+
+    auto composeFrames = [&]( const FixedOverlayMask* overlayMask,
+                              bool reportCompositionProgress,
+                              std::vector<BYTE>& outPixels,
+                              std::vector<BYTE>& outWritten,
+                              std::vector<int>& outOwner,
+                              std::vector<BYTE>& outBlended,
+                              std::vector<BYTE>* outSuppressedMask,
+                              std::vector<int>* outRowBlendPixelCount,
+                              std::vector<int>* outRowBlendWeightSum,
+                              std::vector<int>* outRowBlendWeightMin,
+                              std::vector<int>* outRowBlendWeightMax,
+                              std::vector<int>* outRowBlendDominantFrame,
+                              std::vector<int>* outRowBlendDominantPixels,
+                              std::vector<int>* outRowFullWidthBlendFirstFrame,
+                              std::vector<int>* outRowFullWidthBlendFirstPass,
+                              std::vector<int>* outRowFullWidthBlendFirstWeight,
+                              std::vector<int>* outRowFullWidthBlendLastFrame,
+                              std::vector<int>* outRowFullWidthBlendLastPass,
+                              std::vector<int>* outRowFullWidthBlendLastWeight,
+                              std::vector<int>* outRowFullWidthBlendPassCount,
+                              uint64_t* outSuppressedPixels ) -> bool
+    {
+        outPixels.assign( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ) * 4, 0 );
+        outWritten.assign( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), 0 );
+        outOwner.assign( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), -1 );
+        outBlended.assign( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), 0 );
+        if( outSuppressedMask ) outSuppressedMask->assign( static_cast<size_t>( stitchedWidth ) * static_cast<size_t>( stitchedHeight ), 0 );
+        if( outRowBlendPixelCount ) outRowBlendPixelCount->assign( static_cast<size_t>( stitchedHeight ), 0 );
+        if( outRowBlendWeightSum ) outRowBlendWeightSum->assign( static_cast<size_t>( stitchedHeight ), 0 );
+        if( outRowBlendWeightMin ) outRowBlendWeightMin->assign( static_cast<size_t>( stitchedHeight ), 255 );
+        if( outRowBlendWeightMax ) outRowBlendWeightMax->assign( static_cast<size_t>( stitchedHeight ), 0 );
+        if( outRowBlendDominantFrame ) outRowBlendDominantFrame->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowBlendDominantPixels ) outRowBlendDominantPixels->assign( static_cast<size_t>( stitchedHeight ), 0 );
+        if( outRowFullWidthBlendFirstFrame ) outRowFullWidthBlendFirstFrame->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendFirstPass ) outRowFullWidthBlendFirstPass->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendFirstWeight ) outRowFullWidthBlendFirstWeight->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendLastFrame ) outRowFullWidthBlendLastFrame->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendLastPass ) outRowFullWidthBlendLastPass->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendLastWeight ) outRowFullWidthBlendLastWeight->assign( static_cast<size_t>( stitchedHeight ), -1 );
+        if( outRowFullWidthBlendPassCount ) outRowFullWidthBlendPassCount->assign( static_cast<size_t>( stitchedHeight ), 0 );
+        if( outSuppressedPixels ) *outSuppressedPixels = 0;
+
+        std::atomic<uint64_t> suppressedPixels( 0 );
+
+        for( size_t i = 0; i < composedFrameIndices.size(); ++i )
+        {
+            if( reportCompositionProgress )
+            {
+                reportProgress( 90 + static_cast<int>( ( i + 1 ) * 9 / composedFrameIndices.size() ) );
+            }
+            if( cancelled )
+            {
+                StitchLog( L"[Panorama/Stitch] Cancelled during composition\n" );
+                return false;
+            }
+
+            const size_t frameIndex = composedFrameIndices[i];
+            const POINT& currentOrigin = composedFrameOrigins[i];
+            const int destinationX = currentOrigin.x - minX;
+            const int destinationY = currentOrigin.y - minY;
+            const std::vector<BYTE>& sourcePixels = framePixels[frameIndex];
+
+            int stepX = 0;
+            int stepY = 0;
+            if( i > 0 )
+            {
+                stepX = composedFrameSteps[i].x;
+                stepY = composedFrameSteps[i].y;
+            }
+
+            const int absStepX = abs( stepX );
+            const int absStepY = abs( stepY );
+            const bool mostlyVerticalMove = i > 0 && absStepY >= minProgress && abs( stepX ) <= max( 12, frameWidth / 20 );
+            const bool mostlyHorizontalMove = i > 0 && absStepX >= minProgress && abs( stepY ) <= max( 12, frameHeight / 20 );
+            const int overlapHeight = mostlyVerticalMove ? max( 0, frameHeight - absStepY ) : 0;
+            const int overlapWidth = mostlyHorizontalMove ? max( 0, frameWidth - absStepX ) : 0;
+
+            StitchLog( L"[Panorama/Stitch] Compose frame %zu src=%zu dest=(%d,%d) spanY=%d..%d step=(%d,%d) overlap=(%d,%d) mode=%ls mask=%d\n",
+                       i,
+                       frameIndex,
+                       destinationX,
+                       destinationY,
+                       destinationY,
+                       destinationY + frameHeight,
+                       stepX,
+                       stepY,
+                       overlapWidth,
+                       overlapHeight,
+                       mostlyVerticalMove ? L"vertical" : ( mostlyHorizontalMove ? L"horizontal" : L"neutral" ),
+                       overlayMask ? 1 : 0 );
+
+            // Replace floating-overlay pixels with actual page content from
+            // another frame where the same content is visible outside the
+            // overlay region.  The overlay (spinner icon) sits at a fixed
+            // screen position, but the page scrolls — so any page content
+            // hidden by the overlay in this frame is visible at a shifted
+            // position in a nearby frame.
+            std::vector<BYTE> erasedPixels;
+            const std::vector<BYTE>* composeSrc = &sourcePixels;
+            // Skip erase-rect replacement for the last few composed frames:
+            // at the tail of a panorama there are typically no later donor
+            // frames to supply clean content, so leave the floating overlay
+            // in place rather than smearing mismatched donor content.
+            const bool lastFrame = ( i + 1 >= composedFrameIndices.size() );
+            if( !lastFrame &&
+                overlayMask != nullptr &&
+                overlayMask->eraseRect.right > overlayMask->eraseRect.left &&
+                overlayMask->eraseRect.bottom > overlayMask->eraseRect.top )
+            {
+                const RECT& er = overlayMask->eraseRect;
+                erasedPixels = sourcePixels;
+                bool anyReplaced = false;
+
+                // For small/compact erase rects detected by the residual
+                // overlay scan, skip donor diff validation — the residual
+                // detection already confirmed these are overlay pixels, so
+                // any scroll-aligned donor is better than the overlay.
+                const int eraseW = er.right - er.left;
+                const int eraseH = er.bottom - er.top;
+                const bool compactEraseRect = ( eraseW <= frameWidth / 4 && eraseH <= frameHeight / 4 );
+
+                for( int ey = er.top; ey < er.bottom && ey < frameHeight; ++ey )
+                {
+                    // For this row, find a donor frame where the same page
+                    // content falls outside the erase rect.  Search nearby
+                    // frames first (closest scroll offset).
+                    bool rowReplaced = false;
+                    for( int dist = 1; dist <= static_cast<int>( composedFrameIndices.size() ) && !rowReplaced; ++dist )
+                    {
+                        for( int sign = -1; sign <= 1 && !rowReplaced; sign += 2 )
+                        {
+                            const int j = static_cast<int>( i ) + dist * sign;
+                            if( j < 0 || j >= static_cast<int>( composedFrameIndices.size() ) )
+                                continue;
+
+                            // Compute where this row's page content appears in frame j.
+                            const int donorY = ey + ( composedFrameOrigins[i].y - composedFrameOrigins[j].y );
+                            if( donorY < 0 || donorY >= frameHeight )
+                                continue;
+
+                            // The donor row must be outside the erase rect in frame j,
+                            // and outside any tile-masked overlay area (e.g. bottom strip).
+                            if( donorY >= er.top && donorY < er.bottom )
+                                continue;
+                            if( overlayMask->IsFullWidthMaskedRow( donorY ) )
+                                continue;
+
+                            const auto& donorPixels = framePixels[composedFrameIndices[j]];
+                            if( donorPixels.empty() || donorPixels.size() != sourcePixels.size() )
+                                continue;
+
+                            // Validate donor row against surrounding context
+                            // before copying — reject donors whose content
+                            // diverges from the local source pixels.  Use a
+                            // per-pixel comparison against the source row
+                            // rather than edge context, since the erase rect
+                            // can span the full frame width when sidebars and
+                            // the overlay are both detected.
+                            const int exLeft = max( 0, static_cast<int>( er.left ) );
+                            const int exRight = min( frameWidth, static_cast<int>( er.right ) );
+
+                            const int donorDx = composedFrameOrigins[i].x - composedFrameOrigins[j].x;
+                            bool donorOk = true;
+                            for( int ex = exLeft; ex < exRight; ++ex )
+                            {
+                                const int donorX = ex + donorDx;
+                                if( donorX < 0 || donorX >= frameWidth )
+                                    continue;
+
+                                const size_t dstIdx = ( static_cast<size_t>( ey ) * frameWidth + ex ) * 4;
+                                const size_t srcIdx = ( static_cast<size_t>( donorY ) * frameWidth + donorX ) * 4;
+                                erasedPixels[dstIdx + 0] = donorPixels[srcIdx + 0];
+                                erasedPixels[dstIdx + 1] = donorPixels[srcIdx + 1];
+                                erasedPixels[dstIdx + 2] = donorPixels[srcIdx + 2];
+                            }
+
+                            // For large erase rects (e.g. strip-gated),
+                            // validate donor against source to reject
+                            // misaligned donors.  Skip for compact rects
+                            // where residual detection already confirmed
+                            // these are genuine overlay pixels.
+                            if( !compactEraseRect )
+                            {
+                                int donorDiffSum = 0, donorDiffN = 0;
+                                for( int ex = exLeft; ex < exRight; ++ex )
+                                {
+                                    const int donorX = ex + donorDx;
+                                    if( donorX < 0 || donorX >= frameWidth )
+                                        continue;
+                                    const size_t dstIdx = ( static_cast<size_t>( ey ) * frameWidth + ex ) * 4;
+                                    const size_t srcIdx = ( static_cast<size_t>( donorY ) * frameWidth + donorX ) * 4;
+                                    donorDiffSum += abs( static_cast<int>( donorPixels[srcIdx + 0] ) - static_cast<int>( sourcePixels[dstIdx + 0] ) )
+                                                 + abs( static_cast<int>( donorPixels[srcIdx + 1] ) - static_cast<int>( sourcePixels[dstIdx + 1] ) )
+                                                 + abs( static_cast<int>( donorPixels[srcIdx + 2] ) - static_cast<int>( sourcePixels[dstIdx + 2] ) );
+                                    donorDiffN += 3;
+                                }
+                                const int donorAvgDiff = ( donorDiffN > 0 ) ? donorDiffSum / donorDiffN : 0;
+                                if( donorAvgDiff > 40 )
+                                {
+                                    donorOk = false;
+                                }
+                            }
+                            if( !donorOk )
+                            {
+                                // Revert row to original pixels.
+                                for( int ex = exLeft; ex < exRight; ++ex )
+                                {
+                                    const size_t dstIdx = ( static_cast<size_t>( ey ) * frameWidth + ex ) * 4;
+                                    erasedPixels[dstIdx + 0] = sourcePixels[dstIdx + 0];
+                                    erasedPixels[dstIdx + 1] = sourcePixels[dstIdx + 1];
+                                    erasedPixels[dstIdx + 2] = sourcePixels[dstIdx + 2];
+                                }
+                                continue;  // Try next donor.
+                            }
+                            rowReplaced = true;
+                            anyReplaced = true;
+                        }
+                    }
+
+                    // Fallback for compact erase rects: when no donor was
+                    // found (tail frames or out-of-bounds donors), fill
+                    // from the nearest row just outside the erase rect.
+                    if( !rowReplaced && compactEraseRect )
+                    {
+                        const int exLeft = max( 0, static_cast<int>( er.left ) );
+                        const int exRight = min( frameWidth, static_cast<int>( er.right ) );
+                        // Pick the closest row outside the erase rect.
+                        const int aboveY = max( 0, static_cast<int>( er.top ) - 1 );
+                        const int belowY = min( frameHeight - 1, static_cast<int>( er.bottom ) );
+                        const int fillY = ( ey - aboveY <= belowY - ey ) ? aboveY : belowY;
+                        for( int ex = exLeft; ex < exRight; ++ex )
+                        {
+                            const size_t dstIdx = ( static_cast<size_t>( ey ) * frameWidth + ex ) * 4;
+                            const size_t fillIdx = ( static_cast<size_t>( fillY ) * frameWidth + ex ) * 4;
+                            erasedPixels[dstIdx + 0] = sourcePixels[fillIdx + 0];
+                            erasedPixels[dstIdx + 1] = sourcePixels[fillIdx + 1];
+                            erasedPixels[dstIdx + 2] = sourcePixels[fillIdx + 2];
+                        }
+                        rowReplaced = true;
+                        anyReplaced = true;
+                    }
+                }
+
+                if( anyReplaced )
+                {
+                    composeSrc = &erasedPixels;
+                }
+
+                if( i == 0 )
+                {
+                    StitchLog( L"[Panorama/Stitch] EraseRect: (%d,%d)-(%d,%d) replaced=%d compact=%d\n",
+                        er.left, er.top, er.right, er.bottom,
+                        anyReplaced ? 1 : 0,
+                        compactEraseRect ? 1 : 0 );
+                }
+            }
+            const std::vector<BYTE>& activePixels = *composeSrc;
+
+            constexpr int kComposeRowGrain = 8;
+            parallel_for( 0, frameHeight, [&]( int y )
+            {
+                const int canvasY = destinationY + y;
+                if( canvasY < 0 || canvasY >= stitchedHeight )
+                {
+                    return;
+                }
+
+                const size_t srcRowBase = static_cast<size_t>( y ) * static_cast<size_t>( frameWidth ) * 4;
+                const size_t dstRowBase = static_cast<size_t>( canvasY ) * static_cast<size_t>( stitchedWidth ) * 4;
+                const size_t dstMaskRowBase = static_cast<size_t>( canvasY ) * static_cast<size_t>( stitchedWidth );
+                int rowBlendPixelsThisFrame = 0;
+                int rowBlendWeightSumThisFrame = 0;
+                int rowBlendWeightMinThisFrame = 255;
+                int rowBlendWeightMaxThisFrame = 0;
+                uint64_t rowSuppressedPixels = 0;
+
+                for( int x = 0; x < frameWidth; ++x )
+                {
+                    const int canvasX = destinationX + x;
+                    if( canvasX < 0 || canvasX >= stitchedWidth )
+                    {
+                        continue;
+                    }
+
+                    const size_t dstMaskIndex = dstMaskRowBase + static_cast<size_t>( canvasX );
+
+                    const bool firstFrame = ( i == 0 );
+
+                    if( !lastFrame && overlayMask != nullptr && overlayMask->IsMaskedPixel( x, y ) )
+                    {
+                        // Exempt the first frame's header region so the
+                        // header appears once at the top of the output,
+                        // mirroring the lastFrame exemption for footers.
+                        if( !firstFrame || y >= overlayMask->topHeaderHeight )
+                        {
+                            if( outSuppressedMask != nullptr )
+                            {
+                                ( *outSuppressedMask )[dstMaskIndex] = 1;
+                            }
+                            ++rowSuppressedPixels;
+                            continue;
+                        }
+                    }
+
+                    // Suppress the entire header region for non-first
+                    // frames so only frame 0's header appears at the
+                    // top.  The tile mask only catches some header
+                    // tiles; this ensures ALL header pixels are kept
+                    // from frame 0 and suppressed from later frames.
+                    if( !lastFrame && !firstFrame && overlayMask != nullptr &&
+                        overlayMask->topHeaderHeight > 0 && y < overlayMask->topHeaderHeight )
+                    {
+                        if( outSuppressedMask != nullptr )
+                        {
+                            ( *outSuppressedMask )[dstMaskIndex] = 1;
+                        }
+                        ++rowSuppressedPixels;
+                        continue;
+                    }
+
+                    // Suppress pixels from the residual-detected overlay
+                    // region all the way down through any bottom toolbar.
+                    // The overlay bar sits at local-Y ~872-918, the tile
+                    // mask covers the toolbar below at Y ~960-1155, but
+                    // there can be gaps between them.  By suppressing
+                    // from eraseRect.top to frame bottom, we ensure the
+                    // entire fixed region is handled consistently.
+                    if( !lastFrame && overlayMask != nullptr &&
+                        overlayMask->eraseRect.right > overlayMask->eraseRect.left &&
+                        y >= overlayMask->eraseRect.top &&
+                        x >= overlayMask->eraseRect.left && x < overlayMask->eraseRect.right )
+                    {
+                        if( outSuppressedMask != nullptr )
+                        {
+                            ( *outSuppressedMask )[dstMaskIndex] = 1;
+                        }
+                        ++rowSuppressedPixels;
+                        continue;
+                    }
+
+                    // Suppress the gap above the bottom toolbar where
+                    // floating buttons (scroll-to-bottom, etc.) sit.
+                    // These are too small for tile-based detection but
+                    // consistently present at a fixed screen position.
+                    // The overlap region ensures the canvas already has
+                    // clean content from earlier frames.
+                    if( !lastFrame && !firstFrame && overlayMask != nullptr &&
+                        overlayMask->bottomStripY > 0 &&
+                        y >= overlayMask->bottomStripY - 60 &&
+                        !overlayMask->IsMaskedPixel( x, y ) )
+                    {
+                        if( outSuppressedMask != nullptr )
+                        {
+                            ( *outSuppressedMask )[dstMaskIndex] = 1;
+                        }
+                        ++rowSuppressedPixels;
+                        continue;
+                    }
+
+                    const size_t srcIndex = srcRowBase + static_cast<size_t>( x ) * 4;
+                    const size_t dstIndex = dstRowBase + static_cast<size_t>( canvasX ) * 4;
+
+                    BYTE weightNew = ( i > 0 && !mostlyVerticalMove && !mostlyHorizontalMove ) ? 0 : 255;
+                    if( mostlyVerticalMove && overlapHeight > 0 )
+                    {
+                        if( stepY > 0 )
+                        {
+                            const int overlapEnd = overlapHeight;
+                            if( y < overlapEnd - verticalFeather )
+                            {
+                                weightNew = 0;
+                            }
+                            else if( y < overlapEnd )
+                            {
+                                const int numerator = y - ( overlapEnd - verticalFeather );
+                                weightNew = static_cast<BYTE>( max( 0, min( 255, ( numerator * 255 ) / max( 1, verticalFeather ) ) ) );
+                            }
+                            else
+                            {
+                                weightNew = 255;
+                            }
+                        }
+                        else
+                        {
+                            const int overlapStart = absStepY;
+                            if( y < overlapStart )
+                            {
+                                weightNew = 255;
+                            }
+                            else if( y < overlapStart + verticalFeather )
+                            {
+                                const int numerator = overlapStart + verticalFeather - y;
+                                weightNew = static_cast<BYTE>( max( 0, min( 255, ( numerator * 255 ) / max( 1, verticalFeather ) ) ) );
+                            }
+                            else
+                            {
+                                weightNew = 0;
+                            }
+                        }
+                    }
+                    else if( mostlyHorizontalMove && overlapWidth > 0 )
+                    {
+                        if( stepX > 0 )
+                        {
+                            const int overlapEnd = overlapWidth;
+                            if( x < overlapEnd - horizontalFeather )
+                            {
+                                weightNew = 0;
+                            }
+                            else if( x < overlapEnd )
+                            {
+                                const int numerator = x - ( overlapEnd - horizontalFeather );
+                                weightNew = static_cast<BYTE>( max( 0, min( 255, ( numerator * 255 ) / max( 1, horizontalFeather ) ) ) );
+                            }
+                            else
+                            {
+                                weightNew = 255;
+                            }
+                        }
+                        else
+                        {
+                            const int overlapStart = absStepX;
+                            if( x < overlapStart )
+                            {
+                                weightNew = 255;
+                            }
+                            else if( x < overlapStart + horizontalFeather )
+                            {
+                                const int numerator = overlapStart + horizontalFeather - x;
+                                weightNew = static_cast<BYTE>( max( 0, min( 255, ( numerator * 255 ) / max( 1, horizontalFeather ) ) ) );
+                            }
+                            else
+                            {
+                                weightNew = 0;
+                            }
+                        }
+                    }
+
+                    if( outWritten[dstMaskIndex] == 0 )
+                    {
+                        outPixels[dstIndex + 0] = activePixels[srcIndex + 0];
+                        outPixels[dstIndex + 1] = activePixels[srcIndex + 1];
+                        outPixels[dstIndex + 2] = activePixels[srcIndex + 2];
+                        outPixels[dstIndex + 3] = 0xFF;
+                        outWritten[dstMaskIndex] = 1;
+                        outOwner[dstMaskIndex] = static_cast<int>( frameIndex );
+                        outBlended[dstMaskIndex] = 0;
+                        continue;
+                    }
+
+                    if( weightNew == 0 )
+                    {
+                        continue;
+                    }
+
+                    if( weightNew == 255 )
+                    {
+                        outPixels[dstIndex + 0] = activePixels[srcIndex + 0];
+                        outPixels[dstIndex + 1] = activePixels[srcIndex + 1];
+                        outPixels[dstIndex + 2] = activePixels[srcIndex + 2];
+                        outPixels[dstIndex + 3] = 0xFF;
+                        outOwner[dstMaskIndex] = static_cast<int>( frameIndex );
+                        outBlended[dstMaskIndex] = 0;
+                        continue;
+                    }
+
+                    const int oldWeight = 255 - static_cast<int>( weightNew );
+                    outPixels[dstIndex + 0] = static_cast<BYTE>( ( static_cast<int>( outPixels[dstIndex + 0] ) * oldWeight +
+                                                                    static_cast<int>( activePixels[srcIndex + 0] ) * static_cast<int>( weightNew ) ) / 255 );
+                    outPixels[dstIndex + 1] = static_cast<BYTE>( ( static_cast<int>( outPixels[dstIndex + 1] ) * oldWeight +
+                                                                    static_cast<int>( activePixels[srcIndex + 1] ) * static_cast<int>( weightNew ) ) / 255 );
+                    outPixels[dstIndex + 2] = static_cast<BYTE>( ( static_cast<int>( outPixels[dstIndex + 2] ) * oldWeight +
+                                                                    static_cast<int>( activePixels[srcIndex + 2] ) * static_cast<int>( weightNew ) ) / 255 );
+                    outPixels[dstIndex + 3] = 0xFF;
+                    outBlended[dstMaskIndex] = 1;
+                    ++rowBlendPixelsThisFrame;
+                    rowBlendWeightSumThisFrame += static_cast<int>( weightNew );
+                    rowBlendWeightMinThisFrame = min( rowBlendWeightMinThisFrame, static_cast<int>( weightNew ) );
+                    rowBlendWeightMaxThisFrame = max( rowBlendWeightMaxThisFrame, static_cast<int>( weightNew ) );
+                }
+
+                if( rowSuppressedPixels > 0 )
+                {
+                    suppressedPixels.fetch_add( rowSuppressedPixels );
+                }
+
+                if( outRowBlendPixelCount != nullptr && rowBlendPixelsThisFrame > 0 )
+                {
+                    ( *outRowBlendPixelCount )[canvasY] += rowBlendPixelsThisFrame;
+                    ( *outRowBlendWeightSum )[canvasY] += rowBlendWeightSumThisFrame;
+                    ( *outRowBlendWeightMin )[canvasY] = min( ( *outRowBlendWeightMin )[canvasY], rowBlendWeightMinThisFrame );
+                    ( *outRowBlendWeightMax )[canvasY] = max( ( *outRowBlendWeightMax )[canvasY], rowBlendWeightMaxThisFrame );
+                    if( rowBlendPixelsThisFrame > ( *outRowBlendDominantPixels )[canvasY] )
+                    {
+                        ( *outRowBlendDominantFrame )[canvasY] = static_cast<int>( frameIndex );
+                        ( *outRowBlendDominantPixels )[canvasY] = rowBlendPixelsThisFrame;
+                    }
+                    if( rowBlendPixelsThisFrame == stitchedWidth )
+                    {
+                        const int fullWidthAverageWeight = rowBlendWeightSumThisFrame / rowBlendPixelsThisFrame;
+                        if( ( *outRowFullWidthBlendFirstPass )[canvasY] < 0 )
+                        {
+                            ( *outRowFullWidthBlendFirstFrame )[canvasY] = static_cast<int>( frameIndex );
+                            ( *outRowFullWidthBlendFirstPass )[canvasY] = static_cast<int>( i );
+                            ( *outRowFullWidthBlendFirstWeight )[canvasY] = fullWidthAverageWeight;
+                        }
+                        ( *outRowFullWidthBlendLastFrame )[canvasY] = static_cast<int>( frameIndex );
+                        ( *outRowFullWidthBlendLastPass )[canvasY] = static_cast<int>( i );
+                        ( *outRowFullWidthBlendLastWeight )[canvasY] = fullWidthAverageWeight;
+                        ( *outRowFullWidthBlendPassCount )[canvasY] += 1;
+                    }
+                }
+            }, kComposeRowGrain );
+        }
+
+        if( outSuppressedPixels != nullptr )
+        {
+            *outSuppressedPixels = suppressedPixels.load();
+        }
+        return true;
+    };
+
+    std::vector<BYTE> baselinePixels;
+    std::vector<BYTE> baselineWritten;
+    std::vector<int> baselineOwner;
+    std::vector<BYTE> baselineBlended;
+    if( !fixedOverlayMask.Empty() )
+    {
+        if( !composeFrames( nullptr,
+                            false,
+                            baselinePixels,
+                            baselineWritten,
+                            baselineOwner,
+                            baselineBlended,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr,
+                            nullptr ) )
+        {
+            return false;
+        }
+    }
+
+    std::vector<BYTE> suppressedCanvas;
+    if( !composeFrames( fixedOverlayMask.Empty() ? nullptr : &fixedOverlayMask,
+                        true,
+                        stitchedPixels,
+                        stitchedWritten,
+                        stitchedOwner,
+                        stitchedBlended,
+                        fixedOverlayMask.Empty() ? nullptr : &suppressedCanvas,
+                        &rowBlendPixelCount,
+                        &rowBlendWeightSum,
+                        &rowBlendWeightMin,
+                        &rowBlendWeightMax,
+                        &rowBlendDominantFrame,
+                        &rowBlendDominantPixels,
+                        &rowFullWidthBlendFirstFrame,
+                        &rowFullWidthBlendFirstPass,
+                        &rowFullWidthBlendFirstWeight,
+                        &rowFullWidthBlendLastFrame,
+                        &rowFullWidthBlendLastPass,
+                        &rowFullWidthBlendLastWeight,
+                        &rowFullWidthBlendPassCount,
+                        &overlayDiagnostics.suppressedPixels ) )
+    {
+        return false;
+    }
+
+    if( !fixedOverlayMask.Empty() )
+    {
+        overlayDiagnostics.repairedPixels = RepairSuppressedOverlayHoles( stitchedPixels,
+                                                                          stitchedWritten,
+                                                                          stitchedOwner,
+                                                                          stitchedBlended,
+                                                                          suppressedCanvas,
+                                                                          stitchedWidth,
+                                                                          stitchedHeight );
+
+        for( size_t pixelIndex = 0; pixelIndex < stitchedWritten.size(); ++pixelIndex )
+        {
+            if( stitchedWritten[pixelIndex] != 0 || baselineWritten[pixelIndex] == 0 )
+                continue;
+
+            if( !suppressedCanvas.empty() && suppressedCanvas[pixelIndex] != 0 )
+                continue;
+
+            const size_t colorIndex = pixelIndex * 4;
+            stitchedPixels[colorIndex + 0] = baselinePixels[colorIndex + 0];
+            stitchedPixels[colorIndex + 1] = baselinePixels[colorIndex + 1];
+            stitchedPixels[colorIndex + 2] = baselinePixels[colorIndex + 2];
+            stitchedPixels[colorIndex + 3] = baselinePixels[colorIndex + 3];
+            stitchedWritten[pixelIndex] = 1;
+            stitchedOwner[pixelIndex] = baselineOwner[pixelIndex];
+            stitchedBlended[pixelIndex] = baselineBlended[pixelIndex];
+            overlayDiagnostics.fallbackPixels++;
+        }
+
+        overlayDiagnostics.correctedDarkBands = RepairOverlayDarkBands( stitchedPixels,
+                                                                        stitchedWritten,
+                                                                        stitchedBlended,
+                                                                        overlayDiagnostics.tileBoundsLeft,
+                                                                        overlayDiagnostics.tileBoundsRight,
+                                                                        stitchedWidth,
+                                                                        stitchedHeight,
+                                                                        &overlayDiagnostics.correctedDarkBandRows );
+
+        StitchLog( L"[Panorama/Stitch] FixedOverlay compose: suppressedPixels=%llu repairedPixels=%llu fallbackPixels=%llu correctedDarkBands=%d correctedDarkBandRows=%d\n",
+                     overlayDiagnostics.suppressedPixels,
+                     overlayDiagnostics.repairedPixels,
+                     overlayDiagnostics.fallbackPixels,
+                     overlayDiagnostics.correctedDarkBands,
+                     overlayDiagnostics.correctedDarkBandRows );
+    }
+
+    LogComposedFrameDiagnostics( composedFrameIndices,
+                                 composedFrameOrigins,
+                                 composedFrameSteps,
+                                 frameWidth,
+                                 frameHeight );
+    LogCompositionCoverageDiagnostics( stitchedOwner,
+                                      stitchedWritten,
+                                      stitchedBlended,
+                                      stitchedWidth,
+                                      stitchedHeight );
+    LogSuspiciousTransitionWindowDiagnostics( stitchedPixels,
+                                              stitchedOwner,
+                                              stitchedWritten,
+                                              stitchedBlended,
+                                              rowBlendPixelCount,
+                                              rowBlendWeightSum,
+                                              rowBlendWeightMin,
+                                              rowBlendWeightMax,
+                                              rowBlendDominantFrame,
+                                              rowBlendDominantPixels,
+                                              rowFullWidthBlendFirstFrame,
+                                              rowFullWidthBlendFirstPass,
+                                              rowFullWidthBlendFirstWeight,
+                                              rowFullWidthBlendLastFrame,
+                                              rowFullWidthBlendLastPass,
+                                              rowFullWidthBlendLastWeight,
+                                              rowFullWidthBlendPassCount,
+                                              stitchedWidth,
+                                              stitchedHeight,
+                                              composedFrameIndices,
+                                              composedFrameOrigins,
+                                              composedFrameSteps,
+                                              frameWidth,
+                                              frameHeight,
+                                              verticalFeather,
+                                              horizontalFeather,
+                                              minX,
+                                              minY );
+    LogStitchedBandDiagnostics( stitchedPixels,
+                                stitchedOwner,
+                                stitchedWritten,
+                                stitchedBlended,
+                                rowBlendPixelCount,
+                                rowBlendWeightSum,
+                                rowBlendWeightMin,
+                                rowBlendWeightMax,
+                                rowFullWidthBlendFirstFrame,
+                                rowFullWidthBlendFirstPass,
+                                rowFullWidthBlendFirstWeight,
+                                rowFullWidthBlendLastFrame,
+                                rowFullWidthBlendLastPass,
+                                rowFullWidthBlendLastWeight,
+                                rowFullWidthBlendPassCount,
+                                stitchedWidth,
+                                stitchedHeight,
+                                composedFrameIndices,
+                                composedFrameOrigins,
+                                minY );
+    LogContentDuplicationDiagnostics( stitchedPixels,
+                                      stitchedOwner,
+                                      stitchedWidth,
+                                      stitchedHeight,
+                                      composedFrameIndices,
+                                      composedFrameOrigins,
+                                      composedFrameSteps,
+                                      frameHeight,
+                                      minY );
+
+    if( outComposedFrameCount )
+    {
+        *outComposedFrameCount = composedFrameIndices.size();
+    }
+    if( outComposedAxisSteps )
+    {
+        outComposedAxisSteps->clear();
+        outComposedAxisSteps->reserve( composedFrameSteps.size() > 0 ? composedFrameSteps.size() - 1 : 0 );
+        for( size_t si = 1; si < composedFrameSteps.size(); ++si )
+        {
+            const POINT& s = composedFrameSteps[si];
+            outComposedAxisSteps->push_back( max( abs( s.x ), abs( s.y ) ) );
+        }
+    }
+
+    outStitchedPixels = std::move( stitchedPixels );
+    outStitchedWidth = stitchedWidth;
+    outStitchedHeight = stitchedHeight;
+
+    endStage( timings.composeMs );
+    timings.totalMs = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - stitchStart ).count();
+    if( outTimings )
+    {
+        *outTimings = timings;
+    }
+
+    StitchLog( L"[Panorama/Stitch] Stitch complete durationMs=%.0f prepare=%.0f align=%.0f overlay=%.0f compose=%.0f\n",
+                 timings.totalMs,
+                 timings.prepareMs,
+                 timings.alignMs,
+                 timings.overlayMs,
+                 timings.composeMs );
+    reportProgress( 100 );
+    return true;
+}
+
+StreamingPanoramaStitch::StreamingPanoramaStitch( int frameWidth, int frameHeight, bool lowContrastMode ) :
+    m_frameWidth( frameWidth ),
+    m_frameHeight( frameHeight ),
+    m_lowContrastMode( lowContrastMode ),
+    m_minProgress( lowContrastMode ? max( 4, min( frameWidth, frameHeight ) / 40 ) : max( 8, min( frameWidth, frameHeight ) / 30 ) )
+{
+}
+
+void StreamingPanoramaStitch::AddFrame( std::vector<BYTE>& pixels )
+{
+    if( m_canvasFull ||
+        pixels.size() != static_cast<size_t>( m_frameWidth ) * static_cast<size_t>( m_frameHeight ) * 4 )
+    {
+        return;
+    }
+
+    m_submittedFrameCount++;
+    const double constantFraction = ComputeConstantContentFraction( pixels, m_frameWidth, m_frameHeight );
+    if( m_firstFramePixels.empty() )
+    {
+        m_firstFramePixels = pixels;
+        BuildFullLumaFrame( pixels, m_frameWidth, m_frameHeight, m_referenceLuma );
+        m_referencePixels = std::move( pixels );
+        m_referenceConstantFraction = constantFraction;
+        m_composedFrameCount = 1;
+        return;
+    }
+
+    // Same blank/transition frame rejection as StitchPanoramaPixels.
+    if( constantFraction > 0.999 )
+    {
+        StitchLog( L"[Panorama/Stream] Frame %zu rejected: blank frame constFrac=%.3f\n",
+                   m_submittedFrameCount, constantFraction );
+        return;
+    }
+
+    BuildFullLumaFrame( pixels, m_frameWidth, m_frameHeight, m_currentLuma );
+    const int veryLowEntropy = ( m_referenceConstantFraction > 0.58 && constantFraction > 0.58 ) ? 1 : 0;
+    int dx = m_expectedDx;
+    int dy = m_expectedDy;
+    bool nearStationary = false;
+    if( !FindBestFrameShift( m_referencePixels, pixels, m_frameWidth, m_frameHeight,
+                             m_expectedDx, m_expectedDy, dx, dy, m_lowContrastMode,
+                             m_referenceLuma, m_currentLuma, veryLowEntropy, &nearStationary ) )
+    {
+        m_consecutiveRejects++;
+        StitchLog( L"[Panorama/Stream] Frame %zu rejected: no shift found consecutive=%d\n",
+                   m_submittedFrameCount, m_consecutiveRejects );
+        if( m_consecutiveRejects == kMaxConsecutiveRejects )
+        {
+            StitchLog( L"[Panorama/Stream] Lost track of the scroll position\n" );
+            m_lostTrack = true;
+        }
+        return;
+    }
+    if( m_consecutiveRejects >= kMaxConsecutiveRejects )
+    {
+        StitchLog( L"[Panorama/Stream] Frame %zu realigned after %d rejects\n",
+                   m_submittedFrameCount, m_consecutiveRejects );
+    }
+    m_consecutiveRejects = 0;
+
+    // Same step filtering as StitchPanoramaPixels: a near-stationary match
+    // keeps the canvas in place but still becomes the reference, and
+    // movements too small to trust leave the reference unchanged.
+    int stepX = -dx;
+    int stepY = -dy;
+    if( nearStationary && abs( stepX ) + abs( stepY ) > m_minProgress )
+    {
+        StitchLog( L"[Panorama/Stream] Frame %zu near-stationary zero-step: original=(%d,%d)\n",
+                   m_submittedFrameCount, stepX, stepY );
+        stepX = 0;
+        stepY = 0;
+    }
+    else if( abs( stepX ) + abs( stepY ) < min( m_minProgress / 2, 4 ) )
+    {
+        StitchLog( L"[Panorama/Stream] Frame %zu rejected: low movement step=(%d,%d)\n",
+                   m_submittedFrameCount, stepX, stepY );
+        return;
+    }
+
+    if( !m_axisKnown && ( stepX != 0 || stepY != 0 ) )
+    {
+        m_axisKnown = true;
+        m_vertical = abs( stepY ) >= abs( stepX );
+        m_extentMax = m_vertical ? m_frameHeight : m_frameWidth;
+        StitchLog( L"[Panorama/Stream] Scroll axis %ls\n", m_vertical ? L"vertical" : L"horizontal" );
+    }
+
+    // FindBestFrameShift only searches along the established axis, so the
+    // cross-axis component is noise from the first pair at most.
+    const int step = m_vertical ? stepY : stepX;
+    if( step != 0 )
+    {
+        const int frameLength = m_vertical ? m_frameHeight : m_frameWidth;
+        const int position = m_position + step;
+        if( position + frameLength > m_extentMax )
+        {
+            AppendStrip( pixels, position, max( m_extentMax, position ), position + frameLength );
+        }
+        if( position < m_extentMin && !m_canvasFull )
+        {
+            AppendStrip( pixels, position, position, min( m_extentMin, position + frameLength ) );
+        }
+        m_position = position;
+    }
+
+    m_expectedDx = dx;
+    m_expectedDy = dy;
+    m_composedFrameCount++;
+    m_referencePixels.swap( pixels );
+    m_referenceLuma.swap( m_currentLuma );
+    m_referenceConstantFraction = constantFraction;
+}
+
+// Copies [begin, end) along the scroll axis, in canvas coordinates, out of a
+// frame placed at framePosition.
+void StreamingPanoramaStitch::AppendStrip( const std::vector<BYTE>& pixels, int framePosition, int begin, int end )
+{
+    if( max( m_extentMax, end ) - min( m_extentMin, begin ) > kMaxStitchedCanvasDimension )
+    {
+        // Keep the part next to the canvas and stop growing.
+        if( end > m_extentMax )
+        {
+            end = m_extentMin + kMaxStitchedCanvasDimension;
+        }
+        else
+        {
+            begin = m_extentMax - kMaxStitchedCanvasDimension;
+        }
+        StitchLog( L"[Panorama/Stream] Canvas reached %d pixels, stopping\n", kMaxStitchedCanvasDimension );
+        m_canvasFull = true;
+        if( end <= begin )
+        {
+            return;
+        }
+    }
+
+    Strip strip{ begin, end - begin, {} };
+    const size_t localBegin = static_cast<size_t>( begin - framePosition );
+    const size_t length = static_cast<size_t>( strip.length );
+    if( m_vertical )
+    {
+        const size_t rowBytes = static_cast<size_t>( m_frameWidth ) * 4;
+        strip.pixels.assign( pixels.begin() + localBegin * rowBytes, pixels.begin() + ( localBegin + length ) * rowBytes );
+    }
+    else
+    {
+        strip.pixels.resize( length * m_frameHeight * 4 );
+        for( int y = 0; y < m_frameHeight; ++y )
+        {
+            memcpy( strip.pixels.data() + static_cast<size_t>( y ) * length * 4,
+                    pixels.data() + ( static_cast<size_t>( y ) * m_frameWidth + localBegin ) * 4,
+                    length * 4 );
+        }
+    }
+
+    m_extentMin = min( m_extentMin, begin );
+    m_extentMax = max( m_extentMax, end );
+    m_strips.push_back( std::move( strip ) );
+}
+
+void StreamingPanoramaStitch::GetCanvasSize( int& width, int& height ) const
+{
+    if( m_firstFramePixels.empty() )
+    {
+        width = 0;
+        height = 0;
+        return;
+    }
+
+    const int canvasLength = m_axisKnown ? m_extentMax - m_extentMin : ( m_vertical ? m_frameHeight : m_frameWidth );
+    width = m_vertical ? m_frameWidth : canvasLength;
+    height = m_vertical ? canvasLength : m_frameHeight;
+}
+
+bool StreamingPanoramaStitch::ComposeInto( BYTE* canvas )
+{
+    if( m_firstFramePixels.empty() )
+    {
+        return false;
+    }
+
+    int canvasWidth = 0;
+    int canvasHeight = 0;
+    GetCanvasSize( canvasWidth, canvasHeight );
+    auto blit = [&]( const std::vector<BYTE>& source, int offset, int length )
+    {
+        const size_t canvasOffset = static_cast<size_t>( offset - m_extentMin );
+        if( m_vertical )
+        {
+            memcpy( canvas + canvasOffset * m_frameWidth * 4, source.data(), static_cast<size_t>( length ) * m_frameWidth * 4 );
+            return;
+        }
+        for( int y = 0; y < m_frameHeight; ++y )
+        {
+            memcpy( canvas + ( static_cast<size_t>( y ) * canvasWidth + canvasOffset ) * 4,
+                    source.data() + static_cast<size_t>( y ) * length * 4,
+                    static_cast<size_t>( length ) * 4 );
+        }
+    };
+
+    blit( m_firstFramePixels, 0, m_vertical ? m_frameHeight : m_frameWidth );
+    std::vector<BYTE>().swap( m_firstFramePixels );
+    for( Strip& strip : m_strips )
+    {
+        blit( strip.pixels, strip.offset, strip.length );
+        std::vector<BYTE>().swap( strip.pixels );
+    }
+
+    StitchLog( L"[Panorama/Stream] Finished canvas=%dx%d composed=%zu/%zu strips=%zu canvasFull=%d lostTrack=%d\n",
+               canvasWidth,
+               canvasHeight,
+               m_composedFrameCount,
+               m_submittedFrameCount,
+               m_strips.size(),
+               m_canvasFull ? 1 : 0,
+               m_lostTrack ? 1 : 0 );
+    m_strips.clear();
+    return true;
+}
+
+bool StreamingPanoramaStitch::Compose( std::vector<BYTE>& pixels, int& width, int& height )
+{
+    GetCanvasSize( width, height );
+    if( width <= 0 || height <= 0 )
+    {
+        return false;
+    }
+    pixels.assign( static_cast<size_t>( width ) * static_cast<size_t>( height ) * 4, 0 );
+    return ComposeInto( pixels.data() );
+}
@@ -0,0 +1,238 @@
+//============================================================================
+//
+// PanoramaStitch.h
+//
+// Panorama stitch engine: frame alignment and composition on 32-bpp BGRA
+// pixel buffers.  Has no dependency on GDI or the capture code so it can
+// also be built into the offline replay tool on other platforms.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//============================================================================
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+typedef unsigned char BYTE;
+struct POINT
+{
+    long x;
+    long y;
+};
+struct RECT
+{
+    long left;
+    long top;
+    long right;
+    long bottom;
+};
+#endif
+
+// Hard upper bound on the stitched canvas width and height.  CreateDIBSection
+// uses LONG dimensions and supports values well beyond 32767.  65535 allows
+// ~300 MP at typical aspect ratios while staying within practical memory
+// limits.
+constexpr int kMaxStitchedCanvasDimension = 65535;
+
+// Receives the stitch trace.  enabled is checked before a message is
+// formatted so tracing costs nothing when it is off.
+struct PanoramaStitchLogSink
+{
+    bool (*enabled)();
+    void (*write)( const wchar_t* message );
+};
+
+void SetPanoramaStitchLogSink( const PanoramaStitchLogSink& sink );
+
+// Wall-clock milliseconds spent in each stage of StitchPanoramaPixels.
+struct PanoramaStitchTimings
+{
+    double prepareMs;       // Luma and constant-content analysis of every frame
+    double alignMs;         // Pairwise shift search and frame selection
+    double overlayMs;       // Fixed overlay (sticky header/footer) detection
+    double composeMs;       // Canvas composition, repair passes, diagnostics
+    double totalMs;
+};
+
+// Stitches frames of frameWidth x frameHeight top-down BGRA pixels into
+// stitchedPixels.  progressCallback receives 0-100 and returns true to
+// cancel.  Returns false if the frames could not be stitched or the
+// stitch was cancelled.
+bool StitchPanoramaPixels( const std::vector<std::vector<BYTE>>& framePixels,
+                           int frameWidth,
+                           int frameHeight,
+                           bool lowContrastMode,
+                           std::function<bool( int )> progressCallback,
+                           std::vector<BYTE>& stitchedPixels,
+                           int& stitchedWidth,
+                           int& stitchedHeight,
+                           size_t* outComposedFrameCount = nullptr,
+                           std::vector<int>* outComposedAxisSteps = nullptr,
+                           PanoramaStitchTimings* outTimings = nullptr );
+
+//
+// Building blocks shared with the capture loop and the self-tests.
+//
+void BuildFullLumaFrame( const std::vector<BYTE>& pixels,
+                         int frameWidth,
+                         int frameHeight,
+                         std::vector<BYTE>& luma );
+
+double ComputeConstantContentFraction( const std::vector<BYTE>& pixels,
+                                       int frameWidth,
+                                       int frameHeight );
+
+bool ArePixelFramesNearDuplicateCore( const std::vector<BYTE>& currentPixels,
+                                      const std::vector<BYTE>& previousPixels,
+                                      int frameWidth,
+                                      int frameHeight,
+                                      bool lowContrastMode,
+                                      bool verbose );
+
+bool FindBestFrameShiftVerticalOnly( const std::vector<BYTE>& previousPixels,
+                                     const std::vector<BYTE>& currentPixels,
+                                     int frameWidth,
+                                     int frameHeight,
+                                     int expectedDx,
+                                     int expectedDy,
+                                     int& bestDx,
+                                     int& bestDy,
+                                     bool lowContrastMode,
+                                     const std::vector<BYTE>& precomputedPrevLuma = {},
+                                     const std::vector<BYTE>& precomputedCurrLuma = {},
+                                     int precomputedVeryLowEntropy = -1,
+                                     bool* outNearStationaryOverride = nullptr,
+                                     bool allowHighConstStationaryRelax = false,
+                                     uint64_t* outMaskedStationaryScore = nullptr,
+                                     bool forceExhaustiveProbeBudget = false,
+                                     bool forceExhaustiveFineDx = false );
+
+bool FindBestFrameShift( const std::vector<BYTE>& previousPixels,
+                         const std::vector<BYTE>& currentPixels,
+                         int frameWidth,
+                         int frameHeight,
+                         int expectedDx,
+                         int expectedDy,
+                         int& bestDx,
+                         int& bestDy,
+                         bool lowContrastMode,
+                         const std::vector<BYTE>& precomputedPrevLuma = {},
+                         const std::vector<BYTE>& precomputedCurrLuma = {},
+                         int precomputedVeryLowEntropy = -1,
+                         bool* outNearStationaryOverride = nullptr,
+                         bool allowHighConstStationaryRelax = false,
+                         uint64_t* outMaskedStationaryScore = nullptr );
+
+// Incremental stitcher for the capture loop.  Each frame is aligned against
+// the last composed one as it arrives and only the strip of content it
+// reveals beyond the canvas is kept, so memory is bounded by the canvas and
+// the reference frame and the image is ready as soon as the last frame has
+// been added.
+//
+// Unlike StitchPanoramaPixels there is no pass over all frames: no fixed
+// overlay suppression, no feathering, and a frame that fails to align is
+// dropped instead of going through the retry heuristics.  Sticky headers
+// do not repeat because only newly revealed content is appended.
+//
+// AddFrame and Compose must be called from one thread at a time;
+// IsCanvasFull and HasLostTrack may be polled from any thread.
+class StreamingPanoramaStitch
+{
+public:
+    StreamingPanoramaStitch( int frameWidth, int frameHeight, bool lowContrastMode );
+
+    StreamingPanoramaStitch( const StreamingPanoramaStitch& ) = delete;
+    StreamingPanoramaStitch& operator=( const StreamingPanoramaStitch& ) = delete;
+
+    // Aligns a frame of frameWidth x frameHeight top-down BGRA pixels and
+    // appends what it reveals.  The contents of pixels are consumed.
+    void AddFrame( std::vector<BYTE>& pixels );
+
+    // The canvas reached kMaxStitchedCanvasDimension along the scroll axis;
+    // later frames are ignored.
+    bool IsCanvasFull() const
+    {
+        return m_canvasFull;
+    }
+
+    // kMaxConsecutiveRejects frames in a row failed to align against the
+    // reference, so content scrolled past meanwhile may be missing from the
+    // canvas.  Later frames are still aligned against the reference, which
+    // picks the capture up again once the user scrolls back to it.
+    bool HasLostTrack() const
+    {
+        return m_lostTrack;
+    }
+
+    size_t SubmittedFrameCount() const
+    {
+        return m_submittedFrameCount;
+    }
+
+    size_t ComposedFrameCount() const
+    {
+        return m_composedFrameCount;
+    }
+
+    // Size of the canvas built so far, zero before the first frame.
+    void GetCanvasSize( int& width, int& height ) const;
+
+    // Writes the canvas as GetCanvasSize top-down BGRA pixels into canvas
+    // and releases the kept strips, so it can be called only once.
+    bool ComposeInto( BYTE* canvas );
+
+    bool Compose( std::vector<BYTE>& pixels, int& width, int& height );
+
+    static constexpr int kMaxConsecutiveRejects = 12;
+
+private:
+    struct Strip
+    {
+        // Position and extent along the scroll axis in canvas coordinates,
+        // where the first frame starts at 0.
+        int offset;
+        int length;
+        // Rows of the strip for vertical captures, columns (stored row by
+        // row, length pixels wide) for horizontal ones.
+        std::vector<BYTE> pixels;
+    };
+
+    void AppendStrip( const std::vector<BYTE>& pixels, int framePosition, int begin, int end );
+
+    const int m_frameWidth;
+    const int m_frameHeight;
+    const bool m_lowContrastMode;
+    const int m_minProgress;
+
+    std::atomic<bool> m_canvasFull{ false };
+    std::atomic<bool> m_lostTrack{ false };
+
+    // The reference is the last composed frame; positions are along the
+    // scroll axis with the first frame at 0.
+    std::vector<BYTE> m_firstFramePixels;
+    std::vector<BYTE> m_referencePixels;
+    std::vector<BYTE> m_referenceLuma;
+    std::vector<BYTE> m_currentLuma;
+    double m_referenceConstantFraction = 0.0;
+    int m_expectedDx = 0;
+    int m_expectedDy = 0;
+    int m_consecutiveRejects = 0;
+    bool m_axisKnown = false;
+    bool m_vertical = true;
+    int m_position = 0;
+    int m_extentMin = 0;
+    int m_extentMax = 0;
+    std::vector<Strip> m_strips;
+    size_t m_submittedFrameCount = 0;
+    size_t m_composedFrameCount = 0;
+};
@@ -0,0 +1,296 @@
+//============================================================================
+//
+// TaskScheduler.cpp
+//
+// Persistent worker pool behind ParallelFor.  Each dispatch splits its range
+// into one share per participating thread (the caller plus every worker).
+// A thread takes grains from the front of its own share and, once that is
+// empty, steals the back half of another thread's share, so uneven items
+// (panorama shift candidates, rows that are mostly masked) still balance.
+//
+// This file must not depend on windows.h so the panorama replay tool can
+// build it on Linux.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//
+//============================================================================
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TASK_SCHEDULER_SPIN_PAUSE() _mm_pause()
+#else
+#define TASK_SCHEDULER_SPIN_PAUSE() std::this_thread::yield()
+#endif
+
+namespace
+{
+
+constexpr int kMaxParticipants = 64;
+
+// Iterations a worker polls for the next dispatch before blocking.  Stitch
+// and blur dispatches arrive in bursts a few microseconds apart, and a
+// condition-variable wake costs far more than that.
+constexpr int kIdleSpinIterations = 4000;
+
+// A share is [begin, end) packed into one word so the owner taking grains
+// from the front and a thief splitting off the back agree through a single
+// compare-exchange.  Padded to a cache line so that threads working their
+// own shares don't contend for the same line.
+struct RangeShare
+{
+    std::atomic<uint64_t> range;
+    char padding[64 - sizeof( std::atomic<uint64_t> )];
+};
+
+uint64_t PackRange( int begin, int end )
+{
+    return ( static_cast<uint64_t>( static_cast<uint32_t>( begin ) ) << 32 ) | static_cast<uint32_t>( end );
+}
+
+int RangeBegin( uint64_t range )
+{
+    return static_cast<int32_t>( static_cast<uint32_t>( range >> 32 ) );
+}
+
+int RangeEnd( uint64_t range )
+{
+    return static_cast<int32_t>( static_cast<uint32_t>( range ) );
+}
+
+struct ParallelJob
+{
+    ParallelRangeBody body;
+    const void* context;
+    int grainSize;
+    int shareCount;
+    RangeShare shares[kMaxParticipants];
+};
+
+// Set while a thread runs dispatch bodies; nested dispatches run inline.
+thread_local bool t_insideParallelFor = false;
+
+bool TakeFromFront( ParallelJob& job, int self, int& rangeBegin, int& rangeEnd )
+{
+    std::atomic<uint64_t>& share = job.shares[self].range;
+    uint64_t range = share.load( std::memory_order_acquire );
+    for( ;; )
+    {
+        const int begin = RangeBegin( range );
+        const int end = RangeEnd( range );
+        if( begin >= end )
+        {
+            return false;
+        }
+        const int take = ( end - begin > job.grainSize ) ? begin + job.grainSize : end;
+        if( share.compare_exchange_weak( range, PackRange( take, end ), std::memory_order_acq_rel ) )
+        {
+            rangeBegin = begin;
+            rangeEnd = take;
+            return true;
+        }
+    }
+}
+
+// Moves the back half of another share (all of it if that is a single
+// grain) into this thread's own, now empty, share.
+bool StealIntoOwnShare( ParallelJob& job, int self )
+{
+    for( int offset = 1; offset < job.shareCount; ++offset )
+    {
+        std::atomic<uint64_t>& victim = job.shares[( self + offset ) % job.shareCount].range;
+        uint64_t range = victim.load( std::memory_order_acquire );
+        for( ;; )
+        {
+            const int begin = RangeBegin( range );
+            const int end = RangeEnd( range );
+            const int remaining = end - begin;
+            if( remaining <= 0 )
+            {
+                break;
+            }
+            const int split = ( remaining > job.grainSize ) ? end - remaining / 2 : begin;
+            if( victim.compare_exchange_weak( range, PackRange( begin, split ), std::memory_order_acq_rel ) )
+            {
+                job.shares[self].range.store( PackRange( split, end ), std::memory_order_release );
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void RunParticipant( ParallelJob& job, int self )
+{
+    int rangeBegin = 0;
+    int rangeEnd = 0;
+    for( ;; )
+    {
+        if( TakeFromFront( job, self, rangeBegin, rangeEnd ) )
+        {
+            job.body( job.context, rangeBegin, rangeEnd );
+        }
+        else if( !StealIntoOwnShare( job, self ) )
+        {
+            return;
+        }
+    }
+}
+
+class TaskScheduler
+{
+public:
+    static TaskScheduler& Instance()
+    {
+        // Deliberately never destroyed: workers park on the condition
+        // variable and go away with the process, which avoids joining
+        // threads during static destruction.
+        static TaskScheduler* scheduler = new TaskScheduler();
+        return *scheduler;
+    }
+
+    int Concurrency() const
+    {
+        return static_cast<int>( m_workers.size() ) + 1;
+    }
+
+    void Run( int begin, int end, int grainSize, ParallelRangeBody body, const void* context )
+    {
+        const int count = end - begin;
+        if( m_workers.empty() || count <= grainSize || t_insideParallelFor )
+        {
+            body( context, begin, end );
+            return;
+        }
+
+        // One dispatch owns the workers at a time.  A concurrent caller
+        // (the capture worker stitching while the webcam blurs, say) runs
+        // its range itself rather than queueing behind the other job.
+        std::unique_lock<std::mutex> dispatchLock( m_dispatchMutex, std::try_to_lock );
+        if( !dispatchLock.owns_lock() )
+        {
+            body( context, begin, end );
+            return;
+        }
+
+        ParallelJob job;
+        job.body = body;
+        job.context = context;
+        job.grainSize = grainSize;
+        job.shareCount = Concurrency();
+        const int64_t grains = ( static_cast<int64_t>( count ) + grainSize - 1 ) / grainSize;
+        for( int i = 0; i < job.shareCount; ++i )
+        {
+            const int shareBegin = begin + static_cast<int>( ( std::min )( static_cast<int64_t>( count ), grains * i / job.shareCount * grainSize ) );
+            const int shareEnd = begin + static_cast<int>( ( std::min )( static_cast<int64_t>( count ), grains * ( i + 1 ) / job.shareCount * grainSize ) );
+            job.shares[i].range.store( PackRange( shareBegin, shareEnd ), std::memory_order_relaxed );
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_job = &job;
+            m_generation.fetch_add( 1, std::memory_order_release );
+        }
+        m_wake.notify_all();
+
+        t_insideParallelFor = true;
+        RunParticipant( job, 0 );
+        t_insideParallelFor = false;
+
+        // Close the job so workers that wake late skip it, then wait for
+        // the ones that joined to finish their last grain.  The count lives
+        // in the scheduler, not the job, so the final notify never touches
+        // the caller's stack after it has returned.
+        {
+            std::lock_guard<std::mutex> lock( m_mutex );
+            m_job = nullptr;
+        }
+        for( int active = m_activeWorkers.load( std::memory_order_acquire ); active != 0;
+             active = m_activeWorkers.load( std::memory_order_acquire ) )
+        {
+            m_activeWorkers.wait( active, std::memory_order_acquire );
+        }
+    }
+
+private:
+    TaskScheduler()
+    {
+        const int hardwareThreads = static_cast<int>( std::thread::hardware_concurrency() );
+        const int workerCount = std::clamp( hardwareThreads - 1, 0, kMaxParticipants - 1 );
+        m_workers.reserve( workerCount );
+        for( int i = 0; i < workerCount; ++i )
+        {
+            m_workers.emplace_back( [this, i]() { WorkerLoop( i + 1 ); } );
+        }
+    }
+
+    void WorkerLoop( int self )
+    {
+        t_insideParallelFor = true;
+        uint64_t seenGeneration = 0;
+        for( ;; )
+        {
+            for( int spin = 0; spin < kIdleSpinIterations &&
+                               m_generation.load( std::memory_order_acquire ) == seenGeneration; ++spin )
+            {
+                TASK_SCHEDULER_SPIN_PAUSE();
+            }
+
+            ParallelJob* job = nullptr;
+            {
+                std::unique_lock<std::mutex> lock( m_mutex );
+                m_wake.wait( lock, [&]() { return m_generation.load( std::memory_order_relaxed ) != seenGeneration; } );
+                seenGeneration = m_generation.load( std::memory_order_relaxed );
+                job = m_job;
+                if( job == nullptr )
+                {
+                    continue;
+                }
+                m_activeWorkers.fetch_add( 1, std::memory_order_relaxed );
+            }
+
+            RunParticipant( *job, self );
+
+            if( m_activeWorkers.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+            {
+                m_activeWorkers.notify_one();
+            }
+        }
+    }
+
+    std::mutex m_dispatchMutex;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_generation{ 0 };
+    std::atomic<int> m_activeWorkers{ 0 };
+    ParallelJob* m_job = nullptr;
+    std::vector<std::thread> m_workers;
+};
+
+}
+
+void ParallelForRanges( int begin, int end, int grainSize, ParallelRangeBody body, const void* context )
+{
+    if( end <= begin )
+    {
+        return;
+    }
+    TaskScheduler::Instance().Run( begin, end, ( std::max )( grainSize, 1 ), body, context );
+}
+
+int TaskSchedulerConcurrency()
+{
+    return TaskScheduler::Instance().Concurrency();
+}
@@ -0,0 +1,44 @@
+//============================================================================
+//
+// TaskScheduler.h
+//
+// Process-wide data-parallel scheduler for ZoomIt's CPU image kernels
+// (panorama stitch, background blur, webcam composite).  A fixed set of
+// worker threads is started on first use and kept for the life of the
+// process, so a dispatch costs a wake-up rather than a thread creation.
+// Portable C++ so it also builds into the panorama replay tool.
+//
+// Copyright (C) Mark Russinovich
+// Sysinternals - www.sysinternals.com
+//
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+//============================================================================
+#pragma once
+
+typedef void (*ParallelRangeBody)( const void* context, int rangeBegin, int rangeEnd );
+
+// Calls body( context, rangeBegin, rangeEnd ) for disjoint sub-ranges that
+// together cover [begin, end), in no particular order and possibly on
+// several threads at once.  Sub-ranges hold grainSize items (fewer only at
+// the end of a share), so grainSize should cover enough work to amortize
+// one atomic operation.  Returns when every item has run.
+//
+// Calls made from inside a body, or while another thread's dispatch owns
+// the workers, run serially on the calling thread instead of waiting for
+// workers, so nesting cannot deadlock.  Bodies must not throw.
+void ParallelForRanges( int begin, int end, int grainSize, ParallelRangeBody body, const void* context );
+
+// Number of threads a dispatch can use, including the caller.
+int TaskSchedulerConcurrency();
+
+template<typename Func>
+void ParallelFor( int begin, int end, int grainSize, const Func& body )
+{
+    ParallelForRanges( begin, end, grainSize,
+                       []( const void* context, int rangeBegin, int rangeEnd )
+                       {
+                           ( *static_cast<const Func*>( context ) )( rangeBegin, rangeEnd );
+                       },
+                       &body );
+}
@@ -12,6 +12,7 @@
 #include "pch.h"
 #include "WebcamCapture.h"
 #include "BackgroundBlur.h"
+#include "TaskScheduler.h"
 #include <strmif.h>    // IAMVideoProcAmp, IAMCameraControl
 #include <vidcap.h>    // VideoProcAmp enums
 
@@ -25,6 +26,9 @@
 // Defined in Zoomit.cpp; compiles to nothing in Release builds.
 void OutputDebug(const TCHAR* format, ...);
 
+// Output rows per task scheduler grain in the CPU composite passes.
+constexpr int kCompositeRowGrain = 8;
+
 #pragma comment(lib, "mf.lib")
 #pragma comment(lib, "mfplat.lib")
 #pragma comment(lib, "mfreadwrite.lib")
@@ -1276,23 +1280,26 @@ void WebcamCapture::CaptureThread()
             const float cornerRadius = min( halfW, halfH ) *
                 ( m_shape == RoundedSquare ? 0.40f : 0.10f );
 
-            for( UINT y = 0; y < procH; y++ )
+            ParallelFor( 0, static_cast<int>( procH ), kCompositeRowGrain, [&]( int rowBegin, int rowEnd )
             {
-                // Simple nearest-neighbor downsample for blur input.
-                // Quality doesn't matter here — the result will be blurred.
-                const UINT srcY = srcCropY + y * srcCropH / procH;
-                const UINT32* srcRow = srcPixels + static_cast<size_t>( srcY ) * srcW32;
-                UINT32* dstRow = dstPixels + static_cast<size_t>( y ) * procW;
-                for( UINT x = 0; x < procW; x++ )
+                for( UINT y = static_cast<UINT>( rowBegin ); y < static_cast<UINT>( rowEnd ); y++ )
                 {
-                    const UINT srcX = srcCropX + x * srcCropW / procW;
-                    UINT32 pixel = srcRow[srcX];
-                    UINT32 b = m_gammaLUT[(pixel      ) & 0xFF];
-                    UINT32 g = m_gammaLUT[(pixel >>  8) & 0xFF];
-                    UINT32 r = m_gammaLUT[(pixel >> 16) & 0xFF];
-                    dstRow[x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+                    // Simple nearest-neighbor downsample for blur input.
+                    // Quality doesn't matter here — the result will be blurred.
+                    const UINT srcY = srcCropY + y * srcCropH / procH;
+                    const UINT32* srcRow = srcPixels + static_cast<size_t>( srcY ) * srcW32;
+                    UINT32* dstRow = dstPixels + static_cast<size_t>( y ) * procW;
+                    for( UINT x = 0; x < procW; x++ )
+                    {
+                        const UINT srcX = srcCropX + x * srcCropW / procW;
+                        UINT32 pixel = srcRow[srcX];
+                        UINT32 b = m_gammaLUT[(pixel      ) & 0xFF];
+                        UINT32 g = m_gammaLUT[(pixel >>  8) & 0xFF];
+                        UINT32 r = m_gammaLUT[(pixel >> 16) & 0xFF];
+                        dstRow[x] = 0xFF000000u | (r << 16) | (g << 8) | b;
+                    }
                 }
-            }
+            } );
 
             // Apply background processing at the capped processing
             // resolution — dramatically faster than full output size.
@@ -1441,135 +1448,138 @@ void WebcamCapture::CaptureThread()
                 const float cornerRadiusOut = min( halfWOut, halfHOut ) *
                     ( m_shape == RoundedSquare ? 0.40f : 0.10f );
 
-                for( UINT y = 0; y < ovH; y++ )
+                ParallelFor( 0, static_cast<int>( ovH ), kCompositeRowGrain, [&]( int rowBegin, int rowEnd )
                 {
-                    // Camera bilinear Y setup.
-                    const float camYf = srcCropY + ( y + 0.5f ) * srcCropH / static_cast<float>( ovH ) - 0.5f;
-                    const float camYfl = floorf( max( 0.0f, camYf ) );
-                    const UINT  cy0 = static_cast<UINT>( camYfl );
-                    const UINT  cy1 = min( cy0 + 1, m_camHeight - 1 );
-                    const float cfy = camYf - camYfl;
-                    const float cify = 1.0f - cfy;
-                    const UINT32* camRow0 = srcPixels + static_cast<size_t>( cy0 ) * srcW32;
-                    const UINT32* camRow1 = srcPixels + static_cast<size_t>( cy1 ) * srcW32;
-
-                    // Blur buffer Y setup (nearest-neighbor for Y — blur hides it).
-                    const UINT blurY = min( static_cast<UINT>( ( y + 0.5f ) * procH / static_cast<float>( ovH ) ), procH - 1 );
-                    const UINT32* blurRow = reinterpret_cast<const UINT32*>( m_backgroundBlur->GetBlurredFrame().data() )
-                                            + static_cast<size_t>( blurY ) * procW;
-
-                    // Mask Y — nearest-neighbor sample.
-                    const UINT my = min( static_cast<UINT>( ( y + 0.5f ) * maskH / static_cast<float>( ovH ) ), maskH - 1 );
-                    const float* maskRow = mask + static_cast<size_t>( my ) * maskW;
-
-                    UINT32* outRow = outBuf + static_cast<size_t>( y ) * ovW;
-
-                    for( UINT x = 0; x < ovW; x++ )
+                    for( UINT y = static_cast<UINT>( rowBegin ); y < static_cast<UINT>( rowEnd ); y++ )
                     {
-                        // Shape mask check (at overlay size).
-                        bool inside = true;
-                        if( m_shape == Circle )
-                        {
-                            float radius = min( halfWOut, halfHOut );
-                            float dx = ( x + 0.5f - halfWOut ) / radius;
-                            float dy = ( y + 0.5f - halfHOut ) / radius;
-                            inside = ( dx * dx + dy * dy ) <= 1.0f;
-                        }
-                        else if( m_shape == RoundedRect || m_shape == RoundedSquare )
+                        // Camera bilinear Y setup.
+                        const float camYf = srcCropY + ( y + 0.5f ) * srcCropH / static_cast<float>( ovH ) - 0.5f;
+                        const float camYfl = floorf( max( 0.0f, camYf ) );
+                        const UINT  cy0 = static_cast<UINT>( camYfl );
+                        const UINT  cy1 = min( cy0 + 1, m_camHeight - 1 );
+                        const float cfy = camYf - camYfl;
+                        const float cify = 1.0f - cfy;
+                        const UINT32* camRow0 = srcPixels + static_cast<size_t>( cy0 ) * srcW32;
+                        const UINT32* camRow1 = srcPixels + static_cast<size_t>( cy1 ) * srcW32;
+
+                        // Blur buffer Y setup (nearest-neighbor for Y — blur hides it).
+                        const UINT blurY = min( static_cast<UINT>( ( y + 0.5f ) * procH / static_cast<float>( ovH ) ), procH - 1 );
+                        const UINT32* blurRow = reinterpret_cast<const UINT32*>( m_backgroundBlur->GetBlurredFrame().data() )
+                                                + static_cast<size_t>( blurY ) * procW;
+
+                        // Mask Y — nearest-neighbor sample.
+                        const UINT my = min( static_cast<UINT>( ( y + 0.5f ) * maskH / static_cast<float>( ovH ) ), maskH - 1 );
+                        const float* maskRow = mask + static_cast<size_t>( my ) * maskW;
+
+                        UINT32* outRow = outBuf + static_cast<size_t>( y ) * ovW;
+
+                        for( UINT x = 0; x < ovW; x++ )
                         {
-                            float px = x + 0.5f, py = y + 0.5f;
-                            float cx2 = 0, cy2 = 0;
-                            bool inCorner = false;
-                            if( px < cornerRadiusOut && py < cornerRadiusOut )
-                            { cx2 = cornerRadiusOut; cy2 = cornerRadiusOut; inCorner = true; }
-                            else if( px > ovW - cornerRadiusOut && py < cornerRadiusOut )
-                            { cx2 = ovW - cornerRadiusOut; cy2 = cornerRadiusOut; inCorner = true; }
-                            else if( px < cornerRadiusOut && py > ovH - cornerRadiusOut )
-                            { cx2 = cornerRadiusOut; cy2 = ovH - cornerRadiusOut; inCorner = true; }
-                            else if( px > ovW - cornerRadiusOut && py > ovH - cornerRadiusOut )
-                            { cx2 = ovW - cornerRadiusOut; cy2 = ovH - cornerRadiusOut; inCorner = true; }
-                            if( inCorner )
+                            // Shape mask check (at overlay size).
+                            bool inside = true;
+                            if( m_shape == Circle )
                             {
-                                float ddx2 = px - cx2, ddy2 = py - cy2;
-                                inside = ( ddx2 * ddx2 + ddy2 * ddy2 ) <= ( cornerRadiusOut * cornerRadiusOut );
+                                float radius = min( halfWOut, halfHOut );
+                                float dx = ( x + 0.5f - halfWOut ) / radius;
+                                float dy = ( y + 0.5f - halfHOut ) / radius;
+                                inside = ( dx * dx + dy * dy ) <= 1.0f;
+                            }
+                            else if( m_shape == RoundedRect || m_shape == RoundedSquare )
+                            {
+                                float px = x + 0.5f, py = y + 0.5f;
+                                float cx2 = 0, cy2 = 0;
+                                bool inCorner = false;
+                                if( px < cornerRadiusOut && py < cornerRadiusOut )
+                                { cx2 = cornerRadiusOut; cy2 = cornerRadiusOut; inCorner = true; }
+                                else if( px > ovW - cornerRadiusOut && py < cornerRadiusOut )
+                                { cx2 = ovW - cornerRadiusOut; cy2 = cornerRadiusOut; inCorner = true; }
+                                else if( px < cornerRadiusOut && py > ovH - cornerRadiusOut )
+                                { cx2 = cornerRadiusOut; cy2 = ovH - cornerRadiusOut; inCorner = true; }
+                                else if( px > ovW - cornerRadiusOut && py > ovH - cornerRadiusOut )
+                                { cx2 = ovW - cornerRadiusOut; cy2 = ovH - cornerRadiusOut; inCorner = true; }
+                                if( inCorner )
+                                {
+                                    float ddx2 = px - cx2, ddy2 = py - cy2;
+                                    inside = ( ddx2 * ddx2 + ddy2 * ddy2 ) <= ( cornerRadiusOut * cornerRadiusOut );
+                                }
                             }
-                        }
 
-                        if( !inside )
-                        {
-                            outRow[x] = 0x00000000u;
-                            continue;
-                        }
+                            if( !inside )
+                            {
+                                outRow[x] = 0x00000000u;
+                                continue;
+                            }
 
-                        // Mask sample (nearest-neighbor — mask is soft already).
-                        const UINT mx = min( static_cast<UINT>( ( x + 0.5f ) * maskW / static_cast<float>( ovW ) ), maskW - 1 );
-                        float maskVal = maskRow[mx];
+                            // Mask sample (nearest-neighbor — mask is soft already).
+                            const UINT mx = min( static_cast<UINT>( ( x + 0.5f ) * maskW / static_cast<float>( ovW ) ), maskW - 1 );
+                            float maskVal = maskRow[mx];
 
-                        UINT32 r, g, b;
+                            UINT32 r, g, b;
 
-                        if( maskVal >= 1.0f )
-                        {
-                            // Foreground: bilinear from full-res camera.
-                            const float camXf = srcCropX + ( x + 0.5f ) * srcCropW / static_cast<float>( ovW ) - 0.5f;
-                            const float camXfl = floorf( max( 0.0f, camXf ) );
-                            const UINT  cx0 = static_cast<UINT>( camXfl );
-                            const UINT  cx1 = min( cx0 + 1, srcW32 - 1 );
-                            const float cfx = camXf - camXfl;
-                            const float cifx = 1.0f - cfx;
-
-                            UINT32 p00 = camRow0[cx0], p10 = camRow0[cx1];
-                            UINT32 p01 = camRow1[cx0], p11 = camRow1[cx1];
-                            float w00 = cifx * cify, w10 = cfx * cify;
-                            float w01 = cifx * cfy,  w11 = cfx * cfy;
-
-                            b = m_gammaLUT[static_cast<uint8_t>( w00*(p00 & 0xFF) + w10*(p10 & 0xFF) + w01*(p01 & 0xFF) + w11*(p11 & 0xFF) + 0.5f )];
-                            g = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>8)&0xFF) + w10*((p10>>8)&0xFF) + w01*((p01>>8)&0xFF) + w11*((p11>>8)&0xFF) + 0.5f )];
-                            r = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>16)&0xFF) + w10*((p10>>16)&0xFF) + w01*((p01>>16)&0xFF) + w11*((p11>>16)&0xFF) + 0.5f )];
-                        }
-                        else if( maskVal <= 0.0f )
-                        {
-                            // Background: nearest-neighbor from blurred proc buffer
-                            // (blur already hides any interpolation artefacts).
-                            const UINT bx = min( static_cast<UINT>( ( x + 0.5f ) * procW / static_cast<float>( ovW ) ), procW - 1 );
-                            UINT32 px = blurRow[bx];
-                            b = ( px       ) & 0xFF;
-                            g = ( px >>  8 ) & 0xFF;
-                            r = ( px >> 16 ) & 0xFF;
-                        }
-                        else
-                        {
-                            // Edge: blend camera foreground with blurred background.
-                            const float camXf = srcCropX + ( x + 0.5f ) * srcCropW / static_cast<float>( ovW ) - 0.5f;
-                            const float camXfl = floorf( max( 0.0f, camXf ) );
-                            const UINT  cx0 = static_cast<UINT>( camXfl );
-                            const UINT  cx1 = min( cx0 + 1, srcW32 - 1 );
-                            const float cfx = camXf - camXfl;
-                            const float cifx = 1.0f - cfx;
-
-                            UINT32 p00 = camRow0[cx0], p10 = camRow0[cx1];
-                            UINT32 p01 = camRow1[cx0], p11 = camRow1[cx1];
-                            float w00 = cifx * cify, w10 = cfx * cify;
-                            float w01 = cifx * cfy,  w11 = cfx * cfy;
-
-                            UINT32 fb = m_gammaLUT[static_cast<uint8_t>( w00*(p00 & 0xFF) + w10*(p10 & 0xFF) + w01*(p01 & 0xFF) + w11*(p11 & 0xFF) + 0.5f )];
-                            UINT32 fg = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>8)&0xFF) + w10*((p10>>8)&0xFF) + w01*((p01>>8)&0xFF) + w11*((p11>>8)&0xFF) + 0.5f )];
-                            UINT32 fr = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>16)&0xFF) + w10*((p10>>16)&0xFF) + w01*((p01>>16)&0xFF) + w11*((p11>>16)&0xFF) + 0.5f )];
-
-                            const UINT bx = min( static_cast<UINT>( ( x + 0.5f ) * procW / static_cast<float>( ovW ) ), procW - 1 );
-                            UINT32 bp = blurRow[bx];
-                            UINT32 bb = ( bp       ) & 0xFF;
-                            UINT32 bg2 = ( bp >>  8 ) & 0xFF;
-                            UINT32 br = ( bp >> 16 ) & 0xFF;
-
-                            float inv = 1.0f - maskVal;
-                            r = static_cast<UINT32>( fr * maskVal + br * inv + 0.5f );
-                            g = static_cast<UINT32>( fg * maskVal + bg2 * inv + 0.5f );
-                            b = static_cast<UINT32>( fb * maskVal + bb * inv + 0.5f );
-                        }
+                            if( maskVal >= 1.0f )
+                            {
+                                // Foreground: bilinear from full-res camera.
+                                const float camXf = srcCropX + ( x + 0.5f ) * srcCropW / static_cast<float>( ovW ) - 0.5f;
+                                const float camXfl = floorf( max( 0.0f, camXf ) );
+                                const UINT  cx0 = static_cast<UINT>( camXfl );
+                                const UINT  cx1 = min( cx0 + 1, srcW32 - 1 );
+                                const float cfx = camXf - camXfl;
+                                const float cifx = 1.0f - cfx;
+
+                                UINT32 p00 = camRow0[cx0], p10 = camRow0[cx1];
+                                UINT32 p01 = camRow1[cx0], p11 = camRow1[cx1];
+                                float w00 = cifx * cify, w10 = cfx * cify;
+                                float w01 = cifx * cfy,  w11 = cfx * cfy;
+
+                                b = m_gammaLUT[static_cast<uint8_t>( w00*(p00 & 0xFF) + w10*(p10 & 0xFF) + w01*(p01 & 0xFF) + w11*(p11 & 0xFF) + 0.5f )];
+                                g = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>8)&0xFF) + w10*((p10>>8)&0xFF) + w01*((p01>>8)&0xFF) + w11*((p11>>8)&0xFF) + 0.5f )];
+                                r = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>16)&0xFF) + w10*((p10>>16)&0xFF) + w01*((p01>>16)&0xFF) + w11*((p11>>16)&0xFF) + 0.5f )];
+                            }
+                            else if( maskVal <= 0.0f )
+                            {
+                                // Background: nearest-neighbor from blurred proc buffer
+                                // (blur already hides any interpolation artefacts).
+                                const UINT bx = min( static_cast<UINT>( ( x + 0.5f ) * procW / static_cast<float>( ovW ) ), procW - 1 );
+                                UINT32 px = blurRow[bx];
+                                b = ( px       ) & 0xFF;
+                                g = ( px >>  8 ) & 0xFF;
+                                r = ( px >> 16 ) & 0xFF;
+                            }
+                            else
+                            {
+                                // Edge: blend camera foreground with blurred background.
+                                const float camXf = srcCropX + ( x + 0.5f ) * srcCropW / static_cast<float>( ovW ) - 0.5f;
+                                const float camXfl = floorf( max( 0.0f, camXf ) );
+                                const UINT  cx0 = static_cast<UINT>( camXfl );
+                                const UINT  cx1 = min( cx0 + 1, srcW32 - 1 );
+                                const float cfx = camXf - camXfl;
+                                const float cifx = 1.0f - cfx;
+
+                                UINT32 p00 = camRow0[cx0], p10 = camRow0[cx1];
+                                UINT32 p01 = camRow1[cx0], p11 = camRow1[cx1];
+                                float w00 = cifx * cify, w10 = cfx * cify;
+                                float w01 = cifx * cfy,  w11 = cfx * cfy;
+
+                                UINT32 fb = m_gammaLUT[static_cast<uint8_t>( w00*(p00 & 0xFF) + w10*(p10 & 0xFF) + w01*(p01 & 0xFF) + w11*(p11 & 0xFF) + 0.5f )];
+                                UINT32 fg = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>8)&0xFF) + w10*((p10>>8)&0xFF) + w01*((p01>>8)&0xFF) + w11*((p11>>8)&0xFF) + 0.5f )];
+                                UINT32 fr = m_gammaLUT[static_cast<uint8_t>( w00*((p00>>16)&0xFF) + w10*((p10>>16)&0xFF) + w01*((p01>>16)&0xFF) + w11*((p11>>16)&0xFF) + 0.5f )];
+
+                                const UINT bx = min( static_cast<UINT>( ( x + 0.5f ) * procW / static_cast<float>( ovW ) ), procW - 1 );
+                                UINT32 bp = blurRow[bx];
+                                UINT32 bb = ( bp       ) & 0xFF;
+                                UINT32 bg2 = ( bp >>  8 ) & 0xFF;
+                                UINT32 br = ( bp >> 16 ) & 0xFF;
+
+                                float inv = 1.0f - maskVal;
+                                r = static_cast<UINT32>( fr * maskVal + br * inv + 0.5f );
+                                g = static_cast<UINT32>( fg * maskVal + bg2 * inv + 0.5f );
+                                b = static_cast<UINT32>( fb * maskVal + bb * inv + 0.5f );
+                            }
 
-                        outRow[x] = 0xFF000000u | ( r << 16 ) | ( g << 8 ) | b;
+                            outRow[x] = 0xFF000000u | ( r << 16 ) | ( g << 8 ) | b;
+                        }
                     }
-                }
+                } );
                 finalW = ovW;
                 finalH = ovH;
                 finalPixels = outBuf;
@@ -463,6 +463,8 @@ FancyZones::Destroy() noexcept
 
     m_notificationUtil.reset();
 
+    AppZoneHistory::instance().Flush();
+
     CoUninitialize();
 }
 
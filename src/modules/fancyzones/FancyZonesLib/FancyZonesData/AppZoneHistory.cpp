@@ -3,7 +3,15 @@
 
 #include <common/logger/call_tracer.h>
 #include <common/logger/logger.h>
+#include <common/utils/atomic_file.h>
+#include <common/utils/json_stream.h>
 #include <common/utils/process_path.h>
+#include <common/utils/winapi_error.h>
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
 
 #include <FancyZonesLib/GuidUtils.h>
 #include <FancyZonesLib/FancyZonesWindowProperties.h>
@@ -14,239 +22,788 @@
 
 namespace JsonUtils
 {
-    struct AppZoneHistoryJSON
+    namespace
     {
-    private:
-        static std::optional<FancyZonesDataTypes::WorkAreaId> DeviceIdFromJson(const json::JsonObject& json)
+        using json::stream::Token;
+
+        // Raw fields of a single history item, validated once the whole object is read
+        struct AppZoneHistoryItemJSON
+        {
+            ZoneIndexSet zoneIndexSet;
+            bool hasDevice = false;
+            std::optional<std::wstring> deviceIdStr;
+            std::optional<std::wstring> monitor;
+            std::optional<std::wstring> monitorInstance;
+            std::optional<std::wstring> monitorSerialNumber;
+            int monitorNumber = 0;
+            std::optional<std::wstring> virtualDesktop;
+            std::optional<std::wstring> layoutId;
+            bool valid = true;
+        };
+
+        std::optional<std::wstring> ReadString(json::stream::Reader& reader, Token token, bool& valid)
         {
-            try
+            if (token == Token::String)
             {
-                if (json.HasKey(NonLocalizable::AppZoneHistoryIds::DeviceID))
+                return json::stream::to_wstring(reader.string());
+            }
+
+            valid = false;
+            reader.skip(token);
+            return std::nullopt;
+        }
+
+        void ReadDevice(json::stream::Reader& reader, AppZoneHistoryItemJSON& item)
+        {
+            using namespace NonLocalizable::AppZoneHistoryIds;
+
+            item.hasDevice = true;
+            for (Token token = reader.next(); token != Token::EndObject; token = reader.next())
+            {
+                if (token != Token::Key)
                 {
-                    json::JsonObject device = json.GetNamedObject(NonLocalizable::AppZoneHistoryIds::DeviceID);
-                    std::wstring monitor = device.GetNamedString(NonLocalizable::AppZoneHistoryIds::MonitorID).c_str();
-                    std::wstring monitorInstance = device.GetNamedString(NonLocalizable::AppZoneHistoryIds::MonitorInstanceID, L"").c_str();
-                    std::wstring monitorSerialNumber = device.GetNamedString(NonLocalizable::AppZoneHistoryIds::MonitorSerialNumberID, L"").c_str();
-                    int monitorNumber = static_cast<int>(device.GetNamedNumber(NonLocalizable::AppZoneHistoryIds::MonitorNumberID, 0));
-                    std::wstring virtualDesktop = device.GetNamedString(NonLocalizable::AppZoneHistoryIds::VirtualDesktopID).c_str();
-
-                    auto virtualDesktopGuid = FancyZonesUtils::GuidFromString(virtualDesktop);
-                    if (!virtualDesktopGuid)
-                    {
-                        return std::nullopt;
-                    }
+                    return;
+                }
 
-                    FancyZonesDataTypes::DeviceId deviceId{};
-                    if (monitorInstance.empty())
+                const auto key = reader.string();
+                if (json::stream::key_equals(key, MonitorID))
+                {
+                    item.monitor = ReadString(reader, reader.next(), item.valid);
+                }
+                else if (json::stream::key_equals(key, MonitorInstanceID))
+                {
+                    item.monitorInstance = ReadString(reader, reader.next(), item.valid);
+                }
+                else if (json::stream::key_equals(key, MonitorSerialNumberID))
+                {
+                    item.monitorSerialNumber = ReadString(reader, reader.next(), item.valid);
+                }
+                else if (json::stream::key_equals(key, VirtualDesktopID))
+                {
+                    item.virtualDesktop = ReadString(reader, reader.next(), item.valid);
+                }
+                else if (json::stream::key_equals(key, MonitorNumberID))
+                {
+                    if (Token value = reader.next(); value == Token::Number)
                     {
-                        // old data
-                        deviceId = MonitorUtils::Display::ConvertObsoleteDeviceId(monitor);
+                        item.monitorNumber = static_cast<int>(reader.number());
                     }
                     else
                     {
-                        deviceId.id = monitor;
-                        deviceId.instanceId = monitorInstance;
-                        deviceId.number = monitorNumber;
+                        item.valid = false;
+                        reader.skip(value);
                     }
+                }
+                else if (!reader.skip(reader.next()))
+                {
+                    return;
+                }
+            }
+        }
+
+        // A corrupt index drops the whole item rather than growing the set to an arbitrary size
+        void ReadZoneIndex(json::stream::Reader& reader, AppZoneHistoryItemJSON& item)
+        {
+            const auto index = ZoneIndexSet::IndexFromNumber(reader.number());
+            if (index)
+            {
+                item.zoneIndexSet.insert(*index);
+            }
+            else
+            {
+                item.valid = false;
+            }
+        }
+
+        void ReadZoneIndexSet(json::stream::Reader& reader, AppZoneHistoryItemJSON& item)
+        {
+            item.zoneIndexSet = {};
 
-                    FancyZonesDataTypes::MonitorId monitorId{
-                        .deviceId = deviceId,
-                        .serialNumber = monitorSerialNumber
-                    };
+            Token token = reader.next();
+            if (token == Token::Number)
+            {
+                // single zone index written by old versions
+                ReadZoneIndex(reader, item);
+                return;
+            }
+
+            if (token != Token::BeginArray)
+            {
+                item.valid = false;
+                reader.skip(token);
+                return;
+            }
 
-                    return FancyZonesDataTypes::WorkAreaId{
-                        .monitorId = monitorId,
-                        .virtualDesktopId = virtualDesktopGuid.value(),
-                    };
+            for (token = reader.next(); token != Token::EndArray; token = reader.next())
+            {
+                if (token == Token::Number)
+                {
+                    ReadZoneIndex(reader, item);
                 }
                 else
                 {
-                    std::wstring deviceIdStr = json.GetNamedString(NonLocalizable::AppZoneHistoryIds::DeviceIdID).c_str();
-                    auto bcDeviceId = BackwardsCompatibility::DeviceIdData::ParseDeviceId(deviceIdStr);
-                    if (!bcDeviceId)
+                    item.valid = false;
+                    if (!reader.skip(token))
                     {
-                        return std::nullopt;
+                        return;
                     }
+                }
+            }
+        }
 
-                    return FancyZonesDataTypes::WorkAreaId{
-                        .monitorId = { .deviceId = MonitorUtils::Display::ConvertObsoleteDeviceId(bcDeviceId->deviceName) },
-                        .virtualDesktopId = bcDeviceId->virtualDesktopId,
-                    };
+        // Consumes the value of the current key if it belongs to a history item.
+        bool ReadItemField(json::stream::Reader& reader, AppZoneHistoryItemJSON& item)
+        {
+            using namespace NonLocalizable::AppZoneHistoryIds;
+
+            const auto key = reader.string();
+            if (json::stream::key_equals(key, LayoutIndexesID))
+            {
+                ReadZoneIndexSet(reader, item);
+            }
+            else if (json::stream::key_equals(key, LayoutIdID))
+            {
+                item.layoutId = ReadString(reader, reader.next(), item.valid);
+            }
+            else if (json::stream::key_equals(key, DeviceIdID))
+            {
+                item.deviceIdStr = ReadString(reader, reader.next(), item.valid);
+            }
+            else if (json::stream::key_equals(key, DeviceID))
+            {
+                if (Token value = reader.next(); value == Token::BeginObject)
+                {
+                    ReadDevice(reader, item);
+                }
+                else
+                {
+                    item.valid = false;
+                    reader.skip(value);
                 }
             }
-            catch (const winrt::hresult_error&)
+            else
             {
-                return std::nullopt;
+                return false;
             }
+
+            return true;
         }
 
-        static std::optional<FancyZonesDataTypes::AppZoneHistoryData> ParseSingleAppZoneHistoryItem(const json::JsonObject& json)
+        std::optional<FancyZonesDataTypes::WorkAreaId> WorkAreaIdFromItem(const AppZoneHistoryItemJSON& item)
         {
-            FancyZonesDataTypes::AppZoneHistoryData data;
-            if (json.HasKey(NonLocalizable::AppZoneHistoryIds::LayoutIndexesID))
+            if (item.hasDevice)
             {
-                data.zoneIndexSet = {};
-                for (const auto& value : json.GetNamedArray(NonLocalizable::AppZoneHistoryIds::LayoutIndexesID))
+                if (!item.monitor || !item.virtualDesktop)
+                {
+                    return std::nullopt;
+                }
+
+                auto virtualDesktopGuid = FancyZonesUtils::GuidFromString(item.virtualDesktop.value());
+                if (!virtualDesktopGuid)
+                {
+                    return std::nullopt;
+                }
+
+                FancyZonesDataTypes::DeviceId deviceId{};
+                if (item.monitorInstance.value_or(L"").empty())
                 {
-                    data.zoneIndexSet.push_back(static_cast<ZoneIndex>(value.GetNumber()));
+                    // old data
+                    deviceId = MonitorUtils::Display::ConvertObsoleteDeviceId(item.monitor.value());
                 }
+                else
+                {
+                    deviceId.id = item.monitor.value();
+                    deviceId.instanceId = item.monitorInstance.value();
+                    deviceId.number = item.monitorNumber;
+                }
+
+                FancyZonesDataTypes::MonitorId monitorId{
+                    .deviceId = deviceId,
+                    .serialNumber = item.monitorSerialNumber.value_or(L"")
+                };
+
+                return FancyZonesDataTypes::WorkAreaId{
+                    .monitorId = monitorId,
+                    .virtualDesktopId = virtualDesktopGuid.value(),
+                };
             }
-            else if (json.HasKey(NonLocalizable::AppZoneHistoryIds::LayoutIndexesID))
+
+            if (!item.deviceIdStr)
             {
-                data.zoneIndexSet = { static_cast<ZoneIndex>(json.GetNamedNumber(NonLocalizable::AppZoneHistoryIds::LayoutIndexesID)) };
+                return std::nullopt;
             }
 
-            auto deviceIdOpt = DeviceIdFromJson(json);
-            if (!deviceIdOpt)
+            auto bcDeviceId = BackwardsCompatibility::DeviceIdData::ParseDeviceId(item.deviceIdStr.value());
+            if (!bcDeviceId)
             {
                 return std::nullopt;
             }
 
-            data.workAreaId = deviceIdOpt.value();
-            std::wstring layoutIdStr = json.GetNamedString(NonLocalizable::AppZoneHistoryIds::LayoutIdID).c_str();
-            auto layoutIdOpt = FancyZonesUtils::GuidFromString(layoutIdStr);
+            return FancyZonesDataTypes::WorkAreaId{
+                .monitorId = { .deviceId = MonitorUtils::Display::ConvertObsoleteDeviceId(bcDeviceId->deviceName) },
+                .virtualDesktopId = bcDeviceId->virtualDesktopId,
+            };
+        }
+
+        std::optional<FancyZonesDataTypes::AppZoneHistoryData> AppZoneHistoryDataFromItem(const AppZoneHistoryItemJSON& item)
+        {
+            if (!item.valid || !item.layoutId)
+            {
+                return std::nullopt;
+            }
+
+            auto workAreaId = WorkAreaIdFromItem(item);
+            if (!workAreaId)
+            {
+                return std::nullopt;
+            }
+
+            auto layoutIdOpt = FancyZonesUtils::GuidFromString(item.layoutId.value());
             if (!layoutIdOpt.has_value())
             {
                 return std::nullopt;
             }
 
-            data.layoutId = layoutIdOpt.value();
-            return data;
+            return FancyZonesDataTypes::AppZoneHistoryData{
+                .layoutId = layoutIdOpt.value(),
+                .workAreaId = workAreaId.value(),
+                .zoneIndexSet = item.zoneIndexSet,
+            };
         }
 
-    public:
-        std::wstring appPath;
-        std::vector<FancyZonesDataTypes::AppZoneHistoryData> data;
-        
-        static std::optional<AppZoneHistoryJSON> FromJson(const json::JsonObject& json)
+        void ReadHistory(json::stream::Reader& reader, std::vector<FancyZonesDataTypes::AppZoneHistoryData>& result)
         {
-            try
+            Token token = reader.next();
+            if (token != Token::BeginArray)
             {
-                AppZoneHistoryJSON result;
+                reader.skip(token);
+                return;
+            }
 
-                result.appPath = json.GetNamedString(NonLocalizable::AppZoneHistoryIds::AppPathID);
-                if (json.HasKey(NonLocalizable::AppZoneHistoryIds::HistoryID))
+            for (token = reader.next(); token != Token::EndArray && !reader.failed(); token = reader.next())
+            {
+                if (token != Token::BeginObject)
                 {
-                    auto appHistoryArray = json.GetNamedArray(NonLocalizable::AppZoneHistoryIds::HistoryID);
-                    for (uint32_t i = 0; i < appHistoryArray.Size(); ++i)
-                    {
-                        json::JsonObject json_hist = appHistoryArray.GetObjectAt(i);
-                        if (auto data = ParseSingleAppZoneHistoryItem(json_hist); data.has_value())
-                        {
-                            result.data.push_back(std::move(data.value()));
-                        }
-                    }
+                    reader.skip(token);
+                    continue;
                 }
-                else
+
+                AppZoneHistoryItemJSON item;
+                for (token = reader.next(); token == Token::Key; token = reader.next())
                 {
-                    // handle previous file format, with single desktop layout information per application
-                    if (auto data = ParseSingleAppZoneHistoryItem(json); data.has_value())
+                    if (!ReadItemField(reader, item))
                     {
-                        result.data.push_back(std::move(data.value()));
+                        reader.skip(reader.next());
                     }
                 }
-                if (result.data.empty())
+
+                if (auto data = AppZoneHistoryDataFromItem(item); data.has_value())
                 {
-                    return std::nullopt;
+                    result.push_back(std::move(data.value()));
                 }
+            }
+        }
+
+        // Returns the application path and its history, empty if none of the items is valid
+        std::optional<std::pair<std::wstring, std::vector<FancyZonesDataTypes::AppZoneHistoryData>>> ReadApp(json::stream::Reader& reader)
+        {
+            using namespace NonLocalizable::AppZoneHistoryIds;
+
+            std::optional<std::wstring> appPath;
+            std::vector<FancyZonesDataTypes::AppZoneHistoryData> data;
+            bool hasHistory = false;
+            bool valid = true;
 
-                return result;
+            // previous file format, with single desktop layout information per application
+            AppZoneHistoryItemJSON singleItem;
+
+            for (Token token = reader.next(); token == Token::Key; token = reader.next())
+            {
+                const auto key = reader.string();
+                if (json::stream::key_equals(key, AppPathID))
+                {
+                    appPath = ReadString(reader, reader.next(), valid);
+                }
+                else if (json::stream::key_equals(key, HistoryID))
+                {
+                    hasHistory = true;
+                    ReadHistory(reader, data);
+                }
+                else if (!ReadItemField(reader, singleItem))
+                {
+                    reader.skip(reader.next());
+                }
+            }
+
+            if (!hasHistory)
+            {
+                if (auto item = AppZoneHistoryDataFromItem(singleItem); item.has_value())
+                {
+                    data.push_back(std::move(item.value()));
+                }
             }
-            catch (const winrt::hresult_error&)
+
+            if (reader.failed() || !appPath)
             {
                 return std::nullopt;
             }
+
+            return std::make_pair(std::move(appPath.value()), std::move(data));
         }
 
-        static json::JsonObject ToJson(const AppZoneHistoryJSON& appZoneHistory)
+        std::optional<uint64_t> ReadGeneration(json::stream::Reader& reader)
         {
-            json::JsonObject result{};
+            if (Token value = reader.next(); value == Token::Number && reader.number() >= 0)
+            {
+                return static_cast<uint64_t>(reader.number());
+            }
+            else
+            {
+                reader.skip(value);
+                return std::nullopt;
+            }
+        }
 
-            result.SetNamedValue(NonLocalizable::AppZoneHistoryIds::AppPathID, json::value(appZoneHistory.appPath));
+        void SerializeApp(json::stream::Writer& writer, const std::wstring& appPath, const std::vector<FancyZonesDataTypes::AppZoneHistoryData>& appZoneHistoryData)
+        {
+            using namespace NonLocalizable::AppZoneHistoryIds;
 
-            json::JsonArray appHistoryArray;
-            for (const auto& data : appZoneHistory.data)
+            writer.begin_object();
+            writer.key(AppPathID);
+            writer.value(appPath);
+
+            writer.key(HistoryID);
+            writer.begin_array();
+            for (const auto& data : appZoneHistoryData)
             {
-                json::JsonObject desktopData;
-                json::JsonArray jsonIndexSet;
+                writer.begin_object();
+
+                writer.key(LayoutIndexesID);
+                writer.begin_array();
                 for (ZoneIndex index : data.zoneIndexSet)
                 {
-                    jsonIndexSet.Append(json::value(static_cast<int>(index)));
+                    writer.value(static_cast<int64_t>(index));
                 }
-
-                json::JsonObject device{};
-                device.SetNamedValue(NonLocalizable::AppZoneHistoryIds::MonitorID, json::value(data.workAreaId.monitorId.deviceId.id));
-                device.SetNamedValue(NonLocalizable::AppZoneHistoryIds::MonitorInstanceID, json::value(data.workAreaId.monitorId.deviceId.instanceId));
-                device.SetNamedValue(NonLocalizable::AppZoneHistoryIds::MonitorSerialNumberID, json::value(data.workAreaId.monitorId.serialNumber));
-                device.SetNamedValue(NonLocalizable::AppZoneHistoryIds::MonitorNumberID, json::value(data.workAreaId.monitorId.deviceId.number));
-
-                auto virtualDesktopStr = FancyZonesUtils::GuidToString(data.workAreaId.virtualDesktopId);
-                if (virtualDesktopStr)
+                writer.end_array();
+
+                writer.key(DeviceID);
+                writer.begin_object();
+                writer.key(MonitorID);
+                writer.value(data.workAreaId.monitorId.deviceId.id);
+                writer.key(MonitorInstanceID);
+                writer.value(data.workAreaId.monitorId.deviceId.instanceId);
+                writer.key(MonitorSerialNumberID);
+                writer.value(data.workAreaId.monitorId.serialNumber);
+                writer.key(MonitorNumberID);
+                writer.value(data.workAreaId.monitorId.deviceId.number);
+                if (auto virtualDesktopStr = FancyZonesUtils::GuidToString(data.workAreaId.virtualDesktopId))
                 {
-                    device.SetNamedValue(NonLocalizable::AppZoneHistoryIds::VirtualDesktopID, json::value(virtualDesktopStr.value()));
+                    writer.key(VirtualDesktopID);
+                    writer.value(virtualDesktopStr.value());
                 }
+                writer.end_object();
 
-                desktopData.SetNamedValue(NonLocalizable::AppZoneHistoryIds::LayoutIndexesID, jsonIndexSet);
-                desktopData.SetNamedValue(NonLocalizable::AppZoneHistoryIds::DeviceID, device);
-                auto layoutIdStr = FancyZonesUtils::GuidToString(data.layoutId);
-                if (layoutIdStr)
+                if (auto layoutIdStr = FancyZonesUtils::GuidToString(data.layoutId))
                 {
-                    desktopData.SetNamedValue(NonLocalizable::AppZoneHistoryIds::LayoutIdID, json::value(layoutIdStr.value()));
+                    writer.key(LayoutIdID);
+                    writer.value(layoutIdStr.value());
                 }
 
-                appHistoryArray.Append(desktopData);
+                writer.end_object();
             }
+            writer.end_array();
 
-            result.SetNamedValue(NonLocalizable::AppZoneHistoryIds::HistoryID, appHistoryArray);
-
-            return result;
+            writer.end_object();
         }
-    };
+    }
 
-    AppZoneHistory::TAppZoneHistoryMap ParseAppZoneHistory(const json::JsonObject& fancyZonesDataJSON)
+    // generation is 0 if the file was not written by the journal, e.g. by an older version
+    std::optional<AppZoneHistory::TAppZoneHistoryMap> ParseAppZoneHistory(std::string_view fileContent, uint64_t& generation)
     {
-        try
+        AppZoneHistory::TAppZoneHistoryMap appZoneHistoryMap{};
+        generation = 0;
+
+        json::stream::Reader reader(fileContent);
+        if (reader.next() != Token::BeginObject)
         {
-            AppZoneHistory::TAppZoneHistoryMap appZoneHistoryMap{};
-            auto appLastZones = fancyZonesDataJSON.GetNamedArray(NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID);
+            return std::nullopt;
+        }
+
+        for (Token token = reader.next(); token == Token::Key; token = reader.next())
+        {
+            if (json::stream::key_equals(reader.string(), NonLocalizable::AppZoneHistoryIds::GenerationID))
+            {
+                generation = ReadGeneration(reader).value_or(0);
+                continue;
+            }
+
+            if (!json::stream::key_equals(reader.string(), NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID))
+            {
+                reader.skip(reader.next());
+                continue;
+            }
+
+            Token value = reader.next();
+            if (value != Token::BeginArray)
+            {
+                reader.skip(value);
+                continue;
+            }
 
-            for (uint32_t i = 0; i < appLastZones.Size(); ++i)
+            for (value = reader.next(); value != Token::EndArray && !reader.failed(); value = reader.next())
             {
-                json::JsonObject appLastZone = appLastZones.GetObjectAt(i);
-                if (auto appZoneHistory = AppZoneHistoryJSON::FromJson(appLastZone); appZoneHistory.has_value())
+                if (value != Token::BeginObject)
+                {
+                    reader.skip(value);
+                    continue;
+                }
+
+                if (auto app = ReadApp(reader); app.has_value() && !app->second.empty())
                 {
-                    appZoneHistoryMap[appZoneHistory->appPath] = std::move(appZoneHistory->data);
+                    appZoneHistoryMap[app->first] = std::move(app->second);
                 }
             }
+        }
 
-            return std::move(appZoneHistoryMap);
+        if (reader.failed() || reader.next() != Token::End)
+        {
+            return std::nullopt;
         }
-        catch (const winrt::hresult_error&)
+
+        return appZoneHistoryMap;
+    }
+
+    // The journal is a header line with the generation of the file it applies to, followed by one line per changed
+    // application, in the same format as the items of the file. An empty history means the application was removed.
+    // Returns the number of records applied; a torn last line left by a crash is ignored.
+    size_t ReplayJournal(std::string_view journal, uint64_t generation, AppZoneHistory::TAppZoneHistoryMap& history)
+    {
+        size_t records = 0;
+        bool header = true;
+        while (!journal.empty())
         {
-            return {};
+            const auto end = journal.find('\n');
+            if (end == std::string_view::npos)
+            {
+                break;
+            }
+
+            const auto line = journal.substr(0, end);
+            journal.remove_prefix(end + 1);
+
+            json::stream::Reader reader(line);
+            if (reader.next() != Token::BeginObject)
+            {
+                break;
+            }
+
+            if (header)
+            {
+                // a journal left behind by an older file is stale
+                if (reader.next() != Token::Key || !json::stream::key_equals(reader.string(), NonLocalizable::AppZoneHistoryIds::GenerationID) ||
+                    generation == 0 || ReadGeneration(reader) != generation)
+                {
+                    break;
+                }
+
+                header = false;
+                continue;
+            }
+
+            auto app = ReadApp(reader);
+            if (!app.has_value() || reader.next() != Token::End)
+            {
+                break;
+            }
+
+            if (app->second.empty())
+            {
+                history.erase(app->first);
+            }
+            else
+            {
+                history[app->first] = std::move(app->second);
+            }
+            ++records;
         }
+
+        return records;
+    }
+
+    void SerializeJournalHeader(json::stream::Writer& writer, uint64_t generation)
+    {
+        writer.begin_object();
+        writer.key(NonLocalizable::AppZoneHistoryIds::GenerationID);
+        writer.value(static_cast<int64_t>(generation));
+        writer.end_object();
     }
 
-    json::JsonObject SerializeJson(const AppZoneHistory::TAppZoneHistoryMap& map)
+    void SerializeJson(json::stream::Writer& writer, const AppZoneHistory::TAppZoneHistoryMap& map, uint64_t generation)
     {
-        json::JsonObject root{};
-        json::JsonArray appHistoryArray{};
+        writer.begin_object();
+        writer.key(NonLocalizable::AppZoneHistoryIds::GenerationID);
+        writer.value(static_cast<int64_t>(generation));
+        writer.key(NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID);
+        writer.begin_array();
 
         for (const auto& [appPath, appZoneHistoryData] : map)
         {
-            appHistoryArray.Append(AppZoneHistoryJSON::ToJson(AppZoneHistoryJSON{ appPath, appZoneHistoryData }));
+            SerializeApp(writer, appPath, appZoneHistoryData);
         }
 
-        root.SetNamedValue(NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID, appHistoryArray);
-        return root;
+        writer.end_array();
+        writer.end_object();
     }
 }
 
+// Snapping a window changes the history of a single application, yet saving it means rewriting the whole file, which
+// grows with every application ever snapped. Changes are therefore queued and written off the UI thread: first as
+// records appended to a journal next to the file, then folded into the file once snapping goes idle or the journal
+// grows too long. The file is always replaced atomically and carries a generation number, so a journal is only replayed
+// on top of the file it was written for.
+class AppZoneHistory::Journal
+{
+public:
+    using TAppHistory = std::vector<FancyZonesDataTypes::AppZoneHistoryData>;
+
+    Journal()
+    {
+        m_appendTimer.reset(CreateThreadpoolTimer([](PTP_CALLBACK_INSTANCE, PVOID context, PTP_TIMER) { static_cast<Journal*>(context)->OnAppendTimer(); }, this, nullptr));
+        m_compactTimer.reset(CreateThreadpoolTimer([](PTP_CALLBACK_INSTANCE, PVOID context, PTP_TIMER) { static_cast<Journal*>(context)->OnCompactTimer(); }, this, nullptr));
+    }
+
+    // generation is the one of the file on disk, 0 if unknown so that the first change rewrites the file
+    void Reset(const TAppZoneHistoryMap& history, uint64_t generation)
+    {
+        Discard();
+
+        std::scoped_lock lock(m_fileMutex);
+        Assign(history);
+        m_generation = generation;
+        m_journalRecords = 0;
+    }
+
+    // Called on the UI thread, data is nullptr if the application was removed
+    void Update(const std::wstring& appPath, const TAppHistory* data)
+    {
+        bool first = false;
+        {
+            std::scoped_lock lock(m_mutex);
+            first = m_pending.empty();
+            m_pending[appPath] = data ? WithoutWindows(*data) : TAppHistory{};
+        }
+
+        if (first)
+        {
+            Schedule(m_appendTimer.get(), m_appendDelay);
+        }
+        Schedule(m_compactTimer.get(), m_compactDelay);
+    }
+
+    // Called on the UI thread, like Update
+    void SetDelays(std::chrono::milliseconds appendDelay, std::chrono::milliseconds compactDelay)
+    {
+        m_appendDelay = appendDelay;
+        m_compactDelay = compactDelay;
+    }
+
+    bool Save(const TAppZoneHistoryMap& history)
+    {
+        Discard();
+
+        std::scoped_lock lock(m_fileMutex);
+        Assign(history);
+        return Compact();
+    }
+
+    bool Flush()
+    {
+        Cancel(m_appendTimer.get());
+        Cancel(m_compactTimer.get());
+
+        std::scoped_lock lock(m_fileMutex);
+        return AppendPending() && (m_journalRecords == 0 || Compact());
+    }
+
+    bool Append()
+    {
+        Cancel(m_appendTimer.get());
+
+        std::scoped_lock lock(m_fileMutex);
+        return AppendPending();
+    }
+
+    void Discard()
+    {
+        Cancel(m_appendTimer.get());
+        Cancel(m_compactTimer.get());
+
+        std::scoped_lock lock(m_mutex);
+        m_pending.clear();
+    }
+
+private:
+    static constexpr size_t MaxJournalRecords = 512;
+
+    // window handles are only meaningful to the running instance and are not saved
+    static TAppHistory WithoutWindows(const TAppHistory& data)
+    {
+        TAppHistory result = data;
+        for (auto& item : result)
+        {
+            item.processIdToHandleMap.clear();
+        }
+        return result;
+    }
+
+    // Requires m_fileMutex
+    void Assign(const TAppZoneHistoryMap& history)
+    {
+        m_history.clear();
+        for (const auto& [appPath, data] : history)
+        {
+            m_history.emplace(appPath, WithoutWindows(data));
+        }
+    }
+
+    static void Schedule(PTP_TIMER timer, std::chrono::milliseconds delay)
+    {
+        FILETIME dueTime = wil::filetime::from_int64(static_cast<ULONGLONG>(-wil::filetime_duration::one_millisecond * delay.count()));
+        SetThreadpoolTimer(timer, &dueTime, 0, 0);
+    }
+
+    static void Cancel(PTP_TIMER timer)
+    {
+        SetThreadpoolTimer(timer, nullptr, 0, 0);
+        WaitForThreadpoolTimerCallbacks(timer, TRUE);
+    }
+
+    void OnAppendTimer()
+    {
+        std::scoped_lock lock(m_fileMutex);
+        if (!AppendPending())
+        {
+            Logger::error(L"Failed to save app zone history changes");
+        }
+    }
+
+    void OnCompactTimer()
+    {
+        std::scoped_lock lock(m_fileMutex);
+        if (!AppendPending() || (m_journalRecords > 0 && !Compact()))
+        {
+            Logger::error(L"Failed to save app-zone-history.json");
+        }
+    }
+
+    // Requires m_fileMutex
+    bool AppendPending()
+    {
+        std::map<std::wstring, TAppHistory> pending;
+        {
+            std::scoped_lock lock(m_mutex);
+            pending.swap(m_pending);
+        }
+
+        if (pending.empty())
+        {
+            return true;
+        }
+
+        for (auto& [appPath, data] : pending)
+        {
+            if (data.empty())
+            {
+                m_history.erase(appPath);
+            }
+            else
+            {
+                m_history[appPath] = data;
+            }
+        }
+
+        if (m_generation == 0 || m_journalRecords + pending.size() > MaxJournalRecords)
+        {
+            return Compact();
+        }
+
+        const auto openMode = std::ios::binary | (m_journalRecords == 0 ? std::ios::trunc : std::ios::app);
+        std::ofstream file(AppZoneHistoryJournalFileName(), openMode);
+        if (file && m_journalRecords == 0)
+        {
+            {
+                json::stream::Writer writer(file);
+                JsonUtils::SerializeJournalHeader(writer, m_generation);
+            }
+            file.put('\n');
+        }
+
+        for (const auto& [appPath, data] : pending)
+        {
+            {
+                json::stream::Writer writer(file);
+                JsonUtils::SerializeApp(writer, appPath, data);
+            }
+            file.put('\n');
+        }
+
+        file.flush();
+        if (!file)
+        {
+            // the journal may be torn, fold everything into the file instead
+            return Compact();
+        }
+
+        m_journalRecords += pending.size();
+        return true;
+    }
+
+    // Requires m_fileMutex
+    bool Compact()
+    {
+        const uint64_t generation = m_generation + 1;
+        bool saved = atomic_file::write(AppZoneHistoryFileName(), [&](std::ostream& output) {
+            json::stream::Writer writer(output);
+            JsonUtils::SerializeJson(writer, m_history, generation);
+        });
+
+        if (!saved)
+        {
+            Logger::error(L"Failed to replace app-zone-history.json. {}", get_last_error_or_default(GetLastError()));
+            return false;
+        }
+
+        // a journal left behind by a crash here no longer matches the generation of the file and is ignored
+        m_generation = generation;
+        m_journalRecords = 0;
+        std::error_code error;
+        std::filesystem::remove(AppZoneHistoryJournalFileName(), error);
+        return true;
+    }
+
+    // Changes queued by the UI thread, guarded by m_mutex
+    std::mutex m_mutex;
+    std::map<std::wstring, TAppHistory> m_pending;
+
+    // Copy of the history as written to disk, guarded by m_fileMutex which is always taken before m_mutex
+    std::mutex m_fileMutex;
+    TAppZoneHistoryMap m_history;
+    uint64_t m_generation = 0;
+    size_t m_journalRecords = 0;
+
+    std::chrono::milliseconds m_appendDelay = JournalAppendDelay;
+    std::chrono::milliseconds m_compactDelay = JournalCompactDelay;
+    wil::unique_threadpool_timer m_appendTimer;
+    wil::unique_threadpool_timer m_compactTimer;
+};
 
-AppZoneHistory::AppZoneHistory()
+AppZoneHistory::AppZoneHistory() :
+    m_journal(std::make_unique<Journal>())
 {
 }
 
+AppZoneHistory::~AppZoneHistory() = default;
+
 AppZoneHistory& AppZoneHistory::instance()
 {
     static AppZoneHistory self;
@@ -255,38 +812,86 @@ AppZoneHistory& AppZoneHistory::instance()
 
 void AppZoneHistory::LoadData()
 {
-    auto file = AppZoneHistoryFileName();
-    auto data = json::from_file(file);
-
-    try
+    m_journal->Discard();
+
+    // The history grows with every application ever snapped, so it is read straight from UTF-8 without building a JsonObject
+    auto fileContent = json::stream::read_file(AppZoneHistoryFileName());
+    uint64_t generation = 0;
+    auto data = fileContent ? JsonUtils::ParseAppZoneHistory(fileContent.value(), generation) : std::nullopt;
+    size_t journalRecords = 0;
+    if (data)
     {
-        if (data)
-        {
-            m_history = JsonUtils::ParseAppZoneHistory(data.value());
-        }
-        else
+        m_history = std::move(data.value());
+
+        // changes saved after the file was last written
+        if (auto journal = json::stream::read_file(AppZoneHistoryJournalFileName()))
         {
-            m_history.clear();
-            Logger::error(L"app-zone-history.json file is missing or malformed");
+            journalRecords = JsonUtils::ReplayJournal(journal.value(), generation, m_history);
         }
     }
-    catch (const winrt::hresult_error& e)
+    else
+    {
+        m_history.clear();
+        generation = 0;
+        Logger::error(L"app-zone-history.json file is missing or malformed");
+    }
+
+    m_journal->Reset(m_history, generation);
+    if (journalRecords > 0)
     {
-        Logger::error(L"Parsing app-zone-history error: {}", e.message());
+        // the journal was not folded into the file before exit, do it now so that it starts empty
+        Logger::info(L"Replayed {} app zone history changes", journalRecords);
+        SaveData();
     }
 }
 
 void AppZoneHistory::SaveData()
 {
-    json::to_file(AppZoneHistoryFileName(), JsonUtils::SerializeJson(m_history));
+    if (!m_journal->Save(m_history))
+    {
+        Logger::error(L"Failed to save app-zone-history.json");
+    }
+}
+
+void AppZoneHistory::Flush()
+{
+    if (!m_journal->Flush())
+    {
+        Logger::error(L"Failed to save app-zone-history.json");
+    }
+}
+
+void AppZoneHistory::AppendJournal()
+{
+    if (!m_journal->Append())
+    {
+        Logger::error(L"Failed to save app zone history changes");
+    }
+}
+
+void AppZoneHistory::SetJournalDelays(std::chrono::milliseconds appendDelay, std::chrono::milliseconds compactDelay)
+{
+    m_journal->SetDelays(appendDelay, compactDelay);
+}
+
+void AppZoneHistory::OnAppHistoryChanged(const std::wstring& appPath)
+{
+    auto history = m_history.find(appPath);
+    m_journal->Update(appPath, history != std::end(m_history) ? &history->second : nullptr);
+}
+
+void AppZoneHistory::ResetJournal()
+{
+    m_journal->Reset(m_history, 0);
 }
 
 void AppZoneHistory::AdjustWorkAreaIds(const std::vector<FancyZonesDataTypes::MonitorId>& ids)
 {
-    bool dirtyFlag = false;
+    std::vector<std::wstring> changedApps;
 
     for (auto& [app, data] : m_history)
     {
+        bool dirtyFlag = false;
         for (auto& dataIter : data)
         {
             auto& dataMonitorId = dataIter.workAreaId.monitorId;
@@ -306,11 +911,16 @@ void AppZoneHistory::AdjustWorkAreaIds(const std::vector<FancyZonesDataTypes::Mo
                 }
             }
         }
+
+        if (dirtyFlag)
+        {
+            changedApps.push_back(app);
+        }
     }
 
-    if (dirtyFlag)
+    for (const auto& app : changedApps)
     {
-        SaveData();
+        OnAppHistoryChanged(app);
     }
 }
 
@@ -348,7 +958,7 @@ bool AppZoneHistory::SetAppLastZones(HWND window, const FancyZonesDataTypes::Wor
                 data.processIdToHandleMap[processId] = window;
                 data.layoutId = layoutId;
                 data.zoneIndexSet = zoneIndexSet;
-                SaveData();
+                OnAppHistoryChanged(processPath);
                 return true;
             }
         }
@@ -372,7 +982,7 @@ bool AppZoneHistory::SetAppLastZones(HWND window, const FancyZonesDataTypes::Wor
         m_history[processPath] = std::vector<FancyZonesDataTypes::AppZoneHistoryData>{ data };
     }
 
-    SaveData();
+    OnAppHistoryChanged(processPath);
     return true;
 }
 
@@ -428,7 +1038,7 @@ bool AppZoneHistory::RemoveAppLastZone(HWND window, const FancyZonesDataTypes::W
             {
                 m_history.erase(processPath);
             }
-            SaveData();
+            OnAppHistoryChanged(processPath);
             return true;
         }
         else
@@ -442,6 +1052,7 @@ bool AppZoneHistory::RemoveAppLastZone(HWND window, const FancyZonesDataTypes::W
 void AppZoneHistory::RemoveApp(const std::wstring& appPath)
 {
     m_history.erase(appPath);
+    OnAppHistoryChanged(appPath);
 }
 
 const AppZoneHistory::TAppZoneHistoryMap& AppZoneHistory::GetFullAppZoneHistory() const noexcept
@@ -589,9 +1200,10 @@ void AppZoneHistory::SyncVirtualDesktops(const GUID& currentVirtualDesktop, cons
     };
     bool replaceLastUsedWithCurrent = !desktops.has_value() || currentVirtualDesktop == GUID_NULL || lastUsedVirtualDesktop == GUID_NULL || std::find_if(m_history.begin(), m_history.end(), findCurrentVirtualDesktopInSavedHistory) == m_history.end();
 
-    bool dirtyFlag = false;
+    std::vector<std::wstring> changedApps;
     for (auto it = std::begin(m_history); it != std::end(m_history);)
     {
+        bool dirtyFlag = false;
         auto& perDesktopData = it->second;
         for (auto desktopIt = std::begin(perDesktopData); desktopIt != std::end(perDesktopData);)
         {
@@ -612,10 +1224,14 @@ void AppZoneHistory::SyncVirtualDesktops(const GUID& currentVirtualDesktop, cons
             }
         }
 
+        if (dirtyFlag)
+        {
+            changedApps.push_back(it->first);
+        }
+
         if (perDesktopData.empty())
         {
             it = m_history.erase(it);
-            dirtyFlag = true;
         }
         else
         {
@@ -623,8 +1239,8 @@ void AppZoneHistory::SyncVirtualDesktops(const GUID& currentVirtualDesktop, cons
         }
     }
 
-    if (dirtyFlag)
+    for (const auto& app : changedApps)
     {
-        SaveData();
+        OnAppHistoryChanged(app);
     }
 }
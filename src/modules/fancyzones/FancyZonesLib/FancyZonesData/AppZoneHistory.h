@@ -5,6 +5,8 @@
 
 #include <common/SettingsAPI/settings_helpers.h>
 
+#include <chrono>
+
 namespace NonLocalizable
 {
     namespace AppZoneHistoryIds
@@ -21,6 +23,7 @@ namespace NonLocalizable
         const static wchar_t* MonitorSerialNumberID = L"serial-number";
         const static wchar_t* MonitorNumberID = L"monitor-number";
         const static wchar_t* VirtualDesktopID = L"virtual-desktop";
+        const static wchar_t* GenerationID = L"generation";
     }
 }
 
@@ -29,6 +32,11 @@ class AppZoneHistory
 public:
     using TAppZoneHistoryMap = std::unordered_map<std::wstring, std::vector<FancyZonesDataTypes::AppZoneHistoryData>>;
 
+    // Changes are appended to the journal once snapping paused for JournalAppendDelay, and folded into the file once
+    // it paused for JournalCompactDelay
+    static constexpr std::chrono::milliseconds JournalAppendDelay{ 250 };
+    static constexpr std::chrono::milliseconds JournalCompactDelay{ 2000 };
+
     static AppZoneHistory& instance();
 
     inline static std::wstring AppZoneHistoryFileName()
@@ -41,15 +49,32 @@ public:
 #endif
     }
 
+    inline static std::wstring AppZoneHistoryJournalFileName()
+    {
+        std::wstring saveFolderPath = PTSettingsHelper::get_module_save_folder_location(NonLocalizable::ModuleKey);
+#if defined(UNIT_TESTS)
+        return saveFolderPath + L"\\test-app-zone-history.journal";
+#else
+        return saveFolderPath + L"\\app-zone-history.journal";
+#endif
+    }
+
 #if defined(UNIT_TESTS)
     inline void SetAppZoneHistory(const TAppZoneHistoryMap& history)
     {
         m_history = history;
+        ResetJournal();
     }
 #endif
 
     void LoadData();
     void SaveData();
+    // Writes changes that are still waiting in the journal queue, called on shutdown
+    void Flush();
+    // Appends the queued changes to the journal like the append timer does, without folding it into the file
+    void AppendJournal();
+    // Applies to changes made from now on, lets tests keep changes queued until AppendJournal or Flush
+    void SetJournalDelays(std::chrono::milliseconds appendDelay, std::chrono::milliseconds compactDelay);
     void AdjustWorkAreaIds(const std::vector<FancyZonesDataTypes::MonitorId>& ids);
 
     bool SetAppLastZones(HWND window, const FancyZonesDataTypes::WorkAreaId& workAreaId, const GUID& layoutId, const ZoneIndexSet& zoneIndexSet);
@@ -67,7 +92,14 @@ public:
     
 private:
     AppZoneHistory();
-    ~AppZoneHistory() = default;
+    ~AppZoneHistory();
+
+    // Write-behind persistence of m_history, defined in AppZoneHistory.cpp
+    class Journal;
+
+    void OnAppHistoryChanged(const std::wstring& appPath);
+    void ResetJournal();
 
     TAppZoneHistoryMap m_history;
+    std::unique_ptr<Journal> m_journal;
 };
@@ -13,45 +13,87 @@ namespace ZonedWindowProperties
 {
     const wchar_t PropertyMultipleZone64ID[] = L"FancyZones_zones"; // maximum possible zone count = 64
     const wchar_t PropertyMultipleZone128ID[] = L"FancyZones_zones_max128"; // additional property to allow maximum possible zone count = 128
+    const wchar_t PropertyMultipleZoneExtendedPrefix[] = L"FancyZones_zones_max"; // FancyZones_zones_max192, FancyZones_zones_max256, ...
+    constexpr size_t MaxZoneIndexWords = ZoneIndexSet::MaxWords; // maximum possible zone count = 1024
 
     const wchar_t PropertySortKeyWithinZone[] = L"FancyZones_TabSortKeyWithinZone";
 }
 
-bool FancyZonesWindowProperties::StampZoneIndexProperty(HWND window, const ZoneIndexSet& zoneSet)
+namespace
 {
-    RemoveZoneIndexProperty(window);
-    ZoneIndexSetBitmask bitmask = ZoneIndexSetBitmask::FromIndexSet(zoneSet);
+    // One property stores the 64 zones of a single word of the index set
+    std::wstring ZoneIndexPropertyName(size_t word)
+    {
+        switch (word)
+        {
+        case 0:
+            return ZonedWindowProperties::PropertyMultipleZone64ID;
+        case 1:
+            return ZonedWindowProperties::PropertyMultipleZone128ID;
+        default:
+            return ZonedWindowProperties::PropertyMultipleZoneExtendedPrefix + std::to_wstring((word + 1) * ZoneIndexSet::WordBits);
+        }
+    }
 
-    if (bitmask.part1 != 0)
+    bool StampZoneIndexWord(HWND window, size_t word, ZoneIndexSet::Word bits)
     {
         std::array<int32_t, 2> data{
-            static_cast<int>(bitmask.part1),
-            static_cast<int>(bitmask.part1 >> 32)
+            static_cast<int>(bits),
+            static_cast<int>(bits >> 32)
         };
 
         HANDLE rawData;
         memcpy(&rawData, data.data(), sizeof data);
 
-        if (!SetProp(window, ZonedWindowProperties::PropertyMultipleZone64ID, rawData))
+        if (!SetProp(window, ZoneIndexPropertyName(word).c_str(), rawData))
         {
             Logger::error(L"Failed to stamp window {}", get_last_error_or_default(GetLastError()));
             return false;
         }
+
+        return true;
     }
 
-    if (bitmask.part2 != 0)
+    ZoneIndexSet::Word RetrieveZoneIndexWord(HWND window, size_t word)
     {
-        std::array<int32_t, 2> data{
-            static_cast<int>(bitmask.part2),
-            static_cast<int>(bitmask.part2 >> 32)
-        };
+        HANDLE handle = ::GetProp(window, ZoneIndexPropertyName(word).c_str());
+        if (!handle)
+        {
+            return 0;
+        }
 
-        HANDLE rawData;
-        memcpy(&rawData, data.data(), sizeof data);
+        std::array<int32_t, 2> data;
+        memcpy(data.data(), &handle, sizeof data);
+        return (static_cast<ZoneIndexSet::Word>(static_cast<uint32_t>(data[1])) << 32) | static_cast<uint32_t>(data[0]);
+    }
+}
+
+bool FancyZonesWindowProperties::StampZoneIndexProperty(HWND window, const ZoneIndexSet& zoneSet)
+{
+    RemoveZoneIndexProperty(window);
 
-        if (!SetProp(window, ZonedWindowProperties::PropertyMultipleZone128ID, rawData))
+    // the first two words keep the layout of ZoneIndexSetBitmask, so stamps of previous versions are still recognized
+    ZoneIndexSetBitmask bitmask = ZoneIndexSetBitmask::FromIndexSet(zoneSet);
+    if (bitmask.part1 != 0 && !StampZoneIndexWord(window, 0, bitmask.part1))
+    {
+        return false;
+    }
+
+    if (bitmask.part2 != 0 && !StampZoneIndexWord(window, 1, bitmask.part2))
+    {
+        return false;
+    }
+
+    for (size_t word = ZoneIndexSet::InlineWords; word < zoneSet.WordCount(); ++word)
+    {
+        if (word >= ZonedWindowProperties::MaxZoneIndexWords)
+        {
+            Logger::error(L"Failed to stamp window, zone index exceeds {}", ZonedWindowProperties::MaxZoneIndexWords * ZoneIndexSet::WordBits);
+            return false;
+        }
+
+        if (zoneSet.GetWord(word) != 0 && !StampZoneIndexWord(window, word, zoneSet.GetWord(word)))
         {
-            Logger::error(L"Failed to stamp window {}", get_last_error_or_default(GetLastError()));
             return false;
         }
     }
@@ -63,30 +105,26 @@ void FancyZonesWindowProperties::RemoveZoneIndexProperty(HWND window)
 {
     ::RemoveProp(window, ZonedWindowProperties::PropertyMultipleZone64ID);
     ::RemoveProp(window, ZonedWindowProperties::PropertyMultipleZone128ID);
+    for (size_t word = ZoneIndexSet::InlineWords; word < ZonedWindowProperties::MaxZoneIndexWords; ++word)
+    {
+        ::RemoveProp(window, ZoneIndexPropertyName(word).c_str());
+    }
 }
 
 ZoneIndexSet FancyZonesWindowProperties::RetrieveZoneIndexProperty(HWND window)
 {
-    HANDLE handle64 = ::GetProp(window, ZonedWindowProperties::PropertyMultipleZone64ID);
-    HANDLE handle128 = ::GetProp(window, ZonedWindowProperties::PropertyMultipleZone128ID);
-
-    ZoneIndexSetBitmask bitmask{};
+    ZoneIndexSetBitmask bitmask{
+        .part1 = RetrieveZoneIndexWord(window, 0),
+        .part2 = RetrieveZoneIndexWord(window, 1),
+    };
 
-    if (handle64)
+    ZoneIndexSet result = bitmask.ToIndexSet();
+    for (size_t word = ZoneIndexSet::InlineWords; word < ZonedWindowProperties::MaxZoneIndexWords; ++word)
     {
-        std::array<int32_t, 2> data;
-        memcpy(data.data(), &handle64, sizeof data);
-        bitmask.part1 = (static_cast<decltype(bitmask.part1)>(data[1]) << 32) + data[0];
-    }
-
-    if (handle128)
-    {
-        std::array<int32_t, 2> data;
-        memcpy(data.data(), &handle128, sizeof data);
-        bitmask.part2 = (static_cast<decltype(bitmask.part2)>(data[1]) << 32) + data[0];
+        result.SetWord(word, RetrieveZoneIndexWord(window, word));
     }
 
-    return bitmask.ToIndexSet();
+    return result;
 }
 
 void FancyZonesWindowProperties::StampMovedOnOpeningProperty(HWND window)
@@ -258,12 +258,22 @@ namespace
             data.zoneIndexSet = {};
             for (const auto& value : json.GetNamedArray(NonLocalizable::ZoneIndexSetStr))
             {
-                data.zoneIndexSet.push_back(static_cast<ZoneIndex>(value.GetNumber()));
+                const auto index = ZoneIndexSet::IndexFromNumber(value.GetNumber());
+                if (!index)
+                {
+                    return std::nullopt;
+                }
+                data.zoneIndexSet.insert(*index);
             }
         }
         else if (json.HasKey(NonLocalizable::ZoneIndexStr))
         {
-            data.zoneIndexSet = { static_cast<ZoneIndex>(json.GetNamedNumber(NonLocalizable::ZoneIndexStr)) };
+            const auto index = ZoneIndexSet::IndexFromNumber(json.GetNamedNumber(NonLocalizable::ZoneIndexStr));
+            if (!index)
+            {
+                return std::nullopt;
+            }
+            data.zoneIndexSet = { *index };
         }
 
         std::wstring deviceIdStr = json.GetNamedString(NonLocalizable::DeviceIdStr).c_str();
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "Layout.h"
 
+#include <atomic>
+
 #include <FancyZonesLib/FancyZonesData/CustomLayouts.h>
 #include <FancyZonesLib/FancyZonesWindowProperties.h>
 #include <FancyZonesLib/LayoutConfigurator.h>
@@ -9,6 +11,11 @@
 
 #include <common/logger/logger.h>
 
+namespace
+{
+    std::atomic<uint64_t> layoutGeneration = 0;
+}
+
 namespace ZoneSelectionAlgorithms
 {
     constexpr int OVERLAPPING_CENTERS_SENSITIVITY = 75;
@@ -16,17 +23,17 @@ namespace ZoneSelectionAlgorithms
     template<class CompareF>
     ZoneIndexSet ZoneSelectPriority(const ZonesMap& zones, const ZoneIndexSet& capturedZones, CompareF compare)
     {
-        size_t chosen = 0;
+        ZoneIndex chosen = capturedZones.front();
 
-        for (size_t i = 1; i < capturedZones.size(); ++i)
+        for (ZoneIndex zoneId : capturedZones)
         {
-            if (compare(zones.at(capturedZones[i]), zones.at(capturedZones[chosen])))
+            if (compare(zones.at(zoneId), zones.at(chosen)))
             {
-                chosen = i;
+                chosen = zoneId;
             }
         }
 
-        return { capturedZones[chosen] };
+        return { chosen };
     }
 
     ZoneIndexSet ZoneSelectSubregion(const ZonesMap& zones, const ZoneIndexSet& capturedZones, POINT pt, int sensitivityRadius)
@@ -39,12 +46,12 @@ namespace ZoneSelectionAlgorithms
         };
 
         // Compute the overlapped rectangle.
-        RECT overlap = zones.at(capturedZones[0]).GetZoneRect();
+        RECT overlap = zones.at(capturedZones.front()).GetZoneRect();
         expand(overlap);
 
-        for (size_t i = 1; i < capturedZones.size(); ++i)
+        for (ZoneIndex zoneId : capturedZones)
         {
-            RECT current = zones.at(capturedZones[i]).GetZoneRect();
+            RECT current = zones.at(zoneId).GetZoneRect();
             expand(current);
 
             overlap.top = max(overlap.top, current.top);
@@ -71,7 +78,7 @@ namespace ZoneSelectionAlgorithms
 
         zoneIndex = std::clamp(zoneIndex, static_cast<ZoneIndex>(0), static_cast<ZoneIndex>(capturedZones.size()) - 1);
 
-        return { capturedZones[zoneIndex] };
+        return { capturedZones[static_cast<size_t>(zoneIndex)] };
     }
 
     ZoneIndexSet ZoneSelectClosestCenter(const ZonesMap& zones, const ZoneIndexSet& capturedZones, POINT pt)
@@ -165,6 +172,9 @@ bool Layout::Init(const FancyZonesUtils::Rect& workArea, HMONITOR monitor) noexc
     break;
     }
 
+    m_spatialIndex.Build(m_zones, m_data.sensitivityRadius);
+    m_generation = ++layoutGeneration;
+
     return m_zones.size() == m_data.zoneCount;
 }
 
@@ -183,65 +193,25 @@ const ZonesMap& Layout::Zones() const noexcept
     return m_zones;
 }
 
-ZoneIndexSet Layout::ZonesFromPoint(POINT pt) const noexcept
+uint64_t Layout::Generation() const noexcept
 {
-    ZoneIndexSet capturedZones;
-    ZoneIndexSet strictlyCapturedZones;
-    for (const auto& [zoneId, zone] : m_zones)
-    {
-        const RECT& zoneRect = zone.GetZoneRect();
-        if (zoneRect.left - m_data.sensitivityRadius <= pt.x && pt.x <= zoneRect.right + m_data.sensitivityRadius &&
-            zoneRect.top - m_data.sensitivityRadius <= pt.y && pt.y <= zoneRect.bottom + m_data.sensitivityRadius)
-        {
-            capturedZones.emplace_back(zoneId);
-        }
+    return m_generation;
+}
 
-        if (zoneRect.left <= pt.x && pt.x < zoneRect.right &&
-            zoneRect.top <= pt.y && pt.y < zoneRect.bottom)
-        {
-            strictlyCapturedZones.emplace_back(zoneId);
-        }
-    }
+ZoneIndexSet Layout::ZonesFromPoint(POINT pt) const noexcept
+{
+    // Called on every mouse move while dragging, only the zones near the point are tested
+    auto [capturedZones, strictlyCaptured, overlap] = m_spatialIndex.Query(pt);
 
     // If only one zone is captured, but it's not strictly captured
     // don't consider it as captured
-    if (capturedZones.size() == 1 && strictlyCapturedZones.size() == 0)
+    if (capturedZones.size() == 1 && !strictlyCaptured)
     {
         return {};
     }
 
     // If captured zones do not overlap, return all of them
     // Otherwise, return one of them based on the chosen selection algorithm.
-    bool overlap = false;
-    for (size_t i = 0; i < capturedZones.size(); ++i)
-    {
-        for (size_t j = i + 1; j < capturedZones.size(); ++j)
-        {
-            RECT rectI;
-            RECT rectJ;
-            try
-            {
-                rectI = m_zones.at(capturedZones[i]).GetZoneRect();
-                rectJ = m_zones.at(capturedZones[j]).GetZoneRect();
-            }
-            catch (std::out_of_range)
-            {
-                return {};
-            }
-
-            if (max(rectI.top, rectJ.top) + m_data.sensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
-                max(rectI.left, rectJ.left) + m_data.sensitivityRadius < min(rectI.right, rectJ.right))
-            {
-                overlap = true;
-                break;
-            }
-        }
-        if (overlap)
-        {
-            break;
-        }
-    }
-
     if (overlap)
     {
         try
@@ -263,7 +233,7 @@ ZoneIndexSet Layout::ZonesFromPoint(POINT pt) const noexcept
         catch (std::out_of_range)
         {
             Logger::error("Exception out_of_range was thrown in ZoneSet::ZonesFromPoint");
-            return { capturedZones[0] };
+            return { capturedZones.front() };
         }
     }
 
@@ -272,8 +242,9 @@ ZoneIndexSet Layout::ZonesFromPoint(POINT pt) const noexcept
 
 ZoneIndexSet Layout::GetCombinedZoneRange(const ZoneIndexSet& initialZones, const ZoneIndexSet& finalZones) const noexcept
 {
-    ZoneIndexSet combinedZones, result;
-    std::set_union(begin(initialZones), end(initialZones), begin(finalZones), end(finalZones), std::back_inserter(combinedZones));
+    // Called on every mouse move while extending the selection, the union doesn't allocate for up to 128 zones
+    const ZoneIndexSet combinedZones = initialZones | finalZones;
+    ZoneIndexSet result;
 
     RECT boundingRect{};
     bool boundingRectEmpty = true;
@@ -306,7 +277,7 @@ ZoneIndexSet Layout::GetCombinedZoneRange(const ZoneIndexSet& initialZones, cons
             if (boundingRect.left <= rect.left && rect.right <= boundingRect.right &&
                 boundingRect.top <= rect.top && rect.bottom <= boundingRect.bottom)
             {
-                result.push_back(zoneId);
+                result.insert(zoneId);
             }
         }
     }
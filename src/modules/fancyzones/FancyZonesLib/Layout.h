@@ -4,6 +4,7 @@
 #include <FancyZonesLib/util.h>
 
 #include <FancyZonesLib/LayoutConfigurator.h> // ZonesMap
+#include <FancyZonesLib/ZoneSpatialIndex.h>
 
 class Layout
 {
@@ -17,6 +18,8 @@ public:
     FancyZonesDataTypes::ZoneSetLayoutType Type() const noexcept;
 
     const ZonesMap& Zones() const noexcept;
+    // Unique for every successful Init, so data derived from the zones elsewhere can tell when it's stale
+    uint64_t Generation() const noexcept;
     ZoneIndexSet ZonesFromPoint(POINT pt) const noexcept;
     /**
      * Returns all zones spanned by the minimum bounding rectangle containing the two given zone index sets.
@@ -28,4 +31,6 @@ public:
 private:
     const LayoutData m_data;
     ZonesMap m_zones{};
+    ZoneSpatialIndex m_spatialIndex{};
+    uint64_t m_generation = 0;
 };
@@ -9,11 +9,7 @@
 void LayoutAssignedWindows::Assign(HWND window, const ZoneIndexSet& zones)
 {
     Dismiss(window);
-    
-    for (const auto& index : zones)
-    {
-        m_windowIndexSet[window].push_back(index);
-    }
+    m_windowIndexSet[window] = zones;
 
     if (FancyZonesSettings::settings().disableRoundCorners)
     {
@@ -62,7 +58,7 @@ bool LayoutAssignedWindows::IsZoneEmpty(ZoneIndex zoneIndex) const noexcept
 {
     for (auto& [window, zones] : m_windowIndexSet)
     {
-        if (find(begin(zones), end(zones), zoneIndex) != end(zones))
+        if (zones.contains(zoneIndex))
         {
             return false;
         }
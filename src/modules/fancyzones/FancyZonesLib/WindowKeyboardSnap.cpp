@@ -26,18 +26,19 @@ bool WindowKeyboardSnap::Snap(HWND window, RECT windowRect, HMONITOR monitor, DW
     m_extendData.Reset();
 
     const auto& currentWorkArea = activeWorkAreas.at(monitor);
+    const size_t node = UpdateNeighborGraph(window, monitor, activeWorkAreas, monitors);
     if (monitors.size() > 1 && FancyZonesSettings::settings().moveWindowAcrossMonitors)
     {
         // Multi monitor environment.
         // First, try to stay on the same monitor
-        bool success = MoveByDirectionAndPosition(window, windowRect, vkCode, false, currentWorkArea.get());
+        bool success = MoveByDirectionAndPosition(window, windowRect, vkCode, false, currentWorkArea.get(), node);
         if (success)
         {
             return true;
         }
 
         // Try to snap on another monitor
-        success = SnapBasedOnPositionOnAnotherMonitor(window, windowRect, vkCode, monitor, activeWorkAreas, monitors);
+        success = SnapBasedOnPositionOnAnotherMonitor(window, windowRect, vkCode, monitor, activeWorkAreas, monitors, node);
         if (success)
         {
             // Unsnap from previous work area
@@ -49,7 +50,7 @@ bool WindowKeyboardSnap::Snap(HWND window, RECT windowRect, HMONITOR monitor, DW
     else
     {
         // Single monitor environment, or combined multi-monitor environment.
-        return MoveByDirectionAndPosition(window, windowRect, vkCode, true, currentWorkArea.get());
+        return MoveByDirectionAndPosition(window, windowRect, vkCode, true, currentWorkArea.get(), node);
     }
 }
 
@@ -133,8 +134,33 @@ bool WindowKeyboardSnap::SnapHotkeyBasedOnZoneNumber(HWND window, DWORD vkCode,
     return false;
 }
 
-bool WindowKeyboardSnap::SnapBasedOnPositionOnAnotherMonitor(HWND window, RECT windowRect, DWORD vkCode, HMONITOR current, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors)
+bool WindowKeyboardSnap::SnapBasedOnPositionOnAnotherMonitor(HWND window, RECT windowRect, DWORD vkCode, HMONITOR current, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors, size_t node)
 {
+    if (node != ZoneNeighborGraph::NoNode)
+    {
+        // The window is snapped to a single zone, its neighbors on the other monitors are already known
+        size_t target = m_neighborGraph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::OtherWorkArea);
+        if (target == ZoneNeighborGraph::NoNode)
+        {
+            target = m_neighborGraph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::AnyWorkAreaCycle);
+        }
+
+        if (target == ZoneNeighborGraph::NoNode)
+        {
+            return false;
+        }
+
+        const auto& [targetMonitor, targetZone] = m_neighborGraph.GetNode(target);
+        const auto& workArea = activeWorkAreas.at(targetMonitor);
+        bool snapped = workArea->Snap(window, { targetZone });
+        if (snapped)
+        {
+            Trace::FancyZones::KeyboardSnapWindowToZone(workArea->GetLayout().get(), workArea->GetLayoutWindows());
+        }
+
+        return snapped;
+    }
+
     // Extract zones from all other monitors and target one of them
     std::vector<RECT> zoneRects;
     std::vector<std::pair<ZoneIndex, WorkArea*>> zoneRectsInfo;
@@ -280,7 +306,7 @@ bool WindowKeyboardSnap::MoveByDirectionAndIndex(HWND window, DWORD vkCode, bool
     }
     else
     {
-        const ZoneIndex oldId = zoneIndexes[0];
+        const ZoneIndex oldId = zoneIndexes.front();
 
         // We reached the edge
         if ((vkCode == VK_LEFT && oldId == 0) || (vkCode == VK_RIGHT && oldId == static_cast<int64_t>(numZones) - 1))
@@ -315,7 +341,7 @@ bool WindowKeyboardSnap::MoveByDirectionAndIndex(HWND window, DWORD vkCode, bool
     return snapped;
 }
 
-bool WindowKeyboardSnap::MoveByDirectionAndPosition(HWND window, RECT windowRect, DWORD vkCode, bool cycle, WorkArea* const workArea)
+bool WindowKeyboardSnap::MoveByDirectionAndPosition(HWND window, RECT windowRect, DWORD vkCode, bool cycle, WorkArea* const workArea, size_t node)
 {
     if (!workArea)
     {
@@ -330,6 +356,29 @@ bool WindowKeyboardSnap::MoveByDirectionAndPosition(HWND window, RECT windowRect
         return false;
     }
 
+    if (node != ZoneNeighborGraph::NoNode)
+    {
+        // The window is snapped to a single zone, its neighbors were computed when the layout was applied
+        size_t target = m_neighborGraph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::SameWorkArea);
+        if (target == ZoneNeighborGraph::NoNode && cycle)
+        {
+            target = m_neighborGraph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::SameWorkAreaCycle);
+        }
+
+        if (target == ZoneNeighborGraph::NoNode)
+        {
+            return false;
+        }
+
+        bool success = workArea->Snap(window, { m_neighborGraph.GetNode(target).zone });
+        if (success)
+        {
+            Trace::FancyZones::KeyboardSnapWindowToZone(layout.get(), layoutWindows);
+        }
+
+        return success;
+    }
+
     std::vector<bool> usedZoneIndices(zones.size(), false);
     auto windowZones = layoutWindows.GetZoneIndexSetFromWindow(window);
 
@@ -339,7 +388,7 @@ bool WindowKeyboardSnap::MoveByDirectionAndPosition(HWND window, RECT windowRect
     }
 
     std::vector<RECT> zoneRects;
-    ZoneIndexSet freeZoneIndices;
+    std::vector<ZoneIndex> freeZoneIndices;
 
     for (const auto& [zoneId, zone] : zones)
     {
@@ -392,6 +441,53 @@ bool WindowKeyboardSnap::MoveByDirectionAndPosition(HWND window, RECT windowRect
     return false;
 }
 
+size_t WindowKeyboardSnap::UpdateNeighborGraph(HWND window, HMONITOR monitor, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors)
+{
+    std::vector<ZoneNeighborGraph::WorkAreaInfo> workAreas;
+    std::vector<const ZonesMap*> zones;
+    workAreas.reserve(monitors.size());
+    zones.reserve(monitors.size());
+
+    for (const auto& [workAreaMonitor, monitorRect] : monitors)
+    {
+        const auto iter = activeWorkAreas.find(workAreaMonitor);
+        if (iter == activeWorkAreas.end() || !iter->second || !iter->second->GetLayout())
+        {
+            continue;
+        }
+
+        const auto& layout = iter->second->GetLayout();
+        workAreas.push_back(ZoneNeighborGraph::WorkAreaInfo{
+            .monitor = workAreaMonitor,
+            .monitorRect = monitorRect,
+            .workAreaRect = iter->second->GetWorkAreaRect(),
+            .layoutGeneration = layout->Generation(),
+        });
+        zones.push_back(&layout->Zones());
+    }
+
+    // Only the work areas and layout generations are compared, the graph is rebuilt after they change
+    const RECT combinedRect = FancyZonesUtils::GetMonitorsCombinedRect<&MONITORINFOEX::rcWork>(monitors);
+    if (!m_neighborGraph.IsBuiltFor(workAreas, combinedRect))
+    {
+        m_neighborGraph.Build(workAreas, zones, combinedRect);
+    }
+
+    const auto& workArea = activeWorkAreas.at(monitor);
+    if (!workArea)
+    {
+        return ZoneNeighborGraph::NoNode;
+    }
+
+    const auto windowZones = workArea->GetLayoutWindows().GetZoneIndexSetFromWindow(window);
+    if (windowZones.size() != 1)
+    {
+        return ZoneNeighborGraph::NoNode;
+    }
+
+    return m_neighborGraph.Find(monitor, windowZones.front());
+}
+
 bool WindowKeyboardSnap::Extend(HWND window, RECT windowRect, DWORD vkCode, WorkArea* const workArea)
 {
     if (!workArea)
@@ -411,7 +507,7 @@ bool WindowKeyboardSnap::Extend(HWND window, RECT windowRect, DWORD vkCode, Work
     
     std::vector<bool> usedZoneIndices(zones.size(), false);
     std::vector<RECT> zoneRects;
-    ZoneIndexSet freeZoneIndices;
+    std::vector<ZoneIndex> freeZoneIndices;
 
     // If selectManyZones = true for the second time, use the last zone into which we moved
     // instead of the window rect and enable moving to all zones except the old one
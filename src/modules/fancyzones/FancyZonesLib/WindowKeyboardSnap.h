@@ -1,6 +1,7 @@
 #pragma once
 
 #include <FancyZonesLib/Zone.h>
+#include <FancyZonesLib/ZoneNeighborGraph.h>
 
 class WorkArea;
 
@@ -46,11 +47,16 @@ public:
 	
 private:
     bool SnapHotkeyBasedOnZoneNumber(HWND window, DWORD vkCode, HMONITOR monitor, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<HMONITOR>& monitors);
-    bool SnapBasedOnPositionOnAnotherMonitor(HWND window, RECT windowRect, DWORD vkCode, HMONITOR monitor, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors);
+    bool SnapBasedOnPositionOnAnotherMonitor(HWND window, RECT windowRect, DWORD vkCode, HMONITOR monitor, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors, size_t node);
     
     bool MoveByDirectionAndIndex(HWND window, DWORD vkCode, bool cycle, WorkArea* const workArea);
-    bool MoveByDirectionAndPosition(HWND window, RECT windowRect, DWORD vkCode, bool cycle, WorkArea* const workArea);
+    bool MoveByDirectionAndPosition(HWND window, RECT windowRect, DWORD vkCode, bool cycle, WorkArea* const workArea, size_t node);
     bool Extend(HWND window, RECT windowRect, DWORD vkCode, WorkArea* const workArea);
 
+    // Rebuilds the neighbor graph if the monitors or layouts changed. Returns the node of the zone the window is snapped to,
+    // or NoNode unless it's snapped to exactly one zone, in which case the zones are scanned as before.
+    size_t UpdateNeighborGraph(HWND window, HMONITOR monitor, const std::unordered_map<HMONITOR, std::unique_ptr<WorkArea>>& activeWorkAreas, const std::vector<std::pair<HMONITOR, RECT>>& monitors);
+
     ExtendWindowModeData m_extendData{}; // Needed for ExtendWindowByDirectionAndPosition
+    ZoneNeighborGraph m_neighborGraph{}; // Rebuilt on the first keypress after monitors or layouts change
 };
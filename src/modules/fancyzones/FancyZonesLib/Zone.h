@@ -1,13 +1,12 @@
 #pragma once
 
+#include <FancyZonesLib/ZoneIndexSet.h>
+
 namespace ZoneConstants
 {
     constexpr int MAX_NEGATIVE_SPACING = -20;
 }
 
-using ZoneIndex = int64_t;
-using ZoneIndexSet = std::vector<ZoneIndex>;
-
 /**
  * Class representing one zone inside applied zone layout, which is basically wrapper around rectangle structure.
  */
@@ -0,0 +1,347 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+using ZoneIndex = int64_t;
+
+/**
+ * Set of zone indices stored as a bitset and iterated in ascending order.
+ * Layouts with up to 128 zones fit into the inline words, so the sets built on every mouse move while dragging
+ * or extending don't allocate. The words of larger layouts continue on the heap.
+ */
+class ZoneIndexSet
+{
+public:
+    using Word = uint64_t;
+    static constexpr size_t WordBits = std::numeric_limits<Word>::digits;
+    static constexpr size_t InlineWords = 2;
+
+    // Indices are below MaxZoneCount, so a corrupt index can't make the set allocate more than MaxWords
+    static constexpr ZoneIndex MaxZoneCount = 1024;
+    static constexpr size_t MaxWords = static_cast<size_t>(MaxZoneCount) / WordBits;
+
+    // Index read from JSON, empty if it is not a finite number in [0, MaxZoneCount)
+    static std::optional<ZoneIndex> IndexFromNumber(double number) noexcept
+    {
+        // Written so that NaN fails the check too
+        if (!(number >= 0 && number < static_cast<double>(MaxZoneCount)))
+        {
+            return std::nullopt;
+        }
+
+        return static_cast<ZoneIndex>(number);
+    }
+
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = ZoneIndex;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const ZoneIndex*;
+        using reference = ZoneIndex;
+
+        const_iterator() noexcept = default;
+
+        ZoneIndex operator*() const noexcept
+        {
+            return static_cast<ZoneIndex>(m_word * WordBits + static_cast<size_t>(std::countr_zero(m_bits)));
+        }
+
+        const_iterator& operator++() noexcept
+        {
+            m_bits &= m_bits - 1;
+            SkipEmptyWords();
+            return *this;
+        }
+
+        const_iterator operator++(int) noexcept
+        {
+            auto result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const noexcept
+        {
+            return m_word == other.m_word && m_bits == other.m_bits;
+        }
+
+    private:
+        friend class ZoneIndexSet;
+
+        const_iterator(const ZoneIndexSet* set, size_t word) noexcept :
+            m_set(set), m_word(word), m_bits(set->GetWord(word))
+        {
+            SkipEmptyWords();
+        }
+
+        void SkipEmptyWords() noexcept
+        {
+            const size_t wordCount = m_set->WordCount();
+            while (m_bits == 0 && m_word + 1 < wordCount)
+            {
+                m_bits = m_set->GetWord(++m_word);
+            }
+
+            if (m_bits == 0)
+            {
+                m_word = wordCount;
+            }
+        }
+
+        const ZoneIndexSet* m_set = nullptr;
+        size_t m_word = 0;
+        Word m_bits = 0;
+    };
+
+    using iterator = const_iterator;
+    using value_type = ZoneIndex;
+    using size_type = size_t;
+
+    ZoneIndexSet() noexcept = default;
+
+    ZoneIndexSet(std::initializer_list<ZoneIndex> indices)
+    {
+        for (ZoneIndex index : indices)
+        {
+            insert(index);
+        }
+    }
+
+    const_iterator begin() const noexcept { return const_iterator(this, 0); }
+    const_iterator end() const noexcept { return const_iterator(this, WordCount()); }
+
+    bool empty() const noexcept
+    {
+        for (size_t i = 0; i < WordCount(); ++i)
+        {
+            if (GetWord(i) != 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    size_t size() const noexcept
+    {
+        size_t result = 0;
+        for (size_t i = 0; i < WordCount(); ++i)
+        {
+            result += static_cast<size_t>(std::popcount(GetWord(i)));
+        }
+
+        return result;
+    }
+
+    bool contains(ZoneIndex index) const noexcept
+    {
+        if (index < 0)
+        {
+            return false;
+        }
+
+        const auto bit = static_cast<size_t>(index);
+        return (GetWord(bit / WordBits) >> (bit % WordBits)) & 1;
+    }
+
+    // Indices outside [0, MaxZoneCount) are not valid zones and are ignored
+    void insert(ZoneIndex index)
+    {
+        if (index < 0 || index >= MaxZoneCount)
+        {
+            return;
+        }
+
+        const auto bit = static_cast<size_t>(index);
+        if (bit / WordBits >= WordCount())
+        {
+            m_overflow.resize(bit / WordBits + 1 - InlineWords);
+        }
+
+        WordAt(bit / WordBits) |= Word{ 1 } << (bit % WordBits);
+    }
+
+    // Same as insert, the set stays ordered whatever the insertion order
+    void push_back(ZoneIndex index) { insert(index); }
+
+    void erase(ZoneIndex index) noexcept
+    {
+        const auto bit = static_cast<size_t>(index);
+        if (index >= 0 && bit / WordBits < WordCount())
+        {
+            WordAt(bit / WordBits) &= ~(Word{ 1 } << (bit % WordBits));
+        }
+    }
+
+    void clear() noexcept
+    {
+        m_inline = {};
+        m_overflow.clear();
+    }
+
+    // Smallest index, the set must not be empty
+    ZoneIndex front() const noexcept
+    {
+        return *begin();
+    }
+
+    // Index at the given position in ascending order, the position must be less than size()
+    ZoneIndex operator[](size_t position) const noexcept
+    {
+        for (size_t i = 0; i < WordCount(); ++i)
+        {
+            Word bits = GetWord(i);
+            const auto count = static_cast<size_t>(std::popcount(bits));
+            if (position < count)
+            {
+                for (; position > 0; --position)
+                {
+                    bits &= bits - 1;
+                }
+
+                return static_cast<ZoneIndex>(i * WordBits + static_cast<size_t>(std::countr_zero(bits)));
+            }
+
+            position -= count;
+        }
+
+        return -1;
+    }
+
+    ZoneIndex at(size_t position) const
+    {
+        if (position >= size())
+        {
+            throw std::out_of_range("ZoneIndexSet position out of range");
+        }
+
+        return (*this)[position];
+    }
+
+    ZoneIndexSet& operator|=(const ZoneIndexSet& other)
+    {
+        if (other.WordCount() > WordCount())
+        {
+            m_overflow.resize(other.WordCount() - InlineWords);
+        }
+
+        for (size_t i = 0; i < other.WordCount(); ++i)
+        {
+            WordAt(i) |= other.GetWord(i);
+        }
+
+        return *this;
+    }
+
+    ZoneIndexSet& operator&=(const ZoneIndexSet& other) noexcept
+    {
+        for (size_t i = 0; i < WordCount(); ++i)
+        {
+            WordAt(i) &= other.GetWord(i);
+        }
+
+        return *this;
+    }
+
+    friend ZoneIndexSet operator|(ZoneIndexSet lhs, const ZoneIndexSet& rhs)
+    {
+        lhs |= rhs;
+        return lhs;
+    }
+
+    friend ZoneIndexSet operator&(ZoneIndexSet lhs, const ZoneIndexSet& rhs)
+    {
+        lhs &= rhs;
+        return lhs;
+    }
+
+    bool intersects(const ZoneIndexSet& other) const noexcept
+    {
+        for (size_t i = 0; i < min(WordCount(), other.WordCount()); ++i)
+        {
+            if (GetWord(i) & other.GetWord(i))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool operator==(const ZoneIndexSet& other) const noexcept
+    {
+        for (size_t i = 0; i < max(WordCount(), other.WordCount()); ++i)
+        {
+            if (GetWord(i) != other.GetWord(i))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool operator==(const std::vector<ZoneIndex>& indices) const noexcept
+    {
+        return std::equal(begin(), end(), indices.begin(), indices.end());
+    }
+
+    // Orders sets like sorted index vectors, so they can be used as map keys
+    bool operator<(const ZoneIndexSet& other) const noexcept
+    {
+        return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+    }
+
+    // Raw words, used to store the set compactly. Words past WordCount() are zero.
+    size_t WordCount() const noexcept
+    {
+        return InlineWords + m_overflow.size();
+    }
+
+    Word GetWord(size_t word) const noexcept
+    {
+        if (word < InlineWords)
+        {
+            return m_inline[word];
+        }
+
+        return word - InlineWords < m_overflow.size() ? m_overflow[word - InlineWords] : 0;
+    }
+
+    // Words from MaxWords on hold no valid zones and are ignored
+    void SetWord(size_t word, Word bits)
+    {
+        if (word >= WordCount())
+        {
+            if (bits == 0 || word >= MaxWords)
+            {
+                return;
+            }
+
+            m_overflow.resize(word + 1 - InlineWords);
+        }
+
+        WordAt(word) = bits;
+    }
+
+private:
+    Word& WordAt(size_t word) noexcept
+    {
+        return word < InlineWords ? m_inline[word] : m_overflow[word - InlineWords];
+    }
+
+    std::array<Word, InlineWords> m_inline{};
+    std::vector<Word> m_overflow;
+};
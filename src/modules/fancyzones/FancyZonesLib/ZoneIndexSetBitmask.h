@@ -7,52 +7,19 @@ struct ZoneIndexSetBitmask
     uint64_t part1{ 0 }; // represents 0-63 zones
     uint64_t part2{ 0 }; // represents 64-127 zones
 
-    static ZoneIndexSetBitmask FromIndexSet(const ZoneIndexSet& set)
+    static ZoneIndexSetBitmask FromIndexSet(const ZoneIndexSet& set) noexcept
     {
-        ZoneIndexSetBitmask bitmask{};
-
-        for (const auto zoneIndex : set)
-        {
-            if (zoneIndex <= std::numeric_limits<ZoneIndex>::digits)
-            {
-                bitmask.part1 |= 1ull << zoneIndex;
-            }
-            else
-            {
-                ZoneIndex index = zoneIndex - std::numeric_limits<ZoneIndex>::digits - 1;
-                bitmask.part2 |= 1ull << index;
-            }
-        }
-
-        return bitmask;
+        return ZoneIndexSetBitmask{
+            .part1 = set.GetWord(0),
+            .part2 = set.GetWord(1),
+        };
     }
 
-    ZoneIndexSet ToIndexSet() const noexcept
+    ZoneIndexSet ToIndexSet() const
     {
         ZoneIndexSet zoneIndexSet;
-
-        if (part1 != 0)
-        {
-            for (ZoneIndex i = 0; i <= std::numeric_limits<ZoneIndex>::digits; i++)
-            {
-                if ((1ull << i) & part1)
-                {
-                    zoneIndexSet.push_back(i);
-                }
-            }
-        }
-
-        if (part2 != 0)
-        {
-            for (ZoneIndex i = 0; i <= std::numeric_limits<ZoneIndex>::digits; i++)
-            {
-                if ((1ull << i) & part2)
-                {
-                    zoneIndexSet.push_back(i + std::numeric_limits<ZoneIndex>::digits + 1);
-                }
-            }
-        }
-
+        zoneIndexSet.SetWord(0, part1);
+        zoneIndexSet.SetWord(1, part2);
         return zoneIndexSet;
     }
 };
\ No newline at end of file
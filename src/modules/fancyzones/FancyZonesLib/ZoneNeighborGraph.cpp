@@ -0,0 +1,204 @@
+#include "pch.h"
+#include "ZoneNeighborGraph.h"
+
+namespace
+{
+    constexpr std::array<DWORD, 4> Directions = { VK_LEFT, VK_RIGHT, VK_UP, VK_DOWN };
+
+    size_t DirectionIndex(DWORD vkCode) noexcept
+    {
+        for (size_t i = 0; i < Directions.size(); ++i)
+        {
+            if (Directions[i] == vkCode)
+            {
+                return i;
+            }
+        }
+
+        return Directions.size();
+    }
+
+    RECT ToRect(const FancyZonesUtils::Rect& rect) noexcept
+    {
+        return RECT{ rect.left(), rect.top(), rect.right(), rect.bottom() };
+    }
+}
+
+void ZoneNeighborGraph::Build(const std::vector<WorkAreaInfo>& workAreas, const std::vector<const ZonesMap*>& zones, RECT combinedRect)
+{
+    Clear();
+
+    m_workAreas = workAreas;
+    m_combinedRect = combinedRect;
+
+    m_workAreaStart.reserve(workAreas.size() + 1);
+    for (size_t i = 0; i < workAreas.size(); ++i)
+    {
+        m_workAreaStart.push_back(m_nodes.size());
+        if (i >= zones.size() || !zones[i])
+        {
+            continue;
+        }
+
+        const auto& origin = workAreas[i].monitorRect;
+        for (const auto& [zoneId, zone] : *zones[i])
+        {
+            RECT rect = zone.GetZoneRect();
+            rect.left += origin.left();
+            rect.right += origin.left();
+            rect.top += origin.top();
+            rect.bottom += origin.top();
+
+            m_nodes.push_back(NodeData{ .node = { workAreas[i].monitor, zoneId }, .rect = rect, .workArea = i });
+        }
+    }
+
+    m_workAreaStart.push_back(m_nodes.size());
+    m_edges.assign(m_nodes.size() * EdgeKindCount * DirectionCount, NoNode);
+
+    std::vector<size_t> candidates;
+    std::vector<RECT> candidateRects;
+    candidates.reserve(m_nodes.size());
+    candidateRects.reserve(m_nodes.size());
+
+    auto connect = [&](size_t node, EdgeKind kind, const std::optional<RECT>& cyclingRect) {
+        candidateRects.clear();
+        for (size_t candidate : candidates)
+        {
+            candidateRects.push_back(m_nodes[candidate].rect);
+        }
+
+        for (size_t direction = 0; direction < DirectionCount; ++direction)
+        {
+            const DWORD vkCode = Directions[direction];
+            const RECT start = cyclingRect ? FancyZonesUtils::PrepareRectForCycling(m_nodes[node].rect, *cyclingRect, vkCode) : m_nodes[node].rect;
+            const size_t chosen = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, start, candidateRects);
+            if (chosen < candidates.size())
+            {
+                m_edges[(node * EdgeKindCount + static_cast<size_t>(kind)) * DirectionCount + direction] = candidates[chosen];
+            }
+        }
+    };
+
+    for (size_t node = 0; node < m_nodes.size(); ++node)
+    {
+        const size_t workArea = m_nodes[node].workArea;
+        const size_t first = m_workAreaStart[workArea];
+        const size_t last = m_workAreaStart[workArea + 1];
+
+        // Same candidates as WindowKeyboardSnap::MoveByDirectionAndPosition: the other zones of the work area,
+        // then all of them when cycling
+        candidates.clear();
+        for (size_t i = first; i < last; ++i)
+        {
+            if (i != node)
+            {
+                candidates.push_back(i);
+            }
+        }
+
+        connect(node, EdgeKind::SameWorkArea, std::nullopt);
+
+        candidates.clear();
+        for (size_t i = first; i < last; ++i)
+        {
+            candidates.push_back(i);
+        }
+
+        connect(node, EdgeKind::SameWorkAreaCycle, ToRect(m_workAreas[workArea].workAreaRect));
+
+        // Same candidates as WindowKeyboardSnap::SnapBasedOnPositionOnAnotherMonitor: the zones of the other
+        // work areas in monitor order, then the zones of this work area at the end when cycling
+        candidates.clear();
+        for (size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            if (i < first || i >= last)
+            {
+                candidates.push_back(i);
+            }
+        }
+
+        connect(node, EdgeKind::OtherWorkArea, std::nullopt);
+
+        for (size_t i = first; i < last; ++i)
+        {
+            candidates.push_back(i);
+        }
+
+        connect(node, EdgeKind::AnyWorkAreaCycle, combinedRect);
+    }
+}
+
+void ZoneNeighborGraph::Clear() noexcept
+{
+    m_workAreas.clear();
+    m_combinedRect = {};
+    m_nodes.clear();
+    m_workAreaStart.clear();
+    m_edges.clear();
+}
+
+bool ZoneNeighborGraph::IsBuiltFor(const std::vector<WorkAreaInfo>& workAreas, RECT combinedRect) const noexcept
+{
+    return !m_workAreaStart.empty() && m_workAreas == workAreas && m_combinedRect == FancyZonesUtils::Rect(combinedRect);
+}
+
+size_t ZoneNeighborGraph::Find(HMONITOR monitor, ZoneIndex zone) const noexcept
+{
+    if (zone < 0)
+    {
+        return NoNode;
+    }
+
+    for (size_t i = 0; i < m_workAreas.size(); ++i)
+    {
+        if (m_workAreas[i].monitor != monitor)
+        {
+            continue;
+        }
+
+        const size_t first = m_workAreaStart[i];
+        const size_t last = m_workAreaStart[i + 1];
+
+        // Zone ids of a layout are 0..n-1, so this is the node unless the layout skips ids
+        const size_t direct = first + static_cast<size_t>(zone);
+        if (direct < last && m_nodes[direct].node.zone == zone)
+        {
+            return direct;
+        }
+
+        const auto found = std::lower_bound(m_nodes.begin() + first, m_nodes.begin() + last, zone, [](const NodeData& data, ZoneIndex id) {
+            return data.node.zone < id;
+        });
+
+        if (found != m_nodes.begin() + last && found->node.zone == zone)
+        {
+            return static_cast<size_t>(found - m_nodes.begin());
+        }
+
+        return NoNode;
+    }
+
+    return NoNode;
+}
+
+size_t ZoneNeighborGraph::Neighbor(size_t node, DWORD vkCode, EdgeKind kind) const noexcept
+{
+    const size_t direction = DirectionIndex(vkCode);
+    if (node >= m_nodes.size() || direction >= DirectionCount)
+    {
+        return NoNode;
+    }
+
+    return m_edges[(node * EdgeKindCount + static_cast<size_t>(kind)) * DirectionCount + direction];
+}
+
+const ZoneNeighborGraph::Node& ZoneNeighborGraph::GetNode(size_t node) const noexcept
+{
+    return m_nodes[node].node;
+}
+
+size_t ZoneNeighborGraph::NodeCount() const noexcept
+{
+    return m_nodes.size();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <FancyZonesLib/LayoutConfigurator.h> // ZonesMap
+#include <FancyZonesLib/util.h>
+
+/**
+ * Directional neighbors of the zones of all work areas, so moving a window snapped to a single zone with
+ * Win+Arrow is a lookup instead of a scan over the zones of every monitor. The neighbors are chosen once with
+ * FancyZonesUtils::ChooseNextZoneByPosition, starting from the zone rectangle, with the same candidates
+ * and in the same order as the scan.
+ */
+class ZoneNeighborGraph
+{
+public:
+    static constexpr size_t NoNode = SIZE_MAX;
+
+    enum class EdgeKind
+    {
+        // Another zone of the same work area
+        SameWorkArea,
+        // Any zone of the same work area, entering from the opposite edge of the work area
+        SameWorkAreaCycle,
+        // A zone of another work area
+        OtherWorkArea,
+        // Any zone, entering from the opposite edge of all monitors combined
+        AnyWorkAreaCycle,
+    };
+
+    struct WorkAreaInfo
+    {
+        HMONITOR monitor{};
+        // Origin of the zone rectangles in virtual screen coordinates
+        FancyZonesUtils::Rect monitorRect{};
+        // Size used to move off the opposite edge when cycling within the work area
+        FancyZonesUtils::Rect workAreaRect{};
+        // Layout::Generation of the layout the zones come from
+        uint64_t layoutGeneration{};
+
+        bool operator==(const WorkAreaInfo& other) const = default;
+    };
+
+    struct Node
+    {
+        HMONITOR monitor{};
+        ZoneIndex zone{};
+    };
+
+    // Work areas in monitor order, the zones of each one are taken from the matching entry of zones
+    void Build(const std::vector<WorkAreaInfo>& workAreas, const std::vector<const ZonesMap*>& zones, RECT combinedRect);
+    void Clear() noexcept;
+
+    // Whether the graph was built for these work areas, checked before every lookup
+    bool IsBuiltFor(const std::vector<WorkAreaInfo>& workAreas, RECT combinedRect) const noexcept;
+
+    size_t Find(HMONITOR monitor, ZoneIndex zone) const noexcept;
+    size_t Neighbor(size_t node, DWORD vkCode, EdgeKind kind) const noexcept;
+    const Node& GetNode(size_t node) const noexcept;
+
+    size_t NodeCount() const noexcept;
+
+private:
+    static constexpr size_t DirectionCount = 4;
+    static constexpr size_t EdgeKindCount = 4;
+
+    struct NodeData
+    {
+        Node node;
+        RECT rect;
+        size_t workArea;
+    };
+
+    std::vector<WorkAreaInfo> m_workAreas;
+    FancyZonesUtils::Rect m_combinedRect{};
+
+    // Nodes of work area i are m_nodes[m_workAreaStart[i]..m_workAreaStart[i + 1]), in zone id order
+    std::vector<NodeData> m_nodes;
+    std::vector<size_t> m_workAreaStart;
+
+    // DirectionCount * EdgeKindCount neighbors per node
+    std::vector<size_t> m_edges;
+};
@@ -0,0 +1,178 @@
+#include "pch.h"
+#include "ZoneSpatialIndex.h"
+
+#include <cmath>
+
+namespace
+{
+    // More cells than zones keeps the candidate lists short for the small zones of dense canvas layouts
+    constexpr int MaxGridDimension = 64;
+
+    int CellCoordinate(LONG value, LONG min, LONG max, int cells) noexcept
+    {
+        const int64_t span = static_cast<int64_t>(max) - min + 1;
+        const int64_t cell = (static_cast<int64_t>(value) - min) * cells / span;
+        return static_cast<int>(std::clamp<int64_t>(cell, 0, cells - 1));
+    }
+}
+
+void ZoneSpatialIndex::Build(const ZonesMap& zones, int sensitivityRadius)
+{
+    m_entries.clear();
+    m_cellStart.clear();
+    m_cellEntries.clear();
+    m_overlaps.clear();
+    m_sensitivityRadius = sensitivityRadius;
+    m_columns = 0;
+    m_rows = 0;
+
+    if (zones.empty())
+    {
+        return;
+    }
+
+    m_entries.reserve(zones.size());
+    for (const auto& [zoneId, zone] : zones)
+    {
+        m_entries.push_back(Entry{ zoneId, zone.GetZoneRect() });
+    }
+
+    // A negative radius shrinks the captured area, but the strict test still needs the whole zone
+    const LONG expand = max(sensitivityRadius, 0);
+    auto expanded = [expand](const RECT& rect) {
+        return RECT{ rect.left - expand, rect.top - expand, rect.right + expand, rect.bottom + expand };
+    };
+
+    m_bounds = expanded(m_entries[0].rect);
+    for (const auto& entry : m_entries)
+    {
+        const RECT rect = expanded(entry.rect);
+        m_bounds.left = min(m_bounds.left, rect.left);
+        m_bounds.top = min(m_bounds.top, rect.top);
+        m_bounds.right = max(m_bounds.right, rect.right);
+        m_bounds.bottom = max(m_bounds.bottom, rect.bottom);
+    }
+
+    const int dimension = std::clamp(2 * static_cast<int>(std::ceil(std::sqrt(static_cast<double>(m_entries.size())))), 1, MaxGridDimension);
+    m_columns = dimension;
+    m_rows = dimension;
+
+    // Counting pass, then fill, so every cell lists its entries in zone id order
+    const size_t cellCount = static_cast<size_t>(m_columns) * m_rows;
+    std::vector<RECT> cellRanges;
+    cellRanges.reserve(m_entries.size());
+    m_cellStart.assign(cellCount + 1, 0);
+    for (const auto& entry : m_entries)
+    {
+        const RECT rect = expanded(entry.rect);
+        RECT range{
+            CellCoordinate(rect.left, m_bounds.left, m_bounds.right, m_columns),
+            CellCoordinate(rect.top, m_bounds.top, m_bounds.bottom, m_rows),
+            CellCoordinate(rect.right, m_bounds.left, m_bounds.right, m_columns),
+            CellCoordinate(rect.bottom, m_bounds.top, m_bounds.bottom, m_rows)
+        };
+        cellRanges.push_back(range);
+
+        for (LONG row = range.top; row <= range.bottom; ++row)
+        {
+            for (LONG column = range.left; column <= range.right; ++column)
+            {
+                ++m_cellStart[static_cast<size_t>(row) * m_columns + column + 1];
+            }
+        }
+    }
+
+    for (size_t i = 1; i <= cellCount; ++i)
+    {
+        m_cellStart[i] += m_cellStart[i - 1];
+    }
+
+    m_cellEntries.resize(m_cellStart[cellCount]);
+    std::vector<uint32_t> fill(m_cellStart.begin(), m_cellStart.end() - 1);
+    for (uint32_t i = 0; i < m_entries.size(); ++i)
+    {
+        const RECT& range = cellRanges[i];
+        for (LONG row = range.top; row <= range.bottom; ++row)
+        {
+            for (LONG column = range.left; column <= range.right; ++column)
+            {
+                m_cellEntries[fill[static_cast<size_t>(row) * m_columns + column]++] = i;
+            }
+        }
+    }
+
+    // Same overlap test ZonesFromPoint used to run on every query
+    m_overlapStride = (m_entries.size() + 63) / 64;
+    m_overlaps.assign(m_overlapStride * m_entries.size(), 0);
+    for (size_t i = 0; i < m_entries.size(); ++i)
+    {
+        const RECT& rectI = m_entries[i].rect;
+        for (size_t j = i + 1; j < m_entries.size(); ++j)
+        {
+            const RECT& rectJ = m_entries[j].rect;
+            if (max(rectI.top, rectJ.top) + sensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
+                max(rectI.left, rectJ.left) + sensitivityRadius < min(rectI.right, rectJ.right))
+            {
+                m_overlaps[i * m_overlapStride + j / 64] |= 1ull << (j % 64);
+                m_overlaps[j * m_overlapStride + i / 64] |= 1ull << (i % 64);
+            }
+        }
+    }
+}
+
+ZoneSpatialIndex::QueryResult ZoneSpatialIndex::Query(POINT pt) const
+{
+    QueryResult result;
+    if (m_entries.empty() ||
+        pt.x < m_bounds.left || pt.x > m_bounds.right ||
+        pt.y < m_bounds.top || pt.y > m_bounds.bottom)
+    {
+        return result;
+    }
+
+    const size_t cell = static_cast<size_t>(CellCoordinate(pt.y, m_bounds.top, m_bounds.bottom, m_rows)) * m_columns +
+                        CellCoordinate(pt.x, m_bounds.left, m_bounds.right, m_columns);
+
+    // Indices into m_entries, unlike capturedZones
+    ZoneIndexSet captured;
+    for (uint32_t k = m_cellStart[cell]; k < m_cellStart[cell + 1]; ++k)
+    {
+        const uint32_t i = m_cellEntries[k];
+        const RECT& zoneRect = m_entries[i].rect;
+        if (zoneRect.left - m_sensitivityRadius <= pt.x && pt.x <= zoneRect.right + m_sensitivityRadius &&
+            zoneRect.top - m_sensitivityRadius <= pt.y && pt.y <= zoneRect.bottom + m_sensitivityRadius)
+        {
+            result.overlap = result.overlap || OverlapsAny(i, captured);
+
+            captured.insert(i);
+            result.capturedZones.insert(m_entries[i].id);
+        }
+
+        if (zoneRect.left <= pt.x && pt.x < zoneRect.right &&
+            zoneRect.top <= pt.y && pt.y < zoneRect.bottom)
+        {
+            result.strictlyCaptured = true;
+        }
+    }
+
+    return result;
+}
+
+size_t ZoneSpatialIndex::CellCount() const noexcept
+{
+    return static_cast<size_t>(m_columns) * m_rows;
+}
+
+bool ZoneSpatialIndex::OverlapsAny(size_t entry, const ZoneIndexSet& entries) const noexcept
+{
+    // The row of the entry uses the same word layout as the set, so this is a word-wise intersection
+    for (size_t word = 0; word < m_overlapStride && word < entries.WordCount(); ++word)
+    {
+        if (m_overlaps[entry * m_overlapStride + word] & entries.GetWord(word))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <FancyZonesLib/LayoutConfigurator.h> // ZonesMap
+
+/**
+ * Uniform grid over the zone rectangles of a layout, expanded by the sensitivity radius, so a point query
+ * during dragging only tests the zones registered in the cell under the cursor. Which zones overlap each other
+ * by more than the sensitivity radius is computed once, when the index is built.
+ */
+class ZoneSpatialIndex
+{
+public:
+    struct QueryResult
+    {
+        // Zones within the sensitivity radius of the point, ordered by zone id
+        ZoneIndexSet capturedZones;
+        // The point is inside at least one zone
+        bool strictlyCaptured = false;
+        // At least two of the captured zones overlap
+        bool overlap = false;
+    };
+
+    void Build(const ZonesMap& zones, int sensitivityRadius);
+    QueryResult Query(POINT pt) const;
+
+    size_t CellCount() const noexcept;
+
+private:
+    struct Entry
+    {
+        ZoneIndex id;
+        RECT rect;
+    };
+
+    // Whether the entry overlaps any of the given entries, which are indices into m_entries
+    bool OverlapsAny(size_t entry, const ZoneIndexSet& entries) const noexcept;
+
+    std::vector<Entry> m_entries;
+    int m_sensitivityRadius = 0;
+
+    // Inclusive bounds of all expanded zone rectangles
+    RECT m_bounds{};
+    int m_columns = 0;
+    int m_rows = 0;
+
+    // Entries of cell i are m_cellEntries[m_cellStart[i]..m_cellStart[i + 1]), in zone id order
+    std::vector<uint32_t> m_cellStart;
+    std::vector<uint32_t> m_cellEntries;
+
+    // Row-major bit matrix, m_overlapStride words per entry
+    std::vector<uint64_t> m_overlaps;
+    size_t m_overlapStride = 0;
+};
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include <filesystem>
+#include <fstream>
 
 #include <FancyZonesLib/FancyZonesData/AppZoneHistory.h>
 
@@ -22,7 +23,10 @@ namespace FancyZonesUnitTests
 
         TEST_METHOD_CLEANUP(CleanUp)
         {
-            std::filesystem::remove(AppZoneHistory::instance().AppZoneHistoryFileName());
+            AppZoneHistory::instance().SetJournalDelays(AppZoneHistory::JournalAppendDelay, AppZoneHistory::JournalCompactDelay);
+            AppZoneHistory::instance().Flush();
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (AppZoneHistoryParse)
@@ -135,6 +139,129 @@ namespace FancyZonesUnitTests
             Assert::IsTrue(AppZoneHistory::instance().GetFullAppZoneHistory().empty());
         }
 
+        TEST_METHOD (AppZoneHistoryJournalReplay)
+        {
+            // prepare
+            const FancyZonesDataTypes::AppZoneHistoryData data{
+                .layoutId = FancyZonesUtils::GuidFromString(L"{61FA9FC0-26A6-4B37-A834-491C148DFC57}").value(),
+                .workAreaId = { .monitorId = { .deviceId = { .id = L"monitor-1" } }, .virtualDesktopId = FancyZonesUtils::GuidFromString(L"{72FA9FC0-26A6-4B37-A834-491C148DFC58}").value() },
+                .zoneIndexSet = { 0 }
+            };
+            AppZoneHistory::instance().SetAppZoneHistory({ { L"app-1", { data } }, { L"app-2", { data } } });
+            AppZoneHistory::instance().SaveData();
+
+            const auto generation = static_cast<int64_t>(json::from_file(AppZoneHistory::AppZoneHistoryFileName())->GetNamedNumber(NonLocalizable::AppZoneHistoryIds::GenerationID));
+            {
+                std::ofstream journal(AppZoneHistory::AppZoneHistoryJournalFileName(), std::ios::binary);
+                journal << "{\"generation\":" << generation << "}\n";
+                journal << "{\"app-path\":\"app-3\",\"history\":[{\"zone-index-set\":[2],\"device\":{\"monitor\":\"monitor-1\",\"virtual-desktop\":\"{72FA9FC0-26A6-4B37-A834-491C148DFC58}\"},\"zoneset-uuid\":\"{61FA9FC0-26A6-4B37-A834-491C148DFC57}\"}]}\n";
+                journal << "{\"app-path\":\"app-1\",\"history\":[]}\n";
+                // torn by a crash
+                journal << "{\"app-path\":\"app-2\",\"hist";
+            }
+
+            // test
+            AppZoneHistory::instance().LoadData();
+            const auto& history = AppZoneHistory::instance().GetFullAppZoneHistory();
+            Assert::AreEqual((size_t)2, history.size());
+            Assert::IsFalse(history.contains(L"app-1"));
+            Assert::IsTrue(history.contains(L"app-2"));
+            Assert::IsTrue(history.at(L"app-3")[0].zoneIndexSet == ZoneIndexSet{ 2 });
+
+            // replayed changes are saved to the file
+            Assert::IsFalse(std::filesystem::exists(AppZoneHistory::AppZoneHistoryJournalFileName()));
+            AppZoneHistory::instance().LoadData();
+            Assert::AreEqual((size_t)2, AppZoneHistory::instance().GetFullAppZoneHistory().size());
+        }
+
+        TEST_METHOD (AppZoneHistoryDropsCorruptZoneIndex)
+        {
+            // prepare
+            AppZoneHistory::instance().SetAppZoneHistory({});
+            AppZoneHistory::instance().SaveData();
+
+            const auto generation = static_cast<int64_t>(json::from_file(AppZoneHistory::AppZoneHistoryFileName())->GetNamedNumber(NonLocalizable::AppZoneHistoryIds::GenerationID));
+            {
+                std::ofstream journal(AppZoneHistory::AppZoneHistoryJournalFileName(), std::ios::binary);
+                journal << "{\"generation\":" << generation << "}\n";
+                journal << "{\"app-path\":\"app-1\",\"history\":[{\"zone-index-set\":[1e13],\"device\":{\"monitor\":\"monitor-1\",\"virtual-desktop\":\"{72FA9FC0-26A6-4B37-A834-491C148DFC58}\"},\"zoneset-uuid\":\"{61FA9FC0-26A6-4B37-A834-491C148DFC57}\"}]}\n";
+                journal << "{\"app-path\":\"app-2\",\"history\":[{\"zone-index-set\":[-1],\"device\":{\"monitor\":\"monitor-1\",\"virtual-desktop\":\"{72FA9FC0-26A6-4B37-A834-491C148DFC58}\"},\"zoneset-uuid\":\"{61FA9FC0-26A6-4B37-A834-491C148DFC57}\"}]}\n";
+                journal << "{\"app-path\":\"app-3\",\"history\":[{\"zone-index-set\":[1023],\"device\":{\"monitor\":\"monitor-1\",\"virtual-desktop\":\"{72FA9FC0-26A6-4B37-A834-491C148DFC58}\"},\"zoneset-uuid\":\"{61FA9FC0-26A6-4B37-A834-491C148DFC57}\"}]}\n";
+            }
+
+            // test
+            AppZoneHistory::instance().LoadData();
+            const auto& history = AppZoneHistory::instance().GetFullAppZoneHistory();
+            Assert::IsFalse(history.contains(L"app-1"));
+            Assert::IsFalse(history.contains(L"app-2"));
+            Assert::IsTrue(history.at(L"app-3")[0].zoneIndexSet == ZoneIndexSet{ 1023 });
+        }
+
+        TEST_METHOD (AppZoneHistoryStaleJournalIgnored)
+        {
+            // prepare
+            const FancyZonesDataTypes::AppZoneHistoryData data{
+                .layoutId = FancyZonesUtils::GuidFromString(L"{61FA9FC0-26A6-4B37-A834-491C148DFC57}").value(),
+                .workAreaId = { .monitorId = { .deviceId = { .id = L"monitor-1" } }, .virtualDesktopId = FancyZonesUtils::GuidFromString(L"{72FA9FC0-26A6-4B37-A834-491C148DFC58}").value() },
+                .zoneIndexSet = { 0 }
+            };
+            AppZoneHistory::instance().SetAppZoneHistory({ { L"app-1", { data } } });
+            AppZoneHistory::instance().SaveData();
+
+            // journal written for the previous file
+            const auto generation = static_cast<int64_t>(json::from_file(AppZoneHistory::AppZoneHistoryFileName())->GetNamedNumber(NonLocalizable::AppZoneHistoryIds::GenerationID));
+            {
+                std::ofstream journal(AppZoneHistory::AppZoneHistoryJournalFileName(), std::ios::binary);
+                journal << "{\"generation\":" << generation - 1 << "}\n";
+                journal << "{\"app-path\":\"app-1\",\"history\":[]}\n";
+            }
+
+            // test
+            AppZoneHistory::instance().LoadData();
+            Assert::AreEqual((size_t)1, AppZoneHistory::instance().GetFullAppZoneHistory().size());
+            Assert::IsTrue(AppZoneHistory::instance().GetFullAppZoneHistory().contains(L"app-1"));
+        }
+
+        TEST_METHOD (AppLastZonesSavedToJournal)
+        {
+            const auto layoutId = FancyZonesUtils::GuidFromString(L"{2FEC41DA-3A0B-4E31-9CE1-9473C65D99F2}").value();
+            const FancyZonesDataTypes::WorkAreaId workAreaId{
+                .monitorId = { .deviceId = { .id = L"DELA026", .instanceId = L"5&10a58c63&0&UID16777488" } },
+                .virtualDesktopId = FancyZonesUtils::GuidFromString(L"{39B25DD2-130D-4B5D-8851-4791D66B1539}").value()
+            };
+            const auto window = Mocks::WindowCreate(m_hInst);
+            AppZoneHistory::instance().SaveData();
+
+            // keep the timers from writing behind the test's back
+            AppZoneHistory::instance().SetJournalDelays(std::chrono::hours(1), std::chrono::hours(1));
+            Assert::IsTrue(AppZoneHistory::instance().SetAppLastZones(window, workAreaId, layoutId, { 1 }));
+            Assert::IsFalse(std::filesystem::exists(AppZoneHistory::AppZoneHistoryJournalFileName()));
+
+            // the change is appended to the journal, the file is only rewritten once snapping goes idle
+            AppZoneHistory::instance().AppendJournal();
+            Assert::IsTrue(std::filesystem::exists(AppZoneHistory::AppZoneHistoryJournalFileName()));
+            Assert::AreEqual(0u, json::from_file(AppZoneHistory::AppZoneHistoryFileName())->GetNamedArray(NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID).Size());
+
+            AppZoneHistory::instance().LoadData();
+            Assert::AreEqual((size_t)1, AppZoneHistory::instance().GetFullAppZoneHistory().size());
+        }
+
+        TEST_METHOD (AppLastZonesSavedOnFlush)
+        {
+            const auto layoutId = FancyZonesUtils::GuidFromString(L"{2FEC41DA-3A0B-4E31-9CE1-9473C65D99F2}").value();
+            const FancyZonesDataTypes::WorkAreaId workAreaId{
+                .monitorId = { .deviceId = { .id = L"DELA026", .instanceId = L"5&10a58c63&0&UID16777488" } },
+                .virtualDesktopId = FancyZonesUtils::GuidFromString(L"{39B25DD2-130D-4B5D-8851-4791D66B1539}").value()
+            };
+            const auto window = Mocks::WindowCreate(m_hInst);
+
+            Assert::IsTrue(AppZoneHistory::instance().SetAppLastZones(window, workAreaId, layoutId, { 1 }));
+            AppZoneHistory::instance().Flush();
+
+            Assert::IsFalse(std::filesystem::exists(AppZoneHistory::AppZoneHistoryJournalFileName()));
+            Assert::AreEqual(1u, json::from_file(AppZoneHistory::AppZoneHistoryFileName())->GetNamedArray(NonLocalizable::AppZoneHistoryIds::AppZoneHistoryID).Size());
+        }
+
         TEST_METHOD (AppZoneHistoryParseInvalid)
         {
             // prepare
@@ -373,7 +500,9 @@ namespace FancyZonesUnitTests
 
         TEST_METHOD_CLEANUP(CleanUp)
         {
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (SyncVirtualDesktops_SwitchVirtualDesktop)
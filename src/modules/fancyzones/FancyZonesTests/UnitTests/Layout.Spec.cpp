@@ -4,6 +4,7 @@
 
 #include <FancyZonesLib/FancyZonesData/LayoutDefaults.h>
 #include <FancyZonesLib/FancyZonesData/CustomLayouts.h>
+#include <FancyZonesLib/FancyZonesWindowProperties.h>
 #include <FancyZonesLib/ZoneIndexSetBitmask.h>
 #include <FancyZonesLib/Layout.h>
 #include <FancyZonesLib/Settings.h>
@@ -507,5 +508,122 @@ namespace FancyZonesUnitTests
                 Assert::AreEqual(set[i], actual[i]);
             }
         }
+
+        TEST_METHOD (IterationIsOrdered)
+        {
+            // prepare
+            ZoneIndexSet set;
+            set.insert(300);
+            set.insert(5);
+            set.insert(128);
+            set.insert(64);
+            set.insert(5);
+
+            // test
+            Assert::AreEqual(static_cast<size_t>(4), set.size());
+            Assert::IsTrue(set == std::vector<ZoneIndex>{ 5, 64, 128, 300 });
+            Assert::AreEqual(static_cast<ZoneIndex>(5), set.front());
+            Assert::AreEqual(static_cast<ZoneIndex>(300), set.at(3));
+            Assert::ExpectException<std::out_of_range>([&] { set.at(4); });
+        }
+
+        TEST_METHOD (InsertEraseBeyond128)
+        {
+            // prepare
+            ZoneIndexSet set{ 1, 200, 1000 };
+
+            // test
+            Assert::IsTrue(set.contains(200));
+            Assert::IsFalse(set.contains(201));
+
+            set.erase(200);
+            set.erase(5000);
+            Assert::IsFalse(set.contains(200));
+            Assert::IsTrue(set == std::vector<ZoneIndex>{ 1, 1000 });
+
+            set.clear();
+            Assert::IsTrue(set.empty());
+        }
+
+        TEST_METHOD (NegativeIndexIgnored)
+        {
+            ZoneIndexSet set{ -1, 3 };
+            Assert::IsTrue(set == std::vector<ZoneIndex>{ 3 });
+            Assert::IsFalse(set.contains(-1));
+        }
+
+        TEST_METHOD (UnionAndIntersection)
+        {
+            // prepare
+            const ZoneIndexSet first{ 0, 70, 129 };
+            const ZoneIndexSet second{ 70, 400 };
+
+            // test
+            Assert::IsTrue((first | second) == std::vector<ZoneIndex>{ 0, 70, 129, 400 });
+            Assert::IsTrue((first & second) == std::vector<ZoneIndex>{ 70 });
+            Assert::IsTrue((second & first) == std::vector<ZoneIndex>{ 70 });
+            Assert::IsTrue(first.intersects(second));
+            Assert::IsFalse(first.intersects(ZoneIndexSet{ 1, 400 }));
+        }
+
+        TEST_METHOD (EqualityIgnoresCapacity)
+        {
+            // prepare
+            ZoneIndexSet grown{ 1, 500 };
+            grown.erase(500);
+
+            // test
+            Assert::IsTrue(grown == ZoneIndexSet{ 1 });
+            Assert::IsTrue(ZoneIndexSet{ 1 } == grown);
+        }
+
+        TEST_METHOD (OrderingMatchesSortedVectors)
+        {
+            Assert::IsTrue(ZoneIndexSet{ 0, 5 } < ZoneIndexSet{ 1 });
+            Assert::IsTrue(ZoneIndexSet{ 1 } < ZoneIndexSet{ 1, 2 });
+            Assert::IsFalse(ZoneIndexSet{ 1, 2 } < ZoneIndexSet{ 1, 2 });
+            Assert::IsTrue(ZoneIndexSet{ 200 } < ZoneIndexSet{ 300 });
+        }
+
+        TEST_METHOD (CombinedZoneRangeBeyond128)
+        {
+            // prepare
+            LayoutData data{
+                .uuid = FancyZonesUtils::GuidFromString(L"{33A2B101-06E0-437B-A61E-CDBECF502906}").value(),
+                .type = ZoneSetLayoutType::Columns,
+                .showSpacing = false,
+                .spacing = 0,
+                .zoneCount = 200,
+                .sensitivityRadius = 20
+            };
+            auto layout = std::make_unique<Layout>(data);
+            Assert::IsTrue(layout->Init(RECT{ 0, 0, 4000, 1080 }, Mocks::Monitor()));
+
+            // test
+            const auto actual = layout->GetCombinedZoneRange({ 150 }, { 199 });
+            Assert::AreEqual(static_cast<size_t>(50), actual.size());
+            Assert::AreEqual(static_cast<ZoneIndex>(150), actual.front());
+            Assert::IsTrue(actual.contains(199));
+        }
+
+        TEST_METHOD (WindowPropertyRoundTripBeyond128)
+        {
+            // prepare
+            const auto window = Mocks::WindowCreate(static_cast<HINSTANCE>(GetModuleHandleW(nullptr)));
+            const ZoneIndexSet set{ 3, 31, 127, 128, 640, 1023 };
+
+            // test
+            Assert::IsTrue(FancyZonesWindowProperties::StampZoneIndexProperty(window, set));
+            Assert::IsTrue(set == FancyZonesWindowProperties::RetrieveZoneIndexProperty(window));
+
+            FancyZonesWindowProperties::RemoveZoneIndexProperty(window);
+            Assert::IsTrue(FancyZonesWindowProperties::RetrieveZoneIndexProperty(window).empty());
+        }
+
+        TEST_METHOD (WindowPropertyTooManyZones)
+        {
+            const auto window = Mocks::WindowCreate(static_cast<HINSTANCE>(GetModuleHandleW(nullptr)));
+            Assert::IsFalse(FancyZonesWindowProperties::StampZoneIndexProperty(window, ZoneIndexSet{ 1, 1024 }));
+        }
     };
 }
@@ -93,7 +93,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
         
         TEST_METHOD (Snap_Left)
@@ -305,7 +307,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (Snap_Left)
@@ -538,7 +542,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (Snap_Left)
@@ -845,7 +851,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (Snap_Left)
@@ -1148,7 +1156,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD(ExtendNonSnappedWindow)
@@ -1343,7 +1353,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp)
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD(Snap_ByIndex)
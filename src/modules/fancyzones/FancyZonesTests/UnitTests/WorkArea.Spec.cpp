@@ -47,7 +47,9 @@ namespace FancyZonesUnitTests
         TEST_METHOD_CLEANUP(CleanUp) noexcept
         {
             std::filesystem::remove(AppliedLayouts::AppliedLayoutsFileName());
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
             std::filesystem::remove(CustomLayouts::CustomLayoutsFileName());
             std::filesystem::remove(DefaultLayouts::DefaultLayoutsFileName());
         }
@@ -298,7 +300,9 @@ namespace FancyZonesUnitTests
 
         TEST_METHOD_CLEANUP(CleanUp) noexcept
         {
+            AppZoneHistory::instance().Flush();
             std::filesystem::remove(AppZoneHistory::AppZoneHistoryFileName());
+            std::filesystem::remove(AppZoneHistory::AppZoneHistoryJournalFileName());
         }
 
         TEST_METHOD (WhenWindowIsNotResizablePlacingItIntoTheZoneShouldNotResizeIt)
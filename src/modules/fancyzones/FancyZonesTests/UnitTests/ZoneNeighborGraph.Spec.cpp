@@ -0,0 +1,398 @@
+#include "pch.h"
+
+#include <chrono>
+#include <random>
+
+#include <FancyZonesLib/Layout.h>
+#include <FancyZonesLib/LayoutConfigurator.h>
+#include <FancyZonesLib/ZoneNeighborGraph.h>
+
+#include "Util.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    namespace
+    {
+        constexpr std::array<DWORD, 4> Arrows = { VK_LEFT, VK_RIGHT, VK_UP, VK_DOWN };
+
+        struct TestMonitor
+        {
+            HMONITOR monitor;
+            RECT rect;
+            ZonesMap zones;
+        };
+
+        struct Target
+        {
+            HMONITOR monitor{};
+            ZoneIndex zone = -1;
+
+            bool operator==(const Target& other) const = default;
+        };
+
+        RECT Offset(RECT rect, const RECT& origin)
+        {
+            rect.left += origin.left;
+            rect.right += origin.left;
+            rect.top += origin.top;
+            rect.bottom += origin.top;
+            return rect;
+        }
+
+        RECT CombinedRect(const std::vector<TestMonitor>& monitors)
+        {
+            std::vector<std::pair<HMONITOR, RECT>> rects;
+            for (const auto& monitor : monitors)
+            {
+                rects.emplace_back(monitor.monitor, monitor.rect);
+            }
+
+            return FancyZonesUtils::GetMonitorsCombinedRect<&MONITORINFOEX::rcWork>(rects);
+        }
+
+        ZoneNeighborGraph BuildGraph(const std::vector<TestMonitor>& monitors)
+        {
+            std::vector<ZoneNeighborGraph::WorkAreaInfo> workAreas;
+            std::vector<const ZonesMap*> zones;
+            for (const auto& monitor : monitors)
+            {
+                workAreas.push_back({ .monitor = monitor.monitor, .monitorRect = monitor.rect, .workAreaRect = monitor.rect, .layoutGeneration = 1 });
+                zones.push_back(&monitor.zones);
+            }
+
+            ZoneNeighborGraph graph;
+            graph.Build(workAreas, zones, CombinedRect(monitors));
+            return graph;
+        }
+
+        // The scan WindowKeyboardSnap::MoveByDirectionAndPosition runs for a window snapped to one zone
+        Target ScanSameWorkArea(const TestMonitor& monitor, ZoneIndex zone, DWORD vkCode, bool cycle)
+        {
+            RECT windowRect = monitor.zones.at(zone).GetZoneRect();
+            std::vector<RECT> zoneRects;
+            std::vector<ZoneIndex> freeZoneIndices;
+            for (const auto& [zoneId, item] : monitor.zones)
+            {
+                if (zoneId != zone)
+                {
+                    zoneRects.push_back(item.GetZoneRect());
+                    freeZoneIndices.push_back(zoneId);
+                }
+            }
+
+            size_t result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
+            if (result < zoneRects.size())
+            {
+                return { monitor.monitor, freeZoneIndices[result] };
+            }
+
+            if (cycle)
+            {
+                zoneRects.clear();
+                for (const auto& [zoneId, item] : monitor.zones)
+                {
+                    zoneRects.push_back(item.GetZoneRect());
+                }
+
+                windowRect = FancyZonesUtils::PrepareRectForCycling(windowRect, monitor.rect, vkCode);
+                result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
+                if (result < zoneRects.size())
+                {
+                    return { monitor.monitor, static_cast<ZoneIndex>(result) };
+                }
+            }
+
+            return {};
+        }
+
+        // The scan WindowKeyboardSnap::SnapBasedOnPositionOnAnotherMonitor runs for a window snapped to one zone
+        Target ScanOtherWorkArea(const std::vector<TestMonitor>& monitors, size_t current, ZoneIndex zone, DWORD vkCode)
+        {
+            RECT windowRect = Offset(monitors[current].zones.at(zone).GetZoneRect(), monitors[current].rect);
+            std::vector<RECT> zoneRects;
+            std::vector<Target> targets;
+            for (size_t i = 0; i < monitors.size(); ++i)
+            {
+                if (i != current)
+                {
+                    for (const auto& [zoneId, item] : monitors[i].zones)
+                    {
+                        zoneRects.push_back(Offset(item.GetZoneRect(), monitors[i].rect));
+                        targets.push_back({ monitors[i].monitor, zoneId });
+                    }
+                }
+            }
+
+            size_t result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
+            if (result < zoneRects.size())
+            {
+                return targets[result];
+            }
+
+            for (const auto& [zoneId, item] : monitors[current].zones)
+            {
+                zoneRects.push_back(Offset(item.GetZoneRect(), monitors[current].rect));
+                targets.push_back({ monitors[current].monitor, zoneId });
+            }
+
+            windowRect = FancyZonesUtils::PrepareRectForCycling(windowRect, CombinedRect(monitors), vkCode);
+            result = FancyZonesUtils::ChooseNextZoneByPosition(vkCode, windowRect, zoneRects);
+            return result < zoneRects.size() ? targets[result] : Target{};
+        }
+
+        Target Lookup(const ZoneNeighborGraph& graph, size_t node, DWORD vkCode, ZoneNeighborGraph::EdgeKind kind, ZoneNeighborGraph::EdgeKind fallback)
+        {
+            size_t target = graph.Neighbor(node, vkCode, kind);
+            if (target == ZoneNeighborGraph::NoNode)
+            {
+                target = graph.Neighbor(node, vkCode, fallback);
+            }
+
+            if (target == ZoneNeighborGraph::NoNode)
+            {
+                return {};
+            }
+
+            return { graph.GetNode(target).monitor, graph.GetNode(target).zone };
+        }
+
+        // Overlapping zones of random sizes, like a canvas layout
+        ZonesMap RandomCanvas(std::mt19937& random, int zoneCount, RECT workArea)
+        {
+            const LONG width = workArea.right - workArea.left;
+            const LONG height = workArea.bottom - workArea.top;
+
+            ZonesMap zones;
+            for (int i = 0; i < zoneCount; ++i)
+            {
+                const LONG left = static_cast<LONG>(random() % width);
+                const LONG top = static_cast<LONG>(random() % height);
+                const LONG right = min(width, left + 50 + static_cast<LONG>(random() % (width / 3)));
+                const LONG bottom = min(height, top + 50 + static_cast<LONG>(random() % (height / 3)));
+                zones.emplace(i, Zone(RECT{ left, top, right, bottom }, i));
+            }
+
+            return zones;
+        }
+
+        // A trading desk: rows of monitors side by side, every one with a dense grid layout
+        std::vector<TestMonitor> MonitorWall(int columns, int rows, int zoneCount)
+        {
+            std::vector<TestMonitor> monitors;
+            for (int row = 0; row < rows; ++row)
+            {
+                for (int column = 0; column < columns; ++column)
+                {
+                    const RECT rect{ column * 2560, row * 1440, (column + 1) * 2560, (row + 1) * 1440 };
+                    monitors.push_back({ Mocks::Monitor(), rect, LayoutConfigurator::Grid(RECT{ 0, 0, 2560, 1440 }, zoneCount, 4) });
+                }
+            }
+
+            return monitors;
+        }
+
+        void AssertMatchesScan(const std::vector<TestMonitor>& monitors)
+        {
+            const auto graph = BuildGraph(monitors);
+            for (size_t i = 0; i < monitors.size(); ++i)
+            {
+                for (const auto& [zoneId, zone] : monitors[i].zones)
+                {
+                    const size_t node = graph.Find(monitors[i].monitor, zoneId);
+                    Assert::AreNotEqual(ZoneNeighborGraph::NoNode, node);
+
+                    for (DWORD vkCode : Arrows)
+                    {
+                        Assert::IsTrue(ScanSameWorkArea(monitors[i], zoneId, vkCode, true) ==
+                                       Lookup(graph, node, vkCode, ZoneNeighborGraph::EdgeKind::SameWorkArea, ZoneNeighborGraph::EdgeKind::SameWorkAreaCycle));
+                        Assert::IsTrue(ScanSameWorkArea(monitors[i], zoneId, vkCode, false) ==
+                                       Lookup(graph, node, vkCode, ZoneNeighborGraph::EdgeKind::SameWorkArea, ZoneNeighborGraph::EdgeKind::SameWorkArea));
+                        Assert::IsTrue(ScanOtherWorkArea(monitors, i, zoneId, vkCode) ==
+                                       Lookup(graph, node, vkCode, ZoneNeighborGraph::EdgeKind::OtherWorkArea, ZoneNeighborGraph::EdgeKind::AnyWorkAreaCycle));
+                    }
+                }
+            }
+        }
+    }
+
+    TEST_CLASS (ZoneNeighborGraphUnitTests)
+    {
+    public:
+        TEST_METHOD (EmptyGraph)
+        {
+            ZoneNeighborGraph graph;
+            Assert::AreEqual(ZoneNeighborGraph::NoNode, graph.Find(Mocks::Monitor(), 0));
+            Assert::AreEqual(ZoneNeighborGraph::NoNode, graph.Neighbor(0, VK_LEFT, ZoneNeighborGraph::EdgeKind::SameWorkArea));
+            Assert::IsFalse(graph.IsBuiltFor({}, RECT{}));
+        }
+
+        TEST_METHOD (GridNeighbors)
+        {
+            // 2x2 grid: 0 1 / 2 3
+            const std::vector<TestMonitor> monitors = { { Mocks::Monitor(), RECT{ 0, 0, 1920, 1080 }, LayoutConfigurator::Grid(RECT{ 0, 0, 1920, 1080 }, 4, 0) } };
+            const auto graph = BuildGraph(monitors);
+
+            const size_t node = graph.Find(monitors[0].monitor, 0);
+            Assert::AreEqual(ZoneIndex{ 1 }, graph.GetNode(graph.Neighbor(node, VK_RIGHT, ZoneNeighborGraph::EdgeKind::SameWorkArea)).zone);
+            Assert::AreEqual(ZoneIndex{ 2 }, graph.GetNode(graph.Neighbor(node, VK_DOWN, ZoneNeighborGraph::EdgeKind::SameWorkArea)).zone);
+            Assert::AreEqual(ZoneNeighborGraph::NoNode, graph.Neighbor(node, VK_LEFT, ZoneNeighborGraph::EdgeKind::SameWorkArea));
+            Assert::AreEqual(ZoneIndex{ 1 }, graph.GetNode(graph.Neighbor(node, VK_LEFT, ZoneNeighborGraph::EdgeKind::SameWorkAreaCycle)).zone);
+            Assert::AreEqual(ZoneNeighborGraph::NoNode, graph.Neighbor(node, VK_HOME, ZoneNeighborGraph::EdgeKind::SameWorkArea));
+        }
+
+        TEST_METHOD (CrossMonitorNeighbors)
+        {
+            const auto monitors = MonitorWall(2, 1, 4);
+            const auto graph = BuildGraph(monitors);
+
+            // Right from the top right zone of the left monitor enters the top left zone of the right monitor
+            const size_t node = graph.Find(monitors[0].monitor, 1);
+            const auto& target = graph.GetNode(graph.Neighbor(node, VK_RIGHT, ZoneNeighborGraph::EdgeKind::OtherWorkArea));
+            Assert::IsTrue(monitors[1].monitor == target.monitor);
+            Assert::AreEqual(ZoneIndex{ 0 }, target.zone);
+        }
+
+        TEST_METHOD (IsBuiltFor)
+        {
+            const auto monitors = MonitorWall(2, 1, 4);
+            std::vector<ZoneNeighborGraph::WorkAreaInfo> workAreas;
+            std::vector<const ZonesMap*> zones;
+            for (const auto& monitor : monitors)
+            {
+                workAreas.push_back({ .monitor = monitor.monitor, .monitorRect = monitor.rect, .workAreaRect = monitor.rect, .layoutGeneration = 7 });
+                zones.push_back(&monitor.zones);
+            }
+
+            ZoneNeighborGraph graph;
+            graph.Build(workAreas, zones, CombinedRect(monitors));
+            Assert::IsTrue(graph.IsBuiltFor(workAreas, CombinedRect(monitors)));
+
+            workAreas[1].layoutGeneration = 8;
+            Assert::IsFalse(graph.IsBuiltFor(workAreas, CombinedRect(monitors)));
+        }
+
+        TEST_METHOD (LayoutGenerationChangesOnInit)
+        {
+            LayoutData data{
+                .uuid = FancyZonesUtils::GuidFromString(L"{F762BAD6-DAA1-4997-9497-E11DFEB72F21}").value(),
+                .type = FancyZonesDataTypes::ZoneSetLayoutType::Grid,
+                .showSpacing = false,
+                .spacing = 0,
+                .zoneCount = 4,
+                .sensitivityRadius = 20
+            };
+
+            Layout first(data);
+            Layout second(data);
+            Assert::IsTrue(first.Init(RECT{ 0, 0, 1920, 1080 }, Mocks::Monitor()));
+            Assert::IsTrue(second.Init(RECT{ 0, 0, 1920, 1080 }, Mocks::Monitor()));
+            Assert::AreNotEqual(first.Generation(), second.Generation());
+
+            const auto generation = first.Generation();
+            Assert::IsTrue(first.Init(RECT{ 0, 0, 1920, 1080 }, Mocks::Monitor()));
+            Assert::AreNotEqual(generation, first.Generation());
+        }
+
+        TEST_METHOD (MonitorWallMatchesScan)
+        {
+            AssertMatchesScan(MonitorWall(3, 2, 12));
+        }
+
+        TEST_METHOD (CanvasMatchesScan)
+        {
+            std::mt19937 random(13);
+            for (int iteration = 0; iteration < 20; ++iteration)
+            {
+                std::vector<TestMonitor> monitors = {
+                    { Mocks::Monitor(), RECT{ 0, 0, 1920, 1080 }, RandomCanvas(random, 1 + static_cast<int>(random() % 12), RECT{ 0, 0, 1920, 1080 }) },
+                    { Mocks::Monitor(), RECT{ 1920, 0, 3840, 1080 }, RandomCanvas(random, 1 + static_cast<int>(random() % 12), RECT{ 0, 0, 1920, 1080 }) },
+                    { Mocks::Monitor(), RECT{ 0, -1080, 1920, 0 }, RandomCanvas(random, 1 + static_cast<int>(random() % 12), RECT{ 0, 0, 1920, 1080 }) },
+                };
+
+                AssertMatchesScan(monitors);
+            }
+        }
+    };
+
+    TEST_CLASS (ZoneNeighborGraphBenchmarks)
+    {
+        void Measure(int columns, int rows, int zoneCount)
+        {
+            const auto monitors = MonitorWall(columns, rows, zoneCount);
+
+            auto start = std::chrono::steady_clock::now();
+            const auto graph = BuildGraph(monitors);
+            const std::chrono::duration<double, std::milli> buildElapsed = std::chrono::steady_clock::now() - start;
+
+            // Every arrow from every zone, the way a keypress resolves the target on a multi-monitor setup
+            size_t presses = 0;
+            size_t scanChecksum = 0;
+            start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < monitors.size(); ++i)
+            {
+                for (const auto& [zoneId, zone] : monitors[i].zones)
+                {
+                    for (DWORD vkCode : Arrows)
+                    {
+                        Target target = ScanSameWorkArea(monitors[i], zoneId, vkCode, false);
+                        if (target.zone == -1)
+                        {
+                            target = ScanOtherWorkArea(monitors, i, zoneId, vkCode);
+                        }
+
+                        scanChecksum += static_cast<size_t>(target.zone);
+                        ++presses;
+                    }
+                }
+            }
+            const std::chrono::duration<double, std::micro> scanElapsed = std::chrono::steady_clock::now() - start;
+
+            size_t graphChecksum = 0;
+            start = std::chrono::steady_clock::now();
+            for (const auto& monitor : monitors)
+            {
+                for (const auto& [zoneId, zone] : monitor.zones)
+                {
+                    const size_t node = graph.Find(monitor.monitor, zoneId);
+                    for (DWORD vkCode : Arrows)
+                    {
+                        size_t target = graph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::SameWorkArea);
+                        if (target == ZoneNeighborGraph::NoNode)
+                        {
+                            target = graph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::OtherWorkArea);
+                        }
+
+                        if (target == ZoneNeighborGraph::NoNode)
+                        {
+                            target = graph.Neighbor(node, vkCode, ZoneNeighborGraph::EdgeKind::AnyWorkAreaCycle);
+                        }
+
+                        graphChecksum += static_cast<size_t>(target == ZoneNeighborGraph::NoNode ? ZoneIndex{ -1 } : graph.GetNode(target).zone);
+                    }
+                }
+            }
+            const std::chrono::duration<double, std::micro> graphElapsed = std::chrono::steady_clock::now() - start;
+
+            Assert::AreEqual(scanChecksum, graphChecksum);
+
+            Logger::WriteMessage((std::to_wstring(monitors.size()) + L" monitors x " + std::to_wstring(zoneCount) + L" zones: build " +
+                                  std::to_wstring(buildElapsed.count()) + L" ms, scan " + std::to_wstring(scanElapsed.count() / presses) +
+                                  L" us/keypress, graph " + std::to_wstring(graphElapsed.count() / presses) + L" us/keypress\n")
+                                     .c_str());
+        }
+
+    public:
+        BEGIN_TEST_METHOD_ATTRIBUTE(TradingDeskKeyboardSnap)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (TradingDeskKeyboardSnap)
+        {
+            Measure(2, 1, 16);
+            Measure(3, 2, 16);
+            Measure(3, 2, 64);
+            Measure(4, 2, 128);
+        }
+    };
+}
@@ -0,0 +1,236 @@
+#include "pch.h"
+
+#include <chrono>
+#include <random>
+
+#include <FancyZonesLib/LayoutConfigurator.h>
+#include <FancyZonesLib/ZoneSpatialIndex.h>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace FancyZonesUnitTests
+{
+    namespace
+    {
+        // The scan Layout::ZonesFromPoint ran on every mouse move before the spatial index
+        ZoneSpatialIndex::QueryResult FullScan(const ZonesMap& zones, int sensitivityRadius, POINT pt)
+        {
+            ZoneSpatialIndex::QueryResult result;
+            for (const auto& [zoneId, zone] : zones)
+            {
+                const RECT zoneRect = zone.GetZoneRect();
+                if (zoneRect.left - sensitivityRadius <= pt.x && pt.x <= zoneRect.right + sensitivityRadius &&
+                    zoneRect.top - sensitivityRadius <= pt.y && pt.y <= zoneRect.bottom + sensitivityRadius)
+                {
+                    result.capturedZones.push_back(zoneId);
+                }
+
+                if (zoneRect.left <= pt.x && pt.x < zoneRect.right &&
+                    zoneRect.top <= pt.y && pt.y < zoneRect.bottom)
+                {
+                    result.strictlyCaptured = true;
+                }
+            }
+
+            for (size_t i = 0; i < result.capturedZones.size() && !result.overlap; ++i)
+            {
+                for (size_t j = i + 1; j < result.capturedZones.size(); ++j)
+                {
+                    const RECT rectI = zones.at(result.capturedZones[i]).GetZoneRect();
+                    const RECT rectJ = zones.at(result.capturedZones[j]).GetZoneRect();
+                    if (max(rectI.top, rectJ.top) + sensitivityRadius < min(rectI.bottom, rectJ.bottom) &&
+                        max(rectI.left, rectJ.left) + sensitivityRadius < min(rectI.right, rectJ.right))
+                    {
+                        result.overlap = true;
+                        break;
+                    }
+                }
+            }
+
+            return result;
+        }
+
+        // Overlapping zones of random sizes, like a dense canvas layout
+        ZonesMap RandomCanvas(std::mt19937& random, int zoneCount, RECT workArea)
+        {
+            const LONG width = workArea.right - workArea.left;
+            const LONG height = workArea.bottom - workArea.top;
+
+            ZonesMap zones;
+            for (int i = 0; i < zoneCount; ++i)
+            {
+                const LONG left = workArea.left + static_cast<LONG>(random() % width);
+                const LONG top = workArea.top + static_cast<LONG>(random() % height);
+                const LONG right = min(workArea.right, left + 50 + static_cast<LONG>(random() % (width / 4)));
+                const LONG bottom = min(workArea.bottom, top + 50 + static_cast<LONG>(random() % (height / 4)));
+                zones.emplace(i, Zone(RECT{ left, top, right, bottom }, i));
+            }
+            return zones;
+        }
+
+        // Horizontal sweeps, diagonals and a random walk across the work area
+        std::vector<POINT> MousePaths(std::mt19937& random, RECT workArea, size_t step)
+        {
+            std::vector<POINT> points;
+            for (LONG y = workArea.top; y < workArea.bottom; y += static_cast<LONG>(step) * 16)
+            {
+                for (LONG x = workArea.left; x < workArea.right; x += static_cast<LONG>(step))
+                {
+                    points.push_back(POINT{ x, y });
+                }
+            }
+
+            const LONG width = workArea.right - workArea.left;
+            const LONG height = workArea.bottom - workArea.top;
+            for (LONG i = 0; i < width; i += static_cast<LONG>(step))
+            {
+                points.push_back(POINT{ workArea.left + i, workArea.top + i * height / width });
+                points.push_back(POINT{ workArea.right - i, workArea.top + i * height / width });
+            }
+
+            POINT pt{ workArea.left + width / 2, workArea.top + height / 2 };
+            for (size_t i = 0; i < points.size() / 2; ++i)
+            {
+                pt.x = std::clamp<LONG>(pt.x + static_cast<LONG>(random() % 41) - 20, workArea.left - 30, workArea.right + 30);
+                pt.y = std::clamp<LONG>(pt.y + static_cast<LONG>(random() % 41) - 20, workArea.top - 30, workArea.bottom + 30);
+                points.push_back(pt);
+            }
+
+            return points;
+        }
+
+        void AssertSameResult(const ZoneSpatialIndex::QueryResult& expected, const ZoneSpatialIndex::QueryResult& actual)
+        {
+            Assert::IsTrue(expected.capturedZones == actual.capturedZones);
+            Assert::AreEqual(expected.strictlyCaptured, actual.strictlyCaptured);
+            Assert::AreEqual(expected.overlap, actual.overlap);
+        }
+    }
+
+    TEST_CLASS (ZoneSpatialIndexUnitTests)
+    {
+        const RECT m_workArea{ 0, 0, 7680, 4320 };
+
+    public:
+        TEST_METHOD (EmptyLayout)
+        {
+            ZoneSpatialIndex index;
+            index.Build({}, 20);
+
+            auto result = index.Query(POINT{ 0, 0 });
+            Assert::IsTrue(result.capturedZones.empty());
+            Assert::IsFalse(result.strictlyCaptured);
+        }
+
+        TEST_METHOD (PointOutsideAllZones)
+        {
+            ZonesMap zones;
+            zones.emplace(0, Zone(RECT{ 100, 100, 200, 200 }, 0));
+
+            ZoneSpatialIndex index;
+            index.Build(zones, 20);
+
+            Assert::IsTrue(index.Query(POINT{ 79, 150 }).capturedZones.empty());
+            Assert::IsTrue(index.Query(POINT{ 150, 221 }).capturedZones.empty());
+            Assert::AreEqual(size_t{ 1 }, index.Query(POINT{ 80, 150 }).capturedZones.size());
+        }
+
+        TEST_METHOD (GridMatchesFullScan)
+        {
+            std::mt19937 random(7);
+            const auto zones = LayoutConfigurator::Grid(m_workArea, 128, 8);
+
+            ZoneSpatialIndex index;
+            index.Build(zones, 20);
+            for (const auto& pt : MousePaths(random, m_workArea, 37))
+            {
+                AssertSameResult(FullScan(zones, 20, pt), index.Query(pt));
+            }
+        }
+
+        TEST_METHOD (CanvasMatchesFullScan)
+        {
+            std::mt19937 random(11);
+            for (int sensitivityRadius : { -10, 0, 20, 75 })
+            {
+                for (int zoneCount : { 1, 5, 60, 128 })
+                {
+                    const auto zones = RandomCanvas(random, zoneCount, m_workArea);
+
+                    ZoneSpatialIndex index;
+                    index.Build(zones, sensitivityRadius);
+                    for (const auto& pt : MousePaths(random, m_workArea, 97))
+                    {
+                        AssertSameResult(FullScan(zones, sensitivityRadius, pt), index.Query(pt));
+                    }
+                }
+            }
+        }
+    };
+
+    TEST_CLASS (ZoneSpatialIndexBenchmarks)
+    {
+        const RECT m_workArea{ 0, 0, 7680, 4320 };
+
+        void Measure(const wchar_t* label, const ZonesMap& zones, const std::vector<POINT>& path)
+        {
+            constexpr int sensitivityRadius = 20;
+
+            ZoneSpatialIndex index;
+            auto start = std::chrono::steady_clock::now();
+            index.Build(zones, sensitivityRadius);
+            const std::chrono::duration<double, std::micro> buildElapsed = std::chrono::steady_clock::now() - start;
+
+            size_t scanCaptured = 0;
+            start = std::chrono::steady_clock::now();
+            for (const auto& pt : path)
+            {
+                scanCaptured += FullScan(zones, sensitivityRadius, pt).capturedZones.size();
+            }
+            const std::chrono::duration<double, std::micro> scanElapsed = std::chrono::steady_clock::now() - start;
+
+            size_t indexCaptured = 0;
+            start = std::chrono::steady_clock::now();
+            for (const auto& pt : path)
+            {
+                indexCaptured += index.Query(pt).capturedZones.size();
+            }
+            const std::chrono::duration<double, std::micro> indexElapsed = std::chrono::steady_clock::now() - start;
+
+            Assert::AreEqual(scanCaptured, indexCaptured);
+
+            Logger::WriteMessage((std::wstring(label) + L": " + std::to_wstring(zones.size()) + L" zones, " + std::to_wstring(path.size()) +
+                                  L" points, build " + std::to_wstring(buildElapsed.count()) + L" us (" + std::to_wstring(index.CellCount()) +
+                                  L" cells), full scan " + std::to_wstring(scanElapsed.count() / path.size()) + L" us/point, index " +
+                                  std::to_wstring(indexElapsed.count() / path.size()) + L" us/point\n")
+                                     .c_str());
+        }
+
+    public:
+        BEGIN_TEST_METHOD_ATTRIBUTE(DenseGridDrag)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (DenseGridDrag)
+        {
+            std::mt19937 random(3);
+            const auto path = MousePaths(random, m_workArea, 3);
+            for (int zoneCount : { 16, 64, 128 })
+            {
+                Measure(L"grid", LayoutConfigurator::Grid(m_workArea, zoneCount, 8), path);
+            }
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(DenseCanvasDrag)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (DenseCanvasDrag)
+        {
+            std::mt19937 random(5);
+            const auto path = MousePaths(random, m_workArea, 3);
+            for (int zoneCount : { 16, 64, 128 })
+            {
+                Measure(L"canvas", RandomCanvas(random, zoneCount, m_workArea), path);
+            }
+        }
+    };
+}
@@ -310,24 +310,42 @@ namespace KeyboardEventHandlers
     // Function to handle a shortcut remap
     intptr_t HandleShortcutRemapEvent(KeyboardManagerInput::InputInterface& ii, LowlevelKeyboardEvent* data, State& state, const std::optional<std::wstring>& activatedApp) noexcept
     {
+        // Get the lookup structure of the shortcut table for given activatedApp
+        ShortcutRemapIndex& index = state.GetShortcutRemapIndex(activatedApp);
+        if (index.IsEmpty())
+        {
+            return 0;
+        }
+
         auto resetChordsResults = ResetChordsIfNeeded(data, state, activatedApp);
 
         // Check if any shortcut is currently in the invoked state
-        bool isShortcutInvoked = state.CheckShortcutRemapInvoked(activatedApp);
+        bool isShortcutInvoked = index.AnyInvoked();
 
-        // Get shortcut table for given activatedApp
-        ShortcutRemapTable& reMap = state.GetShortcutRemapTable(activatedApp);
+        static bool isAltRightKeyInvoked = false;
 
-        // Iterate through the shortcut remaps and apply whichever has been pressed
-        for (auto& itShortcut : state.GetSortedShortcutRemapVector(activatedApp))
+        // Check if the right Alt key (AltGr) is pressed.
+        if (data->lParam->vkCode == VK_RMENU && ii.GetVirtualKeyState(VK_LCONTROL) && (data->wParam == WM_KEYDOWN || data->wParam == WM_SYSKEYDOWN))
+        {
+            isAltRightKeyInvoked = true;
+        }
+        else if (data->lParam->vkCode == VK_RMENU && (data->wParam == WM_KEYUP || data->wParam == WM_SYSKEYUP))
         {
-            const auto it = reMap.find(itShortcut);
+            isAltRightKeyInvoked = false;
+        }
 
-            // If a shortcut is currently in the invoked state then skip till the shortcut that is currently invoked
-            if (isShortcutInvoked && !it->second.isShortcutInvoked)
-            {
-                continue;
-            }
+        // Only the remaps which can react to the key are visited, in the order of the sorted shortcut vector. If a shortcut is currently in the invoked state then only the invoked shortcuts are visited.
+        // The modifier state is only read if a remap has the key as action key
+        const DWORD vkCode = data->lParam->vkCode;
+        const uint8_t pressedModifiers = !isShortcutInvoked && index.HasActionKey(vkCode) ? ShortcutRemapIndex::GetPressedModifiers(ii) : 0;
+        std::vector<size_t> candidates;
+        index.GetCandidates(vkCode, pressedModifiers, isShortcutInvoked, candidates);
+
+        // Iterate through the shortcut remaps and apply whichever has been pressed
+        for (const size_t position : candidates)
+        {
+            Shortcut& itShortcut = *index.GetEntry(position).shortcut;
+            const auto it = index.GetEntry(position).remap;
 
             // Check if the remap is to a key or a shortcut
             const bool remapToKey = it->second.targetShortcut.index() == 0;
@@ -341,25 +359,13 @@ namespace KeyboardEventHandlers
             bool isMatchOnChordEnd = false;
             bool isMatchOnChordStart = false;
 
-            static bool isAltRightKeyInvoked = false;
-
-            // Check if the right Alt key (AltGr) is pressed.
-            if (data->lParam->vkCode == VK_RMENU && ii.GetVirtualKeyState(VK_LCONTROL) && (data->wParam == WM_KEYDOWN || data->wParam == WM_SYSKEYDOWN))
-            {
-                isAltRightKeyInvoked = true;
-            }
-            else if (data->lParam->vkCode == VK_RMENU && (data->wParam == WM_KEYUP || data->wParam == WM_SYSKEYUP))
-            {
-                isAltRightKeyInvoked = false;
-            }
-
             // If the shortcut has been pressed down
-            if (!it->second.isShortcutInvoked && it->first.CheckModifiersKeyboardState(ii))
+            if (!it->second.isShortcutInvoked && CheckModifiersKeyboardState(ii, it->first, state))
             {
                 // if not a mod key, check for chord stuff
                 if (!resetChordsResults.CurrentKeyIsModifierKey && (data->wParam == WM_KEYDOWN || data->wParam == WM_SYSKEYDOWN))
                 {
-                    if (it->first.exactMatch == true && !it->first.IsKeyboardStateClearExceptShortcut(ii))
+                    if (it->first.exactMatch == true && !IsKeyboardStateClearExceptShortcut(ii, it->first, state))
                     {
                         continue;
                     }
@@ -372,7 +378,7 @@ namespace KeyboardEventHandlers
                             // Logger::trace(L"ChordKeyboardHandler:new chord started for {}", data->lParam->vkCode);
                             isMatchOnChordStart = true;
                             ResetAllOtherStartedChords(state, activatedApp, data->lParam->vkCode);
-                            itShortcut.SetChordStarted(true);
+                            index.StartChord(position);
                             continue;
                         }
 
@@ -406,7 +412,7 @@ namespace KeyboardEventHandlers
                     resetChordsResults.AnyChordStarted = false;
 
                     // Check if any other keys have been pressed apart from the shortcut. If true, then check for the next shortcut. This is to be done only for shortcut to shortcut remaps
-                    if (!it->first.IsKeyboardStateClearExceptShortcut(ii) && (remapToShortcut || (remapToKey && std::get<DWORD>(it->second.targetShortcut) == CommonSharedConstants::VK_DISABLED)))
+                    if (!IsKeyboardStateClearExceptShortcut(ii, it->first, state) && (remapToShortcut || (remapToKey && std::get<DWORD>(it->second.targetShortcut) == CommonSharedConstants::VK_DISABLED)))
                     {
                         continue;
                     }
@@ -594,6 +600,7 @@ namespace KeyboardEventHandlers
                     }
 
                     it->second.isShortcutInvoked = true;
+                    index.SetInvoked(position);
                     // If app specific shortcut is invoked, store the target application
                     if (activatedApp)
                     {
@@ -752,7 +759,7 @@ namespace KeyboardEventHandlers
                 }
 
                 // The system will see the modifiers of the new shortcut as being held down because of the shortcut remap
-                if (!remapToShortcut || (remapToShortcut && std::get<Shortcut>(it->second.targetShortcut).CheckModifiersKeyboardState(ii)))
+                if (!remapToShortcut || (remapToShortcut && CheckModifiersKeyboardState(ii, std::get<Shortcut>(it->second.targetShortcut), state)))
                 {
                     // Case 2: If the original shortcut is still held down the keyboard will get a key down message of the action key in the original shortcut and the new shortcut's modifiers will be held down (keys held down send repeated keydown messages)
                     if (((data->lParam->vkCode == it->first.GetActionKey() && !it->first.HasChord()) || (data->lParam->vkCode == it->first.GetSecondKey() && it->first.HasChord())) && (data->wParam == WM_KEYDOWN || data->wParam == WM_SYSKEYDOWN))
@@ -831,7 +838,7 @@ namespace KeyboardEventHandlers
                         else
                         {
                             // Check if the keyboard state is clear apart from the target remap key (by creating a temp Shortcut object with the target key)
-                            bool isKeyboardStateClear = Shortcut(std::vector<int32_t>({ Helpers::FilterArtificialKeys(std::get<DWORD>(it->second.targetShortcut)) })).IsKeyboardStateClearExceptShortcut(ii);
+                            bool isKeyboardStateClear = IsKeyboardStateClearExceptShortcut(ii, Shortcut(std::vector<int32_t>({ Helpers::FilterArtificialKeys(std::get<DWORD>(it->second.targetShortcut)) })), state);
 
                             // If the keyboard state is clear, we release the target key but do not reset the remap state
                             if (isKeyboardStateClear)
@@ -916,9 +923,10 @@ namespace KeyboardEventHandlers
                             // Check if a new remapping should be applied
                             Shortcut currentlyPressed = it->first;
                             currentlyPressed.actionKey = data->lParam->vkCode;
-                            auto newRemappingIter = reMap.find(currentlyPressed);
-                            if (newRemappingIter != reMap.end() && !newRemappingIter->first.HasChord())
+                            const auto newRemappingPosition = index.Find(currentlyPressed);
+                            if (newRemappingPosition && !index.GetEntry(*newRemappingPosition).remap->first.HasChord())
                             {
+                                const auto newRemappingIter = index.GetEntry(*newRemappingPosition).remap;
                                 auto& newRemapping = newRemappingIter->second;
                                 Shortcut from = std::get<Shortcut>(it->second.targetShortcut);
                                 if (newRemapping.RemapToKey())
@@ -953,6 +961,7 @@ namespace KeyboardEventHandlers
                                     }
                                     Helpers::SetKeyEvent(keyEventList, INPUT_KEYBOARD, static_cast<WORD>(to.actionKey), 0, KeyboardManagerConstants::KEYBOARDMANAGER_SHORTCUT_FLAG);
                                     newRemapping.isShortcutInvoked = true;
+                                    index.SetInvoked(*newRemappingPosition);
                                 }
                             }
                             else
@@ -1127,13 +1136,7 @@ namespace KeyboardEventHandlers
 
     void ResetAllOtherStartedChords(State& state, const std::optional<std::wstring>& activatedApp, DWORD keyToKeep)
     {
-        for (auto& itShortcut_2 : state.GetSortedShortcutRemapVector(activatedApp))
-        {
-            if (keyToKeep == NULL || itShortcut_2.actionKey != keyToKeep)
-            {
-                itShortcut_2.SetChordStarted(false);
-            }
-        }
+        state.GetShortcutRemapIndex(activatedApp).ResetStartedChords(keyToKeep);
     }
 
     void ResetAllStartedChords(State& state, const std::optional<std::wstring>& activatedApp)
@@ -1170,27 +1173,65 @@ namespace KeyboardEventHandlers
         {
             //Logger::trace(L"ChordKeyboardHandler:reset");
 
-            for (auto& itShortcut : state.GetSortedShortcutRemapVector(activatedApp))
-            {
-                itShortcut.SetChordStarted(false);
-            }
+            state.GetShortcutRemapIndex(activatedApp).ResetStartedChords(NULL);
             result.CurrentKeyIsModifierKey = true;
         }
         else
         {
-            for (auto& itShortcut : state.GetSortedShortcutRemapVector(activatedApp))
-            {
-                if (itShortcut.IsChordStarted())
-                {
-                    result.AnyChordStarted = true;
-                    break;
-                }
-            }
+            result.AnyChordStarted = state.GetShortcutRemapIndex(activatedApp).AnyChordStarted();
         }
 
         return result;
     }
 
+    // Function to check if all the modifiers in the shortcut have been pressed down, using the key state snapshot if it is enabled
+    bool CheckModifiersKeyboardState(KeyboardManagerInput::InputInterface& ii, const Shortcut& shortcut, State& state)
+    {
+        KeyboardStateSnapshot* snapshot = state.GetKeyboardStateSnapshot();
+        if (snapshot == nullptr)
+        {
+            return shortcut.CheckModifiersKeyboardState(ii);
+        }
+
+        // Most checks fail on the snapshot alone. A modifier can still be down in the snapshot after its key up was missed, so a match is confirmed with the key state before it is acted on
+        if (!shortcut.CheckModifiersKeyboardState(*snapshot))
+        {
+            return false;
+        }
+
+        if (!shortcut.CheckModifiersKeyboardState(ii))
+        {
+            snapshot->ResyncModifiers(ii);
+            return false;
+        }
+
+        return true;
+    }
+
+    // Function to check if any keys are pressed down except those in the shortcut, using the key state snapshot if it is enabled
+    bool IsKeyboardStateClearExceptShortcut(KeyboardManagerInput::InputInterface& ii, const Shortcut& shortcut, State& state)
+    {
+        KeyboardStateSnapshot* snapshot = state.GetKeyboardStateSnapshot();
+        if (snapshot == nullptr)
+        {
+            return shortcut.IsKeyboardStateClearExceptShortcut(ii);
+        }
+
+        if (shortcut.IsKeyboardStateClearExceptShortcut(*snapshot))
+        {
+            return true;
+        }
+
+        // Confirm with the key state, since a key can still be down in the snapshot after its key up was missed
+        if (shortcut.IsKeyboardStateClearExceptShortcut(ii))
+        {
+            snapshot->Resync(ii);
+            return true;
+        }
+
+        return false;
+    }
+
     struct handle_data
     {
         unsigned long process_id;
@@ -41,6 +41,12 @@ namespace KeyboardEventHandlers
     // Function to reset chord matching if needed
     ResetChordsResults ResetChordsIfNeeded(LowlevelKeyboardEvent* data, State& state, const std::optional<std::wstring>& activatedApp);
 
+    // Function to check if all the modifiers in the shortcut have been pressed down, using the key state snapshot if it is enabled
+    bool CheckModifiersKeyboardState(KeyboardManagerInput::InputInterface& ii, const Shortcut& shortcut, State& state);
+
+    // Function to check if any keys are pressed down except those in the shortcut, using the key state snapshot if it is enabled
+    bool IsKeyboardStateClearExceptShortcut(KeyboardManagerInput::InputInterface& ii, const Shortcut& shortcut, State& state);
+
     // Function to handle (start or show) programs for shortcuts
     void CreateOrShowProcessForShortcut(Shortcut shortcut) noexcept;
 
@@ -112,7 +112,12 @@ LRESULT CALLBACK KeyboardManager::HookProc(int nCode, const WPARAM wParam, const
         event.wParam = wParam;
         event.lParam->vkCode = Helpers::EncodeKeyNumpadOrigin(event.lParam->vkCode, event.lParam->flags & LLKHF_EXTENDED);
 
-        if (keyboardManagerObjectPtr->HandleKeyboardHookEvent(&event) == 1)
+        const intptr_t result = keyboardManagerObjectPtr->HandleKeyboardHookEvent(&event);
+
+        // Keep the key state snapshot in line with the events which reach the system
+        keyboardManagerObjectPtr->state.UpdateKeyboardStateSnapshot(keyboardManagerObjectPtr->inputHandler, &event, result);
+
+        if (result == 1)
         {
             // Reset Num Lock whenever a NumLock key down event is suppressed since Num Lock key state change occurs before it is intercepted by low level hooks
             if (event.lParam->vkCode == VK_NUMLOCK && (event.wParam == WM_KEYDOWN || event.wParam == WM_SYSKEYDOWN) && event.lParam->dwExtraInfo != KeyboardManagerConstants::KEYBOARDMANAGER_SUPPRESS_FLAG)
@@ -137,6 +142,9 @@ void KeyboardManager::StartLowlevelKeyboardHook()
 
     if (!hookHandle)
     {
+        // Keys which are already held down are only known from the key state
+        state.StartKeyboardStateTracking(inputHandler);
+
         hookHandle = SetWindowsHookEx(WH_KEYBOARD_LL, HookProc, GetModuleHandle(NULL), NULL);
         hookHandleCopy = hookHandle;
         if (!hookHandle)
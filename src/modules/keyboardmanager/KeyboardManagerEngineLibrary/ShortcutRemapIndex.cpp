@@ -0,0 +1,226 @@
+#include "pch.h"
+#include "ShortcutRemapIndex.h"
+
+#include <keyboardmanager/common/InputInterface.h>
+
+// Function to compile the index. The vector and the table must not change until the next build, which the revision is used to detect
+void ShortcutRemapIndex::Build(std::vector<Shortcut>& sortedShortcuts, ShortcutRemapTable& table, uint64_t revision)
+{
+    entries.clear();
+    byKey.clear();
+    modifierMasks.fill(0);
+    otherModifierMasks = 0;
+    invoked.clear();
+    chordsStarted.clear();
+
+    entries.reserve(sortedShortcuts.size());
+    for (auto& shortcut : sortedShortcuts)
+    {
+        const auto it = table.find(shortcut);
+        if (it == table.end())
+        {
+            continue;
+        }
+
+        const size_t position = entries.size();
+        entries.push_back({ &shortcut, it });
+
+        const DWORD actionKey = shortcut.GetActionKey();
+        const uint8_t modifierMask = GetModifierMask(shortcut);
+        byKey[GetKey(actionKey, modifierMask)].push_back(position);
+        (actionKey < KeyCount ? modifierMasks[actionKey] : otherModifierMasks) |= static_cast<uint16_t>(1 << modifierMask);
+
+        // Keep the state of remaps which were already in use
+        if (it->second.isShortcutInvoked)
+        {
+            invoked.push_back(position);
+        }
+        if (shortcut.IsChordStarted())
+        {
+            chordsStarted.push_back(position);
+        }
+    }
+
+    builtRevision = revision;
+}
+
+// Function to check if the index was built from the given configuration revision
+bool ShortcutRemapIndex::IsBuiltFrom(uint64_t revision) const
+{
+    return builtRevision == revision;
+}
+
+bool ShortcutRemapIndex::IsEmpty() const
+{
+    return entries.empty();
+}
+
+const ShortcutRemapIndex::Entry& ShortcutRemapIndex::GetEntry(size_t position) const
+{
+    return entries[position];
+}
+
+// Function to get the position of the remap of a source shortcut. Returns nullopt if it isn't remapped
+std::optional<size_t> ShortcutRemapIndex::Find(const Shortcut& shortcut) const
+{
+    const auto positions = byKey.find(GetKey(shortcut.GetActionKey(), GetModifierMask(shortcut)));
+    if (positions == byKey.end())
+    {
+        return std::nullopt;
+    }
+
+    for (const size_t position : positions->second)
+    {
+        if (*entries[position].shortcut == shortcut)
+        {
+            return position;
+        }
+    }
+
+    return std::nullopt;
+}
+
+// Function to check if any remap has vkCode as action key
+bool ShortcutRemapIndex::HasActionKey(DWORD vkCode) const
+{
+    return GetModifierMasks(vkCode) != 0;
+}
+
+// Function to get the modifier families of which a key is down. Either side counts, so that a
+// remap which is not in the result can't pass Shortcut::CheckModifiersKeyboardState either
+uint8_t ShortcutRemapIndex::GetPressedModifiers(KeyboardManagerInput::InputInterface& ii)
+{
+    uint8_t pressed = 0;
+    if (ii.GetVirtualKeyState(VK_LWIN) || ii.GetVirtualKeyState(VK_RWIN))
+    {
+        pressed |= WinFlag;
+    }
+    if (ii.GetVirtualKeyState(VK_CONTROL) || ii.GetVirtualKeyState(VK_LCONTROL) || ii.GetVirtualKeyState(VK_RCONTROL))
+    {
+        pressed |= CtrlFlag;
+    }
+    if (ii.GetVirtualKeyState(VK_MENU) || ii.GetVirtualKeyState(VK_LMENU) || ii.GetVirtualKeyState(VK_RMENU))
+    {
+        pressed |= AltFlag;
+    }
+    if (ii.GetVirtualKeyState(VK_SHIFT) || ii.GetVirtualKeyState(VK_LSHIFT) || ii.GetVirtualKeyState(VK_RSHIFT))
+    {
+        pressed |= ShiftFlag;
+    }
+    return pressed;
+}
+
+// Function to get the positions of the remaps which can react to a key event, in sorted order
+void ShortcutRemapIndex::GetCandidates(DWORD vkCode, uint8_t pressedModifiers, bool anyInvoked, std::vector<size_t>& candidates) const
+{
+    candidates.clear();
+
+    if (anyInvoked)
+    {
+        candidates.assign(invoked.begin(), invoked.end());
+        return;
+    }
+
+    // Only the masks made of pressed modifiers can match, the remaps of the others are skipped without checking the key state.
+    // The started chords react to any key
+    candidates.assign(chordsStarted.begin(), chordsStarted.end());
+    const uint16_t masks = GetModifierMasks(vkCode);
+    for (uint8_t mask = 0; mask < ModifierMaskCount; mask++)
+    {
+        if ((masks & (1 << mask)) == 0 || (mask & ~pressedModifiers) != 0)
+        {
+            continue;
+        }
+
+        if (const auto positions = byKey.find(GetKey(vkCode, mask)); positions != byKey.end())
+        {
+            candidates.insert(candidates.end(), positions->second.begin(), positions->second.end());
+        }
+    }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+}
+
+// Function to record that a remap has been invoked
+void ShortcutRemapIndex::SetInvoked(size_t position)
+{
+    AddSorted(invoked, position);
+}
+
+// Function to check if any remap of the table is invoked
+bool ShortcutRemapIndex::AnyInvoked()
+{
+    std::erase_if(invoked, [this](size_t position) { return !entries[position].remap->second.isShortcutInvoked; });
+    return !invoked.empty();
+}
+
+// Function to start the chord of a remap
+void ShortcutRemapIndex::StartChord(size_t position)
+{
+    entries[position].shortcut->SetChordStarted(true);
+    AddSorted(chordsStarted, position);
+}
+
+// Function to check if any remap of the table has a started chord
+bool ShortcutRemapIndex::AnyChordStarted()
+{
+    std::erase_if(chordsStarted, [this](size_t position) { return !entries[position].shortcut->IsChordStarted(); });
+    return !chordsStarted.empty();
+}
+
+// Function to reset the started chords, except for the remaps with keyToKeep as action key. NULL resets all of them
+void ShortcutRemapIndex::ResetStartedChords(DWORD keyToKeep)
+{
+    for (const size_t position : chordsStarted)
+    {
+        Shortcut& shortcut = *entries[position].shortcut;
+        if (keyToKeep == NULL || shortcut.actionKey != keyToKeep)
+        {
+            shortcut.SetChordStarted(false);
+        }
+    }
+
+    AnyChordStarted();
+}
+
+// Function to get the modifier families a shortcut requires
+uint8_t ShortcutRemapIndex::GetModifierMask(const Shortcut& shortcut)
+{
+    uint8_t mask = 0;
+    if (shortcut.winKey != ModifierKey::Disabled)
+    {
+        mask |= WinFlag;
+    }
+    if (shortcut.ctrlKey != ModifierKey::Disabled)
+    {
+        mask |= CtrlFlag;
+    }
+    if (shortcut.altKey != ModifierKey::Disabled)
+    {
+        mask |= AltFlag;
+    }
+    if (shortcut.shiftKey != ModifierKey::Disabled)
+    {
+        mask |= ShiftFlag;
+    }
+    return mask;
+}
+
+uint64_t ShortcutRemapIndex::GetKey(DWORD actionKey, uint8_t modifierMask)
+{
+    return (static_cast<uint64_t>(actionKey) << 4) | modifierMask;
+}
+
+uint16_t ShortcutRemapIndex::GetModifierMasks(DWORD actionKey) const
+{
+    return actionKey < KeyCount ? modifierMasks[actionKey] : otherModifierMasks;
+}
+
+void ShortcutRemapIndex::AddSorted(std::vector<size_t>& positions, size_t position)
+{
+    const auto it = std::lower_bound(positions.begin(), positions.end(), position);
+    if (it == positions.end() || *it != position)
+    {
+        positions.insert(it, position);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <keyboardmanager/common/MappingConfiguration.h>
+#include <array>
+#include <unordered_map>
+
+namespace KeyboardManagerInput
+{
+    class InputInterface;
+}
+
+// Lookup structure compiled from a shortcut remap table and its sorted key vector, so that the
+// low level hook only visits the remaps a key event can affect instead of scanning the table.
+// Remaps are identified by their position in the sorted vector, which is the order the hook
+// has always tried them in, and the candidates for an event are returned in that order.
+class ShortcutRemapIndex
+{
+public:
+    struct Entry
+    {
+        // Element of the sorted vector, which holds the chord state of the remap
+        Shortcut* shortcut = nullptr;
+        ShortcutRemapTable::iterator remap;
+    };
+
+    // Function to compile the index. The vector and the table must not change until the next build, which the revision is used to detect
+    void Build(std::vector<Shortcut>& sortedShortcuts, ShortcutRemapTable& table, uint64_t revision);
+
+    // Function to check if the index was built from the given configuration revision
+    bool IsBuiltFrom(uint64_t revision) const;
+
+    bool IsEmpty() const;
+
+    const Entry& GetEntry(size_t position) const;
+
+    // Function to get the position of the remap of a source shortcut. Returns nullopt if it isn't remapped
+    std::optional<size_t> Find(const Shortcut& shortcut) const;
+
+    // Function to check if any remap has vkCode as action key
+    bool HasActionKey(DWORD vkCode) const;
+
+    // Function to get the modifier families (see GetModifierMask) of which a key is down
+    static uint8_t GetPressedModifiers(KeyboardManagerInput::InputInterface& ii);
+
+    // Function to get the positions of the remaps which can react to a key event, in sorted order.
+    // While a remap is invoked only the invoked remaps are considered. Otherwise these are the
+    // remaps with vkCode as action key whose modifiers are all among pressedModifiers, and the
+    // remaps with a started chord. The result is written to a buffer owned by the caller since
+    // sending input from the hook can re-enter it.
+    void GetCandidates(DWORD vkCode, uint8_t pressedModifiers, bool anyInvoked, std::vector<size_t>& candidates) const;
+
+    // Function to record that a remap has been invoked. Invoked remaps are tracked here so that
+    // checking for one doesn't need a scan, and dropped once their flag is cleared
+    void SetInvoked(size_t position);
+
+    // Function to check if any remap of the table is invoked
+    bool AnyInvoked();
+
+    // Function to start the chord of a remap
+    void StartChord(size_t position);
+
+    // Function to check if any remap of the table has a started chord
+    bool AnyChordStarted();
+
+    // Function to reset the started chords, except for the remaps with keyToKeep as action key. NULL resets all of them
+    void ResetStartedChords(DWORD keyToKeep);
+
+private:
+    // Modifier families of a shortcut, regardless of the side it requires
+    enum ModifierFlags : uint8_t
+    {
+        WinFlag = 1,
+        CtrlFlag = 2,
+        AltFlag = 4,
+        ShiftFlag = 8,
+    };
+    static constexpr size_t ModifierMaskCount = 16;
+
+    // Virtual key codes fit in a byte, the masks of other action keys are merged
+    static constexpr size_t KeyCount = 256;
+
+    static uint8_t GetModifierMask(const Shortcut& shortcut);
+    static uint64_t GetKey(DWORD actionKey, uint8_t modifierMask);
+    uint16_t GetModifierMasks(DWORD actionKey) const;
+
+    void AddSorted(std::vector<size_t>& positions, size_t position);
+
+    std::vector<Entry> entries;
+
+    // Remaps by action key and modifier mask, and the masks used with each action key as a bit set
+    std::unordered_map<uint64_t, std::vector<size_t>> byKey;
+    std::array<uint16_t, KeyCount> modifierMasks = {};
+    uint16_t otherModifierMasks = 0;
+
+    std::vector<size_t> invoked;
+    std::vector<size_t> chordsStarted;
+
+    std::optional<uint64_t> builtRevision;
+};
@@ -2,6 +2,9 @@
 #include "State.h"
 #include <optional>
 
+#include <keyboardmanager/common/Helpers.h>
+#include <keyboardmanager/common/InputInterface.h>
+
 // Function to get the iterator of a single key remap given the source key. Returns nullopt if it isn't remapped
 std::optional<SingleKeyRemapTable::iterator> State::GetSingleKeyRemap(const DWORD& originalKey)
 {
@@ -62,6 +65,60 @@ std::vector<Shortcut>& State::GetSortedShortcutRemapVector(const std::optional<s
     return appName ? appSpecificShortcutReMapSortedKeys[*appName] : osLevelShortcutReMapSortedKeys;
 }
 
+// Function to get the lookup structure of a shortcut remap table, which is built on first use after the tables change
+ShortcutRemapIndex& State::GetShortcutRemapIndex(const std::optional<std::wstring>& appName)
+{
+    // Assumes appName exists in the app-specific remap table
+    ShortcutRemapIndex& index = appName ? appSpecificShortcutRemapIndex[*appName] : osLevelShortcutRemapIndex;
+    const uint64_t revision = GetShortcutRemapRevision();
+    if (!index.IsBuiltFrom(revision))
+    {
+        index.Build(GetSortedShortcutRemapVector(appName), GetShortcutRemapTable(appName), revision);
+    }
+
+    return index;
+}
+
+// Function to start keeping the key state snapshot. The state of all the keys is loaded from the input interface
+void State::StartKeyboardStateTracking(KeyboardManagerInput::InputInterface& ii)
+{
+    keyboardStateSnapshot.Resync(ii);
+    isTrackingKeyboardState = true;
+}
+
+// Function to update the key state snapshot after the hook has handled a key event. hookResult is 1 if the event was suppressed
+void State::UpdateKeyboardStateSnapshot(KeyboardManagerInput::InputInterface& ii, LowlevelKeyboardEvent* data, intptr_t hookResult)
+{
+    if (!isTrackingKeyboardState)
+    {
+        return;
+    }
+
+    const DWORD key = Helpers::ClearKeyNumpadOrigin(data->lParam->vkCode);
+
+    // Key ups can be missed, e.g. while the secure desktop is shown after Win+L. The hook runs before the key state is changed, so the modifiers are reloaded before applying the event
+    if (Helpers::IsModifierKey(key))
+    {
+        keyboardStateSnapshot.ResyncModifiers(ii);
+    }
+
+    if (hookResult == 0)
+    {
+        keyboardStateSnapshot.Update(key, data->wParam == WM_KEYDOWN || data->wParam == WM_SYSKEYDOWN);
+    }
+}
+
+// Function to get the key state snapshot if shortcut checks should use it. Returns nullptr if the state of each key should be queried instead
+KeyboardStateSnapshot* State::GetKeyboardStateSnapshot()
+{
+    if (!isTrackingKeyboardState || useLegacyKeyStateQueries)
+    {
+        return nullptr;
+    }
+
+    return &keyboardStateSnapshot;
+}
+
 // Sets the activated target application in app-specific shortcut
 void State::SetActivatedApp(const std::wstring& appName)
 {
@@ -1,7 +1,11 @@
 #pragma once
 #include <keyboardmanager/common/MappingConfiguration.h>
+#include <keyboardmanager/common/KeyboardStateSnapshot.h>
+#include <common/hooks/LowlevelKeyboardEvent.h>
 #include <unordered_set>
 
+#include "ShortcutRemapIndex.h"
+
 class State : public MappingConfiguration
 {
 private:
@@ -14,6 +18,14 @@ private:
     // the (serialized) low-level keyboard hook thread.
     std::unordered_set<DWORD> singleKeyRemapInjectionFailedKeys;
 
+    // Lookup structures for the shortcut remap tables, rebuilt when the tables change
+    ShortcutRemapIndex osLevelShortcutRemapIndex;
+    std::map<std::wstring, ShortcutRemapIndex> appSpecificShortcutRemapIndex;
+
+    // Key down state of all the keys, fed by the events let through by the hook. Only used once tracking has been started
+    KeyboardStateSnapshot keyboardStateSnapshot;
+    bool isTrackingKeyboardState = false;
+
 public:
     // Function to get the iterator of a single key remap given the source key. Returns nullopt if it isn't remapped
     std::optional<SingleKeyRemapTable::iterator> GetSingleKeyRemap(const DWORD& originalKey);
@@ -28,6 +40,18 @@ public:
 
     std::vector<Shortcut>& GetSortedShortcutRemapVector(const std::optional<std::wstring>& appName);
 
+    // Function to get the lookup structure of a shortcut remap table, which is built on first use after the tables change
+    ShortcutRemapIndex& GetShortcutRemapIndex(const std::optional<std::wstring>& appName);
+
+    // Function to start keeping the key state snapshot. The state of all the keys is loaded from the input interface
+    void StartKeyboardStateTracking(KeyboardManagerInput::InputInterface& ii);
+
+    // Function to update the key state snapshot after the hook has handled a key event. hookResult is 1 if the event was suppressed
+    void UpdateKeyboardStateSnapshot(KeyboardManagerInput::InputInterface& ii, LowlevelKeyboardEvent* data, intptr_t hookResult);
+
+    // Function to get the key state snapshot if shortcut checks should use it. Returns nullptr if the state of each key should be queried instead
+    KeyboardStateSnapshot* GetKeyboardStateSnapshot();
+
     // Sets the activated target application in app-specific shortcut
     void SetActivatedApp(const std::wstring& appName);
 
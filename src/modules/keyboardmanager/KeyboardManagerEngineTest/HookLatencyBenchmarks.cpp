@@ -0,0 +1,179 @@
+#include "pch.h"
+
+// Suppressing 26466 - Don't use static_cast downcasts - in CppUnitTest.h
+#pragma warning(push)
+#pragma warning(disable : 26466)
+#include "CppUnitTest.h"
+#pragma warning(pop)
+
+#include "MockedInput.h"
+#include <keyboardmanager/KeyboardManagerEngineLibrary/State.h>
+#include <keyboardmanager/KeyboardManagerEngineLibrary/KeyboardEventHandlers.h>
+#include "TestHelpers.h"
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RemappingLogicTests
+{
+    // Measures the time the shortcut remap hooks take per key event, for small and large remap tables
+    TEST_CLASS (HookLatencyBenchmarks)
+    {
+    private:
+        KeyboardManagerInput::MockedInput mockedInputHandler;
+        State testState;
+
+        static constexpr size_t StreamLength = 20000;
+        static constexpr wchar_t ForegroundProcess[] = L"editor.exe";
+
+        // Recorded key stream: mostly typing, with modifier shortcuts and chords in between. The seed is fixed so every run replays the same events
+        static std::vector<INPUT> MakeKeyStream()
+        {
+            std::mt19937 generator(20240517);
+            std::uniform_int_distribution<int> letter(0, 25);
+            std::uniform_int_distribution<int> action(0, 99);
+            const WORD modifiers[] = { VK_CONTROL, VK_SHIFT, VK_MENU };
+
+            std::vector<INPUT> stream;
+            stream.reserve(StreamLength + 8);
+            auto press = [&stream](WORD key, bool down) {
+                stream.push_back({ .type = INPUT_KEYBOARD, .ki = { .wVk = key, .dwFlags = down ? 0UL : KEYEVENTF_KEYUP } });
+            };
+
+            while (stream.size() < StreamLength)
+            {
+                const int kind = action(generator);
+                const WORD key = static_cast<WORD>('A' + letter(generator));
+                if (kind < 80)
+                {
+                    press(key, true);
+                    press(key, false);
+                }
+                else if (kind < 95)
+                {
+                    const WORD modifier = modifiers[kind % ARRAYSIZE(modifiers)];
+                    press(modifier, true);
+                    press(key, true);
+                    press(key, false);
+                    press(modifier, false);
+                }
+                else
+                {
+                    // Ctrl+K followed by a second key, which starts a chord
+                    const WORD secondKey = static_cast<WORD>('A' + letter(generator));
+                    press(VK_CONTROL, true);
+                    press('K', true);
+                    press('K', false);
+                    press(secondKey, true);
+                    press(secondKey, false);
+                    press(VK_CONTROL, false);
+                }
+            }
+
+            return stream;
+        }
+
+        // Adds remaps of the letter keys with every combination of modifiers in modifierSets, and chords on Ctrl+K
+        void AddRemaps(const std::vector<std::vector<int32_t>>& modifierSets, bool addChords, bool addAppSpecific)
+        {
+            for (const auto& modifierSet : modifierSets)
+            {
+                for (int32_t key = 'A'; key <= 'Z'; key++)
+                {
+                    std::vector<int32_t> keys = modifierSet;
+                    keys.push_back(key);
+                    const Shortcut src(keys);
+                    testState.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_MENU, VK_F1 + (key - 'A') % 12 }));
+                    if (addAppSpecific)
+                    {
+                        testState.AddAppSpecificShortcut(ForegroundProcess, src, Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_F1 + (key - 'A') % 12 }));
+                    }
+                }
+            }
+
+            if (addChords)
+            {
+                for (DWORD secondKey = 'A'; secondKey <= 'Z'; secondKey++)
+                {
+                    Shortcut src(std::vector<int32_t>{ VK_CONTROL, 'K' });
+                    src.SetSecondKey(secondKey);
+                    testState.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_MENU, static_cast<int32_t>(secondKey) }));
+                }
+            }
+        }
+
+        // Replays the key stream one event at a time and logs the mean and 99th percentile latency
+        void MeasureHookLatency(const wchar_t* label)
+        {
+            const auto stream = MakeKeyStream();
+            std::vector<double> latencies;
+            latencies.reserve(stream.size());
+
+            for (const auto& input : stream)
+            {
+                const std::vector<INPUT> event{ input };
+                const auto start = std::chrono::steady_clock::now();
+                mockedInputHandler.SendVirtualInput(event);
+                const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+                latencies.push_back(elapsed.count());
+            }
+
+            double total = 0;
+            for (const double latency : latencies)
+            {
+                total += latency;
+            }
+            std::sort(latencies.begin(), latencies.end());
+            const double p99 = latencies[latencies.size() * 99 / 100];
+
+            std::wstring message = std::wstring(label) + L": " + std::to_wstring(testState.osLevelShortcutReMap.size()) + L" OS level remaps, " +
+                                   std::to_wstring(latencies.size()) + L" events, mean " + std::to_wstring(total / latencies.size()) + L" us, p99 " + std::to_wstring(p99) + L" us";
+            Logger::WriteMessage(message.c_str());
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeTestEnv)
+        {
+            // Reset test environment
+            TestHelpers::ResetTestEnv(mockedInputHandler, testState);
+            mockedInputHandler.SetForegroundProcess(ForegroundProcess);
+
+            // Chain the app specific and OS level shortcut hooks like the keyboard manager hook does
+            mockedInputHandler.SetHookProc([this](LowlevelKeyboardEvent* data) {
+                intptr_t result = KeyboardEventHandlers::HandleAppSpecificShortcutRemapEvent(mockedInputHandler, data, testState);
+                if (result == 1)
+                {
+                    return result;
+                }
+
+                return KeyboardEventHandlers::HandleOSLevelShortcutRemapEvent(mockedInputHandler, data, testState);
+            });
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(HookLatency_SmallRemapTable)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD(HookLatency_SmallRemapTable)
+        {
+            Shortcut src(std::vector<int32_t>{ VK_CONTROL, 'C' });
+            testState.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_INSERT }));
+            Shortcut src2(std::vector<int32_t>{ VK_CONTROL, 'V' });
+            testState.AddOSLevelShortcut(src2, Shortcut(std::vector<int32_t>{ VK_SHIFT, VK_INSERT }));
+
+            MeasureHookLatency(L"Small remap table");
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(HookLatency_LargeRemapTable)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD(HookLatency_LargeRemapTable)
+        {
+            AddRemaps({ { VK_CONTROL, VK_MENU }, { VK_CONTROL, VK_SHIFT }, { VK_MENU, VK_SHIFT }, { VK_LWIN, VK_SHIFT }, { VK_CONTROL, VK_MENU, VK_SHIFT }, { VK_LWIN, VK_CONTROL, VK_SHIFT } }, true, true);
+
+            MeasureHookLatency(L"Large remap table");
+        }
+    };
+}
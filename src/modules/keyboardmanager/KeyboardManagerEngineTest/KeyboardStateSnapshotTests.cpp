@@ -0,0 +1,261 @@
+#include "pch.h"
+
+// Suppressing 26466 - Don't use static_cast downcasts - in CppUnitTest.h
+#pragma warning(push)
+#pragma warning(disable : 26466)
+#include "CppUnitTest.h"
+#pragma warning(pop)
+
+#include "MockedInput.h"
+#include <keyboardmanager/KeyboardManagerEngineLibrary/State.h>
+#include <keyboardmanager/KeyboardManagerEngineLibrary/KeyboardEventHandlers.h>
+#include <keyboardmanager/common/KeyboardStateSnapshot.h>
+#include "TestHelpers.h"
+
+#include <memory>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RemappingLogicTests
+{
+    // Mocked input and state which are driven like the keyboard manager hook, with the key state snapshot either used or replaced by key state queries
+    struct HookHarness
+    {
+        KeyboardManagerInput::MockedInput input;
+        State state;
+        std::vector<intptr_t> results;
+
+        explicit HookHarness(bool useLegacyKeyStateQueries)
+        {
+            TestHelpers::ResetTestEnv(input, state);
+            state.useLegacyKeyStateQueries = useLegacyKeyStateQueries;
+            state.StartKeyboardStateTracking(input);
+
+            input.SetHookProc([this](LowlevelKeyboardEvent* data) {
+                const intptr_t result = HandleEvent(data);
+                state.UpdateKeyboardStateSnapshot(input, data, result);
+                results.push_back(result);
+                return result;
+            });
+        }
+
+        // Same order of handlers as KeyboardManager::HandleKeyboardHookEvent
+        intptr_t HandleEvent(LowlevelKeyboardEvent* data)
+        {
+            if (data->lParam->dwExtraInfo == KeyboardManagerConstants::KEYBOARDMANAGER_SUPPRESS_FLAG)
+            {
+                return 1;
+            }
+
+            if (KeyboardEventHandlers::HandleSingleKeyRemapEvent(input, data, state) == 1)
+            {
+                return 1;
+            }
+
+            if (KeyboardEventHandlers::HandleAppSpecificShortcutRemapEvent(input, data, state) == 1)
+            {
+                return 1;
+            }
+
+            if (KeyboardEventHandlers::HandleSingleKeyToTextRemapEvent(input, data, state) == 1)
+            {
+                return 1;
+            }
+
+            return KeyboardEventHandlers::HandleOSLevelShortcutRemapEvent(input, data, state);
+        }
+
+        void AddRemaps()
+        {
+            input.SetForegroundProcess(L"editor.exe");
+
+            state.AddSingleKeyRemap('J', static_cast<DWORD>('L'));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_CONTROL, 'A' }), Shortcut(std::vector<int32_t>{ VK_MENU, 'V' }));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_SHIFT, 'B' }), Shortcut(std::vector<int32_t>{ VK_LWIN, 'E' }));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_CONTROL, 'C' }), static_cast<DWORD>('D'));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_MENU, 'E' }), Shortcut(std::vector<int32_t>{ VK_CONTROL, 'E' }));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_LSHIFT, 'A' }), static_cast<DWORD>('B'));
+            state.AddOSLevelShortcut(Shortcut(std::vector<int32_t>{ VK_LWIN, 'X' }), Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_SHIFT, VK_ESCAPE }));
+
+            Shortcut exactMatch(std::vector<int32_t>{ VK_SHIFT, 'F' });
+            exactMatch.exactMatch = true;
+            state.AddOSLevelShortcut(exactMatch, Shortcut(std::vector<int32_t>{ VK_CONTROL, 'F' }));
+
+            Shortcut chord(std::vector<int32_t>{ VK_CONTROL, 'K' });
+            chord.SetSecondKey('D');
+            state.AddOSLevelShortcut(chord, Shortcut(std::vector<int32_t>{ VK_CONTROL, VK_SHIFT, 'Z' }));
+
+            state.AddAppSpecificShortcut(L"editor.exe", Shortcut(std::vector<int32_t>{ VK_CONTROL, 'B' }), Shortcut(std::vector<int32_t>{ VK_CONTROL, 'X' }));
+        }
+    };
+
+    // Tests for the key state snapshot used by the shortcut checks
+    TEST_CLASS (KeyboardStateSnapshotTests)
+    {
+    private:
+        KeyboardManagerInput::MockedInput mockedInputHandler;
+        State testState;
+
+        static Shortcut MakeRandomShortcut(std::mt19937& generator)
+        {
+            const ModifierKey modifierKeys[] = { ModifierKey::Disabled, ModifierKey::Disabled, ModifierKey::Left, ModifierKey::Right, ModifierKey::Both };
+            std::uniform_int_distribution<size_t> modifier(0, ARRAYSIZE(modifierKeys) - 1);
+            std::uniform_int_distribution<DWORD> key(1, 0xFE);
+
+            Shortcut shortcut;
+            shortcut.winKey = modifierKeys[modifier(generator)];
+            shortcut.ctrlKey = modifierKeys[modifier(generator)];
+            shortcut.altKey = modifierKeys[modifier(generator)];
+            shortcut.shiftKey = modifierKeys[modifier(generator)];
+            shortcut.actionKey = key(generator);
+            return shortcut;
+        }
+
+    public:
+        TEST_METHOD_INITIALIZE(InitializeTestEnv)
+        {
+            // Reset test environment
+            TestHelpers::ResetTestEnv(mockedInputHandler, testState);
+        }
+
+        // Test if the shortcut checks on the snapshot give the same results as the key state queries
+        TEST_METHOD (ShortcutChecks_ShouldMatchKeyStateQueries_ForRandomKeyboardStates)
+        {
+            std::mt19937 generator(5489);
+            std::bernoulli_distribution keyDown(0.02);
+            std::bernoulli_distribution modifierDown(0.3);
+            const int modifierKeys[] = { VK_LWIN, VK_RWIN, VK_CONTROL, VK_LCONTROL, VK_RCONTROL, VK_MENU, VK_LMENU, VK_RMENU, VK_SHIFT, VK_LSHIFT, VK_RSHIFT };
+
+            for (int i = 0; i < 2000; i++)
+            {
+                for (int key = 0; key < 256; key++)
+                {
+                    mockedInputHandler.SetKeyboardState(key, keyDown(generator));
+                }
+                for (const int key : modifierKeys)
+                {
+                    mockedInputHandler.SetKeyboardState(key, modifierDown(generator));
+                }
+
+                KeyboardStateSnapshot snapshot;
+                snapshot.Resync(mockedInputHandler);
+
+                for (int j = 0; j < 20; j++)
+                {
+                    Shortcut shortcut = MakeRandomShortcut(generator);
+                    Assert::AreEqual(shortcut.CheckModifiersKeyboardState(mockedInputHandler), shortcut.CheckModifiersKeyboardState(snapshot));
+                    Assert::AreEqual(shortcut.IsKeyboardStateClearExceptShortcut(mockedInputHandler), shortcut.IsKeyboardStateClearExceptShortcut(snapshot));
+
+                    // Same shortcut with an action key which is pressed down
+                    shortcut.actionKey = 'A';
+                    mockedInputHandler.SetKeyboardState('A', true);
+                    snapshot.Update('A', true);
+                    Assert::AreEqual(shortcut.IsKeyboardStateClearExceptShortcut(mockedInputHandler), shortcut.IsKeyboardStateClearExceptShortcut(snapshot));
+                }
+            }
+        }
+
+        // Test if the combined modifier keys follow the key events of both sides
+        TEST_METHOD (Snapshot_ShouldUpdateCombinedModifier_OnKeyEvents)
+        {
+            KeyboardStateSnapshot snapshot;
+
+            snapshot.Update(VK_LCONTROL, true);
+            snapshot.Update(VK_RCONTROL, true);
+            snapshot.Update(VK_LCONTROL, false);
+            Assert::AreEqual(true, snapshot.IsKeyDown(VK_CONTROL));
+            snapshot.Update(VK_RCONTROL, false);
+            Assert::AreEqual(false, snapshot.IsKeyDown(VK_CONTROL));
+
+            snapshot.Update(VK_LSHIFT, true);
+            snapshot.Update(VK_SHIFT, false);
+            Assert::AreEqual(false, snapshot.IsKeyDown(VK_LSHIFT));
+            Assert::AreEqual(false, snapshot.IsKeyDown(VK_SHIFT));
+
+            // Key codes outside of the virtual key range are ignored
+            snapshot.Update(0x1000041, true);
+            Assert::AreEqual(false, snapshot.IsKeyDown('A'));
+        }
+
+        // Test if a modifier whose key up was missed by the hook does not invoke a remap
+        TEST_METHOD (MissedModifierKeyUp_ShouldNotInvokeRemap)
+        {
+            HookHarness harness(false);
+            Shortcut src(std::vector<int32_t>{ VK_LWIN, 'E' });
+            harness.state.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_CONTROL, 'E' }));
+
+            std::vector<INPUT> winDown{ { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_LWIN } } };
+            harness.input.SendVirtualInput(winDown);
+
+            // Release Win without going through the hook, as happens when the secure desktop is shown
+            harness.input.SetKeyboardState(VK_LWIN, false);
+
+            std::vector<INPUT> inputs{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'E' } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'E', .dwFlags = KEYEVENTF_KEYUP } },
+            };
+            harness.input.SendVirtualInput(inputs);
+
+            Assert::AreEqual(false, harness.state.osLevelShortcutReMap[src].isShortcutInvoked);
+            Assert::AreEqual(false, harness.input.GetVirtualKeyState(VK_CONTROL));
+        }
+
+        // Test if the hook takes the same decisions with the snapshot and with key state queries over random key sequences
+        TEST_METHOD (HookDecisions_ShouldMatchLegacyKeyStateQueries_ForRandomKeySequences)
+        {
+            // The mocked input clears the combined modifier when either side is released, so only the left modifiers are pressed to keep both sides from being down at once
+            const WORD keys[] = { VK_LCONTROL, VK_LSHIFT, VK_LMENU, VK_LWIN, 'A', 'B', 'C', 'D', 'E', 'F', 'J', 'K', 'X' };
+
+            for (unsigned int seed = 1; seed <= 10; seed++)
+            {
+                auto snapshotHarness = std::make_unique<HookHarness>(false);
+                auto legacyHarness = std::make_unique<HookHarness>(true);
+                snapshotHarness->AddRemaps();
+                legacyHarness->AddRemaps();
+
+                std::mt19937 generator(seed);
+                std::uniform_int_distribution<size_t> keyIndex(0, ARRAYSIZE(keys) - 1);
+                std::vector<WORD> heldKeys;
+
+                auto send = [&](WORD key, bool down) {
+                    std::vector<INPUT> event{ { .type = INPUT_KEYBOARD, .ki = { .wVk = key, .dwFlags = down ? 0UL : KEYEVENTF_KEYUP } } };
+                    snapshotHarness->input.SendVirtualInput(event);
+                    legacyHarness->input.SendVirtualInput(event);
+
+                    Assert::IsTrue(snapshotHarness->results == legacyHarness->results);
+                    for (int i = 0; i < 256; i++)
+                    {
+                        Assert::AreEqual(legacyHarness->input.GetVirtualKeyState(i), snapshotHarness->input.GetVirtualKeyState(i));
+                    }
+                };
+
+                for (int i = 0; i < 3000; i++)
+                {
+                    const WORD key = keys[keyIndex(generator)];
+                    const auto held = std::find(heldKeys.begin(), heldKeys.end(), key);
+                    if (held != heldKeys.end())
+                    {
+                        heldKeys.erase(held);
+                        send(key, false);
+                    }
+                    else if (heldKeys.size() < 4)
+                    {
+                        heldKeys.push_back(key);
+                        send(key, true);
+                    }
+                }
+
+                for (const WORD key : heldKeys)
+                {
+                    send(key, false);
+                }
+
+                for (auto& [shortcut, remap] : legacyHarness->state.osLevelShortcutReMap)
+                {
+                    Assert::AreEqual(remap.isShortcutInvoked, snapshotHarness->state.osLevelShortcutReMap[shortcut].isShortcutInvoked);
+                }
+            }
+        }
+    };
+}
@@ -98,6 +98,41 @@ namespace RemappingLogicTests
             Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(0x56), true);
         }
 
+        // Test if the remap with the pressed modifiers is applied when several remaps share the action key
+        TEST_METHOD (RemappedTwoKeyShortcutsWithSameActionKey_ShouldApplyRemapOfPressedModifier_OnKeyDown)
+        {
+            // Remap Ctrl+A to Alt+V and Shift+A to Alt+B
+            Shortcut ctrlSrc;
+            ctrlSrc.SetKey(VK_CONTROL);
+            ctrlSrc.SetKey(0x41);
+            Shortcut ctrlDest;
+            ctrlDest.SetKey(VK_MENU);
+            ctrlDest.SetKey(0x56);
+            testState.AddOSLevelShortcut(ctrlSrc, ctrlDest);
+            Shortcut shiftSrc;
+            shiftSrc.SetKey(VK_SHIFT);
+            shiftSrc.SetKey(0x41);
+            Shortcut shiftDest;
+            shiftDest.SetKey(VK_MENU);
+            shiftDest.SetKey(0x42);
+            testState.AddOSLevelShortcut(shiftSrc, shiftDest);
+
+            std::vector<INPUT> inputs{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_SHIFT } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A' } },
+            };
+
+            // Send Shift+A keydown
+            mockedInputHandler.SendVirtualInput(inputs);
+
+            // Shift and A key states should be unchanged, Alt and B key states should be true, V should not be pressed
+            Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(VK_SHIFT), false);
+            Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(0x41), false);
+            Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(VK_MENU), true);
+            Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(0x42), true);
+            Assert::AreEqual(mockedInputHandler.GetVirtualKeyState(0x56), false);
+        }
+
         // Test if correct keyboard states are set for a 2 key shortcut remap with different modifiers key down followed by key up
         TEST_METHOD (RemappedTwoKeyShortcutWithDiffModifiers_ShouldClearKeyboard_OnKeyUp)
         {
@@ -2510,5 +2545,107 @@ namespace RemappingLogicTests
             Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(VK_LCONTROL));
             Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(VK_BACK));
         }
+
+        // Test if the remap with the pressed modifiers is applied when several remaps share the same action key
+        TEST_METHOD (RemappedShortcutsWithSameActionKey_ShouldApplyRemapMatchingModifiers_OnKeyDown)
+        {
+            // Remap Ctrl+A to Alt+V, Shift+A to Alt+W and Ctrl+Shift+A to Alt+X
+            Shortcut ctrlSrc(std::vector<int32_t>{ VK_CONTROL, 0x41 });
+            Shortcut shiftSrc(std::vector<int32_t>{ VK_SHIFT, 0x41 });
+            Shortcut ctrlShiftSrc(std::vector<int32_t>{ VK_CONTROL, VK_SHIFT, 0x41 });
+            testState.AddOSLevelShortcut(ctrlSrc, Shortcut(std::vector<int32_t>{ VK_MENU, 0x56 }));
+            testState.AddOSLevelShortcut(shiftSrc, Shortcut(std::vector<int32_t>{ VK_MENU, 0x57 }));
+            testState.AddOSLevelShortcut(ctrlShiftSrc, Shortcut(std::vector<int32_t>{ VK_MENU, 0x58 }));
+
+            std::vector<INPUT> inputs{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_SHIFT } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A' } },
+            };
+
+            // Send Shift+A keydown
+            mockedInputHandler.SendVirtualInput(inputs);
+
+            // Only the Shift+A remap should be invoked
+            Assert::AreEqual(false, testState.osLevelShortcutReMap[ctrlSrc].isShortcutInvoked);
+            Assert::AreEqual(true, testState.osLevelShortcutReMap[shiftSrc].isShortcutInvoked);
+            Assert::AreEqual(false, testState.osLevelShortcutReMap[ctrlShiftSrc].isShortcutInvoked);
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(VK_MENU));
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(0x57));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(0x56));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(0x58));
+        }
+
+        // Test if remaps added or cleared after the hook has already handled key events are taken into account
+        TEST_METHOD (ShortcutRemapsChangedAfterKeyEvents_ShouldApplyCurrentRemaps)
+        {
+            std::vector<INPUT> inputs{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_CONTROL } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A' } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A', .dwFlags = KEYEVENTF_KEYUP } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_CONTROL, .dwFlags = KEYEVENTF_KEYUP } },
+            };
+
+            // Send Ctrl+A with no remaps
+            mockedInputHandler.SendVirtualInput(inputs);
+
+            // Remap Ctrl+A to Alt+V
+            Shortcut src(std::vector<int32_t>{ VK_CONTROL, 0x41 });
+            testState.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_MENU, 0x56 }));
+
+            std::vector<INPUT> keyDown{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_CONTROL } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A' } },
+            };
+            std::vector<INPUT> keyUp{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'A', .dwFlags = KEYEVENTF_KEYUP } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_CONTROL, .dwFlags = KEYEVENTF_KEYUP } },
+            };
+
+            // Send Ctrl+A keydown, the new remap should be applied
+            mockedInputHandler.SendVirtualInput(keyDown);
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(VK_MENU));
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(0x56));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(0x41));
+            mockedInputHandler.SendVirtualInput(keyUp);
+
+            // Clear the remaps and send Ctrl+A keydown again, the keys should not be remapped
+            testState.ClearOSLevelShortcuts();
+            mockedInputHandler.SendVirtualInput(keyDown);
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(VK_CONTROL));
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(0x41));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(VK_MENU));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(0x56));
+        }
+
+        // Test if a chord remap is applied when its second key is pressed after the first one
+        TEST_METHOD (RemappedChordShortcut_ShouldSetTargetShortcutDown_OnSecondKeyDown)
+        {
+            // Remap Ctrl+(K, V) to Ctrl+B
+            Shortcut src(std::vector<int32_t>{ VK_CONTROL, 0x4B });
+            src.SetSecondKey(0x56);
+            testState.AddOSLevelShortcut(src, Shortcut(std::vector<int32_t>{ VK_CONTROL, 0x42 }));
+
+            std::vector<INPUT> inputs{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = VK_CONTROL } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'K' } },
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'K', .dwFlags = KEYEVENTF_KEYUP } },
+            };
+
+            // Send Ctrl+K, the chord should be started but not applied yet
+            mockedInputHandler.SendVirtualInput(inputs);
+            Assert::AreEqual(false, testState.osLevelShortcutReMap[src].isShortcutInvoked);
+
+            // Send V keydown
+            std::vector<INPUT> secondKey{
+                { .type = INPUT_KEYBOARD, .ki = { .wVk = 'V' } },
+            };
+            mockedInputHandler.SendVirtualInput(secondKey);
+
+            // Ctrl and B key states should be true, V key state should be unchanged
+            Assert::AreEqual(true, testState.osLevelShortcutReMap[src].isShortcutInvoked);
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(VK_CONTROL));
+            Assert::AreEqual(true, mockedInputHandler.GetVirtualKeyState(0x42));
+            Assert::AreEqual(false, mockedInputHandler.GetVirtualKeyState(0x56));
+        }
     };
 }
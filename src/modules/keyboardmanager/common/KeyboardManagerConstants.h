@@ -13,6 +13,9 @@ namespace KeyboardManagerConstants
     // Name of the property use to store current active configuration.
     inline const std::wstring ActiveConfigurationSettingName = L"activeConfiguration";
 
+    // Name of the property use to make shortcut checks query the state of each key instead of using the key state snapshot.
+    inline const std::wstring UseLegacyKeyStateQueriesSettingName = L"useLegacyKeyStateQueries";
+
     // Name of the property use to store single keyremaps.
     inline const std::wstring RemapKeysSettingName = L"remapKeys";
 
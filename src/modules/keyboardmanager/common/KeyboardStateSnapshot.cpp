@@ -0,0 +1,136 @@
+#include "pch.h"
+#include "KeyboardStateSnapshot.h"
+
+#include "InputInterface.h"
+
+namespace
+{
+    // Modifier keys, reloaded whenever a modifier key event is seen so that a missed key up can't leave a modifier stuck
+    constexpr DWORD ModifierKeys[] = { VK_LWIN, VK_RWIN, VK_CONTROL, VK_LCONTROL, VK_RCONTROL, VK_MENU, VK_LMENU, VK_RMENU, VK_SHIFT, VK_LSHIFT, VK_RSHIFT };
+
+    constexpr DWORD KeyCount = 256;
+}
+
+// Function to set a key in a key mask. Key codes outside of the virtual key range are ignored
+void KeyboardStateSnapshot::SetKey(KeyMask& mask, DWORD key)
+{
+    if (key < KeyCount)
+    {
+        mask[key / 64] |= 1ull << (key % 64);
+    }
+}
+
+// Function to check if a key is set in a key mask
+bool KeyboardStateSnapshot::IsKeySet(const KeyMask& mask, DWORD key)
+{
+    return key < KeyCount && (mask[key / 64] & (1ull << (key % 64))) != 0;
+}
+
+// Function to reload the state of all the keys from the input interface
+void KeyboardStateSnapshot::Resync(KeyboardManagerInput::InputInterface& ii)
+{
+    keysDown = {};
+    for (DWORD key = 1; key < KeyCount; key++)
+    {
+        if (ii.GetVirtualKeyState(key))
+        {
+            SetKey(keysDown, key);
+        }
+    }
+}
+
+// Function to reload the state of the modifier keys from the input interface
+void KeyboardStateSnapshot::ResyncModifiers(KeyboardManagerInput::InputInterface& ii)
+{
+    for (const DWORD key : ModifierKeys)
+    {
+        SetKeyState(key, ii.GetVirtualKeyState(key));
+    }
+}
+
+// Function to apply a key event which has reached the system, including the combined modifier keys
+void KeyboardStateSnapshot::Update(DWORD key, bool isKeyDown)
+{
+    if (key >= KeyCount)
+    {
+        return;
+    }
+
+    SetKeyState(key, isKeyDown);
+
+    // Releasing a combined modifier key releases both sides, and the combined key stays down while either side is down
+    switch (key)
+    {
+    case VK_CONTROL:
+        if (!isKeyDown)
+        {
+            SetKeyState(VK_LCONTROL, false);
+            SetKeyState(VK_RCONTROL, false);
+        }
+        break;
+    case VK_LCONTROL:
+    case VK_RCONTROL:
+        SetKeyState(VK_CONTROL, IsKeyDown(VK_LCONTROL) || IsKeyDown(VK_RCONTROL));
+        break;
+    case VK_MENU:
+        if (!isKeyDown)
+        {
+            SetKeyState(VK_LMENU, false);
+            SetKeyState(VK_RMENU, false);
+        }
+        break;
+    case VK_LMENU:
+    case VK_RMENU:
+        SetKeyState(VK_MENU, IsKeyDown(VK_LMENU) || IsKeyDown(VK_RMENU));
+        break;
+    case VK_SHIFT:
+        if (!isKeyDown)
+        {
+            SetKeyState(VK_LSHIFT, false);
+            SetKeyState(VK_RSHIFT, false);
+        }
+        break;
+    case VK_LSHIFT:
+    case VK_RSHIFT:
+        SetKeyState(VK_SHIFT, IsKeyDown(VK_LSHIFT) || IsKeyDown(VK_RSHIFT));
+        break;
+    }
+}
+
+// Function to check if a key is pressed down
+bool KeyboardStateSnapshot::IsKeyDown(DWORD key) const
+{
+    return IsKeySet(keysDown, key);
+}
+
+// Function to check if any key which is not set in the mask is pressed down
+bool KeyboardStateSnapshot::IsAnyKeyDownExcept(const KeyMask& allowedKeys) const
+{
+    for (size_t i = 0; i < keysDown.size(); i++)
+    {
+        if ((keysDown[i] & ~allowedKeys[i]) != 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const KeyboardStateSnapshot::KeyMask& KeyboardStateSnapshot::GetKeysDown() const
+{
+    return keysDown;
+}
+
+void KeyboardStateSnapshot::SetKeyState(DWORD key, bool isDown)
+{
+    const uint64_t bit = 1ull << (key % 64);
+    if (isDown)
+    {
+        keysDown[key / 64] |= bit;
+    }
+    else
+    {
+        keysDown[key / 64] &= ~bit;
+    }
+}
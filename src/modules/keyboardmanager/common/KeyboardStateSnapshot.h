@@ -0,0 +1,45 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace KeyboardManagerInput
+{
+    class InputInterface;
+}
+
+// Class to store the key down state of all the virtual keys. It is kept up to date from the key events which are let through by the low level hook, so that shortcut checks can use bit operations instead of querying the state of every key
+class KeyboardStateSnapshot
+{
+public:
+    // 256 bits, one for each virtual key code
+    using KeyMask = std::array<uint64_t, 4>;
+
+    // Function to set a key in a key mask. Key codes outside of the virtual key range are ignored
+    static void SetKey(KeyMask& mask, DWORD key);
+
+    // Function to check if a key is set in a key mask
+    static bool IsKeySet(const KeyMask& mask, DWORD key);
+
+    // Function to reload the state of all the keys from the input interface
+    void Resync(KeyboardManagerInput::InputInterface& ii);
+
+    // Function to reload the state of the modifier keys from the input interface
+    void ResyncModifiers(KeyboardManagerInput::InputInterface& ii);
+
+    // Function to apply a key event which has reached the system, including the combined modifier keys
+    void Update(DWORD key, bool isKeyDown);
+
+    // Function to check if a key is pressed down
+    bool IsKeyDown(DWORD key) const;
+
+    // Function to check if any key which is not set in the mask is pressed down
+    bool IsAnyKeyDownExcept(const KeyMask& allowedKeys) const;
+
+    const KeyMask& GetKeysDown() const;
+
+private:
+    void SetKeyState(DWORD key, bool isDown);
+
+    KeyMask keysDown{};
+};
@@ -46,6 +46,7 @@ void MappingConfiguration::ClearOSLevelShortcuts()
 {
     osLevelShortcutReMap.clear();
     osLevelShortcutReMapSortedKeys.clear();
+    shortcutRemapRevision++;
 }
 
 // Function to clear the Keys remapping table.
@@ -66,6 +67,7 @@ void MappingConfiguration::ClearAppSpecificShortcuts()
 {
     appSpecificShortcutReMap.clear();
     appSpecificShortcutReMapSortedKeys.clear();
+    shortcutRemapRevision++;
 }
 
 // Function to add a new OS level shortcut remapping
@@ -81,6 +83,7 @@ bool MappingConfiguration::AddOSLevelShortcut(const Shortcut& originalSC, const
     osLevelShortcutReMap[originalSC] = RemapShortcut(newSC);
     osLevelShortcutReMapSortedKeys.push_back(originalSC);
     Helpers::SortShortcutVectorBasedOnSize(osLevelShortcutReMapSortedKeys);
+    shortcutRemapRevision++;
 
     return true;
 }
@@ -148,6 +151,7 @@ bool MappingConfiguration::AddAppSpecificShortcut(const std::wstring& app, const
     appSpecificShortcutReMap[process_name][originalSC] = RemapShortcut(newSC);
     appSpecificShortcutReMapSortedKeys[process_name].push_back(originalSC);
     Helpers::SortShortcutVectorBasedOnSize(appSpecificShortcutReMapSortedKeys[process_name]);
+    shortcutRemapRevision++;
     return true;
 }
 
@@ -455,6 +459,15 @@ bool MappingConfiguration::LoadSettings()
         currentConfig = *current_config;
     configurationNameResolved = true;
 
+        try
+        {
+            useLegacyKeyStateQueries = settings.get_raw_json().GetNamedObject(L"properties").GetNamedBoolean(KeyboardManagerConstants::UseLegacyKeyStateQueriesSettingName, false);
+        }
+        catch (...)
+        {
+            useLegacyKeyStateQueries = false;
+        }
+
         // Read the config file and load the remaps.
         auto configFile = json::from_file(PTSettingsHelper::get_module_save_folder_location(KeyboardManagerConstants::ModuleName) + L"\\" + *current_config + L".json");
         if (!configFile)
@@ -484,6 +497,11 @@ bool MappingConfiguration::IsConfigurationNameResolved() const
     return configurationNameResolved;
 }
 
+uint64_t MappingConfiguration::GetShortcutRemapRevision() const
+{
+    return shortcutRemapRevision;
+}
+
 // Save the updated configuration.
 bool MappingConfiguration::SaveSettingsToFile()
 {
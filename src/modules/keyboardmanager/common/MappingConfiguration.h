@@ -48,6 +48,9 @@ public:
     // Function to add a new App specific level shortcut remapping
     bool AddAppSpecificShortcut(const std::wstring& app, const Shortcut& originalSC, const KeyShortcutTextUnion& newSC);
 
+    // Function to get a counter which changes whenever the shortcut remapping tables are cleared or added to. Lookup structures built from the tables use it to detect that they are stale
+    uint64_t GetShortcutRemapRevision() const;
+
     // The map members and their mutexes are left as public since the maps are used extensively in dllmain.cpp.
     // Maps which store the remappings for each of the features. The bool fields should be initialized to false. They are used to check the current state of the shortcut (i.e is that particular shortcut currently pressed down or not).
     // Stores single key remappings
@@ -71,8 +74,12 @@ public:
     // Stores the current configuration name.
     std::wstring currentConfig = KeyboardManagerConstants::DefaultConfiguration;
 
+    // If true, shortcut checks query the state of each key instead of using the key state snapshot kept by the hook
+    bool useLegacyKeyStateQueries = false;
+
 private:
     bool configurationNameResolved = false;
+    uint64_t shortcutRemapRevision = 0;
 
     bool LoadSingleKeyRemaps(const json::JsonObject& jsonData);
     bool LoadSingleKeyToTextRemaps(const json::JsonObject& jsonData);
@@ -4,6 +4,7 @@
 #include <common/interop/shared_constants.h>
 #include "Helpers.h"
 #include "InputInterface.h"
+#include "KeyboardStateSnapshot.h"
 #include <string>
 #include <sstream>
 
@@ -919,6 +920,97 @@ bool Shortcut::IsKeyboardStateClearExceptShortcut(KeyboardManagerInput::InputInt
     return true;
 }
 
+// Function to get the key which has to be pressed for a modifier of the shortcut. Returns NULL if the modifier is not part of the shortcut
+static DWORD GetRequiredModifierKey(ModifierKey modifier, DWORD leftKey, DWORD rightKey, DWORD combinedKey)
+{
+    switch (modifier)
+    {
+    case ModifierKey::Left:
+        return leftKey;
+    case ModifierKey::Right:
+        return rightKey;
+    case ModifierKey::Both:
+        return combinedKey;
+    default:
+        return NULL;
+    }
+}
+
+// Function to check if all the modifiers in the shortcut are pressed down in a key state snapshot
+bool Shortcut::CheckModifiersKeyboardState(const KeyboardStateSnapshot& snapshot) const
+{
+    // Since VK_WIN does not exist, either win key is accepted for both
+    if (winKey == ModifierKey::Both)
+    {
+        if (!snapshot.IsKeyDown(VK_LWIN) && !snapshot.IsKeyDown(VK_RWIN))
+        {
+            return false;
+        }
+    }
+    else if (const DWORD key = GetRequiredModifierKey(winKey, VK_LWIN, VK_RWIN, NULL); key != NULL && !snapshot.IsKeyDown(key))
+    {
+        return false;
+    }
+
+    const DWORD requiredKeys[] = {
+        GetRequiredModifierKey(ctrlKey, VK_LCONTROL, VK_RCONTROL, VK_CONTROL),
+        GetRequiredModifierKey(altKey, VK_LMENU, VK_RMENU, VK_MENU),
+        GetRequiredModifierKey(shiftKey, VK_LSHIFT, VK_RSHIFT, VK_SHIFT),
+    };
+    for (const DWORD key : requiredKeys)
+    {
+        if (key != NULL && !snapshot.IsKeyDown(key))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Function to check if any keys are pressed down in a key state snapshot except those in the shortcut
+bool Shortcut::IsKeyboardStateClearExceptShortcut(const KeyboardStateSnapshot& snapshot) const
+{
+    // Keys which are never considered, same as the keys skipped by the key state queries. 0xFF is set to key down because of the Num Lock
+    static const KeyboardStateSnapshot::KeyMask ignoredKeys = [] {
+        KeyboardStateSnapshot::KeyMask mask{};
+        KeyboardStateSnapshot::SetKey(mask, 0);
+        KeyboardStateSnapshot::SetKey(mask, 0xFF);
+        for (DWORD keyVal = 1; keyVal < 0xFF; keyVal++)
+        {
+            if (IgnoreKeyCode(keyVal))
+            {
+                KeyboardStateSnapshot::SetKey(mask, keyVal);
+            }
+        }
+        return mask;
+    }();
+
+    KeyboardStateSnapshot::KeyMask allowedKeys = ignoredKeys;
+    auto allowModifier = [&allowedKeys](ModifierKey modifier, DWORD leftKey, DWORD rightKey, DWORD combinedKey) {
+        if (modifier == ModifierKey::Left || modifier == ModifierKey::Both)
+        {
+            KeyboardStateSnapshot::SetKey(allowedKeys, leftKey);
+        }
+        if (modifier == ModifierKey::Right || modifier == ModifierKey::Both)
+        {
+            KeyboardStateSnapshot::SetKey(allowedKeys, rightKey);
+        }
+        if (modifier != ModifierKey::Disabled && combinedKey != NULL)
+        {
+            KeyboardStateSnapshot::SetKey(allowedKeys, combinedKey);
+        }
+    };
+
+    allowModifier(winKey, VK_LWIN, VK_RWIN, NULL);
+    allowModifier(ctrlKey, VK_LCONTROL, VK_RCONTROL, VK_CONTROL);
+    allowModifier(altKey, VK_LMENU, VK_RMENU, VK_MENU);
+    allowModifier(shiftKey, VK_LSHIFT, VK_RSHIFT, VK_SHIFT);
+    KeyboardStateSnapshot::SetKey(allowedKeys, actionKey);
+
+    return !snapshot.IsAnyKeyDownExcept(allowedKeys);
+}
+
 // Function to get the number of modifiers that are common between the current shortcut and the shortcut in the argument
 int Shortcut::GetCommonModifiersCount(const Shortcut& input) const
 {
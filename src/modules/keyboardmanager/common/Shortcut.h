@@ -9,6 +9,7 @@ namespace KeyboardManagerInput
     class InputInterface;
 }
 class LayoutMap;
+class KeyboardStateSnapshot;
 
 class Shortcut
 {
@@ -186,6 +187,12 @@ public:
     // Function to check if any keys are pressed down except those in the shortcut
     bool IsKeyboardStateClearExceptShortcut(KeyboardManagerInput::InputInterface& ii) const;
 
+    // Function to check if all the modifiers in the shortcut are pressed down in a key state snapshot
+    bool CheckModifiersKeyboardState(const KeyboardStateSnapshot& snapshot) const;
+
+    // Function to check if any keys are pressed down in a key state snapshot except those in the shortcut
+    bool IsKeyboardStateClearExceptShortcut(const KeyboardStateSnapshot& snapshot) const;
+
     // Function to get the number of modifiers that are common between the current shortcut and the shortcut in the argument
     int GetCommonModifiersCount(const Shortcut& input) const;
 };
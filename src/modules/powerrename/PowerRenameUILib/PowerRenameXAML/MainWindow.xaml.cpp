@@ -7,11 +7,13 @@
 #include <settings.h>
 #include <trace.h>
 #include <Helpers.h>
+#include <BatchRenamer.h>
 
 #include <common/logger/call_tracer.h>
 #include <common/logger/logger.h>
 #include <common/utils/logger_helper.h>
 #include <common/utils/process_path.h>
+#include <common/utils/winapi_error.h>
 
 #include <common/Telemetry/EtwTrace/EtwTrace.h>
 
@@ -260,6 +262,8 @@ namespace winrt::PowerRenameUI::implementation
             });
         }
 #endif
+        RecoverRenameJournals();
+
         if (SUCCEEDED(CPowerRenameManager::s_CreateInstance(&m_prManager)))
         {
             g_prManager = m_prManager;
@@ -570,6 +574,27 @@ namespace winrt::PowerRenameUI::implementation
         return hr;
     }
 
+    void MainWindow::RecoverRenameJournals()
+    {
+        _TRACER_;
+
+        // Undo the renames of batches that were interrupted, before their items are enumerated again
+        for (const auto& journal : BatchRenamer::RecoverJournals(CPowerRenameManager::s_getRenameJournalFolder()))
+        {
+            if (SUCCEEDED(journal.result))
+            {
+                Logger::info(L"Rolled back the interrupted rename batch in {}", journal.path);
+                continue;
+            }
+
+            Logger::warn(L"Dropped the rename journal {}, {} renames could not be undone. {}", journal.path, journal.droppedSteps.size(), get_last_error_or_default(journal.result));
+            for (const auto& step : journal.droppedSteps)
+            {
+                Logger::warn(L"Not undone: {} -> {}", step.source, step.target);
+            }
+        }
+    }
+
     HRESULT MainWindow::EnumerateShellItems(_In_ IEnumShellItems* enumShellItems)
     {
         _TRACER_;
@@ -1367,6 +1392,22 @@ namespace winrt::PowerRenameUI::implementation
         return S_OK;
     }
 
+    HRESULT MainWindow::OnRenameIncomplete(_In_ HRESULT hr)
+    {
+        _TRACER_;
+
+        Logger::error(L"Renaming stopped with renames that could not be undone. {}", get_last_error_or_default(hr));
+
+        auto factory = winrt::get_activation_factory<ResourceManager, IResourceManagerFactory>();
+        ResourceManager manager = factory.CreateInstance(L"PowerToys.PowerRename.pri");
+        std::wstring message{ manager.MainResourceMap().GetValue(L"Resources/ErrorMessage_RenameIncomplete").ValueAsString() };
+        message += L"\n\n";
+        message += get_last_error_or_default(hr);
+        const std::wstring title{ manager.MainResourceMap().GetValue(L"Resources/ErrorMessage_RenameIncompleteTitle").ValueAsString() };
+        MessageBoxW(m_window, message.c_str(), title.c_str(), MB_OK | MB_ICONERROR);
+        return S_OK;
+    }
+
     HRESULT MainWindow::OnRenameCompleted(bool closeUIWindowAfterRenaming)
     {
         _TRACER_;
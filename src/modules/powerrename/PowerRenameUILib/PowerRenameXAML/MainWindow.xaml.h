@@ -69,6 +69,7 @@ namespace winrt::PowerRenameUI::implementation
             HRESULT OnRegExCanceled(_In_ DWORD threadId) override { return m_app->OnRegExCanceled(threadId); }
             HRESULT OnRegExCompleted(_In_ DWORD threadId) override { return m_app->OnRegExCompleted(threadId); }
             HRESULT OnRenameStarted() override { return m_app->OnRenameStarted(); }
+            HRESULT OnRenameIncomplete(_In_ HRESULT hr) override { return m_app->OnRenameIncomplete(hr); }
             HRESULT OnRenameCompleted(bool closeUIWindowAfterRenaming) override { return m_app->OnRenameCompleted(closeUIWindowAfterRenaming); }
 
         private:
@@ -123,6 +124,7 @@ namespace winrt::PowerRenameUI::implementation
         HRESULT OnRegExCanceled(_In_ DWORD) { return S_OK; }
         HRESULT OnRegExCompleted(_In_ DWORD threadId);
         HRESULT OnRenameStarted() { return S_OK; }
+        HRESULT OnRenameIncomplete(_In_ HRESULT hr);
         HRESULT OnRenameCompleted(bool closeUIWindowAfterRenaming);
 
         enum class UpdateFlagCommand
@@ -134,6 +136,7 @@ namespace winrt::PowerRenameUI::implementation
         HRESULT CreateShellItemArrayFromPaths(std::vector<std::wstring> files, IShellItemArray** shellItemArray);
 
         HRESULT InitAutoComplete();
+        void RecoverRenameJournals();
         HRESULT EnumerateShellItems(_In_ IEnumShellItems* enumShellItems);
         void SearchReplaceChanged(bool forceRenaming = false);
         void ValidateFlags(PowerRenameFlags flag);
@@ -285,6 +285,16 @@ public:
             GET_RESOURCE_STRING(IDS_USE_BOOST_LIB),
             CSettingsInstance().GetUseBoostLib());
 
+        settings.add_bool_toggle(
+            L"bool_persist_metadata_index",
+            GET_RESOURCE_STRING(IDS_PERSIST_METADATA_INDEX),
+            CSettingsInstance().GetPersistMetadataIndex());
+
+        settings.add_bool_toggle(
+            L"bool_use_parallel_rename",
+            GET_RESOURCE_STRING(IDS_USE_PARALLEL_RENAME),
+            CSettingsInstance().GetUseParallelRename());
+
         return settings.serialize_to_buffer(buffer, buffer_size);
     }
 
@@ -304,6 +314,8 @@ public:
             CSettingsInstance().SetShowIconOnMenu(values.get_bool_value(L"bool_show_icon_on_menu").value());
             CSettingsInstance().SetExtendedContextMenuOnly(values.get_bool_value(L"bool_show_extended_menu").value());
             CSettingsInstance().SetUseBoostLib(values.get_bool_value(L"bool_use_boost_lib").value());
+            CSettingsInstance().SetPersistMetadataIndex(values.get_bool_value(L"bool_persist_metadata_index").value_or(false));
+            CSettingsInstance().SetUseParallelRename(values.get_bool_value(L"bool_use_parallel_rename").value_or(false));
             CSettingsInstance().Save();
 
             Trace::SettingsChanged();
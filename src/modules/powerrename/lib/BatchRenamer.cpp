@@ -0,0 +1,570 @@
+#include "pch.h"
+#include "BatchRenamer.h"
+
+#include <atomic>
+
+namespace
+{
+    constexpr wchar_t JournalFieldSeparator = L'\t';
+    constexpr wchar_t JournalRecordSeparator = L'\n';
+    constexpr wchar_t JournalFilePrefix[] = L"power-rename-journal-";
+    constexpr wchar_t JournalRewriteSuffix[] = L".new";
+
+    // File systems compare names case insensitively, so paths are matched on an upper case copy
+    std::wstring FoldPath(const std::wstring& path)
+    {
+        std::wstring folded(path);
+        if (!path.empty())
+        {
+            LCMapStringEx(LOCALE_NAME_INVARIANT, LCMAP_UPPERCASE, path.c_str(), static_cast<int>(path.size()), folded.data(), static_cast<int>(folded.size()), nullptr, nullptr, 0);
+        }
+        return folded;
+    }
+
+    std::wstring MakeTemporaryPath(const std::wstring& folder)
+    {
+        static std::atomic<unsigned int> counter = 0;
+        return folder + L"~PowerRename-" + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(++counter) + L".tmp";
+    }
+
+    // Unique per batch, so batches of different PowerRename windows never share a journal
+    std::wstring MakeJournalPath(const std::wstring& folder)
+    {
+        static std::atomic<unsigned int> counter = 0;
+        return folder + L"\\" + JournalFilePrefix + std::to_wstring(GetCurrentProcessId()) + L"-" + std::to_wstring(GetTickCount64()) + L"-" + std::to_wstring(++counter);
+    }
+
+    // A record with an empty source cancels the latest step with that target, whose rename failed
+    void AppendRecord(std::wstring& records, const BatchRenamer::Step& step)
+    {
+        records += step.source;
+        records += JournalFieldSeparator;
+        records += step.target;
+        records += JournalRecordSeparator;
+    }
+
+    bool WriteAndFlush(HANDLE file, const std::wstring& records)
+    {
+        DWORD written = 0;
+        return WriteFile(file, records.data(), static_cast<DWORD>(records.size() * sizeof(wchar_t)), &written, nullptr) &&
+               written == records.size() * sizeof(wchar_t) &&
+               FlushFileBuffers(file);
+    }
+
+    bool PathExists(const std::wstring& path)
+    {
+        return GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES;
+    }
+
+    // Steps about to run, kept in memory for the rollback and appended to the journal file before
+    // the rename, so an interrupted batch can still be undone later. Steps that are recorded but
+    // never ran are recognized by their source still existing and skipped by the rollback.
+    class Journal
+    {
+    public:
+        explicit Journal(const std::wstring& path) :
+            m_path(path)
+        {
+            if (!m_path.empty())
+            {
+                // Kept open for writing while the batch runs, which tells RecoverJournals that
+                // the journal is still in use
+                m_file = CreateFileW(m_path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+            }
+        }
+
+        ~Journal()
+        {
+            Close();
+        }
+
+        bool IsOpen() const
+        {
+            return m_path.empty() || m_file != INVALID_HANDLE_VALUE;
+        }
+
+        // Fails if the step could not be made durable, in which case it must not run
+        bool Record(const BatchRenamer::Step& step)
+        {
+            std::scoped_lock lock(m_mutex);
+            if (m_file != INVALID_HANDLE_VALUE)
+            {
+                std::wstring record;
+                AppendRecord(record, step);
+                if (!WriteAndFlush(m_file, record))
+                {
+                    return false;
+                }
+            }
+            m_steps.push_back(step);
+            return true;
+        }
+
+        // The rename of a recorded step failed. If the target was taken by another file, undoing
+        // the step would move that file, so the step is dropped.
+        void Cancel(const BatchRenamer::Step& step)
+        {
+            std::scoped_lock lock(m_mutex);
+            for (auto it = m_steps.rbegin(); it != m_steps.rend(); ++it)
+            {
+                if (it->target == step.target)
+                {
+                    m_steps.erase(std::next(it).base());
+                    break;
+                }
+            }
+
+            if (m_file != INVALID_HANDLE_VALUE)
+            {
+                std::wstring record;
+                AppendRecord(record, { std::wstring{}, step.target });
+                WriteAndFlush(m_file, record);
+            }
+        }
+
+        const std::vector<BatchRenamer::Step>& Steps() const
+        {
+            return m_steps;
+        }
+
+        // The batch is either complete or fully undone, the journal is no longer needed
+        void Discard()
+        {
+            Close();
+            if (!m_path.empty())
+            {
+                DeleteFileW(m_path.c_str());
+            }
+        }
+
+        void Close()
+        {
+            if (m_file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(m_file);
+                m_file = INVALID_HANDLE_VALUE;
+            }
+        }
+
+    private:
+        std::wstring m_path;
+        HANDLE m_file = INVALID_HANDLE_VALUE;
+        std::mutex m_mutex;
+        std::vector<BatchRenamer::Step> m_steps;
+    };
+}
+
+BatchRenamer::BatchRenamer(std::wstring journalFolder) :
+    m_journalFolder(std::move(journalFolder))
+{
+}
+
+HRESULT BatchRenamer::BuildPlan(const std::vector<Operation>& operations, std::vector<Level>& plan)
+{
+    plan.clear();
+
+    struct Rename
+    {
+        std::wstring source;
+        std::wstring target;
+        std::wstring folder;
+        size_t depth = 0;
+    };
+
+    std::vector<Rename> renames;
+    std::unordered_map<std::wstring, size_t> bySource;
+    std::unordered_map<std::wstring, size_t> byTarget;
+    renames.reserve(operations.size());
+
+    for (const auto& operation : operations)
+    {
+        const size_t separator = operation.path.find_last_of(L'\\');
+        if (separator == std::wstring::npos || operation.newName.empty() || operation.newName.find(L'\\') != std::wstring::npos)
+        {
+            return E_INVALIDARG;
+        }
+
+        Rename rename;
+        rename.source = operation.path;
+        rename.folder = operation.path.substr(0, separator + 1);
+        rename.target = rename.folder + operation.newName;
+        rename.depth = std::count(operation.path.begin(), operation.path.end(), L'\\');
+
+        if (rename.target == rename.source)
+        {
+            continue;
+        }
+
+        const size_t index = renames.size();
+        if (!bySource.emplace(FoldPath(rename.source), index).second)
+        {
+            // The same item is listed twice
+            return E_INVALIDARG;
+        }
+        if (!byTarget.emplace(FoldPath(rename.target), index).second)
+        {
+            return HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS);
+        }
+        renames.push_back(std::move(rename));
+    }
+
+    // Deepest items first, then grouped by folder
+    std::vector<size_t> order(renames.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), [&renames](size_t left, size_t right) {
+        if (renames[left].depth != renames[right].depth)
+        {
+            return renames[left].depth > renames[right].depth;
+        }
+        return renames[left].folder < renames[right].folder;
+    });
+
+    // blocker[i] is the rename whose source is the target of rename i, which has to move first.
+    // waiter is the reverse. Sources and targets are unique, so the renames form chains and cycles.
+    constexpr size_t none = SIZE_MAX;
+    std::vector<size_t> blocker(renames.size(), none);
+    std::vector<size_t> waiter(renames.size(), none);
+    for (size_t i = 0; i < renames.size(); i++)
+    {
+        const auto it = bySource.find(FoldPath(renames[i].target));
+        if (it != bySource.end() && it->second != i)
+        {
+            blocker[i] = it->second;
+            waiter[it->second] = i;
+        }
+    }
+
+    std::vector<bool> planned(renames.size(), false);
+    size_t groupStart = 0;
+    while (groupStart < order.size())
+    {
+        const size_t depth = renames[order[groupStart]].depth;
+        size_t groupEnd = groupStart;
+        while (groupEnd < order.size() && renames[order[groupEnd]].depth == depth)
+        {
+            groupEnd++;
+        }
+
+        Level level;
+
+        // Chains start with a rename whose target is free
+        for (size_t i = groupStart; i < groupEnd; i++)
+        {
+            if (blocker[order[i]] != none)
+            {
+                continue;
+            }
+
+            Sequence sequence;
+            for (size_t current = order[i]; current != none; current = waiter[current])
+            {
+                sequence.push_back({ renames[current].source, renames[current].target });
+                planned[current] = true;
+            }
+            level.push_back(std::move(sequence));
+        }
+
+        // What is left are cycles such as a -> b, b -> a. One item of the cycle moves to a
+        // temporary name first, which frees the target of the item before it.
+        for (size_t i = groupStart; i < groupEnd; i++)
+        {
+            const size_t first = order[i];
+            if (planned[first])
+            {
+                continue;
+            }
+
+            const std::wstring temporaryPath = MakeTemporaryPath(renames[first].folder);
+            Sequence sequence;
+            sequence.push_back({ renames[first].source, temporaryPath });
+            planned[first] = true;
+
+            for (size_t current = waiter[first]; current != first && current != none; current = waiter[current])
+            {
+                sequence.push_back({ renames[current].source, renames[current].target });
+                planned[current] = true;
+            }
+
+            sequence.push_back({ temporaryPath, renames[first].target });
+            level.push_back(std::move(sequence));
+        }
+
+        plan.push_back(std::move(level));
+        groupStart = groupEnd;
+    }
+
+    return S_OK;
+}
+
+HRESULT BatchRenamer::Execute(const std::vector<Operation>& operations, Outcome* outcome)
+{
+    Outcome unused = Outcome::Unchanged;
+    Outcome& result = outcome ? *outcome : unused;
+    result = Outcome::Unchanged;
+
+    std::vector<Level> plan;
+    HRESULT hr = BuildPlan(operations, plan);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    const std::wstring journalPath = m_journalFolder.empty() ? std::wstring{} : MakeJournalPath(m_journalFolder);
+    Journal journal(journalPath);
+    if (!journal.IsOpen())
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    std::atomic<bool> failed = false;
+    std::atomic<HRESULT> firstError = S_OK;
+
+    for (const auto& level : plan)
+    {
+        std::for_each(std::execution::par, level.begin(), level.end(), [&](const Sequence& sequence) {
+            for (const auto& step : sequence)
+            {
+                if (failed)
+                {
+                    return;
+                }
+
+                DWORD error = ERROR_SUCCESS;
+                if (!journal.Record(step))
+                {
+                    error = GetLastError();
+                    error = error != ERROR_SUCCESS ? error : ERROR_WRITE_FAULT;
+                }
+                else if (!MoveFileExW(step.source.c_str(), step.target.c_str(), 0))
+                {
+                    error = GetLastError();
+                    journal.Cancel(step);
+                }
+
+                if (error != ERROR_SUCCESS)
+                {
+                    HRESULT expected = S_OK;
+                    firstError.compare_exchange_strong(expected, HRESULT_FROM_WIN32(error));
+                    failed = true;
+                    return;
+                }
+            }
+        });
+
+        if (failed)
+        {
+            break;
+        }
+    }
+
+    if (failed)
+    {
+        hr = firstError;
+        std::vector<Step> remainingSteps;
+        if (FAILED(s_undoSteps(journal.Steps(), remainingSteps)))
+        {
+            // Keep what is left in the journal, RecoverJournals tries again the next time
+            journal.Close();
+            if (!journalPath.empty())
+            {
+                s_rewriteJournal(journalPath, remainingSteps);
+            }
+            result = Outcome::Incomplete;
+            return hr;
+        }
+    }
+
+    journal.Discard();
+    result = failed ? Outcome::Unchanged : Outcome::Renamed;
+    return hr;
+}
+
+HRESULT BatchRenamer::RollBack(const std::wstring& journalPath, std::vector<Step>* remainingSteps)
+{
+    std::wstring content;
+    {
+        // Not sharing write access fails while the batch of the journal still has it open
+        HANDLE file = CreateFileW(journalPath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return HRESULT_FROM_WIN32(GetLastError());
+        }
+
+        LARGE_INTEGER size{};
+        bool read = false;
+        if (GetFileSizeEx(file, &size) && size.QuadPart < MAXDWORD)
+        {
+            content.resize(static_cast<size_t>(size.QuadPart) / sizeof(wchar_t));
+            DWORD bytesRead = 0;
+            read = ReadFile(file, content.data(), static_cast<DWORD>(content.size() * sizeof(wchar_t)), &bytesRead, nullptr) &&
+                   bytesRead == content.size() * sizeof(wchar_t);
+        }
+        CloseHandle(file);
+
+        if (!read)
+        {
+            return E_FAIL;
+        }
+    }
+
+    // An interrupted write leaves a partial last record, which is skipped
+    std::vector<Step> steps;
+    size_t position = 0;
+    while (position < content.size())
+    {
+        const size_t end = content.find(JournalRecordSeparator, position);
+        if (end == std::wstring::npos)
+        {
+            break;
+        }
+
+        const size_t separator = content.find(JournalFieldSeparator, position);
+        if (separator == std::wstring::npos || separator > end)
+        {
+            return E_FAIL;
+        }
+
+        Step step{ content.substr(position, separator - position), content.substr(separator + 1, end - separator - 1) };
+        position = end + 1;
+
+        if (!step.source.empty())
+        {
+            steps.push_back(std::move(step));
+            continue;
+        }
+
+        const auto cancelled = std::find_if(steps.rbegin(), steps.rend(), [&step](const Step& recorded) { return recorded.target == step.target; });
+        if (cancelled != steps.rend())
+        {
+            steps.erase(std::next(cancelled).base());
+        }
+    }
+
+    std::vector<Step> leftSteps;
+    HRESULT hr = s_undoSteps(steps, leftSteps);
+    if (SUCCEEDED(hr))
+    {
+        DeleteFileW(journalPath.c_str());
+    }
+    else
+    {
+        s_rewriteJournal(journalPath, leftSteps);
+    }
+
+    if (remainingSteps)
+    {
+        *remainingSteps = std::move(leftSteps);
+    }
+    return hr;
+}
+
+std::vector<BatchRenamer::RecoveredJournal> BatchRenamer::RecoverJournals(const std::wstring& journalFolder)
+{
+    std::vector<RecoveredJournal> recovered;
+
+    std::vector<std::wstring> journalPaths;
+    WIN32_FIND_DATAW findData{};
+    HANDLE find = FindFirstFileW((journalFolder + L"\\" + JournalFilePrefix + L"*").c_str(), &findData);
+    if (find == INVALID_HANDLE_VALUE)
+    {
+        return recovered;
+    }
+    do
+    {
+        if (!(findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+        {
+            journalPaths.push_back(journalFolder + L"\\" + findData.cFileName);
+        }
+    } while (FindNextFileW(find, &findData));
+    FindClose(find);
+
+    for (const auto& journalPath : journalPaths)
+    {
+        if (journalPath.ends_with(JournalRewriteSuffix))
+        {
+            // A rewrite that was interrupted before it replaced its journal, which is still
+            // complete. Fails harmlessly while the rewrite is still running.
+            DeleteFileW(journalPath.c_str());
+            continue;
+        }
+
+        RecoveredJournal journal{ journalPath };
+        journal.result = RollBack(journalPath, &journal.droppedSteps);
+        if (journal.result == HRESULT_FROM_WIN32(ERROR_SHARING_VIOLATION))
+        {
+            // The batch is still running in another PowerRename window
+            continue;
+        }
+
+        if (FAILED(journal.result))
+        {
+            // The files were moved, deleted or taken again since, so the steps can't ever be
+            // undone. Keeping the journal would only retry them forever.
+            DeleteFileW(journalPath.c_str());
+        }
+        recovered.push_back(std::move(journal));
+    }
+
+    return recovered;
+}
+
+HRESULT BatchRenamer::s_undoSteps(const std::vector<Step>& steps, std::vector<Step>& remainingSteps)
+{
+    // Undo everything that can be undone, but report the first failure
+    HRESULT hr = S_OK;
+    remainingSteps.clear();
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it)
+    {
+        if (MoveFileExW(it->target.c_str(), it->source.c_str(), 0))
+        {
+            continue;
+        }
+
+        const DWORD error = GetLastError();
+
+        // Undone by an earlier rollback that was interrupted
+        if (!PathExists(it->target) && PathExists(it->source))
+        {
+            continue;
+        }
+
+        if (SUCCEEDED(hr))
+        {
+            hr = HRESULT_FROM_WIN32(error);
+        }
+        remainingSteps.push_back(*it);
+    }
+
+    std::reverse(remainingSteps.begin(), remainingSteps.end());
+    return hr;
+}
+
+HRESULT BatchRenamer::s_rewriteJournal(const std::wstring& journalPath, const std::vector<Step>& steps)
+{
+    // Written next to the journal and moved over it, so a crash leaves either journal complete
+    const std::wstring newJournalPath = journalPath + L".new";
+    HANDLE file = CreateFileW(newJournalPath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    std::wstring records;
+    for (const auto& step : steps)
+    {
+        AppendRecord(records, step);
+    }
+    const bool written = WriteAndFlush(file, records);
+    CloseHandle(file);
+
+    if (!written || !MoveFileExW(newJournalPath.c_str(), journalPath.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        DeleteFileW(newJournalPath.c_str());
+        return FAILED(hr) ? hr : E_FAIL;
+    }
+    return S_OK;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "pch.h"
+
+#include <string>
+#include <vector>
+
+// Renames a batch of files and folders with MoveFileExW instead of a shell file operation.
+// Items are renamed deepest first, so the paths of the items still to be renamed stay valid.
+// Renames that swap or rotate names inside a folder go through a temporary name, and renames
+// that don't depend on each other run in parallel. Each step is recorded in an undo journal
+// before it runs, and if a step fails the steps already done are undone, most recent first.
+// Every batch has its own journal, so several PowerRename windows can rename at the same time.
+class BatchRenamer
+{
+public:
+    struct Operation
+    {
+        // Full path of the item before the batch starts
+        std::wstring path;
+        // New name of the item, without its folder
+        std::wstring newName;
+    };
+
+    struct Step
+    {
+        std::wstring source;
+        std::wstring target;
+    };
+
+    // The steps of a sequence depend on each other and run in order. The sequences of a level are
+    // independent of each other. Levels run one after the other, deepest items first.
+    using Sequence = std::vector<Step>;
+    using Level = std::vector<Sequence>;
+
+    // State of the disk after Execute
+    enum class Outcome
+    {
+        // Every item has its new name
+        Renamed,
+        // No item was renamed, or every rename was undone. The batch can be retried another way.
+        Unchanged,
+        // Some renames of this batch could not be undone. They stay in the journal for
+        // RecoverJournals, and nothing else should touch the items.
+        Incomplete,
+    };
+
+    // Journal left behind by a batch that was interrupted or could not be undone
+    struct RecoveredJournal
+    {
+        std::wstring path;
+        // S_OK if every step was undone. Otherwise the error of the first step that could not be
+        // undone, and the journal was deleted anyway so it can't get in the way of later batches.
+        HRESULT result = S_OK;
+        std::vector<Step> droppedSteps;
+    };
+
+    // The journals are kept in journalFolder. An empty folder keeps the journal in memory only.
+    explicit BatchRenamer(std::wstring journalFolder);
+
+    // Orders the renames of a batch. Fails without touching the disk if two items would end up
+    // with the same path.
+    static HRESULT BuildPlan(const std::vector<Operation>& operations, std::vector<Level>& plan);
+
+    // Renames every item or none of them. If a step fails, the completed steps are undone and
+    // the error of the failed step is returned. outcome tells whether the disk was left unchanged.
+    HRESULT Execute(const std::vector<Operation>& operations, Outcome* outcome = nullptr);
+
+    // Undoes the steps recorded in a journal, most recent first, and deletes the journal if all
+    // of them could be undone. Otherwise the journal keeps the steps that are left, which are
+    // also returned in remainingSteps. Fails with ERROR_SHARING_VIOLATION while the batch that
+    // writes the journal is still running.
+    static HRESULT RollBack(const std::wstring& journalPath, std::vector<Step>* remainingSteps = nullptr);
+
+    // Rolls back the journals that earlier batches left in journalFolder, except those of
+    // batches that are still running. Meant to run once when PowerRename starts.
+    static std::vector<RecoveredJournal> RecoverJournals(const std::wstring& journalFolder);
+
+private:
+    // Steps that could not be undone are returned in remainingSteps, in journal order
+    static HRESULT s_undoSteps(const std::vector<Step>& steps, std::vector<Step>& remainingSteps);
+    static HRESULT s_rewriteJournal(const std::wstring& journalPath, const std::vector<Step>& steps);
+
+    std::wstring m_journalFolder;
+};
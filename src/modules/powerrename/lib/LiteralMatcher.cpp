@@ -0,0 +1,213 @@
+#include "pch.h"
+#include "LiteralMatcher.h"
+
+#include <bit>
+#include <cwctype>
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define LITERAL_MATCHER_SSE2
+#elif defined(_M_ARM64)
+#include <arm_neon.h>
+#define LITERAL_MATCHER_NEON
+#endif
+
+#if defined(LITERAL_MATCHER_SSE2) || defined(LITERAL_MATCHER_NEON)
+static_assert(sizeof(wchar_t) == sizeof(uint16_t), "The vectorized paths process UTF-16 code units");
+#endif
+
+namespace
+{
+    // Number of UTF-16 code units processed per vector
+    constexpr size_t VectorWidth = 8;
+
+    inline wchar_t FoldChar(wchar_t c)
+    {
+        if (c < 0x80)
+        {
+            return (c >= L'A' && c <= L'Z') ? static_cast<wchar_t>(c | 0x20) : c;
+        }
+        return static_cast<wchar_t>(::towlower(c));
+    }
+
+    // Folds VectorWidth code units. Returns false when the block holds non-ASCII characters,
+    // which the caller then folds one by one.
+    inline bool FoldAsciiBlock(const wchar_t* source, wchar_t* folded)
+    {
+#if defined(LITERAL_MATCHER_SSE2)
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source));
+        const __m128i nonAscii = _mm_and_si128(block, _mm_set1_epi16(static_cast<short>(0xFF80)));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi16(nonAscii, _mm_setzero_si128())) != 0xFFFF)
+        {
+            return false;
+        }
+
+        // All lanes are below 0x80, so signed comparisons are safe
+        const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi16(block, _mm_set1_epi16(L'A' - 1)),
+                                              _mm_cmplt_epi16(block, _mm_set1_epi16(L'Z' + 1)));
+        const __m128i lowered = _mm_or_si128(block, _mm_and_si128(isUpper, _mm_set1_epi16(0x20)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(folded), lowered);
+        return true;
+#elif defined(LITERAL_MATCHER_NEON)
+        const uint16x8_t block = vld1q_u16(reinterpret_cast<const uint16_t*>(source));
+        if (vmaxvq_u16(block) >= 0x80)
+        {
+            return false;
+        }
+
+        const uint16x8_t isUpper = vandq_u16(vcgeq_u16(block, vdupq_n_u16(L'A')), vcleq_u16(block, vdupq_n_u16(L'Z')));
+        const uint16x8_t lowered = vorrq_u16(block, vandq_u16(isUpper, vdupq_n_u16(0x20)));
+        vst1q_u16(reinterpret_cast<uint16_t*>(folded), lowered);
+        return true;
+#else
+        for (size_t i = 0; i < VectorWidth; i++)
+        {
+            if (source[i] >= 0x80)
+            {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < VectorWidth; i++)
+        {
+            folded[i] = FoldChar(source[i]);
+        }
+        return true;
+#endif
+    }
+
+    // Bit mask of the lanes of haystack[pos, pos + VectorWidth) equal to c. Lane i owns the bits
+    // starting at i * LaneBits.
+#if defined(LITERAL_MATCHER_SSE2)
+    constexpr unsigned LaneBits = 2;
+
+    inline uint64_t EqualLanes(const wchar_t* haystack, wchar_t c)
+    {
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(haystack));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi16(block, _mm_set1_epi16(static_cast<short>(c)))));
+    }
+#elif defined(LITERAL_MATCHER_NEON)
+    constexpr unsigned LaneBits = 8;
+
+    inline uint64_t EqualLanes(const wchar_t* haystack, wchar_t c)
+    {
+        const uint16x8_t block = vld1q_u16(reinterpret_cast<const uint16_t*>(haystack));
+        const uint16x8_t equal = vceqq_u16(block, vdupq_n_u16(static_cast<uint16_t>(c)));
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(equal, 4)), 0);
+    }
+#endif
+}
+
+LiteralMatcher::LiteralMatcher(std::wstring_view needle, bool caseInsensitive) :
+    m_caseInsensitive(caseInsensitive)
+{
+    if (caseInsensitive)
+    {
+        FoldCase(needle, m_needle);
+    }
+    else
+    {
+        m_needle = needle;
+    }
+}
+
+void LiteralMatcher::FoldCase(std::wstring_view source, std::wstring& folded)
+{
+    folded.resize(source.size());
+
+    size_t i = 0;
+    for (; i + VectorWidth <= source.size(); i += VectorWidth)
+    {
+        if (!FoldAsciiBlock(source.data() + i, folded.data() + i))
+        {
+            for (size_t j = i; j < i + VectorWidth; j++)
+            {
+                folded[j] = FoldChar(source[j]);
+            }
+        }
+    }
+
+    for (; i < source.size(); i++)
+    {
+        folded[i] = FoldChar(source[i]);
+    }
+}
+
+size_t LiteralMatcher::Find(std::wstring_view haystack, size_t pos) const
+{
+    const size_t needleLength = m_needle.size();
+    if (needleLength == 0 || haystack.size() < needleLength || pos > haystack.size() - needleLength)
+    {
+        return std::wstring::npos;
+    }
+
+    const size_t lastStart = haystack.size() - needleLength;
+    const wchar_t first = m_needle[0];
+    const wchar_t* data = haystack.data();
+
+    size_t i = pos;
+#if defined(LITERAL_MATCHER_SSE2) || defined(LITERAL_MATCHER_NEON)
+    // Look for candidates by their first character, a vector at a time, and verify each one.
+    for (; i + VectorWidth <= haystack.size() && i <= lastStart; i += VectorWidth)
+    {
+        uint64_t candidates = EqualLanes(data + i, first);
+        while (candidates)
+        {
+            const size_t candidate = i + std::countr_zero(candidates) / LaneBits;
+            if (candidate > lastStart)
+            {
+                return std::wstring::npos;
+            }
+            if (wmemcmp(data + candidate + 1, m_needle.data() + 1, needleLength - 1) == 0)
+            {
+                return candidate;
+            }
+
+            // Clear the bits of this lane
+            candidates &= ~(((uint64_t{ 1 } << LaneBits) - 1) << ((candidate - i) * LaneBits));
+        }
+    }
+#endif
+
+    for (; i <= lastStart; i++)
+    {
+        if (data[i] == first && wmemcmp(data + i + 1, m_needle.data() + 1, needleLength - 1) == 0)
+        {
+            return i;
+        }
+    }
+
+    return std::wstring::npos;
+}
+
+bool LiteralMatcher::Replace(const std::wstring& source, const std::wstring& replaceTerm, bool matchAll, std::wstring& result) const
+{
+    std::wstring_view haystack = source;
+
+    // Reused across calls to avoid an allocation per name
+    thread_local std::wstring folded;
+    if (m_caseInsensitive)
+    {
+        FoldCase(source, folded);
+        haystack = folded;
+    }
+
+    result.clear();
+
+    bool matched = false;
+    size_t copied = 0;
+    for (size_t pos = Find(haystack, 0); pos != std::wstring::npos; pos = Find(haystack, copied))
+    {
+        matched = true;
+        result.append(source, copied, pos - copied);
+        result.append(replaceTerm);
+        copied = pos + m_needle.size();
+
+        if (!matchAll)
+        {
+            break;
+        }
+    }
+    result.append(source, copied, std::wstring::npos);
+
+    return matched;
+}
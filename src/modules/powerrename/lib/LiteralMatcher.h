@@ -0,0 +1,30 @@
+#pragma once
+
+#include "pch.h"
+
+#include <string>
+#include <string_view>
+
+// Plain text search used when regular expressions are off. For case insensitive searches the
+// needle is folded once per search term, and each name is folded in a single pass with a
+// vectorized fast path for ASCII text. Other characters are folded with towlower.
+class LiteralMatcher
+{
+public:
+    LiteralMatcher() = default;
+    LiteralMatcher(std::wstring_view needle, bool caseInsensitive);
+
+    // Replaces the first or every non-overlapping occurrence of the needle in source.
+    // Returns whether the needle was found.
+    bool Replace(const std::wstring& source, const std::wstring& replaceTerm, bool matchAll, std::wstring& result) const;
+
+    // Returns the position of the needle in haystack at or after pos, or npos. A case insensitive
+    // matcher expects haystack to be folded with FoldCase already.
+    size_t Find(std::wstring_view haystack, size_t pos) const;
+
+    static void FoldCase(std::wstring_view source, std::wstring& folded);
+
+private:
+    std::wstring m_needle;
+    bool m_caseInsensitive = false;
+};
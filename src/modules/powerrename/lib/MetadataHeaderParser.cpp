@@ -0,0 +1,1837 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#include "pch.h"
+#include "MetadataHeaderParser.h"
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+using namespace PowerRenameLib;
+
+// Container layouts:
+// JPEG  - https://www.w3.org/Graphics/JPEG/itu-t81.pdf (markers), EXIF 2.32 section 4.5.4 (APP1)
+// TIFF  - https://www.itu.int/itudoc/itu-t/com16/tiff-fx/docs/tiff6.pdf
+// HEIF  - ISO/IEC 14496-12 (boxes) and ISO/IEC 23008-12 (items), also used by AVIF
+// XMP   - https://github.com/adobe/XMP-Toolkit-SDK/blob/main/docs/XMPSpecificationPart3.pdf
+
+namespace
+{
+    constexpr size_t BlockSize = 16 * 1024;
+    // Larger reads bypass the block cache
+    constexpr size_t MaxCachedReadSize = BlockSize / 2;
+    constexpr size_t BlockAlignment = 4096;
+
+    // Upper bounds that keep damaged files from causing huge allocations or long walks
+    constexpr uint64_t MaxXMPPacketSize = 4 * 1024 * 1024;
+    constexpr uint64_t MaxMetaBoxSize = 4 * 1024 * 1024;
+    constexpr uint32_t MaxIFDEntries = 1024;
+    constexpr uint32_t MaxStringSize = 64 * 1024;
+    constexpr size_t MaxJPEGSegments = 1024;
+    constexpr size_t MaxXMLDepth = 64;
+    constexpr size_t MaxXMPSubjects = 50;
+
+    // TIFF tags
+    constexpr uint16_t TagMake = 271;
+    constexpr uint16_t TagModel = 272;
+    constexpr uint16_t TagOrientation = 274;
+    constexpr uint16_t TagDateTime = 306;
+    constexpr uint16_t TagArtist = 315;
+    constexpr uint16_t TagXMP = 700;
+    constexpr uint16_t TagCopyright = 33432;
+    constexpr uint16_t TagExifIFD = 34665;
+    constexpr uint16_t TagGPSIFD = 34853;
+
+    // Exif IFD tags
+    constexpr uint16_t TagExposureTime = 33434;
+    constexpr uint16_t TagFNumber = 33437;
+    constexpr uint16_t TagISOSpeed = 34855;
+    constexpr uint16_t TagDateTimeOriginal = 36867;
+    constexpr uint16_t TagDateTimeDigitized = 36868;
+    constexpr uint16_t TagExposureBias = 37380;
+    constexpr uint16_t TagFlash = 37385;
+    constexpr uint16_t TagFocalLength = 37386;
+    constexpr uint16_t TagColorSpace = 40961;
+    constexpr uint16_t TagPixelXDimension = 40962;
+    constexpr uint16_t TagPixelYDimension = 40963;
+    constexpr uint16_t TagLensModel = 42036;
+
+    // GPS IFD tags
+    constexpr uint16_t TagGPSLatitudeRef = 1;
+    constexpr uint16_t TagGPSLatitude = 2;
+    constexpr uint16_t TagGPSLongitudeRef = 3;
+    constexpr uint16_t TagGPSLongitude = 4;
+    constexpr uint16_t TagGPSAltitude = 6;
+
+    // TIFF field types
+    enum FieldType : uint16_t
+    {
+        Byte = 1,
+        Ascii = 2,
+        Short = 3,
+        Long = 4,
+        Rational = 5,
+        SByte = 6,
+        Undefined = 7,
+        SShort = 8,
+        SLong = 9,
+        SRational = 10,
+        Float = 11,
+        Double = 12,
+        IFD = 13,
+    };
+
+    uint32_t FieldTypeSize(uint16_t type)
+    {
+        switch (type)
+        {
+        case Byte:
+        case Ascii:
+        case SByte:
+        case Undefined:
+            return 1;
+        case Short:
+        case SShort:
+            return 2;
+        case Long:
+        case SLong:
+        case Float:
+        case IFD:
+            return 4;
+        case Rational:
+        case SRational:
+        case Double:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    // XMP namespaces
+    constexpr std::string_view NsRDF = "http://www.w3.org/1999/02/22-rdf-syntax-ns#";
+    constexpr std::string_view NsXMP = "http://ns.adobe.com/xap/1.0/";
+    constexpr std::string_view NsDC = "http://purl.org/dc/elements/1.1/";
+    constexpr std::string_view NsXMPRights = "http://ns.adobe.com/xap/1.0/rights/";
+    constexpr std::string_view NsXMPMM = "http://ns.adobe.com/xap/1.0/mm/";
+    constexpr std::string_view NsXML = "http://www.w3.org/XML/1998/namespace";
+
+    // APP1 segment signatures
+    constexpr char ExifSignature[] = { 'E', 'x', 'i', 'f', 0, 0 };
+    constexpr char XMPSignature[] = "http://ns.adobe.com/xap/1.0/"; // Including the terminating null
+
+    uint16_t ReadBigEndian16(const uint8_t* bytes)
+    {
+        return static_cast<uint16_t>((bytes[0] << 8) | bytes[1]);
+    }
+
+    uint32_t ReadBigEndian32(const uint8_t* bytes)
+    {
+        return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+               (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+    }
+
+    uint64_t ReadBigEndian64(const uint8_t* bytes)
+    {
+        return (static_cast<uint64_t>(ReadBigEndian32(bytes)) << 32) | ReadBigEndian32(bytes + 4);
+    }
+
+    uint32_t MakeFourCC(const char (&code)[5])
+    {
+        return ReadBigEndian32(reinterpret_cast<const uint8_t*>(code));
+    }
+
+    // Decodes UTF-8, replacing invalid sequences with U+FFFD like MultiByteToWideChar does
+    std::wstring Utf8ToWide(std::string_view text)
+    {
+        std::wstring result;
+        result.reserve(text.size());
+
+        size_t i = 0;
+        while (i < text.size())
+        {
+            const uint8_t lead = static_cast<uint8_t>(text[i]);
+            uint32_t codePoint = 0;
+            size_t length = 0;
+            uint32_t minimum = 0;
+
+            if (lead < 0x80)
+            {
+                result.push_back(static_cast<wchar_t>(lead));
+                ++i;
+                continue;
+            }
+            else if ((lead & 0xE0) == 0xC0)
+            {
+                codePoint = lead & 0x1F;
+                length = 2;
+                minimum = 0x80;
+            }
+            else if ((lead & 0xF0) == 0xE0)
+            {
+                codePoint = lead & 0x0F;
+                length = 3;
+                minimum = 0x800;
+            }
+            else if ((lead & 0xF8) == 0xF0)
+            {
+                codePoint = lead & 0x07;
+                length = 4;
+                minimum = 0x10000;
+            }
+
+            bool valid = length != 0 && i + length <= text.size();
+            for (size_t j = 1; valid && j < length; ++j)
+            {
+                const uint8_t continuation = static_cast<uint8_t>(text[i + j]);
+                valid = (continuation & 0xC0) == 0x80;
+                codePoint = (codePoint << 6) | (continuation & 0x3F);
+            }
+            valid = valid && codePoint >= minimum && codePoint <= 0x10FFFF && (codePoint < 0xD800 || codePoint > 0xDFFF);
+
+            if (!valid)
+            {
+                result.push_back(L'\xFFFD');
+                ++i;
+                continue;
+            }
+
+            if (codePoint >= 0x10000)
+            {
+                codePoint -= 0x10000;
+                result.push_back(static_cast<wchar_t>(0xD800 + (codePoint >> 10)));
+                result.push_back(static_cast<wchar_t>(0xDC00 + (codePoint & 0x3FF)));
+            }
+            else
+            {
+                result.push_back(static_cast<wchar_t>(codePoint));
+            }
+            i += length;
+        }
+
+        return result;
+    }
+
+    void AppendUtf8(std::string& text, uint32_t codePoint)
+    {
+        if (codePoint < 0x80)
+        {
+            text.push_back(static_cast<char>(codePoint));
+        }
+        else if (codePoint < 0x800)
+        {
+            text.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+            text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else if (codePoint < 0x10000)
+        {
+            text.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+            text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+        else
+        {
+            text.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+            text.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+            text.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+        }
+    }
+
+    // Same trimming and empty handling as WICMetadataExtractor::ReadString
+    std::optional<std::wstring> MakeString(std::string_view utf8)
+    {
+        const size_t start = utf8.find_first_not_of(" \t\r\n");
+        if (start == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        const size_t end = utf8.find_last_not_of(" \t\r\n");
+        return Utf8ToWide(utf8.substr(start, end - start + 1));
+    }
+
+    std::optional<SYSTEMTIME> MakeDate(std::string_view utf8, const MetadataHeaderParser::DateParser& parseDate)
+    {
+        if (utf8.empty() || !parseDate)
+        {
+            return std::nullopt;
+        }
+        return parseDate(Utf8ToWide(utf8));
+    }
+
+    /// <summary>
+    /// Reads tags from a TIFF structure (a TIFF file or an EXIF block) through the parser's
+    /// cached reads. Offsets in the structure are relative to its start and are checked against
+    /// its size before anything is read.
+    /// </summary>
+    class TiffReader
+    {
+    public:
+        using ReadFunction = std::function<bool(uint64_t offset, void* buffer, size_t size)>;
+
+        struct Entry
+        {
+            uint16_t tag = 0;
+            uint16_t type = 0;
+            uint32_t count = 0;
+            // Position of the value data relative to the start of the TIFF structure
+            uint64_t valueOffset = 0;
+        };
+
+        using Directory = std::vector<Entry>;
+
+        TiffReader(ReadFunction read, uint64_t start, uint64_t size) :
+            read(std::move(read)), start(start), size(size)
+        {
+        }
+
+        // Reads the header and returns the offset of the first directory
+        bool ReadHeader(uint32_t& firstDirectory)
+        {
+            uint8_t header[8];
+            if (!ReadAt(0, header, sizeof(header)))
+            {
+                return false;
+            }
+
+            if (header[0] == 'I' && header[1] == 'I')
+            {
+                littleEndian = true;
+            }
+            else if (header[0] == 'M' && header[1] == 'M')
+            {
+                littleEndian = false;
+            }
+            else
+            {
+                return false;
+            }
+
+            if (To16(header + 2) != 42)
+            {
+                return false;
+            }
+
+            firstDirectory = To32(header + 4);
+            return true;
+        }
+
+        bool ReadDirectory(uint64_t offset, Directory& directory)
+        {
+            directory.clear();
+
+            uint8_t countBytes[2];
+            if (!ReadAt(offset, countBytes, sizeof(countBytes)))
+            {
+                return false;
+            }
+
+            const uint32_t count = To16(countBytes);
+            if (count > MaxIFDEntries)
+            {
+                return false;
+            }
+
+            std::vector<uint8_t> entries(static_cast<size_t>(count) * 12);
+            if (!ReadAt(offset + 2, entries.data(), entries.size()))
+            {
+                return false;
+            }
+
+            directory.reserve(count);
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint8_t* bytes = entries.data() + static_cast<size_t>(i) * 12;
+
+                Entry entry;
+                entry.tag = To16(bytes);
+                entry.type = To16(bytes + 2);
+                entry.count = To32(bytes + 4);
+
+                const uint32_t typeSize = FieldTypeSize(entry.type);
+                if (typeSize == 0)
+                {
+                    continue;
+                }
+
+                const uint64_t dataSize = static_cast<uint64_t>(typeSize) * entry.count;
+                entry.valueOffset = dataSize <= 4 ? offset + 2 + static_cast<uint64_t>(i) * 12 + 8 : To32(bytes + 8);
+                if (entry.valueOffset > size || dataSize > size - entry.valueOffset)
+                {
+                    continue;
+                }
+
+                directory.push_back(entry);
+            }
+
+            return true;
+        }
+
+        static const Entry* Find(const Directory& directory, uint16_t tag)
+        {
+            const auto it = std::find_if(directory.begin(), directory.end(), [tag](const Entry& entry) {
+                return entry.tag == tag;
+            });
+            return it != directory.end() ? &*it : nullptr;
+        }
+
+        // Offset of a sub-directory such as the Exif or GPS IFD
+        std::optional<uint32_t> ReadPointer(const Directory& directory, uint16_t tag)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || entry->count != 1 || (entry->type != Long && entry->type != IFD))
+            {
+                return std::nullopt;
+            }
+
+            uint8_t bytes[4];
+            if (!ReadAt(entry->valueOffset, bytes, sizeof(bytes)))
+            {
+                return std::nullopt;
+            }
+            return To32(bytes);
+        }
+
+        // ASCII value up to the first null, as stored
+        std::optional<std::string> ReadAscii(const Directory& directory, uint16_t tag)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || entry->type != Ascii || entry->count == 0 || entry->count > MaxStringSize)
+            {
+                return std::nullopt;
+            }
+
+            std::string value(entry->count, '\0');
+            if (!ReadAt(entry->valueOffset, value.data(), value.size()))
+            {
+                return std::nullopt;
+            }
+
+            value.resize(strnlen(value.data(), value.size()));
+            return value;
+        }
+
+        std::optional<std::wstring> ReadString(const Directory& directory, uint16_t tag)
+        {
+            const auto value = ReadAscii(directory, tag);
+            return value ? MakeString(*value) : std::nullopt;
+        }
+
+        // Integer types only, like WICMetadataExtractor::ReadInteger
+        std::optional<int64_t> ReadInteger(const Directory& directory, uint16_t tag)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || entry->count != 1 || FieldTypeSize(entry->type) > 4)
+            {
+                return std::nullopt;
+            }
+
+            uint8_t bytes[4];
+            if (!ReadAt(entry->valueOffset, bytes, FieldTypeSize(entry->type)))
+            {
+                return std::nullopt;
+            }
+
+            switch (entry->type)
+            {
+            case Byte:
+                return bytes[0];
+            case SByte:
+                return static_cast<int8_t>(bytes[0]);
+            case Short:
+                return To16(bytes);
+            case SShort:
+                return static_cast<int16_t>(To16(bytes));
+            case Long:
+                return To32(bytes);
+            case SLong:
+                return static_cast<int32_t>(To32(bytes));
+            default:
+                return std::nullopt;
+            }
+        }
+
+        // Rationals, floats and integers, like WICMetadataExtractor::ReadDouble. A rational with
+        // a zero denominator reads as 0.
+        std::optional<double> ReadDouble(const Directory& directory, uint16_t tag, uint32_t index = 0)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || entry->count <= index || (index > 0 && entry->type != Rational && entry->type != SRational))
+            {
+                return std::nullopt;
+            }
+
+            const uint32_t typeSize = FieldTypeSize(entry->type);
+            uint8_t bytes[8];
+            if (!ReadAt(entry->valueOffset + static_cast<uint64_t>(index) * typeSize, bytes, typeSize))
+            {
+                return std::nullopt;
+            }
+
+            switch (entry->type)
+            {
+            case Rational:
+            {
+                const uint32_t numerator = To32(bytes);
+                const uint32_t denominator = To32(bytes + 4);
+                return denominator != 0 ? static_cast<double>(numerator) / denominator : 0.0;
+            }
+            case SRational:
+            {
+                const int32_t numerator = static_cast<int32_t>(To32(bytes));
+                const int32_t denominator = static_cast<int32_t>(To32(bytes + 4));
+                return denominator != 0 ? static_cast<double>(numerator) / denominator : 0.0;
+            }
+            case Float:
+            {
+                const uint32_t value = To32(bytes);
+                float result;
+                memcpy(&result, &value, sizeof(result));
+                return static_cast<double>(result);
+            }
+            case Double:
+            {
+                const uint64_t value = littleEndian ? (static_cast<uint64_t>(To32(bytes + 4)) << 32) | To32(bytes) :
+                                                      (static_cast<uint64_t>(To32(bytes)) << 32) | To32(bytes + 4);
+                double result;
+                memcpy(&result, &value, sizeof(result));
+                return result;
+            }
+            default:
+            {
+                const auto integer = ReadInteger(directory, tag);
+                return integer ? std::make_optional(static_cast<double>(*integer)) : std::nullopt;
+            }
+            }
+        }
+
+        // Degrees, minutes and seconds as three rationals
+        std::optional<double> ReadGPSCoordinate(const Directory& directory, uint16_t tag)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || entry->type != Rational || entry->count < 3)
+            {
+                return std::nullopt;
+            }
+
+            const auto degrees = ReadDouble(directory, tag, 0);
+            const auto minutes = ReadDouble(directory, tag, 1);
+            const auto seconds = ReadDouble(directory, tag, 2);
+            if (!degrees || !minutes || !seconds)
+            {
+                return std::nullopt;
+            }
+            return *degrees + *minutes / 60.0 + *seconds / 3600.0;
+        }
+
+        // Returns the absolute file range of a BYTE/UNDEFINED value
+        bool GetByteRange(const Directory& directory, uint16_t tag, uint64_t& offset, uint64_t& length)
+        {
+            const Entry* entry = Find(directory, tag);
+            if (!entry || (entry->type != Byte && entry->type != Undefined))
+            {
+                return false;
+            }
+            offset = start + entry->valueOffset;
+            length = entry->count;
+            return true;
+        }
+
+    private:
+        bool ReadAt(uint64_t offset, void* buffer, size_t count)
+        {
+            if (offset > size || count > size - offset)
+            {
+                return false;
+            }
+            return read(start + offset, buffer, count);
+        }
+
+        uint16_t To16(const uint8_t* bytes) const
+        {
+            return littleEndian ? static_cast<uint16_t>(bytes[0] | (bytes[1] << 8)) : ReadBigEndian16(bytes);
+        }
+
+        uint32_t To32(const uint8_t* bytes) const
+        {
+            return littleEndian ? static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+                                      (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24) :
+                                  ReadBigEndian32(bytes);
+        }
+
+        ReadFunction read;
+        uint64_t start;
+        uint64_t size;
+        bool littleEndian = true;
+    };
+
+    /// <summary>
+    /// Just enough XML to read an XMP packet: elements, attributes, namespaces, character data
+    /// and the predefined and numeric entities. DTDs are rejected.
+    /// </summary>
+    class XmlDocument
+    {
+    public:
+        struct Attribute
+        {
+            std::string ns;
+            std::string name;
+            std::string value;
+        };
+
+        struct Element
+        {
+            std::string ns;
+            std::string name;
+            std::vector<Attribute> attributes;
+            std::string text;
+            std::vector<size_t> children;
+        };
+
+        bool Parse(std::string_view xml)
+        {
+            source = xml;
+            position = 0;
+            elements.clear();
+
+            std::vector<size_t> open;
+            std::vector<std::pair<std::string, std::string>> namespaces{ { "xml", std::string(NsXML) } };
+            std::vector<size_t> namespaceMarks;
+            std::vector<std::string> openNames;
+
+            while (position < source.size())
+            {
+                if (source[position] != '<')
+                {
+                    const size_t end = std::min(source.find('<', position), source.size());
+                    if (!open.empty() && !DecodeText(source.substr(position, end - position), elements[open.back()].text))
+                    {
+                        return false;
+                    }
+                    position = end;
+                    continue;
+                }
+
+                if (StartsWith("<?"))
+                {
+                    if (!SkipPast("?>"))
+                    {
+                        return false;
+                    }
+                }
+                else if (StartsWith("<!--"))
+                {
+                    if (!SkipPast("-->"))
+                    {
+                        return false;
+                    }
+                }
+                else if (StartsWith("<![CDATA["))
+                {
+                    const size_t begin = position + 9;
+                    const size_t end = source.find("]]>", begin);
+                    if (end == std::string_view::npos)
+                    {
+                        return false;
+                    }
+                    if (!open.empty())
+                    {
+                        elements[open.back()].text.append(source.substr(begin, end - begin));
+                    }
+                    position = end + 3;
+                }
+                else if (StartsWith("<!"))
+                {
+                    // DOCTYPE and other declarations are not used by XMP
+                    return false;
+                }
+                else if (StartsWith("</"))
+                {
+                    position += 2;
+                    const std::string_view name = ReadName();
+                    SkipWhitespace();
+                    if (open.empty() || name != openNames.back() || !Consume('>'))
+                    {
+                        return false;
+                    }
+                    open.pop_back();
+                    openNames.pop_back();
+                    namespaces.resize(namespaceMarks.back());
+                    namespaceMarks.pop_back();
+                }
+                else
+                {
+                    ++position;
+                    const std::string_view qualifiedName = ReadName();
+                    if (qualifiedName.empty() || open.size() >= MaxXMLDepth)
+                    {
+                        return false;
+                    }
+
+                    namespaceMarks.push_back(namespaces.size());
+
+                    std::vector<std::pair<std::string_view, std::string>> rawAttributes;
+                    bool selfClosing = false;
+                    for (;;)
+                    {
+                        SkipWhitespace();
+                        if (Consume('>'))
+                        {
+                            break;
+                        }
+                        if (Consume('/'))
+                        {
+                            if (!Consume('>'))
+                            {
+                                return false;
+                            }
+                            selfClosing = true;
+                            break;
+                        }
+
+                        const std::string_view attributeName = ReadName();
+                        SkipWhitespace();
+                        if (attributeName.empty() || !Consume('='))
+                        {
+                            return false;
+                        }
+                        SkipWhitespace();
+
+                        std::string value;
+                        if (!ReadAttributeValue(value))
+                        {
+                            return false;
+                        }
+
+                        if (attributeName == "xmlns")
+                        {
+                            namespaces.emplace_back("", std::move(value));
+                        }
+                        else if (attributeName.substr(0, 6) == "xmlns:")
+                        {
+                            namespaces.emplace_back(std::string(attributeName.substr(6)), std::move(value));
+                        }
+                        else
+                        {
+                            rawAttributes.emplace_back(attributeName, std::move(value));
+                        }
+                    }
+
+                    Element element;
+                    ResolveName(qualifiedName, namespaces, true, element.ns, element.name);
+                    for (auto& [attributeName, value] : rawAttributes)
+                    {
+                        Attribute attribute;
+                        ResolveName(attributeName, namespaces, false, attribute.ns, attribute.name);
+                        attribute.value = std::move(value);
+                        element.attributes.push_back(std::move(attribute));
+                    }
+
+                    const size_t index = elements.size();
+                    if (!open.empty())
+                    {
+                        elements[open.back()].children.push_back(index);
+                    }
+                    elements.push_back(std::move(element));
+
+                    if (selfClosing)
+                    {
+                        namespaces.resize(namespaceMarks.back());
+                        namespaceMarks.pop_back();
+                    }
+                    else
+                    {
+                        open.push_back(index);
+                        openNames.emplace_back(qualifiedName);
+                    }
+                }
+            }
+
+            return open.empty() && !elements.empty();
+        }
+
+        const std::vector<Element>& Elements() const
+        {
+            return elements;
+        }
+
+        static const std::string* FindAttribute(const Element& element, std::string_view ns, std::string_view name)
+        {
+            for (const auto& attribute : element.attributes)
+            {
+                if (attribute.ns == ns && attribute.name == name)
+                {
+                    return &attribute.value;
+                }
+            }
+            return nullptr;
+        }
+
+    private:
+        static bool IsWhitespace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+        }
+
+        static bool IsNameCharacter(char c)
+        {
+            return !IsWhitespace(c) && c != '>' && c != '/' && c != '=' && c != '<' && c != '"' && c != '\'';
+        }
+
+        bool StartsWith(std::string_view prefix) const
+        {
+            return source.substr(position, prefix.size()) == prefix;
+        }
+
+        bool SkipPast(std::string_view terminator)
+        {
+            const size_t end = source.find(terminator, position);
+            if (end == std::string_view::npos)
+            {
+                return false;
+            }
+            position = end + terminator.size();
+            return true;
+        }
+
+        void SkipWhitespace()
+        {
+            while (position < source.size() && IsWhitespace(source[position]))
+            {
+                ++position;
+            }
+        }
+
+        bool Consume(char c)
+        {
+            if (position < source.size() && source[position] == c)
+            {
+                ++position;
+                return true;
+            }
+            return false;
+        }
+
+        std::string_view ReadName()
+        {
+            const size_t begin = position;
+            while (position < source.size() && IsNameCharacter(source[position]))
+            {
+                ++position;
+            }
+            return source.substr(begin, position - begin);
+        }
+
+        bool ReadAttributeValue(std::string& value)
+        {
+            if (position >= source.size() || (source[position] != '"' && source[position] != '\''))
+            {
+                return false;
+            }
+
+            const char quote = source[position++];
+            const size_t end = source.find(quote, position);
+            if (end == std::string_view::npos)
+            {
+                return false;
+            }
+
+            const std::string_view raw = source.substr(position, end - position);
+            position = end + 1;
+            return raw.find('<') == std::string_view::npos && DecodeText(raw, value);
+        }
+
+        static bool DecodeText(std::string_view raw, std::string& text)
+        {
+            size_t i = 0;
+            while (i < raw.size())
+            {
+                const size_t ampersand = raw.find('&', i);
+                if (ampersand == std::string_view::npos)
+                {
+                    text.append(raw.substr(i));
+                    break;
+                }
+
+                text.append(raw.substr(i, ampersand - i));
+                const size_t semicolon = raw.find(';', ampersand);
+                if (semicolon == std::string_view::npos)
+                {
+                    return false;
+                }
+
+                const std::string_view entity = raw.substr(ampersand + 1, semicolon - ampersand - 1);
+                if (entity == "lt")
+                {
+                    text.push_back('<');
+                }
+                else if (entity == "gt")
+                {
+                    text.push_back('>');
+                }
+                else if (entity == "amp")
+                {
+                    text.push_back('&');
+                }
+                else if (entity == "quot")
+                {
+                    text.push_back('"');
+                }
+                else if (entity == "apos")
+                {
+                    text.push_back('\'');
+                }
+                else if (entity.size() > 1 && entity[0] == '#')
+                {
+                    const bool hex = entity[1] == 'x';
+                    const std::string_view digits = entity.substr(hex ? 2 : 1);
+                    uint32_t codePoint = 0;
+                    const auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), codePoint, hex ? 16 : 10);
+                    if (digits.empty() || error != std::errc() || end != digits.data() + digits.size() ||
+                        codePoint == 0 || codePoint > 0x10FFFF || (codePoint >= 0xD800 && codePoint <= 0xDFFF))
+                    {
+                        return false;
+                    }
+                    AppendUtf8(text, codePoint);
+                }
+                else
+                {
+                    return false;
+                }
+
+                i = semicolon + 1;
+            }
+            return true;
+        }
+
+        static void ResolveName(std::string_view qualifiedName,
+                                const std::vector<std::pair<std::string, std::string>>& namespaces,
+                                bool useDefaultNamespace,
+                                std::string& ns,
+                                std::string& name)
+        {
+            const size_t colon = qualifiedName.find(':');
+            const std::string_view prefix = colon == std::string_view::npos ? std::string_view() : qualifiedName.substr(0, colon);
+            name = std::string(colon == std::string_view::npos ? qualifiedName : qualifiedName.substr(colon + 1));
+            ns.clear();
+
+            if (prefix.empty() && !useDefaultNamespace)
+            {
+                return;
+            }
+
+            for (auto it = namespaces.rbegin(); it != namespaces.rend(); ++it)
+            {
+                if (it->first == prefix)
+                {
+                    ns = it->second;
+                    return;
+                }
+            }
+        }
+
+        std::string_view source;
+        size_t position = 0;
+        std::vector<Element> elements;
+    };
+
+    /// <summary>
+    /// Property values found in the rdf:Description elements of an XMP packet, as simple values
+    /// or as the items of an rdf:Alt, rdf:Bag or rdf:Seq array.
+    /// </summary>
+    class XMPProperties
+    {
+    public:
+        struct Value
+        {
+            std::string text;
+            // Array items and their xml:lang qualifiers
+            std::vector<std::pair<std::string, std::string>> items;
+            bool isArray = false;
+        };
+
+        explicit XMPProperties(const XmlDocument& document)
+        {
+            const auto& elements = document.Elements();
+            for (const auto& element : elements)
+            {
+                if (element.ns != NsRDF || element.name != "Description")
+                {
+                    continue;
+                }
+
+                // Simple properties written as attributes
+                for (const auto& attribute : element.attributes)
+                {
+                    if (!attribute.ns.empty() && attribute.ns != NsRDF && attribute.ns != NsXML)
+                    {
+                        Value value;
+                        value.text = attribute.value;
+                        Add(attribute.ns, attribute.name, std::move(value));
+                    }
+                }
+
+                for (const size_t childIndex : element.children)
+                {
+                    const auto& property = elements[childIndex];
+
+                    Value value;
+                    if (const auto resource = XmlDocument::FindAttribute(property, NsRDF, "resource"))
+                    {
+                        value.text = *resource;
+                    }
+                    else
+                    {
+                        value.text = property.text;
+                    }
+
+                    for (const size_t arrayIndex : property.children)
+                    {
+                        const auto& array = elements[arrayIndex];
+                        if (array.ns != NsRDF || (array.name != "Alt" && array.name != "Bag" && array.name != "Seq"))
+                        {
+                            continue;
+                        }
+
+                        value.isArray = true;
+                        for (const size_t itemIndex : array.children)
+                        {
+                            const auto& item = elements[itemIndex];
+                            if (item.ns == NsRDF && item.name == "li")
+                            {
+                                const auto language = XmlDocument::FindAttribute(item, NsXML, "lang");
+                                value.items.emplace_back(language ? *language : std::string(), item.text);
+                            }
+                        }
+                        break;
+                    }
+
+                    Add(property.ns, property.name, std::move(value));
+                }
+            }
+        }
+
+        std::optional<std::wstring> GetString(std::string_view ns, std::string_view name) const
+        {
+            const Value* value = Find(ns, name);
+            return value && !value->isArray ? MakeString(value->text) : std::nullopt;
+        }
+
+        std::optional<SYSTEMTIME> GetDate(std::string_view ns, std::string_view name, const MetadataHeaderParser::DateParser& parseDate) const
+        {
+            const Value* value = Find(ns, name);
+            return value && !value->isArray ? MakeDate(value->text, parseDate) : std::nullopt;
+        }
+
+        // The x-default entry of a language alternative
+        std::optional<std::wstring> GetDefaultLanguageString(std::string_view ns, std::string_view name) const
+        {
+            const Value* value = Find(ns, name);
+            if (!value)
+            {
+                return std::nullopt;
+            }
+
+            for (const auto& [language, text] : value->items)
+            {
+                if (language == "x-default")
+                {
+                    return MakeString(text);
+                }
+            }
+            return std::nullopt;
+        }
+
+        // A simple value or the first item of an ordered array
+        std::optional<std::wstring> GetFirstString(std::string_view ns, std::string_view name) const
+        {
+            const Value* value = Find(ns, name);
+            if (!value)
+            {
+                return std::nullopt;
+            }
+
+            if (!value->isArray)
+            {
+                return MakeString(value->text);
+            }
+            return value->items.empty() ? std::nullopt : MakeString(value->items.front().second);
+        }
+
+        std::optional<std::vector<std::wstring>> GetStrings(std::string_view ns, std::string_view name, size_t maxCount) const
+        {
+            const Value* value = Find(ns, name);
+            if (!value || !value->isArray)
+            {
+                return std::nullopt;
+            }
+
+            std::vector<std::wstring> result;
+            for (const auto& item : value->items)
+            {
+                if (result.size() >= maxCount)
+                {
+                    break;
+                }
+                if (auto text = MakeString(item.second))
+                {
+                    result.push_back(std::move(*text));
+                }
+            }
+            return result.empty() ? std::nullopt : std::make_optional(std::move(result));
+        }
+
+    private:
+        void Add(const std::string& ns, const std::string& name, Value value)
+        {
+            // The first occurrence wins if a property is repeated across descriptions
+            properties.try_emplace(ns + name, std::move(value));
+        }
+
+        const Value* Find(std::string_view ns, std::string_view name) const
+        {
+            std::string key(ns);
+            key.append(name);
+            const auto it = properties.find(key);
+            return it != properties.end() ? &it->second : nullptr;
+        }
+
+        std::unordered_map<std::string, Value> properties;
+    };
+
+    bool IsHEIFBrand(uint32_t brand)
+    {
+        static const uint32_t brands[] = {
+            MakeFourCC("heic"),
+            MakeFourCC("heix"),
+            MakeFourCC("hevc"),
+            MakeFourCC("hevx"),
+            MakeFourCC("heim"),
+            MakeFourCC("heis"),
+            MakeFourCC("hevm"),
+            MakeFourCC("hevs"),
+            MakeFourCC("mif1"),
+            MakeFourCC("msf1"),
+            MakeFourCC("avif"),
+            MakeFourCC("avis"),
+        };
+        return std::find(std::begin(brands), std::end(brands), brand) != std::end(brands);
+    }
+
+    /// <summary>
+    /// Walks ISO base media file format boxes inside a buffer
+    /// </summary>
+    class BoxReader
+    {
+    public:
+        struct Box
+        {
+            uint32_t type = 0;
+            // Payload, after the box header
+            size_t offset = 0;
+            size_t size = 0;
+        };
+
+        BoxReader(const uint8_t* data, size_t size) :
+            data(data), size(size)
+        {
+        }
+
+        // Returns false at the end of the buffer or on a damaged box
+        bool Next(Box& box)
+        {
+            if (size - position < 8)
+            {
+                return false;
+            }
+
+            uint64_t boxSize = ReadBigEndian32(data + position);
+            box.type = ReadBigEndian32(data + position + 4);
+            size_t headerSize = 8;
+
+            if (boxSize == 1)
+            {
+                if (size - position < 16)
+                {
+                    return false;
+                }
+                boxSize = ReadBigEndian64(data + position + 8);
+                headerSize = 16;
+            }
+            else if (boxSize == 0)
+            {
+                boxSize = size - position;
+            }
+
+            if (boxSize < headerSize || boxSize > size - position)
+            {
+                return false;
+            }
+
+            box.offset = position + headerSize;
+            box.size = static_cast<size_t>(boxSize) - headerSize;
+            position += static_cast<size_t>(boxSize);
+            return true;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+    };
+
+    /// <summary>
+    /// Bounds-checked big-endian reads over a box payload
+    /// </summary>
+    class ByteStream
+    {
+    public:
+        ByteStream(const uint8_t* data, size_t size) :
+            data(data), size(size)
+        {
+        }
+
+        bool Failed() const
+        {
+            return failed;
+        }
+
+        size_t Position() const
+        {
+            return position;
+        }
+
+        uint64_t Read(size_t byteCount)
+        {
+            if (failed || byteCount > size - position)
+            {
+                failed = true;
+                return 0;
+            }
+
+            uint64_t value = 0;
+            for (size_t i = 0; i < byteCount; ++i)
+            {
+                value = (value << 8) | data[position + i];
+            }
+            position += byteCount;
+            return value;
+        }
+
+        std::string_view ReadNullTerminatedString()
+        {
+            if (failed)
+            {
+                return {};
+            }
+
+            const auto begin = reinterpret_cast<const char*>(data + position);
+            const size_t length = strnlen(begin, size - position);
+            position += std::min(length + 1, size - position);
+            return std::string_view(begin, length);
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t position = 0;
+        bool failed = false;
+    };
+}
+
+MetadataHeaderParser::MetadataHeaderParser(ReadCallback read, uint64_t fileSize) :
+    read(std::move(read)), fileSize(fileSize)
+{
+}
+
+bool MetadataHeaderParser::Read(uint64_t offset, void* buffer, size_t size)
+{
+    if (offset > fileSize || size > fileSize - offset)
+    {
+        return false;
+    }
+
+    if (size == 0)
+    {
+        return true;
+    }
+
+    if (size > MaxCachedReadSize)
+    {
+        const size_t count = read(offset, buffer, size);
+        bytesRead += count;
+        return count == size;
+    }
+
+    if (block.empty() || offset < blockOffset || offset + size > blockOffset + block.size())
+    {
+        blockOffset = offset - offset % BlockAlignment;
+        block.resize(static_cast<size_t>(std::min<uint64_t>(BlockSize, fileSize - blockOffset)));
+
+        const size_t count = read(blockOffset, block.data(), block.size());
+        bytesRead += count;
+        block.resize(count);
+
+        if (offset + size > blockOffset + block.size())
+        {
+            return false;
+        }
+    }
+
+    memcpy(buffer, block.data() + (offset - blockOffset), size);
+    return true;
+}
+
+bool MetadataHeaderParser::LocateMetadata(Layout& outLayout)
+{
+    if (!container)
+    {
+        container = Container::Unknown;
+        Layout found;
+
+        uint8_t signature[12] = {};
+        if (fileSize >= sizeof(signature) && Read(0, signature, sizeof(signature)))
+        {
+            if (signature[0] == 0xFF && signature[1] == 0xD8 && signature[2] == 0xFF)
+            {
+                if (LocateInJPEG(found))
+                {
+                    container = Container::JPEG;
+                }
+            }
+            else if ((signature[0] == 'I' && signature[1] == 'I' && signature[2] == 42 && signature[3] == 0) ||
+                     (signature[0] == 'M' && signature[1] == 'M' && signature[2] == 0 && signature[3] == 42))
+            {
+                found.tiff = { 0, fileSize };
+                container = Container::TIFF;
+            }
+            else if (ReadBigEndian32(signature + 4) == MakeFourCC("ftyp"))
+            {
+                if (LocateInHEIF(found))
+                {
+                    container = Container::HEIF;
+                }
+            }
+        }
+
+        layout = found;
+    }
+
+    outLayout = *layout;
+    return container != Container::Unknown;
+}
+
+bool MetadataHeaderParser::LocateInJPEG(Layout& outLayout)
+{
+    uint64_t offset = 2;
+    for (size_t segment = 0; segment < MaxJPEGSegments; ++segment)
+    {
+        uint8_t marker[2];
+        if (!Read(offset, marker, sizeof(marker)) || marker[0] != 0xFF)
+        {
+            // Truncated or damaged after the segments that were found
+            break;
+        }
+
+        if (marker[1] == 0xFF)
+        {
+            // Fill byte
+            ++offset;
+            continue;
+        }
+
+        // Start of scan or end of image, metadata segments come before
+        if (marker[1] == 0xDA || marker[1] == 0xD9)
+        {
+            break;
+        }
+
+        // Standalone markers without a length
+        if ((marker[1] >= 0xD0 && marker[1] <= 0xD7) || marker[1] == 0x01)
+        {
+            offset += 2;
+            continue;
+        }
+
+        uint8_t lengthBytes[2];
+        if (!Read(offset + 2, lengthBytes, sizeof(lengthBytes)))
+        {
+            break;
+        }
+
+        const uint16_t length = ReadBigEndian16(lengthBytes);
+        if (length < 2)
+        {
+            return false;
+        }
+
+        const uint64_t payload = offset + 4;
+        const uint64_t payloadSize = length - 2u;
+
+        if (marker[1] == 0xE1)
+        {
+            uint8_t header[sizeof(XMPSignature)] = {};
+            const size_t headerSize = static_cast<size_t>(std::min<uint64_t>(sizeof(header), payloadSize));
+            if (Read(payload, header, headerSize))
+            {
+                if (outLayout.tiff.size == 0 && headerSize >= sizeof(ExifSignature) &&
+                    memcmp(header, ExifSignature, sizeof(ExifSignature)) == 0)
+                {
+                    outLayout.tiff = { payload + sizeof(ExifSignature), payloadSize - sizeof(ExifSignature) };
+                }
+                else if (outLayout.xmp.size == 0 && headerSize == sizeof(XMPSignature) &&
+                         memcmp(header, XMPSignature, sizeof(XMPSignature)) == 0)
+                {
+                    outLayout.xmp = { payload + sizeof(XMPSignature), payloadSize - sizeof(XMPSignature) };
+                }
+            }
+        }
+
+        if (outLayout.tiff.size != 0 && outLayout.xmp.size != 0)
+        {
+            break;
+        }
+
+        offset = payload + payloadSize;
+    }
+
+    return true;
+}
+
+bool MetadataHeaderParser::LocateInHEIF(Layout& outLayout)
+{
+    // Find the top level meta box, reading only box headers on the way
+    uint64_t offset = 0;
+    bool isHEIF = false;
+    uint64_t metaOffset = 0;
+    uint64_t metaSize = 0;
+
+    while (offset < fileSize && metaSize == 0)
+    {
+        uint8_t header[16];
+        const size_t headerAvailable = static_cast<size_t>(std::min<uint64_t>(sizeof(header), fileSize - offset));
+        if (headerAvailable < 8 || !Read(offset, header, headerAvailable))
+        {
+            return false;
+        }
+
+        uint64_t boxSize = ReadBigEndian32(header);
+        const uint32_t type = ReadBigEndian32(header + 4);
+        uint64_t headerSize = 8;
+        if (boxSize == 1)
+        {
+            if (headerAvailable < 16)
+            {
+                return false;
+            }
+            boxSize = ReadBigEndian64(header + 8);
+            headerSize = 16;
+        }
+        else if (boxSize == 0)
+        {
+            boxSize = fileSize - offset;
+        }
+
+        if (boxSize < headerSize || boxSize > fileSize - offset)
+        {
+            return false;
+        }
+
+        if (offset == 0)
+        {
+            // The first box must be a file type box naming an image brand
+            if (type != MakeFourCC("ftyp") || boxSize < headerSize + 8)
+            {
+                return false;
+            }
+
+            std::vector<uint8_t> brands(static_cast<size_t>(std::min<uint64_t>(boxSize - headerSize, 1024)));
+            if (!Read(headerSize, brands.data(), brands.size()))
+            {
+                return false;
+            }
+
+            // Major brand, minor version, then compatible brands
+            isHEIF = IsHEIFBrand(ReadBigEndian32(brands.data()));
+            for (size_t i = 8; !isHEIF && i + 4 <= brands.size(); i += 4)
+            {
+                isHEIF = IsHEIFBrand(ReadBigEndian32(brands.data() + i));
+            }
+
+            if (!isHEIF)
+            {
+                return false;
+            }
+        }
+        else if (type == MakeFourCC("meta"))
+        {
+            metaOffset = offset + headerSize;
+            metaSize = boxSize - headerSize;
+        }
+
+        offset += boxSize;
+    }
+
+    if (metaSize == 0)
+    {
+        // A HEIF file without metadata
+        return true;
+    }
+
+    if (metaSize < 4 || metaSize > MaxMetaBoxSize)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> meta(static_cast<size_t>(metaSize));
+    if (!Read(metaOffset, meta.data(), meta.size()))
+    {
+        return false;
+    }
+
+    // meta is a full box, its children follow the version and flags
+    BoxReader children(meta.data() + 4, meta.size() - 4);
+    std::optional<uint32_t> exifItem;
+    std::optional<uint32_t> xmpItem;
+    const uint8_t* ilocData = nullptr;
+    size_t ilocSize = 0;
+
+    BoxReader::Box box;
+    while (children.Next(box))
+    {
+        const uint8_t* payload = meta.data() + 4 + box.offset;
+
+        if (box.type == MakeFourCC("iinf"))
+        {
+            ByteStream stream(payload, box.size);
+            const uint64_t version = stream.Read(1);
+            stream.Read(3);
+            stream.Read(version == 0 ? 2 : 4);
+            if (stream.Failed())
+            {
+                return false;
+            }
+
+            BoxReader entries(payload + stream.Position(), box.size - stream.Position());
+            BoxReader::Box entry;
+            while (entries.Next(entry))
+            {
+                if (entry.type != MakeFourCC("infe"))
+                {
+                    continue;
+                }
+
+                ByteStream info(payload + stream.Position() + entry.offset, entry.size);
+                const uint64_t infoVersion = info.Read(1);
+                info.Read(3);
+                if (infoVersion < 2)
+                {
+                    // Item types were added in version 2
+                    continue;
+                }
+
+                const auto itemId = static_cast<uint32_t>(info.Read(infoVersion == 2 ? 2 : 4));
+                info.Read(2); // item_protection_index
+                const auto itemType = static_cast<uint32_t>(info.Read(4));
+                info.ReadNullTerminatedString(); // item_name
+                if (info.Failed())
+                {
+                    continue;
+                }
+
+                if (itemType == MakeFourCC("Exif") && !exifItem)
+                {
+                    exifItem = itemId;
+                }
+                else if (itemType == MakeFourCC("mime") && !xmpItem &&
+                         info.ReadNullTerminatedString() == "application/rdf+xml")
+                {
+                    xmpItem = itemId;
+                }
+            }
+        }
+        else if (box.type == MakeFourCC("iloc"))
+        {
+            ilocData = payload;
+            ilocSize = box.size;
+        }
+    }
+
+    if (!exifItem && !xmpItem)
+    {
+        return true;
+    }
+
+    if (!ilocData)
+    {
+        return false;
+    }
+
+    ByteStream stream(ilocData, ilocSize);
+    const uint64_t version = stream.Read(1);
+    stream.Read(3);
+    const uint64_t sizes = stream.Read(2);
+    const size_t offsetSize = (sizes >> 12) & 0xF;
+    const size_t lengthSize = (sizes >> 8) & 0xF;
+    const size_t baseOffsetSize = (sizes >> 4) & 0xF;
+    const size_t indexSize = (version == 1 || version == 2) ? (sizes & 0xF) : 0;
+    const uint64_t itemCount = stream.Read(version < 2 ? 2 : 4);
+
+    if (version > 2 || offsetSize > 8 || lengthSize > 8 || baseOffsetSize > 8 || indexSize > 8)
+    {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < itemCount && !stream.Failed(); ++i)
+    {
+        const auto itemId = static_cast<uint32_t>(stream.Read(version < 2 ? 2 : 4));
+        uint64_t constructionMethod = 0;
+        if (version == 1 || version == 2)
+        {
+            constructionMethod = stream.Read(2) & 0xF;
+        }
+        stream.Read(2); // data_reference_index
+        const uint64_t baseOffset = stream.Read(baseOffsetSize);
+        const uint64_t extentCount = stream.Read(2);
+
+        uint64_t extentOffset = 0;
+        uint64_t extentLength = 0;
+        for (uint64_t extent = 0; extent < extentCount && !stream.Failed(); ++extent)
+        {
+            stream.Read(indexSize);
+            extentOffset = stream.Read(offsetSize);
+            extentLength = stream.Read(lengthSize);
+        }
+
+        const bool isExif = exifItem && itemId == *exifItem;
+        const bool isXMP = xmpItem && itemId == *xmpItem;
+        if (stream.Failed() || (!isExif && !isXMP))
+        {
+            continue;
+        }
+
+        // Only items stored as one extent in the file itself are supported
+        if (constructionMethod != 0 || extentCount != 1)
+        {
+            return false;
+        }
+
+        const uint64_t start = baseOffset + extentOffset;
+        if (start < baseOffset || start > fileSize)
+        {
+            return false;
+        }
+        const uint64_t length = extentLength == 0 ? fileSize - start : std::min(extentLength, fileSize - start);
+
+        if (isExif)
+        {
+            // The payload starts with the offset of the TIFF header, past an optional "Exif\0\0"
+            uint8_t headerOffsetBytes[4];
+            if (length < 4 || !Read(start, headerOffsetBytes, sizeof(headerOffsetBytes)))
+            {
+                return false;
+            }
+
+            const uint64_t headerOffset = ReadBigEndian32(headerOffsetBytes);
+            if (headerOffset > length - 4)
+            {
+                return false;
+            }
+            outLayout.tiff = { start + 4 + headerOffset, length - 4 - headerOffset };
+        }
+        else
+        {
+            outLayout.xmp = { start, length };
+        }
+    }
+
+    return !stream.Failed();
+}
+
+bool MetadataHeaderParser::ReadXMPPacket(const Layout& metadataLayout, std::string& packet)
+{
+    if (metadataLayout.xmp.size > MaxXMPPacketSize)
+    {
+        return false;
+    }
+
+    packet.resize(static_cast<size_t>(metadataLayout.xmp.size));
+    if (!Read(metadataLayout.xmp.offset, packet.data(), packet.size()))
+    {
+        return false;
+    }
+
+    // XMP may also be written as UTF-16 or UTF-32, which is left to WIC
+    if (packet.size() >= 2 && (static_cast<uint8_t>(packet[0]) == 0xFE || static_cast<uint8_t>(packet[0]) == 0xFF || packet[0] == '\0' || packet[1] == '\0'))
+    {
+        return false;
+    }
+
+    // Skip a UTF-8 byte order mark
+    if (packet.size() >= 3 && packet.compare(0, 3, "\xEF\xBB\xBF") == 0)
+    {
+        packet.erase(0, 3);
+    }
+
+    // Packets are padded with whitespace and may be null-terminated
+    packet.resize(strnlen(packet.data(), packet.size()));
+    return true;
+}
+
+bool MetadataHeaderParser::ParseEXIF(EXIFMetadata& outMetadata, const DateParser& parseDate)
+{
+    Layout metadataLayout;
+    if (!LocateMetadata(metadataLayout))
+    {
+        return false;
+    }
+
+    if (metadataLayout.tiff.size == 0)
+    {
+        return true;
+    }
+
+    TiffReader tiff([this](uint64_t offset, void* buffer, size_t size) { return Read(offset, buffer, size); },
+                    metadataLayout.tiff.offset,
+                    metadataLayout.tiff.size);
+
+    uint32_t firstDirectory = 0;
+    TiffReader::Directory ifd0;
+    if (!tiff.ReadHeader(firstDirectory) || !tiff.ReadDirectory(firstDirectory, ifd0))
+    {
+        return false;
+    }
+
+    EXIFMetadata metadata;
+    metadata.cameraMake = tiff.ReadString(ifd0, TagMake);
+    metadata.cameraModel = tiff.ReadString(ifd0, TagModel);
+    metadata.orientation = tiff.ReadInteger(ifd0, TagOrientation);
+    metadata.author = tiff.ReadString(ifd0, TagArtist);
+    metadata.copyright = tiff.ReadString(ifd0, TagCopyright);
+    if (const auto dateTime = tiff.ReadAscii(ifd0, TagDateTime))
+    {
+        metadata.dateModified = MakeDate(*dateTime, parseDate);
+    }
+
+    TiffReader::Directory exif;
+    const auto exifOffset = tiff.ReadPointer(ifd0, TagExifIFD);
+    if (exifOffset && tiff.ReadDirectory(*exifOffset, exif))
+    {
+        if (const auto dateTime = tiff.ReadAscii(exif, TagDateTimeOriginal))
+        {
+            metadata.dateTaken = MakeDate(*dateTime, parseDate);
+        }
+        if (const auto dateTime = tiff.ReadAscii(exif, TagDateTimeDigitized))
+        {
+            metadata.dateDigitized = MakeDate(*dateTime, parseDate);
+        }
+
+        metadata.lensModel = tiff.ReadString(exif, TagLensModel);
+        metadata.iso = tiff.ReadInteger(exif, TagISOSpeed);
+        metadata.aperture = tiff.ReadDouble(exif, TagFNumber);
+        metadata.shutterSpeed = tiff.ReadDouble(exif, TagExposureTime);
+        metadata.focalLength = tiff.ReadDouble(exif, TagFocalLength);
+        metadata.exposureBias = tiff.ReadDouble(exif, TagExposureBias);
+        metadata.flash = tiff.ReadInteger(exif, TagFlash);
+        metadata.colorSpace = tiff.ReadInteger(exif, TagColorSpace);
+        metadata.width = tiff.ReadInteger(exif, TagPixelXDimension);
+        metadata.height = tiff.ReadInteger(exif, TagPixelYDimension);
+    }
+
+    TiffReader::Directory gps;
+    const auto gpsOffset = tiff.ReadPointer(ifd0, TagGPSIFD);
+    if (gpsOffset && tiff.ReadDirectory(*gpsOffset, gps))
+    {
+        auto latitude = tiff.ReadGPSCoordinate(gps, TagGPSLatitude);
+        auto longitude = tiff.ReadGPSCoordinate(gps, TagGPSLongitude);
+        if (latitude && longitude)
+        {
+            if (tiff.ReadAscii(gps, TagGPSLatitudeRef) == "S")
+            {
+                latitude = -*latitude;
+            }
+            if (tiff.ReadAscii(gps, TagGPSLongitudeRef) == "W")
+            {
+                longitude = -*longitude;
+            }
+
+            metadata.latitude = latitude;
+            metadata.longitude = longitude;
+        }
+
+        // Like the WIC extractor, the altitude reference (below sea level) is not applied
+        metadata.altitude = tiff.ReadDouble(gps, TagGPSAltitude);
+    }
+
+    // TIFF files keep their XMP packet in IFD0
+    if (container == Container::TIFF && layout->xmp.size == 0)
+    {
+        uint64_t xmpOffset = 0;
+        uint64_t xmpLength = 0;
+        if (tiff.GetByteRange(ifd0, TagXMP, xmpOffset, xmpLength))
+        {
+            layout->xmp = { xmpOffset, xmpLength };
+        }
+    }
+
+    outMetadata = std::move(metadata);
+    return true;
+}
+
+bool MetadataHeaderParser::ParseXMP(XMPMetadata& outMetadata, const DateParser& parseDate)
+{
+    Layout metadataLayout;
+    if (!LocateMetadata(metadataLayout))
+    {
+        return false;
+    }
+
+    if (container == Container::TIFF && metadataLayout.xmp.size == 0)
+    {
+        // The packet location is in IFD0, which ParseEXIF records
+        EXIFMetadata unused;
+        if (!ParseEXIF(unused, nullptr))
+        {
+            return false;
+        }
+        metadataLayout = *layout;
+    }
+
+    if (metadataLayout.xmp.size == 0)
+    {
+        return true;
+    }
+
+    std::string packet;
+    XmlDocument document;
+    if (!ReadXMPPacket(metadataLayout, packet) || !document.Parse(packet))
+    {
+        return false;
+    }
+
+    const XMPProperties properties(document);
+
+    XMPMetadata metadata;
+    metadata.creatorTool = properties.GetString(NsXMP, "CreatorTool");
+    metadata.createDate = properties.GetDate(NsXMP, "CreateDate", parseDate);
+    metadata.modifyDate = properties.GetDate(NsXMP, "ModifyDate", parseDate);
+    metadata.metadataDate = properties.GetDate(NsXMP, "MetadataDate", parseDate);
+
+    metadata.title = properties.GetDefaultLanguageString(NsDC, "title");
+    metadata.description = properties.GetDefaultLanguageString(NsDC, "description");
+    metadata.creator = properties.GetFirstString(NsDC, "creator");
+    metadata.subject = properties.GetStrings(NsDC, "subject", MaxXMPSubjects);
+
+    metadata.rights = properties.GetString(NsXMPRights, "WebStatement");
+
+    metadata.documentID = properties.GetString(NsXMPMM, "DocumentID");
+    metadata.instanceID = properties.GetString(NsXMPMM, "InstanceID");
+    metadata.originalDocumentID = properties.GetString(NsXMPMM, "OriginalDocumentID");
+    metadata.versionID = properties.GetString(NsXMPMM, "VersionID");
+
+    outMetadata = std::move(metadata);
+    return true;
+}
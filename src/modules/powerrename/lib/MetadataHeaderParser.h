@@ -0,0 +1,80 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "MetadataTypes.h"
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace PowerRenameLib
+{
+    /// <summary>
+    /// Reads EXIF (TIFF IFD) and XMP metadata straight from the container headers of JPEG,
+    /// TIFF and HEIF/AVIF files, without creating an image decoder. Only the segments holding
+    /// metadata are read, a block at a time, through the supplied read callback.
+    /// </summary>
+    class MetadataHeaderParser
+    {
+    public:
+        // Reads up to size bytes at offset and returns how many were read
+        using ReadCallback = std::function<size_t(uint64_t offset, void* buffer, size_t size)>;
+        // Converts the text of a date property into a time, or nullopt if it is not a date
+        using DateParser = std::function<std::optional<SYSTEMTIME>(const std::wstring& value)>;
+
+        MetadataHeaderParser(ReadCallback read, uint64_t fileSize);
+
+        // Return false when the container is not supported or is malformed, in which case
+        // the caller should fall back to a full decoder. A supported file without metadata
+        // returns true with no fields set.
+        bool ParseEXIF(EXIFMetadata& outMetadata, const DateParser& parseDate);
+        bool ParseXMP(XMPMetadata& outMetadata, const DateParser& parseDate);
+
+        uint64_t GetBytesRead() const
+        {
+            return bytesRead;
+        }
+
+    private:
+        enum class Container
+        {
+            Unknown,
+            JPEG,
+            TIFF,
+            HEIF
+        };
+
+        struct Range
+        {
+            uint64_t offset = 0;
+            uint64_t size = 0;
+        };
+
+        // Where the metadata blocks of the file are. An empty range means the block is absent.
+        struct Layout
+        {
+            Range tiff;
+            Range xmp;
+        };
+
+        bool Read(uint64_t offset, void* buffer, size_t size);
+        bool LocateMetadata(Layout& layout);
+        bool LocateInJPEG(Layout& layout);
+        bool LocateInHEIF(Layout& layout);
+        bool ReadXMPPacket(const Layout& layout, std::string& packet);
+
+        ReadCallback read;
+        uint64_t fileSize;
+        uint64_t bytesRead = 0;
+
+        // Single block cache, metadata blocks are small and read front to back
+        std::vector<uint8_t> block;
+        uint64_t blockOffset = 0;
+
+        std::optional<Container> container;
+        std::optional<Layout> layout;
+    };
+}
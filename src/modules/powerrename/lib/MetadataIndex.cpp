@@ -0,0 +1,642 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#include "pch.h"
+#include "MetadataIndex.h"
+
+using namespace PowerRenameLib;
+
+namespace
+{
+    constexpr uint32_t IndexFileMagic = 0x494D5250; // "PRMI"
+    // Bump whenever EXIFMetadata, XMPMetadata, the record layout or what the extractor fills in
+    // change
+    constexpr uint32_t IndexFileVersion = 2;
+    // Past this size, entries not used in the current session are dropped on flush
+    constexpr size_t MaxIndexFileSize = 64 * 1024 * 1024;
+
+    struct IndexFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t recordCount;
+    };
+
+    // Followed by the path (pathLength characters) and the serialized metadata. Records are
+    // padded to a multiple of 8 bytes.
+    struct RecordHeader
+    {
+        uint32_t recordSize;
+        uint16_t pathLength;
+        uint8_t type;
+        uint8_t wasSuccessful;
+        uint64_t fileSize;
+        uint64_t lastWriteTime;
+    };
+
+    constexpr size_t RecordAlignment = 8;
+
+    RecordHeader ReadRecordHeader(const BYTE* record)
+    {
+        RecordHeader header;
+        memcpy(&header, record, sizeof(header));
+        return header;
+    }
+
+    bool WriteAll(HANDLE file, const void* data, size_t size)
+    {
+        DWORD written = 0;
+        return WriteFile(file, data, static_cast<DWORD>(size), &written, nullptr) && written == size;
+    }
+
+    bool IsSameFile(HANDLE first, HANDLE second)
+    {
+        BY_HANDLE_FILE_INFORMATION firstInfo{};
+        BY_HANDLE_FILE_INFORMATION secondInfo{};
+        return GetFileInformationByHandle(first, &firstInfo) && GetFileInformationByHandle(second, &secondInfo) &&
+               firstInfo.dwVolumeSerialNumber == secondInfo.dwVolumeSerialNumber &&
+               firstInfo.nFileIndexHigh == secondInfo.nFileIndexHigh &&
+               firstInfo.nFileIndexLow == secondInfo.nFileIndexLow;
+    }
+
+    class RecordWriter
+    {
+    public:
+        explicit RecordWriter(std::vector<BYTE>& buffer) :
+            buffer(buffer)
+        {
+        }
+
+        void Write(const void* data, size_t size)
+        {
+            const auto bytes = static_cast<const BYTE*>(data);
+            buffer.insert(buffer.end(), bytes, bytes + size);
+        }
+
+        template<typename T>
+        void operator()(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Write(&value, sizeof(value));
+        }
+
+        void operator()(const std::wstring& value)
+        {
+            (*this)(static_cast<uint32_t>(value.size()));
+            Write(value.data(), value.size() * sizeof(wchar_t));
+        }
+
+        void operator()(const std::vector<std::wstring>& values)
+        {
+            (*this)(static_cast<uint32_t>(values.size()));
+            for (const auto& value : values)
+            {
+                (*this)(value);
+            }
+        }
+
+        template<typename T>
+        void operator()(const std::optional<T>& value)
+        {
+            (*this)(static_cast<uint8_t>(value.has_value()));
+            if (value.has_value())
+            {
+                (*this)(value.value());
+            }
+        }
+
+    private:
+        std::vector<BYTE>& buffer;
+    };
+
+    // Reads what RecordWriter wrote. Reading past the end of the record marks the reader as
+    // failed instead of touching memory outside of it.
+    class RecordReader
+    {
+    public:
+        RecordReader(const BYTE* data, size_t size) :
+            data(data), size(size)
+        {
+        }
+
+        bool Failed() const
+        {
+            return failed;
+        }
+
+        bool Read(void* destination, size_t count)
+        {
+            if (failed || count > size - position)
+            {
+                failed = true;
+                return false;
+            }
+            memcpy(destination, data + position, count);
+            position += count;
+            return true;
+        }
+
+        template<typename T>
+        void operator()(T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            Read(&value, sizeof(value));
+        }
+
+        void operator()(std::wstring& value)
+        {
+            uint32_t length = 0;
+            (*this)(length);
+            if (failed || length > (size - position) / sizeof(wchar_t))
+            {
+                failed = true;
+                return;
+            }
+            value.resize(length);
+            Read(value.data(), length * sizeof(wchar_t));
+        }
+
+        void operator()(std::vector<std::wstring>& values)
+        {
+            uint32_t count = 0;
+            (*this)(count);
+            for (uint32_t i = 0; i < count && !failed; i++)
+            {
+                (*this)(values.emplace_back());
+            }
+        }
+
+        template<typename T>
+        void operator()(std::optional<T>& value)
+        {
+            uint8_t present = 0;
+            (*this)(present);
+            if (present && !failed)
+            {
+                (*this)(value.emplace());
+            }
+        }
+
+    private:
+        const BYTE* data;
+        size_t size;
+        size_t position = 0;
+        bool failed = false;
+    };
+
+    // Field lists shared by serialization and deserialization
+    template<typename Archive, typename Metadata>
+    void VisitEXIF(Archive& archive, Metadata& metadata)
+    {
+        archive(metadata.dateTaken);
+        archive(metadata.dateDigitized);
+        archive(metadata.dateModified);
+        archive(metadata.cameraMake);
+        archive(metadata.cameraModel);
+        archive(metadata.lensModel);
+        archive(metadata.iso);
+        archive(metadata.aperture);
+        archive(metadata.shutterSpeed);
+        archive(metadata.focalLength);
+        archive(metadata.exposureBias);
+        archive(metadata.flash);
+        archive(metadata.width);
+        archive(metadata.height);
+        archive(metadata.orientation);
+        archive(metadata.colorSpace);
+        archive(metadata.author);
+        archive(metadata.copyright);
+        archive(metadata.latitude);
+        archive(metadata.longitude);
+        archive(metadata.altitude);
+    }
+
+    template<typename Archive, typename Metadata>
+    void VisitXMP(Archive& archive, Metadata& metadata)
+    {
+        archive(metadata.createDate);
+        archive(metadata.modifyDate);
+        archive(metadata.metadataDate);
+        archive(metadata.creatorTool);
+        archive(metadata.title);
+        archive(metadata.description);
+        archive(metadata.creator);
+        archive(metadata.subject);
+        archive(metadata.rights);
+        archive(metadata.documentID);
+        archive(metadata.instanceID);
+        archive(metadata.originalDocumentID);
+        archive(metadata.versionID);
+    }
+
+    template<typename Metadata, typename Visitor>
+    std::vector<BYTE> MakeRecord(MetadataType type, const std::wstring& filePath, const MetadataIndex::FileKey& key, const Metadata& metadata, bool wasSuccessful, const Visitor& visit)
+    {
+        std::vector<BYTE> record(sizeof(RecordHeader));
+        RecordWriter writer(record);
+        writer.Write(filePath.data(), filePath.size() * sizeof(wchar_t));
+        visit(writer, metadata);
+        record.resize((record.size() + RecordAlignment - 1) / RecordAlignment * RecordAlignment);
+
+        RecordHeader header{};
+        header.recordSize = static_cast<uint32_t>(record.size());
+        header.pathLength = static_cast<uint16_t>(filePath.size());
+        header.type = static_cast<uint8_t>(type);
+        header.wasSuccessful = wasSuccessful;
+        header.fileSize = key.size;
+        header.lastWriteTime = key.lastWriteTime;
+        memcpy(record.data(), &header, sizeof(header));
+        return record;
+    }
+
+    template<typename Metadata, typename Visitor>
+    bool ReadRecord(const BYTE* record, Metadata& outMetadata, const Visitor& visit)
+    {
+        const RecordHeader header = ReadRecordHeader(record);
+        const size_t payloadOffset = sizeof(RecordHeader) + header.pathLength * sizeof(wchar_t);
+
+        Metadata metadata{};
+        RecordReader reader(record + payloadOffset, header.recordSize - payloadOffset);
+        visit(reader, metadata);
+        if (reader.Failed())
+        {
+            return false;
+        }
+
+        outMetadata = std::move(metadata);
+        return true;
+    }
+
+    const auto visitEXIF = [](auto& archive, auto& metadata) { VisitEXIF(archive, metadata); };
+    const auto visitXMP = [](auto& archive, auto& metadata) { VisitXMP(archive, metadata); };
+}
+
+bool MetadataIndex::GetFileKey(const std::wstring& filePath, FileKey& key)
+{
+    WIN32_FILE_ATTRIBUTE_DATA attr{};
+    if (!GetFileAttributesExW(filePath.c_str(), GetFileExInfoStandard, &attr))
+    {
+        return false;
+    }
+
+    key.size = (static_cast<uint64_t>(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+    key.lastWriteTime = (static_cast<uint64_t>(attr.ftLastWriteTime.dwHighDateTime) << 32) | attr.ftLastWriteTime.dwLowDateTime;
+    return true;
+}
+
+MetadataIndex::MetadataIndex(std::wstring indexFilePath) :
+    indexFilePath(std::move(indexFilePath))
+{
+    Open();
+}
+
+MetadataIndex::~MetadataIndex()
+{
+    Flush();
+    Close();
+}
+
+void MetadataIndex::Open()
+{
+    fileEnd = 0;
+    fileRecordCount = 0;
+
+    // Write sharing lets the instance flushing append while other instances have the index open
+    file = CreateFileW(indexFilePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(IndexFileHeader)) ||
+        fileSize.QuadPart > static_cast<LONGLONG>(MaxIndexFileSize) * 2)
+    {
+        Close();
+        return;
+    }
+
+    mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    view = mapping ? static_cast<const BYTE*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+    if (!view)
+    {
+        Close();
+        return;
+    }
+
+    IndexFileHeader fileHeader;
+    memcpy(&fileHeader, view, sizeof(fileHeader));
+    if (fileHeader.magic != IndexFileMagic || fileHeader.version != IndexFileVersion)
+    {
+        // Written by another version, it gets replaced on the next flush
+        Close();
+        return;
+    }
+
+    // Keep every well formed record up to the first damaged one. A record appended later for the
+    // same path replaces the earlier one, entries still held in memory replace both.
+    const size_t viewSize = static_cast<size_t>(fileSize.QuadPart);
+    size_t offset = sizeof(IndexFileHeader);
+    uint64_t recordCount = 0;
+    for (; recordCount < fileHeader.recordCount && viewSize - offset >= sizeof(RecordHeader); recordCount++)
+    {
+        const RecordHeader header = ReadRecordHeader(view + offset);
+        if (header.recordSize > viewSize - offset ||
+            header.recordSize < sizeof(RecordHeader) + header.pathLength * sizeof(wchar_t) ||
+            header.type >= records.size())
+        {
+            break;
+        }
+
+        std::wstring path(header.pathLength, L'\0');
+        memcpy(path.data(), view + offset + sizeof(RecordHeader), header.pathLength * sizeof(wchar_t));
+        auto& slot = records[header.type][std::move(path)];
+        if (!slot.record || slot.mapped)
+        {
+            slot.record = view + offset;
+            slot.mapped = true;
+        }
+
+        offset += header.recordSize;
+    }
+
+    fileEnd = offset;
+    fileRecordCount = recordCount;
+}
+
+void MetadataIndex::Close()
+{
+    for (auto& map : records)
+    {
+        std::erase_if(map, [](const auto& entry) { return entry.second.mapped; });
+    }
+    fileEnd = 0;
+    fileRecordCount = 0;
+
+    if (view)
+    {
+        UnmapViewOfFile(view);
+        view = nullptr;
+    }
+    if (mapping)
+    {
+        CloseHandle(mapping);
+        mapping = nullptr;
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+    }
+}
+
+const BYTE* MetadataIndex::Find(MetadataType type, const std::wstring& filePath, const FileKey& key, bool& wasSuccessful) const
+{
+    const auto& map = records[static_cast<size_t>(type)];
+    auto it = map.find(filePath);
+    if (it == map.end())
+    {
+        return nullptr;
+    }
+
+    const RecordHeader header = ReadRecordHeader(it->second.record);
+    if (header.fileSize != key.size || header.lastWriteTime != key.lastWriteTime)
+    {
+        // The file changed since it was indexed
+        return nullptr;
+    }
+
+    it->second.touched = true;
+    wasSuccessful = header.wasSuccessful != 0;
+    return it->second.record;
+}
+
+bool MetadataIndex::TryGetEXIF(const std::wstring& filePath, const FileKey& key, EXIFMetadata& outMetadata, bool& wasSuccessful) const
+{
+    std::shared_lock lock(mutex);
+    const BYTE* record = Find(MetadataType::EXIF, filePath, key, wasSuccessful);
+    return record && ReadRecord(record, outMetadata, visitEXIF);
+}
+
+bool MetadataIndex::TryGetXMP(const std::wstring& filePath, const FileKey& key, XMPMetadata& outMetadata, bool& wasSuccessful) const
+{
+    std::shared_lock lock(mutex);
+    const BYTE* record = Find(MetadataType::XMP, filePath, key, wasSuccessful);
+    return record && ReadRecord(record, outMetadata, visitXMP);
+}
+
+void MetadataIndex::Put(MetadataType type, const std::wstring& filePath, std::vector<BYTE> record)
+{
+    std::unique_lock lock(mutex);
+    auto& slot = records[static_cast<size_t>(type)][filePath];
+    slot.record = newRecords.emplace_back(std::move(record)).data();
+    slot.mapped = false;
+    slot.touched = true;
+    pendingRecords.push_back(slot.record);
+}
+
+void MetadataIndex::PutEXIF(const std::wstring& filePath, const FileKey& key, const EXIFMetadata& metadata, bool wasSuccessful)
+{
+    if (filePath.size() <= UINT16_MAX)
+    {
+        Put(MetadataType::EXIF, filePath, MakeRecord(MetadataType::EXIF, filePath, key, metadata, wasSuccessful, visitEXIF));
+    }
+}
+
+void MetadataIndex::PutXMP(const std::wstring& filePath, const FileKey& key, const XMPMetadata& metadata, bool wasSuccessful)
+{
+    if (filePath.size() <= UINT16_MAX)
+    {
+        Put(MetadataType::XMP, filePath, MakeRecord(MetadataType::XMP, filePath, key, metadata, wasSuccessful, visitXMP));
+    }
+}
+
+HRESULT MetadataIndex::Flush()
+{
+    std::unique_lock lock(mutex);
+    if (pendingRecords.empty())
+    {
+        return S_FALSE;
+    }
+
+    uint64_t liveSize = sizeof(IndexFileHeader);
+    for (const auto& map : records)
+    {
+        for (const auto& [path, slot] : map)
+        {
+            liveSize += ReadRecordHeader(slot.record).recordSize;
+        }
+    }
+
+    uint64_t pendingSize = 0;
+    for (const BYTE* record : pendingRecords)
+    {
+        pendingSize += ReadRecordHeader(record).recordSize;
+    }
+
+    // Appending only writes what is new, the file is rewritten when there is no valid file to
+    // append to or when records replaced by newer ones would make up most of it
+    const uint64_t appendedSize = fileEnd + pendingSize;
+    if (view && appendedSize <= MaxIndexFileSize && appendedSize <= liveSize * 2)
+    {
+        const HRESULT hr = Append(pendingSize);
+        if (hr != E_CHANGED_STATE)
+        {
+            return hr;
+        }
+    }
+
+    return Compact(liveSize);
+}
+
+HRESULT MetadataIndex::Append(uint64_t pendingSize)
+{
+    // Only one instance appends at a time, the others keep the index open for reading only
+    HANDLE writer = CreateFileW(indexFilePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (writer == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    // Another instance may have appended to or replaced the file since it was mapped, and a
+    // crash during an earlier append leaves bytes past the last counted record. Either way the
+    // file gets rewritten from what this instance knows.
+    HRESULT hr = S_OK;
+    IndexFileHeader fileHeader{};
+    DWORD read = 0;
+    LARGE_INTEGER fileSize{};
+    if (!ReadFile(writer, &fileHeader, sizeof(fileHeader), &read, nullptr) || !GetFileSizeEx(writer, &fileSize))
+    {
+        hr = HRESULT_FROM_WIN32(GetLastError());
+    }
+    else if (read != sizeof(fileHeader) || fileHeader.magic != IndexFileMagic || fileHeader.version != IndexFileVersion ||
+             fileHeader.recordCount != fileRecordCount || static_cast<uint64_t>(fileSize.QuadPart) != fileEnd ||
+             !IsSameFile(writer, file))
+    {
+        hr = E_CHANGED_STATE;
+    }
+
+    if (SUCCEEDED(hr))
+    {
+        LARGE_INTEGER position{};
+        position.QuadPart = static_cast<LONGLONG>(fileEnd);
+        bool written = SetFilePointerEx(writer, position, nullptr, FILE_BEGIN);
+        for (size_t i = 0; written && i < pendingRecords.size(); i++)
+        {
+            written = WriteAll(writer, pendingRecords[i], ReadRecordHeader(pendingRecords[i]).recordSize);
+        }
+
+        // The records only count once they are on disk, so a crash before the header is updated
+        // leaves the index as it was
+        fileHeader.recordCount = fileRecordCount + pendingRecords.size();
+        position.QuadPart = 0;
+        written = written && FlushFileBuffers(writer) &&
+                  SetFilePointerEx(writer, position, nullptr, FILE_BEGIN) &&
+                  WriteAll(writer, &fileHeader, sizeof(fileHeader));
+        if (!written)
+        {
+            hr = HRESULT_FROM_WIN32(GetLastError());
+            hr = SUCCEEDED(hr) ? E_FAIL : hr;
+        }
+    }
+    CloseHandle(writer);
+
+    if (SUCCEEDED(hr))
+    {
+        fileEnd += pendingSize;
+        fileRecordCount = fileHeader.recordCount;
+        pendingRecords.clear();
+    }
+    return hr;
+}
+
+HRESULT MetadataIndex::Compact(uint64_t liveSize)
+{
+    // Past the size limit, entries not used in this session are left out
+    const bool touchedOnly = liveSize > MaxIndexFileSize;
+
+    std::vector<BYTE> content(sizeof(IndexFileHeader));
+    std::vector<std::pair<Slot*, size_t>> kept;
+    for (auto& map : records)
+    {
+        for (auto& [path, slot] : map)
+        {
+            if (touchedOnly && !slot.touched)
+            {
+                continue;
+            }
+            kept.emplace_back(&slot, content.size());
+            content.insert(content.end(), slot.record, slot.record + ReadRecordHeader(slot.record).recordSize);
+        }
+    }
+
+    const IndexFileHeader fileHeader{ IndexFileMagic, IndexFileVersion, kept.size() };
+    memcpy(content.data(), &fileHeader, sizeof(fileHeader));
+
+    // Write next to the index and swap it in, so a crash never leaves a half written index behind
+    const std::wstring tempFilePath = indexFilePath + L".tmp";
+    HANDLE tempFile = CreateFileW(tempFilePath.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (tempFile == INVALID_HANDLE_VALUE)
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    const bool written = WriteAll(tempFile, content.data(), content.size());
+    const DWORD writeError = GetLastError();
+    CloseHandle(tempFile);
+    if (!written)
+    {
+        DeleteFileW(tempFilePath.c_str());
+        return writeError ? HRESULT_FROM_WIN32(writeError) : E_FAIL;
+    }
+
+    // A mapped file can't be replaced, so the kept records move into memory before the view
+    // goes away. The entries left out come back from the old file if the swap fails.
+    const BYTE* copy = newRecords.emplace_back(std::move(content)).data();
+    for (const auto& [slot, offset] : kept)
+    {
+        slot->record = copy + offset;
+        slot->mapped = false;
+    }
+    Close();
+
+    if (!MoveFileExW(tempFilePath.c_str(), indexFilePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+    {
+        // Most likely another PowerRename instance has the index mapped
+        const HRESULT hr = HRESULT_FROM_WIN32(GetLastError());
+        DeleteFileW(tempFilePath.c_str());
+        Open();
+        return hr;
+    }
+
+    // Everything is in the new file now, map it instead of keeping the copies
+    std::array<std::vector<std::wstring>, 2> touchedPaths;
+    for (size_t type = 0; type < records.size(); type++)
+    {
+        for (const auto& [path, slot] : records[type])
+        {
+            if (slot.touched)
+            {
+                touchedPaths[type].push_back(path);
+            }
+        }
+        records[type].clear();
+    }
+    newRecords.clear();
+    pendingRecords.clear();
+
+    Open();
+    for (size_t type = 0; type < records.size(); type++)
+    {
+        for (const auto& path : touchedPaths[type])
+        {
+            if (auto it = records[type].find(path); it != records[type].end())
+            {
+                it->second.touched = true;
+            }
+        }
+    }
+
+    return S_OK;
+}
@@ -0,0 +1,92 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#pragma once
+#include "MetadataTypes.h"
+#include <array>
+#include <atomic>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace PowerRenameLib
+{
+    /// <summary>
+    /// Persistent index of extracted EXIF/XMP metadata, shared between PowerRename sessions.
+    /// Entries are keyed by file path and are only returned while the file size and last write
+    /// time still match, so unchanged files skip decoding entirely.
+    /// The index file is memory-mapped read-only; entries added during the session are kept in
+    /// memory until Flush appends them to the file. The file is only rewritten when replaced
+    /// entries take up more space than the live ones or it outgrows its size limit.
+    /// </summary>
+    class MetadataIndex
+    {
+    public:
+        struct FileKey
+        {
+            uint64_t size = 0;
+            uint64_t lastWriteTime = 0;
+        };
+
+        static bool GetFileKey(const std::wstring& filePath, FileKey& key);
+
+        explicit MetadataIndex(std::wstring indexFilePath);
+        ~MetadataIndex();
+
+        MetadataIndex(const MetadataIndex&) = delete;
+        MetadataIndex& operator=(const MetadataIndex&) = delete;
+
+        // Return true if the index holds an entry for this version of the file. wasSuccessful
+        // receives the result of the extraction that produced it.
+        bool TryGetEXIF(const std::wstring& filePath, const FileKey& key, EXIFMetadata& outMetadata, bool& wasSuccessful) const;
+        bool TryGetXMP(const std::wstring& filePath, const FileKey& key, XMPMetadata& outMetadata, bool& wasSuccessful) const;
+
+        void PutEXIF(const std::wstring& filePath, const FileKey& key, const EXIFMetadata& metadata, bool wasSuccessful);
+        void PutXMP(const std::wstring& filePath, const FileKey& key, const XMPMetadata& metadata, bool wasSuccessful);
+
+        // Writes the entries added since the last flush to disk. Does nothing if there are none.
+        // On failure every entry stays available and unwritten ones are retried on the next flush.
+        HRESULT Flush();
+
+    private:
+        struct Slot
+        {
+            // Points either into the mapped view or into newRecords
+            const BYTE* record = nullptr;
+            bool mapped = false;
+            // Set when the entry is used this session. Unused entries are dropped first when the
+            // index outgrows its size limit.
+            mutable std::atomic<bool> touched = false;
+        };
+
+        using RecordMap = std::unordered_map<std::wstring, Slot>;
+
+        void Open();
+        // Unmaps the index, dropping the entries that point into it
+        void Close();
+
+        HRESULT Append(uint64_t pendingSize);
+        HRESULT Compact(uint64_t liveSize);
+
+        const BYTE* Find(MetadataType type, const std::wstring& filePath, const FileKey& key, bool& wasSuccessful) const;
+        void Put(MetadataType type, const std::wstring& filePath, std::vector<BYTE> record);
+
+        std::wstring indexFilePath;
+
+        HANDLE file = INVALID_HANDLE_VALUE;
+        HANDLE mapping = nullptr;
+        const BYTE* view = nullptr;
+        // End of the last valid record of the mapped file and how many records lead up to it
+        uint64_t fileEnd = 0;
+        uint64_t fileRecordCount = 0;
+
+        mutable std::shared_mutex mutex;
+        std::array<RecordMap, 2> records;
+        std::deque<std::vector<BYTE>> newRecords;
+        // Records in newRecords which aren't written to the file yet
+        std::vector<const BYTE*> pendingRecords;
+    };
+}
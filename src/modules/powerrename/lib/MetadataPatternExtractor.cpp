@@ -59,6 +59,14 @@ void MetadataPatternExtractor::ClearCache()
     }
 }
 
+void MetadataPatternExtractor::SetPersistentIndex(std::shared_ptr<MetadataIndex> index)
+{
+    if (extractor)
+    {
+        extractor->SetPersistentIndex(std::move(index));
+    }
+}
+
 MetadataPatternMap MetadataPatternExtractor::ExtractEXIFPatterns(const std::wstring& filePath)
 {
     MetadataPatternMap patterns;
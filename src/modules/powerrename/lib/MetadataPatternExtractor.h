@@ -14,6 +14,8 @@ namespace PowerRenameLib
     // Pattern-Value mapping for metadata replacement
     using MetadataPatternMap = std::unordered_map<std::wstring, std::wstring>;
 
+    class MetadataIndex;
+
     /// <summary>
     /// Metadata pattern extractor that converts metadata into replaceable patterns
     /// </summary>
@@ -26,6 +28,7 @@ namespace PowerRenameLib
         MetadataPatternMap ExtractPatterns(const std::wstring& filePath, MetadataType type);
 
         void ClearCache();
+        void SetPersistentIndex(std::shared_ptr<MetadataIndex> index);
 
         static std::vector<std::wstring> GetSupportedPatterns(MetadataType type);
         static std::vector<std::wstring> GetAllPossiblePatterns();
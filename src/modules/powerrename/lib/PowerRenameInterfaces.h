@@ -2,6 +2,7 @@
 #include "pch.h"
 #include "MetadataTypes.h"
 #include "MetadataPatternExtractor.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -46,6 +47,14 @@ enum class PowerRenameItemRenameStatus {
     ItemNameAlreadyExists,
 };
 
+// Matches of the search term in one item name, filled in by IPowerRenameRegEx::ReplaceWithMatches.
+// Callers keep one per item, so that later passes re-expand the matches instead of searching the
+// name again. Only the regex object that produced it knows what it holds.
+struct PowerRenameMatches
+{
+    virtual ~PowerRenameMatches() = default;
+};
+
 interface __declspec(uuid("3ECBA62B-E0F0-4472-AA2E-DEE7A1AA46B9")) IPowerRenameRegExEvents : public IUnknown
 {
 public:
@@ -73,6 +82,9 @@ public:
     IFACEMETHOD(ResetMetadata)() = 0;
     IFACEMETHOD(GetMetadataType)(_Out_ PowerRenameLib::MetadataType* metadataType) = 0;
     IFACEMETHOD(Replace)(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex) = 0;
+    // Same as Replace, reusing the matches held by matches if they were found in this source with
+    // the current search term and flags. Otherwise the source is searched again and matches updated.
+    IFACEMETHOD(ReplaceWithMatches)(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex, _Inout_ std::shared_ptr<const PowerRenameMatches>& matches) = 0;
 };
 
 interface __declspec(uuid("C7F59201-4DE1-4855-A3A2-26FC3279C8A5")) IPowerRenameItem : public IUnknown
@@ -115,6 +127,7 @@ public:
     IFACEMETHOD(OnRegExCanceled)(_In_ DWORD threadId) = 0;
     IFACEMETHOD(OnRegExCompleted)(_In_ DWORD threadId) = 0;
     IFACEMETHOD(OnRenameStarted)() = 0;
+    IFACEMETHOD(OnRenameIncomplete)(_In_ HRESULT hr) = 0;
     IFACEMETHOD(OnRenameCompleted)(_In_ bool closeUIWindowAfterRenaming) = 0;
 };
 
@@ -7,6 +7,13 @@
 #include "helpers.h"
 #include "trace.h"
 #include <Renaming.h>
+#include "BatchRenamer.h"
+#include "Settings.h"
+#include <common/SettingsAPI/settings_helpers.h>
+#include <dll/PowerRenameConstants.h>
+#include <atomic>
+#include <exception>
+#include <thread>
 
 namespace fs = std::filesystem;
 
@@ -15,6 +22,11 @@ extern HINSTANCE g_hostHInst;
 // The default FOF flags to use in the rename operations
 #define FOF_DEFAULTFLAGS (FOF_ALLOWUNDO | FOFX_ADDUNDORECORD | FOFX_SHOWELEVATIONPROMPT | FOF_RENAMEONCOLLISION)
 
+// Number of items a regex worker processes between cancellation checks
+#define REGEX_WORKER_CHUNK_SIZE 256u
+// Metadata extraction is dominated by file I/O, so small chunks keep every worker busy
+#define METADATA_PREFETCH_CHUNK_SIZE 16u
+
 IFACEMETHODIMP_(ULONG)
 CPowerRenameManager::AddRef()
 {
@@ -412,6 +424,10 @@ IFACEMETHODIMP CPowerRenameManager::GetRenameRegEx(_COM_Outptr_ IPowerRenameRegE
 
 IFACEMETHODIMP CPowerRenameManager::PutRenameRegEx(_In_ IPowerRenameRegEx* pRegEx)
 {
+    _CancelRegExWorkerThread();
+    m_lastRegExPass.valid = false;
+    m_itemMatches.clear();
+
     _ClearRegEx();
     m_spRegEx = pRegEx;
     return S_OK;
@@ -485,6 +501,11 @@ HRESULT CPowerRenameManager::s_CreateInstance(_Outptr_ IPowerRenameManager** pps
     return hr;
 }
 
+std::wstring CPowerRenameManager::s_getRenameJournalFolder()
+{
+    return PTSettingsHelper::get_module_save_folder_location(PowerRenameConstants::ModuleKey);
+}
+
 CPowerRenameManager::CPowerRenameManager() :
     m_refCount(1)
 {
@@ -516,6 +537,7 @@ enum
     SRM_REGEX_STARTED, // RegEx operation was started
     SRM_REGEX_CANCELED, // Regex operation was canceled
     SRM_REGEX_COMPLETE, // Regex worker thread completed
+    SRM_FILEOP_INCOMPLETE, // Batch rename stopped with renames that could not be undone
     SRM_FILEOP_COMPLETE // File Operation worker thread completed
 };
 
@@ -586,6 +608,10 @@ LRESULT CPowerRenameManager::_WndProc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM
         _OnRegExCompleted(static_cast<DWORD>(wParam));
         break;
 
+    case SRM_FILEOP_INCOMPLETE:
+        _OnRenameIncomplete(static_cast<HRESULT>(lParam));
+        break;
+
     default:
         lRes = DefWindowProc(hwnd, msg, wParam, lParam);
         break;
@@ -660,6 +686,10 @@ HRESULT CPowerRenameManager::_PerformFileOperation()
     // Wait for existing regex thread to finish
     _WaitForRegExWorkerThread();
 
+    // Renamed items get new original names
+    m_lastRegExPass.valid = false;
+    m_itemMatches.clear();
+
     // Create worker thread which will perform the actual rename
     HRESULT hr = _CreateFileOpWorkerThread();
     if (SUCCEEDED(hr))
@@ -725,6 +755,41 @@ HRESULT CPowerRenameManager::_CreateFileOpWorkerThread()
     return hr;
 }
 
+void CPowerRenameManager::s_updateRenamedItem(_In_ IPowerRenameManager* psrm, _In_ HWND hwndManager, _In_ IPowerRenameItem* pItem, _In_ const std::wstring& newName)
+{
+    // Update item data
+    PWSTR originalName = nullptr;
+    winrt::check_hresult(pItem->GetOriginalName(&originalName));
+    std::wstring originalNameStr{ originalName };
+    CoTaskMemFree(originalName);
+
+    PWSTR path = nullptr;
+    winrt::check_hresult(pItem->GetPath(&path));
+    std::wstring pathStr{ path };
+    CoTaskMemFree(path);
+    size_t oldPathSize = pathStr.size();
+
+    auto fileNamePos = pathStr.find_last_of(L"\\");
+    pathStr.replace(fileNamePos + 1, originalNameStr.length(), newName);
+    pItem->PutPath(pathStr.c_str());
+    pItem->PutOriginalName(newName.c_str());
+    pItem->PutNewName(nullptr);
+
+    // if folder, update children path
+    bool isFolder = false;
+    winrt::check_hresult(pItem->GetIsFolder(&isFolder));
+    if (isFolder)
+    {
+        int id = -1;
+        winrt::check_hresult(pItem->GetId(&id));
+        psrm->UpdateChildrenPath(id, oldPathSize);
+    }
+
+    int id = -1;
+    winrt::check_hresult(pItem->GetId(&id));
+    PostMessage(hwndManager, SRM_REGEX_ITEM_RENAMED_KEEP_UI, GetCurrentThreadId(), id);
+}
+
 DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
 {
     if (SUCCEEDED(CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE)))
@@ -786,7 +851,8 @@ DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
                             }
                         }
 
-                        // From the greatest depth first, add all items of that depth to the operation
+                        // From the greatest depth first, collect the items of that depth to rename
+                        std::vector<std::pair<CComPtr<IPowerRenameItem>, std::wstring>> renames;
                         for (LONG v = static_cast<LONG>(maxDepth); v >= 0; v--)
                         {
                             for (auto it : matrix[v])
@@ -798,54 +864,72 @@ DWORD WINAPI CPowerRenameManager::s_fileOpWorkerThread(_In_ void* pv)
                                     if (SUCCEEDED(spItem->ShouldRenameItem(flags, &shouldRename)) && shouldRename)
                                     {
                                         PWSTR newName = nullptr;
-                                        if (SUCCEEDED(spItem->GetNewName(&newName)))
+                                        if (SUCCEEDED(spItem->GetNewName(&newName)) && newName)
                                         {
-                                            CComPtr<IShellItem> spShellItem;
-                                            if (SUCCEEDED(spItem->GetShellItem(&spShellItem)))
-                                            {
-                                                spFileOp->RenameItem(spShellItem, newName, nullptr);
-                                                if (!closeUIWindowAfterRenaming)
-                                                {
-                                                    // Update item data
-                                                    PWSTR originalName = nullptr;
-                                                    winrt::check_hresult(spItem->GetOriginalName(&originalName));
-                                                    std::wstring originalNameStr{ originalName };
-
-                                                    PWSTR path = nullptr;
-                                                    winrt::check_hresult(spItem->GetPath(&path));
-                                                    std::wstring pathStr{ path };
-                                                    size_t oldPathSize = pathStr.size();
-
-                                                    auto fileNamePos = pathStr.find_last_of(L"\\");
-                                                    pathStr.replace(fileNamePos + 1, originalNameStr.length(), std::wstring{ newName });
-                                                    spItem->PutPath(pathStr.c_str());
-                                                    spItem->PutOriginalName(newName);
-                                                    spItem->PutNewName(nullptr);
-
-                                                    // if folder, update children path
-                                                    bool isFolder = false;
-                                                    winrt::check_hresult(spItem->GetIsFolder(&isFolder));
-                                                    if (isFolder)
-                                                    {
-                                                        int id = -1;
-                                                        winrt::check_hresult(spItem->GetId(&id));
-                                                        pwtd->spsrm->UpdateChildrenPath(id, oldPathSize);
-                                                    }
-
-                                                    int id = -1;
-                                                    winrt::check_hresult(spItem->GetId(&id));
-                                                    PostMessage(pwtd->hwndManager, SRM_REGEX_ITEM_RENAMED_KEEP_UI, GetCurrentThreadId(), id);
-                                                }
-                                            }
-                                            CoTaskMemFree(newName);
+                                            renames.emplace_back(spItem, newName);
                                         }
+                                        CoTaskMemFree(newName);
                                     }
                                 }
                             }
                         }
 
+                        // The batch renamer moves the items directly, children before parents and independent
+                        // items in parallel. If the batch can't be planned or fails and has been rolled back,
+                        // the shell file operation below runs instead. If the rollback itself failed, the items
+                        // are left as they are and the error is reported.
+                        bool renamed = false;
+                        bool incomplete = false;
+                        if (CSettingsInstance().GetUseParallelRename())
+                        {
+                            std::vector<BatchRenamer::Operation> operations;
+                            operations.reserve(renames.size());
+                            for (const auto& [spItem, newName] : renames)
+                            {
+                                PWSTR path = nullptr;
+                                if (SUCCEEDED(spItem->GetPath(&path)))
+                                {
+                                    operations.push_back({ path, newName });
+                                    CoTaskMemFree(path);
+                                }
+                            }
+
+                            BatchRenamer renamer(s_getRenameJournalFolder());
+                            if (operations.size() == renames.size())
+                            {
+                                BatchRenamer::Outcome outcome = BatchRenamer::Outcome::Unchanged;
+                                const HRESULT hr = renamer.Execute(operations, &outcome);
+                                renamed = outcome == BatchRenamer::Outcome::Renamed;
+                                incomplete = outcome == BatchRenamer::Outcome::Incomplete;
+                                if (incomplete)
+                                {
+                                    PostMessage(pwtd->hwndManager, SRM_FILEOP_INCOMPLETE, GetCurrentThreadId(), static_cast<LPARAM>(hr));
+                                }
+                            }
+                        }
+
+                        if (!renamed && !incomplete)
+                        {
+                            for (const auto& [spItem, newName] : renames)
+                            {
+                                CComPtr<IShellItem> spShellItem;
+                                if (SUCCEEDED(spItem->GetShellItem(&spShellItem)))
+                                {
+                                    spFileOp->RenameItem(spShellItem, newName.c_str(), nullptr);
+                                }
+                            }
+                        }
+
+                        if (!closeUIWindowAfterRenaming && !incomplete)
+                        {
+                            for (const auto& [spItem, newName] : renames)
+                            {
+                                s_updateRenamedItem(pwtd->spsrm, pwtd->hwndManager, spItem, newName);
+                            }
+                        }
+
                         // Set the operation flags
-                        if (SUCCEEDED(spFileOp->SetOperationFlags(FOF_DEFAULTFLAGS)))
+                        if (!renamed && !incomplete && SUCCEEDED(spFileOp->SetOperationFlags(FOF_DEFAULTFLAGS)))
                         {
                             // Set the parent window
                             if (pwtd->hwndParent)
@@ -946,25 +1030,157 @@ DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
 
                 winrt::check_hresult(pwtd->spsrm->GetRenameRegEx(&spRenameRegEx));
 
-                UINT itemCount = 0;
-                unsigned long itemEnumIndex = 0;
-                winrt::check_hresult(pwtd->spsrm->GetItemCount(&itemCount));
+                CPowerRenameManager* pThis = static_cast<CPowerRenameManager*>(pwtd->spsrm.p);
+                RegExPassResult& lastPass = pThis->m_lastRegExPass;
+
+                // Take one snapshot of the items instead of walking the map for every index.
+                std::vector<CComPtr<IPowerRenameItem>> items;
+                std::vector<int> itemIds;
+                pThis->_GetItemsSnapshot(items, itemIds);
+                const UINT itemCount = static_cast<UINT>(items.size());
 
+                // The matches of each item from earlier passes, in snapshot order, handed back to
+                // the manager once this pass is over. Items no longer listed drop theirs.
+                std::vector<std::shared_ptr<const PowerRenameMatches>> itemMatches(itemCount);
                 for (UINT u = 0; u < itemCount; u++)
                 {
-                    // Check if cancel event is signaled
-                    if (WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
+                    if (auto it = pThis->m_itemMatches.find(itemIds[u]); it != pThis->m_itemMatches.end())
+                    {
+                        itemMatches[u] = std::move(it->second);
+                    }
+                }
+                auto storeItemMatches = [&]() {
+                    pThis->m_itemMatches.clear();
+                    for (UINT u = 0; u < itemCount; u++)
+                    {
+                        if (itemMatches[u])
+                        {
+                            pThis->m_itemMatches.emplace(itemIds[u], std::move(itemMatches[u]));
+                        }
+                    }
+                };
+
+                PWSTR searchTermRaw = nullptr;
+                winrt::check_hresult(spRenameRegEx->GetSearchTerm(&searchTermRaw));
+                const std::wstring searchTerm{ searchTermRaw ? searchTermRaw : L"" };
+                CoTaskMemFree(searchTermRaw);
+
+                DWORD flags = 0;
+                winrt::check_hresult(spRenameRegEx->GetFlags(&flags));
+
+                PowerRenameLib::MetadataType metadataType = PowerRenameLib::MetadataType::EXIF;
+                spRenameRegEx->GetMetadataType(&metadataType);
+
+                PWSTR replaceTerm = nullptr;
+                winrt::check_hresult(spRenameRegEx->GetReplaceTerm(&replaceTerm));
+
+                // File time and metadata patterns are pushed into the regex object for each item,
+                // so those items have to be processed one at a time.
+                const bool useMetadata = isMetadataUsed(replaceTerm, metadataType);
+                const bool perItemRegExState = isFileTimeUsed(replaceTerm) || useMetadata;
+                CoTaskMemFree(replaceTerm);
+
+                bool completed = true;
+                if (perItemRegExState)
+                {
+                    lastPass.valid = false;
+
+                    if (useMetadata)
+                    {
+                        // Reading metadata is the slow part and does not touch the regex object, so
+                        // load it for all items DoRename reads it for concurrently before the serial pass.
+                        completed = s_parallelForChunks(itemCount, METADATA_PREFETCH_CHUNK_SIZE, pwtd->cancelEvent, [&](UINT begin, UINT end) {
+                            for (UINT u = begin; u < end; u++)
+                            {
+                                PrefetchMetadata(spRenameRegEx, items[u]);
+                            }
+                        });
+                        FlushMetadataIndex();
+                    }
+
+                    unsigned long itemEnumIndex = 0;
+                    for (UINT u = 0; completed && u < itemCount; u++)
+                    {
+                        // Check if cancel event is signaled
+                        if (WaitForSingleObject(pwtd->cancelEvent, 0) == WAIT_OBJECT_0)
+                        {
+                            completed = false;
+                            break;
+                        }
+
+                        DoRename(spRenameRegEx, itemEnumIndex, items[u], &itemMatches[u]);
+                    }
+                    storeItemMatches();
+                }
+                else
+                {
+                    // Items that did not match in the last pass keep their current new name when the
+                    // match set cannot have grown. A full pass overwrites names the last result describes.
+                    const bool reuseLastPass = s_canReuseRegExPass(lastPass, itemIds, searchTerm, flags);
+                    if (!reuseLastPass)
+                    {
+                        lastPass.valid = false;
+                    }
+                    const size_t reusableCount = reuseLastPass ? lastPass.matched.size() : 0;
+
+                    // First pass: compute every new name concurrently, each item counting from 0, and
+                    // remember which items matched.
+                    std::vector<BYTE> matched(itemCount, FALSE);
+                    completed = s_parallelForChunks(itemCount, REGEX_WORKER_CHUNK_SIZE, pwtd->cancelEvent, [&](UINT begin, UINT end) {
+                        for (UINT u = begin; u < end; u++)
+                        {
+                            if (u < reusableCount && !lastPass.matched[u])
+                            {
+                                continue;
+                            }
+
+                            unsigned long itemEnumIndex = 0;
+                            DoRename(spRenameRegEx, itemEnumIndex, items[u], &itemMatches[u]);
+                            matched[u] = itemEnumIndex != 0;
+                        }
+                    });
+
+                    if (completed && (flags & EnumerateItems))
                     {
-                        // Canceled from manager
-                        // Send the manager thread the canceled message
-                        PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, GetCurrentThreadId(), 0);
-                        break;
+                        // A prefix sum over the matches gives each item the counter value the serial
+                        // pass would have reached. Only matched items after the first one need their
+                        // name recomputed with that value.
+                        std::vector<unsigned long> enumIndices(itemCount, 0);
+                        unsigned long runningIndex = 0;
+                        for (UINT u = 0; u < itemCount; u++)
+                        {
+                            enumIndices[u] = runningIndex;
+                            runningIndex += matched[u];
+                        }
+
+                        completed = s_parallelForChunks(itemCount, REGEX_WORKER_CHUNK_SIZE, pwtd->cancelEvent, [&](UINT begin, UINT end) {
+                            for (UINT u = begin; u < end; u++)
+                            {
+                                if (matched[u] && enumIndices[u] != 0)
+                                {
+                                    unsigned long itemEnumIndex = enumIndices[u];
+                                    DoRename(spRenameRegEx, itemEnumIndex, items[u], &itemMatches[u]);
+                                }
+                            }
+                        });
                     }
 
-                    CComPtr<IPowerRenameItem> spItem;
-                    winrt::check_hresult(pwtd->spsrm->GetItemByIndex(u, &spItem));
+                    storeItemMatches();
+                    if (completed)
+                    {
+                        lastPass.valid = true;
+                        lastPass.searchTerm = searchTerm;
+                        lastPass.flags = flags;
+                        lastPass.itemIds = std::move(itemIds);
+                        lastPass.matched = std::move(matched);
+                    }
+                }
 
-                    DoRename(spRenameRegEx, itemEnumIndex, spItem);
+                if (!completed)
+                {
+                    // Canceled from manager
+                    // Send the manager thread the canceled message
+                    PostMessage(pwtd->hwndManager, SRM_REGEX_CANCELED, GetCurrentThreadId(), 0);
                 }
             }
 
@@ -985,6 +1201,123 @@ DWORD WINAPI CPowerRenameManager::s_regexWorkerThread(_In_ void* pv)
     return 0;
 }
 
+bool CPowerRenameManager::s_parallelForChunks(_In_ UINT itemCount, _In_ UINT chunkSize, _In_ HANDLE cancelEvent, _In_ const std::function<void(UINT, UINT)>& processChunk)
+{
+    const UINT chunkCount = (itemCount + chunkSize - 1) / chunkSize;
+    const UINT workerCount = std::min(std::max(std::thread::hardware_concurrency(), 1u), chunkCount);
+
+    std::atomic<UINT> nextChunk = 0;
+    std::atomic<bool> stop = false;
+    std::exception_ptr workerException;
+    std::mutex workerExceptionMutex;
+
+    auto worker = [&]() {
+        while (!stop)
+        {
+            // Cancellation is observed between chunks
+            if (WaitForSingleObject(cancelEvent, 0) == WAIT_OBJECT_0)
+            {
+                stop = true;
+                break;
+            }
+
+            const UINT chunk = nextChunk++;
+            if (chunk >= chunkCount)
+            {
+                break;
+            }
+
+            const UINT begin = chunk * chunkSize;
+            const UINT end = std::min(begin + chunkSize, itemCount);
+            try
+            {
+                processChunk(begin, end);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(workerExceptionMutex);
+                if (!workerException)
+                {
+                    workerException = std::current_exception();
+                }
+                stop = true;
+            }
+        }
+    };
+
+    if (workerCount <= 1)
+    {
+        // Not worth spinning up threads for a single chunk
+        worker();
+    }
+    else
+    {
+        std::vector<std::thread> workers;
+        workers.reserve(workerCount);
+        for (UINT i = 0; i < workerCount; i++)
+        {
+            workers.emplace_back([&worker]() {
+                const HRESULT hrInit = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+                worker();
+                if (SUCCEEDED(hrInit))
+                {
+                    CoUninitialize();
+                }
+            });
+        }
+
+        for (auto& thread : workers)
+        {
+            thread.join();
+        }
+    }
+
+    if (workerException)
+    {
+        std::rethrow_exception(workerException);
+    }
+
+    return !stop;
+}
+
+bool CPowerRenameManager::s_canReuseRegExPass(_In_ const RegExPassResult& lastPass, _In_ const std::vector<int>& itemIds, _In_ const std::wstring& searchTerm, _In_ DWORD flags)
+{
+    // Items may only have been appended since the last pass
+    if (!lastPass.valid || lastPass.flags != flags || itemIds.size() < lastPass.itemIds.size() ||
+        !std::equal(lastPass.itemIds.begin(), lastPass.itemIds.end(), itemIds.begin()))
+    {
+        return false;
+    }
+
+    if (searchTerm == lastPass.searchTerm)
+    {
+        return true;
+    }
+
+    // Every name containing the extended literal also contains the previous one
+    auto isLiteral = [flags](const std::wstring& term) {
+        return !(flags & UseRegularExpressions) || term.find_first_of(L"\\^$.|?*+()[]{}") == std::wstring::npos;
+    };
+
+    return !lastPass.searchTerm.empty() && searchTerm.starts_with(lastPass.searchTerm) &&
+           isLiteral(lastPass.searchTerm) && isLiteral(searchTerm);
+}
+
+void CPowerRenameManager::_GetItemsSnapshot(std::vector<CComPtr<IPowerRenameItem>>& items, std::vector<int>& itemIds)
+{
+    CSRWSharedAutoLock lock(&m_lockItems);
+
+    items.clear();
+    itemIds.clear();
+    items.reserve(m_renameItems.size());
+    itemIds.reserve(m_renameItems.size());
+    for (const auto& [id, item] : m_renameItems)
+    {
+        items.emplace_back(item);
+        itemIds.push_back(id);
+    }
+}
+
 void CPowerRenameManager::_CancelRegExWorkerThread()
 {
     if (m_startRegExWorkerEvent)
@@ -1134,6 +1467,19 @@ void CPowerRenameManager::_OnRenameStarted()
     }
 }
 
+void CPowerRenameManager::_OnRenameIncomplete(_In_ HRESULT hr)
+{
+    CSRWSharedAutoLock lock(&m_lockEvents);
+
+    for (auto it : m_powerRenameManagerEvents)
+    {
+        if (it.pEvents)
+        {
+            it.pEvents->OnRenameIncomplete(hr);
+        }
+    }
+}
+
 void CPowerRenameManager::_OnRenameCompleted()
 {
     CSRWSharedAutoLock lock(&m_lockEvents);
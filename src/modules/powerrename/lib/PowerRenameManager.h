@@ -1,6 +1,8 @@
 #pragma once
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <functional>
 #include "srwlock.h"
 
 #include <PowerRenameInterfaces.h>
@@ -53,6 +55,8 @@ public:
     IFACEMETHODIMP OnMetadataChanged();
 
     static HRESULT s_CreateInstance(_Outptr_ IPowerRenameManager** ppsrm);
+    // Folder of the undo journals of the batch renamer, see BatchRenamer::RecoverJournals
+    static std::wstring s_getRenameJournalFolder();
 
 protected:
     CPowerRenameManager();
@@ -69,6 +73,7 @@ protected:
     void _OnRegExCanceled(_In_ DWORD threadId);
     void _OnRegExCompleted(_In_ DWORD threadId);
     void _OnRenameStarted();
+    void _OnRenameIncomplete(_In_ HRESULT hr);
     void _OnRenameCompleted();
 
     void _ClearEventHandlers();
@@ -82,14 +87,34 @@ protected:
     void _WaitForRegExWorkerThread();
     HRESULT _CreateFileOpWorkerThread();
 
+    void _GetItemsSnapshot(std::vector<CComPtr<IPowerRenameItem>>& items, std::vector<int>& itemIds);
+
     HRESULT _EnsureRegEx();
     HRESULT _InitRegEx();
     void _ClearRegEx();
 
     // Thread proc for performing the regex rename of each item
     static DWORD WINAPI s_regexWorkerThread(_In_ void* pv);
+    // Splits [0, itemCount) into chunks processed concurrently. Returns false if canceled.
+    static bool s_parallelForChunks(_In_ UINT itemCount, _In_ UINT chunkSize, _In_ HANDLE cancelEvent, _In_ const std::function<void(UINT, UINT)>& processChunk);
+
+    // Outcome of the last completed parallel preview pass. Edits to the replace term, or a literal
+    // search term that only got longer, never turn a non-matching item into a matching one, so the
+    // next pass only needs to revisit the items that matched.
+    struct RegExPassResult
+    {
+        bool valid = false;
+        std::wstring searchTerm;
+        DWORD flags = 0;
+        std::vector<int> itemIds;
+        std::vector<BYTE> matched;
+    };
+
+    static bool s_canReuseRegExPass(_In_ const RegExPassResult& lastPass, _In_ const std::vector<int>& itemIds, _In_ const std::wstring& searchTerm, _In_ DWORD flags);
     // Thread proc for performing the actual file operation that does the file rename
     static DWORD WINAPI s_fileOpWorkerThread(_In_ void* pv);
+    // Points a renamed item at its new path and name, and notifies the UI when it stays open
+    static void s_updateRenamedItem(_In_ IPowerRenameManager* psrm, _In_ HWND hwndManager, _In_ IPowerRenameItem* pItem, _In_ const std::wstring& newName);
 
     static LRESULT CALLBACK s_msgWndProc(_In_ HWND hwnd, _In_ UINT uMsg, _In_ WPARAM wParam, _In_ LPARAM lParam);
     LRESULT _WndProc(_In_ HWND hwnd, _In_ UINT msg, _In_ WPARAM wParam, _In_ LPARAM lParam);
@@ -119,6 +144,13 @@ protected:
         DWORD cookie;
     };
 
+    // Only accessed by the regex worker thread, or after waiting for it
+    RegExPassResult m_lastRegExPass;
+    // Search matches of the items that matched, by item id. A record is only reused while the
+    // search term, the flags and the item name it was found with are unchanged, so edits to the
+    // replace term re-expand it instead of searching again.
+    std::unordered_map<int, std::shared_ptr<const PowerRenameMatches>> m_itemMatches;
+
     CComPtr<IPowerRenameItemFactory> m_spItemFactory;
     CComPtr<IPowerRenameRegEx> m_spRegEx;
 
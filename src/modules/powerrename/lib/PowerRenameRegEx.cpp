@@ -156,6 +156,8 @@ IFACEMETHODIMP CPowerRenameRegEx::PutSearchTerm(_In_ PCWSTR searchTerm, bool for
                 hr = SHStrDup(normalizedSearchTerm.c_str(), &m_searchTerm);
             }
         }
+
+        _UpdateCompiledPattern();
     }
 
     if (SUCCEEDED(hr) && changed)
@@ -326,7 +328,11 @@ IFACEMETHODIMP CPowerRenameRegEx::PutFlags(_In_ DWORD flags)
             (!!(m_flags & EnumerateItems) != newEnumerate) ||
             (!!(m_flags & RandomizeItems) != newRandomizer);
 
-        m_flags = flags;
+        {
+            CSRWExclusiveAutoLock lock(&m_lock);
+            m_flags = flags;
+            _UpdateCompiledPattern();
+        }
 
         if (refreshReplaceTerm)
         {
@@ -410,6 +416,7 @@ CPowerRenameRegEx::CPowerRenameRegEx() :
     SHStrDup(L"", &m_replaceTerm);
 
     _useBoostLib = CSettingsInstance().GetUseBoostLib();
+    _UpdateCompiledPattern();
 }
 
 CPowerRenameRegEx::~CPowerRenameRegEx()
@@ -418,20 +425,149 @@ CPowerRenameRegEx::~CPowerRenameRegEx()
     CoTaskMemFree(m_replaceTerm);
 }
 
-template<bool Std, class Regex = conditional_t<Std, std::wregex, boost::wregex>, class Options = decltype(Regex::icase)>
-static std::wstring RegexReplaceEx(const std::wstring& source, const std::wstring& searchTerm, const std::wstring& replaceTerm, const bool matchAll, const bool caseInsensitive)
+// Flags that change how the search term is compiled. Any other flag change reuses the cached pattern.
+static constexpr DWORD CompiledPatternFlagsMask = CaseSensitive | UseRegularExpressions;
+
+void CPowerRenameRegEx::_UpdateCompiledPattern()
 {
-    Regex pattern(searchTerm, Options::ECMAScript | (caseInsensitive ? Options::icase : Options{}));
+    const std::wstring searchTerm = m_searchTerm ? m_searchTerm : L"";
+    const DWORD flags = m_flags & CompiledPatternFlagsMask;
+
+    if (m_compiledPattern && m_compiledPattern->searchTerm == searchTerm &&
+        m_compiledPattern->flags == flags && m_compiledPattern->useBoostLib == _useBoostLib)
+    {
+        return;
+    }
+
+    auto compiled = std::make_shared<CompiledPattern>();
+    compiled->searchTerm = searchTerm;
+    compiled->flags = flags;
+    compiled->useBoostLib = _useBoostLib;
+
+    const bool isCaseInsensitive = !(flags & CaseSensitive);
+    if (!(flags & UseRegularExpressions))
+    {
+        compiled->literal = LiteralMatcher(searchTerm, isCaseInsensitive);
+    }
+    else if (!searchTerm.empty())
+    {
+        try
+        {
+            if (_useBoostLib)
+            {
+                compiled->boostRegex.emplace(searchTerm, boost::wregex::ECMAScript | (isCaseInsensitive ? boost::wregex::icase : boost::wregex::normal));
+            }
+            else
+            {
+                compiled->stdRegex.emplace(searchTerm, std::wregex::ECMAScript | (isCaseInsensitive ? std::wregex::icase : std::wregex::flag_type{}));
+            }
+        }
+        catch (regex_error&)
+        {
+            // The user is likely still typing the expression. Replace reports E_FAIL until it compiles.
+        }
+        catch (boost::regex_error&)
+        {
+        }
+    }
 
+    m_compiledPattern = std::move(compiled);
+}
+
+template<bool Std>
+struct RegexEngine
+{
+    using Regex = conditional_t<Std, std::wregex, boost::wregex>;
+    using Match = conditional_t<Std, std::wsmatch, boost::wsmatch>;
+    using Iterator = conditional_t<Std, std::wsregex_iterator, boost::wsregex_iterator>;
     using Flags = conditional_t<Std, std::regex_constants::match_flag_type, boost::regex_constants::match_flags>;
-    const auto flags = matchAll ? Flags::match_default : Flags::format_first_only;
 
-    return regex_replace(source, pattern, replaceTerm, flags);
+    static Flags MatchFlags(const bool matchAll)
+    {
+        return matchAll ? Flags::match_default : Flags::format_first_only;
+    }
+};
+
+// Returns the matches of the pattern in source, either from the caller's record of an earlier
+// search or by running the regex once. Only names that matched get a record: those are the only
+// ones a later replace term edit needs to revisit.
+template<bool Std, class Engine = RegexEngine<Std>>
+static std::shared_ptr<const CPowerRenameRegEx::MatchRecord<typename Engine::Match>> FindMatches(
+    const std::wstring& searchTerm,
+    const DWORD flags,
+    const typename Engine::Regex& pattern,
+    const std::wstring& source,
+    const bool matchAll,
+    std::shared_ptr<const PowerRenameMatches>& cached)
+{
+    using Record = CPowerRenameRegEx::MatchRecord<typename Engine::Match>;
+
+    // A record of the other regex engine fails the cast
+    if (auto found = std::dynamic_pointer_cast<const Record>(cached);
+        found && found->matchAll == matchAll && found->flags == flags && found->searchTerm == searchTerm && found->source == source)
+    {
+        return found;
+    }
+
+    auto record = std::make_shared<Record>();
+    record->searchTerm = searchTerm;
+    record->flags = flags;
+    record->source = source;
+    record->matchAll = matchAll;
+
+    // Iterate over the record's own copy of the source, the stored matches refer to it.
+    const auto matchFlags = Engine::MatchFlags(matchAll);
+    for (typename Engine::Iterator it(record->source.cbegin(), record->source.cend(), pattern, matchFlags), end; it != end; ++it)
+    {
+        record->matches.push_back(*it);
+        if (!matchAll)
+        {
+            break;
+        }
+    }
+
+    if (record->matches.empty())
+    {
+        cached.reset();
+    }
+    else
+    {
+        cached = record;
+    }
+
+    return record;
 }
 
-static constexpr std::array RegexReplaceDispatch = { RegexReplaceEx<true>, RegexReplaceEx<false> };
+// Builds the replaced name from previously found matches. Mirrors regex_replace, which is
+// specified in terms of regex_iterator and match_results::format. Returns whether anything matched,
+// which is the basis for incrementing the counter.
+template<bool Std, class Engine = RegexEngine<Std>>
+static bool ExpandMatches(const CPowerRenameRegEx::MatchRecord<typename Engine::Match>& record, const std::wstring& replaceTerm, std::wstring& result)
+{
+    const auto flags = Engine::MatchFlags(record.matchAll);
+
+    result.clear();
+    result.reserve(record.source.size() + replaceTerm.size());
+
+    auto suffixStart = record.source.cbegin();
+    for (const auto& match : record.matches)
+    {
+        result.append(match.prefix().first, match.prefix().second);
+        match.format(std::back_inserter(result), replaceTerm, flags);
+        suffixStart = match[0].second;
+    }
+    result.append(suffixStart, record.source.cend());
+
+    return !record.matches.empty();
+}
 
 HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex)
+{
+    std::shared_ptr<const PowerRenameMatches> matches;
+    return ReplaceWithMatches(source, result, enumIndex, matches);
+}
+
+HRESULT CPowerRenameRegEx::ReplaceWithMatches(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex, _Inout_ std::shared_ptr<const PowerRenameMatches>& matches)
 {
     *result = nullptr;
 
@@ -447,7 +583,6 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result, u
     std::wstring res = normalizedSource;
     try
     {
-        // TODO: creating the regex could be costly.  May want to cache this.
         wchar_t newReplaceTerm[MAX_PATH] = { 0 };
         bool fileTimeErrorOccurred = false;
         bool metadataErrorOccurred = false;
@@ -488,7 +623,6 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result, u
         std::wstring sourceToUse = normalizedSource;
         sourceToUse.reserve(MAX_PATH);
 
-        std::wstring searchTerm(m_searchTerm);
         std::wstring replaceTerm;
         if (appliedTemplateTransform)
         {
@@ -575,75 +709,49 @@ HRESULT CPowerRenameRegEx::Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result, u
         }
 
         bool shouldIncrementCounter = false;
-        const bool isCaseInsensitive = !(m_flags & CaseSensitive);
 
         if (m_flags & UseRegularExpressions)
         {
             replaceTerm = regex_replace(replaceTerm, zeroGroupRegex, L"$1$$$0");
             replaceTerm = regex_replace(replaceTerm, otherGroupsRegex, L"$1$0$4");
 
-            res = RegexReplaceDispatch[_useBoostLib](sourceToUse, m_searchTerm, replaceTerm, m_flags & MatchAllOccurrences, isCaseInsensitive);
+            if (!m_compiledPattern || !(m_compiledPattern->stdRegex || m_compiledPattern->boostRegex))
+            {
+                return E_FAIL;
+            }
 
-            // Use regex search to determine if a match exists. This is the basis for incrementing
-            // the counter.
-            if (_useBoostLib)
+            const bool matchAll = m_flags & MatchAllOccurrences;
+            const auto& pattern = *m_compiledPattern;
+            if (pattern.boostRegex)
             {
-                boost::wregex pattern(m_searchTerm, boost::wregex::ECMAScript | (isCaseInsensitive ? boost::wregex::icase : boost::wregex::normal));
-                shouldIncrementCounter = boost::regex_search(sourceToUse, pattern);
+                const auto record = FindMatches<false>(pattern.searchTerm, pattern.flags, *pattern.boostRegex, sourceToUse, matchAll, matches);
+                shouldIncrementCounter = ExpandMatches<false>(*record, replaceTerm, res);
             }
             else
             {
-                auto regexFlags = std::wregex::ECMAScript;
-                if (isCaseInsensitive)
-                {
-                    regexFlags |= std::wregex::icase;
-                }
-                std::wregex pattern(m_searchTerm, regexFlags);
-                shouldIncrementCounter = std::regex_search(sourceToUse, pattern);
+                const auto record = FindMatches<true>(pattern.searchTerm, pattern.flags, *pattern.stdRegex, sourceToUse, matchAll, matches);
+                shouldIncrementCounter = ExpandMatches<true>(*record, replaceTerm, res);
             }
         }
         else
         {
             // Simple search and replace.
-            size_t pos = 0;
-            do
-            {
-                pos = _Find(sourceToUse, searchTerm, isCaseInsensitive, pos);
-                if (pos != std::string::npos)
-                {
-                    res = sourceToUse.replace(pos, searchTerm.length(), replaceTerm);
-                    pos += replaceTerm.length();
-                    shouldIncrementCounter = true;
-                }
-                if (!(m_flags & MatchAllOccurrences))
-                {
-                    break;
-                }
-            } while (pos != std::string::npos);
+            shouldIncrementCounter = m_compiledPattern->literal.Replace(sourceToUse, replaceTerm, m_flags & MatchAllOccurrences, res);
         }
         hr = SHStrDup(res.c_str(), result);
 
         if (shouldIncrementCounter)
             enumIndex++;
     }
-    catch (regex_error e)
+    catch (regex_error&)
     {
         hr = E_FAIL;
     }
-    return hr;
-}
-
-size_t CPowerRenameRegEx::_Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos)
-{
-    if (caseInsensitive)
+    catch (boost::regex_error&)
     {
-        // Convert to lower
-        std::transform(data.begin(), data.end(), data.begin(), ::towlower);
-        std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+        hr = E_FAIL;
     }
-
-    // Find sub string position in given string starting at position pos
-    return data.find(toSearch, pos);
+    return hr;
 }
 
 void CPowerRenameRegEx::_OnSearchTermChanged()
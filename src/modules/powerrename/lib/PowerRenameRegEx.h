@@ -2,7 +2,11 @@
 #include "pch.h"
 #include "srwlock.h"
 
+#include <optional>
+#include <boost/regex.hpp>
+
 #include "Enumerating.h"
+#include "LiteralMatcher.h"
 
 #include "Randomizer.h"
 #include "MetadataTypes.h"
@@ -35,12 +39,26 @@ public:
     IFACEMETHODIMP ResetMetadata();
     IFACEMETHODIMP GetMetadataType(_Out_ PowerRenameLib::MetadataType* metadataType);
     IFACEMETHODIMP Replace(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex);
+    IFACEMETHODIMP ReplaceWithMatches(_In_ PCWSTR source, _Outptr_ PWSTR* result, unsigned long& enumIndex, _Inout_ std::shared_ptr<const PowerRenameMatches>& matches);
     
     // Get current metadata type based on flags
     PowerRenameLib::MetadataType GetMetadataType() const;
 
     static HRESULT s_CreateInstance(_Outptr_ IPowerRenameRegEx** renameRegEx);
 
+    // Regex matches found in one source name, handed out through ReplaceWithMatches. The record
+    // is only reused while the search term, the flags it was compiled with and the source are the
+    // same. The match iterators point into source, so a record is never modified once published.
+    template<class Match>
+    struct MatchRecord : PowerRenameMatches
+    {
+        std::wstring searchTerm;
+        DWORD flags = 0;
+        bool matchAll = false;
+        std::wstring source;
+        std::vector<Match> matches;
+    };
+
 protected:
     CPowerRenameRegEx();
     virtual ~CPowerRenameRegEx();
@@ -53,7 +71,20 @@ protected:
     HRESULT _OnEnumerateOrRandomizeItemsChanged();
     PowerRenameLib::MetadataType _GetMetadataTypeFromFlags() const;
 
-    size_t _Find(std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos);
+    // Compiled form of the current search term. Rebuilt under the exclusive lock whenever
+    // the search term, the case sensitivity/regex flags or the regex engine change, and
+    // shared read-only by every Replace call of a preview pass.
+    struct CompiledPattern
+    {
+        std::wstring searchTerm;
+        DWORD flags = 0;
+        bool useBoostLib = false;
+        std::optional<std::wregex> stdRegex;
+        std::optional<boost::wregex> boostRegex;
+        LiteralMatcher literal;
+    };
+
+    void _UpdateCompiledPattern();
 
     bool _useBoostLib = false;
     DWORD m_flags = DEFAULT_FLAGS;
@@ -70,6 +101,8 @@ protected:
     CSRWLock m_lock;
     CSRWLock m_lockEvents;
 
+    _Guarded_by_(m_lock) std::shared_ptr<const CompiledPattern> m_compiledPattern;
+
     DWORD m_cookie = 0;
 
     std::vector<Enumerator> m_enumerators;
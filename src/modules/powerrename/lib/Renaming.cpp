@@ -8,9 +8,70 @@
 #include <Helpers.h>
 #include "MetadataPatternExtractor.h"
 #include "PowerRenameRegEx.h"
+#include "MetadataIndex.h"
+#include "Settings.h"
+#include <common/SettingsAPI/settings_helpers.h>
+#include <dll/PowerRenameConstants.h>
 namespace fs = std::filesystem;
 
-bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnumIndex, CComPtr<IPowerRenameItem>& spItem)
+namespace
+{
+    const wchar_t c_metadataIndexFileName[] = L"\\power-rename-metadata-index";
+
+    std::mutex s_metadataMutex; // Mutex to protect static variables
+    std::once_flag s_metadataExtractorInitFlag;
+    std::shared_ptr<PowerRenameLib::MetadataPatternExtractor> s_metadataExtractor;
+    std::shared_ptr<PowerRenameLib::MetadataIndex> s_metadataIndex;
+    std::optional<PowerRenameLib::MetadataType> s_activeMetadataType;
+
+    // Returns the extractor shared by every item, which caches what it has read
+    PowerRenameLib::MetadataPatternExtractor& GetMetadataExtractor(PowerRenameLib::MetadataType metadataType)
+    {
+        // Initialize the extractor only once
+        std::call_once(s_metadataExtractorInitFlag, []() {
+            s_metadataExtractor = std::make_shared<PowerRenameLib::MetadataPatternExtractor>();
+            if (CSettingsInstance().GetPersistMetadataIndex())
+            {
+                const std::wstring folder = PTSettingsHelper::get_module_save_folder_location(PowerRenameConstants::ModuleKey);
+                s_metadataIndex = std::make_shared<PowerRenameLib::MetadataIndex>(folder + c_metadataIndexFileName);
+                s_metadataExtractor->SetPersistentIndex(s_metadataIndex);
+            }
+        });
+
+        // Protect access to shared state
+        {
+            std::lock_guard<std::mutex> lock(s_metadataMutex);
+
+            // Clear cache if metadata type has changed
+            if (s_activeMetadataType.has_value() && s_activeMetadataType.value() != metadataType)
+            {
+                s_metadataExtractor->ClearCache();
+            }
+
+            // Update the active metadata type
+            s_activeMetadataType = metadataType;
+        }
+
+        return *s_metadataExtractor;
+    }
+
+    // Items the flags keep from being renamed. DoRename clears their new name without
+    // reading their metadata.
+    bool isExcluded(DWORD flags, CComPtr<IPowerRenameItem>& spItem)
+    {
+        bool isFolder = false;
+        bool isSubFolderContent = false;
+        winrt::check_hresult(spItem->GetIsFolder(&isFolder));
+        winrt::check_hresult(spItem->GetIsSubFolderContent(&isSubFolderContent));
+
+        return (isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
+               (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
+               (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders)) ||
+               (isFolder && (flags & PowerRenameFlags::ExtensionOnly));
+    }
+}
+
+bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnumIndex, CComPtr<IPowerRenameItem>& spItem, std::shared_ptr<const PowerRenameMatches>* matches)
 {
     bool wouldRename = false;
     DWORD flags = 0;
@@ -31,9 +92,7 @@ bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnum
     winrt::check_hresult(spItem->GetId(&id));
 
     bool isFolder = false;
-    bool isSubFolderContent = false;
     winrt::check_hresult(spItem->GetIsFolder(&isFolder));
-    winrt::check_hresult(spItem->GetIsSubFolderContent(&isSubFolderContent));
 
     // Get metadata type to check if metadata patterns are used
     PowerRenameLib::MetadataType metadataType;
@@ -57,10 +116,7 @@ bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnum
     }
 
     CoTaskMemFree(replaceTerm);
-    if ((isFolder && (flags & PowerRenameFlags::ExcludeFolders)) ||
-        (!isFolder && (flags & PowerRenameFlags::ExcludeFiles)) ||
-        (isSubFolderContent && (flags & PowerRenameFlags::ExcludeSubfolders)) ||
-        (isFolder && (flags & PowerRenameFlags::ExtensionOnly)))
+    if (isExcluded(flags, spItem))
     {
         // Exclude this item from renaming.  Ensure new name is cleared.
         winrt::check_hresult(spItem->PutNewName(nullptr));
@@ -124,32 +180,7 @@ bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnum
         }
         // Extract all patterns for the selected metadata type
         // At this point we know the file is a supported image format (jpg/jpeg/png/tif/tiff)
-        static std::mutex s_metadataMutex; // Mutex to protect static variables
-        static std::once_flag s_metadataExtractorInitFlag;
-        static std::shared_ptr<PowerRenameLib::MetadataPatternExtractor> s_metadataExtractor;
-        static std::optional<PowerRenameLib::MetadataType> s_activeMetadataType;
-
-        // Initialize the extractor only once
-        std::call_once(s_metadataExtractorInitFlag, []() {
-            s_metadataExtractor = std::make_shared<PowerRenameLib::MetadataPatternExtractor>();
-        });
-
-        // Protect access to shared state
-        {
-            std::lock_guard<std::mutex> lock(s_metadataMutex);
-
-            // Clear cache if metadata type has changed
-            if (s_activeMetadataType.has_value() && s_activeMetadataType.value() != metadataType)
-            {
-                s_metadataExtractor->ClearCache();
-            }
-
-            // Update the active metadata type
-            s_activeMetadataType = metadataType;
-        }
-
-        // Extract patterns (this can be done outside the lock if ExtractPatterns is thread-safe)
-        PowerRenameLib::MetadataPatternMap patterns = s_metadataExtractor->ExtractPatterns(filePathStr, metadataType);
+        PowerRenameLib::MetadataPatternMap patterns = GetMetadataExtractor(metadataType).ExtractPatterns(filePathStr, metadataType);
         
         // Always call PutMetadataPatterns to ensure all patterns get replaced
         // Even if empty, this keeps metadata placeholders consistent when no values are extracted
@@ -160,7 +191,14 @@ bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnum
 
     // Failure here means we didn't match anything or had nothing to match
     // Call put_newName with null in that case to reset it
-    winrt::check_hresult(spRenameRegEx->Replace(sourceName, &newName, itemEnumIndex));
+    if (matches)
+    {
+        winrt::check_hresult(spRenameRegEx->ReplaceWithMatches(sourceName, &newName, itemEnumIndex, *matches));
+    }
+    else
+    {
+        winrt::check_hresult(spRenameRegEx->Replace(sourceName, &newName, itemEnumIndex));
+    }
 
     if (useFileTime)
     {
@@ -285,3 +323,47 @@ bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnum
 
     return wouldRename;
 }
+
+void PrefetchMetadata(CComPtr<IPowerRenameRegEx>& spRenameRegEx, CComPtr<IPowerRenameItem>& spItem)
+{
+    // DoRename previews unselected items too, so only the items it skips are skipped here
+    DWORD flags = 0;
+    winrt::check_hresult(spRenameRegEx->GetFlags(&flags));
+    if (isExcluded(flags, spItem))
+    {
+        return;
+    }
+
+    PowerRenameLib::MetadataType metadataType;
+    if (FAILED(spRenameRegEx->GetMetadataType(&metadataType)))
+    {
+        metadataType = PowerRenameLib::MetadataType::EXIF;
+    }
+
+    bool isFolder = false;
+    winrt::check_hresult(spItem->GetIsFolder(&isFolder));
+
+    PWSTR replaceTerm = nullptr;
+    winrt::check_hresult(spRenameRegEx->GetReplaceTerm(&replaceTerm));
+    std::wstring replaceTermStr(replaceTerm ? replaceTerm : L"");
+    CoTaskMemFree(replaceTerm);
+
+    PWSTR filePath = nullptr;
+    winrt::check_hresult(spItem->GetPath(&filePath));
+    std::wstring filePathStr(filePath);
+    CoTaskMemFree(filePath);
+
+    // Same condition DoRename uses to decide whether it needs the metadata of this item
+    if (isMetadataUsed(replaceTermStr.c_str(), metadataType, filePathStr.c_str(), isFolder))
+    {
+        GetMetadataExtractor(metadataType).ExtractPatterns(filePathStr, metadataType);
+    }
+}
+
+void FlushMetadataIndex()
+{
+    if (s_metadataIndex)
+    {
+        s_metadataIndex->Flush();
+    }
+}
@@ -2,4 +2,12 @@
 
 #include <PowerRenameInterfaces.h>
 
-bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnumIndex, CComPtr<IPowerRenameItem>& spItem);
+// matches, if given, holds the search matches of the item from an earlier call and is updated
+bool DoRename(CComPtr<IPowerRenameRegEx>& spRenameRegEx, unsigned long& itemEnumIndex, CComPtr<IPowerRenameItem>& spItem, std::shared_ptr<const PowerRenameMatches>* matches = nullptr);
+
+// Loads the metadata DoRename is going to need for an item into the shared cache.
+// Safe to call for several items concurrently.
+void PrefetchMetadata(CComPtr<IPowerRenameRegEx>& spRenameRegEx, CComPtr<IPowerRenameItem>& spItem);
+
+// Persists what was added to the metadata index, if the index is enabled
+void FlushMetadataIndex();
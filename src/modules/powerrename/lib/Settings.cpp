@@ -26,6 +26,8 @@ namespace
     const wchar_t c_replaceText[] = L"ReplaceText";
     const wchar_t c_mruEnabled[] = L"MRUEnabled";
     const wchar_t c_useBoostLib[] = L"UseBoostLib";
+    const wchar_t c_persistMetadataIndex[] = L"PersistMetadataIndex";
+    const wchar_t c_useParallelRename[] = L"UseParallelRename";
     const wchar_t c_lastWindowWidth[] = L"LastWindowWidth";
     const wchar_t c_lastWindowHeight[] = L"LastWindowHeight";
 
@@ -51,6 +53,8 @@ void CSettings::Save()
     jsonData.SetNamedValue(c_mruEnabled, json::value(settings.MRUEnabled));
     jsonData.SetNamedValue(c_maxMRUSize, json::value(settings.maxMRUSize));
     jsonData.SetNamedValue(c_useBoostLib, json::value(settings.useBoostLib));
+    jsonData.SetNamedValue(c_persistMetadataIndex, json::value(settings.persistMetadataIndex));
+    jsonData.SetNamedValue(c_useParallelRename, json::value(settings.useParallelRename));
 
     json::to_file(moduleJsonFilePath, jsonData);
     GetSystemTimeAsFileTime(&lastLoadedTime);
@@ -123,6 +127,8 @@ void CSettings::MigrateFromRegistry()
     LastRunSettingsInstance().SetReplaceText(GetRegString(c_replaceText, L""));
 
     settings.useBoostLib = false; // Never existed in registry, disabled by default.
+    settings.persistMetadataIndex = false; // Never existed in registry, disabled by default.
+    settings.useParallelRename = false; // Never existed in registry, disabled by default.
 }
 
 void CSettings::ParseJson()
@@ -157,6 +163,14 @@ void CSettings::ParseJson()
             {
                 settings.useBoostLib = jsonSettings.GetNamedBoolean(c_useBoostLib);
             }
+            if (json::has(jsonSettings, c_persistMetadataIndex, json::JsonValueType::Boolean))
+            {
+                settings.persistMetadataIndex = jsonSettings.GetNamedBoolean(c_persistMetadataIndex);
+            }
+            if (json::has(jsonSettings, c_useParallelRename, json::JsonValueType::Boolean))
+            {
+                settings.useParallelRename = jsonSettings.GetNamedBoolean(c_useParallelRename);
+            }
         }
         catch (const winrt::hresult_error&)
         {
@@ -60,6 +60,26 @@ public:
         settings.useBoostLib = useBoostLib;
     }
 
+    inline bool GetPersistMetadataIndex() const
+    {
+        return settings.persistMetadataIndex;
+    }
+
+    inline void SetPersistMetadataIndex(bool persistMetadataIndex)
+    {
+        settings.persistMetadataIndex = persistMetadataIndex;
+    }
+
+    inline bool GetUseParallelRename() const
+    {
+        return settings.useParallelRename;
+    }
+
+    inline void SetUseParallelRename(bool useParallelRename)
+    {
+        settings.useParallelRename = useParallelRename;
+    }
+
     inline bool GetMRUEnabled() const
     {
         return settings.MRUEnabled;
@@ -102,6 +122,8 @@ private:
         bool extendedContextMenuOnly{ false }; // Disabled by default.
         bool persistState{ true };
         bool useBoostLib{ false }; // Disabled by default.
+        bool persistMetadataIndex{ false }; // Disabled by default.
+        bool useParallelRename{ false }; // Disabled by default.
         bool MRUEnabled{ true };
         unsigned int maxMRUSize{ 10 };
         unsigned int flags{ 0 };
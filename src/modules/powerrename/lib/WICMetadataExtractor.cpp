@@ -5,6 +5,8 @@
 #include "pch.h"
 #include "WICMetadataExtractor.h"
 #include "MetadataFormatHelper.h"
+#include "MetadataIndex.h"
+#include "MetadataHeaderParser.h"
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
@@ -401,6 +403,65 @@ namespace
 
         return localTime;
     }
+
+    std::optional<SYSTEMTIME> ParseDateTimeString(const std::wstring& value)
+    {
+        const std::wstring normalized = TrimWhitespace(value);
+        if (normalized.empty())
+        {
+            return std::nullopt;
+        }
+
+        if (auto exifDate = ParseExifDateTime(normalized))
+        {
+            return exifDate;
+        }
+
+        if (auto isoDate = ParseIso8601DateTime(normalized))
+        {
+            return isoDate;
+        }
+
+        return std::nullopt;
+    }
+
+    // Reads metadata straight from the headers of JPEG, TIFF and HEIF/AVIF files, without
+    // creating a WIC decoder. Returns false if the file can't be opened or the container isn't
+    // one the header parser supports.
+    template<typename Parse>
+    bool ParseFileHeaders(const std::wstring& filePath, Parse&& parse)
+    {
+        HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+
+        bool result = false;
+        LARGE_INTEGER fileSize{};
+        if (GetFileSizeEx(file, &fileSize))
+        {
+            MetadataHeaderParser parser(
+                [file](uint64_t offset, void* buffer, size_t size) -> size_t {
+                    OVERLAPPED overlapped{};
+                    overlapped.Offset = static_cast<DWORD>(offset);
+                    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+                    DWORD bytesRead = 0;
+                    if (size > MAXDWORD || !ReadFile(file, buffer, static_cast<DWORD>(size), &bytesRead, &overlapped))
+                    {
+                        return 0;
+                    }
+                    return bytesRead;
+                },
+                static_cast<uint64_t>(fileSize.QuadPart));
+
+            result = parse(parser);
+        }
+
+        CloseHandle(file);
+        return result;
+    }
 // Global WIC factory management with thread-safe access
     CComPtr<IWICImagingFactory> g_wicFactory;
     std::once_flag g_wicInitFlag;
@@ -448,10 +509,29 @@ bool WICMetadataExtractor::ExtractEXIFMetadata(
     EXIFMetadata& outMetadata)
 {
     return cache.GetOrLoadEXIF(filePath, outMetadata, [this, &filePath](EXIFMetadata& metadata) {
-        return LoadEXIFMetadata(filePath, metadata);
+        MetadataIndex::FileKey key;
+        const bool useIndex = persistentIndex && MetadataIndex::GetFileKey(filePath, key);
+
+        bool wasSuccessful = false;
+        if (useIndex && persistentIndex->TryGetEXIF(filePath, key, metadata, wasSuccessful))
+        {
+            return wasSuccessful;
+        }
+
+        wasSuccessful = LoadEXIFMetadata(filePath, metadata);
+        if (useIndex)
+        {
+            persistentIndex->PutEXIF(filePath, key, metadata, wasSuccessful);
+        }
+        return wasSuccessful;
     });
 }
 
+void WICMetadataExtractor::SetPersistentIndex(std::shared_ptr<MetadataIndex> index)
+{
+    persistentIndex = std::move(index);
+}
+
 bool WICMetadataExtractor::LoadEXIFMetadata(
     const std::wstring& filePath,
     EXIFMetadata& outMetadata)
@@ -467,6 +547,14 @@ bool WICMetadataExtractor::LoadEXIFMetadata(
         return false;
     }
 
+    // JPEG, TIFF and HEIF/AVIF are read without a decoder, other containers go through WIC
+    EXIFMetadata headerMetadata;
+    if (ParseFileHeaders(filePath, [&headerMetadata](MetadataHeaderParser& parser) { return parser.ParseEXIF(headerMetadata, ParseDateTimeString); }))
+    {
+        outMetadata = std::move(headerMetadata);
+        return true;
+    }
+
     auto decoder = CreateDecoder(filePath);
     if (!decoder)
     {
@@ -726,28 +814,7 @@ std::optional<SYSTEMTIME> WICMetadataExtractor::ReadDateTime(IWICMetadataQueryRe
         break;
     }
 
-    if (rawValue.empty())
-    {
-        return std::nullopt;
-    }
-
-    const std::wstring normalized = TrimWhitespace(rawValue);
-    if (normalized.empty())
-    {
-        return std::nullopt;
-    }
-
-    if (auto exifDate = ParseExifDateTime(normalized))
-    {
-        return exifDate;
-    }
-
-    if (auto isoDate = ParseIso8601DateTime(normalized))
-    {
-        return isoDate;
-    }
-
-    return std::nullopt;
+    return ParseDateTimeString(rawValue);
 }
 
 std::optional<std::wstring> WICMetadataExtractor::ReadString(IWICMetadataQueryReader* reader, const std::wstring& path)
@@ -1006,7 +1073,21 @@ bool WICMetadataExtractor::ExtractXMPMetadata(
     XMPMetadata& outMetadata)
 {
     return cache.GetOrLoadXMP(filePath, outMetadata, [this, &filePath](XMPMetadata& metadata) {
-        return LoadXMPMetadata(filePath, metadata);
+        MetadataIndex::FileKey key;
+        const bool useIndex = persistentIndex && MetadataIndex::GetFileKey(filePath, key);
+
+        bool wasSuccessful = false;
+        if (useIndex && persistentIndex->TryGetXMP(filePath, key, metadata, wasSuccessful))
+        {
+            return wasSuccessful;
+        }
+
+        wasSuccessful = LoadXMPMetadata(filePath, metadata);
+        if (useIndex)
+        {
+            persistentIndex->PutXMP(filePath, key, metadata, wasSuccessful);
+        }
+        return wasSuccessful;
     });
 }
 
@@ -1023,6 +1104,13 @@ bool WICMetadataExtractor::LoadXMPMetadata(
         return false;
     }
 
+    XMPMetadata headerMetadata;
+    if (ParseFileHeaders(filePath, [&headerMetadata](MetadataHeaderParser& parser) { return parser.ParseXMP(headerMetadata, ParseDateTimeString); }))
+    {
+        outMetadata = std::move(headerMetadata);
+        return true;
+    }
+
     auto decoder = CreateDecoder(filePath);
     if (!decoder)
     {
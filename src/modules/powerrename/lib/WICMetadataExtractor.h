@@ -8,6 +8,7 @@
 #include "PropVariantValue.h"
 #include <wincodec.h>
 #include <atlbase.h>
+#include <memory>
 
 // Forward declarations for unit test friend classes
 namespace WICMetadataExtractorTests
@@ -17,6 +18,8 @@ namespace WICMetadataExtractorTests
 
 namespace PowerRenameLib
 {
+    class MetadataIndex;
+
     /// <summary>
     /// Metadata path format based on container type
     /// </summary>
@@ -50,6 +53,10 @@ namespace PowerRenameLib
 
         void ClearCache();
 
+        // Consults the index before decoding a file and records what was decoded. Must be set
+        // before the extractor is used from several threads.
+        void SetPersistentIndex(std::shared_ptr<MetadataIndex> index);
+
     private:
         // WIC factory management
         static CComPtr<IWICImagingFactory> GetWICFactory();
@@ -81,5 +88,6 @@ namespace PowerRenameLib
 
     private:
         MetadataResultCache cache;
+        std::shared_ptr<MetadataIndex> persistentIndex;
     };
 }
@@ -0,0 +1,315 @@
+#include "pch.h"
+#include "BatchRenamer.h"
+#include "TestFileHelper.h"
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace BatchRenamerTests
+{
+    void WriteText(const std::filesystem::path& path, const std::string& text)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file << text;
+    }
+
+    void WriteJournal(const std::filesystem::path& path, const std::wstring& journal)
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(journal.data()), journal.size() * sizeof(wchar_t));
+    }
+
+    std::string ReadText(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    TEST_CLASS(BatchRenamerTests)
+    {
+    public:
+        TEST_METHOD(BuildPlan_RenamesChildrenBeforeParents)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\folder", L"renamed" },
+                { L"C:\\root\\folder\\sub\\file.txt", L"file2.txt" },
+                { L"C:\\root\\folder\\sub", L"sub2" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(3), plan.size());
+            Assert::AreEqual(L"C:\\root\\folder\\sub\\file.txt", plan[0][0][0].source.c_str());
+            Assert::AreEqual(L"C:\\root\\folder\\sub\\file2.txt", plan[0][0][0].target.c_str());
+            Assert::AreEqual(L"C:\\root\\folder\\sub2", plan[1][0][0].target.c_str());
+            Assert::AreEqual(L"C:\\root\\renamed", plan[2][0][0].target.c_str());
+        }
+
+        TEST_METHOD(BuildPlan_IndependentRenames_AreSeparateSequences)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\a.txt", L"x.txt" },
+                { L"C:\\root\\b.txt", L"y.txt" },
+                { L"C:\\root\\c.txt", L"c.txt" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(1), plan.size());
+            // Renaming an item to its own name is left out
+            Assert::AreEqual(static_cast<size_t>(2), plan[0].size());
+            Assert::AreEqual(static_cast<size_t>(1), plan[0][0].size());
+            Assert::AreEqual(static_cast<size_t>(1), plan[0][1].size());
+        }
+
+        TEST_METHOD(BuildPlan_Chain_StartsWithFreeTarget)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\a", L"b" },
+                { L"C:\\root\\b", L"c" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(1), plan[0].size());
+
+            const auto& sequence = plan[0][0];
+            Assert::AreEqual(static_cast<size_t>(2), sequence.size());
+            Assert::AreEqual(L"C:\\root\\b", sequence[0].source.c_str());
+            Assert::AreEqual(L"C:\\root\\c", sequence[0].target.c_str());
+            Assert::AreEqual(L"C:\\root\\a", sequence[1].source.c_str());
+            Assert::AreEqual(L"C:\\root\\b", sequence[1].target.c_str());
+        }
+
+        TEST_METHOD(BuildPlan_Swap_GoesThroughTemporaryName)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\a", L"B" },
+                { L"C:\\root\\b", L"a" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(1), plan[0].size());
+
+            const auto& sequence = plan[0][0];
+            Assert::AreEqual(static_cast<size_t>(3), sequence.size());
+            Assert::AreEqual(L"C:\\root\\a", sequence[0].source.c_str());
+            Assert::AreEqual(L"C:\\root\\b", sequence[1].source.c_str());
+            Assert::AreEqual(L"C:\\root\\a", sequence[1].target.c_str());
+            Assert::IsTrue(sequence[0].target == sequence[2].source);
+            Assert::AreEqual(L"C:\\root\\B", sequence[2].target.c_str());
+        }
+
+        TEST_METHOD(BuildPlan_CaseOnlyRename_IsSingleStep)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\readme.txt", L"README.txt" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == S_OK);
+            Assert::AreEqual(static_cast<size_t>(1), plan[0][0].size());
+            Assert::AreEqual(L"C:\\root\\README.txt", plan[0][0][0].target.c_str());
+        }
+
+        TEST_METHOD(BuildPlan_DuplicateTargets_Fail)
+        {
+            std::vector<BatchRenamer::Operation> operations = {
+                { L"C:\\root\\a.txt", L"same.txt" },
+                { L"C:\\root\\b.txt", L"SAME.txt" },
+            };
+
+            std::vector<BatchRenamer::Level> plan;
+            Assert::IsTrue(BatchRenamer::BuildPlan(operations, plan) == HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS));
+        }
+
+        TEST_METHOD(Execute_SwapsNamesAndRenamesFolders)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"journals"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"folder"));
+            WriteText(testFileHelper.GetFullPath(L"folder\\a.txt"), "a");
+            WriteText(testFileHelper.GetFullPath(L"folder\\b.txt"), "b");
+
+            std::vector<BatchRenamer::Operation> operations = {
+                { testFileHelper.GetFullPath(L"folder").wstring(), L"renamed" },
+                { testFileHelper.GetFullPath(L"folder\\a.txt").wstring(), L"b.txt" },
+                { testFileHelper.GetFullPath(L"folder\\b.txt").wstring(), L"a.txt" },
+            };
+
+            BatchRenamer renamer(testFileHelper.GetFullPath(L"journals").wstring());
+            Assert::IsTrue(renamer.Execute(operations) == S_OK);
+
+            Assert::IsFalse(testFileHelper.PathExists(L"folder"));
+            Assert::AreEqual("b", ReadText(testFileHelper.GetFullPath(L"renamed\\a.txt")).c_str());
+            Assert::AreEqual("a", ReadText(testFileHelper.GetFullPath(L"renamed\\b.txt")).c_str());
+            Assert::IsTrue(std::filesystem::is_empty(testFileHelper.GetFullPath(L"journals")));
+        }
+
+        TEST_METHOD(Execute_FailedStep_RollsBackBatch)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"journals"));
+            Assert::IsTrue(testFileHelper.AddFolder(L"folder"));
+            Assert::IsTrue(testFileHelper.AddFile(L"folder\\a.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"folder\\b.txt"));
+            // Not part of the batch, so renaming b.txt fails
+            Assert::IsTrue(testFileHelper.AddFile(L"folder\\taken.txt"));
+
+            std::vector<BatchRenamer::Operation> operations = {
+                { testFileHelper.GetFullPath(L"folder\\a.txt").wstring(), L"c.txt" },
+                { testFileHelper.GetFullPath(L"folder\\b.txt").wstring(), L"taken.txt" },
+                { testFileHelper.GetFullPath(L"folder").wstring(), L"renamed" },
+            };
+
+            BatchRenamer renamer(testFileHelper.GetFullPath(L"journals").wstring());
+            Assert::IsTrue(renamer.Execute(operations) == HRESULT_FROM_WIN32(ERROR_ALREADY_EXISTS));
+
+            Assert::IsTrue(testFileHelper.PathExists(L"folder\\a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"folder\\b.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"folder\\c.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"renamed"));
+            Assert::IsTrue(std::filesystem::is_empty(testFileHelper.GetFullPath(L"journals")));
+        }
+
+        TEST_METHOD(RollBack_UndoesJournalledSteps)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"d.txt"));
+
+            // A batch that stopped after renaming a.txt to b.txt and c.txt to d.txt, with a
+            // partially written third record
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n" +
+                                         testFileHelper.GetFullPath(L"c.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"d.txt").wstring() + L"\n" +
+                                         testFileHelper.GetFullPath(L"e.txt").wstring();
+            const std::wstring journalPath = testFileHelper.GetFullPath(L"journal").wstring();
+            WriteJournal(journalPath, journal);
+
+            Assert::IsTrue(BatchRenamer::RollBack(journalPath) == S_OK);
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"c.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"b.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"d.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"journal"));
+        }
+
+        TEST_METHOD(RollBack_KeepsStepsThatCannotBeUndone)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"d.txt"));
+            // Taken again since the batch ran, so c.txt -> d.txt can't be undone
+            Assert::IsTrue(testFileHelper.AddFile(L"c.txt"));
+
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n" +
+                                         testFileHelper.GetFullPath(L"c.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"d.txt").wstring() + L"\n";
+            const std::wstring journalPath = testFileHelper.GetFullPath(L"journal").wstring();
+            WriteJournal(journalPath, journal);
+
+            Assert::IsTrue(FAILED(BatchRenamer::RollBack(journalPath)));
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"d.txt"));
+
+            // Only the step that is left is kept, and it is undone once c.txt is out of the way
+            Assert::IsTrue(DeleteFileW(testFileHelper.GetFullPath(L"c.txt").c_str()));
+            Assert::IsTrue(BatchRenamer::RollBack(journalPath) == S_OK);
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"c.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"d.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"journal"));
+        }
+
+        TEST_METHOD(RollBack_SkipsCancelledSteps)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFile(L"a.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"d.txt"));
+            // Was already there when the batch tried to rename c.txt to it
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+
+            // a.txt -> b.txt was recorded, failed and was cancelled, c.txt -> d.txt ran
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n" +
+                                         L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n" +
+                                         testFileHelper.GetFullPath(L"c.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"d.txt").wstring() + L"\n";
+            const std::wstring journalPath = testFileHelper.GetFullPath(L"journal").wstring();
+            WriteJournal(journalPath, journal);
+
+            Assert::IsTrue(BatchRenamer::RollBack(journalPath) == S_OK);
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"b.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"c.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"d.txt"));
+        }
+
+        TEST_METHOD(RecoverJournals_RollsBackLeftoverJournals)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"journals"));
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+
+            // An earlier batch renamed a.txt to b.txt and was interrupted
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n";
+            WriteJournal(testFileHelper.GetFullPath(L"journals\\power-rename-journal-1-1-1").wstring(), journal);
+
+            const auto recovered = BatchRenamer::RecoverJournals(testFileHelper.GetFullPath(L"journals").wstring());
+            Assert::AreEqual(static_cast<size_t>(1), recovered.size());
+            Assert::IsTrue(recovered[0].result == S_OK);
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsFalse(testFileHelper.PathExists(L"b.txt"));
+            Assert::IsTrue(std::filesystem::is_empty(testFileHelper.GetFullPath(L"journals")));
+        }
+
+        TEST_METHOD(RecoverJournals_DropsJournalThatCannotBeUndone)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"journals"));
+            Assert::IsTrue(testFileHelper.AddFile(L"a.txt"));
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+
+            // Both sides of the step exist again, so it can't be undone
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n";
+            WriteJournal(testFileHelper.GetFullPath(L"journals\\power-rename-journal-1-1-1").wstring(), journal);
+
+            const auto recovered = BatchRenamer::RecoverJournals(testFileHelper.GetFullPath(L"journals").wstring());
+            Assert::AreEqual(static_cast<size_t>(1), recovered.size());
+            Assert::IsTrue(FAILED(recovered[0].result));
+            Assert::AreEqual(static_cast<size_t>(1), recovered[0].droppedSteps.size());
+            Assert::IsTrue(testFileHelper.PathExists(L"a.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"b.txt"));
+            Assert::IsTrue(std::filesystem::is_empty(testFileHelper.GetFullPath(L"journals")));
+
+            // Nothing is left to get in the way of the next batch
+            std::vector<BatchRenamer::Operation> operations = {
+                { testFileHelper.GetFullPath(L"a.txt").wstring(), L"c.txt" },
+            };
+            BatchRenamer renamer(testFileHelper.GetFullPath(L"journals").wstring());
+            BatchRenamer::Outcome outcome = BatchRenamer::Outcome::Unchanged;
+            Assert::IsTrue(renamer.Execute(operations, &outcome) == S_OK);
+            Assert::IsTrue(outcome == BatchRenamer::Outcome::Renamed);
+            Assert::IsTrue(testFileHelper.PathExists(L"c.txt"));
+        }
+
+        TEST_METHOD(RecoverJournals_SkipsJournalOfRunningBatch)
+        {
+            CTestFileHelper testFileHelper;
+            Assert::IsTrue(testFileHelper.AddFolder(L"journals"));
+            Assert::IsTrue(testFileHelper.AddFile(L"b.txt"));
+
+            const std::wstring journal = testFileHelper.GetFullPath(L"a.txt").wstring() + L"\t" + testFileHelper.GetFullPath(L"b.txt").wstring() + L"\n";
+            const std::wstring journalPath = testFileHelper.GetFullPath(L"journals\\power-rename-journal-1-1-1").wstring();
+            WriteJournal(journalPath, journal);
+
+            // Opened the way a running batch keeps its journal open
+            HANDLE file = CreateFileW(journalPath.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+            const auto recovered = BatchRenamer::RecoverJournals(testFileHelper.GetFullPath(L"journals").wstring());
+            CloseHandle(file);
+
+            Assert::IsTrue(recovered.empty());
+            Assert::IsTrue(testFileHelper.PathExists(L"b.txt"));
+            Assert::IsTrue(testFileHelper.PathExists(L"journals\\power-rename-journal-1-1-1"));
+        }
+    };
+}
@@ -727,6 +727,48 @@ TEST_METHOD(VerifyRegexMetacharacterCaret)
     CoTaskMemFree(result);
 }
 
+TEST_METHOD(VerifyReplaceWithMatchesReusesMatchesUntilSearchChanges)
+{
+    CComPtr<IPowerRenameRegEx> renameRegEx;
+    Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+    Assert::IsTrue(renameRegEx->PutFlags(UseRegularExpressions | MatchAllOccurrences) == S_OK);
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"(\\d+)") == S_OK);
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"<$1>") == S_OK);
+
+    std::shared_ptr<const PowerRenameMatches> matches;
+    PWSTR result = nullptr;
+    unsigned long index = {};
+    Assert::IsTrue(renameRegEx->ReplaceWithMatches(L"a1b22", &result, index, matches) == S_OK);
+    Assert::AreEqual(L"a<1>b<22>", result);
+    CoTaskMemFree(result);
+    Assert::IsTrue(matches != nullptr);
+
+    // A replace term edit re-expands the same matches
+    const auto found = matches;
+    Assert::IsTrue(renameRegEx->PutReplaceTerm(L"[$1]") == S_OK);
+    Assert::IsTrue(renameRegEx->ReplaceWithMatches(L"a1b22", &result, index, matches) == S_OK);
+    Assert::AreEqual(L"a[1]b[22]", result);
+    CoTaskMemFree(result);
+    Assert::IsTrue(matches == found);
+
+    // Other names, search terms and flags search again
+    Assert::IsTrue(renameRegEx->ReplaceWithMatches(L"c333", &result, index, matches) == S_OK);
+    Assert::AreEqual(L"c[333]", result);
+    CoTaskMemFree(result);
+    Assert::IsTrue(matches != found);
+
+    Assert::IsTrue(renameRegEx->PutFlags(UseRegularExpressions) == S_OK);
+    Assert::IsTrue(renameRegEx->ReplaceWithMatches(L"a1b22", &result, index, matches) == S_OK);
+    Assert::AreEqual(L"a[1]b22", result);
+    CoTaskMemFree(result);
+
+    Assert::IsTrue(renameRegEx->PutSearchTerm(L"x") == S_OK);
+    Assert::IsTrue(renameRegEx->ReplaceWithMatches(L"a1b22", &result, index, matches) == S_OK);
+    Assert::AreEqual(L"a1b22", result);
+    CoTaskMemFree(result);
+    Assert::IsTrue(matches == nullptr);
+}
+
 #ifndef TESTS_PARTIAL
 };
 }
@@ -0,0 +1,330 @@
+#include "pch.h"
+#include "MetadataHeaderParser.h"
+#include <filesystem>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace PowerRenameLib;
+
+namespace MetadataHeaderParserTests
+{
+    std::wstring GetTestDataPath()
+    {
+        HMODULE hModule = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           reinterpret_cast<LPCWSTR>(&GetTestDataPath),
+                           &hModule);
+
+        wchar_t modulePath[MAX_PATH];
+        GetModuleFileNameW(hModule, modulePath, MAX_PATH);
+        return (std::filesystem::path(modulePath).parent_path() / L"testdata").wstring();
+    }
+
+    std::vector<uint8_t> LoadTestFile(const std::wstring& name)
+    {
+        std::ifstream file(GetTestDataPath() + L"\\" + name, std::ios::binary);
+        return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), {});
+    }
+
+    // Parser over an in-memory copy of a file
+    MetadataHeaderParser MakeParser(const std::vector<uint8_t>& data)
+    {
+        return MetadataHeaderParser(
+            [&data](uint64_t offset, void* buffer, size_t size) -> size_t {
+                if (offset >= data.size())
+                {
+                    return 0;
+                }
+                const size_t count = static_cast<size_t>(std::min<uint64_t>(size, data.size() - offset));
+                memcpy(buffer, data.data() + offset, count);
+                return count;
+            },
+            data.size());
+    }
+
+    // Accepts "YYYY:MM:DD HH:MM:SS" and the date part of ISO 8601 values
+    std::optional<SYSTEMTIME> ParseTestDate(const std::wstring& value)
+    {
+        SYSTEMTIME time{};
+        int year = 0, month = 0, day = 0;
+        if (swscanf_s(value.c_str(), L"%d%*1[:-]%d%*1[:-]%d", &year, &month, &day) != 3)
+        {
+            return std::nullopt;
+        }
+        time.wYear = static_cast<WORD>(year);
+        time.wMonth = static_cast<WORD>(month);
+        time.wDay = static_cast<WORD>(day);
+        return time;
+    }
+
+    // Writes big-endian TIFF files, the byte order the sample photos don't cover
+    class TiffWriter
+    {
+    public:
+        struct Field
+        {
+            uint16_t tag;
+            uint16_t type;
+            uint32_t count;
+            std::vector<uint8_t> value;
+        };
+
+        TiffWriter()
+        {
+            data = { 'M', 'M', 0, 42, 0, 0, 0, 0 };
+        }
+
+        static std::vector<uint8_t> Short(uint16_t value)
+        {
+            return { static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+        }
+
+        static std::vector<uint8_t> Long(uint32_t value)
+        {
+            return { static_cast<uint8_t>(value >> 24), static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value) };
+        }
+
+        static std::vector<uint8_t> Rationals(std::initializer_list<std::pair<uint32_t, uint32_t>> values)
+        {
+            std::vector<uint8_t> bytes;
+            for (const auto& [numerator, denominator] : values)
+            {
+                Append(bytes, Long(numerator));
+                Append(bytes, Long(denominator));
+            }
+            return bytes;
+        }
+
+        static Field Ascii(uint16_t tag, const std::string& text)
+        {
+            return { tag, 2, static_cast<uint32_t>(text.size() + 1), std::vector<uint8_t>(text.c_str(), text.c_str() + text.size() + 1) };
+        }
+
+        // Appends a directory and its values, returns its offset
+        uint32_t AddDirectory(const std::vector<Field>& fields)
+        {
+            const uint32_t offset = static_cast<uint32_t>(data.size());
+            uint32_t valueOffset = offset + 2 + static_cast<uint32_t>(fields.size()) * 12 + 4;
+
+            std::vector<uint8_t> values;
+            Append(data, Short(static_cast<uint16_t>(fields.size())));
+            for (const auto& field : fields)
+            {
+                Append(data, Short(field.tag));
+                Append(data, Short(field.type));
+                Append(data, Long(field.count));
+                if (field.value.size() <= 4)
+                {
+                    std::vector<uint8_t> inlineValue = field.value;
+                    inlineValue.resize(4);
+                    Append(data, inlineValue);
+                }
+                else
+                {
+                    Append(data, Long(valueOffset + static_cast<uint32_t>(values.size())));
+                    Append(values, field.value);
+                    values.resize((values.size() + 1) & ~size_t{ 1 });
+                }
+            }
+            Append(data, Long(0));
+            Append(data, values);
+            return offset;
+        }
+
+        std::vector<uint8_t> Finish(uint32_t firstDirectory)
+        {
+            const auto offset = Long(firstDirectory);
+            std::copy(offset.begin(), offset.end(), data.begin() + 4);
+            return data;
+        }
+
+    private:
+        static void Append(std::vector<uint8_t>& target, const std::vector<uint8_t>& bytes)
+        {
+            target.insert(target.end(), bytes.begin(), bytes.end());
+        }
+
+        std::vector<uint8_t> data;
+    };
+
+    TEST_CLASS(MetadataHeaderParserTests)
+    {
+    public:
+        TEST_METHOD(JPEG_EXIF_ReadsAllFields)
+        {
+            const auto data = LoadTestFile(L"exif_test.jpg");
+            auto parser = MakeParser(data);
+
+            EXIFMetadata metadata;
+            Assert::IsTrue(parser.ParseEXIF(metadata, ParseTestDate));
+
+            Assert::AreEqual(L"samsung", metadata.cameraMake.value().c_str());
+            Assert::AreEqual(L"SM-G930P", metadata.cameraModel.value().c_str());
+            Assert::AreEqual(L"Samsung Galaxy S7 Rear Camera", metadata.lensModel.value().c_str());
+            Assert::AreEqual(static_cast<int64_t>(40), metadata.iso.value());
+            Assert::AreEqual(1.7, metadata.aperture.value(), 0.01);
+            Assert::AreEqual(0.000625, metadata.shutterSpeed.value(), 0.000001);
+            Assert::AreEqual(4.2, metadata.focalLength.value(), 0.01);
+            Assert::AreEqual(0.0, metadata.exposureBias.value(), 0.01);
+            Assert::AreEqual(static_cast<int64_t>(0), metadata.flash.value());
+            Assert::AreEqual(L"Carl Seibert (Exif)", metadata.author.value().c_str());
+            Assert::IsTrue(metadata.copyright.value().find(L"Carl Seibert") != std::wstring::npos);
+            Assert::AreEqual(static_cast<WORD>(2017), metadata.dateTaken.value().wYear);
+
+            // GPS coordinates are west of Greenwich
+            Assert::IsTrue(metadata.latitude.value() > 0.0);
+            Assert::IsTrue(metadata.longitude.value() < 0.0);
+        }
+
+        TEST_METHOD(JPEG_XMP_ReadsAllFields)
+        {
+            const auto data = LoadTestFile(L"xmp_test.jpg");
+            auto parser = MakeParser(data);
+
+            XMPMetadata metadata;
+            Assert::IsTrue(parser.ParseXMP(metadata, ParseTestDate));
+
+            Assert::AreEqual(L"object name here", metadata.title.value().c_str());
+            Assert::IsTrue(metadata.description.value().find(L"This is a metadata test file") != std::wstring::npos);
+            Assert::AreEqual(L"metadatamatters.blog", metadata.rights.value().c_str());
+            Assert::IsTrue(metadata.creatorTool.value().find(L"Adobe Photoshop Lightroom") != std::wstring::npos);
+            Assert::IsTrue(metadata.documentID.value().find(L"xmp.did:") != std::wstring::npos);
+            Assert::IsTrue(metadata.instanceID.value().find(L"xmp.iid:") != std::wstring::npos);
+            Assert::AreEqual(L"Carl Seibert (XMP)", metadata.creator.value().c_str());
+            Assert::AreEqual(L"keywords go here", metadata.subject.value().front().c_str());
+            Assert::AreEqual(static_cast<WORD>(2017), metadata.createDate.value().wYear);
+        }
+
+        TEST_METHOD(JPEG_MissingFields_AreNotSet)
+        {
+            const auto data = LoadTestFile(L"xmp_test_2.jpg");
+            auto parser = MakeParser(data);
+
+            EXIFMetadata exif;
+            Assert::IsTrue(parser.ParseEXIF(exif, ParseTestDate));
+            Assert::AreEqual(static_cast<int64_t>(1080), exif.width.value());
+            Assert::AreEqual(static_cast<int64_t>(810), exif.height.value());
+            Assert::IsFalse(exif.cameraMake.has_value());
+            Assert::IsFalse(exif.latitude.has_value());
+
+            XMPMetadata xmp;
+            Assert::IsTrue(parser.ParseXMP(xmp, ParseTestDate));
+            Assert::IsTrue(xmp.creatorTool.value().find(L"Adobe Photoshop CS6") != std::wstring::npos);
+            Assert::IsFalse(xmp.title.has_value());
+            Assert::IsFalse(xmp.creator.has_value());
+            Assert::IsFalse(xmp.subject.has_value());
+        }
+
+        TEST_METHOD(JPEG_ReadsOnlyTheLeadingSegments)
+        {
+            const auto data = LoadTestFile(L"exif_test_2.jpg");
+            auto parser = MakeParser(data);
+
+            EXIFMetadata exif;
+            XMPMetadata xmp;
+            Assert::IsTrue(parser.ParseEXIF(exif, ParseTestDate));
+            Assert::IsTrue(parser.ParseXMP(xmp, ParseTestDate));
+            Assert::IsTrue(parser.GetBytesRead() < data.size() / 4);
+        }
+
+        TEST_METHOD(AVIF_EXIF_ReadsExifItem)
+        {
+            const auto data = LoadTestFile(L"avif_test.avif");
+            auto parser = MakeParser(data);
+
+            EXIFMetadata metadata;
+            Assert::IsTrue(parser.ParseEXIF(metadata, ParseTestDate));
+            Assert::AreEqual(L"Apple", metadata.cameraMake.value().c_str());
+            Assert::AreEqual(L"iPhone 15 Pro Max", metadata.cameraModel.value().c_str());
+            Assert::AreEqual(static_cast<int64_t>(5712), metadata.width.value());
+            Assert::AreEqual(static_cast<WORD>(2024), metadata.dateTaken.value().wYear);
+            Assert::IsTrue(parser.GetBytesRead() < data.size() / 10);
+        }
+
+        TEST_METHOD(TIFF_BigEndian_ReadsEXIFAndXMP)
+        {
+            const std::string packet =
+                "<x:xmpmeta xmlns:x=\"adobe:ns:meta/\"><rdf:RDF xmlns:rdf=\"http://www.w3.org/1999/02/22-rdf-syntax-ns#\">"
+                "<rdf:Description xmlns:xmp=\"http://ns.adobe.com/xap/1.0/\" xmlns:dc=\"http://purl.org/dc/elements/1.1/\" xmp:CreatorTool=\"Scanner &amp; Co\">"
+                "<dc:title><rdf:Alt><rdf:li xml:lang=\"de\">Titel</rdf:li><rdf:li xml:lang=\"x-default\">Title &#x263A;</rdf:li></rdf:Alt></dc:title>"
+                "<dc:subject><rdf:Bag><rdf:li>one</rdf:li><rdf:li> </rdf:li><rdf:li>two</rdf:li></rdf:Bag></dc:subject>"
+                "</rdf:Description></rdf:RDF></x:xmpmeta>";
+
+            TiffWriter writer;
+            const uint32_t exif = writer.AddDirectory({
+                { 33437, 5, 1, TiffWriter::Rationals({ { 28, 10 } }) },
+                { 37380, 10, 1, TiffWriter::Rationals({ { static_cast<uint32_t>(-2), 3 } }) },
+            });
+            const uint32_t gps = writer.AddDirectory({
+                TiffWriter::Ascii(1, "S"),
+                { 2, 5, 3, TiffWriter::Rationals({ { 33, 1 }, { 51, 1 }, { 0, 1 } }) },
+                TiffWriter::Ascii(3, "E"),
+                { 4, 5, 3, TiffWriter::Rationals({ { 151, 1 }, { 12, 1 }, { 36, 1 } }) },
+            });
+            const uint32_t ifd0 = writer.AddDirectory({
+                TiffWriter::Ascii(271, "  Canon  "),
+                { 274, 3, 1, TiffWriter::Short(6) },
+                { 700, 7, static_cast<uint32_t>(packet.size()), std::vector<uint8_t>(packet.begin(), packet.end()) },
+                { 34665, 4, 1, TiffWriter::Long(exif) },
+                { 34853, 4, 1, TiffWriter::Long(gps) },
+            });
+            const auto data = writer.Finish(ifd0);
+
+            // XMP first, so the packet has to be found without a prior EXIF pass
+            auto parser = MakeParser(data);
+            XMPMetadata xmp;
+            Assert::IsTrue(parser.ParseXMP(xmp, ParseTestDate));
+            Assert::AreEqual(L"Scanner & Co", xmp.creatorTool.value().c_str());
+            Assert::AreEqual(L"Title \x263A", xmp.title.value().c_str());
+            Assert::AreEqual(static_cast<size_t>(2), xmp.subject.value().size());
+            Assert::AreEqual(L"two", xmp.subject.value()[1].c_str());
+
+            EXIFMetadata metadata;
+            Assert::IsTrue(parser.ParseEXIF(metadata, ParseTestDate));
+            Assert::AreEqual(L"Canon", metadata.cameraMake.value().c_str());
+            Assert::AreEqual(static_cast<int64_t>(6), metadata.orientation.value());
+            Assert::AreEqual(2.8, metadata.aperture.value(), 0.0001);
+            Assert::AreEqual(-2.0 / 3.0, metadata.exposureBias.value(), 0.0001);
+            Assert::AreEqual(-33.85, metadata.latitude.value(), 0.0001);
+            Assert::AreEqual(151.21, metadata.longitude.value(), 0.0001);
+        }
+
+        TEST_METHOD(UnsupportedContainer_ReturnsFalse)
+        {
+            const std::vector<uint8_t> png = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 13, 'I', 'H', 'D', 'R' };
+            auto parser = MakeParser(png);
+
+            EXIFMetadata exif;
+            XMPMetadata xmp;
+            Assert::IsFalse(parser.ParseEXIF(exif, ParseTestDate));
+            Assert::IsFalse(parser.ParseXMP(xmp, ParseTestDate));
+        }
+
+        TEST_METHOD(TruncatedFiles_AreHandled)
+        {
+            for (const auto name : { L"exif_test.jpg", L"xmp_test.jpg", L"avif_test.avif" })
+            {
+                const auto original = LoadTestFile(name);
+                for (size_t size = 0; size < 80000 && size < original.size(); size += 997)
+                {
+                    const std::vector<uint8_t> data(original.begin(), original.begin() + size);
+                    auto parser = MakeParser(data);
+
+                    EXIFMetadata exif;
+                    XMPMetadata xmp;
+                    const bool exifParsed = parser.ParseEXIF(exif, ParseTestDate);
+                    const bool xmpParsed = parser.ParseXMP(xmp, ParseTestDate);
+
+                    // Too short to identify the container
+                    if (size < 12)
+                    {
+                        Assert::IsFalse(exifParsed);
+                        Assert::IsFalse(xmpParsed);
+                    }
+                }
+            }
+        }
+    };
+}
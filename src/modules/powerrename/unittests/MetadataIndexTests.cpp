@@ -0,0 +1,193 @@
+#include "pch.h"
+#include "MetadataIndex.h"
+#include "TestFileHelper.h"
+#include <fstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+using namespace PowerRenameLib;
+
+namespace MetadataIndexTests
+{
+    EXIFMetadata MakeEXIF()
+    {
+        EXIFMetadata metadata;
+        metadata.cameraMake = L"samsung";
+        metadata.cameraModel = L"SM-G930P";
+        metadata.iso = 100;
+        metadata.aperture = 1.7;
+        metadata.latitude = 47.6062;
+        metadata.dateTaken = SYSTEMTIME{ 2024, 5, 3, 17, 9, 30, 15, 0 };
+        return metadata;
+    }
+
+    TEST_CLASS(MetadataIndexTests)
+    {
+    public:
+        TEST_METHOD(Lookup_AfterFlush_ReturnsStoredMetadata)
+        {
+            CTestFileHelper testFileHelper;
+            const std::wstring indexPath = testFileHelper.GetFullPath(L"index").wstring();
+            const MetadataIndex::FileKey key{ 1234, 5678 };
+
+            {
+                MetadataIndex index(indexPath);
+                index.PutEXIF(L"C:\\photos\\a.jpg", key, MakeEXIF(), true);
+
+                XMPMetadata xmp;
+                xmp.title = L"Sunset";
+                xmp.subject = std::vector<std::wstring>{ L"beach", L"summer" };
+                index.PutXMP(L"C:\\photos\\a.jpg", key, xmp, true);
+
+                Assert::IsTrue(SUCCEEDED(index.Flush()));
+            }
+
+            MetadataIndex index(indexPath);
+
+            EXIFMetadata exif;
+            bool wasSuccessful = false;
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\photos\\a.jpg", key, exif, wasSuccessful));
+            Assert::IsTrue(wasSuccessful);
+            Assert::AreEqual(L"samsung", exif.cameraMake.value().c_str());
+            Assert::AreEqual(L"SM-G930P", exif.cameraModel.value().c_str());
+            Assert::AreEqual(static_cast<int64_t>(100), exif.iso.value());
+            Assert::AreEqual(1.7, exif.aperture.value());
+            Assert::AreEqual(47.6062, exif.latitude.value());
+            Assert::AreEqual(static_cast<WORD>(2024), exif.dateTaken.value().wYear);
+            Assert::IsFalse(exif.lensModel.has_value());
+
+            XMPMetadata xmp;
+            Assert::IsTrue(index.TryGetXMP(L"C:\\photos\\a.jpg", key, xmp, wasSuccessful));
+            Assert::AreEqual(L"Sunset", xmp.title.value().c_str());
+            Assert::AreEqual(static_cast<size_t>(2), xmp.subject.value().size());
+            Assert::AreEqual(L"summer", xmp.subject.value()[1].c_str());
+        }
+
+        TEST_METHOD(Flush_Twice_AppendsNewEntries)
+        {
+            CTestFileHelper testFileHelper;
+            const std::wstring indexPath = testFileHelper.GetFullPath(L"index").wstring();
+            const MetadataIndex::FileKey key{ 1234, 5678 };
+
+            uintmax_t firstSize = 0;
+            {
+                MetadataIndex index(indexPath);
+                index.PutEXIF(L"C:\\photos\\a.jpg", key, MakeEXIF(), true);
+                Assert::IsTrue(SUCCEEDED(index.Flush()));
+                firstSize = std::filesystem::file_size(indexPath);
+
+                EXIFMetadata replaced = MakeEXIF();
+                replaced.cameraMake = L"Canon";
+                index.PutEXIF(L"C:\\photos\\a.jpg", key, replaced, true);
+                index.PutEXIF(L"C:\\photos\\b.jpg", key, MakeEXIF(), true);
+                Assert::IsTrue(SUCCEEDED(index.Flush()));
+                Assert::AreEqual(S_FALSE, index.Flush());
+            }
+
+            // The replaced record stays in the file, the newer one wins
+            Assert::IsTrue(std::filesystem::file_size(indexPath) > firstSize);
+
+            MetadataIndex index(indexPath);
+            EXIFMetadata exif;
+            bool wasSuccessful = false;
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\photos\\a.jpg", key, exif, wasSuccessful));
+            Assert::AreEqual(L"Canon", exif.cameraMake.value().c_str());
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\photos\\b.jpg", key, exif, wasSuccessful));
+            Assert::AreEqual(L"samsung", exif.cameraMake.value().c_str());
+        }
+
+        TEST_METHOD(Flush_FileCannotBeReplaced_KeepsEntries)
+        {
+            CTestFileHelper testFileHelper;
+            const std::wstring indexPath = testFileHelper.GetFullPath(L"index").wstring();
+            const MetadataIndex::FileKey key{ 1234, 5678 };
+            {
+                std::ofstream file(indexPath, std::ios::binary);
+                file << "not an index file at all";
+            }
+
+            MetadataIndex index(indexPath);
+            index.PutEXIF(L"C:\\photos\\a.jpg", key, MakeEXIF(), true);
+
+            // Without delete sharing the damaged file can't be swapped for a new one
+            HANDLE holder = CreateFileW(indexPath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            Assert::IsTrue(holder != INVALID_HANDLE_VALUE);
+            Assert::IsTrue(FAILED(index.Flush()));
+            CloseHandle(holder);
+
+            EXIFMetadata exif;
+            bool wasSuccessful = false;
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\photos\\a.jpg", key, exif, wasSuccessful));
+            Assert::AreEqual(L"samsung", exif.cameraMake.value().c_str());
+
+            // The entry is still pending and gets written by the next flush
+            Assert::AreEqual(S_OK, index.Flush());
+            MetadataIndex reopened(indexPath);
+            Assert::IsTrue(reopened.TryGetEXIF(L"C:\\photos\\a.jpg", key, exif, wasSuccessful));
+        }
+
+        TEST_METHOD(Lookup_ChangedFile_Misses)
+        {
+            CTestFileHelper testFileHelper;
+            MetadataIndex index(testFileHelper.GetFullPath(L"index").wstring());
+            index.PutEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1234, 5678 }, MakeEXIF(), true);
+
+            EXIFMetadata exif;
+            bool wasSuccessful = false;
+            Assert::IsFalse(index.TryGetEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1234, 5679 }, exif, wasSuccessful));
+            Assert::IsFalse(index.TryGetEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1235, 5678 }, exif, wasSuccessful));
+            Assert::IsFalse(index.TryGetEXIF(L"C:\\photos\\b.jpg", MetadataIndex::FileKey{ 1234, 5678 }, exif, wasSuccessful));
+        }
+
+        TEST_METHOD(Lookup_FailedExtraction_IsRemembered)
+        {
+            CTestFileHelper testFileHelper;
+            MetadataIndex index(testFileHelper.GetFullPath(L"index").wstring());
+            index.PutEXIF(L"C:\\docs\\scan.png", MetadataIndex::FileKey{ 1, 2 }, EXIFMetadata{}, false);
+
+            EXIFMetadata exif;
+            bool wasSuccessful = true;
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\docs\\scan.png", MetadataIndex::FileKey{ 1, 2 }, exif, wasSuccessful));
+            Assert::IsFalse(wasSuccessful);
+        }
+
+        TEST_METHOD(Open_DamagedFile_StartsEmpty)
+        {
+            CTestFileHelper testFileHelper;
+            const std::wstring indexPath = testFileHelper.GetFullPath(L"index").wstring();
+            {
+                std::ofstream file(indexPath, std::ios::binary);
+                file << "not an index file at all";
+            }
+
+            MetadataIndex index(indexPath);
+            EXIFMetadata exif;
+            bool wasSuccessful = false;
+            Assert::IsFalse(index.TryGetEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1234, 5678 }, exif, wasSuccessful));
+
+            index.PutEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1234, 5678 }, MakeEXIF(), true);
+            Assert::IsTrue(SUCCEEDED(index.Flush()));
+            Assert::IsTrue(index.TryGetEXIF(L"C:\\photos\\a.jpg", MetadataIndex::FileKey{ 1234, 5678 }, exif, wasSuccessful));
+        }
+
+        TEST_METHOD(GetFileKey_ReflectsFileChanges)
+        {
+            CTestFileHelper testFileHelper;
+            testFileHelper.AddFile(L"photo.jpg");
+            const std::wstring filePath = testFileHelper.GetFullPath(L"photo.jpg").wstring();
+
+            MetadataIndex::FileKey before;
+            Assert::IsTrue(MetadataIndex::GetFileKey(filePath, before));
+
+            {
+                std::ofstream file(filePath, std::ios::binary | std::ios::app);
+                file << "more bytes";
+            }
+
+            MetadataIndex::FileKey after;
+            Assert::IsTrue(MetadataIndex::GetFileKey(filePath, after));
+            Assert::IsTrue(before.size != after.size);
+
+            Assert::IsFalse(MetadataIndex::GetFileKey(testFileHelper.GetFullPath(L"missing.jpg").wstring(), after));
+        }
+    };
+}
@@ -65,6 +65,12 @@ IFACEMETHODIMP CMockPowerRenameManagerEvents::OnRenameStarted()
     return S_OK;
 }
 
+IFACEMETHODIMP CMockPowerRenameManagerEvents::OnRenameIncomplete(_In_ HRESULT hr)
+{
+    m_renameIncompleteResult = hr;
+    return S_OK;
+}
+
 IFACEMETHODIMP CMockPowerRenameManagerEvents::OnRenameCompleted(bool closeUIWindowAfterRenaming)
 {
     m_renameCompleted = true;
@@ -26,6 +26,7 @@ public:
     IFACEMETHODIMP OnRegExCanceled(_In_ DWORD threadId);
     IFACEMETHODIMP OnRegExCompleted(_In_ DWORD threadId);
     IFACEMETHODIMP OnRenameStarted();
+    IFACEMETHODIMP OnRenameIncomplete(_In_ HRESULT hr);
     IFACEMETHODIMP OnRenameCompleted(bool closeUIWindowAfterRenaming);
 
     ~CMockPowerRenameManagerEvents()
@@ -39,6 +40,7 @@ public:
     bool m_regExCompleted = false;
     bool m_renameStarted = false;
     bool m_renameCompleted = false;
+    HRESULT m_renameIncompleteResult = S_OK;
     bool m_closeUIWindowAfterRenaming = false;
     long m_refCount = 0;
 };
\ No newline at end of file
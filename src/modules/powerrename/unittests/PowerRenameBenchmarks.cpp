@@ -0,0 +1,316 @@
+#include "pch.h"
+#include "powerrename/lib/Settings.h"
+#include <PowerRenameInterfaces.h>
+#include <PowerRenameRegEx.h>
+#include <LiteralMatcher.h>
+#include <MetadataHeaderParser.h>
+#include <wincodec.h>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace PowerRenameBenchmarks
+{
+    // Builds names shaped like the ones found on photo shares, e.g. "IMG_004217 (copy).jpg".
+    static std::vector<std::wstring> MakeSyntheticNames(size_t count)
+    {
+        static const wchar_t* prefixes[] = { L"IMG_", L"DSC", L"Screenshot ", L"holiday-", L"scan_" };
+        static const wchar_t* extensions[] = { L".jpg", L".png", L".heic", L".tif", L".txt" };
+
+        std::vector<std::wstring> names;
+        names.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            std::wstring name = prefixes[i % ARRAYSIZE(prefixes)];
+            name += std::to_wstring(100000 + i);
+            if (i % 7 == 0)
+            {
+                name += L" (copy)";
+            }
+            name += extensions[i % ARRAYSIZE(extensions)];
+            names.push_back(std::move(name));
+        }
+        return names;
+    }
+
+    // Runs Replace over every name and logs the achieved throughput.
+    static void MeasureReplace(PCWSTR label, PCWSTR search, PCWSTR replace, DWORD flags, size_t count)
+    {
+        CComPtr<IPowerRenameRegEx> renameRegEx;
+        Assert::IsTrue(CPowerRenameRegEx::s_CreateInstance(&renameRegEx) == S_OK);
+        Assert::IsTrue(renameRegEx->PutFlags(flags) == S_OK);
+        Assert::IsTrue(renameRegEx->PutSearchTerm(search) == S_OK);
+        Assert::IsTrue(renameRegEx->PutReplaceTerm(replace) == S_OK);
+
+        const auto names = MakeSyntheticNames(count);
+        unsigned long index = {};
+
+        const auto start = std::chrono::steady_clock::now();
+        for (const auto& name : names)
+        {
+            PWSTR result = nullptr;
+            Assert::IsTrue(renameRegEx->Replace(name.c_str(), &result, index) == S_OK);
+            CoTaskMemFree(result);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double itemsPerSecond = elapsed.count() > 0 ? count / elapsed.count() : 0.0;
+        Logger::WriteMessage((std::wstring(label) + L": " + std::to_wstring(count) + L" items in " +
+                              std::to_wstring(elapsed.count()) + L" s (" + std::to_wstring(static_cast<size_t>(itemsPerSecond)) + L" items/s)\n")
+                                 .c_str());
+    }
+
+    static void MeasureAllSizes(PCWSTR label, PCWSTR search, PCWSTR replace, DWORD flags)
+    {
+        for (size_t count : { 10'000, 100'000, 1'000'000 })
+        {
+            MeasureReplace(label, search, replace, flags, count);
+        }
+    }
+
+    TEST_CLASS (RegExBenchmarks)
+    {
+    public:
+        TEST_CLASS_CLEANUP(ClassCleanup)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(StdRegExThroughput)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (StdRegExThroughput)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+            MeasureAllSizes(L"std::wregex", L"(IMG_|DSC)(\\d+)", L"Photo_$2", UseRegularExpressions | MatchAllOccurrences);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(BoostRegExThroughput)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (BoostRegExThroughput)
+        {
+            CSettingsInstance().SetUseBoostLib(true);
+            MeasureAllSizes(L"boost::wregex", L"(IMG_|DSC)(\\d+)", L"Photo_$2", UseRegularExpressions | MatchAllOccurrences);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(EnumeratedRegExThroughput)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (EnumeratedRegExThroughput)
+        {
+            CSettingsInstance().SetUseBoostLib(false);
+            MeasureAllSizes(L"std::wregex + enumerate", L"\\d+", L"${padding=6}", UseRegularExpressions | EnumerateItems);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(LiteralThroughput)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (LiteralThroughput)
+        {
+            MeasureAllSizes(L"literal", L"copy", L"original", MatchAllOccurrences);
+        }
+    };
+
+    // Literal search as it was done before LiteralMatcher: both strings are lowered again for
+    // every occurrence that is looked up.
+    static bool LegacyLiteralReplace(std::wstring source, const std::wstring& search, const std::wstring& replace, bool caseInsensitive, std::wstring& result)
+    {
+        auto find = [](std::wstring data, std::wstring toSearch, bool caseInsensitive, size_t pos) {
+            if (caseInsensitive)
+            {
+                std::transform(data.begin(), data.end(), data.begin(), ::towlower);
+                std::transform(toSearch.begin(), toSearch.end(), toSearch.begin(), ::towlower);
+            }
+            return data.find(toSearch, pos);
+        };
+
+        bool matched = false;
+        result = source;
+        size_t pos = 0;
+        do
+        {
+            pos = find(source, search, caseInsensitive, pos);
+            if (pos != std::wstring::npos)
+            {
+                result = source.replace(pos, search.length(), replace);
+                pos += replace.length();
+                matched = true;
+            }
+        } while (pos != std::wstring::npos);
+        return matched;
+    }
+
+    static void MeasureLiteralMatcher(bool caseInsensitive)
+    {
+        // Long names with many hits are where re-lowering the name per occurrence hurts most
+        std::vector<std::wstring> names;
+        for (size_t i = 0; i < 20'000; i++)
+        {
+            std::wstring name;
+            for (size_t j = 0; j < 12; j++)
+            {
+                name += (i + j) % 3 ? L"Copy of Report " : L"copy of \u00c9t\u00e9 ";
+            }
+            name += std::to_wstring(i) + L".docx";
+            names.push_back(std::move(name));
+        }
+
+        const std::wstring search = L"copy";
+        const std::wstring replace = L"Draft";
+        const LiteralMatcher matcher(search, caseInsensitive);
+
+        std::vector<std::wstring> legacyResults(names.size());
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            LegacyLiteralReplace(names[i], search, replace, caseInsensitive, legacyResults[i]);
+        }
+        const std::chrono::duration<double> legacyElapsed = std::chrono::steady_clock::now() - start;
+
+        std::vector<std::wstring> results(names.size());
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            matcher.Replace(names[i], replace, true, results[i]);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            Assert::AreEqual(legacyResults[i], results[i]);
+        }
+
+        Logger::WriteMessage((std::wstring(caseInsensitive ? L"case insensitive" : L"case sensitive") + L": legacy " +
+                              std::to_wstring(legacyElapsed.count()) + L" s, LiteralMatcher " + std::to_wstring(elapsed.count()) + L" s\n")
+                                 .c_str());
+    }
+
+    TEST_CLASS (LiteralMatcherBenchmarks)
+    {
+    public:
+        BEGIN_TEST_METHOD_ATTRIBUTE(CaseInsensitiveLongNames)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (CaseInsensitiveLongNames)
+        {
+            MeasureLiteralMatcher(true);
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(CaseSensitiveLongNames)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (CaseSensitiveLongNames)
+        {
+            MeasureLiteralMatcher(false);
+        }
+    };
+
+    static std::wstring GetTestDataPath()
+    {
+        HMODULE hModule = nullptr;
+        GetModuleHandleExW(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+                           reinterpret_cast<LPCWSTR>(&GetTestDataPath),
+                           &hModule);
+
+        wchar_t modulePath[MAX_PATH];
+        GetModuleFileNameW(hModule, modulePath, MAX_PATH);
+        return (std::filesystem::path(modulePath).parent_path() / L"testdata").wstring();
+    }
+
+    // Compares reading EXIF and XMP from the file headers with just opening a WIC decoder and its
+    // metadata reader, which is what the WIC extractor has to do before it can query anything.
+    static void MeasureMetadataExtraction(PCWSTR fileName, size_t iterations)
+    {
+        const std::wstring filePath = GetTestDataPath() + L"\\" + fileName;
+
+        CComPtr<IWICImagingFactory> factory;
+        Assert::IsTrue(SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))));
+
+        auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            CComPtr<IWICBitmapDecoder> decoder;
+            CComPtr<IWICBitmapFrameDecode> frame;
+            CComPtr<IWICMetadataQueryReader> reader;
+            if (FAILED(factory->CreateDecoderFromFilename(filePath.c_str(), nullptr, GENERIC_READ, WICDecodeMetadataCacheOnDemand, &decoder)) ||
+                FAILED(decoder->GetFrame(0, &frame)) ||
+                FAILED(frame->GetMetadataQueryReader(&reader)))
+            {
+                Logger::WriteMessage((std::wstring(fileName) + L": no WIC decoder available, skipping\n").c_str());
+                return;
+            }
+        }
+        const std::chrono::duration<double> wicElapsed = std::chrono::steady_clock::now() - start;
+
+        uint64_t bytesRead = 0;
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++)
+        {
+            HANDLE file = CreateFileW(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            Assert::IsTrue(file != INVALID_HANDLE_VALUE);
+
+            LARGE_INTEGER fileSize{};
+            GetFileSizeEx(file, &fileSize);
+
+            PowerRenameLib::MetadataHeaderParser parser(
+                [file](uint64_t offset, void* buffer, size_t size) -> size_t {
+                    OVERLAPPED overlapped{};
+                    overlapped.Offset = static_cast<DWORD>(offset);
+                    overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+                    DWORD count = 0;
+                    return ReadFile(file, buffer, static_cast<DWORD>(size), &count, &overlapped) ? count : 0;
+                },
+                static_cast<uint64_t>(fileSize.QuadPart));
+
+            PowerRenameLib::EXIFMetadata exif;
+            PowerRenameLib::XMPMetadata xmp;
+            Assert::IsTrue(parser.ParseEXIF(exif, nullptr));
+            Assert::IsTrue(parser.ParseXMP(xmp, nullptr));
+            bytesRead = parser.GetBytesRead();
+
+            CloseHandle(file);
+        }
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        Logger::WriteMessage((std::wstring(fileName) + L": WIC decoder " + std::to_wstring(wicElapsed.count()) + L" s, header parser " +
+                              std::to_wstring(elapsed.count()) + L" s for " + std::to_wstring(iterations) + L" files, " +
+                              std::to_wstring(bytesRead) + L" bytes read per file\n")
+                                 .c_str());
+    }
+
+    TEST_CLASS (MetadataExtractionBenchmarks)
+    {
+        static inline bool comInitialized = false;
+
+    public:
+        TEST_CLASS_INITIALIZE(ClassInitialize)
+        {
+            comInitialized = SUCCEEDED(CoInitializeEx(nullptr, COINIT_MULTITHREADED));
+        }
+
+        TEST_CLASS_CLEANUP(ClassCleanup)
+        {
+            if (comInitialized)
+            {
+                CoUninitialize();
+            }
+        }
+
+        BEGIN_TEST_METHOD_ATTRIBUTE(HeaderParserVsWICDecoder)
+            TEST_METHOD_ATTRIBUTE(L"TestCategory", L"Benchmark")
+        END_TEST_METHOD_ATTRIBUTE()
+        TEST_METHOD (HeaderParserVsWICDecoder)
+        {
+            for (PCWSTR fileName : { L"exif_test.jpg", L"exif_test_2.jpg", L"avif_test.avif" })
+            {
+                MeasureMetadataExtraction(fileName, 500);
+            }
+        }
+    };
+}
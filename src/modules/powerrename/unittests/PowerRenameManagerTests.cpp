@@ -174,6 +174,76 @@ namespace PowerRenameManagerTests
             RenameHelper(renamePairs, ARRAYSIZE(renamePairs), L"foo", L"bar", SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }, DEFAULT_FLAGS);
         }
 
+        TEST_METHOD (VerifyEnumeratedRenameAcrossChunks)
+        {
+            // Enough items to be split across several preview chunks. Counter values must follow
+            // item order and skip items that do not match, exactly like a serial pass.
+            std::vector<rename_pairs> renamePairs;
+            int counter = 0;
+            for (int i = 0; i < 600; i++)
+            {
+                if (i % 3 == 0)
+                {
+                    renamePairs.push_back({ L"skip" + std::to_wstring(i) + L".txt", L"skip" + std::to_wstring(i) + L"_norename.txt", true, false, 0 });
+                }
+                else
+                {
+                    renamePairs.push_back({ L"foo" + std::to_wstring(i) + L".txt", L"bar" + std::to_wstring(counter++) + L"_" + std::to_wstring(i) + L".txt", true, true, 0 });
+                }
+            }
+
+            RenameHelper(renamePairs.data(), static_cast<int>(renamePairs.size()), L"foo", L"bar${}_", SYSTEMTIME{ 2020, 7, 3, 22, 15, 6, 42, 453 }, DEFAULT_FLAGS | EnumerateItems);
+        }
+
+        TEST_METHOD (VerifyRenameAfterIncrementalEdits)
+        {
+            // Replace-only and literal-extension edits only revisit previously matched items.
+            // The final preview must still be the same as a full pass with the last terms.
+            CTestFileHelper testFileHelper;
+            const std::vector<std::wstring> names = { L"foo1.txt", L"fob2.txt", L"fo3.txt", L"bar4.txt" };
+            for (const auto& name : names)
+            {
+                Assert::IsTrue(testFileHelper.AddFile(name));
+            }
+
+            CComPtr<IPowerRenameManager> mgr;
+            Assert::IsTrue(CPowerRenameManager::s_CreateInstance(&mgr) == S_OK);
+            for (const auto& name : names)
+            {
+                CComPtr<IPowerRenameItem> item;
+                CMockPowerRenameItem::CreateInstance(testFileHelper.GetFullPath(name).c_str(), name.c_str(), 0, false, SYSTEMTIME{ 0 }, &item);
+                mgr->AddItem(item);
+            }
+
+            CComPtr<IPowerRenameRegEx> renRegEx;
+            Assert::IsTrue(mgr->GetRenameRegEx(&renRegEx) == S_OK);
+            renRegEx->PutFlags(DEFAULT_FLAGS | EnumerateItems);
+            renRegEx->PutSearchTerm(L"fo");
+            renRegEx->PutReplaceTerm(L"x");
+            renRegEx->PutReplaceTerm(L"y${}_");
+            renRegEx->PutSearchTerm(L"foo");
+            renRegEx->PutReplaceTerm(L"z${}_");
+
+            bool replaceSuccess = false;
+            for (int step = 0; step < 20; step++)
+            {
+                replaceSuccess = mgr->Rename(0, true) == S_OK;
+                if (replaceSuccess)
+                {
+                    break;
+                }
+                Sleep(10);
+            }
+            Assert::IsTrue(replaceSuccess);
+
+            Assert::IsTrue(testFileHelper.PathExistsCaseSensitive(L"z0_1.txt"));
+            Assert::IsTrue(testFileHelper.PathExistsCaseSensitive(L"fob2.txt"));
+            Assert::IsTrue(testFileHelper.PathExistsCaseSensitive(L"fo3.txt"));
+            Assert::IsTrue(testFileHelper.PathExistsCaseSensitive(L"bar4.txt"));
+
+            Assert::IsTrue(mgr->Shutdown() == S_OK);
+        }
+
         TEST_METHOD (VerifyFilesOnlyRename)
         {
             // Verify only files are renamed when folders match too
@@ -0,0 +1,117 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "../hotkey_lookup_table.h"
+#include "../latency_histogram.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RunnerUnitTests
+{
+    using CentralizedKeyboardHook::HotkeyLookupTable;
+
+    TEST_CLASS(HotkeyLookupTableTests)
+    {
+        static HotkeyLookupTable::Entry MakeEntry(const HotkeyLookupTable::Hotkey& hotkey, const std::wstring& moduleName)
+        {
+            return { .hotkey = hotkey, .moduleName = moduleName, .action = [] { return true; } };
+        }
+
+    public:
+        TEST_METHOD(Find_MatchesModifiersAndKey)
+        {
+            HotkeyLookupTable table({ MakeEntry({ .win = true, .shift = true, .key = 'C' }, L"ColorPicker"),
+                                      MakeEntry({ .ctrl = true, .alt = true, .key = 'C' }, L"Other") });
+
+            auto entry = table.Find(HotkeyLookupTable::WinModifier | HotkeyLookupTable::ShiftModifier, 'C');
+            Assert::IsNotNull(entry);
+            Assert::AreEqual(std::wstring(L"ColorPicker"), entry->moduleName);
+
+            entry = table.Find(HotkeyLookupTable::CtrlModifier | HotkeyLookupTable::AltModifier, 'C');
+            Assert::IsNotNull(entry);
+            Assert::AreEqual(std::wstring(L"Other"), entry->moduleName);
+
+            Assert::IsNull(table.Find(HotkeyLookupTable::WinModifier, 'C'));
+            Assert::IsNull(table.Find(HotkeyLookupTable::WinModifier | HotkeyLookupTable::ShiftModifier, 'D'));
+        }
+
+        TEST_METHOD(HasKey_OnlyForRegisteredKeys)
+        {
+            HotkeyLookupTable table({ MakeEntry({ .win = true, .key = VK_OEM_2 }, L"ShortcutGuide") });
+
+            Assert::IsTrue(table.HasKey(VK_OEM_2));
+            Assert::IsFalse(table.HasKey('A'));
+            Assert::IsFalse(HotkeyLookupTable().HasKey(VK_OEM_2));
+        }
+
+        TEST_METHOD(Find_SameHotkey_FirstRegisteredWins)
+        {
+            const HotkeyLookupTable::Hotkey hotkey{ .win = true, .ctrl = true, .key = 'T' };
+            HotkeyLookupTable table({ MakeEntry(hotkey, L"First"), MakeEntry(hotkey, L"Second") });
+
+            auto entry = table.Find(HotkeyLookupTable::GetModifierMask(hotkey), 'T');
+            Assert::IsNotNull(entry);
+            Assert::AreEqual(std::wstring(L"First"), entry->moduleName);
+
+            // Once the first one is removed, the other one is found
+            auto entries = table.GetEntries();
+            std::erase_if(entries, [](const HotkeyLookupTable::Entry& e) { return e.moduleName == L"First"; });
+            HotkeyLookupTable updated(std::move(entries));
+            entry = updated.Find(HotkeyLookupTable::GetModifierMask(hotkey), 'T');
+            Assert::IsNotNull(entry);
+            Assert::AreEqual(std::wstring(L"Second"), entry->moduleName);
+        }
+
+        TEST_METHOD(GetModifierMask_EachModifierHasItsBit)
+        {
+            Assert::AreEqual<int>(0, HotkeyLookupTable::GetModifierMask({ .key = 'A' }));
+            Assert::AreEqual<int>(HotkeyLookupTable::WinModifier | HotkeyLookupTable::CtrlModifier | HotkeyLookupTable::ShiftModifier | HotkeyLookupTable::AltModifier,
+                                  HotkeyLookupTable::GetModifierMask({ .win = true, .ctrl = true, .shift = true, .alt = true, .key = 'A' }));
+        }
+    };
+
+    TEST_CLASS(LatencyHistogramTests)
+    {
+    public:
+        TEST_METHOD(GetStats_Empty)
+        {
+            LatencyHistogram histogram;
+            auto stats = histogram.GetStats();
+            Assert::AreEqual<uint64_t>(0, stats.count);
+            Assert::AreEqual(0.0, stats.p99.count());
+        }
+
+        TEST_METHOD(GetStats_PercentilesWithinBucketPrecision)
+        {
+            using namespace std::chrono_literals;
+
+            // 98 fast events, 2 slow ones
+            LatencyHistogram histogram;
+            for (int i = 0; i < 98; i++)
+            {
+                histogram.Record(10us);
+            }
+            histogram.Record(1ms);
+            histogram.Record(2ms);
+
+            auto stats = histogram.GetStats();
+            Assert::AreEqual<uint64_t>(100, stats.count);
+            Assert::IsTrue(stats.p50.count() >= 10.0 && stats.p50.count() <= 12.5);
+            Assert::IsTrue(stats.p99.count() >= 1000.0 && stats.p99.count() <= 1250.0);
+            Assert::AreEqual(2000.0, stats.max.count());
+        }
+
+        TEST_METHOD(Reset_ClearsCounters)
+        {
+            LatencyHistogram histogram;
+            histogram.Record(std::chrono::microseconds(5));
+            histogram.Reset();
+
+            Assert::AreEqual<uint64_t>(0, histogram.GetStats().count);
+        }
+    };
+}
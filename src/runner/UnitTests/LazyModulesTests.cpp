@@ -0,0 +1,111 @@
+// Copyright (c) Microsoft Corporation
+// The Microsoft Corporation licenses this file to you under the MIT license.
+// See the LICENSE file in the project root for more information.
+
+#include "pch.h"
+#include "CppUnitTest.h"
+
+#include "../lazy_modules.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace RunnerUnitTests
+{
+    namespace
+    {
+        powertoys_gpo::gpo_rule_configured_t GpoNotConfigured()
+        {
+            return powertoys_gpo::gpo_rule_configured_not_configured;
+        }
+
+        powertoys_gpo::gpo_rule_configured_t GpoEnabled()
+        {
+            return powertoys_gpo::gpo_rule_configured_enabled;
+        }
+
+        powertoys_gpo::gpo_rule_configured_t GpoDisabled()
+        {
+            return powertoys_gpo::gpo_rule_configured_disabled;
+        }
+
+        json::JsonObject EnabledSettings(bool enabled)
+        {
+            json::JsonObject settings;
+            settings.SetNamedValue(L"ColorPicker", json::value(enabled));
+            return settings;
+        }
+    }
+
+    TEST_CLASS(LazyModulesTests)
+    {
+    public:
+        TEST_METHOD(IsDisabledOnStartup_DisabledInSettings_IsLazy)
+        {
+            const KnownPowertoyModule colorPicker{ L"PowerToys.ColorPicker.dll", L"ColorPicker", GpoNotConfigured };
+
+            Assert::IsTrue(is_disabled_on_startup(colorPicker, EnabledSettings(false)));
+            Assert::IsFalse(is_disabled_on_startup(colorPicker, EnabledSettings(true)));
+        }
+
+        TEST_METHOD(IsDisabledOnStartup_WithoutSetting_IsLoaded)
+        {
+            // The default enabled state is only known from the module itself
+            const KnownPowertoyModule colorPicker{ L"PowerToys.ColorPicker.dll", L"ColorPicker", GpoNotConfigured };
+
+            Assert::IsFalse(is_disabled_on_startup(colorPicker, json::JsonObject{}));
+        }
+
+        TEST_METHOD(IsDisabledOnStartup_GroupPolicyOverridesSettings)
+        {
+            const KnownPowertoyModule forcedOn{ L"PowerToys.ColorPicker.dll", L"ColorPicker", GpoEnabled };
+            const KnownPowertoyModule forcedOff{ L"PowerToys.ColorPicker.dll", L"ColorPicker", GpoDisabled };
+
+            Assert::IsFalse(is_disabled_on_startup(forcedOn, EnabledSettings(false)));
+            Assert::IsTrue(is_disabled_on_startup(forcedOff, EnabledSettings(true)));
+        }
+
+        TEST_METHOD(IsDisabledOnStartup_UndeclaredModule_IsLoaded)
+        {
+            const KnownPowertoyModule powerRename{ L"WinUI3Apps/PowerToys.PowerRenameExt.dll" };
+
+            Assert::IsFalse(is_disabled_on_startup(powerRename, EnabledSettings(false)));
+        }
+
+        TEST_METHOD(Take_EnableAfterStart_LoadsModuleOnce)
+        {
+            LazyModules lazyModules;
+            lazyModules.add(L"ColorPicker", L"PowerToys.ColorPicker.dll");
+            lazyModules.add(L"Awake", L"PowerToys.AwakeModuleInterface.dll");
+
+            // Enabling the module in the settings takes it out of the lazy modules to load it
+            const auto filename = lazyModules.take(L"ColorPicker");
+            Assert::IsTrue(filename.has_value());
+            Assert::AreEqual(std::wstring_view{ L"PowerToys.ColorPicker.dll" }, *filename);
+
+            // Enabling it again doesn't load a second instance
+            Assert::IsFalse(lazyModules.take(L"ColorPicker").has_value());
+            Assert::AreEqual(static_cast<size_t>(1), lazyModules.size());
+        }
+
+        TEST_METHOD(Take_ModuleLoadedOnStartup_IsNotLazy)
+        {
+            LazyModules lazyModules;
+            lazyModules.add(L"ColorPicker", L"PowerToys.ColorPicker.dll");
+
+            Assert::IsFalse(lazyModules.take(L"FancyZones").has_value());
+            Assert::AreEqual(static_cast<size_t>(1), lazyModules.size());
+        }
+
+        TEST_METHOD(TakeAll_ReturnsEveryModuleAndEmpties)
+        {
+            LazyModules lazyModules;
+            lazyModules.add(L"ColorPicker", L"PowerToys.ColorPicker.dll");
+            lazyModules.add(L"Awake", L"PowerToys.AwakeModuleInterface.dll");
+
+            const auto taken = lazyModules.take_all();
+            Assert::AreEqual(static_cast<size_t>(2), taken.size());
+            Assert::IsTrue(lazyModules.empty());
+            Assert::IsTrue(lazyModules.take_all().empty());
+        }
+    };
+}
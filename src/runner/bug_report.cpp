@@ -1,7 +1,9 @@
 #include "pch.h"
 #include "bug_report.h"
 #include "bug_report_dialog.h"
+#include "centralized_kb_hook.h"
 #include "Generated files/resource.h"
+#include <common/logger/logger.h>
 #include <common/utils/process_path.h>
 #include <common/utils/resources.h>
 
@@ -47,6 +49,10 @@ void BugReportManager::launch_bug_report() noexcept
     bool expected_isBugReportRunning = false;
     if (m_isBugReportRunning.compare_exchange_strong(expected_isBugReportRunning, true))
     {
+        // The runner log is collected in the report, so the hook latency ends up in it
+        const auto hookLatency = CentralizedKeyboardHook::GetHookLatencyStats();
+        Logger::info(L"Keyboard hook latency: {} events, p50 {:.1f} us, p99 {:.1f} us, max {:.1f} us", hookLatency.count, hookLatency.p50.count(), hookLatency.p99.count(), hookLatency.max.count());
+
         // Notify observers that bug report is starting
         notify_observers(true);
 
@@ -1,6 +1,8 @@
 #include "pch.h"
 #include "centralized_kb_hook.h"
+#include "hotkey_lookup_table.h"
 #include <atomic>
+#include <memory>
 #include <common/debug_control.h>
 #include <common/utils/winapi_error.h>
 #include <common/logger/logger.h>
@@ -8,21 +10,12 @@
 
 namespace CentralizedKeyboardHook
 {
-    struct HotkeyDescriptor
-    {
-        Hotkey hotkey;
-        std::wstring moduleName;
-        std::function<bool()> action;
-
-        bool operator<(const HotkeyDescriptor& other) const
-        {
-            return hotkey < other.hotkey;
-        };
-    };
-
-    std::multiset<HotkeyDescriptor> hotkeyDescriptors;
+    // The hook loads the published table once per key press, writers copy it under the mutex and publish the copy.
+    // The loaded table stays alive until the hook is done with it, while the action runs.
+    std::atomic<std::shared_ptr<const HotkeyLookupTable>> hotkeyTable{ std::make_shared<const HotkeyLookupTable>() };
     std::mutex mutex;
     HHOOK hHook{};
+    LatencyHistogram hookLatency;
 
     // To store information about handling pressed keys.
     struct PressedKeyDescriptor
@@ -38,7 +31,9 @@ namespace CentralizedKeyboardHook
             return virtualKey < other.virtualKey;
         };
     };
-    std::multiset<PressedKeyDescriptor> pressedKeyDescriptors;
+    // Published like the hotkey table, pressedKeyMutex only serializes the writers
+    using PressedKeyDescriptors = std::multiset<PressedKeyDescriptor>;
+    std::atomic<std::shared_ptr<const PressedKeyDescriptors>> pressedKeyDescriptors{ std::make_shared<const PressedKeyDescriptors>() };
     std::mutex pressedKeyMutex;
 
     // keep track of last pressed key, to detect repeated keys and if there are more keys pressed.
@@ -63,13 +58,8 @@ namespace CentralizedKeyboardHook
         UINT_PTR idTimer,
         DWORD /*dwTime*/)
     {
-        std::multiset<PressedKeyDescriptor> copy;
-        {
-            // Make a copy, to look for the action to call.
-            std::unique_lock lock{ pressedKeyMutex };
-            copy = pressedKeyDescriptors;
-        }
-        for (const auto& it : copy)
+        const auto descriptors = pressedKeyDescriptors.load();
+        for (const auto& it : *descriptors)
         {
             if (it.idTimer == idTimer)
             {
@@ -85,34 +75,27 @@ namespace CentralizedKeyboardHook
         KillTimer(hwnd, idTimer);
     }
 
-    LRESULT CALLBACK KeyboardHookProc(_In_ int nCode, _In_ WPARAM wParam, _In_ LPARAM lParam)
+    // Returns true if the key press invoked a hotkey and must be swallowed
+    bool HandleKeyboardHookEvent(WPARAM wParam, const KBDLLHOOKSTRUCT& keyPressInfo)
     {
-        if (nCode < 0)
-        {
-            return CallNextHookEx(hHook, nCode, wParam, lParam);
-        }
-
-        const auto& keyPressInfo = *reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam);
-
         if (keyPressInfo.dwExtraInfo == PowertoyModuleIface::CENTRALIZED_KEYBOARD_HOOK_DONT_TRIGGER_FLAG)
         {
             // The new keystroke was generated from one of our actions. We should pass it along.
-            return CallNextHookEx(hHook, nCode, wParam, lParam);
+            return false;
         }
 
         // Check if the keys are pressed.
-        if (!pressedKeyDescriptors.empty())
+        const auto pressedKeys = pressedKeyDescriptors.load();
+        if (!pressedKeys->empty())
         {
             bool wasKeyPressed = vkCodePressed != VK_DISABLED;
-            // Hold the lock for the shortest possible duration
             if ((wParam == WM_KEYDOWN || wParam == WM_SYSKEYDOWN))
             {
                 if (!wasKeyPressed)
                 {
                     // If no key was pressed before, let's start a timer to take into account this new key.
-                    std::unique_lock lock{ pressedKeyMutex };
                     PressedKeyDescriptor dummy{ .virtualKey = keyPressInfo.vkCode };
-                    auto [it, last] = pressedKeyDescriptors.equal_range(dummy);
+                    auto [it, last] = pressedKeys->equal_range(dummy);
                     for (; it != last; ++it)
                     {
                         SetTimer(runnerWindow, it->idTimer, it->millisecondsToPress, PressedKeyTimerProc);
@@ -121,9 +104,8 @@ namespace CentralizedKeyboardHook
                 else if (vkCodePressed != keyPressInfo.vkCode)
                 {
                     // If a different key was pressed, let's clear the timers we have started for the previous key.
-                    std::unique_lock lock{ pressedKeyMutex };
                     PressedKeyDescriptor dummy{ .virtualKey = vkCodePressed };
-                    auto [it, last] = pressedKeyDescriptors.equal_range(dummy);
+                    auto [it, last] = pressedKeys->equal_range(dummy);
                     for (; it != last; ++it)
                     {
                         KillTimer(runnerWindow, it->idTimer);
@@ -133,9 +115,8 @@ namespace CentralizedKeyboardHook
             }
             if (wParam == WM_KEYUP || wParam == WM_SYSKEYUP)
             {
-                std::unique_lock lock{ pressedKeyMutex };
                 PressedKeyDescriptor dummy{ .virtualKey = keyPressInfo.vkCode };
-                auto [it, last] = pressedKeyDescriptors.equal_range(dummy);
+                auto [it, last] = pressedKeys->equal_range(dummy);
                 for (; it != last; ++it)
                 {
                     KillTimer(runnerWindow, it->idTimer);
@@ -146,7 +127,15 @@ namespace CentralizedKeyboardHook
 
         if ((wParam != WM_KEYDOWN) && (wParam != WM_SYSKEYDOWN))
         {
-            return CallNextHookEx(hHook, nCode, wParam, lParam);
+            return false;
+        }
+
+        // Most key presses don't end a hotkey, the modifier state is only read for the ones which do.
+        const auto vkCode = static_cast<uint8_t>(keyPressInfo.vkCode);
+        const auto table = hotkeyTable.load();
+        if (!table->HasKey(vkCode))
+        {
+            return false;
         }
 
         Hotkey hotkey{
@@ -154,51 +143,53 @@ namespace CentralizedKeyboardHook
             .ctrl = static_cast<bool>(GetAsyncKeyState(VK_CONTROL) & 0x8000),
             .shift = static_cast<bool>(GetAsyncKeyState(VK_SHIFT) & 0x8000),
             .alt = static_cast<bool>(GetAsyncKeyState(VK_MENU) & 0x8000),
-            .key = static_cast<unsigned char>(keyPressInfo.vkCode)
+            .key = vkCode
         };
 
         if (hotkey == Hotkey{})
         {
-            return CallNextHookEx(hHook, nCode, wParam, lParam);
+            return false;
         }
 
-        std::function<bool()> action;
+        const auto entry = table->Find(HotkeyLookupTable::GetModifierMask(hotkey), vkCode);
+        if (entry && entry->action && entry->action())
         {
-            // Hold the lock for the shortest possible duration
-            std::unique_lock lock{ mutex };
-            HotkeyDescriptor dummy{ .hotkey = hotkey };
-            auto it = hotkeyDescriptors.find(dummy);
-            if (it != hotkeyDescriptors.end())
-            {
-                action = it->action;
-            }
+            // After invoking the hotkey send a dummy key to prevent Start Menu from activating
+            INPUT dummyEvent[1] = {};
+            dummyEvent[0].type = INPUT_KEYBOARD;
+            dummyEvent[0].ki.wVk = 0xFF;
+            dummyEvent[0].ki.dwFlags = KEYEVENTF_KEYUP;
+            dummyEvent[0].ki.dwExtraInfo = PowertoyModuleIface::CENTRALIZED_KEYBOARD_HOOK_DONT_TRIGGER_FLAG;
+            SendInput(1, dummyEvent, sizeof(INPUT));
+
+            // Swallow the key press
+            return true;
         }
 
-        if (action)
+        return false;
+    }
+
+    LRESULT CALLBACK KeyboardHookProc(_In_ int nCode, _In_ WPARAM wParam, _In_ LPARAM lParam)
+    {
+        if (nCode < 0)
         {
-            if (action())
-            {
-                // After invoking the hotkey send a dummy key to prevent Start Menu from activating
-                INPUT dummyEvent[1] = {};
-                dummyEvent[0].type = INPUT_KEYBOARD;
-                dummyEvent[0].ki.wVk = 0xFF;
-                dummyEvent[0].ki.dwFlags = KEYEVENTF_KEYUP;
-                dummyEvent[0].ki.dwExtraInfo = PowertoyModuleIface::CENTRALIZED_KEYBOARD_HOOK_DONT_TRIGGER_FLAG;
-                SendInput(1, dummyEvent, sizeof(INPUT));
-
-                // Swallow the key press
-                return 1;
-            }
+            return CallNextHookEx(hHook, nCode, wParam, lParam);
         }
 
-        return CallNextHookEx(hHook, nCode, wParam, lParam);
+        const auto start = std::chrono::steady_clock::now();
+        const bool swallow = HandleKeyboardHookEvent(wParam, *reinterpret_cast<KBDLLHOOKSTRUCT*>(lParam));
+        hookLatency.Record(std::chrono::steady_clock::now() - start);
+
+        return swallow ? 1 : CallNextHookEx(hHook, nCode, wParam, lParam);
     }
 
     void SetHotkeyAction(const std::wstring& moduleName, const Hotkey& hotkey, std::function<bool()>&& action) noexcept
     {
         Logger::trace(L"Register hotkey action for {}", moduleName);
         std::unique_lock lock{ mutex };
-        hotkeyDescriptors.insert({ .hotkey = hotkey, .moduleName = moduleName, .action = std::move(action) });
+        auto entries = hotkeyTable.load()->GetEntries();
+        entries.push_back({ .hotkey = hotkey, .moduleName = moduleName, .action = std::move(action) });
+        hotkeyTable.store(std::make_shared<const HotkeyLookupTable>(std::move(entries)));
     }
 
     void AddPressedKeyAction(const std::wstring& moduleName, const DWORD vk, const UINT milliseconds, std::function<bool()>&& action) noexcept
@@ -209,17 +200,20 @@ namespace CentralizedKeyboardHook
         const UINT lowerId = vk & 0xFFFF; // The key to press can be the lower ID.
         const UINT timerId = upperId << 16 | lowerId;
         std::unique_lock lock{ pressedKeyMutex };
-        pressedKeyDescriptors.insert({ .virtualKey = vk, .moduleName = moduleName, .action = std::move(action), .idTimer = timerId, .millisecondsToPress = milliseconds });
+        auto descriptors = std::make_shared<PressedKeyDescriptors>(*pressedKeyDescriptors.load());
+        descriptors->insert({ .virtualKey = vk, .moduleName = moduleName, .action = std::move(action), .idTimer = timerId, .millisecondsToPress = milliseconds });
+        pressedKeyDescriptors.store(std::move(descriptors));
     }
 
     void ClearPressedKeyActions(const std::wstring& moduleName) noexcept
     {
         Logger::trace(L"UnRegister pressed key action for {}", moduleName);
         std::unique_lock lock{ pressedKeyMutex };
+        auto descriptors = std::make_shared<PressedKeyDescriptors>(*pressedKeyDescriptors.load());
         const DWORD trackedKey = vkCodePressed.load();
         bool removedTrackedKey = false;
-        auto it = pressedKeyDescriptors.begin();
-        while (it != pressedKeyDescriptors.end())
+        auto it = descriptors->begin();
+        while (it != descriptors->end())
         {
             if (it->moduleName == moduleName)
             {
@@ -229,7 +223,7 @@ namespace CentralizedKeyboardHook
                     KillTimer(runnerWindow, it->idTimer);
                 }
 
-                it = pressedKeyDescriptors.erase(it);
+                it = descriptors->erase(it);
             }
             else
             {
@@ -237,19 +231,21 @@ namespace CentralizedKeyboardHook
             }
         }
 
-        if (pressedKeyDescriptors.empty())
+        if (descriptors->empty())
         {
             vkCodePressed = VK_DISABLED;
         }
         else if (removedTrackedKey)
         {
             PressedKeyDescriptor trackedKeyDescriptor{ .virtualKey = trackedKey };
-            const auto [first, last] = pressedKeyDescriptors.equal_range(trackedKeyDescriptor);
+            const auto [first, last] = descriptors->equal_range(trackedKeyDescriptor);
             if (first == last)
             {
                 vkCodePressed = VK_DISABLED;
             }
         }
+
+        pressedKeyDescriptors.store(std::move(descriptors));
     }
 
     void ClearModuleHotkeys(const std::wstring& moduleName) noexcept
@@ -257,18 +253,9 @@ namespace CentralizedKeyboardHook
         Logger::trace(L"UnRegister hotkey action for {}", moduleName);
         {
             std::unique_lock lock{ mutex };
-            auto it = hotkeyDescriptors.begin();
-            while (it != hotkeyDescriptors.end())
-            {
-                if (it->moduleName == moduleName)
-                {
-                    it = hotkeyDescriptors.erase(it);
-                }
-                else
-                {
-                    ++it;
-                }
-            }
+            auto entries = hotkeyTable.load()->GetEntries();
+            std::erase_if(entries, [&moduleName](const HotkeyLookupTable::Entry& entry) { return entry.moduleName == moduleName; });
+            hotkeyTable.store(std::make_shared<const HotkeyLookupTable>(std::move(entries)));
         }
         ClearPressedKeyActions(moduleName);
     }
@@ -298,12 +285,9 @@ namespace CentralizedKeyboardHook
     {
         // Kill all pending pressed-key timers before unhooking to prevent
         // ghost callbacks firing after the hook is removed.
+        for (const auto& it : *pressedKeyDescriptors.load())
         {
-            std::unique_lock lock{ pressedKeyMutex };
-            for (const auto& it : pressedKeyDescriptors)
-            {
-                KillTimer(runnerWindow, it.idTimer);
-            }
+            KillTimer(runnerWindow, it.idTimer);
         }
 
         vkCodePressed = VK_DISABLED;
@@ -318,4 +302,9 @@ namespace CentralizedKeyboardHook
     {
         runnerWindow = hwnd;
     }
+
+    LatencyHistogram::Stats GetHookLatencyStats() noexcept
+    {
+        return hookLatency.GetStats();
+    }
 }
@@ -1,6 +1,7 @@
 #include "pch.h"
 
 #include "../modules/interface/powertoy_module_interface.h"
+#include "latency_histogram.h"
 
 namespace CentralizedKeyboardHook
 {
@@ -13,4 +14,7 @@ namespace CentralizedKeyboardHook
     void ClearPressedKeyActions(const std::wstring& moduleName) noexcept;
     void ClearModuleHotkeys(const std::wstring& moduleName) noexcept;
     void RegisterWindow(HWND hwnd) noexcept;
+
+    // Time spent in the keyboard hook proc since the runner started
+    LatencyHistogram::Stats GetHookLatencyStats() noexcept;
 };
@@ -194,6 +194,12 @@ GeneralSettings get_general_settings()
         settings.isModulesEnabledMap[name] = powertoy->is_enabled();
     }
 
+    // Keep the modules which are not loaded disabled in the saved settings
+    for (const auto& [name, filename] : lazy_modules())
+    {
+        settings.isModulesEnabledMap[name] = false;
+    }
+
     return settings;
 }
 
@@ -218,6 +224,12 @@ void apply_module_status_update(const json::JsonObject& module_config, bool save
     }
 
     const std::wstring name{ element.Key().c_str() };
+    if (value.GetBoolean())
+    {
+        // Modules which were disabled on startup are loaded when they get enabled
+        load_lazy_powertoy(name);
+    }
+
     if (modules().find(name) == modules().end())
     {
         Logger::warn(L"apply_module_status_update: Module {} not found", name);
@@ -408,6 +420,12 @@ void apply_general_settings(const json::JsonObject& general_configs, bool save)
                 continue;
             }
             const std::wstring name{ enabled_element.Key().c_str() };
+            if (value.GetBoolean())
+            {
+                // Modules which were disabled on startup are loaded when they get enabled
+                load_lazy_powertoy(name);
+            }
+
             const bool found = modules().find(name) != modules().end();
             if (!found)
             {
@@ -579,13 +597,13 @@ void start_enabled_powertoys()
             should_powertoy_be_enabled = false;
         }
 
+        // Hotkeys are registered afterwards for all modules at once, in register_powertoys_hotkeys
         if (should_powertoy_be_enabled)
         {
             Logger::info(L"start_enabled_powertoys: Enabling powertoy {}", name);
+            const auto start = std::chrono::steady_clock::now();
             powertoy->enable();
-            auto& hkmng = HotkeyConflictDetector::HotkeyConflictManager::GetInstance();
-            hkmng.EnableHotkeyByModule(name);
-            powertoy.UpdateHotkeyEx();
+            powertoy.timeline.enable = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
         }
     }
 }
@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "hotkey_lookup_table.h"
+
+namespace CentralizedKeyboardHook
+{
+    uint8_t HotkeyLookupTable::GetModifierMask(const Hotkey& hotkey) noexcept
+    {
+        return static_cast<uint8_t>((hotkey.win ? WinModifier : 0) |
+                                    (hotkey.ctrl ? CtrlModifier : 0) |
+                                    (hotkey.shift ? ShiftModifier : 0) |
+                                    (hotkey.alt ? AltModifier : 0));
+    }
+
+    HotkeyLookupTable::HotkeyLookupTable() noexcept
+    {
+        index.fill(NoEntry);
+    }
+
+    HotkeyLookupTable::HotkeyLookupTable(std::vector<Entry> registeredEntries) :
+        entries(std::move(registeredEntries))
+    {
+        index.fill(NoEntry);
+
+        // Entries past the index range can't be found, there are only a few dozen hotkeys in practice
+        const size_t count = std::min<size_t>(entries.size(), NoEntry);
+        for (size_t i = 0; i < count; i++)
+        {
+            const auto& hotkey = entries[i].hotkey;
+            auto& slot = index[GetModifierMask(hotkey) << 8 | hotkey.key];
+            if (slot == NoEntry)
+            {
+                slot = static_cast<uint16_t>(i);
+                keys.set(hotkey.key);
+            }
+        }
+    }
+
+    const std::vector<HotkeyLookupTable::Entry>& HotkeyLookupTable::GetEntries() const noexcept
+    {
+        return entries;
+    }
+
+    bool HotkeyLookupTable::HasKey(uint8_t vkCode) const noexcept
+    {
+        return keys.test(vkCode);
+    }
+
+    const HotkeyLookupTable::Entry* HotkeyLookupTable::Find(uint8_t modifierMask, uint8_t vkCode) const noexcept
+    {
+        const auto slot = index[(modifierMask & 0xF) << 8 | vkCode];
+        return slot != NoEntry ? &entries[slot] : nullptr;
+    }
+}
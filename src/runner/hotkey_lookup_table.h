@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../modules/interface/powertoy_module_interface.h"
+
+namespace CentralizedKeyboardHook
+{
+    // Immutable table of the hotkey actions, indexed by modifier mask and virtual key.
+    // The keyboard hook reads a published table without locking, writers publish a modified copy.
+    class HotkeyLookupTable
+    {
+    public:
+        using Hotkey = PowertoyModuleIface::Hotkey;
+
+        struct Entry
+        {
+            Hotkey hotkey;
+            std::wstring moduleName;
+            std::function<bool()> action;
+        };
+
+        static constexpr uint8_t WinModifier = 1;
+        static constexpr uint8_t CtrlModifier = 2;
+        static constexpr uint8_t ShiftModifier = 4;
+        static constexpr uint8_t AltModifier = 8;
+
+        static uint8_t GetModifierMask(const Hotkey& hotkey) noexcept;
+
+        HotkeyLookupTable() noexcept;
+
+        // Entries are in registration order. The first one registered for a hotkey is the one found.
+        explicit HotkeyLookupTable(std::vector<Entry> registeredEntries);
+
+        const std::vector<Entry>& GetEntries() const noexcept;
+
+        // Whether any hotkey uses the key, so the modifier state only needs to be read for those keys
+        bool HasKey(uint8_t vkCode) const noexcept;
+
+        const Entry* Find(uint8_t modifierMask, uint8_t vkCode) const noexcept;
+
+    private:
+        static constexpr uint16_t NoEntry = UINT16_MAX;
+
+        std::vector<Entry> entries;
+        std::bitset<256> keys;
+        std::array<uint16_t, 16 * 256> index;
+    };
+}
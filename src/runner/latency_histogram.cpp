@@ -0,0 +1,95 @@
+#include "pch.h"
+#include "latency_histogram.h"
+
+#include <bit>
+#include <cmath>
+
+size_t LatencyHistogram::GetBucket(uint64_t ticks) noexcept
+{
+    if (ticks < SubBuckets)
+    {
+        return static_cast<size_t>(ticks);
+    }
+
+    // The two bits below the highest one select the sub-bucket
+    const size_t highestBit = std::bit_width(ticks) - 1;
+    const size_t subBucket = (ticks >> (highestBit - 2)) & (SubBuckets - 1);
+    return (highestBit - 1) * SubBuckets + subBucket;
+}
+
+uint64_t LatencyHistogram::GetBucketUpperBound(size_t bucket) noexcept
+{
+    if (bucket < SubBuckets)
+    {
+        return bucket;
+    }
+
+    const size_t highestBit = bucket / SubBuckets + 1;
+    const uint64_t subBucket = bucket % SubBuckets;
+    if (highestBit >= 63)
+    {
+        return UINT64_MAX;
+    }
+
+    return ((SubBuckets + subBucket + 1) << (highestBit - 2)) - 1;
+}
+
+void LatencyHistogram::Record(std::chrono::nanoseconds latency) noexcept
+{
+    const uint64_t ticks = latency.count() > 0 ? static_cast<uint64_t>(latency.count()) / TickNanoseconds : 0;
+    buckets[GetBucket(ticks)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+
+    uint64_t max = maxTicks.load(std::memory_order_relaxed);
+    while (ticks > max && !maxTicks.compare_exchange_weak(max, ticks, std::memory_order_relaxed))
+    {
+    }
+}
+
+uint64_t LatencyHistogram::GetPercentile(uint64_t total, double percentile) const noexcept
+{
+    const auto rank = static_cast<uint64_t>(std::ceil(total * percentile));
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BucketCount; bucket++)
+    {
+        seen += buckets[bucket].load(std::memory_order_relaxed);
+        if (seen >= rank)
+        {
+            return GetBucketUpperBound(bucket);
+        }
+    }
+
+    return GetBucketUpperBound(BucketCount - 1);
+}
+
+LatencyHistogram::Stats LatencyHistogram::GetStats() const noexcept
+{
+    Stats stats;
+    stats.count = count.load(std::memory_order_relaxed);
+    if (stats.count == 0)
+    {
+        return stats;
+    }
+
+    // Concurrent records can make the buckets and the maximum slightly disagree, the maximum bounds the percentiles
+    const uint64_t max = maxTicks.load(std::memory_order_relaxed);
+    auto toMicroseconds = [](uint64_t ticks) {
+        return Microseconds(std::chrono::duration<double, std::nano>(static_cast<double>(ticks) * TickNanoseconds));
+    };
+
+    stats.p50 = toMicroseconds(std::min(GetPercentile(stats.count, 0.50), max));
+    stats.p99 = toMicroseconds(std::min(GetPercentile(stats.count, 0.99), max));
+    stats.max = toMicroseconds(max);
+    return stats;
+}
+
+void LatencyHistogram::Reset() noexcept
+{
+    for (auto& bucket : buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+
+    count.store(0, std::memory_order_relaxed);
+    maxTicks.store(0, std::memory_order_relaxed);
+}
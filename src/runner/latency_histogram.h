@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Histogram of latencies which can be recorded from a time sensitive path, like a keyboard hook,
+// and read from another thread. Recording is a few relaxed atomic increments.
+class LatencyHistogram
+{
+public:
+    using Microseconds = std::chrono::duration<double, std::micro>;
+
+    struct Stats
+    {
+        uint64_t count = 0;
+        Microseconds p50{};
+        Microseconds p99{};
+        Microseconds max{};
+    };
+
+    void Record(std::chrono::nanoseconds latency) noexcept;
+
+    // The percentiles are the upper bounds of the buckets they fall in, which are at most 25% above them
+    Stats GetStats() const noexcept;
+
+    void Reset() noexcept;
+
+private:
+    // Latencies are counted in 100 ns ticks, with 4 buckets for each power of two
+    static constexpr uint64_t TickNanoseconds = 100;
+    static constexpr size_t SubBuckets = 4;
+    static constexpr size_t BucketCount = 64 * SubBuckets;
+
+    static size_t GetBucket(uint64_t ticks) noexcept;
+    static uint64_t GetBucketUpperBound(size_t bucket) noexcept;
+    uint64_t GetPercentile(uint64_t count, double percentile) const noexcept;
+
+    std::array<std::atomic<uint64_t>, BucketCount> buckets{};
+    std::atomic<uint64_t> count{};
+    std::atomic<uint64_t> maxTicks{};
+};
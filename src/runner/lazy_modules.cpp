@@ -0,0 +1,44 @@
+#include "pch.h"
+#include "lazy_modules.h"
+
+bool is_disabled_on_startup(const KnownPowertoyModule& known_module, const json::JsonObject& enabled_settings)
+{
+    if (known_module.key.empty() || !known_module.gpo_policy_enabled_configuration)
+    {
+        return false;
+    }
+
+    const auto gpo_rule = known_module.gpo_policy_enabled_configuration();
+    if (gpo_rule == powertoys_gpo::gpo_rule_configured_enabled || gpo_rule == powertoys_gpo::gpo_rule_configured_disabled)
+    {
+        return gpo_rule == powertoys_gpo::gpo_rule_configured_disabled;
+    }
+
+    // Modules without a setting use their own default, which is only known once the DLL is loaded
+    return json::has(enabled_settings, known_module.key, json::JsonValueType::Boolean) && !enabled_settings.GetNamedBoolean(known_module.key);
+}
+
+void LazyModules::add(std::wstring key, std::wstring_view filename)
+{
+    m_modules.insert_or_assign(std::move(key), filename);
+}
+
+std::optional<std::wstring_view> LazyModules::take(const std::wstring& key)
+{
+    auto lazy_module = m_modules.find(key);
+    if (lazy_module == m_modules.end())
+    {
+        return std::nullopt;
+    }
+
+    const auto filename = lazy_module->second;
+    m_modules.erase(lazy_module);
+    return filename;
+}
+
+std::vector<std::pair<std::wstring, std::wstring_view>> LazyModules::take_all()
+{
+    std::vector<std::pair<std::wstring, std::wstring_view>> taken(m_modules.begin(), m_modules.end());
+    m_modules.clear();
+    return taken;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <common/utils/gpo.h>
+#include <common/utils/json.h>
+
+#include <map>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// A module DLL the runner loads on startup
+struct KnownPowertoyModule
+{
+    std::wstring_view filename;
+
+    // Key and group policy of the module, if its DLL can be loaded lazily when the module is disabled
+    std::wstring_view key;
+    powertoys_gpo::gpo_rule_configured_t (*gpo_policy_enabled_configuration)() = nullptr;
+};
+
+// A module doesn't need its DLL on startup if it's disabled in the settings or by group policy.
+// Modules which don't declare their key and group policy are always loaded.
+bool is_disabled_on_startup(const KnownPowertoyModule& known_module, const json::JsonObject& enabled_settings);
+
+// Modules which were disabled on startup and whose DLLs are not loaded yet
+class LazyModules
+{
+public:
+    using container = std::map<std::wstring, std::wstring_view>;
+
+    void add(std::wstring key, std::wstring_view filename);
+
+    // Removes the module and returns its DLL, so that it's loaded only once
+    std::optional<std::wstring_view> take(const std::wstring& key);
+
+    // Removes all modules and returns their keys and DLLs
+    std::vector<std::pair<std::wstring, std::wstring_view>> take_all();
+
+    bool empty() const { return m_modules.empty(); }
+    size_t size() const { return m_modules.size(); }
+    container::const_iterator begin() const { return m_modules.begin(); }
+    container::const_iterator end() const { return m_modules.end(); }
+
+private:
+    container m_modules;
+};
@@ -252,73 +252,67 @@ int runner(bool isProcessElevated, bool openSettings, std::string settingsWindow
         }
 
         // Load PowerToys DLLs
-
-        std::vector<std::wstring_view> knownModules = {
-            L"PowerToys.FancyZonesModuleInterface.dll",
-            L"PowerToys.powerpreview.dll",
-            L"WinUI3Apps/PowerToys.ImageResizerExt.dll",
-            L"PowerToys.KeyboardManager.dll",
-            L"PowerToys.Launcher.dll",
-            L"WinUI3Apps/PowerToys.PowerRenameExt.dll",
-            L"WinUI3Apps/PowerToys.ShortcutGuideModuleInterface.dll",
-            L"PowerToys.ColorPicker.dll",
-            L"PowerToys.AwakeModuleInterface.dll",
-            L"PowerToys.FindMyMouse.dll",
-            L"PowerToys.MouseHighlighter.dll",
-            L"WinUI3Apps/PowerToys.MouseJump.dll",
-            L"PowerToys.AlwaysOnTopModuleInterface.dll",
-            L"PowerToys.MousePointerCrosshairs.dll",
-            L"PowerToys.CursorWrap.dll",
-            L"PowerToys.PowerAccentModuleInterface.dll",
-            L"PowerToys.PowerOCRModuleInterface.dll",
-            L"PowerToys.AdvancedPasteModuleInterface.dll",
-            L"WinUI3Apps/PowerToys.FileLocksmithExt.dll",
-            L"WinUI3Apps/PowerToys.RegistryPreviewExt.dll",
-            L"WinUI3Apps/PowerToys.MeasureToolModuleInterface.dll",
-            L"WinUI3Apps/PowerToys.NewPlus.ShellExtension.dll",
-            L"WinUI3Apps/PowerToys.HostsModuleInterface.dll",
-            L"WinUI3Apps/PowerToys.Peek.dll",
-            L"WinUI3Apps/PowerToys.EnvironmentVariablesModuleInterface.dll",
-            L"PowerToys.MouseWithoutBordersModuleInterface.dll",
-            L"PowerToys.CropAndLockModuleInterface.dll",
-            L"PowerToys.CmdNotFoundModuleInterface.dll",
-            L"PowerToys.WorkspacesModuleInterface.dll",
-            L"PowerToys.CmdPalModuleInterface.dll",
-            L"PowerToys.ZoomItModuleInterface.dll",
-            L"PowerToys.LightSwitchModuleInterface.dll",
-            L"PowerToys.PowerDisplayModuleInterface.dll",
-            L"PowerToys.GrabAndMoveModuleInterface.dll",
-            L"PowerToys.AltWindowCycle.dll",
+        // Modules which declare their key and group policy are loaded lazily while they are disabled
+        std::vector<KnownPowertoyModule> knownModules = {
+            { L"PowerToys.FancyZonesModuleInterface.dll", L"FancyZones", powertoys_gpo::getConfiguredFancyZonesEnabledValue },
+            { L"PowerToys.powerpreview.dll" },
+            { L"WinUI3Apps/PowerToys.ImageResizerExt.dll" },
+            { L"PowerToys.KeyboardManager.dll" },
+            { L"PowerToys.Launcher.dll" },
+            { L"WinUI3Apps/PowerToys.PowerRenameExt.dll" },
+            { L"WinUI3Apps/PowerToys.ShortcutGuideModuleInterface.dll" },
+            { L"PowerToys.ColorPicker.dll", L"ColorPicker", powertoys_gpo::getConfiguredColorPickerEnabledValue },
+            { L"PowerToys.AwakeModuleInterface.dll", L"Awake", powertoys_gpo::getConfiguredAwakeEnabledValue },
+            { L"PowerToys.FindMyMouse.dll", L"FindMyMouse", powertoys_gpo::getConfiguredFindMyMouseEnabledValue },
+            { L"PowerToys.MouseHighlighter.dll", L"MouseHighlighter", powertoys_gpo::getConfiguredMouseHighlighterEnabledValue },
+            { L"WinUI3Apps/PowerToys.MouseJump.dll", L"MouseJump", powertoys_gpo::getConfiguredMouseJumpEnabledValue },
+            { L"PowerToys.AlwaysOnTopModuleInterface.dll", L"AlwaysOnTop", powertoys_gpo::getConfiguredAlwaysOnTopEnabledValue },
+            { L"PowerToys.MousePointerCrosshairs.dll", L"MousePointerCrosshairs", powertoys_gpo::getConfiguredMousePointerCrosshairsEnabledValue },
+            { L"PowerToys.CursorWrap.dll" },
+            { L"PowerToys.PowerAccentModuleInterface.dll" },
+            { L"PowerToys.PowerOCRModuleInterface.dll", L"TextExtractor", powertoys_gpo::getConfiguredTextExtractorEnabledValue },
+            { L"PowerToys.AdvancedPasteModuleInterface.dll" },
+            { L"WinUI3Apps/PowerToys.FileLocksmithExt.dll" },
+            { L"WinUI3Apps/PowerToys.RegistryPreviewExt.dll" },
+            { L"WinUI3Apps/PowerToys.MeasureToolModuleInterface.dll", L"Measure Tool", powertoys_gpo::getConfiguredScreenRulerEnabledValue },
+            { L"WinUI3Apps/PowerToys.NewPlus.ShellExtension.dll" },
+            { L"WinUI3Apps/PowerToys.HostsModuleInterface.dll", L"Hosts", powertoys_gpo::getConfiguredHostsFileEditorEnabledValue },
+            { L"WinUI3Apps/PowerToys.Peek.dll" },
+            { L"WinUI3Apps/PowerToys.EnvironmentVariablesModuleInterface.dll", L"EnvironmentVariables", powertoys_gpo::getConfiguredEnvironmentVariablesEnabledValue },
+            { L"PowerToys.MouseWithoutBordersModuleInterface.dll" },
+            { L"PowerToys.CropAndLockModuleInterface.dll", L"CropAndLock", powertoys_gpo::getConfiguredCropAndLockEnabledValue },
+            { L"PowerToys.CmdNotFoundModuleInterface.dll" },
+            { L"PowerToys.WorkspacesModuleInterface.dll" },
+            { L"PowerToys.CmdPalModuleInterface.dll" },
+            { L"PowerToys.ZoomItModuleInterface.dll", L"ZoomIt", powertoys_gpo::getConfiguredZoomItEnabledValue },
+            { L"PowerToys.LightSwitchModuleInterface.dll" },
+            { L"PowerToys.PowerDisplayModuleInterface.dll" },
+            { L"PowerToys.GrabAndMoveModuleInterface.dll" },
+            { L"PowerToys.AltWindowCycle.dll" },
         };
 
-        for (auto moduleSubdir : knownModules)
+        for (auto moduleSubdir : load_powertoys(knownModules))
         {
-            try
-            {
-                auto pt_module = load_powertoy(moduleSubdir);
-                modules().emplace(pt_module->get_key(), std::move(pt_module));
-            }
-            catch (...)
-            {
-                std::wstring errorMessage = POWER_TOYS_MODULE_LOAD_FAIL;
-                errorMessage += moduleSubdir;
-                
+            std::wstring errorMessage = POWER_TOYS_MODULE_LOAD_FAIL;
+            errorMessage += moduleSubdir;
+            
 #ifdef _DEBUG
-                // In debug mode, simply log the warning and continue execution.
-                // This contrasts with the past approach where developers had to build all modules
-                // without errors before debugging—slowing down quick clone-and-fix iterations.
-                Logger::warn(L"Debug mode: {}", errorMessage);
+            // In debug mode, simply log the warning and continue execution.
+            // This contrasts with the past approach where developers had to build all modules
+            // without errors before debugging—slowing down quick clone-and-fix iterations.
+            Logger::warn(L"Debug mode: {}", errorMessage);
 #else
-                // In release mode, show error dialog as before
-                MessageBoxW(NULL,
-                            errorMessage.c_str(),
-                            L"PowerToys",
-                            MB_OK | MB_ICONERROR);
+            // In release mode, show error dialog as before
+            MessageBoxW(NULL,
+                        errorMessage.c_str(),
+                        L"PowerToys",
+                        MB_OK | MB_ICONERROR);
 #endif
-            }
         }
         // Start initial powertoys
         start_enabled_powertoys();
+        register_powertoys_hotkeys();
+        report_powertoys_startup_timeline();
         std::wstring product_version = get_product_version();
         Trace::EventLaunch(product_version, isProcessElevated);
         PTSettingsHelper::save_last_version_run(product_version);
@@ -2,18 +2,43 @@
 #include "powertoy_module.h"
 #include "centralized_kb_hook.h"
 #include "centralized_hotkeys.h"
+#include "trace.h"
 #include <common/logger/logger.h>
+#include <common/SettingsAPI/settings_helpers.h>
 #include <common/utils/winapi_error.h>
 
+#include <atomic>
+
+namespace
+{
+    // Mapping a DLL mostly waits on the disk, a few threads are enough to overlap that
+    constexpr size_t MaxModuleLoadWorkers = 4;
+
+    double milliseconds_since(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
 std::map<std::wstring, PowertoyModule>& modules()
 {
     static std::map<std::wstring, PowertoyModule> modules;
     return modules;
 }
 
-PowertoyModule load_powertoy(const std::wstring_view filename)
+LazyModules& lazy_modules()
 {
+    static LazyModules lazy_modules;
+    return lazy_modules;
+}
+
+PowertoyModule load_powertoy(const std::wstring_view filename, bool with_hotkeys)
+{
+    auto start = std::chrono::steady_clock::now();
     auto handle = winrt::check_pointer(LoadLibraryW(filename.data()));
+    const double load_duration = milliseconds_since(start);
+
+    start = std::chrono::steady_clock::now();
     auto create = reinterpret_cast<powertoy_create_func>(GetProcAddress(handle, "powertoy_create"));
     if (!create)
     {
@@ -26,7 +51,171 @@ PowertoyModule load_powertoy(const std::wstring_view filename)
         FreeLibrary(handle);
         winrt::throw_hresult(winrt::hresult(E_POINTER));
     }
-    return PowertoyModule(pt_module, handle);
+    const double create_duration = milliseconds_since(start);
+
+    start = std::chrono::steady_clock::now();
+    PowertoyModule powertoy(pt_module, handle, with_hotkeys);
+    powertoy.timeline = { .load = load_duration, .create = create_duration, .config = with_hotkeys ? milliseconds_since(start) : 0 };
+    return powertoy;
+}
+
+std::vector<std::wstring_view> load_powertoys(const std::vector<KnownPowertoyModule>& known_modules)
+{
+    json::JsonObject enabled_settings;
+    try
+    {
+        auto general_settings = PTSettingsHelper::load_general_settings();
+        if (json::has(general_settings, L"enabled"))
+        {
+            enabled_settings = general_settings.GetNamedObject(L"enabled");
+        }
+    }
+    catch (...)
+    {
+    }
+
+    std::vector<std::wstring_view> filenames;
+    for (const auto& known_module : known_modules)
+    {
+        if (is_disabled_on_startup(known_module, enabled_settings))
+        {
+            Logger::info(L"load_powertoys: {} is disabled, it will be loaded when it's enabled", known_module.key);
+            lazy_modules().add(std::wstring{ known_module.key }, known_module.filename);
+        }
+        else
+        {
+            filenames.push_back(known_module.filename);
+        }
+    }
+
+    // The DLLs and their dependencies are mapped on worker threads, while the modules are created here in order.
+    // Some modules create windows or install hooks in powertoy_create, which must stay on the runner thread.
+    struct MappedDll
+    {
+        HMODULE handle = nullptr;
+        double duration = 0;
+        std::atomic<bool> done = false;
+    };
+
+    std::vector<MappedDll> mapped_dlls(filenames.size());
+    std::atomic<size_t> next_dll = 0;
+    std::vector<std::thread> workers;
+    const size_t worker_count = std::clamp<size_t>(std::thread::hardware_concurrency(), 1, MaxModuleLoadWorkers);
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        workers.emplace_back([&] {
+            for (size_t dll = next_dll++; dll < filenames.size(); dll = next_dll++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                mapped_dlls[dll].handle = LoadLibraryW(filenames[dll].data());
+                mapped_dlls[dll].duration = milliseconds_since(start);
+                mapped_dlls[dll].done = true;
+                mapped_dlls[dll].done.notify_one();
+            }
+        });
+    }
+
+    std::vector<std::wstring_view> failed;
+    for (size_t i = 0; i < filenames.size(); i++)
+    {
+        mapped_dlls[i].done.wait(false);
+        try
+        {
+            // The DLL is already mapped if the worker succeeded, this only adds a reference
+            auto pt_module = load_powertoy(filenames[i], false);
+            pt_module.timeline.load = mapped_dlls[i].duration;
+            modules().emplace(pt_module->get_key(), std::move(pt_module));
+        }
+        catch (...)
+        {
+            failed.push_back(filenames[i]);
+        }
+
+        if (mapped_dlls[i].handle)
+        {
+            FreeLibrary(mapped_dlls[i].handle);
+        }
+    }
+
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+
+    return failed;
+}
+
+bool load_lazy_powertoy(const std::wstring& name)
+{
+    const auto filename = lazy_modules().take(name);
+    if (!filename)
+    {
+        return false;
+    }
+
+    Logger::info(L"load_lazy_powertoy: Loading {} from {}", name, *filename);
+    try
+    {
+        auto pt_module = load_powertoy(*filename);
+        modules().emplace(pt_module->get_key(), std::move(pt_module));
+        return true;
+    }
+    catch (...)
+    {
+        Logger::error(L"load_lazy_powertoy: Failed to load {}", *filename);
+        return false;
+    }
+}
+
+void load_lazy_powertoys()
+{
+    for (const auto& [name, filename] : lazy_modules().take_all())
+    {
+        Logger::info(L"load_lazy_powertoys: Loading disabled module {} from {}", name, filename);
+        try
+        {
+            // The module stays disabled, its hotkeys are recorded as hotkeys of a disabled module
+            auto pt_module = load_powertoy(filename);
+            modules().emplace(pt_module->get_key(), std::move(pt_module));
+        }
+        catch (...)
+        {
+            Logger::error(L"load_lazy_powertoys: Failed to load {}", filename);
+        }
+    }
+}
+
+void register_powertoys_hotkeys()
+{
+    for (auto& [name, powertoy] : modules())
+    {
+        const auto start = std::chrono::steady_clock::now();
+        powertoy.register_hotkeys();
+        powertoy.timeline.config = milliseconds_since(start);
+    }
+}
+
+void report_powertoys_startup_timeline()
+{
+    PowertoyModuleTimeline total;
+    for (auto& [name, powertoy] : modules())
+    {
+        const auto& timeline = powertoy.timeline;
+        Logger::info(L"Startup timeline: {} load {:.1f} ms, create {:.1f} ms, config {:.1f} ms, enable {:.1f} ms", name, timeline.load, timeline.create, timeline.config, timeline.enable);
+        Trace::ModuleStartupTimeline(name, timeline);
+
+        total.load += timeline.load;
+        total.create += timeline.create;
+        total.config += timeline.config;
+        total.enable += timeline.enable;
+    }
+
+    for (const auto& [name, filename] : lazy_modules())
+    {
+        Logger::info(L"Startup timeline: {} not loaded, it's disabled", name);
+    }
+
+    Logger::info(L"Startup timeline: {} modules loaded, {} deferred. load {:.1f} ms, create {:.1f} ms, config {:.1f} ms, enable {:.1f} ms", modules().size(), lazy_modules().size(), total.load, total.create, total.config, total.enable);
 }
 
 json::JsonObject PowertoyModule::json_config() const
@@ -39,7 +228,7 @@ json::JsonObject PowertoyModule::json_config() const
     return json::JsonObject::Parse(result);
 }
 
-PowertoyModule::PowertoyModule(PowertoyModuleIface* pt_module, HMODULE handle) :
+PowertoyModule::PowertoyModule(PowertoyModuleIface* pt_module, HMODULE handle, bool with_hotkeys) :
     handle(handle), pt_module(pt_module), hkmng(HotkeyConflictDetector::HotkeyConflictManager::GetInstance())
 {
     if (!pt_module)
@@ -47,6 +236,14 @@ PowertoyModule::PowertoyModule(PowertoyModuleIface* pt_module, HMODULE handle) :
         throw std::runtime_error("Module not initialized");
     }
 
+    if (with_hotkeys)
+    {
+        register_hotkeys();
+    }
+}
+
+void PowertoyModule::register_hotkeys()
+{
     remove_hotkey_records();
     update_hotkeys();
     UpdateHotkeyEx();
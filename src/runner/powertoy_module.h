@@ -5,7 +5,9 @@
 #include <mutex>
 #include <vector>
 #include <functional>
+#include <map>
 #include "hotkey_conflict_detector.h"
+#include "lazy_modules.h"
 
 #include <common/utils/json.h>
 
@@ -29,10 +31,20 @@ struct PowertoyModuleDLLDeleter
     }
 };
 
+// Durations of the startup steps of a module, in milliseconds
+struct PowertoyModuleTimeline
+{
+    double load = 0;
+    double create = 0;
+    double config = 0;
+    double enable = 0;
+};
+
 class PowertoyModule
 {
 public:
-    PowertoyModule(PowertoyModuleIface* pt_module, HMODULE handle);
+    // Without with_hotkeys, the hotkeys are registered later through register_hotkeys()
+    PowertoyModule(PowertoyModuleIface* pt_module, HMODULE handle, bool with_hotkeys = true);
 
     inline PowertoyModuleIface* operator->()
     {
@@ -50,6 +62,10 @@ public:
         hkmng.RemoveHotkeyByModule(pt_module->get_key());
     }
 
+    void register_hotkeys();
+
+    PowertoyModuleTimeline timeline;
+
 private:
     HotkeyConflictDetector::HotkeyConflictManager& hkmng;
     std::unique_ptr<HMODULE, PowertoyModuleDLLDeleter> handle;
@@ -58,5 +74,29 @@ private:
     
 };
 
-PowertoyModule load_powertoy(const std::wstring_view filename);
+PowertoyModule load_powertoy(const std::wstring_view filename, bool with_hotkeys = true);
+
+// The loaded modules. Modules which were disabled on startup are in lazy_modules() instead, until they
+// get enabled or load_lazy_powertoys() is called. Code which needs every module, e.g. to show all
+// settings or hotkeys, calls load_lazy_powertoys() first.
 std::map<std::wstring, PowertoyModule>& modules();
+
+// Keys and DLLs of the modules which were disabled on startup and are not loaded yet
+LazyModules& lazy_modules();
+
+// Loads the known modules into modules(), or registers them in lazy_modules() when they are disabled.
+// DLLs are mapped on worker threads, the modules are created on the calling thread.
+// Hotkeys are not registered. Returns the DLLs which failed to load.
+std::vector<std::wstring_view> load_powertoys(const std::vector<KnownPowertoyModule>& known_modules);
+
+// Loads a module from lazy_modules() into modules(). Returns false if it isn't a lazily loaded module or fails to load.
+bool load_lazy_powertoy(const std::wstring& name);
+
+// Loads all modules left in lazy_modules() into modules(), disabled and with their hotkeys registered
+void load_lazy_powertoys();
+
+// Registers the hotkeys of all loaded modules at once, after the enabled ones were enabled
+void register_powertoys_hotkeys();
+
+// Logs and traces how long each module took to load, create, register its hotkeys and enable
+void report_powertoys_startup_timeline();
@@ -40,6 +40,7 @@ void update_last_send_time(time_t time)
 
 void send()
 {
+    // Modules still in lazy_modules() are disabled, so they have no settings telemetry to send
     for (auto& [name, powertoy] : modules())
     {
         if (powertoy->is_enabled())
@@ -40,6 +40,9 @@ HANDLE g_terminateSettingsEvent = CreateEventW(nullptr, false, false, CommonShar
 
 json::JsonObject get_power_toys_settings()
 {
+    // The settings window shows the settings of the disabled modules too
+    load_lazy_powertoys();
+
     json::JsonObject result;
     for (const auto& [name, powertoy] : modules())
     {
@@ -294,6 +297,8 @@ void dispatch_received_json(const std::wstring& json_to_parse)
 
                 std::wstring requestId = value.GetObjectW().GetNamedString(L"request_id", L"").c_str();
 
+                // Hotkeys of disabled modules count as conflicts as well
+                load_lazy_powertoys();
                 auto& hkmng = HotkeyConflictDetector::HotkeyConflictManager::GetInstance();
                 bool hasConflict = hkmng.HasConflict(hotkey);
 
@@ -335,6 +340,7 @@ void dispatch_received_json(const std::wstring& json_to_parse)
         {
             try
             {
+                load_lazy_powertoys();
                 auto& hkmng = HotkeyConflictDetector::HotkeyConflictManager::GetInstance();
                 auto conflictsJson = hkmng.GetHotkeyConflictsAsJson();
 
@@ -2,6 +2,7 @@
 #include "trace.h"
 
 #include "general_settings.h"
+#include "powertoy_module.h"
 
 #include <common/Telemetry/TraceBase.h>
 
@@ -57,6 +58,21 @@ void Trace::SettingsChanged(const GeneralSettings& settings)
         TraceLoggingKeyword(PROJECT_KEYWORD_MEASURE));
 }
 
+void Trace::ModuleStartupTimeline(const std::wstring& moduleKey, const PowertoyModuleTimeline& timeline)
+{
+    TraceLoggingWriteWrapper(
+        g_hProvider,
+        "Runner_ModuleStartupTimeline",
+        TraceLoggingWideString(moduleKey.c_str(), "ModuleKey"),
+        TraceLoggingFloat64(timeline.load, "LoadMs"),
+        TraceLoggingFloat64(timeline.create, "CreateMs"),
+        TraceLoggingFloat64(timeline.config, "ConfigMs"),
+        TraceLoggingFloat64(timeline.enable, "EnableMs"),
+        ProjectTelemetryPrivacyDataTag(ProjectTelemetryTag_ProductAndServicePerformance),
+        TraceLoggingBoolean(TRUE, "UTCReplace_AppSessionGuid"),
+        TraceLoggingKeyword(PROJECT_KEYWORD_MEASURE));
+}
+
 void Trace::UpdateCheckCompleted(bool success, bool updateAvailable, const std::wstring& fromVersion, const std::wstring& toVersion)
 {
     TraceLoggingWriteWrapper(
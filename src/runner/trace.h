@@ -3,12 +3,14 @@
 #include <common/Telemetry/TraceBase.h>
 
 struct GeneralSettings;
+struct PowertoyModuleTimeline;
 
 class Trace : public telemetry::TraceBase
 {
 public:
     static void EventLaunch(const std::wstring& versionNumber, bool isProcessElevated);
     static void SettingsChanged(const GeneralSettings& settings);
+    static void ModuleStartupTimeline(const std::wstring& moduleKey, const PowertoyModuleTimeline& timeline);
 
     // Auto-update telemetry
     static void UpdateCheckCompleted(bool success, bool updateAvailable, const std::wstring& fromVersion, const std::wstring& toVersion);
@@ -35,6 +35,10 @@ namespace Microsoft.PowerToys.Settings.UI.Library
         [JsonPropertyName("useNewEditor")]
         public bool UseNewEditor { get; set; } = true;
 
+        // Makes the engine query the state of each key for shortcut checks instead of using its key state snapshot. Kept for validating the snapshot, not shown in the UI.
+        [JsonPropertyName("useLegacyKeyStateQueries")]
+        public bool UseLegacyKeyStateQueries { get; set; }
+
         public string ToJsonString()
         {
             return JsonSerializer.Serialize(this);
@@ -18,6 +18,8 @@ namespace Microsoft.PowerToys.Settings.UI.Library
             ShowIcon = false;
             ExtendedContextMenuOnly = false;
             UseBoostLib = false;
+            PersistMetadataIndex = false;
+            UseParallelRename = false;
         }
 
         private int _maxSize;
@@ -52,6 +54,10 @@ namespace Microsoft.PowerToys.Settings.UI.Library
 
         public bool UseBoostLib { get; set; }
 
+        public bool PersistMetadataIndex { get; set; }
+
+        public bool UseParallelRename { get; set; }
+
         public string ToJsonString()
         {
             return JsonSerializer.Serialize(this, SettingsSerializationContext.Default.PowerRenameLocalProperties);
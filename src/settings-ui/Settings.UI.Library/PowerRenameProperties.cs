@@ -19,6 +19,8 @@ namespace Microsoft.PowerToys.Settings.UI.Library
             ShowIcon = new BoolProperty();
             ExtendedContextMenuOnly = new BoolProperty();
             UseBoostLib = new BoolProperty();
+            PersistMetadataIndex = new BoolProperty();
+            UseParallelRename = new BoolProperty();
         }
 
         [ObsoleteAttribute("Now controlled from the general settings", false)]
@@ -44,5 +46,11 @@ namespace Microsoft.PowerToys.Settings.UI.Library
 
         [JsonPropertyName("bool_use_boost_lib")]
         public BoolProperty UseBoostLib { get; set; }
+
+        [JsonPropertyName("bool_persist_metadata_index")]
+        public BoolProperty PersistMetadataIndex { get; set; }
+
+        [JsonPropertyName("bool_use_parallel_rename")]
+        public BoolProperty UseParallelRename { get; set; }
     }
 }
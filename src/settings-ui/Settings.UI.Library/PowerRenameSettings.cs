@@ -34,6 +34,8 @@ namespace Microsoft.PowerToys.Settings.UI.Library
             Properties.ShowIcon.Value = localProperties.ShowIcon;
             Properties.ExtendedContextMenuOnly.Value = localProperties.ExtendedContextMenuOnly;
             Properties.UseBoostLib.Value = localProperties.UseBoostLib;
+            Properties.PersistMetadataIndex.Value = localProperties.PersistMetadataIndex;
+            Properties.UseParallelRename.Value = localProperties.UseParallelRename;
 
             Version = "1";
             Name = ModuleName;
@@ -69,6 +69,8 @@ namespace Microsoft.PowerToys.Settings.UI.ViewModels
             _powerRenameMaxDispListNumValue = Settings.Properties.MaxMRUSize.Value;
             _autoComplete = Settings.Properties.MRUEnabled.Value;
             _powerRenameUseBoostLib = Settings.Properties.UseBoostLib.Value;
+            _powerRenamePersistMetadataIndex = Settings.Properties.PersistMetadataIndex.Value;
+            _powerRenameUseParallelRename = Settings.Properties.UseParallelRename.Value;
 
             // Initialize extension helpers
             HeifExtension = new StoreExtensionHelper(
@@ -108,6 +110,8 @@ namespace Microsoft.PowerToys.Settings.UI.ViewModels
         private int _powerRenameMaxDispListNumValue;
         private bool _autoComplete;
         private bool _powerRenameUseBoostLib;
+        private bool _powerRenamePersistMetadataIndex;
+        private bool _powerRenameUseParallelRename;
 
         public bool IsEnabled
         {
@@ -260,6 +264,42 @@ namespace Microsoft.PowerToys.Settings.UI.ViewModels
             }
         }
 
+        public bool PersistMetadataIndex
+        {
+            get
+            {
+                return _powerRenamePersistMetadataIndex;
+            }
+
+            set
+            {
+                if (value != _powerRenamePersistMetadataIndex)
+                {
+                    _powerRenamePersistMetadataIndex = value;
+                    Settings.Properties.PersistMetadataIndex.Value = value;
+                    RaisePropertyChanged();
+                }
+            }
+        }
+
+        public bool UseParallelRename
+        {
+            get
+            {
+                return _powerRenameUseParallelRename;
+            }
+
+            set
+            {
+                if (value != _powerRenameUseParallelRename)
+                {
+                    _powerRenameUseParallelRename = value;
+                    Settings.Properties.UseParallelRename.Value = value;
+                    RaisePropertyChanged();
+                }
+            }
+        }
+
         public string GetSettingsSubPath()
         {
             return _settingsConfigFileFolder + "\\" + ModuleName;